@@ -56,3 +56,14 @@ ifeq (__ON__, $(strip $(CONFIG_JEMALLOC_SUPPORT)))
 	SHARED_LIB += -ljemalloc
 	GLOABL_INCLUDE += -I/usr/local/include/
 endif
+
+# 默认哈希算法
+ifeq (TIME33, $(strip $(CONFIG_HASH_ALG)))
+	OPTIONS += __HASH_ALG_TIME33__
+else ifeq (XXH3, $(strip $(CONFIG_HASH_ALG)))
+	OPTIONS += __HASH_ALG_XXH3__
+else ifeq (CRC32C, $(strip $(CONFIG_HASH_ALG)))
+	OPTIONS += __HASH_ALG_CRC32C__
+else
+	OPTIONS += __HASH_ALG_WYHASH__
+endif
@@ -14,3 +14,4 @@ CONFIG_MEMALIGN_SUPPORT = POSIX_MEMALIGN	# MEMALIGN # 内存对齐方式
 CONFIG_MEMLEAK_CHECK = __OFF__		# 内存泄露测试
 CONFIG_RTTP_SUPPORT = __ON__ 		# 开启实时传输功能
 CONFIG_JEMALLOC_SUPPORT = __OFF__ 	# 使用Jemalloc内存池
+CONFIG_HASH_ALG = WYHASH			# TIME33 # XXH3 # CRC32C # 默认哈希算法
@@ -0,0 +1,185 @@
+/******************************************************************************
+ ** Coypright(C) 2014-2024 Qiware technology Co., Ltd
+ **
+ ** 文件名: bptree_bench.c
+ ** 版本号: 1.0
+ ** 描  述: B+树与AVL树、红黑树的性能对比
+ **         1. 随机插入、批量加载(仅B+树)
+ **         2. 随机查询(读多写少场景的主要开销)
+ **         3. 范围扫描(从随机位置起沿叶子链表取BENCH_RANGE_LEN个主键)
+ **         用法: bptree_bench [主键个数]
+ ** 作  者: # Qifeng.zou # 2015.08.08 #
+ ******************************************************************************/
+#include "comm.h"
+#include "bptree.h"
+#include "rb_tree.h"
+#include "avl_tree.h"
+
+#define BENCH_KEY_NUM       (1000000)   /* 默认主键个数 */
+#define BENCH_RANGE_LEN     (1000)      /* 范围扫描的长度 */
+
+typedef struct
+{
+    uint64_t key;                       /* 主键 */
+} bench_item_t;
+
+typedef struct
+{
+    int idx;                            /* 加载位置 */
+    int num;                            /* 主键个数 */
+    bench_item_t *item;                 /* 有序数据 */
+} bench_load_t;
+
+/* 获取当前时间(ms) */
+static double bench_msec(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+
+    return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+static int64_t bench_cmp_cb(const bench_item_t *item1, const bench_item_t *item2)
+{
+    return (item1->key > item2->key) - (item1->key < item2->key);
+}
+
+static int bench_sort_cb(const void *item1, const void *item2)
+{
+    return (int)bench_cmp_cb((const bench_item_t *)item1, (const bench_item_t *)item2);
+}
+
+/* 批量加载回调 */
+static int bench_load_cb(void *args, const void **key, size_t *len, void **data)
+{
+    bench_load_t *load = (bench_load_t *)args;
+
+    if (load->idx >= load->num) {
+        return -1;
+    }
+
+    *key = &load->item[load->idx].key;
+    *len = sizeof(uint64_t);
+    *data = &load->item[load->idx++];
+
+    return 0;
+}
+
+/* 范围扫描回调(取满BENCH_RANGE_LEN个后停止) */
+static int bench_range_cb(const void *key, size_t len, void *data, void *args)
+{
+    return (0 == (++*(int *)args % BENCH_RANGE_LEN));
+}
+
+int main(int argc, char *argv[])
+{
+    int idx, num, hit;
+    double tm;
+    uint64_t key, *query;
+    bench_item_t *item, *sorted;
+    bench_load_t load;
+    bptree_t *bpt, *bpt2;
+    avl_tree_t *avl;
+    rbt_tree_t *rbt;
+
+    num = (argc > 1)? atoi(argv[1]) : BENCH_KEY_NUM;
+    if (num <= 0) {
+        fprintf(stderr, "Usage: %s [key num]\n", argv[0]);
+        return -1;
+    }
+
+    item = (bench_item_t *)calloc(num, sizeof(bench_item_t));
+    sorted = (bench_item_t *)calloc(num, sizeof(bench_item_t));
+    query = (uint64_t *)calloc(num, sizeof(uint64_t));
+    if ((NULL == item) || (NULL == sorted) || (NULL == query)) {
+        return -1;
+    }
+
+    srand(7);
+    for (idx=0; idx<num; ++idx) {
+        item[idx].key = (((uint64_t)rand() << 31) | (uint64_t)rand()) * 2; /* 偶数: 奇数用于查询失败 */
+    }
+    for (idx=0; idx<num; ++idx) {
+        query[idx] = item[rand() % num].key + (idx & 1);
+    }
+    memcpy(sorted, item, num * sizeof(bench_item_t));
+    qsort(sorted, num, sizeof(bench_item_t), bench_sort_cb);
+    for (idx=1, hit=1; idx<num; ++idx) { /* 去重 */
+        if (sorted[idx].key != sorted[hit-1].key) {
+            sorted[hit++] = sorted[idx];
+        }
+    }
+    load.num = hit;
+
+    avl = avl_creat(NULL, (cmp_cb_t)bench_cmp_cb);
+    rbt = rbt_creat(NULL, (cmp_cb_t)bench_cmp_cb);
+    bpt = bptree_creat(NULL);
+    bpt2 = bptree_creat(NULL);
+    if ((NULL == avl) || (NULL == rbt) || (NULL == bpt) || (NULL == bpt2)) {
+        return -1;
+    }
+
+    /* > 插入 */
+    fprintf(stdout, "# %d keys, ns/op\n", num);
+    tm = bench_msec();
+    for (idx=0; idx<num; ++idx) { avl_insert(avl, &item[idx]); }
+    fprintf(stdout, "insert: avl:%.1f", (bench_msec() - tm) * 1e6 / num);
+
+    tm = bench_msec();
+    for (idx=0; idx<num; ++idx) { rbt_insert(rbt, &item[idx]); }
+    fprintf(stdout, " rbt:%.1f", (bench_msec() - tm) * 1e6 / num);
+
+    tm = bench_msec();
+    for (idx=0; idx<num; ++idx) { bptree_insert(bpt, &item[idx].key, sizeof(uint64_t), &item[idx]); }
+    fprintf(stdout, " bptree:%.1f", (bench_msec() - tm) * 1e6 / num);
+
+    load.idx = 0;
+    load.item = sorted;
+    tm = bench_msec();
+    bptree_load(bpt2, bench_load_cb, &load);
+    fprintf(stdout, " bptree(load):%.1f\n", (bench_msec() - tm) * 1e6 / num);
+
+    /* > 查询 */
+    hit = 0;
+    tm = bench_msec();
+    for (idx=0; idx<num; ++idx) { hit += (NULL != avl_query(avl, &query[idx])); }
+    fprintf(stdout, "query: avl:%.1f", (bench_msec() - tm) * 1e6 / num);
+
+    tm = bench_msec();
+    for (idx=0; idx<num; ++idx) { hit += (NULL != rbt_query(rbt, &query[idx])); }
+    fprintf(stdout, " rbt:%.1f", (bench_msec() - tm) * 1e6 / num);
+
+    tm = bench_msec();
+    for (idx=0; idx<num; ++idx) { hit += (NULL != bptree_query(bpt, &query[idx], sizeof(uint64_t))); }
+    fprintf(stdout, " bptree:%.1f", (bench_msec() - tm) * 1e6 / num);
+
+    tm = bench_msec();
+    for (idx=0; idx<num; ++idx) { hit += (NULL != bptree_query(bpt2, &query[idx], sizeof(uint64_t))); }
+    fprintf(stdout, " bptree(load):%.1f hit:%d\n", (bench_msec() - tm) * 1e6 / num, hit / 4);
+
+    /* > 范围扫描 */
+    hit = 0;
+    tm = bench_msec();
+    for (idx=0; idx<1000; ++idx) {
+        key = sorted[rand() % load.num].key;
+        bptree_range(bpt2, &key, sizeof(key), NULL, 0, bench_range_cb, &hit);
+        hit = (hit + BENCH_RANGE_LEN - 1) / BENCH_RANGE_LEN * BENCH_RANGE_LEN; /* 接近末尾时不足 */
+    }
+    fprintf(stdout, "range: %.1f ns/key\n", (bench_msec() - tm) * 1e6 / hit);
+
+    fprintf(stdout, "memory: bptree:%lu bytes height:%d bptree(load):%lu bytes height:%d"
+            " avl:%zu bytes rbt:%zu bytes (nodes only)\n",
+            bptree_mem_size(bpt), bpt->height, bptree_mem_size(bpt2), bpt2->height,
+            (size_t)avl_num(avl) * sizeof(avl_node_t), (size_t)rbt->num * sizeof(rbt_node_t));
+
+    bptree_destroy(bpt, NULL, NULL);
+    bptree_destroy(bpt2, NULL, NULL);
+    avl_destroy(avl, mem_dummy_dealloc, NULL);
+    rbt_destroy(rbt, mem_dummy_dealloc, NULL);
+    free(item);
+    free(sorted);
+    free(query);
+
+    return 0;
+}
@@ -0,0 +1,214 @@
+/******************************************************************************
+ ** Coypright(C) 2014-2024 Qiware technology Co., Ltd
+ **
+ ** 文件名: shm_btree_bench.c
+ ** 版本号: 1.0
+ ** 描  述: 共享内存B树的多进程读写测试
+ **         1. 预先插入偶数关键字(数据为关键字本身);
+ **         2. 写进程持续插入/删除奇数关键字, 引起结点分裂与合并;
+ **         3. 分别启动1,2,4,8...个读进程(通过shm_btree_attach附着), 随机查询偶数
+ **            关键字并校验数据, 统计查询速率及范围遍历速率.
+ **         用法: shm_btree_bench [关键字个数] [每轮秒数] [最大读进程数]
+ ** 作  者: # Qifeng.zou # 2015.08.12 #
+ ******************************************************************************/
+#include "comm.h"
+#include "shm_btree.h"
+#include <sys/wait.h>
+
+#define BENCH_PATH          "shm_btree_bench.bt"
+#define BENCH_BTREE_M       (32)        /* B树的阶 */
+#define BENCH_KEY_NUM       (1000000)   /* 默认关键字个数 */
+#define BENCH_SEC           (3)         /* 默认每轮秒数 */
+#define BENCH_READER_MAX    (8)         /* 默认最大读进程数 */
+#define BENCH_RANGE_LEN     (100)       /* 范围遍历的长度 */
+
+/* 各进程的统计(共享内存) */
+typedef struct
+{
+    volatile int stop;                  /* 停止标识 */
+    struct {
+        uint64_t query;                 /* 查询次数 */
+        uint64_t range;                 /* 范围遍历的关键字个数 */
+        uint64_t error;                 /* 校验失败次数 */
+    } reader[64];
+    uint64_t write;                     /* 写操作次数 */
+} bench_stat_t;
+
+/* 获取当前时间(ms) */
+static double bench_msec(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+
+    return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+/* 范围遍历回调: 校验数据
+ *  只校验偶数关键字: 奇数关键字可能被写进程并发删除, 其数据随即被释放复用 */
+static int bench_range_cb(int key, void *data, void *args)
+{
+    if (!(key & 1) && (*(int *)data != key)) {
+        ++*(uint64_t *)args;
+    }
+    return 0;
+}
+
+/* 读进程: 附着B树后随机查询 */
+static int bench_reader(int idx, int num, size_t total, bench_stat_t *stat)
+{
+    int key, val;
+    uint64_t n = 0;
+    unsigned int seed = idx + 1;
+    shm_btree_cntx_t *ctx;
+
+    ctx = shm_btree_attach(BENCH_PATH, BENCH_BTREE_M, total);
+    if (NULL == ctx) {
+        fprintf(stderr, "Attach btree failed!\n");
+        return -1;
+    }
+
+    while (!stat->stop) {
+        key = (rand_r(&seed) % num) << 1;
+        if (shm_btree_query_copy(ctx, key, &val, sizeof(val))
+            || (val != key))
+        {
+            ++stat->reader[idx].error;
+        }
+
+        if (0 == (++n & 1023)) {
+            stat->reader[idx].range += shm_btree_range(ctx, key, key + 2 * BENCH_RANGE_LEN,
+                    bench_range_cb, &stat->reader[idx].error);
+        }
+    }
+
+    stat->reader[idx].query = n;
+
+    return 0;
+}
+
+/* 写进程: 插入/删除奇数关键字 */
+static void bench_writer(shm_btree_cntx_t *ctx, int num, bench_stat_t *stat)
+{
+    int key, *data;
+    uint64_t n = 0;
+    unsigned int seed = 7;
+
+    while (!stat->stop) {
+        key = ((rand_r(&seed) % num) << 1) + 1;
+        if (rand_r(&seed) & 1) {
+            data = (int *)shm_btree_alloc(ctx, sizeof(int));
+            if (NULL == data) {
+                continue;
+            }
+            *data = key;
+            if (shm_btree_insert(ctx, key, data)) {
+                shm_btree_dealloc(ctx, data);
+            }
+            else if (shm_btree_query(ctx, key) != data) {
+                shm_btree_dealloc(ctx, data); /* 已存在 */
+            }
+        } else {
+            shm_btree_remove(ctx, key);
+        }
+        ++n;
+    }
+
+    stat->write = n;
+}
+
+int main(int argc, char *argv[])
+{
+    size_t total;
+    double tm;
+    pid_t pid[64];
+    bench_stat_t *stat;
+    shm_btree_cntx_t *ctx;
+    int idx, num, sec, max, readers, *data;
+    uint64_t query, range, error, errors = 0;
+
+    num = (argc > 1)? atoi(argv[1]) : BENCH_KEY_NUM;
+    sec = (argc > 2)? atoi(argv[2]) : BENCH_SEC;
+    max = (argc > 3)? atoi(argv[3]) : BENCH_READER_MAX;
+    if ((num <= 0) || (sec <= 0) || (max <= 0) || (max > 64)) {
+        fprintf(stderr, "Usage: %s [key num] [seconds] [max readers(<=64)]\n", argv[0]);
+        return -1;
+    }
+
+    stat = (bench_stat_t *)mmap(NULL, sizeof(bench_stat_t),
+            PROT_READ|PROT_WRITE, MAP_SHARED|MAP_ANONYMOUS, -1, 0);
+    if (MAP_FAILED == stat) {
+        return -1;
+    }
+
+    /* > 创建B树并插入偶数关键字 */
+    total = (size_t)num * 256 + 64 * MB;
+    unlink(BENCH_PATH);
+    ctx = shm_btree_creat(BENCH_PATH, BENCH_BTREE_M, total);
+    if (NULL == ctx) {
+        fprintf(stderr, "Create btree failed!\n");
+        return -1;
+    }
+
+    for (idx=0; idx<num; ++idx) {
+        data = (int *)shm_btree_alloc(ctx, sizeof(int));
+        if (NULL == data) {
+            fprintf(stderr, "Alloc failed! idx:%d\n", idx);
+            return -1;
+        }
+        *data = idx << 1;
+        shm_btree_insert(ctx, idx << 1, data);
+    }
+
+    fprintf(stdout, "# keys:%d m:%d %ds/round, 1 writer\n", num, BENCH_BTREE_M, sec);
+    fprintf(stdout, "%8s %14s %14s %14s %12s %8s\n",
+            "readers", "query/s", "query/s/proc", "range keys/s", "write/s", "errors");
+
+    /* > 逐轮增加读进程数 */
+    for (readers=1; readers<=max; readers<<=1) {
+        memset(stat, 0, sizeof(bench_stat_t));
+        fflush(stdout);
+
+        for (idx=0; idx<readers; ++idx) {
+            pid[idx] = fork();
+            if (0 == pid[idx]) {
+                exit(bench_reader(idx, num, total, stat));
+            }
+        }
+
+        tm = bench_msec();
+        if (0 == fork()) {
+            bench_writer(ctx, num, stat);
+            exit(0);
+        }
+
+        sleep(sec);
+        stat->stop = 1;
+        while (wait(NULL) > 0) { NULL; }
+        tm = (bench_msec() - tm) / 1000.0;
+
+        query = range = error = 0;
+        for (idx=0; idx<readers; ++idx) {
+            query += stat->reader[idx].query;
+            range += stat->reader[idx].range;
+            error += stat->reader[idx].error;
+        }
+
+        fprintf(stdout, "%8d %14.0f %14.0f %14.0f %12.0f %8lu\n", readers,
+                query / tm, query / tm / readers, range / tm, stat->write / tm, error);
+        errors += error;
+    }
+
+    fprintf(stdout, "final keys:%lu\n", shm_btree_num(ctx));
+
+    shm_btree_destroy(ctx);
+    munmap(stat, sizeof(bench_stat_t));
+    unlink(BENCH_PATH);
+
+    if (errors) {
+        fprintf(stderr, "Verify failed! errors:%lu\n", errors);
+        return -1;
+    }
+
+    return 0;
+}
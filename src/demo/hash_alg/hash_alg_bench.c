@@ -0,0 +1,231 @@
+/******************************************************************************
+ ** Coypright(C) 2014-2024 Qiware technology Co., Ltd
+ **
+ ** 文件名: hash_alg_bench.c
+ ** 版本号: 1.0
+ ** 描  述: 哈希算法对比
+ **         1. 吞吐量: 不同主键长度下每次哈希的耗时及GB/s
+ **         2. 分布: 顺序整数、字符串、URL主键落入2^n个槽和质数个槽的卡方检验
+ **            (z值越接近0越均匀, |z|>3说明明显聚集)及最大槽长度
+ **         3. 雪崩: 翻转任一输入位时各输出位翻转概率偏离50%的最大值
+ **         用法: hash_alg_bench [MB]
+ ** 作  者: # Qifeng.zou # 2015.08.02 #
+ ******************************************************************************/
+#include <math.h>
+
+#include "comm.h"
+#include "hash_alg.h"
+
+#define BENCH_DATA_MB       (64)        /* 默认每项测试处理的数据量(MB) */
+#define BENCH_BUF_SIZE      (1 << 20)   /* 数据缓存 */
+#define BENCH_KEY_NUM       (1 << 20)   /* 分布测试的主键个数 */
+#define BENCH_SLOT_POW2     (1 << 16)   /* 2^n个槽 */
+#define BENCH_SLOT_PRIME    (65521)     /* 质数个槽 */
+#define BENCH_AVAL_NUM      (2000)      /* 雪崩测试的样本数 */
+#define BENCH_AVAL_LEN      (16)        /* 雪崩测试的主键长度 */
+
+static const char *bench_alg_name[HASH_ALG_TOTAL] = {
+    "time33", "wyhash", "xxh3", "crc32c"
+};
+
+/* 获取当前时间(ms) */
+static double bench_msec(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+
+    return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+/* 吞吐量 */
+static void bench_speed(const uint8_t *buf, size_t total)
+{
+    int alg;
+    size_t idx, num, len, off;
+    uint64_t sum = 0;
+    double tm;
+    hash_alg_cb_t hash;
+    static const size_t lens[] = {4, 8, 16, 32, 64, 128, 256, 1024, 4096, 65536};
+
+    fprintf(stdout, "# throughput: ns/hash (GB/s)\n");
+    fprintf(stdout, "%8s", "len");
+    for (alg=0; alg<HASH_ALG_TOTAL; ++alg) {
+        fprintf(stdout, " %20s", bench_alg_name[alg]);
+    }
+    fprintf(stdout, "\n");
+
+    for (idx=0; idx<sizeof(lens)/sizeof(lens[0]); ++idx) {
+        len = lens[idx];
+        num = total / len;
+        fprintf(stdout, "%8zu", len);
+        for (alg=0; alg<HASH_ALG_TOTAL; ++alg) {
+            hash = hash_alg_get(alg);
+            tm = bench_msec();
+            for (off=0; off<num; ++off) {
+                sum += hash(buf + (off * 64) % (BENCH_BUF_SIZE - len), len, 0);
+            }
+            tm = bench_msec() - tm;
+            fprintf(stdout, " %9.1f (%7.2f)", tm * 1000000 / num,
+                    (double)num * len / (tm / 1000) / (1 << 30));
+        }
+        fprintf(stdout, "\n");
+    }
+
+    fprintf(stdout, "# checksum: %lx\n\n", sum);
+}
+
+/* 生成第idx个主键, 返回主键长度 */
+typedef int (*bench_key_cb_t)(char *key, int idx);
+
+static int bench_key_int(char *key, int idx)
+{
+    memcpy(key, &idx, sizeof(idx));
+    return sizeof(idx);
+}
+
+static int bench_key_str(char *key, int idx)
+{
+    return sprintf(key, "user:%d", idx);
+}
+
+static int bench_key_url(char *key, int idx)
+{
+    return sprintf(key, "http://www.example.com/news/2015/%02d/%d.html?from=index&id=%d",
+                   idx % 12 + 1, idx / 12, idx);
+}
+
+/* 卡方检验: 返回标准化后的z值 */
+static double bench_chi2(const uint32_t *slot, int num, int total)
+{
+    int idx;
+    double e = (double)total / num, chi = 0;
+
+    for (idx=0; idx<num; ++idx) {
+        chi += (slot[idx] - e) * (slot[idx] - e) / e;
+    }
+
+    return (chi - (num - 1)) / sqrt(2.0 * (num - 1));
+}
+
+/* 分布 */
+static void bench_dist(void)
+{
+    int alg, type, idx, len;
+    uint32_t *pow2, *prime, max2, maxp;
+    uint64_t h;
+    char key[256];
+    hash_alg_cb_t hash;
+    static const char *type_name[] = {"int", "str", "url"};
+    static const bench_key_cb_t key_cb[] = {bench_key_int, bench_key_str, bench_key_url};
+
+    pow2 = (uint32_t *)calloc(BENCH_SLOT_POW2, sizeof(uint32_t));
+    prime = (uint32_t *)calloc(BENCH_SLOT_PRIME, sizeof(uint32_t));
+    if ((NULL == pow2) || (NULL == prime)) {
+        free(pow2);
+        free(prime);
+        return;
+    }
+
+    fprintf(stdout, "# distribution: %d keys, z(2^16 slots)/max  z(%d slots)/max\n",
+            BENCH_KEY_NUM, BENCH_SLOT_PRIME);
+    for (type=0; type<(int)(sizeof(key_cb)/sizeof(key_cb[0])); ++type) {
+        for (alg=0; alg<HASH_ALG_TOTAL; ++alg) {
+            hash = hash_alg_get(alg);
+            memset(pow2, 0, BENCH_SLOT_POW2 * sizeof(uint32_t));
+            memset(prime, 0, BENCH_SLOT_PRIME * sizeof(uint32_t));
+
+            for (idx=0; idx<BENCH_KEY_NUM; ++idx) {
+                len = key_cb[type](key, idx);
+                h = hash(key, len, 0);
+                ++pow2[h & (BENCH_SLOT_POW2 - 1)];
+                ++prime[h % BENCH_SLOT_PRIME];
+            }
+
+            for (max2=0, idx=0; idx<BENCH_SLOT_POW2; ++idx) {
+                max2 = (pow2[idx] > max2)? pow2[idx] : max2;
+            }
+            for (maxp=0, idx=0; idx<BENCH_SLOT_PRIME; ++idx) {
+                maxp = (prime[idx] > maxp)? prime[idx] : maxp;
+            }
+
+            fprintf(stdout, "%-4s %-7s %12.2f/%-6u %12.2f/%-6u\n",
+                    type_name[type], bench_alg_name[alg],
+                    bench_chi2(pow2, BENCH_SLOT_POW2, BENCH_KEY_NUM), max2,
+                    bench_chi2(prime, BENCH_SLOT_PRIME, BENCH_KEY_NUM), maxp);
+        }
+    }
+    fprintf(stdout, "\n");
+
+    free(pow2);
+    free(prime);
+}
+
+/* 雪崩 */
+static void bench_avalanche(void)
+{
+    int alg, n, bit, out;
+    uint64_t h, d;
+    double p, bias;
+    uint8_t key[BENCH_AVAL_LEN];
+    hash_alg_cb_t hash;
+    static uint32_t flip[BENCH_AVAL_LEN * 8][64];
+
+    fprintf(stdout, "# avalanche: %d-byte keys, worst |P(flip)-0.5|\n", BENCH_AVAL_LEN);
+    for (alg=0; alg<HASH_ALG_TOTAL; ++alg) {
+        hash = hash_alg_get(alg);
+        memset(flip, 0, sizeof(flip));
+        srandom(1);
+
+        for (n=0; n<BENCH_AVAL_NUM; ++n) {
+            for (bit=0; bit<BENCH_AVAL_LEN; ++bit) {
+                key[bit] = (uint8_t)random();
+            }
+            h = hash(key, sizeof(key), 0);
+            for (bit=0; bit<BENCH_AVAL_LEN*8; ++bit) {
+                key[bit >> 3] ^= (uint8_t)(1 << (bit & 7));
+                d = h ^ hash(key, sizeof(key), 0);
+                key[bit >> 3] ^= (uint8_t)(1 << (bit & 7));
+                for (out=0; out<64; ++out) {
+                    flip[bit][out] += (d >> out) & 1;
+                }
+            }
+        }
+
+        bias = 0;
+        for (bit=0; bit<BENCH_AVAL_LEN*8; ++bit) {
+            for (out=0; out<64; ++out) {
+                p = (double)flip[bit][out] / BENCH_AVAL_NUM;
+                bias = (fabs(p - 0.5) > bias)? fabs(p - 0.5) : bias;
+            }
+        }
+
+        fprintf(stdout, "%-7s %6.3f\n", bench_alg_name[alg], bias);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    size_t idx, total;
+    uint8_t *buf;
+
+    total = (size_t)((argc > 1)? atoi(argv[1]) : BENCH_DATA_MB) << 20;
+
+    buf = (uint8_t *)malloc(BENCH_BUF_SIZE);
+    if (NULL == buf) {
+        fprintf(stderr, "Alloc memory failed!\n");
+        return -1;
+    }
+
+    for (idx=0; idx<BENCH_BUF_SIZE; ++idx) {
+        buf[idx] = (uint8_t)random();
+    }
+
+    bench_speed(buf, total);
+    bench_dist();
+    bench_avalanche();
+
+    free(buf);
+
+    return 0;
+}
@@ -0,0 +1,182 @@
+/******************************************************************************
+ ** Coypright(C) 2014-2024 Qiware technology Co., Ltd
+ **
+ ** 文件名: hash_map_bench.c
+ ** 版本号: 1.0
+ ** 描  述: 哈希表性能对比
+ **         对比hash_tab(红黑树分片)与hash_map(开放寻址分片)的插入、查找、删除
+ **         耗时以及每条数据占用的内存(不含数据本身).
+ **         用法: hash_map_bench [num] [slots]
+ ** 作  者: # Qifeng.zou # 2015.06.18 #
+ ******************************************************************************/
+#include <malloc.h>
+
+#include "comm.h"
+#include "hash_tab.h"
+#include "hash_map.h"
+
+#define BENCH_DATA_NUM      (1000000)   /* 默认数据条数 */
+#define BENCH_SLOT_NUM      (16)        /* 默认分片数 */
+
+typedef struct
+{
+    uint64_t id;
+    char body[16];
+} bench_data_t;
+
+/* 内存统计(作为内存池使用) */
+typedef struct
+{
+    size_t used;
+} bench_pool_t;
+
+static void *bench_alloc(bench_pool_t *pool, size_t size)
+{
+    void *addr = calloc(1, size);
+
+    if (NULL != addr) {
+        pool->used += malloc_usable_size(addr);
+    }
+    return addr;
+}
+
+static void bench_dealloc(bench_pool_t *pool, void *p)
+{
+    pool->used -= malloc_usable_size(p);
+    free(p);
+}
+
+static int64_t bench_hash_cb(const bench_data_t *data)
+{
+    return (int64_t)data->id;
+}
+
+static int64_t bench_cmp_cb(const bench_data_t *d1, const bench_data_t *d2)
+{
+    return (d1->id == d2->id)? 0 : ((d1->id < d2->id)? -1 : 1);
+}
+
+/* 获取当前时间(ms) */
+static double bench_msec(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+
+    return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+static void bench_print(const char *name, const char *op, int num, double ms)
+{
+    fprintf(stdout, "%-9s %-7s %8.2f ms %8.1f ns/op\n", name, op, ms, ms * 1000000 / num);
+}
+
+int main(int argc, char *argv[])
+{
+    int idx, num, slots, miss;
+    double tm;
+    bench_data_t *data, key;
+    hash_tab_t *htab;
+    hash_map_t *hmap;
+    hash_tab_opt_t tab_opt;
+    hash_map_opt_t map_opt;
+    bench_pool_t tab_pool, map_pool;
+
+    num = (argc > 1)? atoi(argv[1]) : BENCH_DATA_NUM;
+    slots = (argc > 2)? atoi(argv[2]) : BENCH_SLOT_NUM;
+
+    data = (bench_data_t *)calloc(num, sizeof(bench_data_t));
+    if (NULL == data) {
+        fprintf(stderr, "Alloc memory failed!\n");
+        return -1;
+    }
+
+    for (idx=0; idx<num; ++idx) {
+        data[idx].id = (uint64_t)random() << 31 | random();
+    }
+
+    memset(&tab_pool, 0, sizeof(tab_pool));
+    memset(&map_pool, 0, sizeof(map_pool));
+
+    memset(&tab_opt, 0, sizeof(tab_opt));
+
+    tab_opt.pool = (void *)&tab_pool;
+    tab_opt.alloc = (mem_alloc_cb_t)bench_alloc;
+    tab_opt.dealloc = (mem_dealloc_cb_t)bench_dealloc;
+
+    map_opt.pool = (void *)&map_pool;
+    map_opt.alloc = (mem_alloc_cb_t)bench_alloc;
+    map_opt.dealloc = (mem_dealloc_cb_t)bench_dealloc;
+
+    htab = hash_tab_creat(slots, (hash_cb_t)bench_hash_cb, (cmp_cb_t)bench_cmp_cb, &tab_opt);
+    hmap = hash_map_creat(slots, (hash_cb_t)bench_hash_cb, (cmp_cb_t)bench_cmp_cb, &map_opt);
+    if ((NULL == htab) || (NULL == hmap)) {
+        fprintf(stderr, "Create hash table failed!\n");
+        return -1;
+    }
+
+    /* > 插入 */
+    tm = bench_msec();
+    for (idx=0; idx<num; ++idx) {
+        hash_tab_insert(htab, &data[idx], WRLOCK);
+    }
+    bench_print("hash_tab", "insert", num, bench_msec() - tm);
+
+    tm = bench_msec();
+    for (idx=0; idx<num; ++idx) {
+        hash_map_insert(hmap, &data[idx], WRLOCK);
+    }
+    bench_print("hash_map", "insert", num, bench_msec() - tm);
+
+    /* > 查找 */
+    miss = 0;
+    tm = bench_msec();
+    for (idx=0; idx<num; ++idx) {
+        key.id = data[(long)idx * 7919 % num].id;
+        if (NULL == hash_tab_query(htab, &key, RDLOCK)) {
+            ++miss;
+            continue;
+        }
+        hash_tab_unlock(htab, &key, RDLOCK);
+    }
+    bench_print("hash_tab", "query", num, bench_msec() - tm);
+
+    tm = bench_msec();
+    for (idx=0; idx<num; ++idx) {
+        key.id = data[(long)idx * 7919 % num].id;
+        if (NULL == hash_map_query(hmap, &key, RDLOCK)) {
+            ++miss;
+            continue;
+        }
+        hash_map_unlock(hmap, &key, RDLOCK);
+    }
+    bench_print("hash_map", "query", num, bench_msec() - tm);
+
+    /* > 内存 */
+    fprintf(stdout, "hash_tab  memory  %8.1f bytes/entry\n", (double)tab_pool.used / num);
+    fprintf(stdout, "hash_map  memory  %8.1f bytes/entry\n", (double)map_pool.used / num);
+
+    /* > 删除 */
+    tm = bench_msec();
+    for (idx=0; idx<num; ++idx) {
+        hash_tab_delete(htab, &data[idx], WRLOCK);
+    }
+    bench_print("hash_tab", "delete", num, bench_msec() - tm);
+
+    tm = bench_msec();
+    for (idx=0; idx<num; ++idx) {
+        hash_map_delete(hmap, &data[idx], WRLOCK);
+    }
+    bench_print("hash_map", "delete", num, bench_msec() - tm);
+
+    if (miss || hash_tab_total(htab) || hash_map_total(hmap)) {
+        fprintf(stderr, "Check failed! miss:%d total:%lu/%lu\n",
+                miss, hash_tab_total(htab), hash_map_total(hmap));
+    }
+
+    hash_tab_destroy(htab, mem_dummy_dealloc, NULL);
+    hash_map_destroy(hmap, mem_dummy_dealloc, NULL);
+    free(data);
+
+    return 0;
+}
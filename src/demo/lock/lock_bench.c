@@ -0,0 +1,193 @@
+/******************************************************************************
+ ** Coypright(C) 2014-2024 Qiware technology Co., Ltd
+ **
+ ** 文件名: lock_bench.c
+ ** 版本号: 1.0
+ ** 描  述: 锁竞争性能测试
+ **         对比pthread互斥锁、原自旋锁(CAS空转, 此处保留一份作为基准)、
+ **         自旋锁(TTAS+退避)、排队锁(ticket)以及MCS锁在2~N个线程下的吞吐量.
+ **         每个线程反复加锁修改共享数据, 解锁后做少量私有计算; 每种情况运行
+ **         固定时间, 统计完成的临界区次数并校验共享计数.
+ **         用法: lock_bench [threads] [msec]
+ ** 作  者: # Qifeng.zou # 2015.09.15 #
+ ******************************************************************************/
+#include "comm.h"
+#include "redo.h"
+#include "atomic.h"
+#include "spinlock.h"
+#include "mcs_lock.h"
+#include "ticket_lock.h"
+
+#define LOCK_BENCH_THREADS  (64)        /* 默认最大线程数 */
+#define LOCK_BENCH_MSEC     (1000)      /* 默认每种情况的运行时间(毫秒) */
+#define LOCK_BENCH_DATA     (4)         /* 临界区修改的缓存行数 */
+#define LOCK_BENCH_WORK     (32)        /* 临界区外的私有计算量 */
+#define LOCK_BENCH_LOCK_NUM (5)         /* 被测对象个数 */
+
+/* 共享数据 */
+typedef struct
+{
+    pthread_mutex_t mutex;              /* 互斥锁 */
+    spinlock_t spin;                    /* 自旋锁 */
+    ticketlock_t ticket;                /* 排队锁 */
+    mcs_lock_t mcs;                     /* MCS锁 */
+    uint64_t data[LOCK_BENCH_DATA][8];  /* 临界区数据 */
+} __attribute__((aligned(64))) lock_bench_shared_t;
+
+/* 被测对象 */
+typedef struct
+{
+    const char *name;                   /* 名称 */
+    void (*lock)(lock_bench_shared_t *sh, mcs_node_t *node);
+    void (*unlock)(lock_bench_shared_t *sh, mcs_node_t *node);
+} lock_bench_lock_t;
+
+/* 线程参数 */
+typedef struct
+{
+    uint64_t ops;                       /* 完成次数 */
+    lock_bench_lock_t *lock;            /* 被测对象 */
+    pthread_barrier_t *barrier;         /* 同时开始 */
+    mcs_node_t node;                    /* MCS结点 */
+} __attribute__((aligned(64))) lock_bench_args_t;
+
+static lock_bench_shared_t g_shared;
+static volatile int g_stop;
+
+static void bench_mutex_lock(lock_bench_shared_t *sh, mcs_node_t *node) { pthread_mutex_lock(&sh->mutex); }
+static void bench_mutex_unlock(lock_bench_shared_t *sh, mcs_node_t *node) { pthread_mutex_unlock(&sh->mutex); }
+
+/* 原自旋锁: CAS空转, 无退避 */
+static void bench_raw_lock(lock_bench_shared_t *sh, mcs_node_t *node)
+{
+    do {} while(!atomic16_cmp_and_set(&sh->spin.l, SPIN_LOCK_UNLOCK, SPIN_LOCK_LOCKED));
+}
+static void bench_raw_unlock(lock_bench_shared_t *sh, mcs_node_t *node)
+{
+    atomic16_cmp_and_set(&sh->spin.l, SPIN_LOCK_LOCKED, SPIN_LOCK_UNLOCK);
+}
+
+static void bench_spin_lock(lock_bench_shared_t *sh, mcs_node_t *node) { spin_lock(&sh->spin); }
+static void bench_spin_unlock(lock_bench_shared_t *sh, mcs_node_t *node) { spin_unlock(&sh->spin); }
+static void bench_ticket_lock(lock_bench_shared_t *sh, mcs_node_t *node) { ticket_lock(&sh->ticket); }
+static void bench_ticket_unlock(lock_bench_shared_t *sh, mcs_node_t *node) { ticket_unlock(&sh->ticket); }
+static void bench_mcs_lock(lock_bench_shared_t *sh, mcs_node_t *node) { mcs_lock(&sh->mcs, node); }
+static void bench_mcs_unlock(lock_bench_shared_t *sh, mcs_node_t *node) { mcs_unlock(&sh->mcs, node); }
+
+/* 工作线程 */
+static void *lock_bench_routine(void *_args)
+{
+    int idx;
+    uint64_t ops = 0;
+    volatile uint64_t work = 0;
+    lock_bench_args_t *args = (lock_bench_args_t *)_args;
+    lock_bench_lock_t *lock = args->lock;
+
+    pthread_barrier_wait(args->barrier);
+
+    while (!g_stop) {
+        lock->lock(&g_shared, &args->node);
+        for (idx=0; idx<LOCK_BENCH_DATA; ++idx) {
+            ++g_shared.data[idx][0];
+        }
+        lock->unlock(&g_shared, &args->node);
+        ++ops;
+
+        for (idx=0; idx<LOCK_BENCH_WORK; ++idx) {
+            work += idx;
+        }
+    }
+
+    args->ops = ops;
+
+    return NULL;
+}
+
+/* 运行一种情况, 返回吞吐量(Mops/s), 共享计数不一致时返回-1 */
+static double lock_bench_run(lock_bench_lock_t *lock, int num, int msec)
+{
+    int idx;
+    uint64_t total = 0;
+    struct timeval begin, end;
+    pthread_t tid[num];
+    pthread_barrier_t barrier;
+    lock_bench_args_t *args;
+
+    args = (lock_bench_args_t *)memalign_alloc(64, num * sizeof(lock_bench_args_t));
+    if (NULL == args) {
+        return -1;
+    }
+
+    memset(args, 0, num * sizeof(lock_bench_args_t));
+    memset(g_shared.data, 0, sizeof(g_shared.data));
+    g_stop = 0;
+
+    pthread_barrier_init(&barrier, NULL, num + 1);
+    for (idx=0; idx<num; ++idx) {
+        args[idx].lock = lock;
+        args[idx].barrier = &barrier;
+        pthread_create(&tid[idx], NULL, lock_bench_routine, &args[idx]);
+    }
+
+    pthread_barrier_wait(&barrier);
+    gettimeofday(&begin, NULL);
+    usleep(msec * 1000);
+    g_stop = 1;
+
+    for (idx=0; idx<num; ++idx) {
+        pthread_join(tid[idx], NULL);
+        total += args[idx].ops;
+    }
+    gettimeofday(&end, NULL);
+
+    pthread_barrier_destroy(&barrier);
+    free(args);
+
+    for (idx=0; idx<LOCK_BENCH_DATA; ++idx) {
+        if (g_shared.data[idx][0] != total) {
+            return -1;
+        }
+    }
+
+    return total / ((end.tv_sec - begin.tv_sec) * 1e6 + (end.tv_usec - begin.tv_usec));
+}
+
+int main(int argc, char *argv[])
+{
+    int num, max, msec, idx;
+    lock_bench_lock_t lock[LOCK_BENCH_LOCK_NUM] = {
+        {"mutex", bench_mutex_lock, bench_mutex_unlock},
+        {"spin-raw", bench_raw_lock, bench_raw_unlock},
+        {"spin", bench_spin_lock, bench_spin_unlock},
+        {"ticket", bench_ticket_lock, bench_ticket_unlock},
+        {"mcs", bench_mcs_lock, bench_mcs_unlock},
+    };
+
+    max = (argc > 1)? atoi(argv[1]) : LOCK_BENCH_THREADS;
+    msec = (argc > 2)? atoi(argv[2]) : LOCK_BENCH_MSEC;
+    if (max < 2 || msec <= 0) {
+        fprintf(stderr, "usage: %s [threads(>=2)] [msec]\n", argv[0]);
+        return -1;
+    }
+
+    pthread_mutex_init(&g_shared.mutex, NULL);
+    spin_lock_init(&g_shared.spin);
+    ticket_lock_init(&g_shared.ticket);
+    mcs_lock_init(&g_shared.mcs);
+
+    fprintf(stderr, "%-8s", "threads");
+    for (idx=0; idx<LOCK_BENCH_LOCK_NUM; ++idx) {
+        fprintf(stderr, " %10s", lock[idx].name);
+    }
+    fprintf(stderr, "  (Mops/s)\n");
+
+    for (num=2; num<=max; num <<= 1) {
+        fprintf(stderr, "%-8d", num);
+        for (idx=0; idx<LOCK_BENCH_LOCK_NUM; ++idx) {
+            fprintf(stderr, " %10.2f", lock_bench_run(&lock[idx], num, msec));
+        }
+        fprintf(stderr, "\n");
+    }
+
+    return 0;
+}
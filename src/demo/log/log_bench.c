@@ -0,0 +1,130 @@
+/******************************************************************************
+ ** Coypright(C) 2014-2024 Qiware technology Co., Ltd
+ **
+ ** 文件名: log_bench.c
+ ** 版本号: 1.0
+ ** 描  述: 日志写入性能测试
+ **         1~N个线程同时调用log_info(), 统计每秒完成的日志调用次数及单次调用
+ **         的最大耗时(写日志的线程是否被磁盘IO阻塞).
+ **         日志文件写在当前目录下的log_bench.log, 测试结束后删除.
+ **         mode为1时使用二进制模式(log_binfo()).
+ **         用法: log_bench [count] [threads] [mode]
+ ** 作  者: # Qifeng.zou # 2015.09.22 #
+ ******************************************************************************/
+#include "comm.h"
+#include "log.h"
+
+#define LOG_BENCH_COUNT     (200000)        /* 默认每个线程的日志条数 */
+#define LOG_BENCH_THREADS   (32)            /* 默认最大线程数 */
+#define LOG_BENCH_PATH      "./log_bench.log" /* 日志路径 */
+
+/* 线程参数 */
+typedef struct
+{
+    int idx;                                /* 线程序号 */
+    int mode;                               /* 日志模式 */
+    long count;                             /* 日志条数 */
+    uint64_t max_ns;                        /* 单次调用最大耗时(纳秒) */
+    log_cycle_t *log;                       /* 日志对象 */
+    pthread_barrier_t *barrier;             /* 同时开始 */
+} log_bench_args_t;
+
+static uint64_t log_bench_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec * 1000000000UL + ts.tv_nsec;
+}
+
+/* 工作线程 */
+static void *log_bench_routine(void *_args)
+{
+    long idx;
+    uint64_t begin, cost;
+    log_bench_args_t *args = (log_bench_args_t *)_args;
+
+    pthread_barrier_wait(args->barrier);
+
+    args->max_ns = 0;
+    for (idx=0; idx<args->count; ++idx) {
+        begin = log_bench_now();
+        if (LOG_MODE_BINARY == args->mode) {
+            log_binfo(args->log, "This is just a test! thread:%d idx:%ld", args->idx, idx);
+        }
+        else {
+            log_info(args->log, "This is just a test! thread:%d idx:%ld", args->idx, idx);
+        }
+        cost = log_bench_now() - begin;
+        if (cost > args->max_ns) {
+            args->max_ns = cost;
+        }
+    }
+
+    return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+    long count;
+    int idx, num, max, mode;
+    double sec;
+    uint64_t max_ns;
+    struct timeval begin, end;
+    pthread_t tid[LOG_BENCH_THREADS];
+    pthread_barrier_t barrier;
+    log_bench_args_t args[LOG_BENCH_THREADS];
+    log_cycle_t *log;
+
+    count = (argc > 1)? atol(argv[1]) : LOG_BENCH_COUNT;
+    max = (argc > 2)? atoi(argv[2]) : LOG_BENCH_THREADS;
+    mode = (argc > 3)? atoi(argv[3]) : LOG_MODE_TEXT;
+    if ((count <= 0) || (max <= 0) || (max > LOG_BENCH_THREADS)) {
+        fprintf(stderr, "usage: %s [count] [threads(1~%d)] [mode(0:text 1:binary)]\n",
+                argv[0], LOG_BENCH_THREADS);
+        return -1;
+    }
+
+    log = log_init(LOG_LEVEL_INFO, LOG_BENCH_PATH);
+    if (NULL == log) {
+        fprintf(stderr, "Initialize log failed!\n");
+        return -1;
+    }
+    else if (log_set_mode(log, mode)) {
+        fprintf(stderr, "Set log mode failed! mode:%d\n", mode);
+        return -1;
+    }
+
+    for (num=1; num<=max; num <<= 1) {
+        pthread_barrier_init(&barrier, NULL, num + 1);
+        for (idx=0; idx<num; ++idx) {
+            args[idx].idx = idx;
+            args[idx].mode = mode;
+            args[idx].count = count;
+            args[idx].log = log;
+            args[idx].barrier = &barrier;
+            pthread_create(&tid[idx], NULL, log_bench_routine, &args[idx]);
+        }
+
+        pthread_barrier_wait(&barrier);
+        gettimeofday(&begin, NULL);
+        max_ns = 0;
+        for (idx=0; idx<num; ++idx) {
+            pthread_join(tid[idx], NULL);
+            if (args[idx].max_ns > max_ns) {
+                max_ns = args[idx].max_ns;
+            }
+        }
+        gettimeofday(&end, NULL);
+        pthread_barrier_destroy(&barrier);
+
+        sec = (end.tv_sec - begin.tv_sec) + (end.tv_usec - begin.tv_usec) / 1e6;
+        fprintf(stderr, "threads:%-4d %10.0f calls/s  max:%8.1f us/call\n",
+                num, num * count / sec, max_ns / 1e3);
+    }
+
+    unlink(LOG_BENCH_PATH);
+
+    return 0;
+}
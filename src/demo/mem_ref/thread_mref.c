@@ -50,9 +50,7 @@ void *customer(void *arg)
     item_t *item[1024];
 
     while (1) {
-        num = MIN(queue_used(q), 1024);
-
-        num = queue_mpop(q, (void **)item, num);
+        num = queue_pop_burst(q, (void **)item, 1024);
         if (0 == num) {
             usleep(0);
             continue;
@@ -0,0 +1,249 @@
+/******************************************************************************
+ ** Coypright(C) 2014-2024 Qiware technology Co., Ltd
+ **
+ ** 文件名: metrics_demo.c
+ ** 版本号: 1.0
+ ** 描  述: 进程内统计(metrics)的测试代码
+ **         注册计数器、仪表、直方图各一个, 由一个常驻线程和多轮短生命周期的
+ **         线程并发更新(线程退出时分片被汇总到retired), 最后核对统计值及导出
+ **         到共享内存的快照. 结束前可保持一段时间, 供metrics_top.py查看:
+ **             tools/metrics_top.py metrics_demo.shm
+ **         用法: metrics_demo [线程数] [轮数] [保持秒数]
+ ** 作  者: # Qifeng.zou # 2015.09.29 #
+ ******************************************************************************/
+#include "comm.h"
+#include "atomic.h"
+#include "metrics.h"
+#include "shm_opt.h"
+
+#define METRICS_DEMO_PATH       "metrics_demo.shm"  /* 共享内存路径 */
+#define METRICS_DEMO_THREADS    (4)         /* 默认每轮的线程数 */
+#define METRICS_DEMO_THREAD_MAX (64)        /* 每轮最大线程数 */
+#define METRICS_DEMO_ROUNDS     (8)         /* 默认轮数 */
+#define METRICS_DEMO_LOOP       (200000)    /* 每个线程的更新次数 */
+#define METRICS_DEMO_VAL_MAX    (5000)      /* 直方图观测值范围[0, VAL_MAX) */
+
+/* 测试对象 */
+typedef struct
+{
+    metrics_t *requests;                    /* 计数器: 请求数 */
+    metrics_t *active;                      /* 仪表: 活跃线程数 */
+    metrics_t *latency;                     /* 直方图: 处理时延(纳秒) */
+
+    volatile int stop;                      /* 常驻线程是否停止 */
+    volatile long resident;                 /* 常驻线程的更新次数 */
+} metrics_demo_t;
+
+/* 第idx次更新的观测值 */
+#define metrics_demo_val(idx) ((uint64_t)((idx) % METRICS_DEMO_VAL_MAX))
+
+/* 短生命周期线程: 更新后退出 */
+static void *metrics_demo_worker(void *_ctx)
+{
+    long idx;
+    metrics_demo_t *ctx = (metrics_demo_t *)_ctx;
+
+    metrics_gauge_inc(ctx->active);
+    for (idx=0; idx<METRICS_DEMO_LOOP; ++idx) {
+        metrics_counter_inc(ctx->requests);
+        metrics_hist_observe(ctx->latency, metrics_demo_val(idx));
+    }
+    metrics_gauge_dec(ctx->active);
+
+    return NULL;
+}
+
+/* 常驻线程: 持续更新直到被停止 */
+static void *metrics_demo_resident(void *_ctx)
+{
+    long idx;
+    metrics_demo_t *ctx = (metrics_demo_t *)_ctx;
+
+    metrics_gauge_inc(ctx->active);
+    for (idx=0; !ctx->stop; ++idx) {
+        metrics_counter_inc(ctx->requests);
+        metrics_hist_observe(ctx->latency, metrics_demo_val(idx));
+        if (0 == (idx & 0xFFF)) {
+            usleep(100);
+        }
+    }
+    metrics_gauge_dec(ctx->active);
+
+    ctx->resident = idx;
+
+    return NULL;
+}
+
+/* 前num次更新的观测值之和 */
+static uint64_t metrics_demo_sum(long num)
+{
+    long idx;
+    uint64_t sum = 0;
+
+    for (idx=0; idx<num; ++idx) {
+        sum += metrics_demo_val(idx);
+    }
+
+    return sum;
+}
+
+/******************************************************************************
+ **函数名称: metrics_demo_check
+ **功    能: 核对统计值及共享内存快照
+ **输入参数:
+ **     ctx: 测试对象
+ **     count: 预期的更新次数
+ **     sum: 预期的观测值之和
+ **输出参数: NONE
+ **返    回: 0:成功 !0:失败
+ **实现描述: 先用metrics_value()核对, 再导出快照, 按metrics_top.py的方式读取
+ **注意事项: 所有更新线程均已退出, 快照不会再变化
+ **作    者: # Qifeng.zou # 2015.09.29 #
+ ******************************************************************************/
+static int metrics_demo_check(metrics_demo_t *ctx, long count, uint64_t sum)
+{
+    int idx, ret = 0;
+    uint64_t seq, num = 0;
+    metrics_shm_t *addr, *shm;
+    metrics_shm_item_t *item;
+
+    fprintf(stdout, "requests:%ld active:%ld latency:%ld (expect %ld/0/%ld)\n",
+            (long)metrics_value(ctx->requests), (long)metrics_value(ctx->active),
+            (long)metrics_value(ctx->latency), count, count);
+
+    if ((metrics_value(ctx->requests) != count)
+        || (0 != metrics_value(ctx->active))
+        || (metrics_value(ctx->latency) != count))
+    {
+        ret = -1;
+    }
+
+    /* > 导出并读取快照 */
+    if (metrics_export()) {
+        fprintf(stderr, "Export metrics failed!\n");
+        return -1;
+    }
+
+    addr = (metrics_shm_t *)shm_attach(METRICS_DEMO_PATH, 0);
+    if (NULL == addr) {
+        fprintf(stderr, "Attach metrics shm failed! errmsg:[%d] %s\n", errno, strerror(errno));
+        return -1;
+    }
+
+    shm = (metrics_shm_t *)malloc(sizeof(metrics_shm_t));
+    if (NULL == shm) {
+        return -1;
+    }
+
+    /* > 按顺序锁读取(导出线程仍在定时写入) */
+    do {
+        while ((seq = addr->seq) & 1) {
+            usleep(1000);
+        }
+        memory_barrier();
+        memcpy(shm, addr, sizeof(metrics_shm_t));
+        memory_barrier();
+    } while (seq != addr->seq);
+
+    if ((METRICS_MAGIC != shm->magic) || (shm->num != 3)) {
+        fprintf(stderr, "Invalid snapshot! magic:%#x num:%u\n", shm->magic, shm->num);
+        free(shm);
+        return -1;
+    }
+
+    item = &shm->item[ctx->latency->idx];
+    for (idx=0; idx<METRICS_HIST_BUCKET_NUM; ++idx) {
+        num += shm->bucket[item->hist][idx];
+    }
+
+    fprintf(stdout, "snapshot: requests:%ld active:%ld latency:%ld sum:%lu buckets:%lu (expect sum %lu)\n",
+            shm->item[ctx->requests->idx].value, shm->item[ctx->active->idx].value,
+            item->value, item->sum, num, sum);
+
+    if ((shm->item[ctx->requests->idx].value != count)
+        || (shm->item[ctx->active->idx].value != 0)
+        || (item->value != count) || (item->sum != sum) || (num != (uint64_t)count))
+    {
+        ret = -1;
+    }
+
+    free(shm);
+
+    return ret;
+}
+
+int main(int argc, char *argv[])
+{
+    int idx, round, threads, rounds, hold;
+    long count;
+    uint64_t sum;
+    pthread_t tid[METRICS_DEMO_THREAD_MAX], resident;
+    metrics_demo_t ctx;
+
+    threads = (argc > 1)? atoi(argv[1]) : METRICS_DEMO_THREADS;
+    rounds = (argc > 2)? atoi(argv[2]) : METRICS_DEMO_ROUNDS;
+    hold = (argc > 3)? atoi(argv[3]) : 0;
+    threads = MIN(MAX(threads, 1), METRICS_DEMO_THREAD_MAX);
+    rounds = MAX(rounds, 1);
+
+    memset(&ctx, 0, sizeof(ctx));
+
+    /* > 注册统计项 */
+    ctx.requests = metrics_counter("demo.requests");
+    ctx.active = metrics_gauge("demo.active_threads");
+    ctx.latency = metrics_histogram("demo.latency_ns");
+    if ((NULL == ctx.requests) || (NULL == ctx.active) || (NULL == ctx.latency)) {
+        fprintf(stderr, "Register metrics failed!\n");
+        return -1;
+    }
+
+    if ((metrics_counter("demo.requests") != ctx.requests)
+        || (NULL != metrics_gauge("demo.requests")))
+    {
+        fprintf(stderr, "Register metrics again failed!\n");
+        return -1;
+    }
+
+    if (metrics_init(METRICS_DEMO_PATH, 0)) {
+        fprintf(stderr, "Init metrics failed! errmsg:[%d] %s\n", errno, strerror(errno));
+        return -1;
+    }
+
+    /* > 常驻线程 + 多轮短生命周期线程 */
+    if (pthread_create(&resident, NULL, metrics_demo_resident, &ctx)) {
+        fprintf(stderr, "Create thread failed! errmsg:[%d] %s\n", errno, strerror(errno));
+        return -1;
+    }
+
+    for (round=0; round<rounds; ++round) {
+        for (idx=0; idx<threads; ++idx) {
+            if (pthread_create(&tid[idx], NULL, metrics_demo_worker, &ctx)) {
+                fprintf(stderr, "Create thread failed! errmsg:[%d] %s\n", errno, strerror(errno));
+                return -1;
+            }
+        }
+        for (idx=0; idx<threads; ++idx) {
+            pthread_join(tid[idx], NULL);
+        }
+        fprintf(stdout, "round:%d requests:%ld active:%ld\n", round,
+                (long)metrics_value(ctx.requests), (long)metrics_value(ctx.active));
+    }
+
+    ctx.stop = 1;
+    pthread_join(resident, NULL);
+
+    /* > 核对 */
+    count = (long)rounds * threads * METRICS_DEMO_LOOP + ctx.resident;
+    sum = rounds * threads * metrics_demo_sum(METRICS_DEMO_LOOP) + metrics_demo_sum(ctx.resident);
+
+    if (metrics_demo_check(&ctx, count, sum)) {
+        fprintf(stderr, "Verify failed!\n");
+        return -1;
+    }
+
+    fprintf(stdout, "Verify ok! run: tools/metrics_top.py %s\n", METRICS_DEMO_PATH);
+
+    sleep(hold);
+
+    return 0;
+}
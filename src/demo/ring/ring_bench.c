@@ -0,0 +1,141 @@
+/******************************************************************************
+ ** Coypright(C) 2014-2024 Qiware technology Co., Ltd
+ **
+ ** 文件名: ring_bench.c
+ ** 版本号: 1.0
+ ** 描  述: 环形队列性能测试
+ **         对比多生产者/多消费者(MPMC)与单生产者/单消费者(SPSC)两种模式下,
+ **         单条压入弹出与批量(burst)压入弹出的吞吐量.
+ **         用法: ring_bench [count] [burst]
+ ** 作  者: # Qifeng.zou # 2015.06.15 #
+ ******************************************************************************/
+#include "comm.h"
+#include "ring.h"
+
+#define RING_BENCH_LEN      (4096)          /* 队列长度 */
+#define RING_BENCH_COUNT    (10000000)      /* 默认测试条数 */
+#define RING_BENCH_BURST    (32)            /* 默认批量个数 */
+
+/* 测试参数 */
+typedef struct
+{
+    ring_t *rq;                             /* 环形队列 */
+    long count;                             /* 测试条数 */
+    int burst;                              /* 批量个数(1:单条压入弹出) */
+} ring_bench_t;
+
+/* 生产者线程 */
+static void *ring_bench_prod(void *_args)
+{
+    int n, k;
+    long idx = 1;
+    void *addr[RING_BENCH_LEN];
+    ring_bench_t *args = (ring_bench_t *)_args;
+
+    while (idx <= args->count) {
+        if (1 == args->burst) {
+            if (ring_push(args->rq, (void *)idx)) {
+                continue;
+            }
+            ++idx;
+            continue;
+        }
+
+        n = MIN(args->burst, args->count - idx + 1);
+        for (k=0; k<n; ++k) {
+            addr[k] = (void *)(idx + k);
+        }
+
+        idx += ring_push_burst(args->rq, addr, n);
+    }
+
+    return NULL;
+}
+
+/* 消费者: 返回校验和 */
+static long ring_bench_cons(ring_bench_t *args)
+{
+    int n, k;
+    void *addr[RING_BENCH_LEN];
+    long num = 0, sum = 0;
+
+    while (num < args->count) {
+        if (1 == args->burst) {
+            addr[0] = ring_pop(args->rq);
+            if (NULL == addr[0]) {
+                continue;
+            }
+            sum += (long)addr[0];
+            ++num;
+            continue;
+        }
+
+        n = ring_pop_burst(args->rq, addr, args->burst);
+        for (k=0; k<n; ++k) {
+            sum += (long)addr[k];
+        }
+        num += n;
+    }
+
+    return sum;
+}
+
+/* 执行测试 */
+static int ring_bench_run(const char *name, int flag, long count, int burst)
+{
+    long sum;
+    pthread_t tid;
+    ring_bench_t args;
+    struct timeval stm, etm;
+    double sec;
+
+    args.rq = ring_creat_ex(RING_BENCH_LEN, flag);
+    if (NULL == args.rq) {
+        fprintf(stderr, "Create ring failed!\n");
+        return -1;
+    }
+    args.count = count;
+    args.burst = burst;
+
+    gettimeofday(&stm, NULL);
+
+    if (pthread_create(&tid, NULL, ring_bench_prod, &args)) {
+        fprintf(stderr, "Create thread failed! errmsg:[%d] %s\n", errno, strerror(errno));
+        ring_destroy(args.rq);
+        free(args.rq);
+        return -1;
+    }
+
+    sum = ring_bench_cons(&args);
+
+    pthread_join(tid, NULL);
+
+    gettimeofday(&etm, NULL);
+
+    sec = (etm.tv_sec - stm.tv_sec) + (etm.tv_usec - stm.tv_usec) / 1000000.0;
+
+    fprintf(stdout, "%-6s burst:%-4d %10.2f Mops/s %s\n", name, burst,
+            count / sec / 1000000, (sum == count * (count + 1) / 2)? "" : "(checksum error)");
+
+    ring_destroy(args.rq);
+    free(args.rq);
+
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    long count;
+    int burst;
+
+    count = (argc > 1)? atol(argv[1]) : RING_BENCH_COUNT;
+    burst = (argc > 2)? atoi(argv[2]) : RING_BENCH_BURST;
+    burst = MIN(MAX(burst, 1), RING_BENCH_LEN);
+
+    ring_bench_run("MPMC", RING_FLAG_MPMC, count, 1);
+    ring_bench_run("SPSC", RING_FLAG_SPSC, count, 1);
+    ring_bench_run("MPMC", RING_FLAG_MPMC, count, burst);
+    ring_bench_run("SPSC", RING_FLAG_SPSC, count, burst);
+
+    return 0;
+}
@@ -0,0 +1,164 @@
+/******************************************************************************
+ ** Coypright(C) 2014-2024 Qiware technology Co., Ltd
+ **
+ ** 文件名: ring_stress.c
+ ** 版本号: 1.0
+ ** 描  述: 环形队列超额订阅压力测试
+ **         生产者和消费者线程数远超CPU核数时, 统计吞吐量以及各线程相邻两次
+ **         成功操作之间的最大间隔(用于观察线程被抢占导致的停顿).
+ **         队列满或空时经spin_backoff()退避(最终让出CPU), 避免空转整个时间片,
+ **         使测得的停顿来自队列本身而非测试程序.
+ **         用法: ring_stress [threads] [count]
+ **             threads: 生产者和消费者线程数(默认: CPU核数*4)
+ **             count: 每个生产者压入的条数
+ ** 作  者: # Qifeng.zou # 2015.06.16 #
+ ******************************************************************************/
+#include "comm.h"
+#include "ring.h"
+#include "atomic.h"
+#include "spinlock.h"
+
+#define RING_STRESS_LEN     (1024)          /* 队列长度 */
+#define RING_STRESS_COUNT   (1000000)       /* 默认每个生产者压入的条数 */
+
+/* 测试参数 */
+typedef struct
+{
+    ring_t *rq;                             /* 环形队列 */
+    long count;                             /* 每个生产者压入的条数 */
+    long total;                             /* 总条数 */
+    volatile uint64_t popped;               /* 已弹出条数 */
+    volatile uint64_t sum;                  /* 校验和 */
+    volatile uint64_t max_gap;              /* 最大停顿(us) */
+} ring_stress_t;
+
+/* 获取当前时间(us) */
+static uint64_t ring_stress_usec(void)
+{
+    struct timespec tm;
+
+    clock_gettime(CLOCK_MONOTONIC, &tm);
+
+    return (uint64_t)tm.tv_sec * 1000000 + tm.tv_nsec / 1000;
+}
+
+/* 更新最大停顿 */
+static void ring_stress_set_gap(ring_stress_t *args, uint64_t gap)
+{
+    uint64_t max;
+
+    do {
+        max = args->max_gap;
+        if (gap <= max) {
+            return;
+        }
+    } while (!atomic64_cmp_and_set(&args->max_gap, max, gap));
+}
+
+/* 生产者线程 */
+static void *ring_stress_prod(void *_args)
+{
+    long idx = 1;
+    uint32_t delay = 1;
+    uint64_t ctm, ltm, gap = 0;
+    ring_stress_t *args = (ring_stress_t *)_args;
+
+    ltm = ring_stress_usec();
+    while (idx <= args->count) {
+        if (ring_push(args->rq, (void *)idx)) {
+            spin_backoff(&delay); /* 队列满 */
+            continue;
+        }
+        ++idx;
+        delay = 1;
+
+        ctm = ring_stress_usec();
+        gap = MAX(gap, ctm - ltm);
+        ltm = ctm;
+    }
+
+    ring_stress_set_gap(args, gap);
+
+    return NULL;
+}
+
+/* 消费者线程 */
+static void *ring_stress_cons(void *_args)
+{
+    void *addr;
+    uint32_t delay = 1;
+    uint64_t ctm, ltm, gap = 0, sum = 0;
+    ring_stress_t *args = (ring_stress_t *)_args;
+
+    ltm = ring_stress_usec();
+    while (args->popped < (uint64_t)args->total) {
+        addr = ring_pop(args->rq);
+        if (NULL == addr) {
+            spin_backoff(&delay); /* 队列空 */
+            continue;
+        }
+        delay = 1;
+        sum += (uint64_t)addr;
+        atomic64_inc(&args->popped);
+
+        ctm = ring_stress_usec();
+        gap = MAX(gap, ctm - ltm);
+        ltm = ctm;
+    }
+
+    atomic64_add(&args->sum, sum);
+    ring_stress_set_gap(args, gap);
+
+    return NULL;
+}
+
+int main(int argc, char *argv[])
+{
+    int idx, num;
+    pthread_t *tid;
+    ring_stress_t args;
+    uint64_t stm, etm;
+
+    num = (argc > 1)? atoi(argv[1]) : 4 * sysconf(_SC_NPROCESSORS_ONLN);
+    num = MAX(num, 1);
+
+    memset(&args, 0, sizeof(args));
+
+    args.count = (argc > 2)? atol(argv[2]) : RING_STRESS_COUNT;
+    args.total = args.count * num;
+    args.rq = ring_creat(RING_STRESS_LEN);
+    if (NULL == args.rq) {
+        fprintf(stderr, "Create ring failed!\n");
+        return -1;
+    }
+
+    tid = (pthread_t *)calloc(2 * num, sizeof(pthread_t));
+    if (NULL == tid) {
+        fprintf(stderr, "Alloc memory failed!\n");
+        return -1;
+    }
+
+    stm = ring_stress_usec();
+
+    for (idx=0; idx<num; ++idx) {
+        pthread_create(&tid[idx], NULL, ring_stress_cons, &args);
+        pthread_create(&tid[num+idx], NULL, ring_stress_prod, &args);
+    }
+
+    for (idx=0; idx<2*num; ++idx) {
+        pthread_join(tid[idx], NULL);
+    }
+
+    etm = ring_stress_usec();
+
+    fprintf(stdout, "threads:%d+%d cpus:%ld total:%ld %.2f Mops/s max-gap:%lums %s\n",
+            num, num, sysconf(_SC_NPROCESSORS_ONLN), args.total,
+            (double)args.total / (etm - stm), args.max_gap / 1000,
+            (args.sum == (uint64_t)(args.count * (args.count + 1) / 2 * num))? "" : "(checksum error)");
+
+    free(tid);
+    ring_destroy(args.rq);
+    free(args.rq);
+
+    return 0;
+}
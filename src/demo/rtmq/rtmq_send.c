@@ -94,9 +94,11 @@ static void rtmq_setup_conf(rtmq_proxy_conf_t *conf, int port)
 
     conf->sendq.max = 2048;
     conf->sendq.size = 4096;
+    conf->sendq.min = 128;      /* 按128~4096分级, 更大的消息从堆中申请 */
 
     conf->recvq.max = 2048;
     conf->recvq.size = 4096;
+    conf->recvq.min = 128;
 }
 
 int main(int argc, const char *argv[])
@@ -0,0 +1,131 @@
+/******************************************************************************
+ ** Coypright(C) 2014-2024 Qiware technology Co., Ltd
+ **
+ ** 文件名: sdtp_conn.c
+ ** 版本号: 1.0
+ ** 描  述: 连接数与CPU消耗的测试
+ **         逐步增加到SDTP接收端的连接数, 各连接每秒发送一次保活请求,
+ **         通过/proc/<pid>/stat统计接收端进程在各阶段的CPU占用率.
+ **         用法: sdtp_conn <ip> <port> <pid> [max] [step] [secs]
+ ** 作  者: # Qifeng.zou # 2015.06.10 #
+ ******************************************************************************/
+#include "sck.h"
+#include "comm.h"
+#include "redo.h"
+#include "sdtp_mesg.h"
+
+#define SDTP_CONN_MAX       (10000)     /* 默认最大连接数 */
+#define SDTP_CONN_STEP      (1000)      /* 默认每阶段增加的连接数 */
+#define SDTP_CONN_SECS      (5)         /* 默认各阶段的统计时长 */
+
+/* 获取进程已消耗的CPU时间(单位: 时钟滴答) */
+static long sdtp_conn_cpu_ticks(int pid)
+{
+    FILE *fp;
+    char *ptr, path[FILE_PATH_MAX_LEN], line[FILE_LINE_MAX_LEN];
+    unsigned long utime, stime;
+
+    snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+
+    fp = fopen(path, "r");
+    if (NULL == fp) {
+        return -1;
+    }
+
+    if (NULL == fgets(line, sizeof(line), fp)) {
+        fclose(fp);
+        return -1;
+    }
+    fclose(fp);
+
+    /* 跳过进程名(可能含空格), 第14/15列为utime/stime */
+    ptr = strrchr(line, ')');
+    if (NULL == ptr) {
+        return -1;
+    }
+
+    if (2 != sscanf(ptr + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu",
+                &utime, &stime)) {
+        return -1;
+    }
+
+    return (long)(utime + stime);
+}
+
+/* 发送保活请求 */
+static int sdtp_conn_kpalive(int fd)
+{
+    char buff[256];
+    sdtp_header_t head;
+
+    head.type = htons(SDTP_CMD_KPALIVE_REQ);
+    head.nid = 0;
+    head.flag = SDTP_SYS_MESG;
+    head.length = 0;
+    head.chksum = htonl(SDTP_CHKSUM_VAL);
+
+    while (read(fd, buff, sizeof(buff)) > 0) { } /* 丢弃应答 */
+
+    return (Writen(fd, &head, sizeof(head)) == sizeof(head))? 0 : -1;
+}
+
+int main(int argc, const char *argv[])
+{
+    int *fds, num = 0, idx, sec;
+    int pid, port, max, step, secs;
+    long ticks, hz = sysconf(_SC_CLK_TCK);
+
+    if (argc < 4) {
+        fprintf(stderr, "Usage: %s <ip> <port> <pid> [max] [step] [secs]\n", argv[0]);
+        return -1;
+    }
+
+    port = atoi(argv[2]);
+    pid = atoi(argv[3]);
+    max = (argc > 4)? atoi(argv[4]) : SDTP_CONN_MAX;
+    step = (argc > 5)? atoi(argv[5]) : SDTP_CONN_STEP;
+    secs = (argc > 6)? atoi(argv[6]) : SDTP_CONN_SECS;
+
+    signal(SIGPIPE, SIG_IGN);
+
+    fds = (int *)calloc(max, sizeof(int));
+    if (NULL == fds) {
+        fprintf(stderr, "errmsg:[%d] %s!\n", errno, strerror(errno));
+        return -1;
+    }
+
+    fprintf(stdout, "%10s %10s\n", "conns", "cpu(%)");
+
+    while (num < max) {
+        /* > 增加连接 */
+        for (idx=0; (idx<step) && (num<max); ++idx) {
+            fds[num] = tcp_connect(AF_INET, argv[1], port);
+            if (fds[num] < 0) {
+                fprintf(stderr, "Connect failed! errmsg:[%d] %s!\n", errno, strerror(errno));
+                max = num;
+                break;
+            }
+            fd_set_nonblocking(fds[num]);
+            ++num;
+        }
+
+        /* > 统计CPU占用 */
+        ticks = sdtp_conn_cpu_ticks(pid);
+        for (sec=0; sec<secs; ++sec) {
+            for (idx=0; idx<num; ++idx) {
+                sdtp_conn_kpalive(fds[idx]);
+            }
+            Sleep(1);
+        }
+        ticks = sdtp_conn_cpu_ticks(pid) - ticks;
+
+        fprintf(stdout, "%10d %10.2f\n", num, 100.0 * ticks / (hz * secs));
+    }
+
+    for (idx=0; idx<num; ++idx) {
+        CLOSE(fds[idx]);
+    }
+    free(fds);
+
+    return 0;
+}
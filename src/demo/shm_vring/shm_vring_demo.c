@@ -0,0 +1,336 @@
+/******************************************************************************
+ ** Coypright(C) 2014-2024 Qiware technology Co., Ltd
+ **
+ ** 文件名: shm_vring_demo.c
+ ** 版本号: 1.0
+ ** 描  述: 变长环形队列(shm_vring)的测试代码
+ **         多个生产者进程写入长短混合的记录(100B为主, 每隔若干条一条64KB),
+ **         父进程作为消费者逐条校验(所属进程、序列号、长度、内容); 再以相同
+ **         容量的shm_queue执行同样的测试, 对比两者的共享内存大小和耗时.
+ **         用法: shm_vring_demo [进程数] [每个进程的记录数]
+ ** 作  者: # Qifeng.zou # 2015.06.14 #
+ ******************************************************************************/
+#include "comm.h"
+#include "shm_ring.h"
+#include "shm_slot.h"
+#include "shm_queue.h"
+#include "shm_vring.h"
+
+#define VRING_DEMO_PROC     (4)             /* 默认生产者进程数 */
+#define VRING_DEMO_PROC_MAX (64)            /* 最大生产者进程数 */
+#define VRING_DEMO_COUNT    (20000)         /* 默认每个进程的记录数 */
+#define VRING_DEMO_CAP      (1024)          /* 队列容量(可容纳的记录数) */
+#define VRING_DEMO_SMALL    (100)           /* 短记录长度 */
+#define VRING_DEMO_LARGE    (64 * KB)       /* 长记录长度 */
+#define VRING_DEMO_RATIO    (16)            /* 每RATIO条记录中有一条长记录 */
+#define VRING_DEMO_WAIT_SEC (5)             /* 超过该时间收不到记录则认为失败 */
+
+#define VRING_DEMO_KEY      "shm_vring_demo.key"
+#define VRING_DEMO_QKEY     "shm_queue_demo.key"
+
+/* 记录头(记录长度包含记录头) */
+typedef struct
+{
+    uint32_t proc;                          /* 生产者编号 */
+    uint32_t seq;                           /* 序列号 */
+    uint32_t len;                           /* 记录长度 */
+    uint32_t resv;                          /* 保留 */
+} vring_demo_head_t;
+
+/* 测试结果 */
+typedef struct
+{
+    long num;                               /* 收到的记录数 */
+    long errors;                            /* 校验失败的记录数 */
+    size_t peak;                            /* 队列的最大占用(vring: 字节; queue: 条数) */
+    double sec;                             /* 耗时(秒) */
+} vring_demo_stat_t;
+
+/* 第seq条记录的长度 */
+#define vring_demo_len(seq) \
+    ((VRING_DEMO_RATIO - 1 == (seq) % VRING_DEMO_RATIO)? VRING_DEMO_LARGE : VRING_DEMO_SMALL)
+
+/* 第idx个数据字节的取值 */
+#define vring_demo_byte(proc, seq, idx) ((uint8_t)((proc) * 131 + (seq) * 7 + (idx)))
+
+/* 填充记录 */
+static void vring_demo_fill(void *addr, int proc, int seq, int len)
+{
+    int idx;
+    uint8_t *data = (uint8_t *)addr;
+    vring_demo_head_t *head = (vring_demo_head_t *)addr;
+
+    head->proc = proc;
+    head->seq = seq;
+    head->len = len;
+    head->resv = 0;
+
+    for (idx=sizeof(vring_demo_head_t); idx<len; ++idx) {
+        data[idx] = vring_demo_byte(proc, seq, idx);
+    }
+}
+
+/******************************************************************************
+ **函数名称: vring_demo_check
+ **功    能: 校验记录
+ **输入参数:
+ **     addr: 记录地址
+ **     len: 队列给出的记录长度(shm_queue为0: 不校验)
+ **     procs: 生产者进程数
+ **     next: 各生产者下一条记录的序列号
+ **输出参数: NONE
+ **返    回: 0:成功 !0:失败
+ **实现描述: 同一生产者的记录按写入顺序到达, 序列号必须连续
+ **注意事项:
+ **作    者: # Qifeng.zou # 2015.06.14 #
+ ******************************************************************************/
+static int vring_demo_check(const void *addr, size_t len, int procs, int *next)
+{
+    uint32_t idx;
+    const uint8_t *data = (const uint8_t *)addr;
+    const vring_demo_head_t *head = (const vring_demo_head_t *)addr;
+
+    if ((head->proc >= (uint32_t)procs)
+        || (head->seq != (uint32_t)next[head->proc])
+        || (head->len != vring_demo_len(head->seq))
+        || (len && (len != head->len)))
+    {
+        fprintf(stderr, "Record error! proc:%u seq:%u len:%u/%zu\n",
+                head->proc, head->seq, head->len, len);
+        return -1;
+    }
+
+    ++next[head->proc];
+
+    for (idx=sizeof(vring_demo_head_t); idx<head->len; ++idx) {
+        if (data[idx] != vring_demo_byte(head->proc, head->seq, idx)) {
+            fprintf(stderr, "Data error! proc:%u seq:%u offset:%u\n",
+                    head->proc, head->seq, idx);
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/* 生产者进程(shm_vring) */
+static int vring_demo_vring_prod(shm_vring_t *vr, int proc, int count)
+{
+    int seq, len;
+    void *addr;
+
+    for (seq=0; seq<count; ++seq) {
+        len = vring_demo_len(seq);
+        while (NULL == (addr = shm_vring_reserve(vr, len))) {
+            sched_yield(); /* 队列已满 */
+        }
+
+        vring_demo_fill(addr, proc, seq, len);
+
+        shm_vring_commit(vr, addr);
+    }
+
+    return 0;
+}
+
+/* 生产者进程(shm_queue) */
+static int vring_demo_queue_prod(shm_queue_t *queue, int proc, int count)
+{
+    int seq, len;
+    void *addr;
+
+    for (seq=0; seq<count; ++seq) {
+        len = vring_demo_len(seq);
+        while (NULL == (addr = shm_queue_malloc(queue, len))) {
+            sched_yield(); /* 内存池已满 */
+        }
+
+        vring_demo_fill(addr, proc, seq, len);
+
+        while (shm_queue_push(queue, addr)) {
+            sched_yield();
+        }
+    }
+
+    return 0;
+}
+
+/* 消费者(shm_vring) */
+static void vring_demo_vring_cons(shm_vring_t *vr, int procs, long total, vring_demo_stat_t *stat)
+{
+    int wait = 0, next[VRING_DEMO_PROC_MAX] = {0};
+    void *addr;
+    size_t len, used;
+
+    while ((stat->num < total) && (wait < VRING_DEMO_WAIT_SEC)) {
+        used = shm_vring_used(vr);
+        stat->peak = MAX(stat->peak, used);
+
+        addr = shm_vring_peek_wait(vr, &len, 1000);
+        if (NULL == addr) {
+            ++wait;
+            continue;
+        }
+
+        wait = 0;
+        if (vring_demo_check(addr, len, procs, next)) {
+            ++stat->errors;
+        }
+        ++stat->num;
+
+        shm_vring_release(vr);
+    }
+}
+
+/* 消费者(shm_queue) */
+static void vring_demo_queue_cons(shm_queue_t *queue, int procs, long total, vring_demo_stat_t *stat)
+{
+    int wait = 0, next[VRING_DEMO_PROC_MAX] = {0};
+    void *addr;
+    size_t used;
+
+    while ((stat->num < total) && (wait < VRING_DEMO_WAIT_SEC)) {
+        used = shm_queue_used(queue);
+        stat->peak = MAX(stat->peak, used);
+
+        addr = shm_queue_pop_wait(queue, 1000);
+        if (NULL == addr) {
+            ++wait;
+            continue;
+        }
+
+        wait = 0;
+        if (vring_demo_check(addr, 0, procs, next)) {
+            ++stat->errors;
+        }
+        ++stat->num;
+
+        shm_queue_dealloc(queue, addr);
+    }
+}
+
+/******************************************************************************
+ **函数名称: vring_demo_run
+ **功    能: 执行一轮测试
+ **输入参数:
+ **     vr: 变长环形队列(NULL: 测试shm_queue)
+ **     queue: 共享内存队列
+ **     procs: 生产者进程数
+ **     count: 每个进程的记录数
+ **输出参数:
+ **     stat: 测试结果
+ **返    回: 0:成功 !0:失败
+ **实现描述: 先创建队列再fork生产者, 子进程继承共享内存的映射
+ **注意事项:
+ **作    者: # Qifeng.zou # 2015.06.14 #
+ ******************************************************************************/
+static int vring_demo_run(shm_vring_t *vr, shm_queue_t *queue,
+        int procs, int count, vring_demo_stat_t *stat)
+{
+    int idx, status, ret = 0;
+    pid_t pid[VRING_DEMO_PROC_MAX];
+    struct timeval stm, etm;
+
+    memset(stat, 0, sizeof(vring_demo_stat_t));
+
+    fflush(stdout); /* 避免子进程重复输出缓存中的内容 */
+
+    gettimeofday(&stm, NULL);
+
+    for (idx=0; idx<procs; ++idx) {
+        pid[idx] = fork();
+        if (pid[idx] < 0) {
+            fprintf(stderr, "Fork failed! errmsg:[%d] %s\n", errno, strerror(errno));
+            procs = idx;
+            ret = -1;
+            break;
+        }
+        else if (0 == pid[idx]) {
+            _exit((NULL != vr)? vring_demo_vring_prod(vr, idx, count)
+                    : vring_demo_queue_prod(queue, idx, count));
+        }
+    }
+
+    if (NULL != vr) {
+        vring_demo_vring_cons(vr, procs, (long)procs * count, stat);
+    }
+    else {
+        vring_demo_queue_cons(queue, procs, (long)procs * count, stat);
+    }
+
+    for (idx=0; idx<procs; ++idx) {
+        if ((waitpid(pid[idx], &status, 0) < 0)
+            || !WIFEXITED(status) || WEXITSTATUS(status))
+        {
+            ret = -1;
+        }
+    }
+
+    gettimeofday(&etm, NULL);
+
+    stat->sec = (etm.tv_sec - stm.tv_sec) + (etm.tv_usec - stm.tv_usec) / 1000000.0;
+
+    if ((stat->num != (long)procs * count) || stat->errors) {
+        ret = -1;
+    }
+
+    return ret;
+}
+
+int main(int argc, char *argv[])
+{
+    int procs, count, ret = 0;
+    size_t avg, vsize, vtotal, qtotal;
+    shm_vring_t *vr;
+    shm_queue_t *queue;
+    vring_demo_stat_t vstat, qstat;
+
+    procs = (argc > 1)? atoi(argv[1]) : VRING_DEMO_PROC;
+    count = (argc > 2)? atoi(argv[2]) : VRING_DEMO_COUNT;
+    procs = MIN(MAX(procs, 1), VRING_DEMO_PROC_MAX);
+    count = MAX(count, 1);
+
+    /* > 相同容量: 可容纳VRING_DEMO_CAP条记录 (vring按平均记录长度计算) */
+    avg = ((VRING_DEMO_RATIO - 1) * shm_vring_rec_size(VRING_DEMO_SMALL)
+            + shm_vring_rec_size(VRING_DEMO_LARGE)) / VRING_DEMO_RATIO;
+    vsize = MAX(VRING_DEMO_CAP * avg, 2 * shm_vring_rec_size(VRING_DEMO_LARGE));
+
+    vr = shm_vring_creat(VRING_DEMO_KEY, vsize);
+    if (NULL == vr) {
+        fprintf(stderr, "Create shm-vring failed! errmsg:[%d] %s\n", errno, strerror(errno));
+        return -1;
+    }
+    vtotal = shm_vring_total(vsize);
+
+    queue = shm_queue_creat(VRING_DEMO_QKEY, VRING_DEMO_CAP, VRING_DEMO_LARGE);
+    if (NULL == queue) {
+        fprintf(stderr, "Create shm-queue failed! errmsg:[%d] %s\n", errno, strerror(errno));
+        return -1;
+    }
+    qtotal = shm_ring_total(VRING_DEMO_CAP) + shm_slot_total(VRING_DEMO_CAP, VRING_DEMO_LARGE);
+
+    fprintf(stdout, "procs:%d count:%d records:%dB/%dB(1/%d) capacity:%d\n",
+            procs, count, VRING_DEMO_SMALL, VRING_DEMO_LARGE, VRING_DEMO_RATIO, VRING_DEMO_CAP);
+
+    /* > 变长环形队列 */
+    if (vring_demo_run(vr, NULL, procs, count, &vstat)) {
+        ret = -1;
+    }
+    fprintf(stdout, "shm_vring: segment:%10zu bytes peak:%10zu bytes %8.2f s recv:%ld errors:%ld\n",
+            vtotal, vstat.peak, vstat.sec, vstat.num, vstat.errors);
+
+    /* > 定长共享内存队列 */
+    if (vring_demo_run(NULL, queue, procs, count, &qstat)) {
+        ret = -1;
+    }
+    fprintf(stdout, "shm_queue: segment:%10zu bytes peak:%10zu recs  %8.2f s recv:%ld errors:%ld\n",
+            qtotal, qstat.peak, qstat.sec, qstat.num, qstat.errors);
+
+    fprintf(stdout, "segment ratio(queue/vring): %.1f\n", (double)qtotal / vtotal);
+
+    if (ret) {
+        fprintf(stderr, "Verify failed!\n");
+    }
+
+    return ret;
+}
@@ -0,0 +1,219 @@
+/******************************************************************************
+ ** Coypright(C) 2014-2024 Qiware technology Co., Ltd
+ **
+ ** 文件名: slab_bench.c
+ ** 版本号: 1.0
+ ** 描  述: 多线程内存申请/释放性能测试
+ **         对比SLAB(线程缓存/无缓存)、共享内存SLAB(每CPU缓存)、glibc malloc
+ **         以及jemalloc(开启CONFIG_JEMALLOC_SUPPORT时)在1~N个线程下的吞吐量.
+ **         每个线程维持SLAB_BENCH_LIVE个存活块, 每次释放最早的块并申请一个
+ **         随机大小(8~1024字节)的新块; 结束后存活块由主线程释放(跨线程释放).
+ **         用法: slab_bench [count] [threads]
+ ** 作  者: # Qifeng.zou # 2015.08.24 #
+ ******************************************************************************/
+#include "comm.h"
+#include "slab.h"
+#include "shm_slab.h"
+
+#define SLAB_BENCH_COUNT    (2000000)       /* 默认每个线程的申请次数 */
+#define SLAB_BENCH_THREADS  (8)             /* 默认最大线程数 */
+#define SLAB_BENCH_LIVE     (256)           /* 每个线程存活的块数 */
+#define SLAB_BENCH_MAX_SIZE (1024)          /* 最大申请尺寸 */
+#define SLAB_BENCH_POOL     (256 * MB)      /* 内存池大小 */
+
+/* 绕过malloc替换(链接jemalloc时), 直接调用glibc */
+extern void *__libc_malloc(size_t size);
+extern void __libc_free(void *p);
+
+/* 内存分配器 */
+typedef struct
+{
+    const char *name;                       /* 名称 */
+    void *(*alloc)(void *pool, size_t size);/* 申请 */
+    void (*dealloc)(void *pool, void *p);   /* 释放 */
+    void *pool;                             /* 内存池 */
+} slab_bench_alloc_t;
+
+/* 线程参数 */
+typedef struct
+{
+    int idx;                                /* 线程序号 */
+    long count;                             /* 申请次数 */
+    slab_bench_alloc_t *alloc;              /* 内存分配器 */
+    pthread_barrier_t *barrier;             /* 同时开始 */
+    void *live[SLAB_BENCH_LIVE];            /* 存活的块 */
+} slab_bench_args_t;
+
+static void *slab_bench_slab_alloc(void *pool, size_t size) { return slab_alloc((slab_pool_t *)pool, size); }
+static void slab_bench_slab_dealloc(void *pool, void *p) { slab_dealloc((slab_pool_t *)pool, p); }
+static void *slab_bench_shm_alloc(void *pool, size_t size) { return shm_slab_alloc((shm_slab_pool_t *)pool, size); }
+static void slab_bench_shm_dealloc(void *pool, void *p) { shm_slab_dealloc((shm_slab_pool_t *)pool, p); }
+static void *slab_bench_libc_alloc(void *pool, size_t size) { return __libc_malloc(size); }
+static void slab_bench_libc_dealloc(void *pool, void *p) { __libc_free(p); }
+#if defined(__JEMALLOC_SUPPORT__)
+static void *slab_bench_je_alloc(void *pool, size_t size) { return mallocx(size, 0); }
+static void slab_bench_je_dealloc(void *pool, void *p) { dallocx(p, 0); }
+#endif /*__JEMALLOC_SUPPORT__*/
+
+/* 工作线程 */
+static void *slab_bench_routine(void *_args)
+{
+    long n;
+    int idx;
+    size_t size;
+    unsigned int seed;
+    slab_bench_args_t *args = (slab_bench_args_t *)_args;
+    slab_bench_alloc_t *alloc = args->alloc;
+
+    seed = args->idx + 1;
+
+    pthread_barrier_wait(args->barrier);
+
+    for (n=0; n<args->count; ++n) {
+        idx = n % SLAB_BENCH_LIVE;
+        if (NULL != args->live[idx]) {
+            alloc->dealloc(alloc->pool, args->live[idx]);
+        }
+
+        size = 8 + rand_r(&seed) % SLAB_BENCH_MAX_SIZE;
+        args->live[idx] = alloc->alloc(alloc->pool, size);
+        if (NULL == args->live[idx]) {
+            fprintf(stderr, "%s: alloc failed! size:%lu\n", alloc->name, size);
+            break;
+        }
+        *(char *)args->live[idx] = (char)n;
+    }
+
+    pthread_barrier_wait(args->barrier);
+
+    return NULL;
+}
+
+/* 执行测试 */
+static int slab_bench_run(slab_bench_alloc_t *alloc, int num, long count)
+{
+    int i, k;
+    double sec;
+    pthread_t tid[num];
+    slab_bench_args_t *args;
+    pthread_barrier_t barrier;
+    struct timeval stm, etm;
+
+    args = (slab_bench_args_t *)calloc(num, sizeof(slab_bench_args_t));
+    if (NULL == args) {
+        return -1;
+    }
+
+    pthread_barrier_init(&barrier, NULL, num + 1);
+
+    for (i=0; i<num; ++i) {
+        args[i].idx = i;
+        args[i].count = count;
+        args[i].alloc = alloc;
+        args[i].barrier = &barrier;
+        if (pthread_create(&tid[i], NULL, slab_bench_routine, &args[i])) {
+            fprintf(stderr, "Create thread failed! errmsg:[%d] %s\n", errno, strerror(errno));
+            exit(-1);
+        }
+    }
+
+    pthread_barrier_wait(&barrier);
+    gettimeofday(&stm, NULL);
+    pthread_barrier_wait(&barrier);
+    gettimeofday(&etm, NULL);
+
+    for (i=0; i<num; ++i) {
+        pthread_join(tid[i], NULL);
+    }
+
+    sec = (etm.tv_sec - stm.tv_sec) + (etm.tv_usec - stm.tv_usec) / 1000000.0;
+
+    fprintf(stdout, "%-10s threads:%-3d %8.2f Mops/s %8.1f ns/op\n", alloc->name, num,
+            num * count / sec / 1000000, sec * 1000000000 / count);
+
+    /* > 由主线程释放存活块 */
+    for (i=0; i<num; ++i) {
+        for (k=0; k<SLAB_BENCH_LIVE; ++k) {
+            if (NULL != args[i].live[k]) {
+                alloc->dealloc(alloc->pool, args[i].live[k]);
+            }
+        }
+    }
+
+    pthread_barrier_destroy(&barrier);
+    free(args);
+
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    long count;
+    void *addr;
+    int i, k, num, max;
+    slab_pool_t *slab, *slab_nc;
+    shm_slab_pool_t *shm;
+    slab_bench_alloc_t alloc[5];
+
+    count = (argc > 1)? atol(argv[1]) : SLAB_BENCH_COUNT;
+    max = (argc > 2)? atoi(argv[2]) : SLAB_BENCH_THREADS;
+    max = MAX(max, 1);
+
+    /* > 创建内存池 */
+    slab = slab_creat_by_calloc(SLAB_BENCH_POOL, NULL);     /* 启用线程缓存 */
+    addr = calloc(1, SLAB_BENCH_POOL);
+    slab_nc = (NULL != addr)? slab_init(addr, SLAB_BENCH_POOL, NULL) : NULL; /* 不启用缓存 */
+    shm = (shm_slab_pool_t *)calloc(1, SLAB_BENCH_POOL);
+    if (NULL == slab || NULL == slab_nc || NULL == shm) {
+        fprintf(stderr, "Create slab failed!\n");
+        return -1;
+    }
+
+    shm->pool_size = SLAB_BENCH_POOL;
+    if (shm_slab_init(shm)) {
+        fprintf(stderr, "Init shm slab failed!\n");
+        return -1;
+    }
+
+    num = 0;
+    alloc[num].name = "slab";
+    alloc[num].alloc = slab_bench_slab_alloc;
+    alloc[num].dealloc = slab_bench_slab_dealloc;
+    alloc[num++].pool = slab;
+    alloc[num].name = "slab-lock";
+    alloc[num].alloc = slab_bench_slab_alloc;
+    alloc[num].dealloc = slab_bench_slab_dealloc;
+    alloc[num++].pool = slab_nc;
+    alloc[num].name = "shm_slab";
+    alloc[num].alloc = slab_bench_shm_alloc;
+    alloc[num].dealloc = slab_bench_shm_dealloc;
+    alloc[num++].pool = shm;
+    alloc[num].name = "glibc";
+    alloc[num].alloc = slab_bench_libc_alloc;
+    alloc[num].dealloc = slab_bench_libc_dealloc;
+    alloc[num++].pool = NULL;
+#if defined(__JEMALLOC_SUPPORT__)
+    alloc[num].name = "jemalloc";
+    alloc[num].alloc = slab_bench_je_alloc;
+    alloc[num].dealloc = slab_bench_je_dealloc;
+    alloc[num++].pool = NULL;
+#endif /*__JEMALLOC_SUPPORT__*/
+
+    /* > 1, 2, 4, ... max个线程 */
+    for (i=1; ; i <<= 1) {
+        i = MIN(i, max);
+        for (k=0; k<num; ++k) {
+            slab_bench_run(&alloc[k], i, count);
+        }
+        if (i == max) {
+            break;
+        }
+        fprintf(stdout, "\n");
+    }
+
+    slab_destroy(slab);
+    slab_destroy(slab_nc);
+    free(shm);
+
+    return 0;
+}
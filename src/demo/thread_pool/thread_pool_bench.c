@@ -0,0 +1,381 @@
+/******************************************************************************
+ ** Coypright(C) 2014-2024 Qiware technology Co., Ltd
+ **
+ ** 文件名: thread_pool_bench.c
+ ** 版本号: 1.0
+ ** 描  述: 线程池短任务吞吐量测试
+ **         对比工作窃取线程池(thread_pool_t)与原有实现(单链表+互斥锁+条件变量,
+ **         此处保留一份作为基准)在1~N个线程下的吞吐量:
+ **         1. 外部提交: 主线程提交空任务;
+ **         2. 内部派生: 每个根任务在池内派生THREAD_POOL_BENCH_FANOUT个子任务.
+ **         两种方式下未完成的任务均不超过THREAD_POOL_BENCH_WINDOW个(原有实现
+ **         追加任务需遍历链表, 积压过多时耗时与积压数成正比).
+ **         3. 突发唤醒: 全部线程休眠后一次提交与线程数相同的阻塞任务, 各任务应由
+ **            不同线程并行执行, 耗时应接近单个任务的耗时.
+ **         用法: thread_pool_bench [count] [threads]
+ ** 作  者: # Qifeng.zou # 2015.09.08 #
+ ******************************************************************************/
+#include "comm.h"
+#include "atomic.h"
+#include "thread_pool.h"
+
+#define THREAD_POOL_BENCH_COUNT     (1000000)   /* 默认任务数 */
+#define THREAD_POOL_BENCH_THREADS   (8)         /* 默认最大线程数 */
+#define THREAD_POOL_BENCH_WINDOW    (1024)      /* 外部提交时最多未完成的任务数 */
+#define THREAD_POOL_BENCH_FANOUT    (64)        /* 每个根任务派生的子任务数 */
+#define THREAD_POOL_BENCH_BURST_THREADS (4)     /* 突发唤醒: 线程数(即每轮任务数) */
+#define THREAD_POOL_BENCH_BURST_ROUND   (10)    /* 突发唤醒: 轮数 */
+#define THREAD_POOL_BENCH_BURST_MSEC    (200)   /* 突发唤醒: 每个任务的阻塞时间(ms) */
+
+/* 原有线程池(基准) */
+typedef struct
+{
+    pthread_mutex_t queue_lock;     /* 队列互斥锁 */
+    pthread_cond_t queue_ready;     /* 队列临界锁 */
+    thread_worker_t *head;          /* 队列头 */
+    int queue_size;                 /* 工作队列当前大小 */
+    int shutdown;                   /* 是否已销毁线程 */
+} legacy_pool_t;
+
+/* 测试对象 */
+typedef struct
+{
+    const char *name;               /* 名称 */
+    void *pool;                     /* 线程池 */
+    int (*add)(void *pool, void *(*process)(void *arg), void *arg);
+} thread_pool_bench_t;
+
+static thread_pool_bench_t *g_bench;    /* 当前测试对象 */
+static volatile uint64_t g_done;        /* 已完成任务数 */
+
+static void *legacy_routine(void *_pool)
+{
+    thread_worker_t *worker;
+    legacy_pool_t *pool = (legacy_pool_t *)_pool;
+
+    while (1) {
+        pthread_mutex_lock(&pool->queue_lock);
+        while ((0 == pool->shutdown) && (0 == pool->queue_size)) {
+            pthread_cond_wait(&pool->queue_ready, &pool->queue_lock);
+        }
+
+        if (0 != pool->shutdown) {
+            pthread_mutex_unlock(&pool->queue_lock);
+            return NULL;
+        }
+
+        pool->queue_size--;
+        worker = pool->head;
+        pool->head = worker->next;
+        pthread_mutex_unlock(&pool->queue_lock);
+
+        (*(worker->process))(worker->arg);
+
+        pthread_mutex_lock(&pool->queue_lock);
+        free(worker);
+        pthread_mutex_unlock(&pool->queue_lock);
+    }
+
+    return NULL;
+}
+
+static int legacy_add(void *_pool, void *(*process)(void *arg), void *arg)
+{
+    thread_worker_t *worker, *member;
+    legacy_pool_t *pool = (legacy_pool_t *)_pool;
+
+    worker = (thread_worker_t *)malloc(sizeof(thread_worker_t));
+    if (NULL == worker) {
+        return -1;
+    }
+
+    worker->process = process;
+    worker->arg = arg;
+    worker->next = NULL;
+
+    pthread_mutex_lock(&pool->queue_lock);
+    member = pool->head;
+    if (NULL != member) {
+        while (NULL != member->next) {
+            member = member->next;
+        }
+        member->next = worker;
+    } else {
+        pool->head = worker;
+    }
+    pool->queue_size++;
+    pthread_mutex_unlock(&pool->queue_lock);
+
+    pthread_cond_signal(&pool->queue_ready);
+
+    return 0;
+}
+
+static legacy_pool_t *legacy_init(int num, pthread_t *tid)
+{
+    int idx;
+    legacy_pool_t *pool;
+
+    pool = (legacy_pool_t *)calloc(1, sizeof(legacy_pool_t));
+    if (NULL == pool) {
+        return NULL;
+    }
+
+    pthread_mutex_init(&pool->queue_lock, NULL);
+    pthread_cond_init(&pool->queue_ready, NULL);
+
+    for (idx=0; idx<num; ++idx) {
+        pthread_create(&tid[idx], NULL, legacy_routine, pool);
+    }
+
+    return pool;
+}
+
+static void legacy_destroy(legacy_pool_t *pool, int num, pthread_t *tid)
+{
+    int idx;
+
+    pthread_mutex_lock(&pool->queue_lock);
+    pool->shutdown = 1;
+    pthread_mutex_unlock(&pool->queue_lock);
+    pthread_cond_broadcast(&pool->queue_ready);
+
+    for (idx=0; idx<num; ++idx) {
+        pthread_join(tid[idx], NULL);
+    }
+
+    pthread_mutex_destroy(&pool->queue_lock);
+    pthread_cond_destroy(&pool->queue_ready);
+    free(pool);
+}
+
+static int steal_add(void *pool, void *(*process)(void *arg), void *arg)
+{
+    return thread_pool_add_worker((thread_pool_t *)pool, process, arg);
+}
+
+/* 空任务 */
+static void *thread_pool_bench_nop(void *arg)
+{
+    atomic64_inc(&g_done);
+    return NULL;
+}
+
+/* 阻塞任务 */
+static void *thread_pool_bench_block(void *arg)
+{
+    usleep(THREAD_POOL_BENCH_BURST_MSEC * 1000);
+    atomic64_inc(&g_done);
+    return NULL;
+}
+
+/* 根任务: 在池内派生子任务 */
+static void *thread_pool_bench_fork(void *arg)
+{
+    int idx;
+
+    for (idx=0; idx<THREAD_POOL_BENCH_FANOUT; ++idx) {
+        while (g_bench->add(g_bench->pool, thread_pool_bench_nop, NULL)) {
+            sched_yield();
+        }
+    }
+
+    return NULL;
+}
+
+static double thread_pool_bench_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* 等待全部任务完成 */
+static void thread_pool_bench_wait(uint64_t total)
+{
+    while (g_done < total) {
+        sched_yield();
+    }
+}
+
+/* 外部提交 */
+static double thread_pool_bench_submit(thread_pool_bench_t *bench, long count)
+{
+    long idx;
+    double begin;
+
+    g_done = 0;
+    begin = thread_pool_bench_now();
+
+    for (idx=0; idx<count; ++idx) {
+        while ((uint64_t)idx - g_done >= THREAD_POOL_BENCH_WINDOW) {
+            sched_yield();
+        }
+        while (bench->add(bench->pool, thread_pool_bench_nop, NULL)) {
+            sched_yield();
+        }
+    }
+
+    thread_pool_bench_wait(count);
+
+    return count / (thread_pool_bench_now() - begin) / 1e6;
+}
+
+/* 内部派生 */
+static double thread_pool_bench_spawn(thread_pool_bench_t *bench, long count)
+{
+    long idx, root = count / THREAD_POOL_BENCH_FANOUT;
+    double begin;
+
+    g_done = 0;
+    begin = thread_pool_bench_now();
+
+    for (idx=0; idx<root; ++idx) {
+        while ((uint64_t)idx * THREAD_POOL_BENCH_FANOUT - g_done >= THREAD_POOL_BENCH_WINDOW) {
+            sched_yield();
+        }
+        while (bench->add(bench->pool, thread_pool_bench_fork, NULL)) {
+            sched_yield();
+        }
+    }
+
+    thread_pool_bench_wait(root * THREAD_POOL_BENCH_FANOUT);
+
+    return root * THREAD_POOL_BENCH_FANOUT / (thread_pool_bench_now() - begin) / 1e6;
+}
+
+/******************************************************************************
+ **函数名称: thread_pool_bench_burst
+ **功    能: 突发唤醒测试
+ **输入参数:
+ **     bench: 测试对象(线程数为THREAD_POOL_BENCH_BURST_THREADS)
+ **输出参数:
+ **     slow: 耗时超过1.5倍任务阻塞时间的轮数
+ **返    回: 最大耗时(ms)
+ **实现描述: 每轮先等待线程全部进入休眠, 再连续提交与线程数相同的阻塞任务
+ **注意事项: 只唤醒一个线程时, 其余任务要等该线程执行完才被处理, 耗时成倍增加
+ **作    者: # Qifeng.zou # 2015.09.28 #
+ ******************************************************************************/
+static double thread_pool_bench_burst(thread_pool_bench_t *bench, int *slow)
+{
+    int idx, round;
+    double begin, cost, max = 0;
+
+    *slow = 0;
+    for (round=0; round<THREAD_POOL_BENCH_BURST_ROUND; ++round) {
+        usleep(50000); /* 等待线程休眠 */
+
+        g_done = 0;
+        begin = thread_pool_bench_now();
+
+        for (idx=0; idx<THREAD_POOL_BENCH_BURST_THREADS; ++idx) {
+            while (bench->add(bench->pool, thread_pool_bench_block, NULL)) {
+                sched_yield();
+            }
+        }
+
+        thread_pool_bench_wait(THREAD_POOL_BENCH_BURST_THREADS);
+
+        cost = (thread_pool_bench_now() - begin) * 1000;
+        if (cost > THREAD_POOL_BENCH_BURST_MSEC * 1.5) {
+            ++(*slow);
+        }
+        max = MAX(max, cost);
+    }
+
+    return max;
+}
+
+int main(int argc, char *argv[])
+{
+    int num, max, slow;
+    long count;
+    double submit, spawn, cost;
+    pthread_t tid[256];
+    legacy_pool_t *legacy;
+    thread_pool_t *tpool;
+    thread_pool_bench_t bench;
+
+    count = (argc > 1)? atol(argv[1]) : THREAD_POOL_BENCH_COUNT;
+    max = (argc > 2)? atoi(argv[2]) : THREAD_POOL_BENCH_THREADS;
+    if (count <= 0 || max <= 0 || max > 256) {
+        fprintf(stderr, "usage: %s [count] [threads(1~256)]\n", argv[0]);
+        return -1;
+    }
+
+    g_bench = &bench;
+
+    fprintf(stderr, "%-8s %-10s %14s %14s\n", "threads", "pool", "submit(Mops/s)", "spawn(Mops/s)");
+
+    for (num=1; num<=max; num <<= 1) {
+        /* > 原有实现 */
+        legacy = legacy_init(num, tid);
+        if (NULL == legacy) {
+            return -1;
+        }
+
+        bench.name = "legacy";
+        bench.pool = legacy;
+        bench.add = legacy_add;
+
+        submit = thread_pool_bench_submit(&bench, count);
+        spawn = thread_pool_bench_spawn(&bench, count);
+        fprintf(stderr, "%-8d %-10s %14.2f %14.2f\n", num, bench.name, submit, spawn);
+
+        legacy_destroy(legacy, num, tid);
+
+        /* > 工作窃取 */
+        tpool = thread_pool_init(num, NULL, NULL);
+        if (NULL == tpool) {
+            return -1;
+        }
+
+        bench.name = "stealing";
+        bench.pool = tpool;
+        bench.add = steal_add;
+
+        submit = thread_pool_bench_submit(&bench, count);
+        spawn = thread_pool_bench_spawn(&bench, count);
+        fprintf(stderr, "%-8d %-10s %14.2f %14.2f\n", num, bench.name, submit, spawn);
+
+        thread_pool_destroy(tpool);
+    }
+
+    /* > 突发唤醒 */
+    fprintf(stderr, "\nburst: %d threads, %d x %dms blocking tasks per round, %d rounds\n",
+            THREAD_POOL_BENCH_BURST_THREADS, THREAD_POOL_BENCH_BURST_THREADS,
+            THREAD_POOL_BENCH_BURST_MSEC, THREAD_POOL_BENCH_BURST_ROUND);
+    fprintf(stderr, "%-10s %12s %12s\n", "pool", "max(ms)", "slow rounds");
+
+    legacy = legacy_init(THREAD_POOL_BENCH_BURST_THREADS, tid);
+    if (NULL == legacy) {
+        return -1;
+    }
+
+    bench.name = "legacy";
+    bench.pool = legacy;
+    bench.add = legacy_add;
+
+    cost = thread_pool_bench_burst(&bench, &slow);
+    fprintf(stderr, "%-10s %12.1f %12d\n", bench.name, cost, slow);
+
+    legacy_destroy(legacy, THREAD_POOL_BENCH_BURST_THREADS, tid);
+
+    tpool = thread_pool_init(THREAD_POOL_BENCH_BURST_THREADS, NULL, NULL);
+    if (NULL == tpool) {
+        return -1;
+    }
+
+    bench.name = "stealing";
+    bench.pool = tpool;
+    bench.add = steal_add;
+
+    cost = thread_pool_bench_burst(&bench, &slow);
+    fprintf(stderr, "%-10s %12.1f %12d\n", bench.name, cost, slow);
+
+    thread_pool_destroy(tpool);
+
+    return 0;
+}
@@ -3,24 +3,42 @@
  **
  ** 文件名: timer_test.c
  ** 版本号: 1.0
- ** 描  述: 
+ ** 描  述: 定时器的测试代码
+ **         1. 定时任务: 由timer_task_routine()线程驱动, 毫秒级精度;
+ **         2. 时间轮: 将timerfd加入epoll, 在事件循环中直接处理定时器.
  ** 作  者: # Qifeng.zou # 2016年01月08日 星期五 09时02分24秒 #
  ******************************************************************************/
 #include "comm.h"
 #include "timer.h"
+#include "timer_wheel.h"
+
+static timer_wheel_t *g_wheel;
 
 void proc(void *idx)
 {
-    time_t ctm = time(NULL);
-    fprintf(stderr, "%s: tm:%lu idx:%lu\n", __func__, ctm, (uint64_t)idx);
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+    fprintf(stderr, "%s: tm:%lu.%03lu idx:%lu\n", __func__,
+            tv.tv_sec, tv.tv_usec / 1000, (uint64_t)idx);
+}
+
+void wheel_proc(void *idx)
+{
+    fprintf(stderr, "%s: elapsed:%luus idx:%lu\n", __func__,
+            timer_wheel_now(g_wheel), (uint64_t)idx);
 }
 
 int main(void)
 {
-    int idx;
+    int idx, epid;
+    pthread_t tid;
     timer_cntx_t *timer;
-    timer_task_t task[10];
+    timer_task_t *task[10];
+    struct epoll_event ev;
+    timer_wheel_node_t node[10];
 
+    /* > 定时任务(独立线程) */
     timer = timer_cntx_init();
     if (NULL == timer) {
         fprintf(stderr, "Initialize timer context failed!");
@@ -28,21 +46,39 @@ int main(void)
     }
 
     for (idx=0; idx<10; idx+=1) {
-        timer_task_init(&task[idx], proc, 1, 2, (void *)((uint64_t)idx));
-
-        timer_task_add(timer, &task[idx]);
+        task[idx] = timer_task_init_ms(100 * idx, 500);
+        timer_task_add(task[idx], proc, (void *)((uint64_t)idx));
+        timer_task_start(timer, task[idx]);
     }
 
     for (idx=3; idx<5; idx+=1) {
-        timer_task_del(timer, &task[idx]);
+        timer_task_stop(timer, task[idx]);
+    }
+
+    pthread_create(&tid, NULL, timer_task_routine, (void *)timer);
+
+    /* > 时间轮(嵌入事件循环) */
+    g_wheel = timer_wheel_creat(TIMER_WHEEL_TICK_US);
+    if (NULL == g_wheel) {
+        fprintf(stderr, "Create timer wheel failed!");
+        return -1;
     }
 
-    for (idx=5; idx<7; idx+=1) {
-        timer_task_update(&task[idx], proc, 2, 5, (void *)((uint64_t)idx));
+    for (idx=0; idx<10; idx+=1) {
+        timer_wheel_node_init(&node[idx], wheel_proc, (void *)((uint64_t)idx));
+        timer_wheel_add(g_wheel, &node[idx], 150000 * idx, (idx & 1)? 1000000 : 0);
     }
 
-    timer_task_routine((void *)timer);
+    epid = epoll_create1(EPOLL_CLOEXEC);
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    epoll_ctl(epid, EPOLL_CTL_ADD, timer_wheel_fd(g_wheel), &ev);
+
+    for (;;) {
+        if (epoll_wait(epid, &ev, 1, -1) > 0) {
+            timer_wheel_expire(g_wheel);
+        }
+    }
 
     return 0;
 }
-
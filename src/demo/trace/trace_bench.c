@@ -0,0 +1,183 @@
+/******************************************************************************
+ ** Coypright(C) 2014-2024 Qiware technology Co., Ltd
+ **
+ ** 文件名: trace_bench.c
+ ** 版本号: 1.0
+ ** 描  述: 热点路径跟踪(trace)的开销测试
+ **         两个线程经sig_queue传递消息(接收线程: READ/PUSH, 处理线程:
+ **         DISPATCH/DONE), 交替测试关闭跟踪与按1/rate抽样两种情况的耗时.
+ **         结束后生成的跟踪文件可由tools/trace_export.py转换为JSON:
+ **             tools/trace_export.py trace_bench.trace > trace.json
+ **         用法: trace_bench [消息数] [抽样比例] [跟踪文件]
+ ** 作  者: # Qifeng.zou # 2015.09.30 #
+ ******************************************************************************/
+#include "comm.h"
+#include "trace.h"
+#include "sig_queue.h"
+
+#define TRACE_BENCH_COUNT   (2000000)       /* 默认消息数 */
+#define TRACE_BENCH_RATE    (100)           /* 默认抽样比例 */
+#define TRACE_BENCH_REPEAT  (3)             /* 重复次数 */
+#define TRACE_BENCH_QLEN    (4096)          /* 队列长度 */
+#define TRACE_BENCH_WORK    (50)            /* 处理线程的模拟计算量 */
+#define TRACE_BENCH_PATH    "trace_bench.trace"
+
+/* 处理阶段 */
+typedef enum
+{
+    TRACE_BENCH_READ                        /* 接收 */
+    , TRACE_BENCH_PUSH                      /* 放入队列 */
+    , TRACE_BENCH_DISPATCH                  /* 取出队列 */
+    , TRACE_BENCH_DONE                      /* 处理完成 */
+} trace_bench_stage_e;
+
+/* 消息 */
+typedef struct
+{
+    uint64_t trace_id;                      /* 跟踪ID(0:不跟踪) */
+    uint32_t type;                          /* 消息类型 */
+    uint32_t seq;                           /* 序列号 */
+} trace_bench_msg_t;
+
+/* 测试参数 */
+typedef struct
+{
+    sig_queue_t *sq;                        /* 队列 */
+    long count;                             /* 消息数 */
+    volatile uint64_t sum;                  /* 校验和(防止计算被优化) */
+} trace_bench_t;
+
+/* 处理线程 */
+static void *trace_bench_cons(void *_args)
+{
+    int k;
+    long idx;
+    uint64_t sum = 0;
+    trace_bench_msg_t *msg;
+    trace_bench_t *args = (trace_bench_t *)_args;
+
+    for (idx=0; idx<args->count; ++idx) {
+        msg = (trace_bench_msg_t *)sig_queue_pop(args->sq);
+        trace_event(msg->trace_id, TRACE_BENCH_DISPATCH, msg->type);
+
+        for (k=0; k<TRACE_BENCH_WORK; ++k) {
+            sum += msg->seq ^ k;
+        }
+
+        trace_event(msg->trace_id, TRACE_BENCH_DONE, msg->type);
+        sig_queue_dealloc(args->sq, msg);
+    }
+
+    args->sum = sum;
+
+    return NULL;
+}
+
+/******************************************************************************
+ **函数名称: trace_bench_run
+ **功    能: 执行一轮测试
+ **输入参数:
+ **     args: 测试参数
+ **     rate: 抽样比例(0:关闭跟踪)
+ **输出参数: NONE
+ **返    回: 耗时(毫秒) (<0:失败)
+ **实现描述: 当前线程作为接收线程, 只对被抽样的消息读取TSC, 与rtmq一致
+ **注意事项:
+ **作    者: # Qifeng.zou # 2015.09.30 #
+ ******************************************************************************/
+static double trace_bench_run(trace_bench_t *args, int rate)
+{
+    long idx;
+    pthread_t tid;
+    uint64_t tsc;
+    struct timeval stm, etm;
+    trace_bench_msg_t *msg;
+
+    trace_init(NULL, rate); /* 已启用: 只修改抽样比例 */
+
+    gettimeofday(&stm, NULL);
+
+    if (pthread_create(&tid, NULL, trace_bench_cons, args)) {
+        fprintf(stderr, "Create thread failed! errmsg:[%d] %s\n", errno, strerror(errno));
+        return -1;
+    }
+
+    for (idx=0; idx<args->count; ++idx) {
+        while (NULL == (msg = sig_queue_malloc(args->sq, sizeof(trace_bench_msg_t)))) {
+            sched_yield();
+        }
+
+        msg->type = idx & 0x7;
+        msg->seq = idx;
+        msg->trace_id = trace_sample();
+        if (msg->trace_id) {
+            tsc = cpu_ticket_get();
+            trace_record(msg->trace_id, TRACE_BENCH_READ, msg->type, tsc);
+            trace_event(msg->trace_id, TRACE_BENCH_PUSH, msg->type);
+        }
+
+        sig_queue_push(args->sq, msg);
+    }
+
+    pthread_join(tid, NULL);
+
+    gettimeofday(&etm, NULL);
+
+    return (etm.tv_sec - stm.tv_sec) * 1000.0 + (etm.tv_usec - stm.tv_usec) / 1000.0;
+}
+
+int main(int argc, char *argv[])
+{
+    int idx, rate;
+    double off, on, off_sum = 0, on_sum = 0;
+    const char *path;
+    trace_bench_t args;
+
+    memset(&args, 0, sizeof(args));
+
+    args.count = (argc > 1)? atol(argv[1]) : TRACE_BENCH_COUNT;
+    rate = (argc > 2)? atoi(argv[2]) : TRACE_BENCH_RATE;
+    path = (argc > 3)? argv[3] : TRACE_BENCH_PATH;
+    args.count = MAX(args.count, 1);
+    rate = MAX(rate, 1);
+
+    args.sq = sig_queue_creat(TRACE_BENCH_QLEN, sizeof(trace_bench_msg_t));
+    if (NULL == args.sq) {
+        fprintf(stderr, "Create queue failed!\n");
+        return -1;
+    }
+
+    /* > 启用跟踪(先不抽样) */
+    if (trace_init(path, 0)) {
+        fprintf(stderr, "Init trace failed! path:%s errmsg:[%d] %s\n", path, errno, strerror(errno));
+        return -1;
+    }
+
+    trace_stage(TRACE_BENCH_READ, "read");
+    trace_stage(TRACE_BENCH_PUSH, "push");
+    trace_stage(TRACE_BENCH_DISPATCH, "dispatch");
+    trace_stage(TRACE_BENCH_DONE, "done");
+
+    /* > 交替测试, 减少机器状态变化的影响 */
+    fprintf(stdout, "messages:%ld rate:1/%d\n", args.count, rate);
+    for (idx=0; idx<TRACE_BENCH_REPEAT; ++idx) {
+        off = trace_bench_run(&args, 0);
+        on = trace_bench_run(&args, rate);
+        if ((off < 0) || (on < 0)) {
+            return -1;
+        }
+        off_sum += off;
+        on_sum += on;
+        fprintf(stdout, "round:%d off:%8.1f ms (%6.1f ns/msg)  1/%d:%8.1f ms (%6.1f ns/msg)\n",
+                idx, off, off * 1e6 / args.count, rate, on, on * 1e6 / args.count);
+    }
+
+    fprintf(stdout, "overhead: %+.2f%%\n", (on_sum - off_sum) * 100.0 / off_sum);
+
+    /* > 写入剩余事件(文件头保留最后一轮的抽样比例) */
+    trace_sync();
+
+    fprintf(stdout, "run: tools/trace_export.py %s > trace.json\n", path);
+
+    return 0;
+}
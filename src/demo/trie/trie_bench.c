@@ -0,0 +1,175 @@
+/******************************************************************************
+ ** Coypright(C) 2014-2024 Qiware technology Co., Ltd
+ **
+ ** 文件名: trie_bench.c
+ ** 版本号: 1.0
+ ** 描  述: 键树性能测试
+ **         1. 生成URL形式的主键(公共前缀长、分叉多), 测试插入/查询/最长前缀匹配
+ **            的平均耗时
+ **         2. 统计每个键占用的内存, 并估算原256路键树所需的内存(每个有后续的
+ **            前缀都要申请256个结点)
+ **         用法: trie_bench [键个数]
+ ** 作  者: # Qifeng.zou # 2015.08.05 #
+ ******************************************************************************/
+#include "comm.h"
+#include "trie.h"
+
+#define BENCH_KEY_NUM       (1000000)   /* 默认键个数 */
+#define BENCH_KEY_LEN       (64)        /* 键的最大长度 */
+#define BENCH_OLD_NODE_SIZE (24)        /* 原键树结点大小 */
+
+typedef struct
+{
+    int len;
+    u_char key[BENCH_KEY_LEN];
+} bench_key_t;
+
+static const char *bench_host[] = {
+    "http://www.qiware.com/", "http://news.qiware.com/", "https://www.example.com/",
+    "https://img.example.com/", "http://bbs.qiware.cn/", "http://mail.qiware.cn/"
+};
+
+static const char *bench_dir[] = {
+    "index/", "news/", "sports/", "tech/", "images/", "article/", "video/", "user/"
+};
+
+/* 获取当前时间(ms) */
+static double bench_msec(void)
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+
+    return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+/* 生成URL形式的主键 */
+static void bench_key_gen(bench_key_t *k, unsigned int *seed)
+{
+    k->len = snprintf((char *)k->key, sizeof(k->key), "%s%s%s%u/%u.html",
+            bench_host[rand_r(seed) % (sizeof(bench_host)/sizeof(bench_host[0]))],
+            bench_dir[rand_r(seed) % (sizeof(bench_dir)/sizeof(bench_dir[0]))],
+            bench_dir[rand_r(seed) % (sizeof(bench_dir)/sizeof(bench_dir[0]))],
+            rand_r(seed) % 10000, rand_r(seed));
+}
+
+/* 主键比较(排序用) */
+static int bench_key_cmp(const void *_a, const void *_b)
+{
+    int ret;
+    const bench_key_t *a = (const bench_key_t *)_a, *b = (const bench_key_t *)_b;
+
+    ret = memcmp(a->key, b->key, MIN(a->len, b->len));
+
+    return ret? ret : (a->len - b->len);
+}
+
+/******************************************************************************
+ **函数名称: bench_old_mem
+ **功    能: 估算原256路键树的内存
+ **输入参数:
+ **     keys: 主键(已排序)
+ **     num: 主键个数
+ **输出参数: NONE
+ **返    回: 内存(字节)
+ **实现描述: 原实现中每个有后续字符的前缀都有一个256个结点的孩子数组. 按字典序
+ **          排列后, 每个键新引入的前缀个数 = 键长 - 与前一个键的公共前缀长度.
+ **注意事项:
+ **作    者: # Qifeng.zou # 2015.08.05 #
+ ******************************************************************************/
+static size_t bench_old_mem(const bench_key_t *keys, int num)
+{
+    int idx, lcp, max;
+    size_t arrays = 1;
+
+    for (idx=0; idx<num; ++idx) {
+        lcp = 0;
+        if (idx > 0) {
+            max = MIN(keys[idx].len, keys[idx-1].len);
+            for (; (lcp < max) && (keys[idx].key[lcp] == keys[idx-1].key[lcp]); ++lcp) { NULL; }
+        }
+        if (keys[idx].len - 1 > lcp) {
+            arrays += keys[idx].len - 1 - lcp;
+        }
+    }
+
+    return arrays * 256 * BENCH_OLD_NODE_SIZE;
+}
+
+int main(int argc, char *argv[])
+{
+    int idx, num, hit;
+    void *data;
+    double tm;
+    unsigned int seed = 7;
+    bench_key_t *keys;
+    trie_tree_t *trie;
+    u_char url[BENCH_KEY_LEN + 16];
+
+    num = (argc > 1)? atoi(argv[1]) : BENCH_KEY_NUM;
+    if (num <= 0) {
+        fprintf(stderr, "Usage: %s [key num]\n", argv[0]);
+        return -1;
+    }
+
+    keys = (bench_key_t *)calloc(num, sizeof(bench_key_t));
+    if (NULL == keys) {
+        return -1;
+    }
+
+    for (idx=0; idx<num; ++idx) {
+        bench_key_gen(&keys[idx], &seed);
+    }
+
+    trie = trie_creat(NULL);
+    if (NULL == trie) {
+        free(keys);
+        return -1;
+    }
+
+    /* > 插入 */
+    tm = bench_msec();
+    for (idx=0; idx<num; ++idx) {
+        if (trie_insert(trie, keys[idx].key, keys[idx].len, (void *)&keys[idx])) {
+            fprintf(stderr, "Insert failed! idx:%d\n", idx);
+            return -1;
+        }
+    }
+    tm = bench_msec() - tm;
+    fprintf(stdout, "insert: %d keys %.1f ns/op\n", num, tm * 1e6 / num);
+
+    /* > 查询 */
+    hit = 0;
+    tm = bench_msec();
+    for (idx=0; idx<num; ++idx) {
+        if (0 == trie_query(trie, keys[idx].key, keys[idx].len, &data)) {
+            ++hit;
+        }
+    }
+    tm = bench_msec() - tm;
+    fprintf(stdout, "query: %.1f ns/op hit:%d\n", tm * 1e6 / num, hit);
+
+    /* > 最长前缀匹配(键后追加查询串) */
+    hit = 0;
+    tm = bench_msec();
+    for (idx=0; idx<num; ++idx) {
+        memcpy(url, keys[idx].key, keys[idx].len);
+        memcpy(url + keys[idx].len, "?id=1", 5);
+        if (trie_match(trie, url, keys[idx].len + 5, &data) > 0) {
+            ++hit;
+        }
+    }
+    tm = bench_msec() - tm;
+    fprintf(stdout, "match: %.1f ns/op hit:%d\n", tm * 1e6 / num, hit);
+
+    /* > 内存 */
+    qsort(keys, num, sizeof(bench_key_t), bench_key_cmp);
+    fprintf(stdout, "memory: keys:%lu art:%zu bytes (%.1f bytes/key) old(estimate):%zu bytes\n",
+            trie_num(trie), trie_mem_size(trie),
+            (double)trie_mem_size(trie) / trie_num(trie), bench_old_mem(keys, num));
+
+    trie_destroy(trie, NULL, NULL);
+    free(keys);
+
+    return 0;
+}
@@ -6,6 +6,7 @@
 #include "queue.h"
 #include "access.h"
 #include "rb_tree.h"
+#include "metrics.h"
 
 #define ACC_TMOUT_MSEC       (1000)  /* 超时(豪秒) */
 
@@ -24,6 +25,7 @@ typedef struct
 
     socket_t cmd_sck;               /* 命令套接字 */
     unsigned int conn_total;        /* 当前连接数 */
+    metrics_t *conn_metric;         /* 统计项: 当前连接数(所有接收线程之和) */
 
     queue_t *connq;                 /* 连接队列 */
     ring_t *sendq;                  /* 发送队列 */
@@ -8,7 +8,7 @@
 #include "rb_tree.h"
 #include "spinlock.h"
 #include "avl_tree.h"
-#include "hash_tab.h"
+#include "hash_map.h"
 #include "shm_queue.h"
 #include "acc_comm.h"
 #include "acc_lsn.h"
@@ -78,7 +78,7 @@ typedef struct _acc_cntx_t {
     thread_pool_t *rsvr_pool;       /* 接收线程池 */
     thread_pool_t *lsvr_pool;       /* 帧听线程池 */
 
-    hash_tab_t *conn_cid_tab;       /* CID集合(注:数组长度与Agent相等) */
+    hash_map_t *conn_cid_tab;       /* CID集合(注:数组长度与Agent相等) */
 
     queue_t **connq;                /* 连接队列(注:数组长度与Agent相等) */
     ring_t **sendq;                 /* 发送队列(注:数组长度与Agent相等) */
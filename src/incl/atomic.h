@@ -3,6 +3,15 @@
 
 #include <stdint.h>
 
+/* 编译器屏障: 禁止编译器对屏障前后的内存访问进行重排 */
+#define compiler_barrier() __asm__ volatile("" ::: "memory")
+
+/* 内存屏障: 禁止CPU将屏障前的写与屏障后的读重排(x86仅此一种重排) */
+#define memory_barrier() __asm__ volatile("mfence" ::: "memory")
+
+/* 自旋等待提示: 降低自旋时的功耗及对超线程兄弟核的干扰 */
+#define cpu_relax() __asm__ volatile("pause" ::: "memory")
+
 /******************************************************************************
  **函数名称: atomic16_xset
  **功    能: 先返回v中的值，再执行 (*v) = i
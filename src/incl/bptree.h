@@ -0,0 +1,118 @@
+#if !defined(__BPTREE_H__)
+#define __BPTREE_H__
+
+#include "comm.h"
+
+/*
+ * 内存B+树(面向读多写少的场景, 如配置表、路由表)
+ *  1. 结点为固定大小的连续内存块, 按缓存行对齐, 主键与指针内联存放,
+ *     一次查找只访问树高个结点, 避免平衡二叉树逐个结点跳转的缓存缺失;
+ *  2. 主键: 无符号64位整数(AVX2并行比较) 或 最长key_len字节的字节串(memcmp序);
+ *  3. 叶子结点双向链接, 支持有序遍历和范围查询;
+ *  4. 支持有序数据的批量加载(自底向上构建, 叶子填满).
+ */
+
+#define BPTREE_CACHE_LINE   (64)            /* 缓存行大小 */
+#define BPTREE_NODE_SIZE    (512)           /* 默认结点大小(字节) */
+#define BPTREE_KEY_LEN_MAX  (256)           /* 字节串主键的最大长度 */
+
+/* 错误码定义 */
+typedef enum
+{
+    BPTREE_OK                               /* 成功 */
+
+    , BPTREE_ERR = ~0x7fffffff              /* 失败 */
+    , BPTREE_NODE_EXIST                     /* 结点已存在 */
+    , BPTREE_NOT_FOUND                      /* 未找到 */
+} bptree_err_e;
+
+/* 主键类型 */
+typedef enum
+{
+    BPTREE_KEY_U64                          /* 无符号64位整数 */
+    , BPTREE_KEY_STR                        /* 字节串(按memcmp序, 较短的前缀更小) */
+} bptree_key_e;
+
+/* 选项 */
+typedef struct
+{
+    bptree_key_e key_type;                  /* 主键类型 */
+    int key_len;                            /* 字节串主键的最大长度(KEY_STR时有效) */
+    int node_size;                          /* 结点大小(0:默认BPTREE_NODE_SIZE, 须为缓存行的整数倍) */
+
+    void *pool;                             /* 内存池(注: 自定义时由其保证对齐) */
+    mem_alloc_cb_t alloc;                   /* 申请内存 */
+    mem_dealloc_cb_t dealloc;               /* 释放内存 */
+} bptree_opt_t;
+
+/* 结点(头部之后依次是主键数组和指针数组) */
+typedef struct _bptree_node_t
+{
+    uint16_t leaf;                          /* 是否为叶子 */
+    uint16_t num;                           /* 主键个数 */
+    struct _bptree_node_t *prev;            /* 前一个叶子 */
+    struct _bptree_node_t *next;            /* 后一个叶子 */
+} bptree_node_t;
+
+/* B+树 */
+typedef struct _bptree_t
+{
+    bptree_key_e key_type;                  /* 主键类型 */
+    int key_len;                            /* 字节串主键的最大长度 */
+    int key_size;                           /* 主键在结点中占用的空间 */
+    int node_size;                          /* 结点大小 */
+    int leaf_max;                           /* 叶子的最大主键数 */
+    int inner_max;                          /* 内部结点的最大主键数 */
+
+    int height;                             /* 树高(0:空树) */
+    uint64_t num;                           /* 主键个数 */
+    uint64_t node_num;                      /* 结点个数 */
+    bptree_node_t *root;                    /* 根结点 */
+    bptree_node_t *head;                    /* 第一个叶子 */
+    bptree_node_t *tail;                    /* 最后一个叶子 */
+
+    /* 在结点中查找第一个不小于key的位置 */
+    int (*search)(const struct _bptree_t *tree, const bptree_node_t *node, const void *key);
+
+    /* 内存池 */
+    struct {
+        void *pool;                         /* 内存池 */
+        mem_alloc_cb_t alloc;               /* 申请内存 */
+        mem_dealloc_cb_t dealloc;           /* 释放内存 */
+    };
+} bptree_t;
+
+/* 迭代器 */
+typedef struct
+{
+    bptree_t *tree;                         /* B+树 */
+    bptree_node_t *leaf;                    /* 当前叶子 */
+    int idx;                                /* 在叶子中的位置 */
+} bptree_iter_t;
+
+/* 遍历回调(返回非0时停止) */
+typedef int (*bptree_trav_cb_t)(const void *key, size_t len, void *data, void *args);
+
+/* 批量加载回调: 依次返回升序的主键(返回非0表示没有更多数据) */
+typedef int (*bptree_load_cb_t)(void *args, const void **key, size_t *len, void **data);
+
+bptree_t *bptree_creat(bptree_opt_t *opt);
+int bptree_insert(bptree_t *tree, const void *key, size_t len, void *data);
+void *bptree_query(bptree_t *tree, const void *key, size_t len);
+int bptree_delete(bptree_t *tree, const void *key, size_t len, void **data);
+int bptree_load(bptree_t *tree, bptree_load_cb_t next, void *args);
+
+int bptree_seek(bptree_t *tree, bptree_iter_t *iter, const void *key, size_t len);
+int bptree_next(bptree_iter_t *iter, const void **key, size_t *len, void **data);
+int bptree_range(bptree_t *tree, const void *min, size_t min_len,
+        const void *max, size_t max_len, bptree_trav_cb_t proc, void *args);
+int bptree_trav(bptree_t *tree, trav_cb_t proc, void *args);
+
+void bptree_print(bptree_t *tree);
+void bptree_destroy(bptree_t *tree, mem_dealloc_cb_t dealloc, void *args);
+
+#define bptree_num(tree) ((tree)->num)
+#define bptree_isempty(tree) (0 == (tree)->num)
+#define bptree_mem_size(tree) ((tree)->node_num * (tree)->node_size)
+
+#endif /*__BPTREE_H__*/
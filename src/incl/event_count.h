@@ -0,0 +1,154 @@
+#if !defined(__EVENT_COUNT_H__)
+#define __EVENT_COUNT_H__
+
+#include "comm.h"
+#include "atomic.h"
+#include "futex.h"
+
+/******************************************************************************
+ **
+ ** 事件计数(eventcount): 基于futex的等待/通知原语
+ **     等待者:
+ **         for (;;) {
+ **             if (条件成立) break;            -- 可先自旋若干轮
+ **             key = event_count_prepare(ec);  -- 登记
+ **             if (条件成立) { event_count_cancel(ec); break; }
+ **             event_count_wait(ec, key, -1);  -- 休眠
+ **         }
+ **     通知者:
+ **         使条件成立(如入队);
+ **         event_count_notify(ec);             -- 无等待者时只有一次读操作
+ **
+ **     通知者发布后经全屏障读取等待者数, 等待者先登记再检查条件. 因此要么
+ **     通知者看到等待者而唤醒, 要么等待者看到条件成立而不休眠, 不会丢失唤醒.
+ **     登记后有通知时seq已变化, futex_wait立即返回.
+ **
+ **     等待者数与已唤醒但尚未返回的等待者数(wakes)放在同一个字中原子修改:
+ **     通知者只在wakes小于等待者数时唤醒, 被唤醒者尚未运行时(如CPU繁忙)不会
+ **     重复唤醒同一个等待者; 连续N次通知则唤醒N个等待者, 不会只唤醒一个而让
+ **     其余任务积压. 等待者返回或取消登记时同时减少两者(wakes不小于0).
+ **
+ ******************************************************************************/
+#define EVENT_COUNT_WAITER  (1)             /* 等待者数的单位(低16位) */
+#define EVENT_COUNT_WAKE    (1 << 16)       /* 已唤醒数的单位(高16位) */
+
+#define event_count_waiters(state) ((state) & 0xFFFF)
+#define event_count_wakes(state) ((state) >> 16)
+
+typedef struct
+{
+    volatile uint32_t seq;          /* 通知序号(futex字) */
+    volatile uint32_t state;        /* 低16位: 已登记(准备休眠或休眠)的等待者数
+                                       高16位: 已唤醒但尚未返回的等待者数 */
+} event_count_t;
+
+/* 初始化 */
+static inline void event_count_init(event_count_t *ec)
+{
+    ec->seq = 0;
+    ec->state = 0;
+}
+
+/******************************************************************************
+ **函数名称: event_count_prepare
+ **功    能: 登记等待
+ **输入参数:
+ **     ec: 事件计数
+ **输出参数: NONE
+ **返    回: 等待键值(传给event_count_wait())
+ **实现描述: 原子操作自带全屏障, 之后读取的条件不会早于登记
+ **注意事项: 登记后须调用event_count_wait()或event_count_cancel()之一
+ **作    者: # Qifeng.zou # 2015.09.28 #
+ ******************************************************************************/
+static inline uint32_t event_count_prepare(event_count_t *ec)
+{
+    atomic32_add(&ec->state, EVENT_COUNT_WAITER);
+    return ec->seq;
+}
+
+/* 取消登记(登记后发现条件已成立, 或等待返回): 同时消耗一个在途的唤醒 */
+static inline void event_count_cancel(event_count_t *ec)
+{
+    uint32_t state, next;
+
+    do {
+        state = ec->state;
+        next = state - EVENT_COUNT_WAITER;
+        if (event_count_wakes(state)) {
+            next -= EVENT_COUNT_WAKE;
+        }
+    } while (!atomic32_cmp_and_set(&ec->state, state, next));
+}
+
+/******************************************************************************
+ **函数名称: event_count_wait
+ **功    能: 等待通知
+ **输入参数:
+ **     ec: 事件计数
+ **     key: 等待键值(event_count_prepare()的返回值)
+ **     msec: 超时时间(ms) (注: <0时表示永久等待)
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述: 登记之后已有通知时立即返回; 返回时注销登记并消耗一个在途的唤醒
+ **注意事项: 返回后需由调用者重新检查等待条件
+ **作    者: # Qifeng.zou # 2015.09.28 #
+ ******************************************************************************/
+static inline void event_count_wait(event_count_t *ec, uint32_t key, int msec)
+{
+    if (key == ec->seq) {
+        futex_wait(&ec->seq, key, msec);
+    }
+    event_count_cancel(ec);
+}
+
+/******************************************************************************
+ **函数名称: event_count_notify
+ **功    能: 唤醒一个等待者
+ **输入参数:
+ **     ec: 事件计数
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述: 无等待者, 或每个等待者都已有在途的唤醒时直接返回, 不做系统调用;
+ **          否则增加wakes后唤醒一个等待者
+ **注意事项: 须在条件成立(如数据入队)之后调用
+ **作    者: # Qifeng.zou # 2015.09.28 #
+ ******************************************************************************/
+static inline void event_count_notify(event_count_t *ec)
+{
+    uint32_t state;
+
+    memory_barrier();
+    do {
+        state = ec->state;
+        if (event_count_wakes(state) >= event_count_waiters(state)) {
+            return;
+        }
+    } while (!atomic32_cmp_and_set(&ec->state, state, state + EVENT_COUNT_WAKE));
+
+    atomic32_inc(&ec->seq);
+    futex_wake(&ec->seq, 1);
+}
+
+/******************************************************************************
+ **函数名称: event_count_notify_all
+ **功    能: 唤醒所有等待者
+ **输入参数:
+ **     ec: 事件计数
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述: 无等待者时直接返回
+ **注意事项: 须在条件成立(如设置退出标志)之后调用
+ **作    者: # Qifeng.zou # 2015.09.28 #
+ ******************************************************************************/
+static inline void event_count_notify_all(event_count_t *ec)
+{
+    memory_barrier();
+    if (0 == event_count_waiters(ec->state)) {
+        return;
+    }
+
+    atomic32_inc(&ec->seq);
+    futex_wake(&ec->seq, INT_MAX);
+}
+
+#endif /*__EVENT_COUNT_H__*/
@@ -0,0 +1,10 @@
+#if !defined(__EVFD_H__)
+#define __EVFD_H__
+
+#include "comm.h"
+
+int evfd_creat(void);
+int evfd_notify(int fd);
+uint64_t evfd_clear(int fd);
+
+#endif /*__EVFD_H__*/
@@ -0,0 +1,51 @@
+#if !defined(__FUTEX_H__)
+#define __FUTEX_H__
+
+#include "comm.h"
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
+/******************************************************************************
+ **函数名称: futex_wait
+ **功    能: 等待futex字的值发生变化
+ **输入参数:
+ **     addr: futex字(可位于共享内存)
+ **     val: 期望值(当*addr != val时立即返回)
+ **     msec: 超时时间(ms) (注: <0时表示永久等待)
+ **输出参数: NONE
+ **返    回: 0:被唤醒 !0:超时、值已变化或被信号中断
+ **实现描述: 使用FUTEX_WAIT(非PRIVATE)以支持跨进程
+ **注意事项: 返回后需由调用者重新检查等待条件
+ **作    者: # Qifeng.zou # 2015.06.12 #
+ ******************************************************************************/
+static inline int futex_wait(volatile uint32_t *addr, uint32_t val, int msec)
+{
+    struct timespec tm, *ptm = NULL;
+
+    if (msec >= 0) {
+        tm.tv_sec = msec / 1000;
+        tm.tv_nsec = (msec % 1000) * 1000000;
+        ptm = &tm;
+    }
+
+    return syscall(SYS_futex, addr, FUTEX_WAIT, val, ptm, NULL, 0);
+}
+
+/******************************************************************************
+ **函数名称: futex_wake
+ **功    能: 唤醒等待在futex字上的进程(线程)
+ **输入参数:
+ **     addr: futex字(可位于共享内存)
+ **     num: 最多唤醒的个数
+ **输出参数: NONE
+ **返    回: 实际唤醒的个数
+ **实现描述:
+ **注意事项:
+ **作    者: # Qifeng.zou # 2015.06.12 #
+ ******************************************************************************/
+static inline int futex_wake(volatile uint32_t *addr, int num)
+{
+    return syscall(SYS_futex, addr, FUTEX_WAKE, num, NULL, NULL, 0);
+}
+
+#endif /*__FUTEX_H__*/
@@ -3,7 +3,43 @@
 
 #include "comm.h"
 
+/* 哈希算法 */
+typedef enum
+{
+    HASH_ALG_TIME33                 /* TIME33(逐字节) */
+    , HASH_ALG_WYHASH               /* WYHASH(8/16字节步长) */
+    , HASH_ALG_XXH3                 /* XXH3风格(条带累加, SSE2/AVX2) */
+    , HASH_ALG_CRC32C               /* CRC32C(SSE4.2) */
+
+    , HASH_ALG_TOTAL                /* 算法总数 */
+} hash_alg_e;
+
+/* 哈希回调 */
+typedef uint64_t (*hash_alg_cb_t)(const void *addr, size_t len, uint64_t seed);
+
 uint64_t hash_time33(const char *str);
 uint64_t hash_time33_ex(const void *addr, size_t len);
+uint64_t hash_wyhash(const void *addr, size_t len, uint64_t seed);
+uint64_t hash_xxh3(const void *addr, size_t len, uint64_t seed);
+uint32_t hash_crc32c(const void *addr, size_t len, uint32_t crc);
+hash_alg_cb_t hash_alg_get(hash_alg_e alg);
+
+/* 默认哈希算法(由switch.mak中的CONFIG_HASH_ALG选择)
+ * 注: 结果截断为63位, 与hash_time33()一致, 可直接存入int64_t */
+#if defined(__HASH_ALG_TIME33__)
+    #define HASH_ALG_DEFAULT HASH_ALG_TIME33
+    #define hash_default(addr, len) hash_time33_ex(addr, len)
+#elif defined(__HASH_ALG_XXH3__)
+    #define HASH_ALG_DEFAULT HASH_ALG_XXH3
+    #define hash_default(addr, len) (hash_xxh3(addr, len, 0) & 0x7FFFFFFFFFFFFFFF)
+#elif defined(__HASH_ALG_CRC32C__)
+    #define HASH_ALG_DEFAULT HASH_ALG_CRC32C
+    #define hash_default(addr, len) (hash_alg_get(HASH_ALG_CRC32C)(addr, len, 0) & 0x7FFFFFFFFFFFFFFF)
+#else /* 默认: WYHASH */
+    #define HASH_ALG_DEFAULT HASH_ALG_WYHASH
+    #define hash_default(addr, len) (hash_wyhash(addr, len, 0) & 0x7FFFFFFFFFFFFFFF)
+#endif
+
+#define hash_default_str(str) hash_default(str, strlen(str))
 
 #endif /*__HASH_ALG_H__*/
@@ -0,0 +1,51 @@
+#if !defined(__HASH_MAP_H__)
+#define __HASH_MAP_H__
+
+#include "comm.h"
+#include "lock.h"
+#include "swiss_tab.h"
+
+/* 选项 */
+typedef struct
+{
+    void *pool;                                     /* 内存池 */
+    mem_alloc_cb_t alloc;                           /* 申请内存 */
+    mem_dealloc_cb_t dealloc;                       /* 释放内存 */
+} hash_map_opt_t;
+
+/* 分片(注: 各分片独占缓存行, 避免锁的伪共享) */
+typedef struct
+{
+    pthread_rwlock_t lock;                          /* 分片锁 */
+    swiss_tab_t *tab;                               /* 开放寻址哈希表 */
+} __attribute__((aligned(64))) hash_map_shard_t;
+
+/* 分片哈希表(接口与hash_tab_t一致) */
+typedef struct
+{
+    int len;                                        /* 分片数 */
+    hash_map_shard_t *shard;                        /* 分片数组(长度: len) */
+
+    cmp_cb_t cmp;                                   /* 比较回调 */
+    hash_cb_t hash;                                 /* 生成哈系值的回调 */
+
+    /* 内存池 */
+    struct {
+        void *pool;                                 /* 内存池 */
+        mem_alloc_cb_t alloc;                       /* 申请内存 */
+        mem_dealloc_cb_t dealloc;                   /* 释放内存 */
+    };
+} hash_map_t;
+
+hash_map_t *hash_map_creat(int len, hash_cb_t hash, cmp_cb_t cmp, hash_map_opt_t *opt);
+int hash_map_insert(hash_map_t *map, void *data, lock_e lock);
+void *hash_map_query(hash_map_t *map, void *key, lock_e lock);
+void hash_map_unlock(hash_map_t *map, void *key, lock_e lock);
+void *hash_map_delete(hash_map_t *map, void *key, lock_e lock);
+int hash_map_trav(hash_map_t *map, trav_cb_t proc, void *args, lock_e lock);
+int hash_map_trav_slot(hash_map_t *map, const void *key, trav_cb_t proc, void *args, lock_e lock);
+int hash_map_destroy(hash_map_t *map, mem_dealloc_cb_t dealloc, void *args);
+uint64_t hash_map_total(hash_map_t *map);
+size_t hash_map_mem_size(hash_map_t *map);
+
+#endif /*__HASH_MAP_H__*/
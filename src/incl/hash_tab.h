@@ -5,22 +5,42 @@
 #include "lock.h"
 #include "rb_tree.h"
 
+#define HASH_TAB_FLAG_GROW  (0x01)                  /* 扩容模式(线性哈希: 负载过高时逐个分裂槽) */
+
+#define HASH_TAB_SEG_MAX    (24)                    /* 最大段数(槽数最多可扩至len*2^23) */
+#define HASH_TAB_LOAD_MAX   (4)                     /* 扩容模式下每个槽的平均数据上限 */
+#define HASH_TAB_SPLIT_NUM  (2)                     /* 每次扩容分裂的槽数 */
+
 /* 选线 */
 typedef struct
 {
     void *pool;                                     /* 内存池 */
     mem_alloc_cb_t alloc;                           /* 申请内存 */
     mem_dealloc_cb_t dealloc;                       /* 释放内存 */
+    int flag;                                       /* 标志(HASH_TAB_FLAG_XXX) */
 } hash_tab_opt_t;
 
+/* 槽段(注: 第0段长度为len, 第k段长度为len*2^(k-1); 已分配的段不再移动) */
+typedef struct
+{
+    rbt_tree_t **tree;                              /* 树 */
+    pthread_rwlock_t *lock;                         /* 树锁 */
+} hash_tab_seg_t;
+
 /* 哈希数组 */
 typedef struct
 {
-    int len;                                        /* 数组长 */
+    int len;                                        /* 数组长(初始槽数) */
     uint64_t total;                                 /* 数据总数 */
+    int flag;                                       /* 标志(HASH_TAB_FLAG_XXX) */
+
+    hash_tab_seg_t seg[HASH_TAB_SEG_MAX];           /* 槽段 */
 
-    rbt_tree_t **tree;                              /* 树(长度: len) */
-    pthread_rwlock_t *lock;                         /* 树锁(长度: len) */
+    /* 扩容(线性哈希): 当前槽数 = (len << level) + split */
+    int level;                                      /* 已完成的翻倍次数 */
+    int split;                                      /* 下一个待分裂的槽 */
+    volatile uint32_t pend;                         /* 积欠的分裂次数(未抢到扩容锁的插入累加) */
+    pthread_rwlock_t glock;                         /* 扩容锁(扩容模式下: 操作加读锁, 分裂加写锁) */
 
     cmp_cb_t cmp;                                   /* 比较回调 */
     hash_cb_t hash;                                 /* 生成哈系值的回调 */
@@ -2,6 +2,7 @@
 #define __LOG_H__
 
 #include "comm.h"
+#include "atomic.h"
 #include "avl_tree.h"
 #include "thread_pool.h"
 
@@ -30,12 +31,21 @@ typedef enum
 
 #define LOG_MEM_SIZE            (1 * MB)    /* 日志缓存SIZE */
 #define LOG_SYNC_TIMEOUT        (1)         /* 日志超时同步时间 */
+#define LOG_RING_SIZE           (256 * KB)  /* 每个线程的日志环形缓存SIZE(必须为2^n) */
+#define LOG_RING_YIELD_NUM      (16)        /* 缓存已满时先让出CPU的次数 */
+#define LOG_RING_WAIT_MSEC      (100)       /* 缓存已满时最多再等待的时间(毫秒), 超时丢弃 */
 
 #define LOG_MSG_MAX_LEN         (2048)      /* 日志行最大长度 */
+#define LOG_PREFIX_MAX_LEN      (64)        /* 日志行前缀(进程号|日期|时间|级别)最大长度 */
 #define LOG_MAX_SIZE            (128 * MB)  /* 单个日志文件的最大SIZE */
 
 #define LOG_SUFFIX              ".log"      /* 日志文件后缀 */
 
+/* 限流设置(log_error/log_warn的每个调用点各自限流, 见log_set_limit()) */
+#define LOG_LIMIT_RATE          (100)       /* 每秒补充的令牌数 */
+#define LOG_LIMIT_BURST         (200)       /* 令牌桶容量 */
+#define LOG_LIMIT_SAMPLE        (1000)      /* 被抑制的日志每SAMPLE条输出1条 */
+
 /* DUMP设置 */
 #define LOG_DUMP_COL_NUM        (16)        /* DUMP列数 */
 #define LOG_DUMP_PAGE_MAX_ROWS  (20)        /* DUMP页最大行数 */
@@ -45,6 +55,13 @@ typedef enum
 
 #define log_is_timeout(diff_time) (diff_time >= LOG_SYNC_TIMEOUT)
 
+/* 日志模式 */
+typedef enum
+{
+    LOG_MODE_TEXT                           /* 文本模式(默认) */
+    , LOG_MODE_BINARY                       /* 二进制模式(由tools/log_decode.py还原为文本) */
+} log_mode_e;
+
 /* 日志服务 */
 typedef struct
 {
@@ -53,17 +70,138 @@ typedef struct
 
     avl_tree_t *logs;                       /* 日志列表(管理log_cycle_t对象) */
     pthread_mutex_t lock;                   /* 锁 */
+
+    volatile uint32_t notify;               /* 唤醒同步线程的标志(futex字) */
 } log_svr_t;
 
+/* 线程日志缓存(单生产者/单消费者环形缓存)
+ *  记录格式: [长度(4字节)][类型(4字节)][记录内容], 按8字节对齐;
+ *  尾部空间不足时写入LOG_RING_SKIP标记, 从头部继续写入. */
+#define LOG_RING_SKIP           (0xFFFFFFFF)/* 跳过尾部剩余空间 */
+#define LOG_RING_HEAD_LEN       (8)         /* 记录头长度 */
+
+typedef struct _log_ring_t
+{
+    volatile uint64_t head;                 /* 写入位置(所属线程) */
+    char _pad1[64 - sizeof(uint64_t)];
+    volatile uint64_t tail;                 /* 读取位置(同步线程) */
+    char _pad2[64 - sizeof(uint64_t)];
+
+    size_t size;                            /* 缓存SIZE */
+    char *data;                             /* 缓存首地址 */
+    volatile int closed;                    /* 所属线程是否已退出 */
+    uint32_t drop;                          /* 缓存已满而丢弃的条数(尚未报告, 只由所属线程修改) */
+    struct _log_ring_t *next;               /* 下一个缓存 */
+} log_ring_t;
+
+/******************************************************************************
+ ** 二进制日志
+ **     调用点首次执行时注册格式串(分配格式ID), 之后每次只将格式ID、时间和原始
+ **     参数拷贝到线程缓存, 不调用vsnprintf. 二进制模式的日志文件由以下记录组成:
+ **         [文件头] [记录头][记录内容] [记录头][记录内容] ...
+ **     记录头与线程缓存的记录头相同(长度+类型), 记录之间不对齐. 每个日志文件
+ **     开头写入此前注册的全部格式, 之后注册的格式在首次使用前写入, 因此每个
+ **     文件(含转储后的文件)均可单独解析.
+ ******************************************************************************/
+#define LOG_BIN_MAGIC           (0x42474F4C)/* 文件头魔术字("LOGB") */
+#define LOG_BIN_VERSION         (1)         /* 文件格式版本 */
+#define LOG_BIN_ARG_MAX         (32)        /* 格式串最大参数个数 */
+#define LOG_ARG_PREC_NONE       (-1)        /* 字符串参数未指定精度 */
+#define LOG_ARG_PREC_STAR       (-2)        /* 字符串参数的精度由前一个int参数给出(%.*s) */
+
+/* 记录类型 */
+typedef enum
+{
+    LOG_REC_TEXT                            /* 文本日志(与文本模式的日志行相同) */
+    , LOG_REC_FMT                           /* 格式定义(log_bin_fmt_t) */
+    , LOG_REC_DATA                          /* 二进制日志(log_bin_data_t) */
+} log_rec_type_e;
+
+/* 参数类型 */
+typedef enum
+{
+    LOG_ARG_INT                             /* int及更短的整数(8字节, 符号扩展) */
+    , LOG_ARG_LONG                          /* long/long long/size_t等(8字节) */
+    , LOG_ARG_DOUBLE                        /* double(8字节) */
+    , LOG_ARG_STR                           /* 字符串([长度(4字节)][内容]) */
+    , LOG_ARG_PTR                           /* 指针(8字节) */
+} log_arg_type_e;
+
+/* 文件头 */
+typedef struct
+{
+    uint32_t magic;                         /* 魔术字(LOG_BIN_MAGIC) */
+    uint32_t version;                       /* 版本号(LOG_BIN_VERSION) */
+} log_bin_file_t;
+
+/* 格式定义: 后跟参数类型[argc](每个1字节)及"文件名\0函数名\0格式串\0" */
+typedef struct
+{
+    uint32_t id;                            /* 格式ID */
+    int32_t lineno;                         /* 文件行号 */
+    int32_t level;                          /* 日志级别 */
+    int32_t argc;                           /* 参数个数 */
+} log_bin_fmt_t;
+
+/* 二进制日志: 后跟各参数的原始值 */
+typedef struct
+{
+    uint64_t sec;                           /* 时间(秒) */
+    uint32_t nsec;                          /* 时间(纳秒) */
+    uint32_t id;                            /* 格式ID */
+    int32_t pid;                            /* 进程号 */
+    uint32_t resv;                          /* 保留 */
+} log_bin_data_t;
+
+/* 调用点(每个调用点一个静态对象, 由log_bxxx()宏定义) */
+typedef struct
+{
+    volatile uint32_t id;                   /* 格式ID(0:未注册) */
+    int level;                              /* 日志级别 */
+    const char *fname;                      /* 文件名 */
+    int lineno;                             /* 文件行号 */
+    const char *func;                       /* 函数名 */
+
+    const char *fmt;                        /* 格式串(注册时设置) */
+    int argc;                               /* 参数个数(-1:不支持二进制, 按文本输出) */
+    uint8_t type[LOG_BIN_ARG_MAX];          /* 参数类型(log_arg_type_e) */
+    int16_t prec[LOG_BIN_ARG_MAX];          /* 字符串参数的精度(LOG_ARG_PREC_XXX或>=0) */
+} log_fmt_t;
+
+/* 调用点限流(令牌桶, 每个调用点一个静态对象, 由log_error()/log_warn()宏定义) */
+typedef struct
+{
+    volatile uint32_t tokens;               /* 剩余令牌(按int32_t使用, 竞争时可能小于0) */
+    volatile uint32_t sec;                  /* 上次补充令牌的时间(秒) */
+    volatile uint32_t suppressed;           /* 上次汇总以来被抑制的条数 */
+} log_limit_t;
+
+/* 限流参数 */
+typedef struct
+{
+    uint32_t rate;                          /* 每秒补充的令牌数(0:不限流) */
+    uint32_t burst;                         /* 令牌桶容量 */
+    uint32_t sample;                        /* 抽样间隔(0:不抽样) */
+} log_limit_conf_t;
+
 /* 日志对象 */
 typedef struct _log_cycle_t
 {
     int level;                              /* 日志级别 */
+    int mode;                               /* 日志模式(log_mode_e) */
     log_svr_t *owner;                       /* 所属服务 */
     char path[FILE_NAME_MAX_LEN];           /* 日志文件绝对路径 */
 
     pid_t pid;                              /* 进程PID */
 
+    /* 写入线程: 只写本线程的环形缓存, 不加锁且不做磁盘IO */
+    struct {
+        pthread_key_t key;                  /* 线程私有数据(log_ring_t) */
+        log_ring_t *list;                   /* 环形缓存链表(由ring.lock保护) */
+        pthread_mutex_t lock;               /* 链表锁(只在增删结点时持有, 不含磁盘IO) */
+    } ring;
+
+    /* 同步线程: 收集各环形缓存的日志, 写入文件并转储 */
     struct {
         int fd;                             /* 文件描述符 */
         size_t size;                        /* 缓存SIZE */
@@ -71,6 +209,7 @@ typedef struct _log_cycle_t
         size_t outoff;                      /* 同步偏移 */
         char *text;                         /* 日志缓存首地址 */
         struct timeb sync_tm;               /* 上次同步的时间 */
+        uint32_t fmt_num;                   /* 当前文件已写入的格式数(二进制模式) */
         pthread_mutex_t lock;               /* 线程互斥锁 */
     };
 } log_cycle_t;
@@ -85,6 +224,8 @@ void log_core(log_cycle_t *log, int level,
                 const char *fname, int lineno, const char *func,
                 const void *dump, int dumplen,
                 const char *fmt, ...);
+void log_bcore(log_cycle_t *log, log_fmt_t *site, const char *fmt, ...);
+int log_set_mode(log_cycle_t *log, int mode);
 #define log_get_path(path, size, name) \
             snprintf(path, size, "../log/%s.log", name)
 
@@ -92,12 +233,16 @@ void log_core(log_cycle_t *log, int level,
 #define log_fatal(log, ...) /* 撰写FATAL级别日志 */\
     if (NULL != (log) && LOG_LEVEL_FATAL >= (log)->level) \
         log_core(log, LOG_LEVEL_FATAL, __FILE__, __LINE__, __func__, NULL, 0, __VA_ARGS__)
-#define log_error(log, ...) /* 撰写ERROR级别日志 */\
-    if (NULL != (log) && LOG_LEVEL_ERROR >= (log)->level) \
-        log_core(log, LOG_LEVEL_ERROR, __FILE__, __LINE__, __func__, NULL, 0, __VA_ARGS__)
-#define log_warn(log, ...)  /* 撰写WARN级别日志 */\
-    if (NULL != (log) && LOG_LEVEL_WARN >= (log)->level) \
-        log_core(log, LOG_LEVEL_WARN, __FILE__, __LINE__, __func__, NULL, 0, __VA_ARGS__)
+#define log_limit_core(log, _level, ...) /* 撰写限流的日志 */\
+    if (NULL != (log) && (_level) >= (log)->level) { \
+        static log_limit_t _log_limit; \
+        if (log_limit_check(log, &_log_limit, _level, __FILE__, __LINE__, __func__)) \
+            log_core(log, _level, __FILE__, __LINE__, __func__, NULL, 0, __VA_ARGS__); \
+    }
+#define log_error(log, ...) /* 撰写ERROR级别日志(限流) */\
+    log_limit_core(log, LOG_LEVEL_ERROR, __VA_ARGS__)
+#define log_warn(log, ...)  /* 撰写WARN级别日志(限流) */\
+    log_limit_core(log, LOG_LEVEL_WARN, __VA_ARGS__)
 #define log_info(log, ...)  /* 撰写INFO级别日志 */\
     if (NULL != (log) && LOG_LEVEL_INFO >= (log)->level) \
         log_core(log, LOG_LEVEL_INFO, __FILE__, __LINE__, __func__, NULL, 0, __VA_ARGS__)
@@ -111,9 +256,24 @@ void log_core(log_cycle_t *log, int level,
     if (NULL != (log) && LOG_LEVEL_TRACE >= (log)->level) \
         log_core(log, LOG_LEVEL_TRACE, __FILE__, __LINE__, __func__, addr, len, __VA_ARGS__)
 
+/* 二进制日志接口: 用于高频调用点, 二进制模式下不格式化(见log_set_mode())
+ *  注意: 格式串须为字符串常量; 不支持的格式(如%n, %Lf)自动按文本输出 */
+#define log_bcore_site(log, _level, ...) \
+    if (NULL != (log) && (_level) >= (log)->level) { \
+        static log_fmt_t _log_site = {0, (_level), __FILE__, __LINE__, __func__}; \
+        log_bcore(log, &_log_site, __VA_ARGS__); \
+    }
+#define log_binfo(log, ...) log_bcore_site(log, LOG_LEVEL_INFO, __VA_ARGS__)
+#define log_bdebug(log, ...) log_bcore_site(log, LOG_LEVEL_DEBUG, __VA_ARGS__)
+#define log_btrace(log, ...) log_bcore_site(log, LOG_LEVEL_TRACE, __VA_ARGS__)
+
 /* 内部接口 */
 int log_insert(log_svr_t *lsvr, log_cycle_t *log);
+uint32_t log_fmt_total(void);
+int log_fmt_encode(uint32_t id, char *addr, size_t size);
+int log_bin_decode(const char *data, uint32_t len, char *addr, size_t size);
 int log_sync(log_cycle_t *log);
+void log_svr_notify(log_svr_t *lsvr);
 
 extern size_t g_log_max_size;
 #define _log_set_max_size(size) (g_log_max_size = (size))
@@ -121,4 +281,51 @@ extern size_t g_log_max_size;
 
 void log_set_max_size(size_t size);
 
+/* 限流接口 */
+extern log_limit_conf_t g_log_limit;
+void log_set_limit(uint32_t rate, uint32_t burst, uint32_t sample);
+void log_limit_refill(log_cycle_t *log, log_limit_t *lim, int level,
+        const char *fname, int lineno, const char *func, uint32_t now);
+
+/******************************************************************************
+ **函数名称: log_limit_check
+ **功    能: 调用点限流检测
+ **输入参数:
+ **     log: 日志对象
+ **     lim: 调用点限流对象
+ **     level: 日志级别
+ **     fname: 文件名
+ **     lineno: 文件行号
+ **     func: 函数名
+ **输出参数: NONE
+ **返    回: true:输出 false:抑制
+ **实现描述:
+ **     1. 进入新的一秒时补充令牌, 并汇总输出上一阶段被抑制的条数
+ **     2. 有令牌时取走一个令牌; 否则计入抑制条数, 每sample条放行1条
+ **注意事项: 被抑制时只有一次原子操作(抑制计数)
+ **作    者: # Qifeng.zou # 2015.09.27 #
+ ******************************************************************************/
+static inline int log_limit_check(log_cycle_t *log, log_limit_t *lim, int level,
+        const char *fname, int lineno, const char *func)
+{
+    uint32_t now, n;
+
+    if (0 == g_log_limit.rate) {
+        return true;
+    }
+
+    now = (uint32_t)time(NULL);
+    if (now != lim->sec) {
+        log_limit_refill(log, lim, level, fname, lineno, func, now);
+    }
+
+    if (((int32_t)lim->tokens > 0) && ((int32_t)atomic32_xdec(&lim->tokens) > 0)) {
+        return true;
+    }
+
+    n = atomic32_inc(&lim->suppressed);
+
+    return (0 != g_log_limit.sample) && (0 == n % g_log_limit.sample);
+}
+
 #endif /*__LOG_H__*/
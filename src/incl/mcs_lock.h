@@ -0,0 +1,158 @@
+#if !defined(__MCS_LOCK_H__)
+#define __MCS_LOCK_H__
+
+#include "comm.h"
+#include "atomic.h"
+#include "spinlock.h"
+
+/******************************************************************************
+ **
+ ** MCS排队锁:
+ **     1. 等待者按到达顺序排队, 每个等待者只在自己的结点上自旋, 解锁时只
+ **        修改后继结点, 高竞争时不会出现所有等待者争抢同一缓存行的情况;
+ **     2. 队列中的链接保存结点相对于锁的偏移量而非指针. 锁和结点位于同一
+ **        共享内存时, 在各进程中的偏移量相同, 因此可跨进程使用; 进程内使用
+ **        时结点可位于任意位置(如栈上).
+ **
+ ** 使用方式:
+ **     mcs_node_t node;
+ **     mcs_lock(lck, &node);
+ **     ...
+ **     mcs_unlock(lck, &node);
+ **     加锁和解锁须使用同一结点, 结点在解锁前不能释放或用于其他锁.
+ **
+ ** 注意: MCS锁严格按到达顺序交接. 线程数超过CPU数时, 锁可能交给未在运行的
+ **       等待者, 吞吐量反而低于spinlock_t, 此时应优先使用spinlock_t.
+ **
+ ******************************************************************************/
+
+/* 排队结点 */
+typedef struct
+{
+    volatile int64_t next;          /* 后继结点(相对于锁的偏移, 0:无) */
+    volatile uint32_t locked;       /* 是否仍需等待 */
+} __attribute__((aligned(64))) mcs_node_t;
+
+/* MCS锁 */
+typedef struct
+{
+    volatile int64_t tail;          /* 队尾结点(相对于锁的偏移, 0:未锁) */
+} mcs_lock_t;
+
+#define mcs_node_off(lck, node) ((int64_t)((char *)(node) - (char *)(lck)))
+#define mcs_node_addr(lck, off) ((mcs_node_t *)((char *)(lck) + (off)))
+
+/******************************************************************************
+ **函数名称: mcs_lock_init
+ **功    能: 初始化MCS锁
+ **输入参数:
+ **     lck: MCS锁
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述:
+ **注意事项:
+ **作    者: # Qifeng.zou # 2015.09.15 #
+ ******************************************************************************/
+static inline void mcs_lock_init(mcs_lock_t *lck)
+{
+    lck->tail = 0;
+}
+
+/******************************************************************************
+ **函数名称: mcs_lock
+ **功    能: 加锁
+ **输入参数:
+ **     lck: MCS锁
+ **     node: 本次加锁使用的结点
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述:
+ **     1. 将本结点交换为队尾; 原队尾为空则直接获得锁
+ **     2. 否则挂到原队尾之后, 在本结点的locked上自旋等待前驱交出锁
+ **注意事项:
+ **作    者: # Qifeng.zou # 2015.09.15 #
+ ******************************************************************************/
+static inline void mcs_lock(mcs_lock_t *lck, mcs_node_t *node)
+{
+    int64_t prev;
+    uint32_t delay = 1;
+
+    node->next = 0;
+    node->locked = 1;
+
+    prev = (int64_t)atomic64_xset((volatile uint64_t *)&lck->tail, mcs_node_off(lck, node));
+    if (0 == prev) {
+        return;
+    }
+
+    mcs_node_addr(lck, prev)->next = mcs_node_off(lck, node);
+
+    while (node->locked) {
+        spin_backoff(&delay);
+    }
+    compiler_barrier();
+}
+
+/******************************************************************************
+ **函数名称: mcs_trylock
+ **功    能: 尝试加锁
+ **输入参数:
+ **     lck: MCS锁
+ **     node: 本次加锁使用的结点
+ **输出参数: NONE
+ **返    回: 0:成功 !0:失败
+ **实现描述: 仅当队列为空时获得锁
+ **注意事项:
+ **作    者: # Qifeng.zou # 2015.09.15 #
+ ******************************************************************************/
+static inline int mcs_trylock(mcs_lock_t *lck, mcs_node_t *node)
+{
+    if (0 != lck->tail) {
+        return -1;
+    }
+
+    node->next = 0;
+    node->locked = 0;
+
+    return atomic64_cmp_and_set((volatile uint64_t *)&lck->tail,
+            0, mcs_node_off(lck, node))? 0 : -1;
+}
+
+/******************************************************************************
+ **函数名称: mcs_unlock
+ **功    能: 解锁
+ **输入参数:
+ **     lck: MCS锁
+ **     node: 加锁时使用的结点
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述:
+ **     1. 无后继时, 若本结点仍为队尾则将锁置空
+ **     2. 否则等待后继完成挂接, 再将锁交给后继
+ **注意事项:
+ **作    者: # Qifeng.zou # 2015.09.15 #
+ ******************************************************************************/
+static inline void mcs_unlock(mcs_lock_t *lck, mcs_node_t *node)
+{
+    uint32_t delay = 1;
+
+    if (0 == node->next) {
+        if (atomic64_cmp_and_set((volatile uint64_t *)&lck->tail,
+                mcs_node_off(lck, node), 0))
+        {
+            return;
+        }
+
+        while (0 == node->next) {
+            spin_backoff(&delay);
+        }
+    }
+
+    compiler_barrier();
+    mcs_node_addr(lck, node->next)->locked = 0;
+}
+
+/* 销毁 */
+#define mcs_lock_destroy(lck) mcs_lock_init(lck)
+
+#endif /*__MCS_LOCK_H__*/
@@ -0,0 +1,199 @@
+#if !defined(__METRICS_H__)
+#define __METRICS_H__
+
+#include "comm.h"
+
+/******************************************************************************
+ **
+ ** 进程内统计(计数器/仪表/延迟直方图)
+ **     1. 按名称注册, 返回统计项; 同名重复注册返回同一统计项;
+ **     2. 每个线程首次更新时分配本线程的分片, 更新只修改本线程的分片(无锁,
+ **        无原子操作). 线程退出时分片并入全局, 计数不会回退;
+ **     3. 导出线程每隔一段时间汇总各分片, 写入共享内存快照(顺序锁保护).
+ **        tools/metrics_top.py附着共享内存读取快照, 不影响业务线程.
+ **
+ ** 直方图采用对数-线性分桶: 每个2的幂区间再等分为METRICS_HIST_SUB_NUM个桶,
+ ** 相对误差不超过1/METRICS_HIST_SUB_NUM; 小于METRICS_HIST_SUB_NUM的值各占一桶.
+ **
+ ******************************************************************************/
+#define METRICS_MAGIC           (0x4D455452)/* 共享内存魔术字("METR") */
+#define METRICS_VERSION         (1)         /* 共享内存格式版本 */
+#define METRICS_MAX_NUM         (256)       /* 统计项最大个数 */
+#define METRICS_HIST_MAX_NUM    (32)        /* 直方图最大个数 */
+#define METRICS_NAME_MAX_LEN    (64)        /* 名称最大长度 */
+#define METRICS_SLOT_MAX_NUM    (8192)      /* 每个线程分片的槽位数 */
+#define METRICS_EXPORT_MSEC     (100)       /* 默认导出间隔(毫秒) */
+
+#define METRICS_HIST_SUB_BITS   (2)
+#define METRICS_HIST_SUB_NUM    (1 << METRICS_HIST_SUB_BITS) /* 每个2的幂区间的桶数 */
+#define METRICS_HIST_BUCKET_NUM /* 直方图桶数(覆盖64位整数) */\
+    (METRICS_HIST_SUB_NUM + (64 - METRICS_HIST_SUB_BITS) * METRICS_HIST_SUB_NUM)
+
+/* 统计类型 */
+typedef enum
+{
+    METRICS_COUNTER                         /* 计数器(只增) */
+    , METRICS_GAUGE                         /* 仪表(可增可减, 或直接设置) */
+    , METRICS_HISTOGRAM                     /* 直方图(次数/总和/分桶) */
+} metrics_type_e;
+
+/* 统计项 */
+typedef struct
+{
+    int idx;                                /* 序号 */
+    int type;                               /* 统计类型(metrics_type_e) */
+    int off;                                /* 在线程分片中的槽位 */
+    int hist;                               /* 直方图序号(-1:非直方图) */
+    volatile int64_t base;                  /* 仪表的设置值(metrics_gauge_set()) */
+    char name[METRICS_NAME_MAX_LEN];        /* 名称 */
+} metrics_t;
+
+/* 线程分片 */
+typedef struct _metrics_shard_t
+{
+    volatile uint64_t slot[METRICS_SLOT_MAX_NUM]; /* 槽位(只由所属线程修改) */
+    struct _metrics_shard_t *next;          /* 下一个分片 */
+} metrics_shard_t;
+
+/* 共享内存: 统计项快照 */
+typedef struct
+{
+    char name[METRICS_NAME_MAX_LEN];        /* 名称 */
+    int32_t type;                           /* 统计类型 */
+    int32_t hist;                           /* 直方图序号(-1:非直方图) */
+    int64_t value;                          /* 计数器/仪表的值; 直方图的次数 */
+    uint64_t sum;                           /* 直方图的总和 */
+} metrics_shm_item_t;
+
+/* 共享内存: 快照 */
+typedef struct
+{
+    uint32_t magic;                         /* 魔术字(METRICS_MAGIC) */
+    uint32_t version;                       /* 版本号(METRICS_VERSION) */
+    volatile uint64_t seq;                  /* 顺序锁(奇数:正在更新) */
+    uint64_t time;                          /* 快照时间(毫秒) */
+    int32_t pid;                            /* 进程号 */
+    uint32_t num;                           /* 统计项个数 */
+    uint32_t hist_sub_bits;                 /* METRICS_HIST_SUB_BITS */
+    uint32_t hist_bucket_num;               /* METRICS_HIST_BUCKET_NUM */
+    metrics_shm_item_t item[METRICS_MAX_NUM];  /* 统计项 */
+    uint64_t bucket[METRICS_HIST_MAX_NUM][METRICS_HIST_BUCKET_NUM]; /* 直方图分桶 */
+} metrics_shm_t;
+
+/* 外部接口 */
+int metrics_init(const char *path, int msec);
+metrics_t *metrics_counter(const char *name);
+metrics_t *metrics_gauge(const char *name);
+metrics_t *metrics_histogram(const char *name);
+int64_t metrics_value(const metrics_t *m);
+int metrics_export(void);
+
+/* 内部接口 */
+extern __thread metrics_shard_t *g_metrics_shard;
+metrics_shard_t *metrics_shard_creat(void);
+
+/* 获取当前线程的分片 */
+static inline volatile uint64_t *metrics_slot(const metrics_t *m)
+{
+    metrics_shard_t *shard = g_metrics_shard;
+
+    if (NULL == shard) {
+        shard = metrics_shard_creat();
+        if (NULL == shard) {
+            return NULL;
+        }
+    }
+
+    return &shard->slot[m->off];
+}
+
+/******************************************************************************
+ **函数名称: metrics_counter_add
+ **功    能: 计数器增加
+ **输入参数:
+ **     m: 统计项(为NULL时忽略)
+ **     n: 增加值
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述: 只修改本线程的分片
+ **注意事项:
+ **作    者: # Qifeng.zou # 2015.09.29 #
+ ******************************************************************************/
+static inline void metrics_counter_add(const metrics_t *m, uint64_t n)
+{
+    volatile uint64_t *slot;
+
+    if (NULL == m || NULL == (slot = metrics_slot(m))) {
+        return;
+    }
+
+    *slot += n;
+}
+
+#define metrics_counter_inc(m) metrics_counter_add(m, 1)
+
+/* 仪表增减(各线程分片之和加上设置值即为当前值) */
+static inline void metrics_gauge_add(const metrics_t *m, int64_t n)
+{
+    volatile uint64_t *slot;
+
+    if (NULL == m || NULL == (slot = metrics_slot(m))) {
+        return;
+    }
+
+    *slot += (uint64_t)n;
+}
+
+#define metrics_gauge_inc(m) metrics_gauge_add(m, 1)
+#define metrics_gauge_dec(m) metrics_gauge_add(m, -1)
+
+/* 仪表设置(同一仪表应只使用设置或只使用增减) */
+static inline void metrics_gauge_set(metrics_t *m, int64_t val)
+{
+    if (NULL != m) {
+        m->base = val;
+    }
+}
+
+/* 计算值所在的直方图分桶 */
+static inline int metrics_hist_bucket(uint64_t val)
+{
+    int e;
+
+    if (val < METRICS_HIST_SUB_NUM) {
+        return (int)val;
+    }
+
+    e = 63 - __builtin_clzll(val);
+
+    return METRICS_HIST_SUB_NUM
+        + ((e - METRICS_HIST_SUB_BITS) << METRICS_HIST_SUB_BITS)
+        + (int)((val >> (e - METRICS_HIST_SUB_BITS)) & (METRICS_HIST_SUB_NUM - 1));
+}
+
+/******************************************************************************
+ **函数名称: metrics_hist_observe
+ **功    能: 直方图记录一个值
+ **输入参数:
+ **     m: 统计项(为NULL时忽略)
+ **     val: 观测值(如耗时纳秒数)
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述: 槽位布局: [次数][总和][分桶0..METRICS_HIST_BUCKET_NUM-1]
+ **注意事项:
+ **作    者: # Qifeng.zou # 2015.09.29 #
+ ******************************************************************************/
+static inline void metrics_hist_observe(const metrics_t *m, uint64_t val)
+{
+    volatile uint64_t *slot;
+
+    if (NULL == m || NULL == (slot = metrics_slot(m))) {
+        return;
+    }
+
+    slot[0] += 1;
+    slot[1] += val;
+    slot[2 + metrics_hist_bucket(val)] += 1;
+}
+
+#endif /*__METRICS_H__*/
@@ -4,27 +4,55 @@
 #include "slot.h"
 #include "ring.h"
 
+#define QUEUE_POOL_MAX      (16)            /* 最大分级数 */
+#define QUEUE_CHUNK_NUM     (64)            /* 分级内存池每次扩充的单元数 */
+#define QUEUE_HEAD_SIZE     (16)            /* 分级单元头部(记录所属分级, 保持16字节对齐) */
+#define QUEUE_POOL_LARGE    (-1)            /* 超过最大分级: 直接从堆申请 */
+
 /* 队列配置 */
 typedef struct
 {
     int max;                                /* 单元总数 */
-    size_t size;                            /* 单元大小 */
+    size_t size;                            /* 单元大小(分级时: 最大分级的大小) */
+    size_t min;                             /* 最小分级的大小(0:不分级, 单元大小固定为size) */
 } queue_conf_t;
 
+/* 分级内存池(单元按需扩充) */
+typedef struct
+{
+    int size;                               /* 单元大小(不含头部) */
+    int limit;                              /* 单元数上限 */
+    volatile int num;                       /* 已创建单元数 */
+    spinlock_t lock;                        /* 扩充锁 */
+    ring_t *free;                           /* 空闲单元 */
+    void *chunk;                            /* 内存块链表(首8字节指向下一块) */
+} queue_pool_t;
+
 /* 队列 */
 typedef struct
 {
-    slot_t *slot;                           /* 内存池 */
+    slot_t *slot;                           /* 内存池(固定大小; 分级时为NULL) */
     ring_t *ring;                           /* 队列 */
+
+    int pool_num;                           /* 分级数 */
+    queue_pool_t *pool;                     /* 分级内存池(按单元大小升序) */
 } queue_t;
 
 queue_t *queue_creat(int max, int size);
-#define queue_malloc(q, size) slot_alloc((q)->slot, size)
-static inline void queue_dealloc(queue_t *q, void *p) { slot_dealloc((q)->slot, p); }
+queue_t *queue_creat_ex(int max, int min, int size);
+void *queue_pool_alloc(queue_t *q, int size);
+void queue_pool_dealloc(queue_t *q, void *p);
+static inline void *queue_malloc(queue_t *q, int size)
+    { return (NULL != q->slot)? slot_alloc(q->slot, size) : queue_pool_alloc(q, size); }
+static inline void queue_dealloc(queue_t *q, void *p)
+    { if (NULL != q->slot) { slot_dealloc(q->slot, p); } else { queue_pool_dealloc(q, p); } }
+#define queue_flush(q) do { if (NULL != (q)->slot) { slot_flush((q)->slot); } } while(0) /* 归还本线程缓存的内存块 */
 #define queue_push(q, addr) ring_push((q)->ring, addr)
 #define queue_mpush(q, addr, num) ring_mpush((q)->ring, addr, num)
 #define queue_pop(q) ring_pop((q)->ring)
 #define queue_mpop(q, addr, num) ring_mpop((q)->ring, addr, num)
+#define queue_push_burst(q, addr, num) ring_push_burst((q)->ring, addr, num)
+#define queue_pop_burst(q, addr, num) ring_pop_burst((q)->ring, addr, num)
 #define queue_print(q) ring_print((q)->ring)
 void queue_destroy(queue_t *q);
 
@@ -33,6 +61,7 @@ void queue_destroy(queue_t *q);
 #define queue_used(q) ring_used((q)->ring)
 #define queue_empty(q) !ring_used((q)->ring)
 #define queue_max(q) ring_max((q)->ring)
-#define queue_size(q) slot_size((q)->slot)
+#define queue_isfixed(q) (NULL != (q)->slot)    /* 单元大小是否固定(否则可申请任意大小) */
+#define queue_size(q) (queue_isfixed(q)? slot_size((q)->slot) : (q)->pool[(q)->pool_num-1].size)
 
 #endif /*__QUEUE_H__*/
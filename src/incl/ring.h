@@ -3,36 +3,62 @@
 
 #include "log.h"
 
-/* 环形无锁队列 */
+/* 队列标志 */
+#define RING_FLAG_MPMC  (0)                 /* 多生产者/多消费者 */
+#define RING_FLAG_SP    (0x01)              /* 单生产者(入队无需CAS) */
+#define RING_FLAG_SC    (0x02)              /* 单消费者(出队无需CAS) */
+#define RING_FLAG_SPSC  (RING_FLAG_SP | RING_FLAG_SC)
+
+/* 队列单元 */
+typedef struct
+{
+    volatile unsigned int seq;              /* 序列号(标识单元状态) */
+    void *data;                             /* 数据地址 */
+} ring_cell_t;
+
+/* 环形无锁队列
+ *  单元序列号seq与位置pos的关系:
+ *      seq == pos: 单元空闲, 可由申请到pos的生产者写入
+ *      seq == pos + 1: 单元已写入, 可由申请到pos的消费者读取
+ *      读取后置seq = pos + max, 供下一轮的生产者使用
+ *  生产者/消费者只需等待自己的单元, 不再等待其他线程推进尾索引. */
 typedef struct
 {
     unsigned int max;                       /* 队列容量(注: 必须为2的次方) */
     unsigned int mask;                      /* 掩码值Mask = (max - 1) */
-    volatile unsigned int num;              /* 队列成员个数 */
+    int flag;                               /* 队列标志(RING_FLAG_XXX) */
 
-    void **data;                            /* 指针数组(对其构造循环队列) */
+    ring_cell_t *cell;                      /* 单元数组(对其构造循环队列) */
 
-    /* 生产者 */
+    /* 生产者(注: 生产者和消费者分处不同的缓存行, 避免伪共享) */
     struct {
         volatile unsigned int head;         /* 生产者: 头索引(注: 其值一直往上递增) */
-        volatile unsigned int tail;         /* 生产者: 尾索引(注: 其值一直往上递增) */
-    } prod;
+    } prod __attribute__((aligned(64)));
 
     /* 消费者 */
     struct {
         volatile unsigned int head;         /* 消费者: 头索引(注: 其值一直往上递增) */
-        volatile unsigned int tail;         /* 消费者: 尾索引(注: 其值一直往上递增) */
-    } cons;
+    } cons __attribute__((aligned(64)));
 } ring_t;
 
 ring_t *ring_creat(int max);
+ring_t *ring_creat_ex(int max, int flag);
 int ring_push(ring_t *rq, void *addr);
 int ring_mpush(ring_t *rq, void **addr, unsigned int num);
+int ring_push_burst(ring_t *rq, void **addr, unsigned int num);
 void *ring_pop(ring_t *rq);
 int ring_mpop(ring_t *rq, void **addr, unsigned int num);
+int ring_pop_burst(ring_t *rq, void **addr, unsigned int num);
 void ring_print(ring_t *rq);
 void ring_destroy(ring_t *rq);
 #define ring_max(rq) ((rq)->max)
-#define ring_used(rq) ((rq)->num)
+
+/* 获取队列成员个数(注: 先读消费者头再读生产者头, 保证结果不会为负) */
+static inline unsigned int ring_used(ring_t *rq)
+{
+    unsigned int cons_head = rq->cons.head;
+
+    return rq->prod.head - cons_head;
+}
 
 #endif /*__RING_H__*/
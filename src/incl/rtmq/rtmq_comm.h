@@ -7,6 +7,7 @@
 #include "pipe.h"
 #include "queue.h"
 #include "iovec.h"
+#include "metrics.h"
 #include "rtmq_mesg.h"
 
 #define RTMQ_RECONN_INTV        (2)     /* 连接重连间隔 */
@@ -106,6 +107,9 @@ typedef struct
     uint64_t proc_total;                /* 已处理条数 */
     uint64_t drop_total;                /* 丢弃条数 */
     uint64_t err_total;                 /* 错误条数 */
+    metrics_t *proc_metric;             /* 统计项: 已处理条数 */
+    metrics_t *drop_metric;             /* 统计项: 丢弃条数 */
+    metrics_t *err_metric;              /* 统计项: 错误条数 */
 } rtmq_worker_t;
 
 /******************************************************************************
@@ -8,7 +8,9 @@
 #include "iovec.h"
 #include "list2.h"
 #include "queue.h"
+#include "bptree.h"
 #include "vector.h"
+#include "trace.h"
 #include "shm_opt.h"
 #include "spinlock.h"
 #include "avl_tree.h"
@@ -21,6 +23,15 @@
 #define RTMQ_CTX_POOL_SIZE          (5 * MB)/* 全局内存池空间 */
 #define RTMQ_CONNQ_LEN              (8192)  /* 连接队列长度 */
 
+/* 跟踪阶段(见trace.h, 按处理先后编号) */
+typedef enum
+{
+    RTMQ_TRACE_READ                     /* 接收线程读取数据 */
+    , RTMQ_TRACE_PUSH                   /* 放入接收队列 */
+    , RTMQ_TRACE_DISPATCH               /* 工作线程开始处理 */
+    , RTMQ_TRACE_DONE                   /* 回调处理完成 */
+} rtmq_trace_stage_e;
+
 /* 鉴权信息 */
 typedef struct
 {
@@ -110,6 +121,11 @@ typedef struct
     uint64_t recv_total;                /* 获取的数据总条数 */
     uint64_t err_total;                 /* 错误的数据条数 */
     uint64_t drop_total;                /* 丢弃的数据条数 */
+    metrics_t *recv_metric;             /* 统计项: 获取的数据条数 */
+    metrics_t *err_metric;              /* 统计项: 错误的数据条数 */
+    metrics_t *drop_metric;             /* 统计项: 丢弃的数据条数 */
+
+    uint64_t read_tsc;                  /* 最近一次读取数据的时刻(仅在启用跟踪时更新) */
 } rtmq_rsvr_t;
 
 /* 接收数据项 */
@@ -117,6 +133,7 @@ typedef struct
 {
     void *base;                         /* 内存块首地址: 用于内存引用计数 */
     void *data;                         /* 数据地址: 真实数据地址 */
+    uint64_t trace_id;                  /* 跟踪ID(0:未被抽样) */
 } rtmq_recv_item_t;
 
 /* 新增连接项 */
@@ -155,9 +172,9 @@ typedef struct
                                            此队列, 再从此队列分发到不同的线程队列 */
 
     pthread_rwlock_t node_to_svr_map_lock;  /* 读写锁: NODE->SVR映射表 */
-    avl_tree_t *node_to_svr_map;        /* NODE->SVR的映射表(以nid为主键 rtmq_node_to_svr_map_t) */
+    bptree_t *node_to_svr_map;          /* NODE->SVR的映射表(以nid为主键 rtmq_node_to_svr_map_t) */
 
-    hash_tab_t *sub;                   /* 订阅表(注:以type为主键, 存储rtmq_sub_list_t类型) */
+    hash_map_t *sub;                   /* 订阅表(注:以type为主键, 存储rtmq_sub_list_t类型) */
 } rtmq_cntx_t;
 
 /* 外部接口 */
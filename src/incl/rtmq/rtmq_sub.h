@@ -4,7 +4,7 @@
 #include "comm.h"
 #include "mesg.h"
 #include "vector.h"
-#include "hash_tab.h"
+#include "hash_map.h"
 
 /* 订阅连接 */
 typedef struct
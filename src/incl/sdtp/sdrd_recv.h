@@ -7,6 +7,7 @@
 #include "comm.h"
 #include "list2.h"
 #include "queue.h"
+#include "bptree.h"
 #include "shm_opt.h"
 #include "avl_tree.h"
 #include "sdtp_comm.h"
@@ -15,6 +16,9 @@
 
 /* 宏定义 */
 #define SDTP_CTX_POOL_SIZE      (5 * MB)/* 全局内存池空间 */
+#define SDRD_EVENT_MAX_NUM      (2048)  /* 单次处理的最大事件数 */
+#define SDRD_TMOUT_MSEC         (1000)  /* 事件等待超时(毫秒) */
+#define SDRD_TMOUT_SCAN_SEC     (1)     /* 超时扫描间隔(秒) */
 
 /* Recv线程的UNIX-UDP路径 */
 #define sdrd_rsvr_usck_path(conf, path, id) \
@@ -75,6 +79,9 @@ typedef struct _sdrd_sck_t
 
     list_t *mesg_list;                  /* 发送消息链表 */
 
+    list2_node_t *node;                 /* 所在连接链表的结点 */
+    uint32_t events;                    /* 已注册的epoll事件 */
+
     uint64_t recv_total;                /* 接收的数据条数 */
 } sdrd_sck_t;
 
@@ -99,11 +106,14 @@ typedef struct
     log_cycle_t *log;                   /* 日志对象 */
 
     int cmd_sck_id;                     /* 命令套接字 */
+    int evfd;                           /* 事件通知(发送队列有数据时由分发线程通知) */
+
+    int epid;                           /* epoll描述符 */
+    int fds;                            /* 处于就绪状态的套接字数 */
+    struct epoll_event *events;         /* 事件数组 */
 
-    int max;                            /* 最大套接字 */
     time_t ctm;                         /* 当前时间 */
-    fd_set rdset;                       /* 可读集合 */
-    fd_set wrset;                       /* 可写集合 */
+    time_t scan_tm;                     /* 上次超时扫描时间 */
     list2_t *conn_list;                 /* 套接字链表 */
 
     /* 队列缓存 */
@@ -150,7 +160,7 @@ typedef struct
                                            此队列, 再从此队列分发到不同的线程队列 */
 
     pthread_rwlock_t node_to_svr_map_lock;  /* 读写锁: NODE->SVR映射表 */
-    avl_tree_t *node_to_svr_map;         /* NODE->SVR的映射表(以nid为主键 sdrd_node_item_t) */
+    bptree_t *node_to_svr_map;           /* NODE->SVR的映射表(以nid为主键 sdrd_node_item_t) */
 } sdrd_cntx_t;
 
 /* 外部接口 */
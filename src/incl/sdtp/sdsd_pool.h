@@ -1,9 +1,9 @@
 #if !defined(__SDSD_H__)
 #define __SDSD_H__
 
-#include "ticket_lock.h"
+#include "atomic.h"
 
-#define SDSD_POOL_PAGE_NUM   (4)    /* 缓存池页数: 页越多锁冲突越小 但消耗更多的内存 */
+#define SDSD_POOL_PAGE_NUM   (4)    /* 缓存池页数: 页越多冲突越小 但消耗更多的内存 */
 
 /**
  *   |<------------------------------ 共享内存 ------------------------------>|
@@ -15,25 +15,35 @@
  *   |    |<--- off --->|                   |<---------- off ---------->|     |
  *   |    |<-------------- size ----------->|<-------------- size ----------->|
  *  addr buf[0]                            buf[1]
+ *
+ *  各记录在页内的布局: |sdtp_header_t|报体|sdtp_header_t|报体|...
+ *  1. 生产者通过原子加(off)预留空间, 无锁拷贝数据, 最后写入chksum作为提交标志;
+ *  2. 发送线程封页后逐条检查chksum, 只有全部记录提交完成后才发送该页.
  */
 
 typedef struct
 {
     int idx;                                /* 页号 */
-    ticketlock_t lock;                      /* 锁 */
 
     size_t begin;                           /* 开始偏移(从共享内存起始处计算) */
     size_t size;                            /* 缓存总长 */
     size_t end;                             /* 结束偏移 */
 
-    size_t off;                             /* 已用长度 */
+#define SDSD_POOL_SEALED    (0x8000000000000000UL)  /* 封页标志(禁止继续预留空间) */
+    volatile uint64_t off;                  /* 已预留长度(最高位为封页标志)
+                                               注: 生产者通过原子加预留空间, 无需加锁 */
+#define SDSD_POOL_INVALID_OFF   ((size_t)-1)/* 无效偏移 */
+    volatile size_t limit;                  /* 首个越界预留的起始偏移(由越界的生产者设置) */
+    size_t len;                             /* 可发送数据长度(封页且提交完成后设置) */
+    size_t chk;                             /* 已确认提交的偏移(只由发送线程修改) */
 
 #define SDSD_MOD_WR        (0)              /* 权限:写 */
-#define SDSD_MOD_RD        (1)              /* 权限:读 */
+#define SDSD_MOD_SEAL      (1)              /* 权限:已封页, 等待生产者提交 */
+#define SDSD_MOD_RD        (2)              /* 权限:读 */
     int mode;                               /* 当前权限(只能由发送线程修改) */
-    int num;                                /* 数据块数 */
+    int num;                                /* 数据块数(只由发送线程统计) */
     time_t send_tm;                         /* 上次数据发送时间 */
-} sdsd_pool_page_t;
+} __attribute__((aligned(64))) sdsd_pool_page_t;
 
 typedef struct
 {
@@ -13,6 +13,8 @@
 #define sdsd_worker_usck_path(conf, path, id) \
     snprintf(path, sizeof(path), "../temp/sdtp/send/%s/usck/%s_swrk_%d.usck", conf->name, conf->name, id+1)
 
+#define SDSD_EVENT_MAX_NUM      (8)     /* 单次处理的最大事件数 */
+
 /* 发送类型 */
 typedef enum
 {
@@ -37,6 +39,7 @@ typedef struct
                                             1: 已发送保活
                                             2: 保活成功 */
     list_t *mesg_list;                  /* 发送链表 */
+    uint32_t events;                    /* 已注册的epoll事件 */
 
     sdtp_snap_t recv;                   /* 接收快照 */
     sdtp_send_snap_e send_type;         /* 发送类型(系统数据或自定义数据) */
@@ -55,9 +58,9 @@ typedef struct
     int cmd_sck_id;                     /* 命令通信套接字ID */
     sdsd_sck_t sck;                    /* 发送套接字 */
 
-    int max;                            /* 套接字最大值 */
-    fd_set rset;                        /* 读集合 */
-    fd_set wset;                        /* 写集合 */
+    int epid;                           /* epoll描述符 */
+    int fds;                            /* 处于就绪状态的套接字数 */
+    struct epoll_event events[SDSD_EVENT_MAX_NUM]; /* 事件数组 */
     slab_pool_t *pool;                  /* 内存池 */
 
     /* 统计信息 */
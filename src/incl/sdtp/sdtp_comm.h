@@ -5,6 +5,7 @@
 #include "log.h"
 #include "comm.h"
 #include "queue.h"
+#include "metrics.h"
 #include "sdtp_mesg.h"
 
 #define SDTP_NAME_MAX_LEN       (64)    /* 名称长度 */
@@ -105,6 +106,7 @@ typedef struct
     log_cycle_t *log;                   /* 日志对象 */
 
     int cmd_sck_id;                     /* 命令套接字 */
+    int evfd;                           /* 事件通知(接收线程放入数据后通知) */
 
     int max;                            /* 套接字最大值 */
     fd_set rdset;                       /* 可读套接字集合 */
@@ -112,6 +114,9 @@ typedef struct
     uint64_t proc_total;                /* 已处理条数 */
     uint64_t drop_total;                /* 丢弃条数 */
     uint64_t err_total;                 /* 错误条数 */
+    metrics_t *proc_metric;             /* 统计项: 已处理条数 */
+    metrics_t *drop_metric;             /* 统计项: 丢弃条数 */
+    metrics_t *err_metric;              /* 统计项: 错误条数 */
 } sdtp_worker_t;
 
 /******************************************************************************
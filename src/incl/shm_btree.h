@@ -4,6 +4,7 @@
 #include "comm.h"
 #include "redo.h"
 #include "shm_slab.h"
+#include "spinlock.h"
 
 /******************************************************************************
  **
@@ -16,19 +17,27 @@
  **      -----------------------------------------------------------------
  **     ^       ^
  **     |       |
- **   btree    pool 
+ **   btree    pool
  **     btree: B树对象
  **     pool: 内存池对象
+ **
+ ** 并发控制(乐观锁耦合):
+ **     1. 写操作之间通过btree->lock互斥;
+ **     2. 每个结点有版本号, 写者修改结点前后各加1(奇数表示正在修改);
+ **     3. 读者不加锁: 记下结点版本号后读取内容, 进入孩子前校验父结点版本号
+ **        未变, 否则从根重新开始. 根的变化由btree->version保护;
+ **     4. 释放的结点只放入结点空闲链表(不归还内存池), 保证读者读到的始终是
+ **        结点, 其版本号单调递增.
  ******************************************************************************/
 
-/* B树结点 */
+#define SHM_BTREE_SPIN_MAX  (1024)                  /* 读者等待修改完成的自旋次数 */
+
+/* B树结点(其后依次为: int key[max+1]; off_t data[max+1]; off_t child[max+2]) */
 typedef struct _shm_btree_node_t
 {
+    volatile uint64_t version;                      /* 版本号(奇数: 正在修改) */
     int num;                                        /* 关键字数 */
-    off_t key;                                      /* 关键字(int *) */
-    off_t data;                                     /* 结点承载(void **) */
-    off_t child;                                    /* 孩子结点(shm_btree_node_t **) */
-    off_t parent;                                   /* 父亲结点(shm_btree_node_t *) */
+    off_t parent;                                   /* 父亲结点(空闲时: 下一空闲结点) */
 } shm_btree_node_t;
 
 /* B树对象 */
@@ -39,6 +48,11 @@ typedef struct
     int sep_idx;                                    /* 结点分化的分割索引 */
     off_t root;                                     /* 根结点(shm_btree_node_t *) */
 
+    spinlock_t lock;                                /* 写锁 */
+    volatile uint64_t version;                      /* 根的版本号(奇数: 正在修改) */
+    off_t free;                                     /* 空闲结点链表 */
+    uint64_t num;                                   /* 关键字总数 */
+
     size_t total;                                   /* 总大小 */
 } shm_btree_t;
 
@@ -51,11 +65,17 @@ typedef struct
     shm_slab_pool_t *pool;                          /* 内存池 */
 } shm_btree_cntx_t;
 
+/* 范围遍历回调(返回非0时停止) */
+typedef int (*shm_btree_trav_cb_t)(int key, void *data, void *args);
+
 extern shm_btree_cntx_t *shm_btree_creat(const char *path, int m, size_t total);
 shm_btree_cntx_t *shm_btree_attach(const char *path, int m, size_t total);
 int shm_btree_insert(shm_btree_cntx_t *ctx, int key, void *data);
 int shm_btree_remove(shm_btree_cntx_t *ctx, int key);
 void *shm_btree_query(shm_btree_cntx_t *ctx, int key);
+int shm_btree_query_copy(shm_btree_cntx_t *ctx, int key, void *buf, size_t size);
+int shm_btree_next(shm_btree_cntx_t *ctx, int key, bool inclusive, int *next, void **data);
+int shm_btree_range(shm_btree_cntx_t *ctx, int min, int max, shm_btree_trav_cb_t proc, void *args);
 int shm_btree_dump(shm_btree_cntx_t *ctx);
 extern int shm_btree_destroy(shm_btree_cntx_t *ctx);
 void shm_btree_print(shm_btree_cntx_t *ctx);
@@ -63,5 +83,6 @@ void shm_btree_print(shm_btree_cntx_t *ctx);
 void *shm_btree_alloc(shm_btree_cntx_t *ctx, size_t size);
 #define shm_btree_alloc(ctx, size) shm_slab_alloc((ctx)->pool, (size))
 #define shm_btree_dealloc(ctx, ptr) shm_slab_dealloc((ctx)->pool, (ptr))
+#define shm_btree_num(ctx) ((ctx)->btree->num)
 
 #endif /*__SHM_BTREE_H__*/
@@ -14,32 +14,75 @@
  *   ^          ^            ^                ^
  *   |          |            |                |
  *  addr       slot         node             data
+ *
+ * 扩容(线性哈希): 哈希槽按slot_max预分配, 初始只使用len个槽. 平均链长超过
+ * SHM_HASH_LOAD_MAX时, 由插入者逐个分裂槽, 当前槽数 = (len << level) + split.
+ * 分裂过程记录在头部日志中, 执行分裂的进程异常退出后, 其他进程可接管并续做.
+ * 槽锁记录持有者的进程ID, 只有确认持有者已退出(kill(pid, 0)返回ESRCH)时才
+ * 被接管, 持有者仍存活时(即使被抢占或暂停)一直等待.
  */
 
+#define SHM_HASH_LOAD_MAX   (2)     /* 每个槽的平均结点数上限 */
+#define SHM_HASH_SPLIT_NUM  (2)     /* 每次插入最多分裂的槽数 */
+
+/* 迁移阶段 */
+typedef enum
+{
+    SHM_HASH_MOVE_IDLE              /* 空闲(原槽和新槽的锁均由扩容者持有) */
+    , SHM_HASH_MOVE_LOCK            /* 正在加锁或解锁(两个槽的锁不一定由扩容者持有) */
+    , SHM_HASH_MOVE_UNLINK          /* 正从原槽摘除 */
+    , SHM_HASH_MOVE_LINK            /* 正挂入新槽 */
+} shm_hash_move_e;
+
+/* 哈希结点 */
+typedef struct
+{
+    shm_list_node_t list;           /* 链表结点(注: 必须为第一个成员) */
+    uint64_t hash;                  /* 哈希值(分裂时据此迁移) */
+} shm_hash_node_t;
+
 /* 哈希槽 */
 typedef struct
 {
-    spinlock_t lock;                /* 链表锁 */
+    volatile uint32_t lock;         /* 链表锁: 持有者的进程ID(0: 未锁) */
     shm_list_t list;                /* 链表 */
 } shm_hash_slot_t;
 
+/* 分裂日志 */
+typedef struct
+{
+    int slot;                       /* 正在分裂的槽(-1: 无) */
+    uint64_t lsp;                   /* 分裂开始时的level/split */
+    volatile int phase;             /* 迁移阶段(shm_hash_move_e) */
+    off_t node;                     /* 正在迁移的结点 */
+    off_t head;                     /* 新槽原链头 */
+    off_t tail;                     /* 新槽原链尾 */
+} shm_hash_journal_t;
+
 /* 头部信息 */
 typedef struct
 {
-    int len;                        /* 哈希数组长度 */
+    int len;                        /* 哈希数组长度(初始槽数) */
     int max;                        /* 结点最大个数 */
     size_t size;                    /* 数据结点单元大小 */
+    int slot_max;                   /* 哈希槽最大个数(预分配) */
     off_t slot_off;                 /* 哈希槽起始偏移 */
-    off_t node_off;                 /* 结点单元起始偏移 */
-    off_t data_off;                 /* 数据单元起始偏移 */
+    off_t node_off;                 /* 结点队列起始偏移 */
+    off_t data_off;                 /* 数据队列起始偏移 */
+
+    volatile uint32_t num;          /* 结点总数 */
+    volatile uint64_t lsp;          /* 扩容进度(高32位: level 低32位: split) */
+    volatile uint32_t owner;        /* 正在扩容的进程ID(0: 无) */
+    shm_hash_journal_t journal;     /* 分裂日志 */
 } shm_hash_head_t;
 
 /* 哈希表 */
 typedef struct
 {
     void *addr;                     /* 首地址 */
+    uint32_t pid;                   /* 当前进程ID(槽锁及扩容权的持有者标识) */
     shm_hash_head_t *head;          /* 头部信息 */
-    shm_hash_slot_t *slot;          /* 哈希槽数组(其长度为head->len) */
+    shm_hash_slot_t *slot;          /* 哈希槽数组(其长度为head->slot_max) */
     shm_ring_t *node_pool;          /* 链表结点内存池(用于链表结点空间的申请和回收)
                                        未被使用的结点在此队列中 */
     shm_ring_t *data_pool;          /* 数据结点内存池(用于数据结点空间的申请和回收)
@@ -47,10 +90,13 @@ typedef struct
 } shm_hash_t;
 
 shm_hash_t *shm_hash_creat(const char *path, int len, int max, size_t size);
+shm_hash_t *shm_hash_attach(const char *path);
 void *shm_hash_alloc(shm_hash_t *sh);
 void shm_hash_dealloc(shm_hash_t *sh, void *addr);
 
 int shm_hash_push(shm_hash_t *sh, void *key, int len, void *data);
 void *shm_hash_pop(shm_hash_t *sh, void *key, int len, cmp_cb_t cmp_cb);
 
+#define shm_hash_total(sh) ((sh)->head->num)
+
 #endif /*__SHM_HASH_H__*/
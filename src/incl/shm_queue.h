@@ -28,6 +28,8 @@ int shm_queue_push(shm_queue_t *shmq, void *p);
 int shm_queue_mpush(shm_queue_t *shmq, void **p, int num);
 void *shm_queue_pop(shm_queue_t *shmq);
 int shm_queue_mpop(shm_queue_t *shmq, void **p, int _num);
+void *shm_queue_pop_wait(shm_queue_t *shmq, int msec);
+int shm_queue_mpop_wait(shm_queue_t *shmq, void **p, int num, int msec);
 
 #define shm_queue_print(shmq) shm_ring_print((shmq)->ring)
 #define shm_queue_isempty(shmq) shm_ring_isempty((shmq)->ring)
@@ -9,6 +9,8 @@ typedef struct
     unsigned int max;                       /* 队列容量(注: 必须为2的次方) */
     unsigned int mask;                      /* 掩码值Mask = (max - 1) */
     volatile unsigned int num;              /* 队列成员个数 */
+    volatile uint32_t seq;                  /* 压入序列号(futex字: 每次压入加1) */
+    volatile uint32_t waits;                /* 等待者个数(为0时压入方无需唤醒) */
 
     /* 生产者 */
     struct
@@ -32,6 +34,7 @@ int shm_ring_push(shm_ring_t *rq, off_t off);
 int shm_ring_mpush(shm_ring_t *rq, off_t *off, unsigned int num);
 off_t shm_ring_pop(shm_ring_t *rq);
 int shm_ring_mpop(shm_ring_t *rq, off_t *off, unsigned int num);
+int shm_ring_mpop_wait(shm_ring_t *rq, off_t *off, unsigned int num, int msec);
 void shm_ring_print(shm_ring_t *rq);
 #define shm_ring_isempty(ring) (0 == (ring)->num)
 #define shm_ring_used(ring) ((ring)->num)
@@ -11,6 +11,17 @@
 #include "log.h"
 #include "spinlock.h"
 
+/* 每CPU缓存
+ *  1. 共享内存中为每个CPU设置一组分级缓存(记录空闲块的偏移量), 各进程共用;
+ *  2. 申请和回收先尝试当前CPU的缓存, 只竞争该CPU的锁(通常无竞争), 锁被占用时
+ *     (如进程被调度到其他CPU)直接走全局锁;
+ *  3. 缓存为空时加一次全局锁批量补充, 缓存满时加一次全局锁批量归还一半;
+ *  4. 缓存位于共享内存而非进程私有, 进程退出不会遗留块. */
+#define SHM_SLAB_CPU_MAX        (64)        /* 每CPU缓存的最大组数 */
+#define SHM_SLAB_CACHE_CLASS    (9)         /* 缓存分级数(8B, 16B, ..., 2KB) */
+#define SHM_SLAB_CACHE_SIZE     (32)        /* 每个分级最多缓存的块数 */
+#define SHM_SLAB_CACHE_BYTES    (16 * 1024) /* 每个分级最多缓存的字节数 */
+
 /* 内存分配方式 */
 typedef enum
 {
@@ -43,6 +54,16 @@ typedef struct
     int prev_idx;               /* 上一页的索引 */
 } shm_slab_page_t;
 
+/* 每CPU缓存 */
+typedef struct
+{
+    spinlock_t lock;            /* 锁 */
+    struct {
+        int num;                /* 缓存的块数 */
+        size_t offset[SHM_SLAB_CACHE_SIZE]; /* 缓存的块(相对内存池的偏移量) */
+    } slot[SHM_SLAB_CACHE_CLASS];
+} shm_slab_cache_t;
+
 typedef struct
 {
     spinlock_t lock;            /* 锁 */
@@ -58,13 +79,18 @@ typedef struct
 
     size_t slot_offset;         /* SLOT数组的起始偏移量 */
     size_t page_offset;         /* PAGE数组的起始偏移量 */
-	
+
+    int cpu_num;                /* 每CPU缓存的组数(0:不启用) */
+    size_t cache_size;          /* 每组缓存的大小(按缓存行对齐) */
+    size_t cache_offset;        /* 每CPU缓存的起始偏移量 */
+
     shm_slab_page_t free;       /* 空闲页链表 */
 } shm_slab_pool_t;
 
 int32_t shm_slab_init(shm_slab_pool_t *pool);
 void *shm_slab_alloc(shm_slab_pool_t *pool, size_t size);
 void shm_slab_dealloc(shm_slab_pool_t *pool, void *p);
+void shm_slab_flush(shm_slab_pool_t *pool);
 
 size_t shm_slab_head_size(size_t size);
 #endif /*__SHM_SLAB__*/
@@ -0,0 +1,52 @@
+#if !defined(__SHM_VRING_H__)
+#define __SHM_VRING_H__
+
+#include "comm.h"
+
+/* 记录标志 */
+#define SHM_VRING_FREE      (0)     /* 空闲(未提交) */
+#define SHM_VRING_DATA      (1)     /* 数据(已提交) */
+#define SHM_VRING_PAD       (2)     /* 填充(回绕时跳过队尾剩余空间) */
+
+#define SHM_VRING_ALIGN     (8)     /* 记录对齐 */
+
+/* 记录头 */
+typedef struct
+{
+    uint32_t len;                   /* 数据长度(不含记录头) */
+    volatile uint32_t flag;         /* 记录标志(取值: SHM_VRING_FREE/DATA/PAD) */
+} shm_vring_head_t;
+
+/* 变长环形队列(多生产者/单消费者) */
+typedef struct
+{
+    size_t size;                    /* 数据区大小(注: 必须为2的次方) */
+    size_t mask;                    /* 掩码值mask = (size - 1) */
+
+    volatile uint64_t head __attribute__((aligned(64))); /* 生产者: 已申请位置(一直往上递增) */
+    volatile uint64_t tail __attribute__((aligned(64))); /* 消费者: 已释放位置(一直往上递增) */
+
+    volatile uint32_t seq __attribute__((aligned(64))); /* 提交序列号(futex字) */
+    volatile uint32_t waits;        /* 等待者个数 */
+} shm_vring_t;
+
+#define shm_vring_data(vr) ((char *)((vr) + 1))
+#define shm_vring_rec_size(len) mem_align(sizeof(shm_vring_head_t) + (len), SHM_VRING_ALIGN)
+#define shm_vring_max_len(vr) ((vr)->size/2 - sizeof(shm_vring_head_t)) /* 单条记录最大长度 */
+#define shm_vring_used(vr) ((size_t)((vr)->head - (vr)->tail))
+#define shm_vring_isempty(vr) ((vr)->head == (vr)->tail)
+
+size_t shm_vring_total(size_t size);
+shm_vring_t *shm_vring_init(void *addr, size_t size);
+shm_vring_t *shm_vring_creat(const char *path, size_t size);
+shm_vring_t *shm_vring_attach(const char *path);
+
+void *shm_vring_reserve(shm_vring_t *vr, size_t len);
+void shm_vring_commit(shm_vring_t *vr, void *p);
+int shm_vring_push(shm_vring_t *vr, const void *data, size_t len);
+
+void *shm_vring_peek(shm_vring_t *vr, size_t *len);
+void *shm_vring_peek_wait(shm_vring_t *vr, size_t *len, int msec);
+void shm_vring_release(shm_vring_t *vr);
+
+#endif /*__SHM_VRING_H__*/
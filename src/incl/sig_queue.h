@@ -3,11 +3,13 @@
 
 #include "comm.h"
 #include "queue.h"
+#include "event_count.h"
+
+#define SIG_QUEUE_SPIN_NUM  (64)    /* 队列为空时休眠前的自旋次数 */
 
 typedef struct
 {
-    pthread_mutex_t lock;           /* 队列锁 */
-    pthread_cond_t ready;           /* 临界变量 */
+    event_count_t ready;            /* 等待/通知(无消费者休眠时, 插入不做系统调用) */
     queue_t *queue;                 /* 队列(无锁队列) */
 } sig_queue_t;
 
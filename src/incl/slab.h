@@ -7,9 +7,22 @@
 #include <memory.h>
 #include <stdint.h>
 
+#include <pthread.h>
+#include <stdbool.h>
+
 #include "log.h"
 #include "spinlock.h"
 
+/* 线程缓存
+ *  1. 每个线程为每个分级(8B~2KB)缓存若干空闲块, 申请和回收优先在缓存中进行, 不加锁;
+ *  2. 缓存为空时加一次锁批量补充, 缓存满时加一次锁批量归还较早放入的一半;
+ *  3. 各分级缓存的总字节数不超过SLAB_CACHE_BYTES, 大块缓存的个数相应较少;
+ *  4. 线程退出时其缓存的块全部归还内存池.
+ *  注: 仅slab_creat_by_calloc()创建的内存池启用, slab_init()的内存可能位于共享内存. */
+#define SLAB_CACHE_CLASS    (9)         /* 缓存分级数(8B, 16B, ..., 2KB) */
+#define SLAB_CACHE_SIZE     (64)        /* 每个分级最多缓存的块数 */
+#define SLAB_CACHE_BYTES    (32 * 1024) /* 每个分级最多缓存的字节数 */
+
 typedef struct _slab_page_t
 {
     uintptr_t slab;
@@ -17,7 +30,22 @@ typedef struct _slab_page_t
     uintptr_t prev;
 } slab_page_t;
 
-typedef struct
+struct _slab_pool_t;
+
+/* 线程缓存 */
+typedef struct _slab_cache_t
+{
+    struct _slab_pool_t *pool;          /* 所属内存池 */
+    struct _slab_cache_t *prev;         /* 前一个缓存 */
+    struct _slab_cache_t *next;         /* 后一个缓存 */
+
+    struct {
+        int num;                        /* 缓存的块数 */
+        void *obj[SLAB_CACHE_SIZE];     /* 缓存的块 */
+    } slot[SLAB_CACHE_CLASS];
+} slab_cache_t;
+
+typedef struct _slab_pool_t
 {
     spinlock_t lock;                    /* 内存锁 */
     log_cycle_t *log;                   /* 日志对象 */
@@ -30,12 +58,22 @@ typedef struct
 
     u_char *start;                      /* 内存起始地址 */
     u_char *end;                        /* 内存结束地址 */
+
+    /* 线程缓存 */
+    struct {
+        bool enable;                    /* 是否启用 */
+        pthread_key_t key;              /* 线程私有数据KEY(slab_cache_t *) */
+        spinlock_t lock;                /* 缓存链表锁 */
+        slab_cache_t *list;             /* 缓存链表(销毁时释放) */
+    } cache;
 } slab_pool_t;
 
 slab_pool_t *slab_init(void *addr, size_t size, log_cycle_t *log);
 void *slab_alloc(slab_pool_t *pool, size_t size);
 void slab_dealloc(slab_pool_t *pool, void *p);
-#define slab_destroy(pool) { free(pool); pool = NULL; }
+void slab_flush(slab_pool_t *pool);
+void slab_cache_destroy(slab_pool_t *pool);
+#define slab_destroy(pool) { slab_cache_destroy(pool); free(pool); pool = NULL; }
 
 slab_pool_t *slab_creat_by_calloc(size_t size, log_cycle_t *log);
 
@@ -3,19 +3,51 @@
 
 #include "comm.h"
 #include "ring.h"
+#include "spinlock.h"
 
-typedef struct
+/* 线程缓存(弹匣)
+ *  1. 每个线程持有一个弹匣, 申请和回收优先在弹匣中进行, 不访问共享的环形队列;
+ *  2. 弹匣为空时从环形队列批量补充, 弹匣满时批量归还一半, 一次CAS搬运多个块;
+ *  3. 线程A申请、线程B回收的块先进入B的弹匣, 满后批量归还, 跨线程回收同样批量进行;
+ *  4. 线程退出时其弹匣中的块全部归还环形队列.
+ *  注: 弹匣最多缓存SLOT_MAG_SIZE个块, 块数较少的内存池不启用, 避免线程缓存耗尽内存池. */
+#define SLOT_MAG_SIZE   (32)        /* 弹匣容量 */
+#define SLOT_MAG_BATCH  (16)        /* 批量补充/归还的块数 */
+#define SLOT_MAG_MIN    (1024)      /* 启用弹匣的最小块数 */
+
+struct _slot_t;
+
+/* 弹匣 */
+typedef struct _slot_mag_t
 {
-    int max;                    /* 内存块数 */
-    int size;                   /* 内存块大小 */
+    int num;                        /* 缓存的块数 */
+    struct _slot_t *slot;           /* 所属内存池 */
+    struct _slot_mag_t *prev;       /* 前一个弹匣 */
+    struct _slot_mag_t *next;       /* 后一个弹匣 */
+    void *cell[SLOT_MAG_SIZE];      /* 缓存的块 */
+} __attribute__((aligned(64))) slot_mag_t;
+
+typedef struct _slot_t
+{
+    int max;                        /* 内存块数 */
+    int size;                       /* 内存块大小 */
+
+    void *addr;                     /* 内存地址 */
+    ring_t *ring;                   /* 环形队列 */
 
-    void *addr;                 /* 内存地址 */
-    ring_t *ring;               /* 环形队列 */
+    /* 线程缓存 */
+    struct {
+        bool enable;                /* 是否启用 */
+        pthread_key_t key;          /* 线程私有数据KEY(slot_mag_t *) */
+        spinlock_t lock;            /* 弹匣链表锁 */
+        slot_mag_t *list;           /* 弹匣链表(销毁时释放) */
+    } mag;
 } slot_t;
 
 slot_t *slot_creat(int num, size_t size);
 void *slot_alloc(slot_t *slot, int size);
-static inline void slot_dealloc(slot_t *slot, void *p) { ring_push(slot->ring, p); }
+void slot_dealloc(slot_t *slot, void *p);
+void slot_flush(slot_t *slot);
 void slot_destroy(slot_t *slot);
 #define slot_max(slot) ((slot)->max)
 #define slot_size(slot) ((slot)->size)
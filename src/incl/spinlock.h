@@ -7,12 +7,42 @@
 #define SPIN_LOCK_LOCKED  (0)   /* 已锁 */
 #define SPIN_LOCK_UNLOCK  (1)   /* 未锁 */
 
-/* 自旋锁 */
+#define SPIN_LOCK_BACKOFF_MAX   (256)   /* 最大退避次数(pause), 超过后让出CPU */
+
+/* 自旋锁(可位于共享内存) */
 typedef struct
 {
     uint16_t l;
 } spinlock_t;
 
+/******************************************************************************
+ **函数名称: spin_backoff
+ **功    能: 自旋等待时的退避
+ **输入参数:
+ **     delay: 当前退避次数(初始为1)
+ **输出参数:
+ **     delay: 下一轮的退避次数
+ **返    回: VOID
+ **实现描述: 执行delay次pause, 并将delay翻倍; 达到上限后每轮让出一次CPU,
+ **          避免持锁者被抢占时等待者空转整个时间片.
+ **注意事项:
+ **作    者: # Qifeng.zou # 2015.09.15 #
+ ******************************************************************************/
+static inline void spin_backoff(uint32_t *delay)
+{
+    uint32_t n;
+
+    if (*delay > SPIN_LOCK_BACKOFF_MAX) {
+        sched_yield();
+        return;
+    }
+
+    for (n=0; n<*delay; ++n) {
+        cpu_relax();
+    }
+    *delay <<= 1;
+}
+
 /******************************************************************************
  **函数名称: spin_lock_init
  **功    能: 初始化自旋锁
@@ -36,13 +66,23 @@ static inline void spin_lock_init(spinlock_t *lck)
  **     lck: 自旋锁
  **输出参数: NONE
  **返    回: VOID
- **实现描述: 
+ **实现描述: test-and-test-and-set: 先只读等待锁空闲, 再CAS抢锁; 抢锁失败时
+ **          指数退避, 减少对缓存行的争抢.
  **注意事项:
  **作    者: # Qifeng.zou # 2015.04.18 #
  ******************************************************************************/
 static inline void spin_lock(spinlock_t *lck)
 {
-    do {} while(!atomic16_cmp_and_set(&lck->l, SPIN_LOCK_UNLOCK, SPIN_LOCK_LOCKED));
+    uint32_t delay = 1;
+
+    for (;;) {
+        if ((SPIN_LOCK_UNLOCK == *(volatile uint16_t *)&lck->l)
+            && atomic16_cmp_and_set(&lck->l, SPIN_LOCK_UNLOCK, SPIN_LOCK_LOCKED))
+        {
+            return;
+        }
+        spin_backoff(&delay);
+    }
 }
 
 /******************************************************************************
@@ -52,12 +92,15 @@ static inline void spin_lock(spinlock_t *lck)
  **     lck: 自旋锁
  **输出参数: NONE
  **返    回: 0:成功 !0:失败
- **实现描述: 
+ **实现描述: 锁已被占用时不执行CAS, 避免循环调用时反复争抢缓存行
  **注意事项:
  **作    者: # Qifeng.zou # 2015.04.18 #
  ******************************************************************************/
 static inline int spin_trylock(spinlock_t *lck)
 {
+    if (SPIN_LOCK_UNLOCK != *(volatile uint16_t *)&lck->l) {
+        return -1;
+    }
     return atomic16_cmp_and_set(&lck->l, SPIN_LOCK_UNLOCK, SPIN_LOCK_LOCKED)? 0 : -1;
 }
 
@@ -67,14 +110,16 @@ static inline int spin_trylock(spinlock_t *lck)
  **输入参数:
  **     lck: 自旋锁
  **输出参数: NONE
- **返    回: 0:成功 !0:失败
- **实现描述: 
- **注意事项:
+ **返    回: 0:成功
+ **实现描述: x86写操作不会与之前的读写重排, 只需编译器屏障加普通写
+ **注意事项: 只能由持锁者调用
  **作    者: # Qifeng.zou # 2015.04.18 #
  ******************************************************************************/
 static inline int spin_unlock(spinlock_t *lck)
 {
-    return atomic16_cmp_and_set(&lck->l, SPIN_LOCK_LOCKED, SPIN_LOCK_UNLOCK)? 0 : -1;
+    compiler_barrier();
+    *(volatile uint16_t *)&lck->l = SPIN_LOCK_UNLOCK;
+    return 0;
 }
 
 /******************************************************************************
@@ -0,0 +1,79 @@
+#if !defined(__SWISS_TAB_H__)
+#define __SWISS_TAB_H__
+
+#include "comm.h"
+
+#define SWISS_GROUP_WIDTH   (16)            /* 控制字节组宽度(一次SSE2比较的字节数) */
+#define SWISS_MIN_CAP       (SWISS_GROUP_WIDTH) /* 最小容量 */
+#define SWISS_MIGRATE_NUM   (2 * SWISS_GROUP_WIDTH) /* 扩容时每次操作迁移的单元数 */
+
+/* 控制字节取值 */
+#define SWISS_CTRL_EMPTY    ((int8_t)0x80)  /* 空闲 */
+#define SWISS_CTRL_DELETED  ((int8_t)0xFE)  /* 已删除(墓碑) */
+                                            /* 0x00~0x7F: 已占用(取值为哈希值的低7位) */
+
+/* 错误码定义 */
+typedef enum
+{
+    SWISS_OK                                /* 成功 */
+
+    , SWISS_ERR = ~0x7fffffff               /* 失败 */
+    , SWISS_NODE_EXIST                      /* 结点存在 */
+} swiss_ret_e;
+
+/* 选项 */
+typedef struct
+{
+    void *pool;                             /* 内存池 */
+    mem_alloc_cb_t alloc;                   /* 申请内存 */
+    mem_dealloc_cb_t dealloc;               /* 释放内存 */
+} swiss_opt_t;
+
+/* 单元数组 */
+typedef struct
+{
+    size_t cap;                             /* 容量(注: 必须为SWISS_GROUP_WIDTH的2^n倍) */
+    size_t num;                             /* 已占用单元数 */
+    size_t del;                             /* 墓碑单元数 */
+    int8_t *ctrl;                           /* 控制字节(长度: cap) */
+    void **slot;                            /* 数据地址(长度: cap) */
+} swiss_arr_t;
+
+/* 开放寻址哈希表(Swiss table)
+ *  1. 每个单元对应1个控制字节, 记录单元状态及哈希值的低7位(h2);
+ *  2. 以16个控制字节为一组, 通过SSE2一次比较整组, 仅对h2匹配的单元比较主键;
+ *  3. 扩容时新建2倍容量的数组, 后续每次插入/删除时迁移部分旧数据(渐进式扩容),
+ *     避免一次性迁移全部数据引起的停顿. */
+typedef struct
+{
+    uint64_t total;                         /* 数据总数 */
+
+    swiss_arr_t cur;                        /* 当前数组 */
+    swiss_arr_t old;                        /* 旧数组(扩容迁移期间有效) */
+    size_t mig;                             /* 旧数组的迁移位置 */
+
+    cmp_cb_t cmp;                           /* 比较回调 */
+    hash_cb_t hash;                         /* 生成哈希值的回调 */
+
+    /* 内存池 */
+    struct {
+        void *pool;                         /* 内存池 */
+        mem_alloc_cb_t alloc;               /* 申请内存 */
+        mem_dealloc_cb_t dealloc;           /* 释放内存 */
+    };
+} swiss_tab_t;
+
+swiss_tab_t *swiss_tab_creat(size_t cap, hash_cb_t hash, cmp_cb_t cmp, swiss_opt_t *opt);
+int swiss_tab_insert(swiss_tab_t *tab, void *data);
+void *swiss_tab_query(swiss_tab_t *tab, void *key);
+void *swiss_tab_delete(swiss_tab_t *tab, void *key);
+int swiss_tab_insert_ex(swiss_tab_t *tab, uint64_t hval, void *data);
+void *swiss_tab_query_ex(swiss_tab_t *tab, uint64_t hval, void *key);
+void *swiss_tab_delete_ex(swiss_tab_t *tab, uint64_t hval, void *key);
+int swiss_tab_trav(swiss_tab_t *tab, trav_cb_t proc, void *args);
+size_t swiss_tab_mem_size(swiss_tab_t *tab);
+int swiss_tab_destroy(swiss_tab_t *tab, mem_dealloc_cb_t dealloc, void *args);
+
+#define swiss_tab_total(tab) ((tab)->total)
+
+#endif /*__SWISS_TAB_H__*/
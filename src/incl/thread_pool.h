@@ -2,9 +2,26 @@
 #define __THREAD_POOL_H__
 
 #include "comm.h"
+#include "spinlock.h"
+#include "event_count.h"
+
+/******************************************************************************
+ **
+ ** 工作窃取线程池:
+ **     1. 每个线程有一个Chase-Lev双端队列: 本线程在bottom端压入/弹出(无锁),
+ **        其他线程在top端窃取(CAS);
+ **     2. 非池内线程提交的任务按轮转放入各线程的注入队列(自旋锁+尾指针, O(1)),
+ **        池内线程提交的任务直接压入本线程的双端队列;
+ **     3. 线程依次从: 本线程双端队列 -> 本线程注入队列 -> 随机选择的其他线程
+ **        获取任务;
+ **     4. 无任务时先自旋THREAD_POOL_SPIN_NUM轮, 仍无任务再通过futex休眠.
+ **
+ ******************************************************************************/
 
 #define THREAD_ATTR_STACK_SIZE  (0x800000)  /* 线程栈SIZE */
 #define THREAD_POOL_SLAB_SIZE   (16 * KB)   /* 线程池Slab空间SIZE */
+#define THREAD_POOL_DEQUE_SIZE  (4096)      /* 双端队列容量(必须为2^n) */
+#define THREAD_POOL_SPIN_NUM    (64)        /* 休眠前自旋轮数 */
 
 /* 选项 */
 typedef struct
@@ -22,17 +39,46 @@ typedef struct _thread_worker_t
     struct _thread_worker_t *next;  /* 下一个节点 */
 } thread_worker_t;
 
-/* 线程池 */
+struct _thread_pool_t;
+
+/* 池内线程 */
 typedef struct
 {
-    pthread_mutex_t queue_lock;     /* 队列互斥锁 */
-    pthread_cond_t queue_ready;     /* 队列临界锁 */
+    /* 双端队列(Chase-Lev) */
+    struct
+    {
+        volatile uint64_t top;      /* 窃取端(其他线程) */
+        char _pad1[64 - sizeof(uint64_t)];
+        volatile uint64_t bottom;   /* 压入/弹出端(本线程) */
+        char _pad2[64 - sizeof(uint64_t)];
+        thread_worker_t *task[THREAD_POOL_DEQUE_SIZE];
+    } deque;
+
+    /* 注入队列(非池内线程提交, 或双端队列已满) */
+    struct
+    {
+        spinlock_t lock;            /* 自旋锁 */
+        volatile int num;           /* 任务数 */
+        thread_worker_t *head;      /* 队列头 */
+        thread_worker_t *tail;      /* 队列尾 */
+    } inject;
+
+    int idx;                        /* 线程序号 */
+    uint32_t seed;                  /* 随机种子(选择窃取对象) */
+    struct _thread_pool_t *tpool;   /* 所属线程池 */
+} thread_pool_thd_t;
 
-    thread_worker_t *head;          /* 队列头 */
-    int shutdown;                   /* 是否已销毁线程 */
+/* 线程池 */
+typedef struct _thread_pool_t
+{
+    volatile int shutdown;          /* 是否已销毁线程 */
     pthread_t *tid;                 /* 线程ID数组 —动态分配空间 */
     int num;                        /* 实际创建的线程个数 */
-    int queue_size;                 /* 工作队列当前大小 */
+    thread_pool_thd_t *thd;         /* 池内线程数组 —动态分配空间 */
+
+    volatile uint32_t rr;           /* 轮转序号(选择注入队列) */
+    event_count_t ready;            /* 休眠/唤醒空闲线程 */
+    volatile uint32_t alive;        /* 存活(或正在创建)的线程数 */
 
     void *data;                     /* 附加数据 */
 
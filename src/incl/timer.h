@@ -3,44 +3,39 @@
 
 #include "comm.h"
 #include "list.h"
+#include "timer_wheel.h"
 
-#define TIMER_CAP    (128)      /* 堆容量 */
-
+/* 处理项 */
 typedef struct
 {
     void (*proc)(void *param);  /* 定时回调 */
     void *param;                /* 附加参数 */
 } timer_task_item_t;
 
-/* 管理对象 */
+/* 管理对象(由timer_task_routine()线程驱动; 事件循环可直接使用timer_wheel_t) */
 typedef struct
 {
-    int len;                    /* 成员个数 */
-    int cap;                    /* 最大容量 */
-    void **e;                   /* 成员列表(数组) */
-
-    pthread_rwlock_t lock;      /* 读写锁 */
-
-    cmp_cb_t cmp;               /* 比较回调 */
+    timer_wheel_t *wheel;       /* 时间轮 */
+    pthread_mutex_t lock;       /* 锁(可重入: 回调中可启停任务) */
 } timer_cntx_t;
 
 /* 任务对象 */
 typedef struct
 {
-    int idx;                    /* 堆中序号 */
     timer_cntx_t *ctx;          /* 上下文对象 */
+    timer_wheel_node_t node;    /* 时间轮结点 */
 
-    int start;                  /* 开始时间 */
-    int interval;               /* 间隔时间 */
+    int start;                  /* 开始时间(毫秒) */
+    int interval;               /* 间隔时间(毫秒, 0:只执行一次) */
 
     list_t *list;               /* 处理列表(注:指向timer_task_item_t对象) */
 
     uint64_t times;             /* 已执行次数 */
-    time_t ttl;                 /* 下次执行时间 */
 } timer_task_t;
 
 timer_cntx_t *timer_cntx_init(void);
 timer_task_t *timer_task_init(int start, int interval);
+timer_task_t *timer_task_init_ms(int start_ms, int interval_ms);
 int timer_task_add(timer_task_t *task, void (*proc)(void *param), void *param);
 int timer_task_start(timer_cntx_t *ctx, timer_task_t *task);
 int timer_task_stop(timer_cntx_t *ctx, timer_task_t *task);
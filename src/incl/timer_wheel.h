@@ -0,0 +1,74 @@
+#if !defined(__TIMER_WHEEL_H__)
+#define __TIMER_WHEEL_H__
+
+#include "comm.h"
+
+/******************************************************************************
+ **
+ ** 分层时间轮:
+ **     1. 时间按tick(默认1ms)划分, 共5层: 第0层256个槽, 其余每层64个槽,
+ **        覆盖2^32个tick(1ms时约49天), 更远的定时器放在最高层的槽中;
+ **     2. 定时器按到期时刻距当前时刻的远近放入对应层的槽(双向链表), 添加和
+ **        删除均为O(1);
+ **     3. 第0层转完一圈时, 将上一层当前槽中的定时器重新分配到下层(级联);
+ **     4. 每层有非空槽位图, 用于快速计算最近的到期时刻, 并据此设置timerfd.
+ **
+ ** 使用方式: 将timer_wheel_fd()加入epoll, 可读时调用timer_wheel_expire();
+ **          或以timer_wheel_timeout()作为epoll_wait()的超时时间.
+ **          非线程安全: 添加/删除/处理须在同一线程(或由调用者加锁).
+ **
+ ******************************************************************************/
+
+#define TIMER_WHEEL_TICK_US     (1000)      /* 默认tick(微秒) */
+#define TIMER_WHEEL_LEVEL       (5)         /* 层数 */
+#define TIMER_WHEEL_ROOT_BITS   (8)         /* 第0层位数 */
+#define TIMER_WHEEL_NODE_BITS   (6)         /* 其余层位数 */
+#define TIMER_WHEEL_ROOT_SIZE   (1 << TIMER_WHEEL_ROOT_BITS)    /* 第0层槽数 */
+#define TIMER_WHEEL_NODE_SIZE   (1 << TIMER_WHEEL_NODE_BITS)    /* 其余层槽数 */
+#define TIMER_WHEEL_SLOT_NUM    (TIMER_WHEEL_ROOT_SIZE + (TIMER_WHEEL_LEVEL - 1) * TIMER_WHEEL_NODE_SIZE)
+
+/* 定时回调 */
+typedef void (*timer_wheel_cb_t)(void *param);
+
+/* 定时器(由调用者分配, 可嵌入其他结构体) */
+typedef struct _timer_wheel_node_t
+{
+    struct _timer_wheel_node_t *prev;       /* 前一结点 */
+    struct _timer_wheel_node_t *next;       /* 后一结点 */
+
+    int slot;                               /* 所在槽(-1:未启动) */
+    uint64_t expire;                        /* 到期时刻(tick) */
+    uint64_t period;                        /* 周期(tick, 0:一次性) */
+
+    timer_wheel_cb_t proc;                  /* 定时回调 */
+    void *param;                            /* 附加参数 */
+} timer_wheel_node_t;
+
+/* 时间轮 */
+typedef struct
+{
+    int fd;                                 /* timerfd */
+    uint32_t tick;                          /* tick(微秒) */
+    uint64_t base;                          /* 起始时刻(微秒, CLOCK_MONOTONIC) */
+    uint64_t curr;                          /* 下一个待处理的tick */
+    uint64_t armed;                         /* timerfd已设置的到期tick(0:未设置) */
+    int num;                                /* 定时器个数 */
+
+    uint64_t bitmap[TIMER_WHEEL_SLOT_NUM / 64]; /* 非空槽位图 */
+    timer_wheel_node_t slot[TIMER_WHEEL_SLOT_NUM]; /* 槽(链表头) */
+} timer_wheel_t;
+
+timer_wheel_t *timer_wheel_creat(uint32_t tick_us);
+void timer_wheel_node_init(timer_wheel_node_t *node, timer_wheel_cb_t proc, void *param);
+int timer_wheel_add(timer_wheel_t *tw, timer_wheel_node_t *node, uint64_t timeout_us, uint64_t period_us);
+int timer_wheel_del(timer_wheel_t *tw, timer_wheel_node_t *node);
+int timer_wheel_expire(timer_wheel_t *tw);
+int timer_wheel_timeout(timer_wheel_t *tw);
+uint64_t timer_wheel_now(timer_wheel_t *tw);
+void timer_wheel_destroy(timer_wheel_t *tw);
+
+#define timer_wheel_fd(tw) ((tw)->fd)
+#define timer_wheel_num(tw) ((tw)->num)
+#define timer_wheel_pending(node) ((node)->slot >= 0) /* 定时器是否已启动 */
+
+#endif /*__TIMER_WHEEL_H__*/
@@ -0,0 +1,166 @@
+#if !defined(__TRACE_H__)
+#define __TRACE_H__
+
+#include "comm.h"
+#include "atomic.h"
+
+/******************************************************************************
+ **
+ ** 热点路径跟踪(按比例抽样)
+ **     1. 入口处调用trace_sample(): 每rate条(trace_init()指定)消息抽取1条并
+ **        分配跟踪ID, 未启用(rate为0)时只有一次读操作;
+ **     2. 跟踪ID随消息在各线程间传递, 经过各处理阶段时调用trace_event()记录
+ **        CPU时钟(TSC), 写入本线程的环形缓存(单生产者/单消费者, 无锁). 缓存满
+ **        时丢弃新事件, 不阻塞业务线程;
+ **     3. 同步线程定时将各线程的事件写入跟踪文件, 由tools/trace_export.py转换
+ **        为Chrome trace格式(chrome://tracing或Perfetto查看).
+ **
+ ** 文件格式: [文件头(trace_file_head_t)][事件(trace_file_event_t) ...]
+ **     文件头中的阶段名称在每次同步时重写, 因此可在trace_init()之后注册阶段.
+ **
+ ******************************************************************************/
+#define TRACE_MAGIC             (0x43415254)/* 文件魔术字("TRAC") */
+#define TRACE_VERSION           (1)         /* 文件格式版本 */
+#define TRACE_STAGE_MAX_NUM     (16)        /* 阶段最大个数 */
+#define TRACE_NAME_MAX_LEN      (32)        /* 阶段名称最大长度 */
+#define TRACE_RING_SIZE         (8192)      /* 每个线程缓存的事件数(2的幂) */
+#define TRACE_SYNC_MSEC         (100)       /* 同步间隔(毫秒) */
+#define TRACE_FILE_MAX_SIZE     (256 * MB)  /* 跟踪文件最大长度(超过后不再写入) */
+
+/* 文件头 */
+typedef struct
+{
+    uint32_t magic;                         /* 魔术字(TRACE_MAGIC) */
+    uint32_t version;                       /* 版本号(TRACE_VERSION) */
+    int32_t pid;                            /* 进程号 */
+    uint32_t rate;                          /* 抽样比例 */
+    uint64_t tsc_hz;                        /* TSC频率(每秒时钟数) */
+    uint64_t tsc_base;                      /* 基准时刻的TSC */
+    uint64_t ns_base;                       /* 基准时刻(CLOCK_REALTIME, 纳秒) */
+    uint64_t drop;                          /* 因缓存已满丢弃的事件数 */
+    char stage[TRACE_STAGE_MAX_NUM][TRACE_NAME_MAX_LEN]; /* 阶段名称 */
+} trace_file_head_t;
+
+/* 事件(环形缓存及文件中) */
+typedef struct
+{
+    uint64_t id;                            /* 跟踪ID */
+    uint64_t tsc;                           /* CPU时钟 */
+    uint32_t tid;                           /* 线程ID */
+    uint16_t stage;                         /* 阶段 */
+    uint16_t resv;                          /* 保留 */
+    uint32_t type;                          /* 消息类型 */
+    uint32_t resv2;                         /* 保留 */
+} trace_file_event_t;
+
+/* 线程事件缓存(单生产者/单消费者) */
+typedef struct _trace_ring_t
+{
+    volatile uint64_t head;                 /* 写入位置(所属线程) */
+    char _pad1[64 - sizeof(uint64_t)];
+    volatile uint64_t tail;                 /* 读取位置(同步线程) */
+    char _pad2[64 - sizeof(uint64_t)];
+
+    uint32_t tid;                           /* 所属线程ID */
+    uint32_t seq;                           /* 跟踪ID序号 */
+    uint32_t count;                         /* 抽样计数 */
+    volatile uint64_t drop;                 /* 缓存已满而丢弃的事件数 */
+    volatile int closed;                    /* 所属线程是否已退出 */
+    struct _trace_ring_t *next;             /* 下一个缓存 */
+    trace_file_event_t event[TRACE_RING_SIZE]; /* 事件 */
+} trace_ring_t;
+
+/* 外部接口 */
+int trace_init(const char *path, int rate);
+int trace_stage(int stage, const char *name);
+int trace_sync(void);
+
+/* 内部接口 */
+extern volatile uint32_t g_trace_rate;
+extern __thread trace_ring_t *g_trace_ring;
+trace_ring_t *trace_ring_creat(void);
+
+/* 获取当前线程的缓存 */
+static inline trace_ring_t *trace_ring_get(void)
+{
+    return (NULL != g_trace_ring)? g_trace_ring : trace_ring_creat();
+}
+
+/******************************************************************************
+ **函数名称: trace_sample
+ **功    能: 抽样并分配跟踪ID
+ **输入参数: NONE
+ **输出参数: NONE
+ **返    回: 跟踪ID(0:不跟踪)
+ **实现描述: 按线程计数, 每g_trace_rate条抽取1条; 跟踪ID为(线程ID << 32 | 序号)
+ **注意事项: 未启用跟踪时只读取g_trace_rate
+ **作    者: # Qifeng.zou # 2015.09.30 #
+ ******************************************************************************/
+static inline uint64_t trace_sample(void)
+{
+    uint32_t rate = g_trace_rate;
+    trace_ring_t *ring;
+
+    if (0 == rate) {
+        return 0;
+    }
+
+    ring = trace_ring_get();
+    if ((NULL == ring) || (++ring->count < rate)) {
+        return 0;
+    }
+
+    ring->count = 0;
+    if (0 == ++ring->seq) {
+        ++ring->seq;
+    }
+
+    return ((uint64_t)ring->tid << 32) | ring->seq;
+}
+
+/******************************************************************************
+ **函数名称: trace_record
+ **功    能: 记录跟踪事件
+ **输入参数:
+ **     id: 跟踪ID(0:不跟踪, 直接返回)
+ **     stage: 阶段
+ **     type: 消息类型
+ **     tsc: CPU时钟(事件发生时刻)
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述: 先写入事件, 再发布head(x86写写不重排, 仅需编译器屏障)
+ **注意事项: 缓存已满时丢弃并计数
+ **作    者: # Qifeng.zou # 2015.09.30 #
+ ******************************************************************************/
+static inline void trace_record(uint64_t id, int stage, uint32_t type, uint64_t tsc)
+{
+    uint64_t head;
+    trace_ring_t *ring;
+    trace_file_event_t *ev;
+
+    if (0 == id || NULL == (ring = trace_ring_get())) {
+        return;
+    }
+
+    head = ring->head;
+    if (head - ring->tail >= TRACE_RING_SIZE) {
+        ++ring->drop;
+        return;
+    }
+
+    ev = &ring->event[head & (TRACE_RING_SIZE - 1)];
+    ev->id = id;
+    ev->tsc = tsc;
+    ev->tid = ring->tid;
+    ev->stage = stage;
+    ev->type = type;
+
+    compiler_barrier();
+    ring->head = head + 1;
+}
+
+/* 记录当前时刻的跟踪事件: 未被抽样(id为0)时不读取TSC */
+#define trace_event(id, stage, type) \
+    do { if (id) { trace_record(id, stage, type, cpu_ticket_get()); } } while (0)
+
+#endif /*__TRACE_H__*/
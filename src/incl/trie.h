@@ -3,6 +3,26 @@
 
 #include "comm.h"
 
+/*
+ * 自适应基数树(Adaptive Radix Tree)
+ *  1. 内部结点按孩子数在4/16/48/256四种规格间自动升级, 每个结点只占实际需要的空间
+ *  2. 路径压缩: 只有一个孩子的链被压缩到结点的prefix中(最多保存TRIE_PREFIX_MAX个
+ *     字节, 超出部分查询时跳过, 最终由叶子中的完整键校验)
+ *  3. 叶子保存完整的键, 用指针最低位标识(TRIE_IS_LEAF)
+ *  4. 某个键恰好是另一个键的前缀时, 它挂在对应内部结点的leaf上
+ */
+
+#define TRIE_PREFIX_MAX     (10)        /* 结点中保存的压缩路径最大长度 */
+
+/* 结点类型 */
+typedef enum
+{
+    TRIE_NODE4                          /* 最多4个孩子 */
+    , TRIE_NODE16                       /* 最多16个孩子 */
+    , TRIE_NODE48                       /* 最多48个孩子 */
+    , TRIE_NODE256                      /* 最多256个孩子 */
+} trie_node_type_e;
+
 /* 选项 */
 typedef struct
 {
@@ -11,19 +31,57 @@ typedef struct
     mem_dealloc_cb_t dealloc;           /* 释放空间 */
 } trie_opt_t;
 
-/* 键树的结点 */
-typedef struct _kwt_node_t
+/* 叶子结点 */
+typedef struct
 {
-    u_char key;                         /* 键值 */
     void *data;                         /* 结点数据 */
-    struct _kwt_node_t *child;          /* 后续节点 */
+    int len;                            /* 键长 */
+    u_char key[0];                      /* 完整的键 */
+} trie_leaf_t;
+
+/* 内部结点(公共头部) */
+typedef struct
+{
+    uint8_t type;                       /* 结点类型(trie_node_type_e) */
+    uint16_t num;                       /* 孩子个数 */
+    uint32_t prefix_len;                /* 压缩路径长度 */
+    u_char prefix[TRIE_PREFIX_MAX];     /* 压缩路径(只保存前TRIE_PREFIX_MAX个字节) */
+    trie_leaf_t *leaf;                  /* 在此结束的键(没有时为NULL) */
 } trie_node_t;
 
+typedef struct
+{
+    trie_node_t n;                      /* 公共头部 */
+    u_char key[4];                      /* 孩子的键(有序) */
+    void *child[4];                     /* 孩子 */
+} trie_node4_t;
+
+typedef struct
+{
+    trie_node_t n;                      /* 公共头部 */
+    u_char key[16];                     /* 孩子的键(有序, SIMD并行比较) */
+    void *child[16];                    /* 孩子 */
+} trie_node16_t;
+
+typedef struct
+{
+    trie_node_t n;                      /* 公共头部 */
+    u_char idx[256];                    /* 键 -> 孩子下标+1(0表示无) */
+    void *child[48];                    /* 孩子 */
+} trie_node48_t;
+
+typedef struct
+{
+    trie_node_t n;                      /* 公共头部 */
+    void *child[256];                   /* 孩子(以键为下标) */
+} trie_node256_t;
+
 /* 键树 */
 typedef struct
 {
-    int max;                            /* 结点个数(必须为2的次方) */
-    trie_node_t *root;                  /* 键树根结点 */
+    void *root;                         /* 根(内部结点或叶子) */
+    uint64_t num;                       /* 键的个数 */
+    size_t mem;                         /* 占用内存(字节, 不含附加数据) */
 
     /* 选项 */
     void *pool;                         /* 内存池 */
@@ -31,10 +89,18 @@ typedef struct
     mem_dealloc_cb_t dealloc;           /* 释放空间 */
 } trie_tree_t;
 
+/* 遍历回调 */
+typedef int (*trie_trav_cb_t)(const u_char *key, int len, void *data, void *args);
+
 trie_tree_t *trie_creat(trie_opt_t *opt);
 int trie_insert(trie_tree_t *tree, const u_char *str, int len, void *data);
 int trie_query(trie_tree_t *tree, const u_char *str, int len, void **data);
+int trie_match(trie_tree_t *tree, const u_char *str, int len, void **data);
+int trie_prefix_trav(trie_tree_t *tree, const u_char *prefix, int len, trie_trav_cb_t proc, void *args);
 void trie_print(trie_tree_t *kwt);
 void trie_destroy(trie_tree_t *tree, void *mempool, mem_dealloc_cb_t dealloc);
 
+#define trie_num(tree) ((tree)->num)
+#define trie_mem_size(tree) ((tree)->mem)
+
 #endif /*__TRIE_H__*/
@@ -143,6 +143,7 @@ int acc_rsvr_init(acc_cntx_t *ctx, acc_rsvr_t *rsvr, int idx)
     rsvr->id = idx;
     rsvr->log = ctx->log;
     rsvr->recv_seq = 0;
+    rsvr->conn_metric = metrics_gauge("acc.rsvr.conn");
 
     rsvr->sendq = ctx->sendq[idx];
     rsvr->connq = ctx->connq[idx];
@@ -379,7 +380,7 @@ static int acc_rsvr_conn_timeout(acc_cntx_t *ctx, acc_rsvr_t *rsvr)
         /* > 获取超时连接 */
         key.cid = rsvr->id;
 
-        hash_tab_trav_slot(ctx->conn_cid_tab, &key,
+        hash_map_trav_slot(ctx->conn_cid_tab, &key,
                 (trav_cb_t)acc_rsvr_get_timeout_conn_list, &timeout, RDLOCK);
 
         log_debug(rsvr->log, "Timeout connections: %d!", timeout.list->num);
@@ -443,15 +444,10 @@ static int acc_rsvr_add_conn(acc_cntx_t *ctx, acc_rsvr_t *rsvr)
 
     connq = rsvr->connq;
     while (1) {
-        num = MIN(queue_used(connq), AGT_RSVR_CONN_POP_NUM);
-        if (0 == num) {
-            return ACC_OK;
-        }
-
         /* > 取数据 */
-        num = queue_mpop(connq, (void **)add, num);
+        num = queue_pop_burst(connq, (void **)add, AGT_RSVR_CONN_POP_NUM);
         if (0 == num) {
-            continue;
+            return ACC_OK;
         }
 
         for (idx=0; idx<num; ++idx) {
@@ -539,6 +535,7 @@ static int acc_rsvr_add_conn(acc_cntx_t *ctx, acc_rsvr_t *rsvr)
 
             epoll_ctl(rsvr->epid, EPOLL_CTL_ADD, sck->fd, &ev);
             ++rsvr->conn_total;
+            metrics_gauge_inc(rsvr->conn_metric);
         }
     }
 
@@ -583,6 +580,7 @@ static int acc_rsvr_del_conn(acc_cntx_t *ctx, acc_rsvr_t *rsvr, socket_t *sck)
     FREE(sck);
 
     --rsvr->conn_total;
+    metrics_gauge_dec(rsvr->conn_metric);
     return ACC_OK;
 }
 
@@ -905,13 +903,8 @@ static int acc_rsvr_dist_send_data(acc_cntx_t *ctx, acc_rsvr_t *rsvr)
 
     sendq = rsvr->sendq;
     while (1) {
-        num = MIN(ring_used(sendq), AGT_RSVR_DIST_POP_NUM);
-        if (0 == num) {
-            break;
-        }
-
         /* > 弹出应答数据 */
-        num = ring_mpop(sendq, addr, num);
+        num = ring_pop_burst(sendq, addr, AGT_RSVR_DIST_POP_NUM);
         if (0 == num) {
             break;
         }
@@ -965,7 +958,7 @@ static socket_t *acc_push_into_send_list(
     /* > 查询会话对象 */
     key.cid = cid;
 
-    extra = hash_tab_query(ctx->conn_cid_tab, &key, WRLOCK);
+    extra = hash_map_query(ctx->conn_cid_tab, &key, WRLOCK);
     if (NULL == extra) {
         log_error(ctx->log, "Query connection by cid failed! cid:%lu", cid);
         return NULL;
@@ -975,12 +968,12 @@ static socket_t *acc_push_into_send_list(
 
     /* > 放入发送列表 */
     if (list_rpush(extra->send_list, addr)) {
-        hash_tab_unlock(ctx->conn_cid_tab, &key, WRLOCK);
+        hash_map_unlock(ctx->conn_cid_tab, &key, WRLOCK);
         log_error(ctx->log, "Push data into send list failed! cid:%lu", cid);
         return NULL;
     }
 
-    hash_tab_unlock(ctx->conn_cid_tab, &key, WRLOCK);
+    hash_map_unlock(ctx->conn_cid_tab, &key, WRLOCK);
 
     return sck;
 }
@@ -1027,14 +1020,14 @@ static int acc_rsvr_kick_conn(acc_cntx_t *ctx, acc_rsvr_t *rsvr)
             /* > 查询会话对象 */
             key.cid = kick->cid;
 
-            extra = hash_tab_query(ctx->conn_cid_tab, &key, RDLOCK);
+            extra = hash_map_query(ctx->conn_cid_tab, &key, RDLOCK);
             if (NULL == extra) {
                 continue;
             }
 
             sck = extra->sck;
 
-            hash_tab_unlock(ctx->conn_cid_tab, &key, RDLOCK);
+            hash_map_unlock(ctx->conn_cid_tab, &key, RDLOCK);
 
             acc_rsvr_del_conn(ctx, rsvr, sck);
         }
@@ -80,7 +80,7 @@ acc_cntx_t *acc_init(acc_protocol_t *protocol, acc_conf_t *conf, log_cycle_t *lo
         }
 
         /* > 创建连接管理 */
-        ctx->conn_cid_tab = (hash_tab_t *)hash_tab_creat(conf->rsvr_num,
+        ctx->conn_cid_tab = (hash_map_t *)hash_map_creat(conf->rsvr_num,
             (hash_cb_t)acc_conn_cid_hash_cb, (cmp_cb_t)acc_conn_cid_cmp_cb, NULL);
         if (NULL == ctx->conn_cid_tab) {
             log_error(ctx->log, "Init sid list failed!");
@@ -394,7 +394,7 @@ static int acc_creat_queue(acc_cntx_t *ctx)
  ******************************************************************************/
 int acc_conn_cid_tab_add(acc_cntx_t *ctx, acc_socket_extra_t *extra)
 {
-    return hash_tab_insert(ctx->conn_cid_tab, extra, WRLOCK);
+    return hash_map_insert(ctx->conn_cid_tab, extra, WRLOCK);
 }
 
 /******************************************************************************
@@ -414,7 +414,7 @@ acc_socket_extra_t *acc_conn_cid_tab_del(acc_cntx_t *ctx, uint64_t cid)
 
     key.cid = cid;
 
-    return hash_tab_delete(ctx->conn_cid_tab, &key, WRLOCK);
+    return hash_map_delete(ctx->conn_cid_tab, &key, WRLOCK);
 }
 
 /******************************************************************************
@@ -435,14 +435,14 @@ int acc_get_rid_by_cid(acc_cntx_t *ctx, uint64_t cid)
 
     key.cid = cid;
 
-    extra = hash_tab_query(ctx->conn_cid_tab, &key, RDLOCK);
+    extra = hash_map_query(ctx->conn_cid_tab, &key, RDLOCK);
     if (NULL == extra) {
         return -1;
     }
 
     rid = extra->rid;
 
-    hash_tab_unlock(ctx->conn_cid_tab, &key, RDLOCK);
+    hash_map_unlock(ctx->conn_cid_tab, &key, RDLOCK);
 
     return rid;
 }
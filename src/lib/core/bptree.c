@@ -0,0 +1,1012 @@
+/******************************************************************************
+ ** Copyright(C) 2014-2024 Qiware technology Co., Ltd
+ **
+ ** 文件名: bptree.c
+ ** 版本号: 1.0
+ ** 描  述: 内存B+树
+ **         1. 结点布局: [头部(32字节)][主键数组][指针数组], 整个结点为一块
+ **            node_size字节的连续内存, 按缓存行对齐;
+ **         2. 内部结点: num个主键, num+1个孩子, child[i]中的主键均小于key[i],
+ **            child[i+1]中的主键均不小于key[i];
+ **         3. 叶子结点: num个主键及其数据, 叶子之间双向链接;
+ **         4. 字节串主键在结点中存为[长度(2字节)][内容(补0至key_len字节)],
+ **            补0后先按内容比较, 再按长度比较, 即为字节串的字典序.
+ ** 作  者: # Qifeng.zou # 2015.08.08 #
+ ******************************************************************************/
+#include "redo.h"
+#include "bptree.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#define BPTREE_HEAD_SIZE    (32)            /* 结点头部大小(主键数组按32字节对齐) */
+#define BPTREE_DEPTH_MAX    (64)            /* 树的最大高度 */
+
+/* 字节串主键 */
+typedef struct
+{
+    uint16_t len;                           /* 长度 */
+    u_char str[0];                          /* 内容(补0至key_len字节) */
+} bptree_str_t;
+
+static void bptree_node_free(bptree_t *tree, bptree_node_t *node, mem_dealloc_cb_t dealloc, void *args);
+
+#define bptree_key(tree, node, idx) \
+    ((u_char *)(uintptr_t)(node) + BPTREE_HEAD_SIZE + (size_t)(idx) * (tree)->key_size)
+#define bptree_ptr(tree, node) \
+    ((void **)((u_char *)(uintptr_t)(node) + BPTREE_HEAD_SIZE + (size_t)((node)->leaf? \
+        (tree)->leaf_max : (tree)->inner_max) * (tree)->key_size))
+
+/******************************************************************************
+ **函数名称: bptree_key_cmp
+ **功    能: 比较结点中的两个主键
+ **输入参数:
+ **     tree: B+树
+ **     k1: 主键1
+ **     k2: 主键2
+ **输出参数: NONE
+ **返    回: <0: k1<k2 0: 相等 >0: k1>k2
+ **实现描述: 字节串两边都补了0, 只需比较较长者的长度
+ **注意事项:
+ **作    者: # Qifeng.zou # 2015.08.08 #
+ ******************************************************************************/
+static inline int bptree_key_cmp(const bptree_t *tree, const void *k1, const void *k2)
+{
+    int ret;
+    const bptree_str_t *s1, *s2;
+
+    if (BPTREE_KEY_U64 == tree->key_type) {
+        return (*(const uint64_t *)k1 > *(const uint64_t *)k2)
+            - (*(const uint64_t *)k1 < *(const uint64_t *)k2);
+    }
+
+    s1 = (const bptree_str_t *)k1;
+    s2 = (const bptree_str_t *)k2;
+    ret = memcmp(s1->str, s2->str, MAX(s1->len, s2->len));
+
+    return ret? ret : ((int)s1->len - (int)s2->len);
+}
+
+/* 将外部主键转换为结点中的存储格式 */
+static int bptree_key_encode(const bptree_t *tree, const void *key, size_t len, void *buf)
+{
+    bptree_str_t *s;
+
+    if (BPTREE_KEY_U64 == tree->key_type) {
+        if (sizeof(uint64_t) != len) {
+            return BPTREE_ERR;
+        }
+        memcpy(buf, key, sizeof(uint64_t));
+        return BPTREE_OK;
+    }
+
+    if (len > (size_t)tree->key_len) {
+        return BPTREE_ERR;
+    }
+
+    s = (bptree_str_t *)buf;
+    memset(buf, 0, tree->key_size);
+    s->len = len;
+    memcpy(s->str, key, len);
+
+    return BPTREE_OK;
+}
+
+/* 将结点中的主键转换为外部格式 */
+static inline const void *bptree_key_decode(const bptree_t *tree, const void *k, size_t *len)
+{
+    if (BPTREE_KEY_U64 == tree->key_type) {
+        *len = sizeof(uint64_t);
+        return k;
+    }
+
+    *len = ((const bptree_str_t *)k)->len;
+    return ((const bptree_str_t *)k)->str;
+}
+
+/* 二分查找第一个不小于key的位置 */
+static int bptree_search_bsearch(const bptree_t *tree, const bptree_node_t *node, const void *key)
+{
+    int low = 0, mid, high = node->num;
+
+    while (low < high) {
+        mid = (low + high) >> 1;
+        if (bptree_key_cmp(tree, bptree_key(tree, node, mid), key) < 0) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    return low;
+}
+
+/* 统计小于key的主键个数(主键有序, 即为第一个不小于key的位置) */
+static int bptree_search_u64(const bptree_t *tree, const bptree_node_t *node, const void *key)
+{
+    int idx, pos = 0;
+    uint64_t k = *(const uint64_t *)key;
+    const uint64_t *keys = (const uint64_t *)bptree_key(tree, node, 0);
+
+    for (idx=0; idx<node->num; ++idx) {
+        pos += (keys[idx] < k);
+    }
+
+    return pos;
+}
+
+#if defined(__x86_64__)
+/* AVX2: 一次比较4个主键(无符号比较: 两边同时翻转符号位后做有符号比较) */
+__attribute__((target("avx2")))
+static int bptree_search_u64_avx2(const bptree_t *tree, const bptree_node_t *node, const void *key)
+{
+    int idx, pos = 0;
+    __m256i bias, k, v;
+    const uint64_t *keys = (const uint64_t *)bptree_key(tree, node, 0);
+
+    bias = _mm256_set1_epi64x((long long)0x8000000000000000ULL);
+    k = _mm256_xor_si256(_mm256_set1_epi64x(*(const long long *)key), bias);
+
+    for (idx=0; idx+4<=node->num; idx+=4) {
+        v = _mm256_xor_si256(_mm256_load_si256((const __m256i *)(keys + idx)), bias);
+        pos += __builtin_popcount(_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(k, v))));
+    }
+
+    for (; idx<node->num; ++idx) {
+        pos += (keys[idx] < *(const uint64_t *)key);
+    }
+
+    return pos;
+}
+#endif /*__x86_64__*/
+
+/* 内部结点中key所在的孩子 */
+static inline int bptree_child_idx(const bptree_t *tree, const bptree_node_t *node, const void *key)
+{
+    int pos;
+
+    pos = tree->search(tree, node, key);
+    if ((pos < node->num) && (0 == bptree_key_cmp(tree, bptree_key(tree, node, pos), key))) {
+        return pos + 1;
+    }
+
+    return pos;
+}
+
+/* 默认内存申请(按缓存行对齐) */
+static void *bptree_mem_alloc(void *pool, size_t size)
+{
+    return memalign_alloc(BPTREE_CACHE_LINE, size);
+}
+
+/* 新建结点 */
+static bptree_node_t *bptree_node_alloc(bptree_t *tree, int leaf)
+{
+    bptree_node_t *node;
+
+    node = (bptree_node_t *)tree->alloc(tree->pool, tree->node_size);
+    if (NULL == node) {
+        return NULL;
+    }
+
+    node->leaf = leaf;
+    node->num = 0;
+    node->prev = NULL;
+    node->next = NULL;
+    ++tree->node_num;
+
+    return node;
+}
+
+/* 释放结点 */
+static void bptree_node_dealloc(bptree_t *tree, bptree_node_t *node)
+{
+    --tree->node_num;
+    tree->dealloc(tree->pool, node);
+}
+
+/******************************************************************************
+ **函数名称: bptree_creat
+ **功    能: 创建B+树
+ **输入参数:
+ **     opt: 选项(NULL: 主键为uint64_t, 默认结点大小)
+ **输出参数: NONE
+ **返    回: B+树
+ **实现描述: 结点至少能容纳2个叶子主键和3个内部主键, 不足时自动增大结点
+ **注意事项: 64位主键在AVX2可用时使用向量比较
+ **作    者: # Qifeng.zou # 2015.08.08 #
+ ******************************************************************************/
+bptree_t *bptree_creat(bptree_opt_t *opt)
+{
+    bptree_t *tree;
+    bptree_opt_t _opt;
+
+    if (NULL == opt) {
+        memset(&_opt, 0, sizeof(_opt));
+        _opt.key_type = BPTREE_KEY_U64;
+    } else {
+        memcpy(&_opt, opt, sizeof(_opt));
+    }
+    opt = &_opt;
+
+    if ((BPTREE_KEY_STR == opt->key_type)
+        && ((opt->key_len <= 0) || (opt->key_len > BPTREE_KEY_LEN_MAX))) {
+        return NULL;
+    } else if (NULL == opt->alloc) {
+        opt->pool = NULL;
+        opt->alloc = (mem_alloc_cb_t)bptree_mem_alloc;
+        opt->dealloc = (mem_dealloc_cb_t)mem_dealloc;
+    }
+
+    tree = (bptree_t *)opt->alloc(opt->pool, sizeof(bptree_t));
+    if (NULL == tree) {
+        return NULL;
+    }
+
+    memset(tree, 0, sizeof(bptree_t));
+
+    tree->key_type = opt->key_type;
+    if (BPTREE_KEY_U64 == opt->key_type) {
+        tree->key_len = sizeof(uint64_t);
+        tree->key_size = sizeof(uint64_t);
+        tree->search = bptree_search_u64;
+#if defined(__x86_64__)
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            tree->search = bptree_search_u64_avx2;
+        }
+#endif
+    } else {
+        tree->key_len = opt->key_len;
+        tree->key_size = (sizeof(bptree_str_t) + opt->key_len + 7) & ~7;
+        tree->search = bptree_search_bsearch;
+    }
+
+    /* > 计算结点容量 */
+    tree->node_size = (opt->node_size > 0)? opt->node_size : BPTREE_NODE_SIZE;
+    tree->node_size = (tree->node_size + BPTREE_CACHE_LINE - 1) & ~(BPTREE_CACHE_LINE - 1);
+    while ((int)(tree->node_size - BPTREE_HEAD_SIZE - sizeof(void *))
+           / (int)(tree->key_size + sizeof(void *)) < 3) {
+        tree->node_size += BPTREE_CACHE_LINE;
+    }
+
+    tree->leaf_max = (tree->node_size - BPTREE_HEAD_SIZE) / (tree->key_size + sizeof(void *));
+    tree->inner_max = (tree->node_size - BPTREE_HEAD_SIZE - sizeof(void *))
+        / (tree->key_size + sizeof(void *));
+
+    tree->pool = opt->pool;
+    tree->alloc = opt->alloc;
+    tree->dealloc = opt->dealloc;
+
+    return tree;
+}
+
+/******************************************************************************
+ **函数名称: bptree_find_leaf
+ **功    能: 查找主键所在的叶子
+ **输入参数:
+ **     tree: B+树
+ **     key: 主键(存储格式)
+ **输出参数:
+ **     path: 途经的内部结点
+ **     pidx: 在各内部结点中选择的孩子
+ **返    回: 叶子
+ **实现描述:
+ **注意事项: path/pidx为NULL时不记录路径
+ **作    者: # Qifeng.zou # 2015.08.08 #
+ ******************************************************************************/
+static bptree_node_t *bptree_find_leaf(const bptree_t *tree,
+        const void *key, bptree_node_t **path, int *pidx)
+{
+    int idx, depth = 0;
+    bptree_node_t *node = tree->root;
+
+    while (!node->leaf) {
+        idx = bptree_child_idx(tree, node, key);
+        if (NULL != path) {
+            path[depth] = node;
+            pidx[depth] = idx;
+            ++depth;
+        }
+        node = (bptree_node_t *)bptree_ptr(tree, node)[idx];
+    }
+
+    return node;
+}
+
+/* 在结点的pos处插入主键和指针(内部结点的指针插在pos+1) */
+static void bptree_node_put(bptree_t *tree, bptree_node_t *node, int pos, const void *key, void *ptr)
+{
+    int off = node->leaf? 0 : 1;
+    void **p = bptree_ptr(tree, node);
+
+    memmove(bptree_key(tree, node, pos+1), bptree_key(tree, node, pos),
+            (size_t)(node->num - pos) * tree->key_size);
+    memcpy(bptree_key(tree, node, pos), key, tree->key_size);
+    memmove(p + pos + off + 1, p + pos + off, (node->num - pos) * sizeof(void *));
+    p[pos + off] = ptr;
+    ++node->num;
+}
+
+/******************************************************************************
+ **函数名称: bptree_split
+ **功    能: 分裂已满的结点并插入
+ **输入参数:
+ **     tree: B+树
+ **     node: 已满的结点
+ **     pos: 插入位置
+ **     key: 主键(存储格式)
+ **     ptr: 数据或右孩子
+ **输出参数:
+ **     sep: 上移到父结点的分隔主键
+ **返    回: 新建的右结点(NULL: 失败)
+ **实现描述:
+ **     叶子: 后一半移入右结点, 分隔主键为右结点的第一个主键(保留在叶子中)
+ **     内部结点: key[mid]上移, 其后的主键和孩子移入右结点
+ **注意事项:
+ **作    者: # Qifeng.zou # 2015.08.08 #
+ ******************************************************************************/
+static bptree_node_t *bptree_split(bptree_t *tree,
+        bptree_node_t *node, int pos, const void *key, void *ptr, void *sep)
+{
+    int mid = node->num / 2;
+    bptree_node_t *right;
+
+    right = bptree_node_alloc(tree, node->leaf);
+    if (NULL == right) {
+        return NULL;
+    }
+
+    if (node->leaf) {
+        right->num = node->num - mid;
+        memcpy(bptree_key(tree, right, 0), bptree_key(tree, node, mid), (size_t)right->num * tree->key_size);
+        memcpy(bptree_ptr(tree, right), bptree_ptr(tree, node) + mid, right->num * sizeof(void *));
+        node->num = mid;
+
+        /* > 链入叶子链表 */
+        right->prev = node;
+        right->next = node->next;
+        if (NULL != node->next) {
+            node->next->prev = right;
+        } else {
+            tree->tail = right;
+        }
+        node->next = right;
+
+        if (pos <= mid) {
+            bptree_node_put(tree, node, pos, key, ptr);
+        } else {
+            bptree_node_put(tree, right, pos - mid, key, ptr);
+        }
+        memcpy(sep, bptree_key(tree, right, 0), tree->key_size);
+        return right;
+    }
+
+    right->num = node->num - mid - 1;
+    memcpy(sep, bptree_key(tree, node, mid), tree->key_size);
+    memcpy(bptree_key(tree, right, 0), bptree_key(tree, node, mid+1), (size_t)right->num * tree->key_size);
+    memcpy(bptree_ptr(tree, right), bptree_ptr(tree, node) + mid + 1, (right->num + 1) * sizeof(void *));
+    node->num = mid;
+
+    if (pos <= mid) {
+        bptree_node_put(tree, node, pos, key, ptr);
+    } else {
+        bptree_node_put(tree, right, pos - mid - 1, key, ptr);
+    }
+
+    return right;
+}
+
+/******************************************************************************
+ **函数名称: bptree_insert
+ **功    能: 插入主键
+ **输入参数:
+ **     tree: B+树
+ **     key: 主键(KEY_U64: uint64_t的地址, len为8)
+ **     len: 主键长度
+ **     data: 数据
+ **输出参数: NONE
+ **返    回: BPTREE_OK:成功 BPTREE_NODE_EXIST:已存在 BPTREE_ERR:失败
+ **实现描述: 插入叶子, 已满时分裂, 分隔主键逐层上移, 根分裂时树高加1
+ **注意事项:
+ **作    者: # Qifeng.zou # 2015.08.08 #
+ ******************************************************************************/
+int bptree_insert(bptree_t *tree, const void *key, size_t len, void *data)
+{
+    int depth, pos, pidx[BPTREE_DEPTH_MAX];
+    bptree_node_t *leaf, *node, *right, *root, *path[BPTREE_DEPTH_MAX];
+    uint64_t k[(sizeof(bptree_str_t) + BPTREE_KEY_LEN_MAX + 7) / 8];
+    uint64_t sep[(sizeof(bptree_str_t) + BPTREE_KEY_LEN_MAX + 7) / 8];
+
+    if (bptree_key_encode(tree, key, len, k)) {
+        return BPTREE_ERR;
+    }
+
+    /* > 空树 */
+    if (NULL == tree->root) {
+        leaf = bptree_node_alloc(tree, true);
+        if (NULL == leaf) {
+            return BPTREE_ERR;
+        }
+        bptree_node_put(tree, leaf, 0, k, data);
+        tree->root = tree->head = tree->tail = leaf;
+        tree->height = 1;
+        ++tree->num;
+        return BPTREE_OK;
+    }
+
+    /* > 插入叶子 */
+    leaf = bptree_find_leaf(tree, k, path, pidx);
+    pos = tree->search(tree, leaf, k);
+    if ((pos < leaf->num) && (0 == bptree_key_cmp(tree, bptree_key(tree, leaf, pos), k))) {
+        return BPTREE_NODE_EXIST;
+    }
+
+    if (leaf->num < tree->leaf_max) {
+        bptree_node_put(tree, leaf, pos, k, data);
+        ++tree->num;
+        return BPTREE_OK;
+    }
+
+    right = bptree_split(tree, leaf, pos, k, data, sep);
+    if (NULL == right) {
+        return BPTREE_ERR;
+    }
+    ++tree->num;
+
+    /* > 分隔主键逐层上移 */
+    for (depth=tree->height-2; depth>=0; --depth) {
+        node = path[depth];
+        pos = pidx[depth];
+        if (node->num < tree->inner_max) {
+            bptree_node_put(tree, node, pos, sep, right);
+            return BPTREE_OK;
+        }
+
+        memcpy(k, sep, tree->key_size);
+        right = bptree_split(tree, node, pos, k, right, sep);
+        if (NULL == right) {
+            return BPTREE_ERR;
+        }
+    }
+
+    /* > 根分裂 */
+    root = bptree_node_alloc(tree, false);
+    if (NULL == root) {
+        return BPTREE_ERR;
+    }
+    memcpy(bptree_key(tree, root, 0), sep, tree->key_size);
+    bptree_ptr(tree, root)[0] = tree->root;
+    bptree_ptr(tree, root)[1] = right;
+    root->num = 1;
+    tree->root = root;
+    ++tree->height;
+
+    return BPTREE_OK;
+}
+
+/******************************************************************************
+ **函数名称: bptree_query
+ **功    能: 查询主键
+ **输入参数:
+ **     tree: B+树
+ **     key: 主键
+ **     len: 主键长度
+ **输出参数: NONE
+ **返    回: 数据(NULL: 不存在)
+ **实现描述:
+ **注意事项:
+ **作    者: # Qifeng.zou # 2015.08.08 #
+ ******************************************************************************/
+void *bptree_query(bptree_t *tree, const void *key, size_t len)
+{
+    int pos;
+    bptree_node_t *leaf;
+    uint64_t k[(sizeof(bptree_str_t) + BPTREE_KEY_LEN_MAX + 7) / 8];
+
+    if ((NULL == tree->root) || bptree_key_encode(tree, key, len, k)) {
+        return NULL;
+    }
+
+    leaf = bptree_find_leaf(tree, k, NULL, NULL);
+    pos = tree->search(tree, leaf, k);
+    if ((pos < leaf->num) && (0 == bptree_key_cmp(tree, bptree_key(tree, leaf, pos), k))) {
+        return bptree_ptr(tree, leaf)[pos];
+    }
+
+    return NULL;
+}
+
+/* 删除结点中pos处的主键及指针(内部结点: 删除key[pos]及child[pos+1]) */
+static void bptree_node_del(bptree_t *tree, bptree_node_t *node, int pos, int off)
+{
+    void **p = bptree_ptr(tree, node);
+
+    memmove(bptree_key(tree, node, pos), bptree_key(tree, node, pos+1),
+            (size_t)(node->num - pos - 1) * tree->key_size);
+    memmove(p + pos + off, p + pos + off + 1,
+            (node->leaf? (node->num - pos - 1) : (node->num - pos - off)) * sizeof(void *));
+    --node->num;
+}
+
+/******************************************************************************
+ **函数名称: bptree_delete
+ **功    能: 删除主键
+ **输入参数:
+ **     tree: B+树
+ **     key: 主键
+ **     len: 主键长度
+ **输出参数:
+ **     data: 被删除的数据
+ **返    回: BPTREE_OK:成功 BPTREE_NOT_FOUND:不存在 BPTREE_ERR:失败
+ **实现描述: 叶子为空时从链表和父结点中摘除, 并逐层回收没有孩子的内部结点;
+ **          根只剩一个孩子时树高减1.
+ **注意事项: 面向读多写少的场景, 不做结点合并与借位(未满的结点仍然有效),
+ **          内部结点中的分隔主键可能是已删除的主键, 不影响查找.
+ **作    者: # Qifeng.zou # 2015.08.08 #
+ ******************************************************************************/
+int bptree_delete(bptree_t *tree, const void *key, size_t len, void **data)
+{
+    int depth, pos, pidx[BPTREE_DEPTH_MAX];
+    bptree_node_t *leaf, *node, *child, *path[BPTREE_DEPTH_MAX];
+    uint64_t k[(sizeof(bptree_str_t) + BPTREE_KEY_LEN_MAX + 7) / 8];
+
+    *data = NULL;
+    if (NULL == tree->root) {
+        return BPTREE_NOT_FOUND;
+    } else if (bptree_key_encode(tree, key, len, k)) {
+        return BPTREE_ERR;
+    }
+
+    leaf = bptree_find_leaf(tree, k, path, pidx);
+    pos = tree->search(tree, leaf, k);
+    if ((pos >= leaf->num) || (0 != bptree_key_cmp(tree, bptree_key(tree, leaf, pos), k))) {
+        return BPTREE_NOT_FOUND;
+    }
+
+    *data = bptree_ptr(tree, leaf)[pos];
+    bptree_node_del(tree, leaf, pos, 0);
+    --tree->num;
+    if (leaf->num > 0) {
+        return BPTREE_OK;
+    }
+
+    /* > 摘除空叶子 */
+    if (NULL != leaf->prev) { leaf->prev->next = leaf->next; } else { tree->head = leaf->next; }
+    if (NULL != leaf->next) { leaf->next->prev = leaf->prev; } else { tree->tail = leaf->prev; }
+
+    child = leaf;
+    for (depth=tree->height-2; depth>=0; --depth) {
+        bptree_node_dealloc(tree, child);
+        node = path[depth];
+        pos = pidx[depth];
+        if (node->num > 0) {
+            if (pos > 0) {
+                bptree_node_del(tree, node, pos - 1, 1); /* 删除key[pos-1]及child[pos] */
+            } else {
+                bptree_node_del(tree, node, 0, 0); /* 删除key[0]及child[0] */
+            }
+            break;
+        }
+        child = node; /* 没有主键的内部结点只有这一个孩子 */
+    }
+
+    if (depth < 0) {
+        bptree_node_dealloc(tree, child);
+        tree->root = tree->head = tree->tail = NULL;
+        tree->height = 0;
+        return BPTREE_OK;
+    }
+
+    /* > 根只剩一个孩子时降低树高 */
+    while (!tree->root->leaf && (0 == tree->root->num)) {
+        node = tree->root;
+        tree->root = (bptree_node_t *)bptree_ptr(tree, node)[0];
+        bptree_node_dealloc(tree, node);
+        --tree->height;
+    }
+
+    return BPTREE_OK;
+}
+
+/******************************************************************************
+ **函数名称: bptree_load
+ **功    能: 批量加载有序数据
+ **输入参数:
+ **     tree: B+树(必须为空树)
+ **     next: 依次返回升序主键的回调
+ **     args: 回调参数
+ **输出参数: NONE
+ **返    回: BPTREE_OK:成功 BPTREE_ERR:失败(主键非严格升序或内存不足)
+ **实现描述: 先将叶子依次填满并链接, 再自底向上逐层构建内部结点, 每个结点的
+ **          分隔主键为右侧子树中最左叶子的第一个主键
+ **注意事项: 失败时回收已创建的结点, 树恢复为空树
+ **作    者: # Qifeng.zou # 2015.08.08 #
+ ******************************************************************************/
+int bptree_load(bptree_t *tree, bptree_load_cb_t next, void *args)
+{
+    int idx, cidx, n, level_num, num, cap = 0;
+    size_t len;
+    void *data;
+    const void *key;
+    bptree_node_t *leaf = NULL, *node, **level = NULL, **upper;
+    const void **mins, **upper_mins;
+    uint64_t k[(sizeof(bptree_str_t) + BPTREE_KEY_LEN_MAX + 7) / 8];
+
+    if (NULL != tree->root) {
+        return BPTREE_ERR;
+    }
+
+    /* > 填充叶子 */
+    level_num = 0;
+    while (0 == next(args, &key, &len, &data)) {
+        if (bptree_key_encode(tree, key, len, k)) {
+            goto LEAF_ERR;
+        } else if ((NULL != leaf)
+            && (bptree_key_cmp(tree, bptree_key(tree, leaf, leaf->num - 1), k) >= 0)) {
+            goto LEAF_ERR; /* 非严格升序 */
+        }
+
+        if ((NULL == leaf) || (leaf->num >= tree->leaf_max)) {
+            if (level_num >= cap) {
+                cap = cap? 2*cap : 64;
+                upper = (bptree_node_t **)realloc(level, cap * sizeof(bptree_node_t *));
+                if (NULL == upper) {
+                    goto LEAF_ERR;
+                }
+                level = upper;
+            }
+
+            node = bptree_node_alloc(tree, true);
+            if (NULL == node) {
+                goto LEAF_ERR;
+            }
+            node->prev = leaf;
+            if (NULL != leaf) {
+                leaf->next = node;
+            } else {
+                tree->head = node;
+            }
+            leaf = node;
+            tree->tail = leaf;
+            level[level_num++] = leaf;
+        }
+
+        memcpy(bptree_key(tree, leaf, leaf->num), k, tree->key_size);
+        bptree_ptr(tree, leaf)[leaf->num++] = data;
+        ++tree->num;
+    }
+
+    if (0 == level_num) {
+        free(level);
+        return BPTREE_OK;
+    }
+
+    mins = (const void **)calloc(level_num, sizeof(void *));
+    if (NULL == mins) {
+        goto LEAF_ERR;
+    }
+    for (idx=0; idx<level_num; ++idx) {
+        mins[idx] = bptree_key(tree, level[idx], 0);
+    }
+    tree->height = 1;
+
+    /* > 逐层构建内部结点(孩子在同层结点间平均分配) */
+    while (level_num > 1) {
+        num = div_ceiling(level_num, tree->inner_max + 1);
+        upper = (bptree_node_t **)calloc(num, sizeof(bptree_node_t *));
+        upper_mins = (const void **)calloc(num, sizeof(void *));
+        if ((NULL == upper) || (NULL == upper_mins)) {
+            free(upper);
+            free(upper_mins);
+            upper = NULL;
+            idx = cidx = 0;
+            goto INNER_ERR;
+        }
+
+        for (idx=0, cidx=0; idx<num; ++idx) {
+            node = bptree_node_alloc(tree, false);
+            if (NULL == node) {
+                free(upper_mins);
+                goto INNER_ERR;
+            }
+            upper[idx] = node;
+            upper_mins[idx] = mins[cidx];
+            bptree_ptr(tree, node)[0] = level[cidx++];
+
+            n = level_num / num + ((idx < level_num % num)? 1 : 0) - 1;
+            for (; node->num < n; ++cidx) {
+                memcpy(bptree_key(tree, node, node->num), mins[cidx], tree->key_size);
+                bptree_ptr(tree, node)[++node->num] = level[cidx];
+            }
+        }
+
+        free(level);
+        free(mins);
+        level = upper;
+        mins = upper_mins;
+        level_num = num;
+        ++tree->height;
+    }
+
+    tree->root = level[0];
+    free(level);
+    free(mins);
+
+    return BPTREE_OK;
+
+INNER_ERR:
+    /* > 已建结点各自回收其子树, 其余孩子单独回收 */
+    for (n=0; n<idx; ++n) {
+        bptree_node_free(tree, upper[n], NULL, NULL);
+    }
+    for (n=cidx; n<level_num; ++n) {
+        bptree_node_free(tree, level[n], NULL, NULL);
+    }
+    free(upper);
+    free(level);
+    free(mins);
+    tree->head = tree->tail = NULL;
+    tree->height = 0;
+    tree->num = 0;
+    return BPTREE_ERR;
+
+LEAF_ERR:
+    while (NULL != tree->head) {
+        node = tree->head;
+        tree->head = node->next;
+        bptree_node_dealloc(tree, node);
+    }
+    free(level);
+    tree->tail = NULL;
+    tree->num = 0;
+    return BPTREE_ERR;
+}
+
+/******************************************************************************
+ **函数名称: bptree_seek
+ **功    能: 定位迭代器
+ **输入参数:
+ **     tree: B+树
+ **     key: 起始主键(NULL: 从第一个主键开始)
+ **     len: 主键长度
+ **输出参数:
+ **     iter: 迭代器(指向第一个不小于key的主键)
+ **返    回: BPTREE_OK:成功 BPTREE_ERR:失败
+ **实现描述:
+ **注意事项: 迭代期间不能修改B+树
+ **作    者: # Qifeng.zou # 2015.08.08 #
+ ******************************************************************************/
+int bptree_seek(bptree_t *tree, bptree_iter_t *iter, const void *key, size_t len)
+{
+    uint64_t k[(sizeof(bptree_str_t) + BPTREE_KEY_LEN_MAX + 7) / 8];
+
+    iter->tree = tree;
+    iter->leaf = tree->head;
+    iter->idx = 0;
+
+    if ((NULL == key) || (NULL == tree->root)) {
+        return BPTREE_OK;
+    } else if (bptree_key_encode(tree, key, len, k)) {
+        return BPTREE_ERR;
+    }
+
+    iter->leaf = bptree_find_leaf(tree, k, NULL, NULL);
+    iter->idx = tree->search(tree, iter->leaf, k);
+
+    return BPTREE_OK;
+}
+
+/******************************************************************************
+ **函数名称: bptree_next
+ **功    能: 取迭代器当前主键并后移
+ **输入参数:
+ **     iter: 迭代器
+ **输出参数:
+ **     key: 主键(指向结点内部, 可为NULL)
+ **     len: 主键长度(可为NULL)
+ **     data: 数据
+ **返    回: BPTREE_OK:成功 BPTREE_NOT_FOUND:已遍历完
+ **实现描述: 沿叶子链表前进
+ **注意事项:
+ **作    者: # Qifeng.zou # 2015.08.08 #
+ ******************************************************************************/
+int bptree_next(bptree_iter_t *iter, const void **key, size_t *len, void **data)
+{
+    size_t l;
+    const void *k;
+    bptree_t *tree = iter->tree;
+
+    while ((NULL != iter->leaf) && (iter->idx >= iter->leaf->num)) {
+        iter->leaf = iter->leaf->next;
+        iter->idx = 0;
+    }
+
+    if (NULL == iter->leaf) {
+        return BPTREE_NOT_FOUND;
+    }
+
+    k = bptree_key_decode(tree, bptree_key(tree, iter->leaf, iter->idx), &l);
+    if (NULL != key) { *key = k; }
+    if (NULL != len) { *len = l; }
+    *data = bptree_ptr(tree, iter->leaf)[iter->idx++];
+
+    return BPTREE_OK;
+}
+
+/******************************************************************************
+ **函数名称: bptree_range
+ **功    能: 范围查询
+ **输入参数:
+ **     tree: B+树
+ **     min: 下限(含, NULL: 不限)
+ **     min_len: 下限长度
+ **     max: 上限(含, NULL: 不限)
+ **     max_len: 上限长度
+ **     proc: 回调(返回非0时停止)
+ **     args: 回调参数
+ **输出参数: NONE
+ **返    回: BPTREE_OK:成功 BPTREE_ERR:失败
+ **实现描述: 定位下限所在叶子后沿链表遍历, 直到超出上限
+ **注意事项:
+ **作    者: # Qifeng.zou # 2015.08.08 #
+ ******************************************************************************/
+int bptree_range(bptree_t *tree, const void *min, size_t min_len,
+        const void *max, size_t max_len, bptree_trav_cb_t proc, void *args)
+{
+    size_t len;
+    void *data;
+    const void *key;
+    bptree_iter_t iter;
+    uint64_t k[(sizeof(bptree_str_t) + BPTREE_KEY_LEN_MAX + 7) / 8];
+
+    if ((NULL != max) && bptree_key_encode(tree, max, max_len, k)) {
+        return BPTREE_ERR;
+    } else if (bptree_seek(tree, &iter, min, min_len)) {
+        return BPTREE_ERR;
+    }
+
+    for (;;) {
+        while ((NULL != iter.leaf) && (iter.idx >= iter.leaf->num)) {
+            iter.leaf = iter.leaf->next;
+            iter.idx = 0;
+        }
+        if (NULL == iter.leaf) {
+            break;
+        } else if ((NULL != max)
+            && (bptree_key_cmp(tree, bptree_key(tree, iter.leaf, iter.idx), k) > 0)) {
+            break;
+        }
+
+        bptree_next(&iter, &key, &len, &data);
+        if (proc(key, len, data, args)) {
+            break;
+        }
+    }
+
+    return BPTREE_OK;
+}
+
+/******************************************************************************
+ **函数名称: bptree_trav
+ **功    能: 按主键顺序遍历
+ **输入参数:
+ **     tree: B+树
+ **     proc: 回调
+ **     args: 回调参数
+ **输出参数: NONE
+ **返    回: 0:成功 !0:失败
+ **实现描述: 沿叶子链表遍历
+ **注意事项:
+ **作    者: # Qifeng.zou # 2015.08.08 #
+ ******************************************************************************/
+int bptree_trav(bptree_t *tree, trav_cb_t proc, void *args)
+{
+    int idx;
+    bptree_node_t *leaf;
+
+    for (leaf=tree->head; NULL != leaf; leaf=leaf->next) {
+        for (idx=0; idx<leaf->num; ++idx) {
+            proc(bptree_ptr(tree, leaf)[idx], args);
+        }
+    }
+
+    return 0;
+}
+
+/* 打印主键 */
+static void bptree_key_print(const bptree_t *tree, const void *k)
+{
+    if (BPTREE_KEY_U64 == tree->key_type) {
+        fprintf(stdout, " %lu", *(const uint64_t *)k);
+        return;
+    }
+
+    fprintf(stdout, " %.*s", ((const bptree_str_t *)k)->len, ((const bptree_str_t *)k)->str);
+}
+
+/* 打印子树 */
+static void _bptree_print(const bptree_t *tree, const bptree_node_t *node, int depth)
+{
+    int idx;
+
+    for (idx=0; idx<depth; ++idx) {
+        fprintf(stdout, "|   ");
+    }
+
+    fprintf(stdout, "%s[%d]:", node->leaf? "leaf" : "node", node->num);
+    for (idx=0; idx<node->num; ++idx) {
+        bptree_key_print(tree, bptree_key(tree, node, idx));
+    }
+    fprintf(stdout, "\n");
+
+    if (!node->leaf) {
+        for (idx=0; idx<=node->num; ++idx) {
+            _bptree_print(tree, (const bptree_node_t *)bptree_ptr(tree, node)[idx], depth+1);
+        }
+    }
+}
+
+/******************************************************************************
+ **函数名称: bptree_print
+ **功    能: 打印B+树
+ **输入参数:
+ **     tree: B+树
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述:
+ **注意事项:
+ **作    者: # Qifeng.zou # 2015.08.08 #
+ ******************************************************************************/
+void bptree_print(bptree_t *tree)
+{
+    fprintf(stdout, "num:%lu height:%d nodes:%lu node_size:%d leaf_max:%d inner_max:%d\n",
+            tree->num, tree->height, tree->node_num, tree->node_size, tree->leaf_max, tree->inner_max);
+
+    if (NULL != tree->root) {
+        _bptree_print(tree, tree->root, 0);
+    }
+}
+
+/* 释放子树 */
+static void bptree_node_free(bptree_t *tree, bptree_node_t *node, mem_dealloc_cb_t dealloc, void *args)
+{
+    int idx;
+
+    if (node->leaf) {
+        if (NULL != dealloc) {
+            for (idx=0; idx<node->num; ++idx) {
+                dealloc(args, bptree_ptr(tree, node)[idx]);
+            }
+        }
+    } else {
+        for (idx=0; idx<=node->num; ++idx) {
+            bptree_node_free(tree, (bptree_node_t *)bptree_ptr(tree, node)[idx], dealloc, args);
+        }
+    }
+
+    bptree_node_dealloc(tree, node);
+}
+
+/******************************************************************************
+ **函数名称: bptree_destroy
+ **功    能: 销毁B+树
+ **输入参数:
+ **     tree: B+树
+ **     dealloc: 数据释放回调(NULL: 不释放数据)
+ **     args: 回调参数
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述:
+ **注意事项:
+ **作    者: # Qifeng.zou # 2015.08.08 #
+ ******************************************************************************/
+void bptree_destroy(bptree_t *tree, mem_dealloc_cb_t dealloc, void *args)
+{
+    if (NULL != tree->root) {
+        bptree_node_free(tree, tree->root, dealloc, args);
+    }
+
+    tree->dealloc(tree->pool, tree);
+}
@@ -0,0 +1,71 @@
+/******************************************************************************
+ ** Coypright(C) 2014-2024 Qiware technology Co., Ltd
+ **
+ ** 文件名: evfd.c
+ ** 版本号: 1.0
+ ** 描  述: 线程间事件通知
+ **         通过eventfd唤醒阻塞在epoll/select上的线程, 替代UNIX-UDP的命令往返.
+ ** 作  者: # Qifeng.zou # 2015.06.10 #
+ ******************************************************************************/
+#include "comm.h"
+#include "evfd.h"
+#include <sys/eventfd.h>
+
+/******************************************************************************
+ **函数名称: evfd_creat
+ **功    能: 创建事件通知描述符
+ **输入参数: NONE
+ **输出参数: NONE
+ **返    回: 描述符(<0:失败)
+ **实现描述: 非阻塞模式, 多次通知在被读取前会合并为一次可读事件
+ **注意事项:
+ **作    者: # Qifeng.zou # 2015.06.10 #
+ ******************************************************************************/
+int evfd_creat(void)
+{
+    return eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+}
+
+/******************************************************************************
+ **函数名称: evfd_notify
+ **功    能: 发送事件通知
+ **输入参数:
+ **     fd: 事件通知描述符
+ **输出参数: NONE
+ **返    回: 0:成功 !0:失败
+ **实现描述:
+ **注意事项: 计数器溢出时(EAGAIN)说明对端尚未处理, 视为通知成功
+ **作    者: # Qifeng.zou # 2015.06.10 #
+ ******************************************************************************/
+int evfd_notify(int fd)
+{
+    uint64_t v = 1;
+
+    if (write(fd, &v, sizeof(v)) < 0) {
+        return (EAGAIN == errno)? 0 : -1;
+    }
+
+    return 0;
+}
+
+/******************************************************************************
+ **函数名称: evfd_clear
+ **功    能: 清除事件通知
+ **输入参数:
+ **     fd: 事件通知描述符
+ **输出参数: NONE
+ **返    回: 清除前累计的通知次数
+ **实现描述:
+ **注意事项:
+ **作    者: # Qifeng.zou # 2015.06.10 #
+ ******************************************************************************/
+uint64_t evfd_clear(int fd)
+{
+    uint64_t v = 0;
+
+    if (read(fd, &v, sizeof(v)) < 0) {
+        return 0;
+    }
+
+    return v;
+}
@@ -0,0 +1,325 @@
+/******************************************************************************
+ ** Copyright(C) 2014-2024 Qiware technology Co., Ltd
+ **
+ ** 文件名: hash_map.c
+ ** 版本号: 1.0
+ ** 描  述: 分片哈希表模块
+ **         1. 使用分片分解锁的压力(同hash_tab)
+ **         2. 各分片使用开放寻址哈希表(swiss_tab), 插入时无需申请结点内存,
+ **            查找时无需遍历指针
+ **         3. 接口与hash_tab一致, 可直接替换
+ ** 作  者: # Qifeng.zou # 2015.06.18 #
+ ******************************************************************************/
+#include "hash_map.h"
+
+#define HASH_MAP_SHARD_CAP  (64)    /* 分片初始容量 */
+
+#define hash_map_idx(map, hval) ((uint64_t)(hval) % (map)->len)
+
+static void _hash_map_lock(hash_map_t *map, int idx, lock_e lock)
+{
+    if (WRLOCK == lock) {
+        pthread_rwlock_wrlock(&map->shard[idx].lock);
+    } else if (RDLOCK == lock) {
+        pthread_rwlock_rdlock(&map->shard[idx].lock);
+    }
+}
+
+static void _hash_map_unlock(hash_map_t *map, int idx, lock_e lock)
+{
+    if ((WRLOCK == lock) || (RDLOCK == lock)) {
+        pthread_rwlock_unlock(&map->shard[idx].lock);
+    }
+}
+
+/******************************************************************************
+ **函数名称: hash_map_creat
+ **功    能: 创建分片哈希表
+ **输入参数:
+ **     len: 分片数
+ **     hash: 生成哈希值的函数
+ **     cmp: 数据比较函数
+ **     opt: 其他选项
+ **输出参数: NONE
+ **返    回: 分片哈希表
+ **实现描述:
+ **注意事项:
+ **作    者: # Qifeng.zou # 2015.06.18 #
+ ******************************************************************************/
+hash_map_t *hash_map_creat(int len, hash_cb_t hash, cmp_cb_t cmp, hash_map_opt_t *opt)
+{
+    int idx;
+    hash_map_t *map;
+    swiss_opt_t swiss_opt;
+    hash_map_opt_t _opt;
+
+    if (NULL == opt) {
+        _opt.pool = (void *)NULL;
+        _opt.alloc = (mem_alloc_cb_t)mem_alloc;
+        _opt.dealloc = (mem_dealloc_cb_t)mem_dealloc;
+        opt = &_opt;
+    }
+
+    /* > 创建对象 */
+    map = (hash_map_t *)opt->alloc(opt->pool, sizeof(hash_map_t));
+    if (NULL == map) {
+        return NULL;
+    }
+
+    map->len = len;
+    map->cmp = cmp;
+    map->hash = hash;
+    map->pool = opt->pool;
+    map->alloc = opt->alloc;
+    map->dealloc = opt->dealloc;
+
+    map->shard = (hash_map_shard_t *)opt->alloc(opt->pool, len * sizeof(hash_map_shard_t));
+    if (NULL == map->shard) {
+        opt->dealloc(opt->pool, map);
+        return NULL;
+    }
+
+    /* > 初始化分片 */
+    swiss_opt.pool = opt->pool;
+    swiss_opt.alloc = opt->alloc;
+    swiss_opt.dealloc = opt->dealloc;
+
+    for (idx=0; idx<len; ++idx) {
+        pthread_rwlock_init(&map->shard[idx].lock, NULL);
+        map->shard[idx].tab = NULL;
+    }
+
+    for (idx=0; idx<len; ++idx) {
+        map->shard[idx].tab = swiss_tab_creat(HASH_MAP_SHARD_CAP, hash, cmp, &swiss_opt);
+        if (NULL == map->shard[idx].tab) {
+            hash_map_destroy(map, mem_dummy_dealloc, NULL);
+            return NULL;
+        }
+    }
+
+    return map;
+}
+
+/******************************************************************************
+ **函数名称: hash_map_insert
+ **功    能: 插入数据
+ **输入参数:
+ **     map: 分片哈希表
+ **     data: 需要插入的数据
+ **     lock: 锁操作
+ **输出参数: NONE
+ **返    回: 0:成功 !0:失败(含已存在)
+ **实现描述: 哈希值只计算一次, 同时用于选择分片和分片内定位
+ **注意事项:
+ **作    者: # Qifeng.zou # 2015.06.18 #
+ ******************************************************************************/
+int hash_map_insert(hash_map_t *map, void *data, lock_e lock)
+{
+    int ret, idx;
+    uint64_t hval;
+
+    hval = map->hash(data);
+    idx = hash_map_idx(map, hval);
+
+    _hash_map_lock(map, idx, lock);
+    ret = swiss_tab_insert_ex(map->shard[idx].tab, hval, data);
+    _hash_map_unlock(map, idx, lock);
+
+    return ret;
+}
+
+/******************************************************************************
+ **函数名称: hash_map_query
+ **功    能: 查找数据
+ **输入参数:
+ **     map: 分片哈希表
+ **     key: 主键
+ **     lock: 锁操作
+ **输出参数: NONE
+ **返    回: 查询的数据
+ **实现描述:
+ **注意事项:
+ **     1. 当lock为NONLOCK时, 用完查询的数据后, 无需调用hash_map_unlock()释放锁.
+ **     2. 当lock为WRLOCK/RDLOCK且找到数据时, 用完查询的数据后, 需要调用
+ **        hash_map_unlock()释放锁; 未找到时已自动释放锁.
+ **作    者: # Qifeng.zou # 2015.06.18 #
+ ******************************************************************************/
+void *hash_map_query(hash_map_t *map, void *key, lock_e lock)
+{
+    int idx;
+    void *data;
+    uint64_t hval;
+
+    hval = map->hash(key);
+    idx = hash_map_idx(map, hval);
+
+    _hash_map_lock(map, idx, lock);
+    data = swiss_tab_query_ex(map->shard[idx].tab, hval, key);
+    if (NULL == data) {
+        _hash_map_unlock(map, idx, lock);
+        return NULL; /* 未找到 */
+    }
+
+    return data;
+}
+
+/******************************************************************************
+ **函数名称: hash_map_unlock
+ **功    能: 解锁
+ **输入参数:
+ **     map: 分片哈希表
+ **     key: 主键
+ **     lock: 解哪种锁(读锁/写锁)
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述:
+ **注意事项:
+ **作    者: # Qifeng.zou # 2015.06.18 #
+ ******************************************************************************/
+void hash_map_unlock(hash_map_t *map, void *key, lock_e lock)
+{
+    _hash_map_unlock(map, hash_map_idx(map, map->hash(key)), lock);
+}
+
+/******************************************************************************
+ **函数名称: hash_map_delete
+ **功    能: 删除数据
+ **输入参数:
+ **     map: 分片哈希表
+ **     key: 主键
+ **     lock: 锁操作
+ **输出参数: NONE
+ **返    回: 数据地址
+ **实现描述:
+ **注意事项: 返回地址的内存空间由外部释放
+ **作    者: # Qifeng.zou # 2015.06.18 #
+ ******************************************************************************/
+void *hash_map_delete(hash_map_t *map, void *key, lock_e lock)
+{
+    int idx;
+    void *data;
+    uint64_t hval;
+
+    hval = map->hash(key);
+    idx = hash_map_idx(map, hval);
+
+    _hash_map_lock(map, idx, lock);
+    data = swiss_tab_delete_ex(map->shard[idx].tab, hval, key);
+    _hash_map_unlock(map, idx, lock);
+
+    return data;
+}
+
+/******************************************************************************
+ **函数名称: hash_map_trav
+ **功    能: 遍历哈希表
+ **输入参数:
+ **     map: 分片哈希表
+ **     proc: 回调函数
+ **     args: 附加参数
+ **     lock: 加锁方式
+ **输出参数: NONE
+ **返    回: 0:成功 !0:失败
+ **实现描述:
+ **注意事项: 回调函数proc()中禁止插入或删除数据
+ **作    者: # Qifeng.zou # 2015.06.18 #
+ ******************************************************************************/
+int hash_map_trav(hash_map_t *map, trav_cb_t proc, void *args, lock_e lock)
+{
+    int idx;
+
+    for (idx=0; idx<map->len; ++idx) {
+        _hash_map_lock(map, idx, lock);
+        swiss_tab_trav(map->shard[idx].tab, proc, args);
+        _hash_map_unlock(map, idx, lock);
+    }
+
+    return 0;
+}
+
+/******************************************************************************
+ **函数名称: hash_map_trav_slot
+ **功    能: 遍历主键所在分片的所有数据
+ **输入参数:
+ **     map: 分片哈希表
+ **     key: 主键(遍历该主键对应的分片)
+ **     proc: 回调函数
+ **     args: 附加参数
+ **     lock: 加锁方式
+ **输出参数: NONE
+ **返    回: 0:成功 !0:失败
+ **实现描述:
+ **注意事项:
+ **作    者: # Qifeng.zou # 2015.06.18 #
+ ******************************************************************************/
+int hash_map_trav_slot(hash_map_t *map, const void *key, trav_cb_t proc, void *args, lock_e lock)
+{
+    int idx;
+
+    idx = hash_map_idx(map, map->hash(key));
+
+    _hash_map_lock(map, idx, lock);
+    swiss_tab_trav(map->shard[idx].tab, proc, args);
+    _hash_map_unlock(map, idx, lock);
+
+    return 0;
+}
+
+/******************************************************************************
+ **函数名称: hash_map_destroy
+ **功    能: 销毁哈希表
+ **输入参数:
+ **     map: 分片哈希表
+ **     dealloc: 数据释放回调
+ **     args: 附加参数
+ **输出参数: NONE
+ **返    回: 0:成功 !0:失败
+ **实现描述:
+ **注意事项:
+ **作    者: # Qifeng.zou # 2015.06.18 #
+ ******************************************************************************/
+int hash_map_destroy(hash_map_t *map, mem_dealloc_cb_t dealloc, void *args)
+{
+    int idx;
+
+    for (idx=0; idx<map->len; ++idx) {
+        pthread_rwlock_wrlock(&map->shard[idx].lock);
+        if (NULL != map->shard[idx].tab) {
+            swiss_tab_destroy(map->shard[idx].tab, dealloc, args);
+        }
+        pthread_rwlock_unlock(&map->shard[idx].lock);
+
+        pthread_rwlock_destroy(&map->shard[idx].lock);
+    }
+
+    map->dealloc(map->pool, map->shard);
+    map->dealloc(map->pool, map);
+
+    return 0;
+}
+
+/* 获取数据总数(注: 未加锁, 仅供统计使用) */
+uint64_t hash_map_total(hash_map_t *map)
+{
+    int idx;
+    uint64_t total = 0;
+
+    for (idx=0; idx<map->len; ++idx) {
+        total += swiss_tab_total(map->shard[idx].tab);
+    }
+
+    return total;
+}
+
+/* 获取哈希表占用的内存(不含数据本身) */
+size_t hash_map_mem_size(hash_map_t *map)
+{
+    int idx;
+    size_t size = sizeof(hash_map_t) + map->len * sizeof(hash_map_shard_t);
+
+    for (idx=0; idx<map->len; ++idx) {
+        size += swiss_tab_mem_size(map->shard[idx].tab);
+    }
+
+    return size;
+}
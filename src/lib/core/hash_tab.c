@@ -6,24 +6,100 @@
  ** 描  述: 哈希表模块
  **         1. 使用哈希数组分解锁的压力
  **         2. 使用红黑树解决数据查找的性能问题
+ **         3. 扩容模式(HASH_TAB_FLAG_GROW)下使用线性哈希逐个分裂槽, 无需一次性
+ **            迁移全部数据
  ** 作  者: # Qifeng.zou # 2014.10.22 #
  ******************************************************************************/
+#include "atomic.h"
 #include "rb_tree.h"
 #include "hash_tab.h"
 
-static void _hash_tab_lock(hash_tab_t *htab, int idx, lock_e lock)
+#define hash_tab_is_grow(htab) ((htab)->flag & HASH_TAB_FLAG_GROW)
+#define hash_tab_is_lock(lock) ((WRLOCK == (lock)) || (RDLOCK == (lock)))
+
+/* 当前槽数 */
+#define hash_tab_slot_num(htab) \
+    (((uint64_t)(htab)->len << (htab)->level) + (htab)->split)
+
+/* 第k段的起始槽和长度 */
+#define hash_tab_seg_base(htab, k) ((0 == (k))? 0 : ((uint64_t)(htab)->len << ((k) - 1)))
+#define hash_tab_seg_len(htab, k) ((0 == (k))? (uint64_t)(htab)->len : ((uint64_t)(htab)->len << ((k) - 1)))
+
+/* 计算槽所在的段 */
+static inline int hash_tab_seg_idx(hash_tab_t *htab, uint64_t idx)
+{
+    if (idx < (uint64_t)htab->len) {
+        return 0;
+    }
+    return 64 - __builtin_clzll(idx / htab->len);
+}
+
+/* 获取槽对应的树 */
+static inline rbt_tree_t *hash_tab_tree(hash_tab_t *htab, uint64_t idx)
+{
+    int k = hash_tab_seg_idx(htab, idx);
+
+    return htab->seg[k].tree[idx - hash_tab_seg_base(htab, k)];
+}
+
+/* 获取槽对应的锁 */
+static inline pthread_rwlock_t *hash_tab_rwlock(hash_tab_t *htab, uint64_t idx)
+{
+    int k = hash_tab_seg_idx(htab, idx);
+
+    return &htab->seg[k].lock[idx - hash_tab_seg_base(htab, k)];
+}
+
+/******************************************************************************
+ **函数名称: hash_tab_slot_idx
+ **功    能: 计算哈希值所在的槽
+ **输入参数:
+ **     htab: 哈希数组
+ **     hval: 哈希值
+ **输出参数: NONE
+ **返    回: 槽索引
+ **实现描述: 线性哈希: 已分裂的槽(< split)按下一级的槽数取模
+ **注意事项: 扩容模式下, 调用者需持有扩容锁(读锁或写锁)
+ **作    者: # Qifeng.zou # 2015.06.20 #
+ ******************************************************************************/
+static inline uint64_t hash_tab_slot_idx(hash_tab_t *htab, uint64_t hval)
+{
+    uint64_t idx;
+
+    idx = hval % ((uint64_t)htab->len << htab->level);
+    if (idx < (uint64_t)htab->split) {
+        idx = hval % ((uint64_t)htab->len << (htab->level + 1));
+    }
+
+    return idx;
+}
+
+static uint64_t _hash_tab_lock(hash_tab_t *htab, const void *key, lock_e lock)
 {
+    uint64_t idx;
+
+    if (hash_tab_is_grow(htab) && hash_tab_is_lock(lock)) {
+        pthread_rwlock_rdlock(&htab->glock);
+    }
+
+    idx = hash_tab_slot_idx(htab, (uint64_t)htab->hash(key));
+
     if (WRLOCK == lock) {
-        pthread_rwlock_wrlock(&htab->lock[idx]);
+        pthread_rwlock_wrlock(hash_tab_rwlock(htab, idx));
     } else if (RDLOCK == lock) {
-        pthread_rwlock_rdlock(&htab->lock[idx]);
+        pthread_rwlock_rdlock(hash_tab_rwlock(htab, idx));
     }
+
+    return idx;
 }
 
-static void _hash_tab_unlock(hash_tab_t *htab, int idx, lock_e lock)
+static void _hash_tab_unlock(hash_tab_t *htab, uint64_t idx, lock_e lock)
 {
-    if ((WRLOCK == lock) || (RDLOCK == lock)) {
-        pthread_rwlock_unlock(&htab->lock[idx]);
+    if (hash_tab_is_lock(lock)) {
+        pthread_rwlock_unlock(hash_tab_rwlock(htab, idx));
+        if (hash_tab_is_grow(htab)) {
+            pthread_rwlock_unlock(&htab->glock);
+        }
     }
 }
 
@@ -37,18 +113,65 @@ static void _hash_tab_unlock(hash_tab_t *htab, int idx, lock_e lock)
  **输出参数: NONE
  **返    回: VOID
  **实现描述:
- **注意事项:
+ **注意事项: 扩容模式下, 加锁期间持有扩容读锁, 槽的映射关系不会发生变化
  **作    者: # Qifeng.zou # 2016.09.10 04:19:51 #
  ******************************************************************************/
 void hash_tab_unlock(hash_tab_t *htab, void *key, lock_e lock)
 {
-    unsigned int idx;
+    uint64_t idx;
+
+    idx = hash_tab_slot_idx(htab, (uint64_t)htab->hash(key));
+
+    _hash_tab_unlock(htab, idx, lock);
+}
+
+/******************************************************************************
+ **函数名称: hash_tab_seg_init
+ **功    能: 初始化槽段
+ **输入参数:
+ **     htab: 哈希数组
+ **     k: 段索引
+ **输出参数: NONE
+ **返    回: 0:成功 !0:失败
+ **实现描述:
+ **注意事项:
+ **作    者: # Qifeng.zou # 2015.06.20 #
+ ******************************************************************************/
+static int hash_tab_seg_init(hash_tab_t *htab, int k)
+{
+    uint64_t idx, len;
+    rbt_opt_t rbt_opt;
+    hash_tab_seg_t *seg = &htab->seg[k];
+
+    len = hash_tab_seg_len(htab, k);
+
+    seg->tree = (rbt_tree_t **)htab->alloc(htab->pool, len*sizeof(rbt_tree_t *));
+    if (NULL == seg->tree) {
+        return -1;
+    }
 
-    idx = htab->hash(key) % htab->len;
+    seg->lock = (pthread_rwlock_t *)htab->alloc(htab->pool, len*sizeof(pthread_rwlock_t));
+    if (NULL == seg->lock) {
+        htab->dealloc(htab->pool, seg->tree);
+        seg->tree = NULL;
+        return -1;
+    }
+
+    memset(&rbt_opt, 0, sizeof(rbt_opt));
 
-    if ((WRLOCK == lock) || (RDLOCK == lock)) {
-        pthread_rwlock_unlock(&htab->lock[idx]);
+    rbt_opt.pool = (void *)htab->pool;
+    rbt_opt.alloc = (mem_alloc_cb_t)htab->alloc;
+    rbt_opt.dealloc = (mem_dealloc_cb_t)htab->dealloc;
+
+    for (idx=0; idx<len; ++idx) {
+        pthread_rwlock_init(&seg->lock[idx], NULL);
+        seg->tree[idx] = rbt_creat(&rbt_opt, htab->cmp);
+        if (NULL == seg->tree[idx]) {
+            return -1;
+        }
     }
+
+    return 0;
 }
 
 /******************************************************************************
@@ -62,14 +185,12 @@ void hash_tab_unlock(hash_tab_t *htab, void *key, lock_e lock)
  **输出参数: NONE
  **返    回: 哈希数组地址
  **实现描述:
- **注意事项:
+ **注意事项: 设置HASH_TAB_FLAG_GROW时, len为初始槽数, 之后随数据量增长逐步扩容
  **作    者: # Qifeng.zou # 2014.10.22 #
  ******************************************************************************/
 hash_tab_t *hash_tab_creat(int len, hash_cb_t hash, cmp_cb_t cmp, hash_tab_opt_t *opt)
 {
-    int idx;
     hash_tab_t *htab;
-    rbt_opt_t rbt_opt;
     hash_tab_opt_t hmap_opt;
 
     if (NULL == opt) {
@@ -88,45 +209,149 @@ hash_tab_t *hash_tab_creat(int len, hash_cb_t hash, cmp_cb_t cmp, hash_tab_opt_t
         return NULL;
     }
 
+    memset(htab, 0, sizeof(hash_tab_t));
+
     htab->total = 0;
     htab->len = len;
     htab->cmp = cmp;
     htab->hash = hash;
+    htab->flag = opt->flag;
     htab->pool = (void *)opt->pool;
     htab->alloc = (mem_alloc_cb_t)opt->alloc;
     htab->dealloc = (mem_dealloc_cb_t)opt->dealloc;
 
-    htab->tree = (rbt_tree_t **)opt->alloc(opt->pool, len*sizeof(rbt_tree_t *));
-    if (NULL == htab->tree) {
-        opt->dealloc(opt->pool, htab);
+    pthread_rwlock_init(&htab->glock, NULL);
+
+    /* > 初始化数组 */
+    if (hash_tab_seg_init(htab, 0)) {
+        hash_tab_destroy(htab, mem_dummy_dealloc, NULL);
         return NULL;
     }
 
-    htab->lock = (pthread_rwlock_t *)opt->alloc(opt->pool, len*sizeof(pthread_rwlock_t));
-    if (NULL == htab->lock) {
-        opt->dealloc(opt->pool, htab->tree);
-        opt->dealloc(opt->pool, htab);
-        return NULL;
+    return htab;
+}
+
+/* 收集需迁移的数据 */
+typedef struct
+{
+    hash_tab_t *htab;                               /* 哈希数组 */
+    uint64_t idx;                                   /* 分裂的槽 */
+    uint64_t mod;                                   /* 分裂后的槽数 */
+    int num;                                        /* 需迁移的数据个数 */
+    void **data;                                    /* 需迁移的数据 */
+} hash_tab_split_t;
+
+static int hash_tab_split_trav_cb(void *data, hash_tab_split_t *split)
+{
+    if ((uint64_t)split->htab->hash(data) % split->mod != split->idx) {
+        split->data[split->num++] = data;
     }
+    return 0;
+}
 
-    /* > 初始化数组 */
-    memset(&rbt_opt, 0, sizeof(rbt_opt));
+/******************************************************************************
+ **函数名称: hash_tab_split
+ **功    能: 分裂一个槽
+ **输入参数:
+ **     htab: 哈希数组
+ **输出参数: NONE
+ **返    回: 0:成功 !0:失败
+ **实现描述:
+ **     1. 每轮开始时分配新段(长度与当前槽数相同)
+ **     2. 将split槽中按下一级取模不再落在本槽的数据迁移至split + (len << level)槽
+ **     3. split加1, 一轮分裂完成后level加1
+ **注意事项: 调用者需持有扩容写锁
+ **作    者: # Qifeng.zou # 2015.06.20 #
+ ******************************************************************************/
+static int hash_tab_split(hash_tab_t *htab)
+{
+    int idx;
+    void *data;
+    rbt_tree_t *src, *dst;
+    hash_tab_split_t split;
 
-    rbt_opt.pool = (void *)opt->pool;
-    rbt_opt.alloc = (mem_alloc_cb_t)opt->alloc;
-    rbt_opt.dealloc = (mem_dealloc_cb_t)opt->dealloc;
+    if (htab->level + 1 >= HASH_TAB_SEG_MAX) {
+        return -1; /* 已达上限 */
+    }
 
-    for (idx=0; idx<len; ++idx) {
-        pthread_rwlock_init(&htab->lock[idx], NULL);
+    /* > 分配新段 */
+    if ((0 == htab->split) && (NULL == htab->seg[htab->level + 1].tree)) {
+        if (hash_tab_seg_init(htab, htab->level + 1)) {
+            return -1;
+        }
+    }
+
+    src = hash_tab_tree(htab, htab->split);
+    dst = hash_tab_tree(htab, htab->split + ((uint64_t)htab->len << htab->level));
 
-        htab->tree[idx] = rbt_creat(&rbt_opt, cmp);
-        if (NULL == htab->tree[idx]) {
-            hash_tab_destroy(htab, mem_dummy_dealloc, NULL);
-            return NULL;
+    /* > 收集需迁移的数据 */
+    memset(&split, 0, sizeof(split));
+
+    split.htab = htab;
+    split.idx = htab->split;
+    split.mod = (uint64_t)htab->len << (htab->level + 1);
+    if (src->num) {
+        split.data = (void **)calloc(src->num, sizeof(void *));
+        if (NULL == split.data) {
+            return -1;
         }
+        rbt_trav(src, (trav_cb_t)hash_tab_split_trav_cb, (void *)&split);
     }
 
-    return htab;
+    /* > 迁移数据 */
+    for (idx=0; idx<split.num; ++idx) {
+        rbt_delete(src, split.data[idx], &data);
+        rbt_insert(dst, split.data[idx]);
+    }
+
+    free(split.data);
+
+    /* > 推进分裂位置 */
+    if ((uint64_t)(++htab->split) == ((uint64_t)htab->len << htab->level)) {
+        htab->split = 0;
+        ++htab->level;
+    }
+
+    return 0;
+}
+
+/******************************************************************************
+ **函数名称: hash_tab_grow
+ **功    能: 扩容
+ **输入参数:
+ **     htab: 哈希数组
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述: 负载超过HASH_TAB_LOAD_MAX时, 分裂HASH_TAB_SPLIT_NUM个槽
+ **注意事项: 扩容写锁被占用时(含本线程持有查询锁的情况)不等待, 只将本次应做的
+ **          分裂次数记入pend, 由下一个抢到写锁的插入一并完成, 因此既不会阻塞
+ **          也不会死锁, 且并发插入时扩容不会落后于负载.
+ **作    者: # Qifeng.zou # 2015.06.20 #
+ ******************************************************************************/
+static void hash_tab_grow(hash_tab_t *htab)
+{
+    uint32_t idx, num;
+
+    if (htab->total <= hash_tab_slot_num(htab) * HASH_TAB_LOAD_MAX) {
+        return;
+    }
+
+    if (pthread_rwlock_trywrlock(&htab->glock)) {
+        atomic32_add(&htab->pend, HASH_TAB_SPLIT_NUM); /* 记账, 由抢到锁者补做 */
+        return;
+    }
+
+    num = HASH_TAB_SPLIT_NUM + atomic32_xset(&htab->pend, 0);
+    for (idx=0; idx<num; ++idx) {
+        if (htab->total <= hash_tab_slot_num(htab) * HASH_TAB_LOAD_MAX) {
+            break;
+        }
+        if (hash_tab_split(htab)) {
+            break;
+        }
+    }
+
+    pthread_rwlock_unlock(&htab->glock);
 }
 
 /******************************************************************************
@@ -146,17 +371,19 @@ hash_tab_t *hash_tab_creat(int len, hash_cb_t hash, cmp_cb_t cmp, hash_tab_opt_t
 int hash_tab_insert(hash_tab_t *htab, void *data, lock_e lock)
 {
     int ret;
-    unsigned int idx;
-
-    idx = htab->hash(data) % htab->len;
+    uint64_t idx;
 
-    _hash_tab_lock(htab, idx, lock);
-    ret = rbt_insert(htab->tree[idx], data);
+    idx = _hash_tab_lock(htab, data, lock);
+    ret = rbt_insert(hash_tab_tree(htab, idx), data);
     if (0 == ret) {
         ++htab->total;
     }
     _hash_tab_unlock(htab, idx, lock);
 
+    if ((0 == ret) && hash_tab_is_grow(htab)) {
+        hash_tab_grow(htab);
+    }
+
     return ret;
 }
 
@@ -178,12 +405,10 @@ int hash_tab_insert(hash_tab_t *htab, void *data, lock_e lock)
 void *hash_tab_query(hash_tab_t *htab, void *key, lock_e lock)
 {
     void *data = NULL;
-    unsigned int idx;
+    uint64_t idx;
 
-    idx = htab->hash(key) % htab->len;
-
-    _hash_tab_lock(htab, idx, lock);
-    data = rbt_query((rbt_tree_t *)htab->tree[idx], key);
+    idx = _hash_tab_lock(htab, key, lock);
+    data = rbt_query(hash_tab_tree(htab, idx), key);
     if (NULL == data) {
         _hash_tab_unlock(htab, idx, lock);
         return NULL; /* 未找到 */
@@ -208,12 +433,10 @@ void *hash_tab_query(hash_tab_t *htab, void *key, lock_e lock)
 void *hash_tab_delete(hash_tab_t *htab, void *key, lock_e lock)
 {
     void *data;
-    unsigned int idx;
-
-    idx = htab->hash(key) % htab->len;
+    uint64_t idx;
 
-    _hash_tab_lock(htab, idx, lock);
-    rbt_delete(htab->tree[idx], key, &data);
+    idx = _hash_tab_lock(htab, key, lock);
+    rbt_delete(hash_tab_tree(htab, idx), key, &data);
     if (NULL != data) {
         --htab->total;
     }
@@ -224,12 +447,10 @@ void *hash_tab_delete(hash_tab_t *htab, void *key, lock_e lock)
 
 void hash_tab_print(hash_tab_t *htab, void *key, lock_e lock, print_cb_t print_cb)
 {
-    unsigned int idx;
-
-    idx = htab->hash(key) % htab->len;
+    uint64_t idx;
 
-    _hash_tab_lock(htab, idx, lock);
-    rbt_print(htab->tree[idx], print_cb);
+    idx = _hash_tab_lock(htab, key, lock);
+    rbt_print(hash_tab_tree(htab, idx), print_cb);
     _hash_tab_unlock(htab, idx, lock);
 }
 
@@ -246,20 +467,29 @@ void hash_tab_print(hash_tab_t *htab, void *key, lock_e lock, print_cb_t print_c
  ******************************************************************************/
 int hash_tab_destroy(hash_tab_t *htab, mem_dealloc_cb_t dealloc, void *args)
 {
-    int idx;
+    int k;
+    uint64_t idx, len;
+    hash_tab_seg_t *seg;
+
+    for (k=0; k<HASH_TAB_SEG_MAX; ++k) {
+        seg = &htab->seg[k];
+        if (NULL == seg->tree) {
+            break;
+        }
 
-    for (idx=0; idx<htab->len; ++idx) {
-        pthread_rwlock_wrlock(&htab->lock[idx]);
-        if (NULL != htab->tree[idx]) {
-            rbt_destroy(htab->tree[idx], dealloc, args);
+        len = hash_tab_seg_len(htab, k);
+        for (idx=0; idx<len; ++idx) {
+            if (NULL != seg->tree[idx]) {
+                rbt_destroy(seg->tree[idx], dealloc, args);
+            }
+            pthread_rwlock_destroy(&seg->lock[idx]);
         }
-        pthread_rwlock_unlock(&htab->lock[idx]);
 
-        pthread_rwlock_destroy(&htab->lock[idx]);
+        htab->dealloc(htab->pool, seg->tree);
+        htab->dealloc(htab->pool, seg->lock);
     }
 
-    htab->dealloc(htab->pool, htab->tree);
-    htab->dealloc(htab->pool, htab->lock);
+    pthread_rwlock_destroy(&htab->glock);
     htab->dealloc(htab->pool, htab);
 
     return 0;
@@ -281,12 +511,31 @@ int hash_tab_destroy(hash_tab_t *htab, mem_dealloc_cb_t dealloc, void *args)
  ******************************************************************************/
 int hash_tab_trav(hash_tab_t *htab, trav_cb_t proc, void *args, lock_e lock)
 {
-    int idx;
+    uint64_t idx, num;
+    pthread_rwlock_t *rwlock;
 
-    for (idx=0; idx<htab->len; ++idx) {
-        _hash_tab_lock(htab, idx, lock);
-        rbt_trav(htab->tree[idx], proc, args);
-        _hash_tab_unlock(htab, idx, lock);
+    if (hash_tab_is_grow(htab) && hash_tab_is_lock(lock)) {
+        pthread_rwlock_rdlock(&htab->glock);
+    }
+
+    num = hash_tab_slot_num(htab);
+    for (idx=0; idx<num; ++idx) {
+        rwlock = hash_tab_rwlock(htab, idx);
+        if (WRLOCK == lock) {
+            pthread_rwlock_wrlock(rwlock);
+        } else if (RDLOCK == lock) {
+            pthread_rwlock_rdlock(rwlock);
+        }
+
+        rbt_trav(hash_tab_tree(htab, idx), proc, args);
+
+        if (hash_tab_is_lock(lock)) {
+            pthread_rwlock_unlock(rwlock);
+        }
+    }
+
+    if (hash_tab_is_grow(htab) && hash_tab_is_lock(lock)) {
+        pthread_rwlock_unlock(&htab->glock);
     }
 
     return 0;
@@ -309,12 +558,10 @@ int hash_tab_trav(hash_tab_t *htab, trav_cb_t proc, void *args, lock_e lock)
  ******************************************************************************/
 int hash_tab_trav_slot(hash_tab_t *htab, const void *key, trav_cb_t proc, void *args, lock_e lock)
 {
-    int idx;
-
-    idx = htab->hash(key) % htab->len;
+    uint64_t idx;
 
-    _hash_tab_lock(htab, idx, lock);
-    rbt_trav(htab->tree[idx], proc, args);
+    idx = _hash_tab_lock(htab, key, lock);
+    rbt_trav(hash_tab_tree(htab, idx), proc, args);
     _hash_tab_unlock(htab, idx, lock);
 
     return 0;
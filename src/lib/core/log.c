@@ -1,8 +1,9 @@
 /*******************************************************************************
  ** 模  块: 异步日志模块 - 客户端代码
  ** 说  明:
- **     考虑性能要求, 日志首先存储在缓冲区中, 当缓存区中的日志达到一定量、或超
- **     过一定时间未同步、或出现错误级别日志时, 则将日志同步到日志文件中.
+ **     考虑性能要求, 每个线程将日志写入本线程的环形缓存(单生产者/单消费者, 无锁),
+ **     由日志服务的同步线程收集并写入日志文件. 写日志的线程不做磁盘IO, 缓存超过
+ **     一半或出现FATAL日志时唤醒同步线程, 否则同步线程定时同步.
  ** 注  意:
  **     不同的"进程"和"线程"是不能使用的同名的日志文件
  ** 作  者: # Qifeng.zou # 2013.11.07 #
@@ -10,13 +11,50 @@
 #include "log.h"
 #include "comm.h"
 #include "redo.h"
+#include "atomic.h"
 
 size_t g_log_max_size = LOG_MAX_SIZE;
+log_limit_conf_t g_log_limit = {LOG_LIMIT_RATE, LOG_LIMIT_BURST, LOG_LIMIT_SAMPLE};
+
+/* 日志行中的级别提示 */
+static const char *g_log_level_tag[LOG_LEVEL_TOTAL + 1] = {
+    "TRACE", "DEBUG", "INFO", "WARN", "ERROR", "FATAL", "OTHER"
+};
+
+/* 级别提示的长度 */
+static const int g_log_level_tag_len[LOG_LEVEL_TOTAL + 1] = {5, 5, 4, 4, 5, 5, 5};
+
+#define LOG_DUMP_ROW_LEN    (5 + 8 + 4 * LOG_DUMP_COL_NUM + 2) /* DUMP每行最大长度 */
+
+/* 日志行前缀缓存: "@进程号|YYYYMMDD|HH:MM:SS." 每秒只生成一次, 毫秒单独填写 */
+typedef struct
+{
+    time_t sec;                             /* 缓存对应的秒 */
+    int pid;                                /* 缓存对应的进程号 */
+    int len;                                /* 缓存长度 */
+    char prefix[LOG_PREFIX_MAX_LEN];        /* 缓存内容 */
+} log_time_cache_t;
+
+static __thread log_time_cache_t g_log_time_cache = {-1, 0, 0, {0}};
+
+/* 二进制日志的格式注册表(格式ID = 下标 + 1) */
+static struct
+{
+    pthread_mutex_t lock;                   /* 锁 */
+    volatile uint32_t num;                  /* 格式数 */
+    uint32_t cap;                           /* 数组容量 */
+    log_fmt_t **list;                       /* 调用点数组 */
+} g_log_fmt = {PTHREAD_MUTEX_INITIALIZER, 0, 0, NULL};
+
+#define LOG_FMT_TEXT_ID     (0xFFFFFFFF)    /* 不支持二进制的调用点 */
 
 /* 函数声明 */
 static int log_write(log_cycle_t *log, int level,
-        const void *dump, int dumplen, const char *msg, const struct timeb *ctm);
+        const char *fname, int lineno, const char *func,
+        const void *dump, int dumplen, const char *fmt, va_list args);
 static int log_print_dump(char *addr, const void *dump, int dumplen);
+static void log_ring_release(void *_ring);
+static int log_bin_write(log_cycle_t *log, log_fmt_t *site, va_list args);
 
 /******************************************************************************
  **函数名称: log_init
@@ -53,6 +91,14 @@ log_cycle_t *log_init(int level, const char *path)
     log->level = level;
     log->pid = getpid();
     pthread_mutex_init(&log->lock, NULL);
+    pthread_mutex_init(&log->ring.lock, NULL);
+
+    if (pthread_key_create(&log->ring.key, log_ring_release)) {
+        pthread_mutex_destroy(&log->ring.lock);
+        pthread_mutex_destroy(&log->lock);
+        free(log);
+        return NULL;
+    }
 
     do {
         /* > 创建日志缓存 */
@@ -80,11 +126,141 @@ log_cycle_t *log_init(int level, const char *path)
 
     /* 5. 异常处理 */
     FREE(log->text);
+    pthread_key_delete(log->ring.key);
+    pthread_mutex_destroy(&log->ring.lock);
     pthread_mutex_destroy(&log->lock);
     free(log);
     return NULL;
 }
 
+/******************************************************************************
+ **函数名称: log_ring_get
+ **功    能: 获取当前线程的日志缓存
+ **输入参数:
+ **     log: 日志对象
+ **输出参数: NONE
+ **返    回: 环形缓存
+ **实现描述: 首次写日志时创建, 并加入日志对象的缓存链表, 由同步线程收集
+ **注意事项: 链表由ring.lock保护, 而非log->lock: 同步线程持有log->lock写文件,
+ **          线程首次写日志不应因此等待磁盘IO
+ **作    者: # Qifeng.zou # 2015.09.22 #
+ ******************************************************************************/
+static log_ring_t *log_ring_get(log_cycle_t *log)
+{
+    log_ring_t *ring;
+
+    ring = (log_ring_t *)pthread_getspecific(log->ring.key);
+    if (NULL != ring) {
+        return ring;
+    }
+
+    ring = (log_ring_t *)calloc(1, sizeof(log_ring_t));
+    if (NULL == ring) {
+        return NULL;
+    }
+
+    ring->size = LOG_RING_SIZE;
+    ring->data = (char *)malloc(ring->size);
+    if (NULL == ring->data) {
+        free(ring);
+        return NULL;
+    }
+
+    if (pthread_setspecific(log->ring.key, ring)) {
+        free(ring->data);
+        free(ring);
+        return NULL;
+    }
+
+    pthread_mutex_lock(&log->ring.lock);
+    ring->next = log->ring.list;
+    log->ring.list = ring;
+    pthread_mutex_unlock(&log->ring.lock);
+
+    return ring;
+}
+
+/******************************************************************************
+ **函数名称: log_ring_release
+ **功    能: 线程退出时释放日志缓存
+ **输入参数:
+ **     _ring: 环形缓存
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述: 只设置退出标志, 剩余日志由同步线程写入文件后再释放
+ **注意事项:
+ **作    者: # Qifeng.zou # 2015.09.22 #
+ ******************************************************************************/
+static void log_ring_release(void *_ring)
+{
+    log_ring_t *ring = (log_ring_t *)_ring;
+
+    compiler_barrier();
+    ring->closed = 1;
+}
+
+/******************************************************************************
+ **函数名称: log_ring_reserve
+ **功    能: 在环形缓存中申请一条记录的空间
+ **输入参数:
+ **     ring: 环形缓存
+ **     need: 记录最大长度(含记录头, 8字节对齐)
+ **输出参数:
+ **     pos: 记录起始位置
+ **返    回: 日志文本的写入地址(NULL:空间不足)
+ **实现描述: 尾部连续空间不足时, 写入跳过标记后从头部申请
+ **注意事项: 只能由所属线程调用. 提交(log_ring_commit)后同步线程才可见
+ **作    者: # Qifeng.zou # 2015.09.22 #
+ ******************************************************************************/
+static char *log_ring_reserve(log_ring_t *ring, size_t need, uint64_t *pos)
+{
+    size_t off, left;
+    uint64_t head = ring->head, tail = ring->tail;
+
+    off = head & (ring->size - 1);
+    left = ring->size - off;
+    if (left < need) {
+        if (head + left + need - tail > ring->size) {
+            return NULL;
+        }
+        *(uint32_t *)(ring->data + off) = LOG_RING_SKIP;
+        head += left;
+        off = 0;
+    } else if (head + need - tail > ring->size) {
+        return NULL;
+    }
+
+    *pos = head;
+
+    return ring->data + off + LOG_RING_HEAD_LEN;
+}
+
+/******************************************************************************
+ **函数名称: log_ring_commit
+ **功    能: 提交记录
+ **输入参数:
+ **     ring: 环形缓存
+ **     pos: 记录起始位置(log_ring_reserve()的输出)
+ **     type: 记录类型(log_rec_type_e)
+ **     len: 记录内容长度
+ **输出参数: NONE
+ **返    回: 缓存已使用的空间
+ **实现描述: 先写记录头, 再发布head(x86写写不重排, 仅需编译器屏障)
+ **注意事项: 只能由所属线程调用
+ **作    者: # Qifeng.zou # 2015.09.22 #
+ ******************************************************************************/
+static size_t log_ring_commit(log_ring_t *ring, uint64_t pos, int type, size_t len)
+{
+    char *head = ring->data + (pos & (ring->size - 1));
+
+    *(uint32_t *)head = (uint32_t)len;
+    *(uint32_t *)(head + sizeof(uint32_t)) = (uint32_t)type;
+    compiler_barrier();
+    ring->head = pos + LOG_RING_HEAD_LEN + ((len + 7) & ~7UL);
+
+    return ring->head - ring->tail;
+}
+
 /******************************************************************************
  **函数名称: log_core
  **功    能: 日志核心调用
@@ -98,11 +274,7 @@ log_cycle_t *log_init(int level, const char *path)
  **     fmt: 格式化输出
  **输出参数: NONE
  **返    回: VOID
- **实现描述:
- **     1. 判断日志级别
- **     2. 获取系统时间
- **     3. 组合日志信息
- **     4. 日志同步处理
+ **实现描述: 将日志直接格式化到当前线程的环形缓存中
  **注意事项: 日志级别的判断在函数外进行判断
  **作    者: # Qifeng.zou # 2013.10.24 #
  ******************************************************************************/
@@ -111,19 +283,11 @@ void log_core(log_cycle_t *log, int level,
                 const void *dump, int dumplen,
                 const char *fmt, ...)
 {
-    int len;
     va_list args;
-    struct timeb ctm;
-    char errmsg[LOG_MSG_MAX_LEN];
 
     va_start(args, fmt);
-    len = snprintf(errmsg, sizeof(errmsg), "[%s][%d]%s() ", fname, lineno, func);
-    vsnprintf(errmsg + len, sizeof(errmsg) - len, fmt, args);
+    log_write(log, level, fname, lineno, func, dump, dumplen, fmt, args);
     va_end(args);
-
-    ftime(&ctm);
-
-    log_write(log, level, dump, dumplen, errmsg, &ctm);
 }
 
 /******************************************************************************
@@ -217,119 +381,374 @@ void log_set_max_size(size_t size)
     _log_set_max_size(size);
 }
 
+/******************************************************************************
+ **函数名称: log_set_limit
+ **功    能: 设置log_error()/log_warn()的限流参数
+ **输入参数:
+ **     rate: 每个调用点每秒补充的令牌数(0:不限流)
+ **     burst: 令牌桶容量(小于rate时取rate)
+ **     sample: 被抑制的日志每sample条输出1条(0:不抽样)
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述:
+ **注意事项: 对所有日志对象生效, 应在初始化时设置
+ **作    者: # Qifeng.zou # 2015.09.27 #
+ ******************************************************************************/
+void log_set_limit(uint32_t rate, uint32_t burst, uint32_t sample)
+{
+    g_log_limit.burst = (burst < rate)? rate : burst;
+    g_log_limit.sample = sample;
+    g_log_limit.rate = rate;
+}
+
+/******************************************************************************
+ **函数名称: log_limit_refill
+ **功    能: 补充调用点的令牌并汇总被抑制的日志
+ **输入参数:
+ **     log: 日志对象
+ **     lim: 调用点限流对象
+ **     level: 日志级别
+ **     fname: 文件名
+ **     lineno: 文件行号
+ **     func: 函数名
+ **     now: 当前时间(秒)
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述: 每秒只有一个线程执行补充(CAS更新时间), 按经过的秒数补充令牌,
+ **          不超过令牌桶容量; 有被抑制的日志时输出一条汇总
+ **注意事项: 汇总在该调用点下一次被调用时输出
+ **作    者: # Qifeng.zou # 2015.09.27 #
+ ******************************************************************************/
+void log_limit_refill(log_cycle_t *log, log_limit_t *lim, int level,
+        const char *fname, int lineno, const char *func, uint32_t now)
+{
+    int32_t tokens;
+    uint64_t add;
+    uint32_t last = lim->sec, n, sample;
+
+    if ((last == now) || !atomic32_cmp_and_set(&lim->sec, last, now)) {
+        return; /* 其他线程已补充 */
+    }
+
+    /* > 补充令牌 */
+    add = (0 == last)? g_log_limit.burst : (uint64_t)(now - last) * g_log_limit.rate;
+    tokens = (int32_t)lim->tokens;
+    if (tokens < 0) {
+        tokens = 0;
+    }
+    add += tokens;
+    atomic32_xset(&lim->tokens, (add > g_log_limit.burst)? g_log_limit.burst : (uint32_t)add);
+
+    /* > 汇总被抑制的日志 */
+    n = atomic32_xset(&lim->suppressed, 0);
+    if (0 == n) {
+        return;
+    }
+
+    sample = g_log_limit.sample;
+    log_core(log, level, fname, lineno, func, NULL, 0,
+            "%u similar messages suppressed in last %us (%u of them logged by sampling)",
+            n, (0 == last)? 0 : now - last, sample? n / sample : 0);
+}
+
+/* 截断snprintf的返回值: 返回实际写入的长度 */
+static inline int log_fmt_len(int len, int cap)
+{
+    return (len < 0)? 0 : ((len >= cap)? cap - 1 : len);
+}
+
+/* 按固定宽度输出整数(不足时补0), 返回写入的长度 */
+static inline int log_fmt_uint(char *addr, unsigned int val, int width)
+{
+    int idx;
+
+    for (idx=width-1; idx>=0; --idx) {
+        addr[idx] = '0' + val % 10;
+        val /= 10;
+    }
+
+    return width;
+}
+
+/* 输出十进制整数, 返回写入的长度 */
+static inline int log_fmt_int(char *addr, int val)
+{
+    int len = 0, idx;
+    char buff[16];
+    unsigned int uval = (val < 0)? -(unsigned int)val : (unsigned int)val;
+
+    do {
+        buff[len++] = '0' + uval % 10;
+        uval /= 10;
+    } while (uval);
+
+    idx = 0;
+    if (val < 0) {
+        addr[idx++] = '-';
+    }
+    while (len > 0) {
+        addr[idx++] = buff[--len];
+    }
+
+    return idx;
+}
+
+/******************************************************************************
+ **函数名称: log_fmt_prefix
+ **功    能: 生成日志行前缀
+ **输入参数:
+ **     log: 日志对象
+ **     level: 日志级别
+ **输出参数:
+ **     addr: 日志行前缀(@进程号|YYYYMMDD|HH:MM:SS.MMM|级别提示 )
+ **返    回: 前缀长度
+ **实现描述:
+ **     前缀中只有毫秒变化频繁, 因此每个线程缓存"@进程号|YYYYMMDD|HH:MM:SS."
+ **     部分, 秒或进程号变化时才重新生成, 其余部分逐字节填写, 不调用snprintf.
+ **注意事项: 前缀最大长度约40字节, 小于LOG_PREFIX_MAX_LEN
+ **作    者: # Qifeng.zou # 2015.09.25 #
+ ******************************************************************************/
+static int log_fmt_prefix(log_cycle_t *log, int level, char *addr)
+{
+    int len;
+    struct tm loctm;
+    struct timespec ts;
+    log_time_cache_t *cache = &g_log_time_cache;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+
+    /* > 更新缓存 */
+    if ((ts.tv_sec != cache->sec) || (log->pid != cache->pid)) {
+        local_time(&ts.tv_sec, &loctm);
+
+        len = 0;
+        cache->prefix[len++] = '@';
+        len += log_fmt_int(cache->prefix + len, log->pid);
+        cache->prefix[len++] = '|';
+        len += log_fmt_uint(cache->prefix + len, loctm.tm_year + 1900, 4);
+        len += log_fmt_uint(cache->prefix + len, loctm.tm_mon + 1, 2);
+        len += log_fmt_uint(cache->prefix + len, loctm.tm_mday, 2);
+        cache->prefix[len++] = '|';
+        len += log_fmt_uint(cache->prefix + len, loctm.tm_hour, 2);
+        cache->prefix[len++] = ':';
+        len += log_fmt_uint(cache->prefix + len, loctm.tm_min, 2);
+        cache->prefix[len++] = ':';
+        len += log_fmt_uint(cache->prefix + len, loctm.tm_sec, 2);
+        cache->prefix[len++] = '.';
+
+        cache->len = len;
+        cache->pid = log->pid;
+        cache->sec = ts.tv_sec;
+    }
+
+    /* > 拷贝缓存并填写毫秒和级别 */
+    memcpy(addr, cache->prefix, cache->len);
+    len = cache->len;
+    len += log_fmt_uint(addr + len, ts.tv_nsec / 1000000, 3);
+    addr[len++] = '|';
+    memcpy(addr + len, g_log_level_tag[level], g_log_level_tag_len[level]);
+    len += g_log_level_tag_len[level];
+    addr[len++] = ' ';
+
+    return len;
+}
+
+/******************************************************************************
+ **函数名称: log_fmt_location
+ **功    能: 生成日志的位置信息
+ **输入参数:
+ **     fname: 文件名
+ **     lineno: 文件行号
+ **     func: 函数名
+ **输出参数:
+ **     addr: 位置信息([文件][行号]函数() )
+ **返    回: 长度(最大LOG_MSG_MAX_LEN-1)
+ **实现描述: 长度足够时逐字节填写, 否则交给snprintf截断
+ **注意事项:
+ **作    者: # Qifeng.zou # 2015.09.25 #
+ ******************************************************************************/
+static int log_fmt_location(const char *fname, int lineno, const char *func, char *addr)
+{
+    int len;
+    size_t flen = strlen(fname), fnlen = strlen(func);
+
+    if (flen + fnlen + 32 > LOG_MSG_MAX_LEN) {
+        return log_fmt_len(snprintf(addr, LOG_MSG_MAX_LEN,
+                    "[%s][%d]%s() ", fname, lineno, func), LOG_MSG_MAX_LEN);
+    }
+
+    len = 0;
+    addr[len++] = '[';
+    memcpy(addr + len, fname, flen);
+    len += flen;
+    addr[len++] = ']';
+    addr[len++] = '[';
+    len += log_fmt_int(addr + len, lineno);
+    addr[len++] = ']';
+    memcpy(addr + len, func, fnlen);
+    len += fnlen;
+    addr[len++] = '(';
+    addr[len++] = ')';
+    addr[len++] = ' ';
+
+    return len;
+}
+
+/* 报告此前丢弃的日志条数(缓存使用降到一半以下才报告并恢复等待, 否则下次再试) */
+static void log_ring_drop_report(log_cycle_t *log, log_ring_t *ring)
+{
+    int len;
+    char *addr;
+    uint64_t pos;
+    size_t need = (LOG_RING_HEAD_LEN + LOG_PREFIX_MAX_LEN + 64 + 7) & ~7UL;
+
+    if (ring->head - ring->tail > ring->size / 2) {
+        return; /* 同步线程尚未恢复 */
+    }
+
+    addr = log_ring_reserve(ring, need, &pos);
+    if (NULL == addr) {
+        return;
+    }
+
+    len = log_fmt_prefix(log, LOG_LEVEL_WARN, addr);
+    len += log_fmt_len(snprintf(addr + len, 64,
+                "%u log records dropped: ring buffer full\n", ring->drop), 64);
+
+    log_ring_commit(ring, pos, LOG_REC_TEXT, len);
+    ring->drop = 0;
+}
+
+/******************************************************************************
+ **函数名称: log_ring_wait
+ **功    能: 在环形缓存中申请空间(空间不足时有限等待)
+ **输入参数:
+ **     log: 日志对象
+ **     ring: 环形缓存
+ **     need: 记录最大长度(含记录头, 8字节对齐)
+ **输出参数:
+ **     pos: 记录起始位置
+ **返    回: 写入地址(NULL:超时, 本条日志被丢弃)
+ **实现描述:
+ **     1. 有未报告的丢弃数时, 先写入一条丢弃汇总
+ **     2. 空间不足时唤醒同步线程, 先让出CPU LOG_RING_YIELD_NUM次, 再每次睡眠
+ **        1毫秒, 最多LOG_RING_WAIT_MSEC次; 仍不足则丢弃本条并计数
+ **     3. 已处于丢弃状态(丢弃数尚未报告)时不再等待, 直接丢弃, 直到缓存使用
+ **        降到一半以下. 避免同步线程停止工作后, 每条日志都让业务线程阻塞
+ **        LOG_RING_WAIT_MSEC
+ **注意事项: 只能由所属线程调用
+ **作    者: # Qifeng.zou # 2015.09.22 #
+ ******************************************************************************/
+static char *log_ring_wait(log_cycle_t *log, log_ring_t *ring, size_t need, uint64_t *pos)
+{
+    int n;
+    char *addr;
+
+    if (ring->drop) {
+        log_ring_drop_report(log, ring);
+    }
+
+    for (n=0; NULL == (addr = log_ring_reserve(ring, need, pos)); ++n) {
+        if (ring->drop || (n >= LOG_RING_YIELD_NUM + LOG_RING_WAIT_MSEC)) {
+            ++ring->drop;
+            return NULL;
+        }
+
+        log_svr_notify(log->owner);
+        if (n < LOG_RING_YIELD_NUM) {
+            sched_yield();
+            continue;
+        }
+        usleep(1000);
+    }
+
+    return addr;
+}
+
 /******************************************************************************
  **函数名称: log_write
  **功    能: 将日志信息写入缓存
  **输入参数:
- **     cycle: 日志对象
+ **     log: 日志对象
  **     level: 日志级别
+ **     fname: 文件名
+ **     lineno: 文件行号
+ **     func: 函数名
  **     dump: 内存地址
  **     dumplen: 需打印的地址长度
- **     msg: 日志内容
+ **     fmt: 格式化输出
+ **     args: 可变参数
  **输出参数: NONE
- **返    回: 0:成功 !0:失败
+ **返    回: 0:成功 !0:失败(含缓存已满而丢弃)
  **实现描述:
- **注意事项:
+ **     1. 按最大长度在本线程的环形缓存中申请空间, 空间不足时唤醒同步线程并有限
+ **        等待(见log_ring_wait()), 超时则丢弃本条日志并计数, 恢复后写入一条
+ **        "N log records dropped"的汇总
+ **     2. 格式化: @进程号|YYYYMMDD|HH:MM:SS.MMM|级别提示 [文件][行号]函数() 内容
+ **        其中前缀和位置信息不经过snprintf, 见log_fmt_prefix()/log_fmt_location()
+ **     3. 提交记录, 缓存使用超过一半或FATAL日志时唤醒同步线程
+ **注意事项: 不加锁, 不做磁盘IO. 缓存满时选择丢弃而非改为加锁直接写文件: 缓存
+ **          满说明磁盘跟不上, 此时在业务线程中做磁盘IO只会把阻塞传给所有写日志
+ **          的线程, 且会打乱与缓存中尚未写入的日志的先后顺序.
  **作    者: # Qifeng.zou # 2013.10.31 #
  ******************************************************************************/
 static int log_write(log_cycle_t *log, int level,
-    const void *dump, int dumplen, const char *errmsg, const struct timeb *ctm)
+        const char *fname, int lineno, const char *func,
+        const void *dump, int dumplen, const char *fmt, va_list args)
 {
-    int msglen, left;
+    int len, rows;
     char *addr;
-    struct tm loctm;
+    size_t need, used;
+    uint64_t pos;
+    log_ring_t *ring;
 
-    local_time(&ctm->time, &loctm);        /* 获取当前系统时间 */
-
-    pthread_mutex_lock(&log->lock);
-
-    addr = log->text + log->inoff;
-    left = log->size - log->inoff;
+    ring = log_ring_get(log);
+    if (NULL == ring) {
+        return -1;
+    }
 
-    switch (level) {
-        case LOG_LEVEL_FATAL:
-        {
-            /* @进程号|YYYYMMDD|HH:MM:SS.MM|级别提示 日志内容 */
-            snprintf(addr, left, "@%d|%04d%02d%02d|%02d:%02d:%02d.%03d|FATAL %s\n",
-                    log->pid, loctm.tm_year+1900, loctm.tm_mon+1, loctm.tm_mday,
-                    loctm.tm_hour, loctm.tm_min, loctm.tm_sec,
-                    ctm->millitm, errmsg);
-            break;
-        }
-        case LOG_LEVEL_ERROR:
-        {
-            /* @进程号|YYYYMMDD|HH:MM:SS.MM|级别提示 日志内容 */
-            snprintf(addr, left, "@%d|%04d%02d%02d|%02d:%02d:%02d.%03d|ERROR %s\n",
-                    log->pid, loctm.tm_year+1900, loctm.tm_mon+1, loctm.tm_mday,
-                    loctm.tm_hour, loctm.tm_min, loctm.tm_sec,
-                    ctm->millitm, errmsg);
-            break;
-        }
-        case LOG_LEVEL_WARN:
-        {
-            /* @进程号|YYYYMMDD|HH:MM:SS.MM|级别提示 日志内容 */
-            snprintf(addr, left, "@%d|%04d%02d%02d|%02d:%02d:%02d.%03d|WARN %s\n",
-                    log->pid, loctm.tm_year+1900, loctm.tm_mon+1, loctm.tm_mday,
-                    loctm.tm_hour, loctm.tm_min, loctm.tm_sec,
-                    ctm->millitm, errmsg);
-            break;
-        }
-        case LOG_LEVEL_INFO:
-        {
-            /* @进程号|YYYYMMDD|HH:MM:SS.MM|级别提示 日志内容 */
-            snprintf(addr, left, "@%d|%04d%02d%02d|%02d:%02d:%02d.%03d|INFO %s\n",
-                    log->pid, loctm.tm_year+1900, loctm.tm_mon+1, loctm.tm_mday,
-                    loctm.tm_hour, loctm.tm_min, loctm.tm_sec,
-                    ctm->millitm, errmsg);
-            break;
-        }
-        case LOG_LEVEL_DEBUG:
-        {
-            /* @进程号|YYYYMMDD|HH:MM:SS.MM|级别提示 日志内容 */
-            snprintf(addr, left, "@%d|%04d%02d%02d|%02d:%02d:%02d.%03d|DEBUG %s\n",
-                    log->pid, loctm.tm_year+1900, loctm.tm_mon+1, loctm.tm_mday,
-                    loctm.tm_hour, loctm.tm_min, loctm.tm_sec,
-                    ctm->millitm, errmsg);
-            break;
-        }
-        case LOG_LEVEL_TRACE:
-        {
-            /* @进程号|YYYYMMDD|HH:MM:SS.MM|级别提示 日志内容 */
-            snprintf(addr, left, "@%d|%04d%02d%02d|%02d:%02d:%02d.%03d|TRACE %s\n",
-                    log->pid, loctm.tm_year+1900, loctm.tm_mon+1, loctm.tm_mday,
-                    loctm.tm_hour, loctm.tm_min, loctm.tm_sec,
-                    ctm->millitm, errmsg);
-            break;
-        }
-        default:
-        {
-            /* @进程号|YYYYMMDD|HH:MM:SS.MM|级别提示 日志内容 */
-            snprintf(addr, left, "@%d|%04d%02d%02d|%02d:%02d:%02d.%03d|OTHER %s\n",
-                    log->pid, loctm.tm_year+1900, loctm.tm_mon+1, loctm.tm_mday,
-                    loctm.tm_hour, loctm.tm_min, loctm.tm_sec,
-                    ctm->millitm, errmsg);
-            break;
+    /* > 计算记录的最大长度(DUMP过长时截断) */
+    need = LOG_RING_HEAD_LEN + LOG_PREFIX_MAX_LEN + LOG_MSG_MAX_LEN + 1;
+    if ((NULL != dump) && (dumplen > 0)) {
+        rows = (dumplen - 1) / LOG_DUMP_COL_NUM + 1;
+        if ((size_t)rows * 2 * LOG_DUMP_ROW_LEN > ring->size / 4) {
+            rows = ring->size / 4 / (2 * LOG_DUMP_ROW_LEN);
+            dumplen = rows * LOG_DUMP_COL_NUM;
         }
+        need += rows * 2 * LOG_DUMP_ROW_LEN; /* 含每LOG_DUMP_PAGE_MAX_ROWS行的头部 */
     }
+    need = (need + 7) & ~7UL;
 
-    msglen = strlen(addr);
-    log->inoff += msglen;
-    addr += msglen;
-    left -= msglen;
+    /* > 申请空间 */
+    addr = log_ring_wait(log, ring, need, &pos);
+    if (NULL == addr) {
+        return -1;
+    }
 
-    /* 打印DUMP数据 */
-    if ((NULL != dump) && (dumplen > 0) && (left > dumplen)) {
-        msglen = log_print_dump(addr, dump, dumplen);
-        log->inoff += msglen;
+    /* > 格式化日志 */
+    if ((level < 0) || (level >= LOG_LEVEL_TOTAL)) {
+        level = LOG_LEVEL_TOTAL;
     }
 
-    /* 判断是否强制同步 */
-    if (left <= 0.8 * log->size) {
-        memcpy(&log->sync_tm, ctm, sizeof(log->sync_tm));
-        log_sync(log);
+    len = log_fmt_prefix(log, level, addr);
+    len += log_fmt_location(fname, lineno, func, addr + len);
+    if (len < LOG_PREFIX_MAX_LEN + LOG_MSG_MAX_LEN - 1) {
+        len += log_fmt_len(vsnprintf(addr + len,
+                    LOG_PREFIX_MAX_LEN + LOG_MSG_MAX_LEN - len, fmt, args),
+                    LOG_PREFIX_MAX_LEN + LOG_MSG_MAX_LEN - len);
     }
+    addr[len++] = '\n';
 
-    pthread_mutex_unlock(&log->lock);
+    /* > 打印DUMP数据 */
+    if ((NULL != dump) && (dumplen > 0)) {
+        len += log_print_dump(addr + len, dump, dumplen);
+    }
+
+    /* > 提交并判断是否唤醒同步线程 */
+    used = log_ring_commit(ring, pos, LOG_REC_TEXT, len);
+    if ((used > ring->size / 2) || (LOG_LEVEL_FATAL == level)) {
+        log_svr_notify(log->owner);
+    }
 
     return 0;
 }
@@ -378,7 +797,7 @@ static int log_print_dump(char *addr, const void *dump, int dumplen)
 
             /* >>3.1 16进制打印一行 */
             for (idx=0; (idx<LOG_DUMP_COL_NUM) && (dump_ptr<dump_end); idx++) {
-                sprintf(in, "%02x ", *dump_ptr);
+                sprintf(in, "%02x ", (unsigned char)*dump_ptr);
                 in += 3;
                 dump_ptr++;
             }
@@ -411,3 +830,645 @@ static int log_print_dump(char *addr, const void *dump, int dumplen)
 
     return (in - addr);
 }
+
+/******************************************************************************
+ **函数名称: log_fmt_parse
+ **功    能: 解析格式串的参数类型
+ **输入参数:
+ **     site: 调用点
+ **     fmt: 格式串
+ **输出参数:
+ **     site: 参数个数、类型及字符串参数的精度
+ **返    回: 0:成功 !0:不支持二进制输出
+ **实现描述: 按printf的转换说明([标志][宽度][.精度][长度]转换符)依次解析,
+ **          宽度或精度为'*'时对应一个int参数. 字符串参数记录其精度, 写入时
+ **          据此限制读取长度(缓存可以不以'\0'结尾)
+ **注意事项: 不支持%n, %m, %Lf, %ls等
+ **作    者: # Qifeng.zou # 2015.09.26 #
+ ******************************************************************************/
+static int log_fmt_parse(log_fmt_t *site, const char *fmt)
+{
+    int argc = 0, islong, prec;
+    const char *p = fmt;
+
+#define LOG_FMT_ADD_ARG(_type) \
+    if (argc >= LOG_BIN_ARG_MAX) { return -1; } \
+    site->prec[argc] = LOG_ARG_PREC_NONE; \
+    site->type[argc++] = (_type);
+
+    while ('\0' != *p) {
+        if ('%' != *p++) {
+            continue;
+        }
+        else if ('%' == *p) {
+            ++p;
+            continue;
+        }
+
+        /* > 标志 */
+        while (('-' == *p) || ('+' == *p) || (' ' == *p) || ('#' == *p) || ('0' == *p) || ('\'' == *p)) {
+            ++p;
+        }
+
+        /* > 宽度 */
+        if ('*' == *p) {
+            LOG_FMT_ADD_ARG(LOG_ARG_INT);
+            ++p;
+        }
+        while (isdigit(*p)) {
+            ++p;
+        }
+
+        /* > 精度 */
+        prec = LOG_ARG_PREC_NONE;
+        if ('.' == *p) {
+            ++p;
+            if ('*' == *p) {
+                LOG_FMT_ADD_ARG(LOG_ARG_INT);
+                prec = LOG_ARG_PREC_STAR;
+                ++p;
+            }
+            else {
+                prec = 0;
+                while (isdigit(*p)) {
+                    prec = MIN(10 * prec + (*p - '0'), LOG_MSG_MAX_LEN);
+                    ++p;
+                }
+            }
+        }
+
+        /* > 长度 */
+        islong = 0;
+        while (('h' == *p) || ('l' == *p) || ('z' == *p) || ('j' == *p) || ('t' == *p) || ('q' == *p)) {
+            islong |= ('h' != *p);
+            ++p;
+        }
+        if ('L' == *p) {
+            return -1;
+        }
+
+        /* > 转换符 */
+        switch (*p++) {
+            case 'd': case 'i': case 'u': case 'x': case 'X': case 'o':
+            {
+                LOG_FMT_ADD_ARG(islong? LOG_ARG_LONG : LOG_ARG_INT);
+                break;
+            }
+            case 'c':
+            {
+                if (islong) { return -1; } /* wint_t */
+                LOG_FMT_ADD_ARG(LOG_ARG_INT);
+                break;
+            }
+            case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+            {
+                LOG_FMT_ADD_ARG(LOG_ARG_DOUBLE);
+                break;
+            }
+            case 's':
+            {
+                if (islong) { return -1; } /* wchar_t * */
+                LOG_FMT_ADD_ARG(LOG_ARG_STR);
+                site->prec[argc-1] = prec;
+                break;
+            }
+            case 'p':
+            {
+                LOG_FMT_ADD_ARG(LOG_ARG_PTR);
+                break;
+            }
+            default:
+            {
+                return -1;
+            }
+        }
+    }
+
+#undef LOG_FMT_ADD_ARG
+
+    site->argc = argc;
+
+    return 0;
+}
+
+/******************************************************************************
+ **函数名称: log_fmt_register
+ **功    能: 注册调用点的格式串
+ **输入参数:
+ **     site: 调用点
+ **     fmt: 格式串
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述: 解析参数类型并分配格式ID; 格式不支持或过长时标记为按文本输出
+ **注意事项: 每个调用点只在首次调用时执行一次
+ **作    者: # Qifeng.zou # 2015.09.26 #
+ ******************************************************************************/
+static void log_fmt_register(log_fmt_t *site, const char *fmt)
+{
+    uint32_t cap;
+    log_fmt_t **list;
+
+    pthread_mutex_lock(&g_log_fmt.lock);
+    if (0 != site->id) {
+        pthread_mutex_unlock(&g_log_fmt.lock);
+        return;
+    }
+
+    site->fmt = fmt;
+
+    /* > 解析参数类型(格式定义须能放入一条记录) */
+    if (log_fmt_parse(site, fmt)
+        || (LOG_RING_HEAD_LEN + sizeof(log_bin_fmt_t) + LOG_BIN_ARG_MAX
+            + strlen(site->fname) + strlen(site->func) + strlen(fmt) + 3 > LOG_MSG_MAX_LEN))
+    {
+        site->argc = -1;
+        compiler_barrier();
+        site->id = LOG_FMT_TEXT_ID;
+        pthread_mutex_unlock(&g_log_fmt.lock);
+        return;
+    }
+
+    /* > 分配格式ID */
+    if (g_log_fmt.num >= g_log_fmt.cap) {
+        cap = g_log_fmt.cap? 2 * g_log_fmt.cap : 256;
+        list = (log_fmt_t **)realloc(g_log_fmt.list, cap * sizeof(log_fmt_t *));
+        if (NULL == list) {
+            site->argc = -1;
+            compiler_barrier();
+            site->id = LOG_FMT_TEXT_ID;
+            pthread_mutex_unlock(&g_log_fmt.lock);
+            return;
+        }
+        g_log_fmt.list = list;
+        g_log_fmt.cap = cap;
+    }
+
+    g_log_fmt.list[g_log_fmt.num] = site;
+    compiler_barrier();
+    site->id = ++g_log_fmt.num;
+
+    pthread_mutex_unlock(&g_log_fmt.lock);
+}
+
+/******************************************************************************
+ **函数名称: log_fmt_total
+ **功    能: 获取已注册的格式数
+ **输入参数: NONE
+ **输出参数: NONE
+ **返    回: 格式数(即最大的格式ID)
+ **实现描述:
+ **注意事项:
+ **作    者: # Qifeng.zou # 2015.09.26 #
+ ******************************************************************************/
+uint32_t log_fmt_total(void)
+{
+    return g_log_fmt.num;
+}
+
+/******************************************************************************
+ **函数名称: log_fmt_encode
+ **功    能: 生成格式定义记录
+ **输入参数:
+ **     id: 格式ID
+ **     size: 缓存SIZE(不小于LOG_MSG_MAX_LEN)
+ **输出参数:
+ **     addr: 格式定义记录(记录头+log_bin_fmt_t+参数类型+字符串)
+ **返    回: 记录长度(-1:格式ID不存在)
+ **实现描述:
+ **注意事项: 由同步线程调用
+ **作    者: # Qifeng.zou # 2015.09.26 #
+ ******************************************************************************/
+int log_fmt_encode(uint32_t id, char *addr, size_t size)
+{
+    int len;
+    size_t n;
+    log_fmt_t *site;
+    log_bin_fmt_t *def;
+
+    if (size < LOG_MSG_MAX_LEN) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&g_log_fmt.lock);
+    if ((0 == id) || (id > g_log_fmt.num)) {
+        pthread_mutex_unlock(&g_log_fmt.lock);
+        return -1;
+    }
+    site = g_log_fmt.list[id - 1];
+    pthread_mutex_unlock(&g_log_fmt.lock);
+
+    len = LOG_RING_HEAD_LEN;
+    def = (log_bin_fmt_t *)(addr + len);
+    def->id = id;
+    def->lineno = site->lineno;
+    def->level = site->level;
+    def->argc = site->argc;
+    len += sizeof(log_bin_fmt_t);
+
+    memcpy(addr + len, site->type, site->argc);
+    len += site->argc;
+
+    n = strlen(site->fname) + 1;
+    memcpy(addr + len, site->fname, n);
+    len += n;
+    n = strlen(site->func) + 1;
+    memcpy(addr + len, site->func, n);
+    len += n;
+    n = strlen(site->fmt) + 1;
+    memcpy(addr + len, site->fmt, n);
+    len += n;
+
+    *(uint32_t *)addr = len - LOG_RING_HEAD_LEN;
+    *(uint32_t *)(addr + sizeof(uint32_t)) = LOG_REC_FMT;
+
+    return len;
+}
+
+/* 从二进制日志中取出一个8字节的参数(整数/浮点数/指针) */
+static int log_bin_arg(const char **arg, const char *end, void *val)
+{
+    if (*arg + sizeof(uint64_t) > end) {
+        return -1;
+    }
+    memcpy(val, *arg, sizeof(uint64_t));
+    *arg += sizeof(uint64_t);
+    return 0;
+}
+
+/******************************************************************************
+ **函数名称: log_bin_decode
+ **功    能: 将二进制日志还原为文本日志行
+ **输入参数:
+ **     data: 二进制日志(log_bin_data_t+参数, 不含记录头)
+ **     len: 二进制日志长度
+ **     size: 缓存SIZE(不小于LOG_PREFIX_MAX_LEN + LOG_MSG_MAX_LEN + 1)
+ **输出参数:
+ **     addr: 日志行(与log_write()的格式相同, 以'\n'结尾)
+ **返    回: 日志行长度(-1:格式ID不存在或参数不完整)
+ **实现描述: 与tools/log_decode.py相同, 按格式串逐个转换说明取出参数, 宽度及
+ **          精度为'*'时代入参数值, 再交给snprintf转换单个参数
+ **注意事项: 由同步线程调用. 用于切换到文本模式前已写入缓存的二进制日志
+ **作    者: # Qifeng.zou # 2015.09.26 #
+ ******************************************************************************/
+int log_bin_decode(const char *data, uint32_t len, char *addr, size_t size)
+{
+    int idx, n, level, width, prec;
+    int64_t ival;
+    double dval;
+    uint32_t slen;
+    size_t off, cap;
+    struct tm loctm;
+    time_t sec;
+    char spec[64];
+    log_fmt_t *site;
+    const char *p, *arg, *end = data + len;
+    const log_bin_data_t *bin = (const log_bin_data_t *)data;
+
+    if ((len < sizeof(log_bin_data_t))
+        || (size < LOG_PREFIX_MAX_LEN + LOG_MSG_MAX_LEN + 1)) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&g_log_fmt.lock);
+    if ((0 == bin->id) || (bin->id > g_log_fmt.num)) {
+        pthread_mutex_unlock(&g_log_fmt.lock);
+        return -1;
+    }
+    site = g_log_fmt.list[bin->id - 1];
+    pthread_mutex_unlock(&g_log_fmt.lock);
+
+    /* > 前缀及位置信息(时间和进程号取自记录) */
+    level = ((site->level < 0) || (site->level >= LOG_LEVEL_TOTAL))? LOG_LEVEL_TOTAL : site->level;
+    sec = (time_t)bin->sec;
+    local_time(&sec, &loctm);
+
+    off = log_fmt_len(snprintf(addr, LOG_PREFIX_MAX_LEN, "@%d|%04d%02d%02d|%02d:%02d:%02d.%03u|%s ",
+            bin->pid, loctm.tm_year + 1900, loctm.tm_mon + 1, loctm.tm_mday,
+            loctm.tm_hour, loctm.tm_min, loctm.tm_sec, bin->nsec / 1000000,
+            g_log_level_tag[level]), LOG_PREFIX_MAX_LEN);
+    off += log_fmt_location(site->fname, site->lineno, site->func, addr + off);
+
+    /* > 按格式串还原内容 */
+    cap = LOG_PREFIX_MAX_LEN + LOG_MSG_MAX_LEN;
+    arg = data + sizeof(log_bin_data_t);
+    p = site->fmt;
+    idx = 0;
+    while (('\0' != *p) && (off < cap - 1)) {
+        if ('%' != *p) {
+            addr[off++] = *p++;
+            continue;
+        }
+        else if ('%' == *(p + 1)) {
+            addr[off++] = '%';
+            p += 2;
+            continue;
+        }
+
+        /* > 标志 */
+        n = 0;
+        spec[n++] = *p++;
+        while ((('-' == *p) || ('+' == *p) || (' ' == *p) || ('#' == *p) || ('0' == *p) || ('\'' == *p))
+            && (n < 8)) {
+            spec[n++] = *p++;
+        }
+
+        /* > 宽度(为'*'时代入参数值, 负数表示左对齐) */
+        width = -1;
+        if ('*' == *p) {
+            if (log_bin_arg(&arg, end, &ival)) { return -1; }
+            ++idx;
+            if (ival < 0) {
+                spec[n++] = '-';
+                ival = -ival;
+            }
+            width = (int)MIN(ival, LOG_MSG_MAX_LEN);
+            ++p;
+        }
+        else if (isdigit(*p)) {
+            for (width=0; isdigit(*p); ++p) {
+                width = MIN(10 * width + (*p - '0'), LOG_MSG_MAX_LEN);
+            }
+        }
+        if (width >= 0) {
+            n += snprintf(spec + n, sizeof(spec) - n, "%d", width);
+        }
+
+        /* > 精度(为'*'时代入参数值, 负数视为未指定) */
+        prec = -1;
+        if ('.' == *p) {
+            ++p;
+            if ('*' == *p) {
+                if (log_bin_arg(&arg, end, &ival)) { return -1; }
+                ++idx;
+                prec = (ival < 0)? -1 : (int)MIN(ival, LOG_MSG_MAX_LEN);
+                ++p;
+            }
+            else {
+                for (prec=0; isdigit(*p); ++p) {
+                    prec = MIN(10 * prec + (*p - '0'), LOG_MSG_MAX_LEN);
+                }
+            }
+        }
+
+        /* > 长度 */
+        while (('h' == *p) || ('l' == *p) || ('z' == *p) || ('j' == *p) || ('t' == *p) || ('q' == *p)) {
+            if (n < (int)sizeof(spec) - 16) {
+                spec[n++] = *p;
+            }
+            ++p;
+        }
+
+        if (idx >= site->argc) {
+            return -1;
+        }
+
+        /* > 转换符: 单独转换一个参数 */
+        switch (site->type[idx++]) {
+            case LOG_ARG_STR:
+            {
+                if (arg + sizeof(uint32_t) > end) { return -1; }
+                memcpy(&slen, arg, sizeof(slen));
+                arg += sizeof(uint32_t);
+                if (arg + slen > end) { return -1; }
+                snprintf(spec + n, sizeof(spec) - n, ".%us", slen); /* 内容已按精度截断 */
+                off += log_fmt_len(snprintf(addr + off, cap - off, spec, arg), cap - off);
+                arg += slen;
+                break;
+            }
+            case LOG_ARG_DOUBLE:
+            {
+                if (log_bin_arg(&arg, end, &dval)) { return -1; }
+                if (prec >= 0) {
+                    n += snprintf(spec + n, sizeof(spec) - n, ".%d", prec);
+                }
+                snprintf(spec + n, sizeof(spec) - n, "%c", *p);
+                off += log_fmt_len(snprintf(addr + off, cap - off, spec, dval), cap - off);
+                break;
+            }
+            case LOG_ARG_PTR:
+            {
+                if (log_bin_arg(&arg, end, &ival)) { return -1; }
+                snprintf(spec + n, sizeof(spec) - n, "p");
+                off += log_fmt_len(snprintf(addr + off, cap - off, spec, (void *)ival), cap - off);
+                break;
+            }
+            case LOG_ARG_LONG:
+            case LOG_ARG_INT:
+            default:
+            {
+                if (log_bin_arg(&arg, end, &ival)) { return -1; }
+                if (prec >= 0) {
+                    n += snprintf(spec + n, sizeof(spec) - n, ".%d", prec);
+                }
+                snprintf(spec + n, sizeof(spec) - n, "%c", *p);
+                if (LOG_ARG_INT == site->type[idx-1]) {
+                    off += log_fmt_len(snprintf(addr + off, cap - off, spec, (int)ival), cap - off);
+                }
+                else {
+                    off += log_fmt_len(snprintf(addr + off, cap - off, spec, (long)ival), cap - off);
+                }
+                break;
+            }
+        }
+        ++p;
+    }
+
+    addr[off++] = '\n';
+
+    return (int)off;
+}
+
+/******************************************************************************
+ **函数名称: log_bcore
+ **功    能: 二进制日志核心调用
+ **输入参数:
+ **     log: 日志对象
+ **     site: 调用点
+ **     fmt: 格式化输出
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述:
+ **     1. 首次调用时注册格式串
+ **     2. 二进制模式下只拷贝原始参数; 否则(或格式不支持时)按文本输出
+ **注意事项: 日志级别的判断在函数外进行判断
+ **作    者: # Qifeng.zou # 2015.09.26 #
+ ******************************************************************************/
+void log_bcore(log_cycle_t *log, log_fmt_t *site, const char *fmt, ...)
+{
+    va_list args;
+
+    if (0 == site->id) {
+        log_fmt_register(site, fmt);
+    }
+
+    va_start(args, fmt);
+    if ((LOG_MODE_BINARY == log->mode) && (site->argc >= 0) && (fmt == site->fmt)) {
+        log_bin_write(log, site, args);
+    }
+    else {
+        log_write(log, site->level, site->fname, site->lineno, site->func, NULL, 0, fmt, args);
+    }
+    va_end(args);
+}
+
+/* 字符串参数的写入长度: 不超过LOG_MSG_MAX_LEN及精度(star为%.*s的精度参数, <0时视为未指定) */
+static size_t log_arg_strlen(const char *str, int prec, int64_t star)
+{
+    if (LOG_ARG_PREC_STAR == prec) {
+        prec = (star < 0)? LOG_ARG_PREC_NONE : (int)MIN(star, LOG_MSG_MAX_LEN);
+    }
+
+    return strnlen(str, (prec < 0)? LOG_MSG_MAX_LEN : prec);
+}
+
+/******************************************************************************
+ **函数名称: log_bin_write
+ **功    能: 将二进制日志写入缓存
+ **输入参数:
+ **     log: 日志对象
+ **     site: 调用点
+ **     args: 可变参数
+ **输出参数: NONE
+ **返    回: 0:成功 !0:失败
+ **实现描述:
+ **     1. 计算参数总长度(字符串最长LOG_MSG_MAX_LEN, 且不超过%.Ns/%.*s的精度)
+ **     2. 在环形缓存中申请空间, 依次写入时间、格式ID和各参数的原始值
+ **注意事项: 不加锁, 不格式化. 缓存已满时与log_write()相同, 有限等待后丢弃
+ **作    者: # Qifeng.zou # 2015.09.26 #
+ ******************************************************************************/
+static int log_bin_write(log_cycle_t *log, log_fmt_t *site, va_list args)
+{
+    int idx;
+    char *addr;
+    uint32_t n;
+    size_t len, need, used;
+    uint64_t pos;
+    int64_t ival;
+    double dval;
+    struct timespec ts;
+    const char *str;
+    va_list copy;
+    log_ring_t *ring;
+    log_bin_data_t *data;
+
+    ring = log_ring_get(log);
+    if (NULL == ring) {
+        return -1;
+    }
+
+    /* > 计算记录长度(ival保存前一个int参数, 即%.*s的精度) */
+    ival = 0;
+    len = sizeof(log_bin_data_t);
+    va_copy(copy, args);
+    for (idx=0; idx<site->argc; ++idx) {
+        switch (site->type[idx]) {
+            case LOG_ARG_INT:
+            {
+                ival = va_arg(copy, int);
+                len += sizeof(uint64_t);
+                break;
+            }
+            case LOG_ARG_LONG:
+            {
+                (void)va_arg(copy, long);
+                len += sizeof(uint64_t);
+                break;
+            }
+            case LOG_ARG_DOUBLE:
+            {
+                (void)va_arg(copy, double);
+                len += sizeof(uint64_t);
+                break;
+            }
+            case LOG_ARG_STR:
+            {
+                str = va_arg(copy, const char *);
+                len += sizeof(uint32_t) + log_arg_strlen((NULL == str)? "(null)" : str, site->prec[idx], ival);
+                break;
+            }
+            case LOG_ARG_PTR:
+            default:
+            {
+                (void)va_arg(copy, void *);
+                len += sizeof(uint64_t);
+                break;
+            }
+        }
+    }
+    va_end(copy);
+
+    need = (LOG_RING_HEAD_LEN + len + 7) & ~7UL;
+
+    /* > 申请空间 */
+    addr = log_ring_wait(log, ring, need, &pos);
+    if (NULL == addr) {
+        return -1;
+    }
+
+    /* > 写入时间和格式ID */
+    clock_gettime(CLOCK_REALTIME, &ts);
+
+    data = (log_bin_data_t *)addr;
+    data->sec = ts.tv_sec;
+    data->nsec = ts.tv_nsec;
+    data->id = site->id;
+    data->pid = log->pid;
+    data->resv = 0;
+    addr += sizeof(log_bin_data_t);
+
+    /* > 写入参数(整数按8字节存储, 字符串存储长度和内容; 之后的参数不对齐) */
+    ival = 0;
+    for (idx=0; idx<site->argc; ++idx) {
+        switch (site->type[idx]) {
+            case LOG_ARG_INT:
+            {
+                ival = va_arg(args, int);
+                memcpy(addr, &ival, sizeof(ival));
+                addr += sizeof(ival);
+                break;
+            }
+            case LOG_ARG_LONG:
+            {
+                ival = va_arg(args, long);
+                memcpy(addr, &ival, sizeof(ival));
+                addr += sizeof(ival);
+                break;
+            }
+            case LOG_ARG_DOUBLE:
+            {
+                dval = va_arg(args, double);
+                memcpy(addr, &dval, sizeof(dval));
+                addr += sizeof(dval);
+                break;
+            }
+            case LOG_ARG_STR:
+            {
+                str = va_arg(args, const char *);
+                if (NULL == str) {
+                    str = "(null)";
+                }
+                n = log_arg_strlen(str, site->prec[idx], ival);
+                memcpy(addr, &n, sizeof(n));
+                memcpy(addr + sizeof(uint32_t), str, n);
+                addr += sizeof(uint32_t) + n;
+                break;
+            }
+            case LOG_ARG_PTR:
+            default:
+            {
+                ival = (int64_t)va_arg(args, void *);
+                memcpy(addr, &ival, sizeof(ival));
+                addr += sizeof(ival);
+                break;
+            }
+        }
+    }
+
+    /* > 提交并判断是否唤醒同步线程 */
+    used = log_ring_commit(ring, pos, LOG_REC_DATA, len);
+    if (used > ring->size / 2) {
+        log_svr_notify(log->owner);
+    }
+
+    return 0;
+}
@@ -9,14 +9,18 @@
 #include "log.h"
 #include "redo.h"
 #include "comm.h"
+#include "futex.h"
+#include "atomic.h"
 
 static log_svr_t *g_log_svr = NULL;
 static pthread_mutex_t g_log_mutex = PTHREAD_MUTEX_INITIALIZER;
 
 static size_t log_sync_to_disk(log_cycle_t *log);
+static int log_flush(log_cycle_t *log);
 static int log_rename(const log_cycle_t *log, const struct timeb *time);
 static void *log_sync_proc(void *_lsvr);
 static int _log_sync_proc(log_cycle_t *log, void *args);
+static void log_svr_exit(void);
 
 /******************************************************************************
  **函数名称: log_svr_cmp_cb
@@ -68,7 +72,8 @@ log_svr_t *log_svr_init(void)
         }
 
         g_log_svr = lsvr;
-        lsvr->timeout = 1;
+        lsvr->timeout = LOG_SYNC_TIMEOUT;
+        pthread_mutex_init(&lsvr->lock, NULL);
 
         lsvr->logs = avl_creat(NULL, (cmp_cb_t)log_svr_cmp_cb);
         if (NULL == lsvr->logs) {
@@ -83,14 +88,63 @@ log_svr_t *log_svr_init(void)
         /* > 执行同步操作 */
         thread_pool_add_worker(lsvr->tp, log_sync_proc, (void *)lsvr);
 
-        pthread_mutex_unlock(&lsvr->lock);
+        /* > 进程退出时同步剩余日志 */
+        atexit(log_svr_exit);
+
+        pthread_mutex_unlock(&g_log_mutex);
         return lsvr;
     } while (0);
 
-    pthread_mutex_unlock(&lsvr->lock);
+    pthread_mutex_unlock(&g_log_mutex);
     return lsvr;
 }
 
+/******************************************************************************
+ **函数名称: log_svr_notify
+ **功    能: 唤醒同步线程
+ **输入参数:
+ **     lsvr: 日志服务
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述: 标志已置位时直接返回, 同步线程被唤醒前只执行一次唤醒操作
+ **注意事项: 调用前写入的日志在同步线程被唤醒后可见
+ **作    者: # Qifeng.zou # 2015.09.22 #
+ ******************************************************************************/
+void log_svr_notify(log_svr_t *lsvr)
+{
+    memory_barrier();
+    if (0 != lsvr->notify) {
+        return;
+    }
+
+    if (atomic32_cmp_and_set(&lsvr->notify, 0, 1)) {
+        futex_wake(&lsvr->notify, 1);
+    }
+}
+
+/******************************************************************************
+ **函数名称: log_svr_exit
+ **功    能: 进程退出时同步所有日志
+ **输入参数: NONE
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述:
+ **注意事项:
+ **作    者: # Qifeng.zou # 2015.09.22 #
+ ******************************************************************************/
+static void log_svr_exit(void)
+{
+    log_svr_t *lsvr = g_log_svr;
+
+    if ((NULL == lsvr) || (NULL == lsvr->logs)) {
+        return;
+    }
+
+    pthread_mutex_lock(&lsvr->lock);
+    avl_trav(lsvr->logs, (trav_cb_t)_log_sync_proc, NULL);
+    pthread_mutex_unlock(&lsvr->lock);
+}
+
 /******************************************************************************
  **函数名称: log_sync_proc
  **功    能: 同步日志
@@ -98,7 +152,8 @@ log_svr_t *log_svr_init(void)
  **     lsvr: 全局对象
  **输出参数: NONE
  **返    回: VOID
- **实现描述:
+ **实现描述: 先清除唤醒标志再收集日志, 收集期间的唤醒不会丢失;
+ **          无唤醒时每timeout秒同步一次.
  **注意事项:
  **作    者: # Qifeng.zou # 2013.10.31 #
  ******************************************************************************/
@@ -107,10 +162,13 @@ static void *log_sync_proc(void *_lsvr)
     log_svr_t *lsvr = (log_svr_t *)_lsvr;
 
     while (1) {
+        atomic32_xset(&lsvr->notify, 0);
+
         pthread_mutex_lock(&lsvr->lock);
         avl_trav(lsvr->logs, (trav_cb_t)_log_sync_proc, NULL);
         pthread_mutex_unlock(&lsvr->lock);
-        Sleep(lsvr->timeout);
+
+        futex_wait(&lsvr->notify, 0, lsvr->timeout * 1000);
     }
     return (void *)NULL;
 }
@@ -136,17 +194,17 @@ static int _log_sync_proc(log_cycle_t *log, void *args)
 }
 
 /******************************************************************************
- **函数名称: log_sync
- **功    能: 强制同步日志信息到日志文件
+ **函数名称: log_flush
+ **功    能: 将日志缓存写入文件, 文件过大时转储
  **输入参数:
  **     log: 日志对象
  **输出参数: NONE
- **返    回: VOID
+ **返    回: 0:成功 !0:失败
  **实现描述:
  **注意事项: 请在函数外部加锁
  **作    者: # Qifeng.zou # 2013.10.30 #
  ******************************************************************************/
-int log_sync(log_cycle_t *log)
+static int log_flush(log_cycle_t *log)
 {
     size_t sz;
 
@@ -162,6 +220,225 @@ int log_sync(log_cycle_t *log)
     return 0;
 }
 
+/******************************************************************************
+ **函数名称: log_append
+ **功    能: 追加数据到日志缓存
+ **输入参数:
+ **     log: 日志对象
+ **     addr: 数据
+ **     len: 数据长度(不大于日志缓存SIZE)
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述: 日志缓存空间不足时先写入文件
+ **注意事项: 请在函数外部加锁
+ **作    者: # Qifeng.zou # 2015.09.26 #
+ ******************************************************************************/
+static void log_append(log_cycle_t *log, const void *addr, size_t len)
+{
+    if (log->inoff + len > log->size) {
+        log_flush(log);
+    }
+
+    memcpy(log->text + log->inoff, addr, len);
+    log->inoff += len;
+}
+
+/******************************************************************************
+ **函数名称: log_fmt_sync
+ **功    能: 写入当前文件中尚未写入的格式定义(二进制模式)
+ **输入参数:
+ **     log: 日志对象
+ **     id: 即将写入的二进制日志的格式ID
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述: 格式ID按注册顺序分配, 依次补齐至id
+ **注意事项: 请在函数外部加锁
+ **作    者: # Qifeng.zou # 2015.09.26 #
+ ******************************************************************************/
+static void log_fmt_sync(log_cycle_t *log, uint32_t id)
+{
+    int len;
+    char def[LOG_MSG_MAX_LEN];
+
+    while (log->fmt_num < id) {
+        len = log_fmt_encode(log->fmt_num + 1, def, sizeof(def));
+        if (len < 0) {
+            return;
+        }
+        /* 缓存满时可能新建文件, 文件头中已包含全部格式, fmt_num随之更新 */
+        log_append(log, def, len);
+        if (log->fmt_num < id) {
+            ++log->fmt_num;
+        }
+    }
+}
+
+/******************************************************************************
+ **函数名称: log_ring_drain
+ **功    能: 收集线程日志缓存中的日志
+ **输入参数:
+ **     log: 日志对象
+ **     ring: 环形缓存
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述:
+ **     依次拷贝各记录到日志缓存, 日志缓存满时先写入文件, 最后释放已读空间.
+ **     二进制模式拷贝记录头和记录内容, 并在二进制日志之前补齐其格式定义;
+ **     文本模式只拷贝日志文本, 二进制日志先还原为文本.
+ **注意事项: 1. 请在函数外部加锁
+ **          2. 写入线程按写入时读到的模式选择记录类型, 切换模式后缓存中仍可能
+ **             有另一种模式的记录, 因此按各记录自身的类型处理, 不丢弃
+ **作    者: # Qifeng.zou # 2015.09.22 #
+ ******************************************************************************/
+static void log_ring_drain(log_cycle_t *log, log_ring_t *ring)
+{
+    int n;
+    size_t off;
+    uint32_t len, type;
+    log_bin_data_t *data;
+    char line[LOG_PREFIX_MAX_LEN + LOG_MSG_MAX_LEN + 1];
+    uint64_t tail = ring->tail, head = ring->head;
+
+    compiler_barrier();
+
+    while (tail < head) {
+        off = tail & (ring->size - 1);
+        len = *(uint32_t *)(ring->data + off);
+        if (LOG_RING_SKIP == len) {
+            tail += ring->size - off;
+            continue;
+        }
+        type = *(uint32_t *)(ring->data + off + sizeof(uint32_t));
+
+        switch (type) {
+            case LOG_REC_TEXT:
+            {
+                if (LOG_MODE_BINARY == log->mode) {
+                    log_append(log, ring->data + off, LOG_RING_HEAD_LEN + len);
+                    break;
+                }
+                log_append(log, ring->data + off + LOG_RING_HEAD_LEN, len);
+                break;
+            }
+            case LOG_REC_DATA:
+            {
+                if (LOG_MODE_BINARY == log->mode) {
+                    data = (log_bin_data_t *)(ring->data + off + LOG_RING_HEAD_LEN);
+                    if (data->id > log->fmt_num) {
+                        log_fmt_sync(log, data->id);
+                    }
+                    log_append(log, ring->data + off, LOG_RING_HEAD_LEN + len);
+                    break;
+                }
+                n = log_bin_decode(ring->data + off + LOG_RING_HEAD_LEN, len, line, sizeof(line));
+                if (n > 0) {
+                    log_append(log, line, n);
+                }
+                break;
+            }
+            default:
+            {
+                break;
+            }
+        }
+
+        tail += LOG_RING_HEAD_LEN + ((len + 7) & ~7UL);
+    }
+
+    compiler_barrier();
+    ring->tail = tail;
+}
+
+/******************************************************************************
+ **函数名称: log_sync
+ **功    能: 强制同步日志信息到日志文件
+ **输入参数:
+ **     log: 日志对象
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述:
+ **     1. 收集各线程日志缓存中的日志: 缓存只在链表头插入, 因此取得链表头后
+ **        无需持有ring.lock即可遍历
+ **     2. 持有ring.lock释放所属线程已退出且已收集完的缓存(不含磁盘IO)
+ **     3. 写入日志文件, 文件过大时转储
+ **注意事项: 请在函数外部加锁(log->lock)
+ **作    者: # Qifeng.zou # 2013.10.30 #
+ ******************************************************************************/
+int log_sync(log_cycle_t *log)
+{
+    int closed;
+    log_ring_t *ring, *next, **prev;
+
+    /* 1. 收集各线程的日志 */
+    pthread_mutex_lock(&log->ring.lock);
+    ring = log->ring.list;
+    pthread_mutex_unlock(&log->ring.lock);
+
+    for (; NULL != ring; ring = ring->next) {
+        log_ring_drain(log, ring);
+    }
+
+    /* 2. 释放已退出线程的缓存 */
+    pthread_mutex_lock(&log->ring.lock);
+    prev = &log->ring.list;
+    for (ring = log->ring.list; NULL != ring; ring = next) {
+        next = ring->next;
+
+        closed = ring->closed; /* 须在比较读写位置前读取: 退出标志之前写入的日志均已提交 */
+        compiler_barrier();
+
+        if (closed && (ring->tail == ring->head)) {
+            *prev = next;
+            free(ring->data);
+            free(ring);
+            continue;
+        }
+        prev = &ring->next;
+    }
+    pthread_mutex_unlock(&log->ring.lock);
+
+    /* 3. 写入日志文件 */
+    return log_flush(log);
+}
+
+/******************************************************************************
+ **函数名称: log_bin_head
+ **功    能: 写入二进制日志文件的文件头和已注册的格式定义
+ **输入参数:
+ **     log: 日志对象
+ **输出参数: NONE
+ **返    回: 写入长度
+ **实现描述: 新文件中写入全部格式定义, 使每个文件均可单独解析
+ **注意事项: 请在函数外部加锁
+ **作    者: # Qifeng.zou # 2015.09.26 #
+ ******************************************************************************/
+static size_t log_bin_head(log_cycle_t *log)
+{
+    int len;
+    uint32_t id, num;
+    size_t sz = 0;
+    log_bin_file_t head;
+    char def[LOG_MSG_MAX_LEN];
+
+    head.magic = LOG_BIN_MAGIC;
+    head.version = LOG_BIN_VERSION;
+    Writen(log->fd, &head, sizeof(head));
+    sz += sizeof(head);
+
+    num = log_fmt_total();
+    for (id=1; id<=num; ++id) {
+        len = log_fmt_encode(id, def, sizeof(def));
+        if (len < 0) {
+            break;
+        }
+        Writen(log->fd, def, len);
+        sz += len;
+    }
+    log->fmt_num = id - 1;
+
+    return sz;
+}
+
 /******************************************************************************
  **函数名称: log_sync_to_disk
  **功    能: 强制日志到磁盘
@@ -221,13 +498,18 @@ static size_t log_sync_to_disk(log_cycle_t *log)
             break;
         }
 
-        /* 6. 写入指定日志文件 */
+        /* 6. 新文件: 二进制模式写入文件头和格式定义 */
+        if ((0 == sz) && (LOG_MODE_BINARY == log->mode)) {
+            sz = log_bin_head(log);
+        }
+
+        /* 7. 写入指定日志文件 */
         Writen(log->fd, addr, n);
 
         sz += n;
     } while(0);
 
-    /* 7. 标志复位 */
+    /* 8. 标志复位 */
     memset(addr, 0, n);
     log->inoff = 0;
     log->outoff = 0;
@@ -283,3 +565,46 @@ int log_insert(log_svr_t *lsvr, log_cycle_t *log)
     pthread_mutex_unlock(&lsvr->lock);
     return 0;
 }
+
+/******************************************************************************
+ **函数名称: log_set_mode
+ **功    能: 设置日志模式
+ **输入参数:
+ **     log: 日志对象
+ **     mode: 日志模式(LOG_MODE_TEXT/LOG_MODE_BINARY)
+ **输出参数: NONE
+ **返    回: 0:成功 !0:失败
+ **实现描述:
+ **     1. 按原模式同步已写入的日志
+ **     2. 日志文件非空时转储, 保证一个文件中只有一种模式
+ **注意事项: 二进制模式的日志文件须使用tools/log_decode.py还原为文本
+ **作    者: # Qifeng.zou # 2015.09.26 #
+ ******************************************************************************/
+int log_set_mode(log_cycle_t *log, int mode)
+{
+    struct stat st;
+
+    if ((LOG_MODE_TEXT != mode) && (LOG_MODE_BINARY != mode)) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&log->lock);
+    if (mode == log->mode) {
+        pthread_mutex_unlock(&log->lock);
+        return 0;
+    }
+
+    log_sync(log);
+
+    if ((0 == lstat(log->path, &st)) && (st.st_size > 0)) {
+        CLOSE(log->fd);
+        ftime(&log->sync_tm);
+        log_rename(log, &log->sync_tm);
+    }
+
+    log->fmt_num = 0;
+    log->mode = mode;
+    pthread_mutex_unlock(&log->lock);
+
+    return 0;
+}
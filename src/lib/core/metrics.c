@@ -0,0 +1,374 @@
+/******************************************************************************
+ ** Copyright(C) 2014-2024 Qiware technology Co., Ltd
+ **
+ ** 文件名: metrics.c
+ ** 版本号: 1.0
+ ** 描  述: 进程内统计模块
+ **         统计项按名称注册到进程内唯一的注册表, 业务线程只更新本线程的分片;
+ **         导出线程定时汇总各分片并写入共享内存, 由外部工具读取.
+ ** 作  者: # Qifeng.zou # 2015.09.29 #
+ ******************************************************************************/
+#include "comm.h"
+#include "redo.h"
+#include "atomic.h"
+#include "metrics.h"
+#include "shm_opt.h"
+#include "thread_pool.h"
+
+/* 注册表 */
+typedef struct
+{
+    pthread_mutex_t lock;                   /* 锁(保护注册及分片链表) */
+    pthread_once_t once;                    /* 线程键只创建一次 */
+    pthread_key_t key;                      /* 线程键(线程退出时回收分片) */
+
+    int num;                                /* 统计项个数 */
+    int hist_num;                           /* 直方图个数 */
+    int slot_num;                           /* 已分配的槽位数 */
+    metrics_t *item[METRICS_MAX_NUM];       /* 统计项 */
+
+    metrics_shard_t *shards;                /* 各线程的分片 */
+    metrics_shard_t *retired;               /* 已退出线程的分片之和 */
+
+    int msec;                               /* 导出间隔(毫秒) */
+    pthread_t tid;                          /* 导出线程 */
+    metrics_shm_t *shm;                     /* 共享内存快照 */
+} metrics_reg_t;
+
+static metrics_reg_t g_metrics = {
+    PTHREAD_MUTEX_INITIALIZER, PTHREAD_ONCE_INIT
+};
+
+__thread metrics_shard_t *g_metrics_shard = NULL;
+
+/* 各类型占用的槽位数 */
+#define metrics_slot_num(type) ((METRICS_HISTOGRAM == (type))? (2 + METRICS_HIST_BUCKET_NUM) : 1)
+
+/******************************************************************************
+ **函数名称: metrics_shard_release
+ **功    能: 线程退出时回收分片
+ **输入参数:
+ **     _shard: 本线程的分片
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述: 将分片累加到retired后从链表中摘除, 保证计数不随线程退出而减少
+ **注意事项:
+ **作    者: # Qifeng.zou # 2015.09.29 #
+ ******************************************************************************/
+static void metrics_shard_release(void *_shard)
+{
+    int idx;
+    metrics_shard_t *shard = (metrics_shard_t *)_shard, **prev;
+
+    pthread_mutex_lock(&g_metrics.lock);
+    for (prev = &g_metrics.shards; NULL != *prev; prev = &(*prev)->next) {
+        if (*prev == shard) {
+            *prev = shard->next;
+            break;
+        }
+    }
+    for (idx=0; idx<g_metrics.slot_num; ++idx) {
+        g_metrics.retired->slot[idx] += shard->slot[idx];
+    }
+    pthread_mutex_unlock(&g_metrics.lock);
+
+    g_metrics_shard = NULL;
+    free(shard);
+}
+
+/* 创建线程键及退出线程的分片 */
+static void metrics_key_creat(void)
+{
+    g_metrics.retired = (metrics_shard_t *)calloc(1, sizeof(metrics_shard_t));
+    if (NULL == g_metrics.retired) {
+        return;
+    }
+
+    if (pthread_key_create(&g_metrics.key, metrics_shard_release)) {
+        FREE(g_metrics.retired);
+    }
+}
+
+/******************************************************************************
+ **函数名称: metrics_shard_creat
+ **功    能: 创建本线程的分片
+ **输入参数: NONE
+ **输出参数: NONE
+ **返    回: 本线程的分片
+ **实现描述: 分片挂入注册表的链表, 线程退出时由线程键的析构函数回收
+ **注意事项: 由metrics_slot()在线程首次更新统计时调用
+ **作    者: # Qifeng.zou # 2015.09.29 #
+ ******************************************************************************/
+metrics_shard_t *metrics_shard_creat(void)
+{
+    metrics_shard_t *shard;
+
+    pthread_once(&g_metrics.once, metrics_key_creat);
+    if (NULL == g_metrics.retired) {
+        return NULL;
+    }
+
+    shard = (metrics_shard_t *)calloc(1, sizeof(metrics_shard_t));
+    if (NULL == shard) {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&g_metrics.lock);
+    shard->next = g_metrics.shards;
+    g_metrics.shards = shard;
+    pthread_mutex_unlock(&g_metrics.lock);
+
+    pthread_setspecific(g_metrics.key, shard);
+    g_metrics_shard = shard;
+
+    return shard;
+}
+
+/******************************************************************************
+ **函数名称: metrics_register
+ **功    能: 注册统计项
+ **输入参数:
+ **     name: 名称
+ **     type: 统计类型
+ **输出参数: NONE
+ **返    回: 统计项
+ **实现描述: 同名同类型时返回已有的统计项; 同名不同类型、超过上限时返回NULL
+ **注意事项: 统计项不会被注销, 可在初始化时注册后长期保存
+ **作    者: # Qifeng.zou # 2015.09.29 #
+ ******************************************************************************/
+static metrics_t *metrics_register(const char *name, int type)
+{
+    int idx, num;
+    metrics_t *m;
+
+    if ((NULL == name) || ('\0' == name[0])
+        || (strlen(name) >= METRICS_NAME_MAX_LEN))
+    {
+        return NULL;
+    }
+
+    pthread_mutex_lock(&g_metrics.lock);
+
+    for (idx=0; idx<g_metrics.num; ++idx) {
+        m = g_metrics.item[idx];
+        if (0 == strcmp(m->name, name)) {
+            pthread_mutex_unlock(&g_metrics.lock);
+            return (type == m->type)? m : NULL;
+        }
+    }
+
+    num = metrics_slot_num(type);
+    if ((g_metrics.num >= METRICS_MAX_NUM)
+        || (g_metrics.slot_num + num > METRICS_SLOT_MAX_NUM)
+        || ((METRICS_HISTOGRAM == type) && (g_metrics.hist_num >= METRICS_HIST_MAX_NUM)))
+    {
+        pthread_mutex_unlock(&g_metrics.lock);
+        return NULL;
+    }
+
+    m = (metrics_t *)calloc(1, sizeof(metrics_t));
+    if (NULL == m) {
+        pthread_mutex_unlock(&g_metrics.lock);
+        return NULL;
+    }
+
+    m->idx = g_metrics.num;
+    m->type = type;
+    m->off = g_metrics.slot_num;
+    m->hist = (METRICS_HISTOGRAM == type)? g_metrics.hist_num++ : -1;
+    snprintf(m->name, sizeof(m->name), "%s", name);
+
+    g_metrics.slot_num += num;
+    g_metrics.item[g_metrics.num++] = m;
+
+    pthread_mutex_unlock(&g_metrics.lock);
+
+    return m;
+}
+
+/* 注册计数器 */
+metrics_t *metrics_counter(const char *name)
+{
+    return metrics_register(name, METRICS_COUNTER);
+}
+
+/* 注册仪表 */
+metrics_t *metrics_gauge(const char *name)
+{
+    return metrics_register(name, METRICS_GAUGE);
+}
+
+/* 注册直方图 */
+metrics_t *metrics_histogram(const char *name)
+{
+    return metrics_register(name, METRICS_HISTOGRAM);
+}
+
+/* 汇总某槽位(须持有注册表的锁) */
+static uint64_t metrics_sum(int off)
+{
+    uint64_t sum;
+    metrics_shard_t *shard;
+
+    sum = (NULL == g_metrics.retired)? 0 : g_metrics.retired->slot[off];
+    for (shard = g_metrics.shards; NULL != shard; shard = shard->next) {
+        sum += shard->slot[off];
+    }
+
+    return sum;
+}
+
+/******************************************************************************
+ **函数名称: metrics_value
+ **功    能: 获取统计项的当前值
+ **输入参数:
+ **     m: 统计项
+ **输出参数: NONE
+ **返    回: 计数器/仪表的值; 直方图的次数
+ **实现描述: 汇总各线程的分片
+ **注意事项: 需要加锁, 不要在热点路径上调用
+ **作    者: # Qifeng.zou # 2015.09.29 #
+ ******************************************************************************/
+int64_t metrics_value(const metrics_t *m)
+{
+    int64_t val;
+
+    if (NULL == m) {
+        return 0;
+    }
+
+    pthread_mutex_lock(&g_metrics.lock);
+    val = (int64_t)metrics_sum(m->off);
+    pthread_mutex_unlock(&g_metrics.lock);
+
+    return (METRICS_GAUGE == m->type)? (m->base + val) : val;
+}
+
+/******************************************************************************
+ **函数名称: metrics_export
+ **功    能: 将当前统计写入共享内存快照
+ **输入参数: NONE
+ **输出参数: NONE
+ **返    回: 0:成功 !0:失败
+ **实现描述:
+ **     写入前后各递增一次seq: 读者看到seq为奇数, 或读取前后seq不一致时重读.
+ **注意事项: 由导出线程定时调用, 也可在退出前手动调用一次
+ **作    者: # Qifeng.zou # 2015.09.29 #
+ ******************************************************************************/
+int metrics_export(void)
+{
+    int idx, bkt;
+    metrics_t *m;
+    struct timeval tv;
+    metrics_shm_t *shm = g_metrics.shm;
+    metrics_shm_item_t *item;
+
+    if (NULL == shm) {
+        return -1;
+    }
+
+    gettimeofday(&tv, NULL);
+
+    pthread_mutex_lock(&g_metrics.lock);
+
+    ++shm->seq;
+    memory_barrier();
+
+    shm->time = tv.tv_sec * 1000UL + tv.tv_usec / 1000;
+    shm->pid = getpid();
+    shm->num = g_metrics.num;
+    for (idx=0; idx<g_metrics.num; ++idx) {
+        m = g_metrics.item[idx];
+        item = &shm->item[idx];
+
+        snprintf(item->name, sizeof(item->name), "%s", m->name);
+        item->type = m->type;
+        item->hist = m->hist;
+        item->value = (int64_t)metrics_sum(m->off);
+        item->sum = 0;
+        switch (m->type) {
+            case METRICS_GAUGE:
+            {
+                item->value += m->base;
+                break;
+            }
+            case METRICS_HISTOGRAM:
+            {
+                item->sum = metrics_sum(m->off + 1);
+                for (bkt=0; bkt<METRICS_HIST_BUCKET_NUM; ++bkt) {
+                    shm->bucket[m->hist][bkt] = metrics_sum(m->off + 2 + bkt);
+                }
+                break;
+            }
+            default:
+            {
+                break;
+            }
+        }
+    }
+
+    memory_barrier();
+    ++shm->seq;
+
+    pthread_mutex_unlock(&g_metrics.lock);
+
+    return 0;
+}
+
+/* 导出线程 */
+static void *metrics_export_routine(void *args)
+{
+    for (;;) {
+        metrics_export();
+        usleep(g_metrics.msec * 1000);
+    }
+
+    return NULL;
+}
+
+/******************************************************************************
+ **函数名称: metrics_init
+ **功    能: 启动统计导出
+ **输入参数:
+ **     path: 共享内存路径(保存共享内存ID的文件, 供metrics_top.py读取)
+ **     msec: 导出间隔(毫秒) (注: <=0时使用METRICS_EXPORT_MSEC)
+ **输出参数: NONE
+ **返    回: 0:成功 !0:失败
+ **实现描述: 创建共享内存并启动导出线程
+ **注意事项:
+ **     1. 不调用本函数时统计照常进行, 只是不导出(可用metrics_value()查询);
+ **     2. 每个进程只需调用一次, 重复调用直接返回成功.
+ **作    者: # Qifeng.zou # 2015.09.29 #
+ ******************************************************************************/
+int metrics_init(const char *path, int msec)
+{
+    metrics_shm_t *shm;
+
+    pthread_mutex_lock(&g_metrics.lock);
+    if (NULL != g_metrics.shm) {
+        pthread_mutex_unlock(&g_metrics.lock);
+        return 0;
+    }
+
+    shm = (metrics_shm_t *)shm_creat(path, sizeof(metrics_shm_t));
+    if (NULL == shm) {
+        pthread_mutex_unlock(&g_metrics.lock);
+        return -1;
+    }
+
+    memset(shm, 0, sizeof(metrics_shm_t));
+    shm->magic = METRICS_MAGIC;
+    shm->version = METRICS_VERSION;
+    shm->hist_sub_bits = METRICS_HIST_SUB_BITS;
+    shm->hist_bucket_num = METRICS_HIST_BUCKET_NUM;
+
+    g_metrics.shm = shm;
+    g_metrics.msec = (msec > 0)? msec : METRICS_EXPORT_MSEC;
+    pthread_mutex_unlock(&g_metrics.lock);
+
+    if (thread_creat(&g_metrics.tid, metrics_export_routine, NULL)) {
+        return -1;
+    }
+
+    return 0;
+}
@@ -9,7 +9,7 @@
 #include "comm.h"
 #include "mref.h"
 #include "atomic.h"
-#include "hash_tab.h"
+#include "hash_map.h"
 
 #define MREF_SLOT_LEN    (999)
 
@@ -26,7 +26,7 @@ typedef struct
 } mref_item_t;
 
 /* 内存应用管理表 */
-hash_tab_t *gMemRefTab;
+hash_map_t *gMemRefTab;
 
 #define GetMemRef() (gMemRefTab)
 #define SetMemRef(tab) (gMemRefTab = (tab))
@@ -57,9 +57,9 @@ static int64_t mref_cmp_cb(const mref_item_t *item1, const mref_item_t *item2)
  ******************************************************************************/
 int mref_init(void)
 {
-    hash_tab_t *tab;
+    hash_map_t *tab;
 
-    tab = hash_tab_creat(MREF_SLOT_LEN,
+    tab = hash_map_creat(MREF_SLOT_LEN,
             (hash_cb_t)mref_hash_cb,
             (cmp_cb_t)mref_cmp_cb, NULL);
 
@@ -117,16 +117,16 @@ static int mref_add(void *addr, void *pool, mem_dealloc_cb_t dealloc)
 {
     int cnt;
     mref_item_t *item, key;
-    hash_tab_t *tab = GetMemRef();
+    hash_map_t *tab = GetMemRef();
 
 AGAIN:
     /* > 查询引用 */
     key.addr = addr;
 
-    item = hash_tab_query(tab, (void *)&key, RDLOCK);
+    item = hash_map_query(tab, (void *)&key, RDLOCK);
     if (NULL != item) {
         cnt = (int)atomic32_inc(&item->count);
-        hash_tab_unlock(tab, &key, RDLOCK);
+        hash_map_unlock(tab, &key, RDLOCK);
         return cnt;
     }
 
@@ -142,7 +142,7 @@ AGAIN:
     item->pool = pool;
     item->dealloc = dealloc;
 
-    if (hash_tab_insert(tab, item, WRLOCK)) {
+    if (hash_map_insert(tab, item, WRLOCK)) {
         free(item);
         goto AGAIN;
     }
@@ -182,14 +182,14 @@ int mref_inc(void *addr)
 {
     int cnt;
     mref_item_t *item, key;
-    hash_tab_t *tab = GetMemRef();
+    hash_map_t *tab = GetMemRef();
 
     key.addr = addr;
 
-    item = hash_tab_query(tab, (void *)&key, RDLOCK);
+    item = hash_map_query(tab, (void *)&key, RDLOCK);
     if (NULL != item) {
         cnt = (int)atomic32_inc(&item->count);
-        hash_tab_unlock(tab, &key, RDLOCK);
+        hash_map_unlock(tab, &key, RDLOCK);
         return cnt;
     }
 
@@ -214,12 +214,12 @@ int mref_dec(void *addr)
 {
     int cnt;
     mref_item_t *item, key;
-    hash_tab_t *tab = GetMemRef();
+    hash_map_t *tab = GetMemRef();
 
     /* > 修改统计计数 */
     key.addr = addr;
 
-    item = hash_tab_query(tab, (void *)&key, RDLOCK);
+    item = hash_map_query(tab, (void *)&key, RDLOCK);
     if (NULL == item) {
         assert(0);
         return 0; // Didn't find
@@ -227,22 +227,22 @@ int mref_dec(void *addr)
 
     cnt = (int)atomic32_dec(&item->count);
 
-    hash_tab_unlock(tab, &key, RDLOCK);
+    hash_map_unlock(tab, &key, RDLOCK);
 
     /* > 是否释放内存 */
     if (0 == cnt) {
-        item = hash_tab_query(tab, (void *)&key, WRLOCK);
+        item = hash_map_query(tab, (void *)&key, WRLOCK);
         if (NULL == item) {
             return 0; // 已被释放
         } else if (0 == item->count) {
-            hash_tab_delete(tab, (void *)&key, NONLOCK);
-            hash_tab_unlock(tab, &key, WRLOCK);
+            hash_map_delete(tab, (void *)&key, NONLOCK);
+            hash_map_unlock(tab, &key, WRLOCK);
 
             item->dealloc(item->pool, item->addr); // 释放被管理的内存
             free(item);
             return 0;
         }
-        hash_tab_unlock(tab, &key, WRLOCK);
+        hash_map_unlock(tab, &key, WRLOCK);
         return 0;
     }
     return cnt;
@@ -263,15 +263,15 @@ int mref_check(void *addr)
 {
     int cnt;
     mref_item_t *item, key;
-    hash_tab_t *tab = GetMemRef();
+    hash_map_t *tab = GetMemRef();
 
     /* > 查询引用 */
     key.addr = addr;
 
-    item = (mref_item_t *)hash_tab_query(tab, (void *)&key, RDLOCK);
+    item = (mref_item_t *)hash_map_query(tab, (void *)&key, RDLOCK);
     if (NULL != item) {
         cnt = item->count;
-        hash_tab_unlock(tab, &key, RDLOCK);
+        hash_map_unlock(tab, &key, RDLOCK);
         return cnt;
     }
 
@@ -6,6 +6,7 @@
  ** 描  述: 队列模块
  **     1. 先进先出的一种数据结构
  **     2. 循环无锁队列
+ **     3. 单元内存可以是固定大小(queue_creat), 也可以按2的次方分级(queue_creat_ex)
  ** 作  者: # Qifeng.zou # 2014.04.28 #
  ******************************************************************************/
 
@@ -49,6 +50,7 @@ queue_t *queue_creat(int max, int size)
     queue->slot = slot_creat(max, size);
     if (NULL == queue->slot) {
         ring_destroy(queue->ring);
+        free(queue->ring);
         FREE(queue);
         return NULL;
     }
@@ -56,6 +58,207 @@ queue_t *queue_creat(int max, int size)
     return queue;
 }
 
+/******************************************************************************
+ **函数名称: queue_creat_ex
+ **功    能: 创建分级队列
+ **输入参数:
+ **     max: 队列长度(必须为2的次方)
+ **     min: 最小分级的单元大小(0:不分级, 等同于queue_creat(max, size))
+ **     size: 最大分级的单元大小
+ **输出参数: NONE
+ **返    回: 队列对象
+ **实现描述:
+ **     1. 分级大小为min, 2*min, 4*min ... 直至不小于size(均取2的次方);
+ **     2. 各分级的单元按需以QUEUE_CHUNK_NUM个为一批扩充, 每级最多max个,
+ **        内存占用随实际的消息大小分布而定;
+ **     3. 超过最大分级的申请直接从堆中申请, 不再失败.
+ **注意事项: 每个单元之前有QUEUE_HEAD_SIZE字节的头部, 记录其所属分级
+ **作    者: # Qifeng.zou # 2015.08.14 #
+ ******************************************************************************/
+queue_t *queue_creat_ex(int max, int min, int size)
+{
+    int idx, num, sz;
+    queue_t *queue;
+    queue_pool_t *pool;
+
+    if ((min <= 0) || (min >= size)) {
+        return queue_creat(max, size);
+    }
+    else if (0 == max) {
+        return NULL;
+    }
+
+    /* > 计算分级数 */
+    min = power2(min);
+    for (num=1, sz=min; (sz < size) && (num < QUEUE_POOL_MAX); ++num, sz <<= 1) { NULL; }
+
+    /* > 新建对象 */
+    queue = (queue_t *)calloc(1, sizeof(queue_t));
+    if (NULL == queue) {
+        return NULL;
+    }
+
+    queue->pool = (queue_pool_t *)calloc(num, sizeof(queue_pool_t));
+    if (NULL == queue->pool) {
+        FREE(queue);
+        return NULL;
+    }
+
+    queue->pool_num = num;
+
+    /* > 创建队列 */
+    queue->ring = ring_creat(max);
+    if (NULL == queue->ring) {
+        queue_destroy(queue);
+        return NULL;
+    }
+
+    /* > 创建各分级的空闲队列(单元按需申请) */
+    for (idx=0; idx<num; ++idx) {
+        pool = &queue->pool[idx];
+
+        pool->size = min << idx;
+        pool->limit = max;
+        spin_lock_init(&pool->lock);
+
+        pool->free = ring_creat(max);
+        if (NULL == pool->free) {
+            queue_destroy(queue);
+            return NULL;
+        }
+    }
+
+    return queue;
+}
+
+/******************************************************************************
+ **函数名称: queue_pool_grow
+ **功    能: 扩充分级内存池
+ **输入参数:
+ **     pool: 分级内存池
+ **输出参数: NONE
+ **返    回: 新单元(含头部)
+ **实现描述: 申请一块可容纳QUEUE_CHUNK_NUM个单元的内存, 返回第一个, 其余放入
+ **          空闲队列
+ **注意事项: 单元数已达上限时返回NULL
+ **作    者: # Qifeng.zou # 2015.08.14 #
+ ******************************************************************************/
+static void *queue_pool_grow(queue_pool_t *pool)
+{
+    void *chunk, *cell;
+    int idx, num, cell_size;
+
+    spin_lock(&pool->lock);
+
+    /* > 其他线程已经扩充 */
+    cell = ring_pop(pool->free);
+    if (NULL != cell) {
+        spin_unlock(&pool->lock);
+        return cell;
+    }
+
+    num = MIN(QUEUE_CHUNK_NUM, pool->limit - pool->num);
+    if (num <= 0) {
+        spin_unlock(&pool->lock);
+        return NULL;
+    }
+
+    cell_size = QUEUE_HEAD_SIZE + pool->size;
+
+    chunk = (void *)memalign_alloc(QUEUE_HEAD_SIZE, QUEUE_HEAD_SIZE + num * cell_size);
+    if (NULL == chunk) {
+        spin_unlock(&pool->lock);
+        return NULL;
+    }
+
+    *(void **)chunk = pool->chunk;
+    pool->chunk = chunk;
+
+    cell = chunk + QUEUE_HEAD_SIZE;
+    for (idx=1; idx<num; ++idx) {
+        ring_push(pool->free, cell + idx * cell_size);
+    }
+    pool->num += num;
+
+    spin_unlock(&pool->lock);
+
+    return cell;
+}
+
+/******************************************************************************
+ **函数名称: queue_pool_alloc
+ **功    能: 从分级内存池申请单元
+ **输入参数:
+ **     queue: 分级队列
+ **     size: 申请空间大小
+ **输出参数: NONE
+ **返    回: 内存地址
+ **实现描述:
+ **     1. 从能容纳size的最小分级中申请, 该级已满时尝试更大的分级;
+ **     2. 超过最大分级(或各级均已满)时直接从堆中申请.
+ **注意事项: 由queue_malloc()调用
+ **作    者: # Qifeng.zou # 2015.08.14 #
+ ******************************************************************************/
+void *queue_pool_alloc(queue_t *queue, int size)
+{
+    int idx;
+    void *cell;
+    queue_pool_t *pool;
+
+    for (idx=0; idx<queue->pool_num; ++idx) {
+        pool = &queue->pool[idx];
+        if (size > pool->size) {
+            continue;
+        }
+
+        cell = ring_pop(pool->free);
+        if (NULL == cell) {
+            cell = queue_pool_grow(pool);
+            if (NULL == cell) {
+                continue;
+            }
+        }
+
+        *(int *)cell = idx;
+        return cell + QUEUE_HEAD_SIZE;
+    }
+
+    /* > 大对象 */
+    cell = (void *)memalign_alloc(QUEUE_HEAD_SIZE, QUEUE_HEAD_SIZE + size);
+    if (NULL == cell) {
+        return NULL;
+    }
+
+    *(int *)cell = QUEUE_POOL_LARGE;
+
+    return cell + QUEUE_HEAD_SIZE;
+}
+
+/******************************************************************************
+ **函数名称: queue_pool_dealloc
+ **功    能: 回收分级内存池的单元
+ **输入参数:
+ **     queue: 分级队列
+ **     p: 内存地址
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述: 根据头部记录的分级放回对应的空闲队列, 大对象直接释放
+ **注意事项: 由queue_dealloc()调用
+ **作    者: # Qifeng.zou # 2015.08.14 #
+ ******************************************************************************/
+void queue_pool_dealloc(queue_t *queue, void *p)
+{
+    void *cell = p - QUEUE_HEAD_SIZE;
+    int idx = *(int *)cell;
+
+    if (QUEUE_POOL_LARGE == idx) {
+        free(cell);
+        return;
+    }
+
+    ring_push(queue->pool[idx].free, cell);
+}
+
 /******************************************************************************
  **函数名称: queue_destroy
  **功    能: 销毁加锁队列
@@ -69,7 +272,32 @@ queue_t *queue_creat(int max, int size)
  ******************************************************************************/
 void queue_destroy(queue_t *queue)
 {
-    ring_destroy(queue->ring);
-    slot_destroy(queue->slot);
+    int idx;
+    void *chunk;
+    queue_pool_t *pool;
+
+    if (NULL != queue->ring) {
+        ring_destroy(queue->ring);
+        free(queue->ring);
+    }
+
+    if (NULL != queue->slot) {
+        slot_destroy(queue->slot);
+    }
+
+    for (idx=0; idx<queue->pool_num; ++idx) {
+        pool = &queue->pool[idx];
+        if (NULL != pool->free) {
+            ring_destroy(pool->free);
+            free(pool->free);
+        }
+        while (NULL != pool->chunk) {
+            chunk = pool->chunk;
+            pool->chunk = *(void **)chunk;
+            free(chunk);
+        }
+    }
+
+    FREE(queue->pool);
     free(queue);
 }
@@ -13,18 +13,22 @@
 #include "atomic.h"
 
 /******************************************************************************
- **函数名称: ring_creat
+ **函数名称: ring_creat_ex
  **功    能: 环形队列初始化
  **输入参数:
  **     max: 队列容量
+ **     flag: 队列标志(RING_FLAG_MPMC/SP/SC/SPSC)
  **输出参数:
- **返    回: 0:成功 !0:失败
+ **返    回: 环形队列
  **实现描述:
- **注意事项: max必须为2^n值. 如果max不是2^n值, 则取比起max大的2^n作为值.
- **作    者: # Qifeng.zou # 2014.05.04 #
+ **注意事项:
+ **     1. max必须为2^n值. 如果max不是2^n值, 则取比起max大的2^n作为值.
+ **     2. 设置RING_FLAG_SP/SC时, 调用者必须保证只有一个生产者/消费者.
+ **作    者: # Qifeng.zou # 2015.06.15 #
  ******************************************************************************/
-ring_t *ring_creat(int max)
+ring_t *ring_creat_ex(int max, int flag)
 {
+    int idx;
     ring_t *rq;
 
     max = power2(max); /* > max必须为2的n次方 */
@@ -35,22 +39,179 @@ ring_t *ring_creat(int max)
         return NULL;
     }
 
-    rq->data = (void **)calloc(max, sizeof(void *));
-    if (NULL == rq->data) {
+    rq->cell = (ring_cell_t *)calloc(max, sizeof(ring_cell_t));
+    if (NULL == rq->cell) {
         free(rq);
         return NULL;
     }
 
+    for (idx=0; idx<max; ++idx) {
+        rq->cell[idx].seq = idx;
+    }
+
     /* > 设置相关标志 */
     rq->max = max;
-    rq->num = 0;
     rq->mask = max - 1;
-    rq->prod.head = rq->prod.tail = 0;
-    rq->cons.head = rq->cons.tail = 0;
+    rq->flag = flag;
+    rq->prod.head = 0;
+    rq->cons.head = 0;
 
     return rq;
 }
 
+/******************************************************************************
+ **函数名称: ring_creat
+ **功    能: 环形队列初始化(多生产者/多消费者)
+ **输入参数:
+ **     max: 队列容量
+ **输出参数:
+ **返    回: 环形队列
+ **实现描述:
+ **注意事项: max必须为2^n值. 如果max不是2^n值, 则取比起max大的2^n作为值.
+ **作    者: # Qifeng.zou # 2014.05.04 #
+ ******************************************************************************/
+ring_t *ring_creat(int max)
+{
+    return ring_creat_ex(max, RING_FLAG_MPMC);
+}
+
+/******************************************************************************
+ **函数名称: _ring_mpush
+ **功    能: 插入多个数据
+ **输入参数:
+ **     rq: 环形队列
+ **     addr: 数据地址数组
+ **     num: 数组长度
+ **     burst: 空间不足时是否尽量插入(true:插入剩余空间可容纳的个数 false:不插入)
+ **输出参数:
+ **返    回: 实际插入个数
+ **实现描述:
+ **     1. 从生产者头开始, 统计连续空闲的单元个数(seq == pos)
+ **     2. 多生产者通过CAS推进生产者头, 单生产者直接推进
+ **     3. 依次写入数据, 并置seq = pos + 1表示单元可读
+ **注意事项: 生产者在写入过程中被抢占时, 只会影响其所占单元的读取, 不会阻塞
+ **          其他生产者和消费者.
+ **作    者: # Qifeng.zou # 2015.06.16 #
+ ******************************************************************************/
+static int _ring_mpush(ring_t *rq, void **addr, unsigned int num, bool burst)
+{
+    int diff = 0;
+    ring_cell_t *cell;
+    unsigned int pos, n, i;
+
+    pos = rq->prod.head;
+
+    /* > 申请队列空间 */
+    while (1) {
+        for (n=0; n<num; ++n) {
+            cell = &rq->cell[(pos+n) & rq->mask];
+            diff = (int)(cell->seq - (pos+n));
+            if (0 != diff) {
+                break;
+            }
+        }
+
+        if (n < num) {
+            if (diff > 0) {
+                pos = rq->prod.head; /* 已被其他生产者申请 */
+                continue;
+            }
+            else if (!burst || 0 == n) {
+                return 0; /* 空间不足 */
+            }
+        }
+
+        if (rq->flag & RING_FLAG_SP) {
+            rq->prod.head = pos + n;
+            break;
+        }
+        else if (atomic32_cmp_and_set(&rq->prod.head, pos, pos+n)) {
+            break;
+        }
+
+        pos = rq->prod.head;
+    }
+
+    /* > 放入队列空间 */
+    for (i=0; i<n; ++i) {
+        cell = &rq->cell[(pos+i) & rq->mask];
+        cell->data = addr[i];
+        compiler_barrier(); /* 数据写入必须先于序列号的更新 */
+        cell->seq = pos + i + 1;
+    }
+
+    return n;
+}
+
+/******************************************************************************
+ **函数名称: _ring_mpop
+ **功    能: 弹出多个数据
+ **输入参数:
+ **     rq: 环形队列
+ **     num: 最多弹出的个数
+ **     burst: 数据不足时是否尽量弹出(true:弹出现有的数据 false:不弹出)
+ **输出参数:
+ **     addr: 指针数组
+ **返    回: 实际弹出个数
+ **实现描述:
+ **     1. 从消费者头开始, 统计连续可读的单元个数(seq == pos + 1)
+ **     2. 多消费者通过CAS推进消费者头, 单消费者直接推进
+ **     3. 依次读取数据, 并置seq = pos + max表示单元可供下一轮写入
+ **注意事项: 已申请但尚未写完的单元视为无数据, 消费者不会等待
+ **作    者: # Qifeng.zou # 2015.06.16 #
+ ******************************************************************************/
+static int _ring_mpop(ring_t *rq, void **addr, unsigned int num, bool burst)
+{
+    int diff = 0;
+    ring_cell_t *cell;
+    unsigned int pos, n, i;
+
+    pos = rq->cons.head;
+
+    /* > 申请队列数据 */
+    while (1) {
+        for (n=0; n<num; ++n) {
+            cell = &rq->cell[(pos+n) & rq->mask];
+            diff = (int)(cell->seq - (pos+n+1));
+            if (0 != diff) {
+                break;
+            }
+        }
+
+        if (n < num) {
+            if (diff > 0) {
+                pos = rq->cons.head; /* 已被其他消费者申请 */
+                continue;
+            }
+            else if (!burst || 0 == n) {
+                return 0; /* 无数据 */
+            }
+        }
+
+        if (rq->flag & RING_FLAG_SC) {
+            rq->cons.head = pos + n;
+            break;
+        }
+        else if (atomic32_cmp_and_set(&rq->cons.head, pos, pos+n)) {
+            break;
+        }
+
+        pos = rq->cons.head;
+    }
+
+    compiler_barrier(); /* 序列号检查必须先于数据读取 */
+
+    /* > 地址弹出队列 */
+    for (i=0; i<n; ++i) {
+        cell = &rq->cell[(pos+i) & rq->mask];
+        addr[i] = cell->data;
+        compiler_barrier(); /* 数据读取必须先于序列号的更新 */
+        cell->seq = pos + i + rq->max;
+    }
+
+    return n;
+}
+
 /******************************************************************************
  **函数名称: ring_push
  **功    能: 入队列
@@ -65,7 +226,7 @@ ring_t *ring_creat(int max)
  ******************************************************************************/
 int ring_push(ring_t *rq, void *addr)
 {
-    return ring_mpush(rq, &addr, 1);
+    return (1 == _ring_mpush(rq, &addr, 1, false))? 0 : -1;
 }
 
 /******************************************************************************
@@ -83,7 +244,7 @@ void *ring_pop(ring_t *rq)
 {
     void *addr[1];
 
-    if (0 == ring_mpop(rq, addr, 1)) {
+    if (0 == _ring_mpop(rq, addr, 1, false)) {
         return NULL;
     }
 
@@ -99,38 +260,31 @@ void *ring_pop(ring_t *rq)
  **     num: 数组长度
  **输出参数:
  **返    回: 0:成功 !0:失败
- **实现描述:
+ **实现描述: 剩余空间不足num个时, 不插入任何数据
  **注意事项: addr指向的地址必须为堆地址
  **作    者: # Qifeng.zou # 2015.05.05 #
  ******************************************************************************/
 int ring_mpush(ring_t *rq, void **addr, unsigned int num)
 {
-    int succ;
-    unsigned int prod_head, prod_next, cons_tail, i;
-
-    /* > 申请队列空间 */
-    do {
-        prod_head = rq->prod.head;
-        cons_tail = rq->cons.tail;
-        if (num > (rq->max + cons_tail - prod_head)) {
-            return -1; /* 空间不足 */
-        }
-
-        prod_next = prod_head + num;
-
-        succ = atomic32_cmp_and_set(&rq->prod.head, prod_head, prod_next);
-    } while (0 == succ);
-
-    /* > 放入队列空间 */
-    for (i=0; i<num; ++i) {
-        rq->data[(prod_head+i) & rq->mask] = addr[i];
-    }
-    while (rq->prod.tail != prod_head) { NULL; }
-    rq->prod.tail = prod_next;
-
-    atomic32_add(&rq->num, num); /* 计数 */
+    return ((unsigned int)_ring_mpush(rq, addr, num, false) == num)? 0 : -1;
+}
 
-    return 0;
+/******************************************************************************
+ **函数名称: ring_push_burst
+ **功    能: 尽量插入多个数据
+ **输入参数:
+ **     rq: 环形队列
+ **     addr: 数据地址数组
+ **     num: 数组长度
+ **输出参数:
+ **返    回: 实际插入个数(插入addr[0] ~ addr[n-1])
+ **实现描述: 剩余空间不足num个时, 插入剩余空间可容纳的个数
+ **注意事项: 未插入的数据仍由调用者负责处理
+ **作    者: # Qifeng.zou # 2015.06.15 #
+ ******************************************************************************/
+int ring_push_burst(ring_t *rq, void **addr, unsigned int num)
+{
+    return _ring_mpush(rq, addr, num, true);
 }
 
 /******************************************************************************
@@ -143,41 +297,30 @@ int ring_mpush(ring_t *rq, void **addr, unsigned int num)
  **     addr: 指针数组
  **返    回: 数据实际条数
  **实现描述: 无锁编程
- **注意事项:
+ **注意事项: 队列中数据不足num个时, 不弹出任何数据
  **作    者: # Qifeng.zou # 2015.05.05 #
  ******************************************************************************/
 int ring_mpop(ring_t *rq, void **addr, unsigned int num)
 {
-    int succ;
-    unsigned int cons_head, cons_next, prod_tail, i;
-
-    /* > 申请队列空间 */
-    do {
-        cons_head = rq->cons.head;
-        prod_tail = rq->prod.tail;
-
-        if (num > prod_tail - cons_head) {
-            return 0; /* 无数据 */
-        }
-
-        cons_next = cons_head + num;
-
-        succ = atomic32_cmp_and_set(&rq->cons.head, cons_head, cons_next);
-    } while(0 == succ);
-
-    /* > 地址弹出队列 */
-    for (i=0; i<num; ++i) {
-        addr[i] = (void *)rq->data[(cons_head+i) & rq->mask];
-    }
-
-    /* > 判断是否其他线程也在进行处理, 是的话, 则等待对方完成处理 */
-    while (rq->cons.tail != cons_head) { NULL; }
-
-    rq->cons.tail = cons_next;
-
-    atomic32_sub(&rq->num, num); /* 计数 */
+    return _ring_mpop(rq, addr, num, false);
+}
 
-    return num;
+/******************************************************************************
+ **函数名称: ring_pop_burst
+ **功    能: 尽量弹出多个数据
+ **输入参数:
+ **     rq: 队列
+ **     num: 最多弹出的个数
+ **输出参数:
+ **     addr: 指针数组
+ **返    回: 实际弹出个数(0:队列为空)
+ **实现描述: 队列中数据不足num个时, 弹出现有的全部数据
+ **注意事项: 调用者无需事先通过ring_used()计算弹出个数
+ **作    者: # Qifeng.zou # 2015.06.15 #
+ ******************************************************************************/
+int ring_pop_burst(ring_t *rq, void **addr, unsigned int num)
+{
+    return _ring_mpop(rq, addr, num, true);
 }
 
 /******************************************************************************
@@ -193,9 +336,8 @@ int ring_mpop(ring_t *rq, void **addr, unsigned int num)
  ******************************************************************************/
 void ring_destroy(ring_t *rq)
 {
-    free(rq->data);
+    free(rq->cell);
     rq->max = 0;
-    rq->num = 0;
 }
 
 /******************************************************************************
@@ -211,9 +353,9 @@ void ring_destroy(ring_t *rq)
  ******************************************************************************/
 void ring_print(ring_t *rq)
 {
-    unsigned int i;
+    unsigned int i, num = ring_used(rq);
 
-    for (i=0; i<rq->num; ++i) {
-        fprintf(stderr, "ptr[%d]: %p", rq->prod.head+i, rq->data[(rq->prod.head+i)&rq->mask]);
+    for (i=0; i<num; ++i) {
+        fprintf(stderr, "ptr[%d]: %p", rq->cons.head+i, rq->cell[(rq->cons.head+i)&rq->mask].data);
     }
 }
@@ -13,6 +13,7 @@
  **            其中：Ki[i=0,1,...,n-1]为关键字, 且Ki<Ki+1[i=0,1,...,n-2];
  **            Ci[i=0,1,...,n]为至上子树根结点的指针, 且指针Ci所指子树中所有结点的
  **            关键字均小于Ki[i=0,1,...,n-1], 但都大于Ki-1[i=1,...,n-1];
+ **         并发控制: 写者之间互斥, 读者使用乐观锁耦合(详见shm_btree.h)
  ** 作  者: # Qifeng.zou # 2015.08.10 #
  ******************************************************************************/
 #include "shm_btree.h"
@@ -20,7 +21,22 @@
 #define shm_btree_ptr_to_off(ctx, ptr) (off_t)((void *)(ptr) - (ctx)->addr)
 #define shm_btree_off_to_ptr(ctx, off) (void *)((ctx)->addr + (off))
 
+/* 结点内联数组(关键字数组按8字节对齐) */
+#define shm_btree_key_size(btree) ((((btree)->max + 1) * sizeof(int) + 7) & ~((size_t)7))
+#define shm_btree_node_size(btree) \
+    (sizeof(shm_btree_node_t) + shm_btree_key_size(btree) + (2 * (btree)->max + 3) * sizeof(off_t))
+#define shm_btree_node_key(node) ((int *)((node) + 1))
+#define shm_btree_node_data(btree, node) \
+    ((off_t *)((char *)((node) + 1) + shm_btree_key_size(btree)))
+#define shm_btree_node_child(btree, node) \
+    (shm_btree_node_data(btree, node) + (btree)->max + 1)
+
+/* 版本号: 写者修改前后各加1 */
+#define shm_btree_write_begin(version) do { ++*(version); compiler_barrier(); } while(0)
+#define shm_btree_write_end(version) do { compiler_barrier(); ++*(version); } while(0)
+
 static shm_btree_node_t *shm_btree_node_alloc(shm_btree_cntx_t *ctx);
+static void shm_btree_node_free(shm_btree_cntx_t *ctx, shm_btree_node_t *node);
 static int shm_btree_node_dealloc(shm_btree_cntx_t *ctx, shm_btree_node_t *node);
 
 static int _shm_btree_insert(shm_btree_cntx_t *ctx, shm_btree_node_t *node, int key, int idx, void *data);
@@ -69,12 +85,12 @@ shm_btree_cntx_t *shm_btree_creat(const char *path, int m, size_t total)
         return NULL;
     }
 
-    lseek(fd, total, SEEK_SET);
+    lseek(fd, total - 1, SEEK_SET); /* 文件大小为total, 与attach的校验一致 */
 
     write(fd, "", 1);
 
     addr = mmap(NULL, total, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
-    if (NULL == addr) {
+    if (MAP_FAILED == addr) {
         close(fd);
         return NULL;
     }
@@ -101,6 +117,11 @@ shm_btree_cntx_t *shm_btree_creat(const char *path, int m, size_t total)
     btree->root = 0; /* 空 */
     btree->total = total;
 
+    spin_lock_init(&btree->lock);
+    btree->version = 0;
+    btree->free = 0; /* 空 */
+    btree->num = 0;
+
     pool = ctx->pool;
     pool->pool_size = total - sizeof(shm_btree_t);
 
@@ -162,7 +183,7 @@ shm_btree_cntx_t *shm_btree_attach(const char *path, int m, size_t total)
     }
 
     addr = mmap(NULL, total, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
-    if (NULL == addr) {
+    if (MAP_FAILED == addr) {
         close(fd);
         return NULL;
     }
@@ -200,35 +221,164 @@ shm_btree_cntx_t *shm_btree_attach(const char *path, int m, size_t total)
  **     num: 键值数组长度
  **     key: 需要查找的键
  **输出参数: NONE
- **返    回: 离key最近的键值索引
+ **返    回: 第一个不小于key的键值索引(0 ~ num)
  **实现描述: 使用二分查找算法实现
  **注意事项:
- **     返回值存mid在以下几种可能性:
- **     1. 返回等于key的值索引: keys[mid] == key
- **     2. 返回小于key的最大值索引: (keys[mid] < key) && (keys[mid+1] > key)
- **     3. 返回大于key的最小值索引: (keys[mid-1] < key) && (keys[mid] > key)
+ **     1. 返回idx < num且keys[idx] == key时表示找到;
+ **     2. 否则key只可能在孩子结点child[idx]中.
  **作    者: # Qifeng.zou # 2015.04.30 #
  ******************************************************************************/
 static int shm_btree_key_bsearch(const int *keys, int num, int key)
 {
-    int low, mid = 0, high;
+    int low, mid, high;
 
     low = 0;
-    high = num - 1;
+    high = num;
 
-    while (high >= low) {
+    while (low < high) {
         mid = (low + high) >> 1;
-        if (key == keys[mid]) {
-            return mid;
-        } else if (key < keys[mid]) {
-            high = mid - 1;
+        if (keys[mid] < key) {
+            low = mid + 1;
             continue;
         }
+        high = mid;
+    }
+
+    return low;
+}
+
+/******************************************************************************
+ **函数名称: shm_btree_read_begin
+ **功    能: 读取结点版本号
+ **输入参数:
+ **     version: 版本号
+ **输出参数: NONE
+ **返    回: 版本号(偶数)
+ **实现描述: 版本号为奇数时表示写者正在修改, 自旋等待其完成
+ **注意事项:
+ **     1. 写者可能在另一个进程中被调度出去, 自旋SHM_BTREE_SPIN_MAX次后让出CPU;
+ **     2. x86下读读/写写不会乱序, 编译屏障即可保证"读版本号->读内容->校验版本号"
+ **        的顺序.
+ **作    者: # Qifeng.zou # 2015.08.12 #
+ ******************************************************************************/
+static inline uint64_t shm_btree_read_begin(const volatile uint64_t *version)
+{
+    int n = 0;
+    uint64_t v;
+
+    while ((v = *version) & 1) {
+        if (++n >= SHM_BTREE_SPIN_MAX) {
+            n = 0;
+            sched_yield();
+        }
+    }
+
+    compiler_barrier();
+
+    return v;
+}
+
+/******************************************************************************
+ **函数名称: shm_btree_read_valid
+ **功    能: 校验读取期间版本号是否发生变化
+ **输入参数:
+ **     version: 版本号
+ **     v: shm_btree_read_begin()返回的版本号
+ **输出参数: NONE
+ **返    回: true:未变化(读到的内容有效) false:已变化(需重试)
+ **实现描述:
+ **注意事项:
+ **作    者: # Qifeng.zou # 2015.08.12 #
+ ******************************************************************************/
+static inline bool shm_btree_read_valid(const volatile uint64_t *version, uint64_t v)
+{
+    compiler_barrier();
+
+    return (*version == v);
+}
+
+/******************************************************************************
+ **函数名称: shm_btree_search
+ **功    能: 无锁查找关键字
+ **输入参数:
+ **     ctx: B树
+ **     key: 关键字
+ **输出参数:
+ **     _node: 关键字所在结点
+ **     _v: 读取结点时的版本号
+ **     data: 关键字对应数据(偏移量)
+ **返    回: 0:找到 -1:未找到
+ **实现描述: 乐观锁耦合
+ **     1. 读取根的版本号 -> 读取根结点 -> 校验根的版本号;
+ **     2. 读取孩子偏移 -> 校验父结点版本号 -> 读取孩子版本号 -> 再次校验父结点
+ **        版本号, 保证读到孩子版本号时其仍是父结点的孩子;
+ **     3. 任一校验失败则从根重新开始.
+ **注意事项:
+ **     找到时结点内容在版本号_v下有效, 调用者访问数据后可再次校验以确认未被删除
+ **作    者: # Qifeng.zou # 2015.08.12 #
+ ******************************************************************************/
+static int shm_btree_search(shm_btree_cntx_t *ctx,
+        int key, shm_btree_node_t **_node, uint64_t *_v, off_t *data)
+{
+    int idx, num;
+    uint64_t v, cv, rv;
+    off_t off, coff, doff;
+    shm_btree_node_t *node, *child;
+    shm_btree_t *btree = ctx->btree;
+
+AGAIN:
+    rv = shm_btree_read_begin(&btree->version);
+    off = btree->root;
+    if (!shm_btree_read_valid(&btree->version, rv)) {
+        goto AGAIN;
+    }
+    else if (0 == off) {
+        return -1; /* 空树 */
+    }
+
+    node = (shm_btree_node_t *)shm_btree_off_to_ptr(ctx, off);
+    v = shm_btree_read_begin(&node->version);
+    if (!shm_btree_read_valid(&btree->version, rv)) {
+        goto AGAIN;
+    }
+
+    while (1) {
+        num = node->num;
+        if ((num < 0) || (num > btree->max + 1)) {
+            goto AGAIN; /* 读到了正在修改的内容 */
+        }
+
+        idx = shm_btree_key_bsearch(shm_btree_node_key(node), num, key);
+        if ((idx < num) && (key == shm_btree_node_key(node)[idx])) {
+            doff = shm_btree_node_data(btree, node)[idx];
+            if (!shm_btree_read_valid(&node->version, v)) {
+                goto AGAIN;
+            }
+            *_node = node;
+            *_v = v;
+            *data = doff;
+            return 0; /* 找到 */
+        }
 
-        low = mid + 1;
+        coff = shm_btree_node_child(btree, node)[idx];
+        if (!shm_btree_read_valid(&node->version, v)) {
+            goto AGAIN;
+        }
+        else if (0 == coff) {
+            return -1; /* 未找到 */
+        }
+
+        child = (shm_btree_node_t *)shm_btree_off_to_ptr(ctx, coff);
+        cv = shm_btree_read_begin(&child->version);
+        if (!shm_btree_read_valid(&node->version, v)) {
+            goto AGAIN;
+        }
+
+        node = child;
+        v = cv;
     }
 
-    return mid;
+    return -1;
 }
 
 /******************************************************************************
@@ -240,7 +390,7 @@ static int shm_btree_key_bsearch(const int *keys, int num, int key)
  **     data: 关键字对应数据
  **输出参数: NONE
  **返    回: 0:成功 !0:失败
- **实现描述:
+ **实现描述: 加写锁后插入
  **注意事项:
  **作    者: # Qifeng.zou # 2015.08.10 #
  ******************************************************************************/
@@ -252,39 +402,46 @@ int shm_btree_insert(shm_btree_cntx_t *ctx, int key, void *data)
     off_t *node_data, *node_child;
     shm_btree_t *btree = ctx->btree;
 
+    spin_lock(&btree->lock);
+
     /* 1. 插入根结点 */
     if (0 == btree->root) {
         node = shm_btree_node_alloc(ctx);
         if (NULL == node) {
+            spin_unlock(&btree->lock);
             return -1;
         }
 
-        node_key = (int *)shm_btree_off_to_ptr(ctx, node->key);
-        node_data = (off_t *)shm_btree_off_to_ptr(ctx, node->data);
+        node_key = shm_btree_node_key(node);
+        node_data = shm_btree_node_data(btree, node);
 
         node->num = 1;
         node_key[0] = key;
         node->parent = 0; /* 空 */
         node_data[0] = (off_t)shm_btree_ptr_to_off(ctx, data);
+
+        shm_btree_write_begin(&btree->version);
         btree->root = (off_t)shm_btree_ptr_to_off(ctx, node);
+        shm_btree_write_end(&btree->version);
+
+        ++btree->num;
+        spin_unlock(&btree->lock);
         return 0;
     }
 
     /* 2. 查找关键字的插入位置 */
     node = (shm_btree_node_t *)shm_btree_off_to_ptr(ctx, btree->root);
     while (1) {
-        node_key = (int *)shm_btree_off_to_ptr(ctx, node->key);
-        node_data = (off_t *)shm_btree_off_to_ptr(ctx, node->data);
+        node_key = shm_btree_node_key(node);
 
         /* 二分查找算法实现 */
         idx = shm_btree_key_bsearch(node_key, node->num, key);
-        if (key == node_key[idx]) {
+        if ((idx < node->num) && (key == node_key[idx])) {
+            spin_unlock(&btree->lock);
             return 0;
-        } else if (key > node_key[idx]) {
-            idx += 1;
         }
 
-        node_child = (off_t *)shm_btree_off_to_ptr(ctx, node->child);
+        node_child = shm_btree_node_child(btree, node);
         if (0 == node_child[idx]) {
             break;
         }
@@ -293,7 +450,12 @@ int shm_btree_insert(shm_btree_cntx_t *ctx, int key, void *data)
     }
 
     /* 3. 执行插入操作 */
-    return _shm_btree_insert(ctx, node, key, idx, data);
+    ++btree->num;
+    idx = _shm_btree_insert(ctx, node, key, idx, data);
+
+    spin_unlock(&btree->lock);
+
+    return idx;
 }
 
 /******************************************************************************
@@ -319,8 +481,10 @@ static int _shm_btree_insert(shm_btree_cntx_t *ctx,
     off_t *node_data;
     shm_btree_t *btree = ctx->btree;
 
-    node_key = (int *)shm_btree_off_to_ptr(ctx, node->key);
-    node_data = (off_t *)shm_btree_off_to_ptr(ctx, node->data);
+    node_key = shm_btree_node_key(node);
+    node_data = shm_btree_node_data(btree, node);
+
+    shm_btree_write_begin(&node->version);
 
     /* 1. 插入最底层的节点: 孩子节点都是空指针 */
     for (i=node->num; i>idx; i--) {
@@ -337,6 +501,8 @@ static int _shm_btree_insert(shm_btree_cntx_t *ctx,
         return shm_btree_split(ctx, node);
     }
 
+    shm_btree_write_end(&node->version);
+
     return 0;
 }
 
@@ -350,6 +516,7 @@ static int _shm_btree_insert(shm_btree_cntx_t *ctx,
  **返    回: 0:成功 !0:失败
  **实现描述:
  **注意事项:
+ **     node处于修改状态(版本号为奇数), 返回前结束修改
  **作    者: # Qifeng.zou # 2015.08.10 #
  ******************************************************************************/
 static int shm_btree_split(shm_btree_cntx_t *ctx, shm_btree_node_t *node)
@@ -369,16 +536,31 @@ static int shm_btree_split(shm_btree_cntx_t *ctx, shm_btree_node_t *node)
 
         node2 = shm_btree_node_alloc(ctx);
         if (NULL == node2) {
+            shm_btree_write_end(&node->version);
             return -1;
         }
 
-        node_key = (int *)shm_btree_off_to_ptr(ctx, node->key);
-        node_data = (off_t *)shm_btree_off_to_ptr(ctx, node->data);
-        node_child = (off_t *)shm_btree_off_to_ptr(ctx, node->child);
+        parent = NULL;
+        if (0 == node->parent) {
+            parent = shm_btree_node_alloc(ctx);
+            if (NULL == parent) {
+                shm_btree_write_begin(&node2->version);
+                shm_btree_node_free(ctx, node2);
+                shm_btree_write_end(&node->version);
+                return -1;
+            }
+            shm_btree_write_begin(&parent->version);
+        }
+
+        shm_btree_write_begin(&node2->version);
 
-        node2_key = (int *)shm_btree_off_to_ptr(ctx, node2->key);
-        node2_data = (off_t *)shm_btree_off_to_ptr(ctx, node2->data);
-        node2_child = (off_t *)shm_btree_off_to_ptr(ctx, node2->child);
+        node_key = shm_btree_node_key(node);
+        node_data = shm_btree_node_data(btree, node);
+        node_child = shm_btree_node_child(btree, node);
+
+        node2_key = shm_btree_node_key(node2);
+        node2_data = shm_btree_node_data(btree, node2);
+        node2_child = shm_btree_node_child(btree, node2);
 
         /* Copy data */
         memcpy(node2_key, node_key+sep_idx+1, (total-sep_idx-1) * sizeof(int));
@@ -388,61 +570,49 @@ static int shm_btree_split(shm_btree_cntx_t *ctx, shm_btree_node_t *node)
         node2->num = (total - sep_idx - 1);
         node2->parent  = node->parent;
 
-        node->num = sep_idx;
-
         /* Insert into parent */
-        if (0 == node->parent) {  /* Parent is NULL */
+        if (NULL != parent) {  /* Parent is NULL */
             /* Split root node */
-            parent = shm_btree_node_alloc(ctx);
-            if (NULL == parent) {
-                return -1;
-            }
-
-            parent_key = (int *)shm_btree_off_to_ptr(ctx, parent->key);
-            parent_data = (off_t *)shm_btree_off_to_ptr(ctx, parent->data);
-            parent_child = (off_t *)shm_btree_off_to_ptr(ctx, parent->child);
+            parent_key = shm_btree_node_key(parent);
+            parent_data = shm_btree_node_data(btree, parent);
+            parent_child = shm_btree_node_child(btree, parent);
 
-            btree->root = (off_t)shm_btree_ptr_to_off(ctx, parent);
             parent_child[0] = (off_t)shm_btree_ptr_to_off(ctx, node);
-            node->parent = btree->root;
-            node2->parent = node->parent;
-
             parent_key[0] = node_key[sep_idx];
             parent_data[0] = node_data[sep_idx];
             parent_child[1] = (off_t)shm_btree_ptr_to_off(ctx, node2);
-            parent->num++;
+            parent->num = 1;
+
+            node->parent = (off_t)shm_btree_ptr_to_off(ctx, parent);
+            node2->parent = node->parent;
+
+            shm_btree_write_begin(&btree->version);
+            btree->root = node->parent;
+            shm_btree_write_end(&btree->version);
         } else {
             /* Insert into parent node */
             parent = (shm_btree_node_t *)shm_btree_off_to_ptr(ctx, node->parent);
 
-            parent_key = (int *)shm_btree_off_to_ptr(ctx, parent->key);
-            parent_data = (off_t *)shm_btree_off_to_ptr(ctx, parent->data);
-            parent_child = (off_t *)shm_btree_off_to_ptr(ctx, parent->child);
-
-            for (idx=parent->num; idx>0; idx--) {
-                if (node_key[sep_idx] < parent_key[idx-1]) {
-                    parent_key[idx] = parent_key[idx-1];
-                    parent_data[idx] = parent_data[idx-1];
-                    parent_child[idx+1] = parent_child[idx];
-                } else {
-                    parent_key[idx] = node_key[sep_idx];
-                    parent_data[idx] = node_data[sep_idx];
-                    parent_child[idx+1] = (off_t)shm_btree_ptr_to_off(ctx, node2);
-                    node2->parent = (off_t)shm_btree_ptr_to_off(ctx, parent);
-                    parent->num++;
-                    break;
-                }
-            }
+            parent_key = shm_btree_node_key(parent);
+            parent_data = shm_btree_node_data(btree, parent);
+            parent_child = shm_btree_node_child(btree, parent);
 
-            if (0 == idx) {
-                parent_key[0] = node_key[sep_idx];
-                parent_data[0] = node_data[sep_idx];
-                parent_child[1] = (off_t)shm_btree_ptr_to_off(ctx, node2);
-                node2->parent = (off_t)shm_btree_ptr_to_off(ctx, parent);
-                parent->num++;
-            }
+            shm_btree_write_begin(&parent->version);
+
+            idx = shm_btree_key_bsearch(parent_key, parent->num, node_key[sep_idx]);
+
+            memmove(parent_key+idx+1, parent_key+idx, (parent->num-idx) * sizeof(int));
+            memmove(parent_data+idx+1, parent_data+idx, (parent->num-idx) * sizeof(off_t));
+            memmove(parent_child+idx+2, parent_child+idx+1, (parent->num-idx) * sizeof(off_t));
+
+            parent_key[idx] = node_key[sep_idx];
+            parent_data[idx] = node_data[sep_idx];
+            parent_child[idx+1] = (off_t)shm_btree_ptr_to_off(ctx, node2);
+            parent->num++;
         }
 
+        node->num = sep_idx;
+
         memset(node_key+sep_idx, 0, (total - sep_idx) * sizeof(int));
         memset(node_data+sep_idx, 0, (total - sep_idx) * sizeof(off_t));
         memset(node_child+sep_idx+1, 0, (total - sep_idx) * sizeof(off_t));
@@ -454,9 +624,15 @@ static int shm_btree_split(shm_btree_cntx_t *ctx, shm_btree_node_t *node)
                 child->parent = (off_t)shm_btree_ptr_to_off(ctx, node2);
             }
         }
+
+        shm_btree_write_end(&node2->version);
+        shm_btree_write_end(&node->version);
+
         node = parent;
     }
 
+    shm_btree_write_end(&node->version);
+
     return 0;
 }
 
@@ -470,46 +646,83 @@ static int shm_btree_split(shm_btree_cntx_t *ctx, shm_btree_node_t *node)
  **输出参数: NONE
  **返    回: 0:成功 !0:失败
  **实现描述:
- **     使用node->child[idx]中的最大值替代被删除的关键字, 并依次向下处理直至最底
- **     层结点. -- 其实最终其处理过程相当于是删除最底层结点的关键字
+ **     使用左子树(node->child[idx])中的最大值替代被删除的关键字 -- 其实最终其处
+ **     理过程相当于是删除最底层结点的关键字
  **注意事项:
  **作    者: # Qifeng.zou # 2015.08.10 #
  ******************************************************************************/
 static int _shm_btree_remove(shm_btree_cntx_t *ctx, shm_btree_node_t *node, int idx)
 {
-    shm_btree_node_t *orig = node, *child;
-    int *node_key, *orig_key;
-    off_t *node_data, *orig_data;
-    off_t *node_child;
+    int m;
+    off_t mid;
+    shm_btree_node_t *leaf, *path;
+    int *node_key, *leaf_key;
+    off_t *node_data, *leaf_data, *leaf_child;
     shm_btree_t *btree = ctx->btree;
 
-    /* 使用node->child[idx]中的最大值替代被删除的关键字 */
-    do {
-        node_child = (off_t *)shm_btree_off_to_ptr(ctx, node->child);
-        if (0 == node_child[idx]) {
-            break;
+    node_key = shm_btree_node_key(node);
+    node_data = shm_btree_node_data(btree, node);
+    leaf_child = shm_btree_node_child(btree, node);
+
+    if (0 == leaf_child[idx]) {
+        /* 1. 最底层结点: 直接删除 */
+        leaf = node;
+        shm_btree_write_begin(&leaf->version);
+        for (m=idx; m<leaf->num-1; ++m) {
+            node_key[m] = node_key[m+1];
+            node_data[m] = node_data[m+1];
+        }
+    } else {
+        /* 2. 使用左子树中的最大值替代被删除的关键字 */
+        leaf = (shm_btree_node_t *)shm_btree_off_to_ptr(ctx, leaf_child[idx]);
+        while (1) {
+            leaf_child = shm_btree_node_child(btree, leaf);
+            if (0 == leaf_child[leaf->num]) {
+                break;
+            }
+            leaf = (shm_btree_node_t *)shm_btree_off_to_ptr(ctx, leaf_child[leaf->num]);
         }
-        child = (shm_btree_node_t *)shm_btree_off_to_ptr(ctx, node_child[idx]);
-        node = child;
-    } while(1);
 
-    node_key = (int *)shm_btree_off_to_ptr(ctx, node->key);
-    node_data = (off_t *)shm_btree_off_to_ptr(ctx, node->data);
+        leaf_key = shm_btree_node_key(leaf);
+        leaf_data = shm_btree_node_data(btree, leaf);
+
+        /* node至leaf路径上的结点均进入修改状态: 读者若在替换前经过node, 之后
+         * 在中间结点或leaf中都会发现版本变化而重试, 不会在leaf中看到前驱已被
+         * 移走而node中尚未替换(或相反)的状态 */
+        shm_btree_write_begin(&node->version);
+        for (mid = shm_btree_node_child(btree, node)[idx]; ; ) {
+            path = (shm_btree_node_t *)shm_btree_off_to_ptr(ctx, mid);
+            shm_btree_write_begin(&path->version);
+            if (path == leaf) {
+                break;
+            }
+            mid = shm_btree_node_child(btree, path)[path->num];
+        }
 
-    orig_key = (int *)shm_btree_off_to_ptr(ctx, orig->key);
-    orig_data = (off_t *)shm_btree_off_to_ptr(ctx, orig->data);
+        node_key[idx] = leaf_key[leaf->num - 1];
+        node_data[idx] = leaf_data[leaf->num - 1];
 
-    orig_key[idx] = node_key[node->num - 1];
-    orig_data[idx] = node_data[node->num - 1];
+        for (mid = shm_btree_node_child(btree, node)[idx]; ; ) {
+            path = (shm_btree_node_t *)shm_btree_off_to_ptr(ctx, mid);
+            if (path == leaf) {
+                break;
+            }
+            mid = shm_btree_node_child(btree, path)[path->num];
+            shm_btree_write_end(&path->version);
+        }
+        shm_btree_write_end(&node->version);
+    }
 
     /* 最终其处理过程相当于是删除最底层结点的关键字 */
-    --node->num;
-    node_key[node->num] = 0;
-    node_data[node->num] = 0; /* 空 */
-    if (node->num < btree->min) {
-        return shm_btree_merge(ctx, node);
+    --leaf->num;
+    shm_btree_node_key(leaf)[leaf->num] = 0;
+    shm_btree_node_data(btree, leaf)[leaf->num] = 0; /* 空 */
+    if (leaf->num < btree->min) {
+        return shm_btree_merge(ctx, leaf);
     }
 
+    shm_btree_write_end(&leaf->version);
+
     return 0;
 }
 
@@ -526,7 +739,7 @@ static int _shm_btree_remove(shm_btree_cntx_t *ctx, shm_btree_node_t *node, int
  **     1) 合并结点的情况: node->num + brother->num + 1 <= max
  **     2) 借用结点的情况: node->num + brother->num + 1 >  max
  **注意事项:
- **     node此时为最底层结点
+ **     node处于修改状态(版本号为奇数), 返回前结束修改或释放
  **作    者: # Qifeng.zou # 2015.08.10 #
  ******************************************************************************/
 static int shm_btree_merge(shm_btree_cntx_t *ctx, shm_btree_node_t *node)
@@ -539,35 +752,33 @@ static int shm_btree_merge(shm_btree_cntx_t *ctx, shm_btree_node_t *node)
     off_t *node_data, *parent_data, *left_data, *right_data;
     off_t *node_child, *parent_child, *left_child, *right_child;
 
-
-    node_key = (int *)shm_btree_off_to_ptr(ctx, node->key);
-    node_data = (off_t *)shm_btree_off_to_ptr(ctx, node->data);
-    node_child = (off_t *)shm_btree_off_to_ptr(ctx, node->child);
+    node_key = shm_btree_node_key(node);
+    node_data = shm_btree_node_data(btree, node);
+    node_child = shm_btree_node_child(btree, node);
 
     /* 1. node是根结点, 不必进行合并处理 */
     if (0 == node->parent) {
         if (0 == node->num) {
+            shm_btree_write_begin(&btree->version);
+            btree->root = node_child[0]; /* 为0时树为空 */
+            shm_btree_write_end(&btree->version);
             if (0 != node_child[0]) {
-                btree->root = node_child[0];
                 child = (shm_btree_node_t *)shm_btree_off_to_ptr(ctx, node_child[0]);
                 child->parent = 0; /* 空 */
-            } else {
-                btree->root = 0; /* 空 */
             }
-            shm_slab_dealloc(ctx->pool, node_child);
-            shm_slab_dealloc(ctx->pool, node_key);
-            shm_slab_dealloc(ctx->pool, node_data);
-            shm_slab_dealloc(ctx->pool, node);
+            shm_btree_node_free(ctx, node);
+            return 0;
         }
+        shm_btree_write_end(&node->version);
         return 0;
     }
 
     /* 2. 查找node是其父结点的第几个孩子结点 */
-    parent = (shm_btree_node_t *)((void *)ctx->addr + node->parent);
+    parent = (shm_btree_node_t *)shm_btree_off_to_ptr(ctx, node->parent);
 
-    parent_key = (int *)shm_btree_off_to_ptr(ctx, parent->key);
-    parent_data = (off_t *)shm_btree_off_to_ptr(ctx, parent->data);
-    parent_child = (off_t *)shm_btree_off_to_ptr(ctx, parent->child);
+    parent_key = shm_btree_node_key(parent);
+    parent_data = shm_btree_node_data(btree, parent);
+    parent_child = shm_btree_node_child(btree, parent);
 
     off = (off_t)shm_btree_ptr_to_off(ctx, node);
     for (idx=0; idx<=parent->num; idx++) {
@@ -577,22 +788,28 @@ static int shm_btree_merge(shm_btree_cntx_t *ctx, shm_btree_node_t *node)
     }
 
     if (idx > parent->num) {
+        shm_btree_write_end(&node->version);
         return -1;
     }
+
+    shm_btree_write_begin(&parent->version);
+
     /* 3. node: 最后一个孩子结点(left < node)
      * node as right child */
-    else if (idx == parent->num) {
+    if (idx == parent->num) {
         mid = idx - 1;
         left = (shm_btree_node_t *)shm_btree_off_to_ptr(ctx, parent_child[mid]);
 
+        shm_btree_write_begin(&left->version);
+
         /* 1) 合并结点 */
         if ((node->num + left->num + 1) <= btree->max) {
             return _shm_btree_merge(ctx, left, node, mid);
         }
 
-        left_key = (int *)shm_btree_off_to_ptr(ctx, left->key);
-        left_data = (off_t *)shm_btree_off_to_ptr(ctx, left->data);
-        left_child = (off_t *)shm_btree_off_to_ptr(ctx, left->child);
+        left_key = shm_btree_node_key(left);
+        left_data = shm_btree_node_data(btree, left);
+        left_child = shm_btree_node_child(btree, left);
 
         /* 2) 借用结点:brother->key[num-1] */
         for (m=node->num; m>0; m--) {
@@ -617,6 +834,10 @@ static int shm_btree_merge(shm_btree_cntx_t *ctx, shm_btree_node_t *node)
         left_data[left->num - 1] = 0; /* 空 */
         left_child[left->num] = 0; /* 空 */
         left->num--;
+
+        shm_btree_write_end(&left->version);
+        shm_btree_write_end(&node->version);
+        shm_btree_write_end(&parent->version);
         return 0;
     }
 
@@ -625,15 +846,17 @@ static int shm_btree_merge(shm_btree_cntx_t *ctx, shm_btree_node_t *node)
     mid = idx;
     right = (shm_btree_node_t *)shm_btree_off_to_ptr(ctx, parent_child[mid + 1]);
 
-    right_key = (int *)shm_btree_off_to_ptr(ctx, right->key);
-    right_data = (off_t *)shm_btree_off_to_ptr(ctx, right->data);
-    right_child = (off_t *)shm_btree_off_to_ptr(ctx, right->child);
+    shm_btree_write_begin(&right->version);
 
     /* 1) 合并结点 */
     if ((node->num + right->num + 1) <= btree->max) {
         return _shm_btree_merge(ctx, node, right, mid);
     }
 
+    right_key = shm_btree_node_key(right);
+    right_data = shm_btree_node_data(btree, right);
+    right_child = shm_btree_node_child(btree, right);
+
     /* 2) 借用结点: right->key[0] */
     node_key[node->num] = parent_key[mid];
     node_data[node->num] = parent_data[mid];
@@ -653,6 +876,10 @@ static int shm_btree_merge(shm_btree_cntx_t *ctx, shm_btree_node_t *node)
     }
     right_child[m] = 0; /* 空 */
     right->num--;
+
+    shm_btree_write_end(&right->version);
+    shm_btree_write_end(&node->version);
+    shm_btree_write_end(&parent->version);
     return 0;
 }
 
@@ -661,12 +888,14 @@ static int shm_btree_merge(shm_btree_cntx_t *ctx, shm_btree_node_t *node)
  **功    能: 合并结点
  **输入参数:
  **     btree: B树
- **     node:
- **     brother:
+ **     left: 左结点
+ **     right: 右结点(合并后释放)
+ **     mid: 父结点中分隔left和right的关键字索引
  **输出参数: NONE
  **返    回: 0:成功 !0:失败
  **实现描述:
  **注意事项:
+ **     left, right及其父结点均处于修改状态
  **作    者: # Qifeng.zou # 2015.08.10 #
  ******************************************************************************/
 static int _shm_btree_merge(shm_btree_cntx_t *ctx,
@@ -681,17 +910,17 @@ static int _shm_btree_merge(shm_btree_cntx_t *ctx,
 
     parent = (shm_btree_node_t *)shm_btree_off_to_ptr(ctx, left->parent);
 
-    parent_key = (int *)shm_btree_off_to_ptr(ctx, parent->key);
-    parent_data = (off_t *)shm_btree_off_to_ptr(ctx, parent->data);
-    parent_child = (off_t *)shm_btree_off_to_ptr(ctx, parent->child);
+    parent_key = shm_btree_node_key(parent);
+    parent_data = shm_btree_node_data(btree, parent);
+    parent_child = shm_btree_node_child(btree, parent);
 
-    left_key = (int *)shm_btree_off_to_ptr(ctx, left->key);
-    left_data = (off_t *)shm_btree_off_to_ptr(ctx, left->data);
-    left_child = (off_t *)shm_btree_off_to_ptr(ctx, left->child);
+    left_key = shm_btree_node_key(left);
+    left_data = shm_btree_node_data(btree, left);
+    left_child = shm_btree_node_child(btree, left);
 
-    right_key = (int *)shm_btree_off_to_ptr(ctx, right->key);
-    right_data = (off_t *)shm_btree_off_to_ptr(ctx, right->data);
-    right_child = (off_t *)shm_btree_off_to_ptr(ctx, right->child);
+    right_key = shm_btree_node_key(right);
+    right_data = shm_btree_node_data(btree, right);
+    right_child = shm_btree_node_child(btree, right);
 
     left_key[left->num] = parent_key[mid];
     left_data[left->num] = parent_data[mid];
@@ -719,16 +948,17 @@ static int _shm_btree_merge(shm_btree_cntx_t *ctx,
     parent_data[m] = 0; /* 空 */
     parent_child[m+1] = 0; /* 空 */
     parent->num--;
-    shm_slab_dealloc(ctx->pool, right_child);
-    shm_slab_dealloc(ctx->pool, right_key);
-    shm_slab_dealloc(ctx->pool, right_data);
-    shm_slab_dealloc(ctx->pool, right);
+
+    shm_btree_node_free(ctx, right);
+    shm_btree_write_end(&left->version);
 
     /* Check */
     if (parent->num < btree->min) {
         return shm_btree_merge(ctx, parent);
     }
 
+    shm_btree_write_end(&parent->version);
+
     return 0;
 }
 
@@ -745,37 +975,26 @@ static int _shm_btree_merge(shm_btree_cntx_t *ctx,
  ******************************************************************************/
 int shm_btree_destroy(shm_btree_cntx_t *ctx)
 {
-    int idx;
-    int *node_key;
-    void *node_data;
-    off_t *node_child;
-    shm_btree_node_t *node, *child;
+    shm_btree_node_t *node;
     shm_btree_t *btree = ctx->btree;
 
-    if (0 == btree->root) {
-        munmap(ctx->addr, btree->total);
-        free(ctx);
-        return 0;
-    }
-
-    node = (shm_btree_node_t *)shm_btree_off_to_ptr(ctx, btree->root);
+    spin_lock(&btree->lock);
 
-    node_key = (int *)shm_btree_off_to_ptr(ctx, node->key);
-    node_data = (off_t *)shm_btree_off_to_ptr(ctx, node->data);
-    node_child = (off_t *)shm_btree_off_to_ptr(ctx, node->child);
+    if (0 != btree->root) {
+        node = (shm_btree_node_t *)shm_btree_off_to_ptr(ctx, btree->root);
+        shm_btree_node_dealloc(ctx, node);
+        btree->root = 0;
+        btree->num = 0;
+    }
 
-    for (idx=0; idx<=node->num; ++idx) {
-        if (0 != node_child[idx]) {
-            child = (shm_btree_node_t *)shm_btree_off_to_ptr(ctx, node_child[idx]);
-            shm_btree_node_dealloc(ctx, child);
-        }
+    /* 释放空闲结点 */
+    while (0 != btree->free) {
+        node = (shm_btree_node_t *)shm_btree_off_to_ptr(ctx, btree->free);
+        btree->free = node->parent;
+        shm_slab_dealloc(ctx->pool, node);
     }
 
-    shm_slab_dealloc(ctx->pool, node_key);
-    shm_slab_dealloc(ctx->pool, node_data);
-    shm_slab_dealloc(ctx->pool, node_child);
-    shm_slab_dealloc(ctx->pool, node);
-    btree->root = 0;
+    spin_unlock(&btree->lock);
 
     munmap(ctx->addr, btree->total);
     free(ctx);
@@ -801,8 +1020,8 @@ static void _shm_btree_print(shm_btree_cntx_t *ctx, shm_btree_node_t *node, int
     off_t *node_child;
     shm_btree_node_t *child;
 
-    node_key = (int *)shm_btree_off_to_ptr(ctx, node->key);
-    node_child = (off_t *)shm_btree_off_to_ptr(ctx, node->child);
+    node_key = shm_btree_node_key(node);
+    node_child = shm_btree_node_child(ctx->btree, node);
 
     /* 1. Print Start */
     for (d=0; d<deep; d++) {
@@ -851,7 +1070,7 @@ static void _shm_btree_print(shm_btree_cntx_t *ctx, shm_btree_node_t *node, int
  **输出参数: NONE
  **返    回: VOID
  **实现描述:
- **注意事项:
+ **注意事项: 加写锁, 避免打印过程中结构发生变化
  **作    者: # Qifeng.zou # 2015.08.10 #
  ******************************************************************************/
 void shm_btree_print(shm_btree_cntx_t *ctx)
@@ -859,11 +1078,15 @@ void shm_btree_print(shm_btree_cntx_t *ctx)
     shm_btree_node_t *node;
     shm_btree_t *btree = ctx->btree;
 
+    spin_lock(&btree->lock);
+
     if (0 != btree->root) { /* 不空 */
         node = (shm_btree_node_t *)shm_btree_off_to_ptr(ctx, btree->root);
 
         _shm_btree_print(ctx, node, 0);
     }
+
+    spin_unlock(&btree->lock);
 }
 
 /******************************************************************************
@@ -873,55 +1096,65 @@ void shm_btree_print(shm_btree_cntx_t *ctx)
  **     btree: B树
  **输出参数: NONE
  **返    回: 节点地址
- **实现描述:
+ **实现描述: 优先从空闲结点链表中获取, 否则从内存池申请
  **注意事项:
+ **     关键字、数据和孩子数组内联在结点之后, 且都多留一个位置用于分裂前的移动
  **作    者: # Qifeng.zou # 2015.08.10 #
  ******************************************************************************/
 static shm_btree_node_t *shm_btree_node_alloc(shm_btree_cntx_t *ctx)
 {
-    int *node_key;
     shm_btree_node_t *node;
-    off_t *node_data, *node_child;
     shm_btree_t *btree = ctx->btree;
 
-    node = (shm_btree_node_t *)shm_slab_alloc(ctx->pool, sizeof(shm_btree_node_t));
+    /* > 复用空闲结点(版本号继续递增, 滞后的读者能够发现变化) */
+    if (0 != btree->free) {
+        node = (shm_btree_node_t *)shm_btree_off_to_ptr(ctx, btree->free);
+        btree->free = node->parent;
+
+        shm_btree_write_begin(&node->version);
+        node->num = 0;
+        node->parent = 0; /* 空 */
+        memset(node + 1, 0, shm_btree_node_size(btree) - sizeof(shm_btree_node_t));
+        shm_btree_write_end(&node->version);
+        return node;
+    }
+
+    /* > 从内存池申请(内存已清零) */
+    node = (shm_btree_node_t *)shm_slab_alloc(ctx->pool, shm_btree_node_size(btree));
     if (NULL == node) {
         return NULL;
     }
 
+    node->version = 0;
     node->num = 0;
     node->parent = 0; /* 空 */
 
-    /* More than (max) is for move */
-    node_key = (int *)shm_slab_alloc(ctx->pool, (btree->max + 1) * sizeof(int));
-    if (NULL == node_key) {
-        shm_slab_dealloc(ctx->pool, node);
-        return NULL;
-    }
-
-    node->key = (off_t)shm_btree_ptr_to_off(ctx, node_key);
-
-    node_data = (off_t *)shm_slab_alloc(ctx->pool, (btree->max + 1) * sizeof(off_t));
-    if (NULL == node_data) {
-        shm_slab_dealloc(ctx->pool, node_key);
-        shm_slab_dealloc(ctx->pool, node);
-        return NULL;
-    }
-
-    node->data = (off_t)shm_btree_ptr_to_off(ctx, node_data);
+    return node;
+}
 
-    /* More than (max+1) is for move */
-    node_child = (off_t *)shm_slab_alloc(ctx->pool, (btree->max+2) * sizeof(off_t));
-    if (NULL == node_child) {
-        shm_slab_dealloc(ctx->pool, node_key);
-        shm_slab_dealloc(ctx->pool, node_data);
-        shm_slab_dealloc(ctx->pool, node);
-        return NULL;
-    }
+/******************************************************************************
+ **函数名称: shm_btree_node_free
+ **功    能: 释放结点到空闲结点链表
+ **输入参数:
+ **     ctx: B树
+ **     node: 将被释放的结点(处于修改状态)
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述: 结束修改状态后放入空闲结点链表(通过parent字段链接)
+ **注意事项:
+ **     结点不归还内存池: 读者可能仍持有该结点的偏移, 须保证其读到的始终是结点,
+ **     且版本号只增不减.
+ **作    者: # Qifeng.zou # 2015.08.12 #
+ ******************************************************************************/
+static void shm_btree_node_free(shm_btree_cntx_t *ctx, shm_btree_node_t *node)
+{
+    shm_btree_t *btree = ctx->btree;
 
-    node->child = (off_t)shm_btree_ptr_to_off(ctx, node_child);
+    node->num = 0;
+    node->parent = btree->free;
+    shm_btree_write_end(&node->version);
 
-    return node;
+    btree->free = (off_t)shm_btree_ptr_to_off(ctx, node);
 }
 
 /******************************************************************************
@@ -939,13 +1172,10 @@ static shm_btree_node_t *shm_btree_node_alloc(shm_btree_cntx_t *ctx)
 static int shm_btree_node_dealloc(shm_btree_cntx_t *ctx, shm_btree_node_t *node)
 {
     int idx;
-    int *node_key;
-    off_t *node_data, *node_child;
+    off_t *node_child;
     shm_btree_node_t *child;
 
-    node_key = (int *)shm_btree_off_to_ptr(ctx, node->key);
-    node_data = (off_t *)shm_btree_off_to_ptr(ctx, node->data);
-    node_child = (off_t *)shm_btree_off_to_ptr(ctx, node->child);
+    node_child = shm_btree_node_child(ctx->btree, node);
 
     for (idx=0; idx<=node->num; ++idx) {
         if (0 != node_child[idx]) {
@@ -955,9 +1185,6 @@ static int shm_btree_node_dealloc(shm_btree_cntx_t *ctx, shm_btree_node_t *node)
         }
     }
 
-    shm_slab_dealloc(ctx->pool, node_key);
-    shm_slab_dealloc(ctx->pool, node_data);
-    shm_slab_dealloc(ctx->pool, node_child);
     shm_slab_dealloc(ctx->pool, node);
     return 0;
 }
@@ -970,41 +1197,45 @@ static int shm_btree_node_dealloc(shm_btree_cntx_t *ctx, shm_btree_node_t *node)
  **     key: 关键字
  **输出参数: NONE
  **返    回: 0:成功 !0:失败
- **实现描述:
+ **实现描述: 加写锁后删除
  **注意事项:
+ **     先将关键字从树中摘除, 再释放其数据, 保证读者校验版本号后不会返回已释放
+ **     的数据
  **作    者: # Qifeng.zou # 2015.08.10 #
  ******************************************************************************/
 int shm_btree_remove(shm_btree_cntx_t *ctx, int key)
 {
-    int idx;
-    off_t off;
-    void *data;
+    int idx, ret;
+    off_t off, data;
     int *node_key;
     shm_btree_node_t *node;
-    off_t *node_data, *node_child;
+    off_t *node_child;
     shm_btree_t *btree = ctx->btree;
 
+    spin_lock(&btree->lock);
+
     off = btree->root;
     while (0 != off) {
         node = (shm_btree_node_t *)shm_btree_off_to_ptr(ctx, off);
 
-        node_key = (int *)shm_btree_off_to_ptr(ctx, node->key);
-        node_data = (off_t *)shm_btree_off_to_ptr(ctx, node->data);
-        node_child = (off_t *)shm_btree_off_to_ptr(ctx, node->child);
+        node_key = shm_btree_node_key(node);
+        node_child = shm_btree_node_child(btree, node);
 
         idx = shm_btree_key_bsearch(node_key, node->num, key);
-        if (key == node_key[idx]) {
-            data = (void *)shm_btree_off_to_ptr(ctx, node_data[idx]);
-            shm_slab_dealloc(ctx->pool, data);
-            return _shm_btree_remove(ctx, node, idx);
-        } else if (key < node_key[idx]) {
-            off = node_child[idx];
-            continue;
+        if ((idx < node->num) && (key == node_key[idx])) {
+            data = shm_btree_node_data(btree, node)[idx];
+            ret = _shm_btree_remove(ctx, node, idx);
+            --btree->num;
+            shm_slab_dealloc(ctx->pool, shm_btree_off_to_ptr(ctx, data));
+            spin_unlock(&btree->lock);
+            return ret;
         }
 
-        off = node_child[idx+1];
+        off = node_child[idx];
     }
 
+    spin_unlock(&btree->lock);
+
     return -1; /* Not found */
 }
 
@@ -1016,39 +1247,192 @@ int shm_btree_remove(shm_btree_cntx_t *ctx, int key)
  **     key: 关键字
  **输出参数: NONE
  **返    回: key对应的数据
- **实现描述:
+ **实现描述: 无锁查找
  **注意事项:
+ **     返回后数据可能被其他进程删除, 需要稳定读取数据时使用shm_btree_query_copy()
  **作    者: # Qifeng.zou # 2015.08.10 #
  ******************************************************************************/
 void *shm_btree_query(shm_btree_cntx_t *ctx, int key)
 {
-    int idx;
-    off_t off;
-    int *node_key;
+    uint64_t v;
+    off_t data;
     shm_btree_node_t *node;
-    off_t *node_data, *node_child;
+
+    if (shm_btree_search(ctx, key, &node, &v, &data)) {
+        return NULL; /* 未找到 */
+    }
+
+    return (void *)shm_btree_off_to_ptr(ctx, data); /* 找到 */
+}
+
+/******************************************************************************
+ **函数名称: shm_btree_query_copy
+ **功    能: 查询指定关键字并拷贝其数据
+ **输入参数:
+ **     ctx: B树
+ **     key: 关键字
+ **     size: 拷贝长度
+ **输出参数:
+ **     buf: 数据拷贝
+ **返    回: 0:找到 -1:未找到
+ **实现描述: 无锁查找, 拷贝后再次校验结点版本号, 发生变化则重新查找
+ **注意事项:
+ **     结点版本号未变说明拷贝期间关键字未被删除, 数据也就不会被释放和复用
+ **作    者: # Qifeng.zou # 2015.08.12 #
+ ******************************************************************************/
+int shm_btree_query_copy(shm_btree_cntx_t *ctx, int key, void *buf, size_t size)
+{
+    uint64_t v;
+    off_t data;
+    shm_btree_node_t *node;
+
+    while (1) {
+        if (shm_btree_search(ctx, key, &node, &v, &data)) {
+            return -1; /* 未找到 */
+        }
+
+        memcpy(buf, shm_btree_off_to_ptr(ctx, data), size);
+
+        if (shm_btree_read_valid(&node->version, v)) {
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+/******************************************************************************
+ **函数名称: shm_btree_next
+ **功    能: 查找key的后继关键字
+ **输入参数:
+ **     ctx: B树
+ **     key: 关键字
+ **     inclusive: 是否包含key本身
+ **输出参数:
+ **     next: 后继关键字
+ **     data: 后继关键字对应的数据
+ **返    回: 0:找到 -1:不存在
+ **实现描述: 无锁查找
+ **     从根向下查找, 记录路径上第一个大于(或不小于)key的关键字, 越往下记录的
+ **     值越小, 到达最底层结点后最后记录的即为后继.
+ **注意事项:
+ **作    者: # Qifeng.zou # 2015.08.12 #
+ ******************************************************************************/
+int shm_btree_next(shm_btree_cntx_t *ctx, int key, bool inclusive, int *next, void **data)
+{
+    bool found;
+    int idx, num, k = 0;
+    uint64_t v, cv, rv;
+    off_t off, coff, doff = 0;
+    shm_btree_node_t *node, *child;
     shm_btree_t *btree = ctx->btree;
 
+    if (!inclusive) {
+        if (INT_MAX == key) {
+            return -1;
+        }
+        ++key; /* 大于key即不小于key+1 */
+    }
+
+AGAIN:
+    found = false;
+    rv = shm_btree_read_begin(&btree->version);
     off = btree->root;
-    while (0 != off) {
-        node = (shm_btree_node_t *)shm_btree_off_to_ptr(ctx, off);
+    if (!shm_btree_read_valid(&btree->version, rv)) {
+        goto AGAIN;
+    }
+    else if (0 == off) {
+        return -1; /* 空树 */
+    }
 
-        node_key = (int *)shm_btree_off_to_ptr(ctx, node->key);
-        node_data = (off_t *)shm_btree_off_to_ptr(ctx, node->data);
-        node_child = (off_t *)shm_btree_off_to_ptr(ctx, node->child);
+    node = (shm_btree_node_t *)shm_btree_off_to_ptr(ctx, off);
+    v = shm_btree_read_begin(&node->version);
+    if (!shm_btree_read_valid(&btree->version, rv)) {
+        goto AGAIN;
+    }
 
-        idx = shm_btree_key_bsearch(node_key, node->num, key);
-        if (key == node_key[idx]) {
-            return (void *)shm_btree_off_to_ptr(ctx, node_data[idx]); /* 找到 */
-        } else if (key < node_key[idx]) {
-            off = node_child[idx];
-            continue;
+    while (1) {
+        num = node->num;
+        if ((num < 0) || (num > btree->max + 1)) {
+            goto AGAIN;
         }
 
-        node = (shm_btree_node_t *)shm_btree_off_to_ptr(ctx, node_child[idx+1]);
+        idx = shm_btree_key_bsearch(shm_btree_node_key(node), num, key);
+        if (idx < num) {
+            k = shm_btree_node_key(node)[idx];
+            doff = shm_btree_node_data(btree, node)[idx];
+            found = true;
+        }
+
+        coff = shm_btree_node_child(btree, node)[idx];
+        if (!shm_btree_read_valid(&node->version, v)) {
+            goto AGAIN;
+        }
+        else if ((0 == coff) || (found && (k == key))) {
+            break; /* 最底层结点 或 正好命中 */
+        }
+
+        child = (shm_btree_node_t *)shm_btree_off_to_ptr(ctx, coff);
+        cv = shm_btree_read_begin(&child->version);
+        if (!shm_btree_read_valid(&node->version, v)) {
+            goto AGAIN;
+        }
+
+        node = child;
+        v = cv;
+    }
+
+    if (!found) {
+        return -1;
+    }
+
+    *next = k;
+    if (NULL != data) {
+        *data = (void *)shm_btree_off_to_ptr(ctx, doff);
+    }
+
+    return 0;
+}
+
+/******************************************************************************
+ **函数名称: shm_btree_range
+ **功    能: 按序遍历[min, max]范围内的关键字
+ **输入参数:
+ **     ctx: B树
+ **     min: 最小关键字(含)
+ **     max: 最大关键字(含)
+ **     proc: 回调函数(返回非0时停止遍历)
+ **     args: 附加参数
+ **输出参数: NONE
+ **返    回: 遍历的关键字个数
+ **实现描述: 通过shm_btree_next()逐个获取后继, 整个过程不加锁
+ **注意事项:
+ **     每次获取后继都是独立的一致快照, 遍历期间并发插入或删除的关键字可能被
+ **     看到也可能看不到, 但返回的关键字严格递增且不会重复.
+ **     回调得到的是数据地址而非拷贝: 关键字在回调前后被并发删除时, 其数据
+ **     可能已被释放复用, 调用者需自行保证数据的生命周期.
+ **作    者: # Qifeng.zou # 2015.08.12 #
+ ******************************************************************************/
+int shm_btree_range(shm_btree_cntx_t *ctx, int min, int max, shm_btree_trav_cb_t proc, void *args)
+{
+    int key, num = 0;
+    void *data;
+
+    if ((min > max) || shm_btree_next(ctx, min, true, &key, &data)) {
+        return 0;
+    }
+
+    while (key <= max) {
+        ++num;
+        if (proc(key, data, args)) {
+            break;
+        }
+        else if (shm_btree_next(ctx, key, false, &key, &data)) {
+            break;
+        }
     }
 
-    return NULL; /* 未找到 */
+    return num;
 }
 
 /******************************************************************************
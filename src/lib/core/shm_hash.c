@@ -11,25 +11,45 @@
 #include "shm_hash.h"
 #include "hash_alg.h"
 
-#define SHM_HASH_TOTAL_SIZE(len, max, size) /* 计算哈希空间 */\
+#define SHM_HASH_TOTAL_SIZE(slots, max, size) /* 计算哈希空间 */\
     (sizeof(shm_hash_head_t) + 2 * shm_ring_total(max) \
-     + (len) * sizeof(shm_hash_slot_t) \
-     + (max) * (sizeof(shm_list_node_t) + (size)))
+     + (slots) * sizeof(shm_hash_slot_t) \
+     + (max) * (sizeof(shm_hash_node_t) + (size)))
 
 /* 获取各段偏移 */
-#define SHM_HASH_HEAD_OFFSET(len, max, size) (0)
-#define SHM_HASH_SLOT_OFFSET(len, max, size) (sizeof(shm_hash_head_t))
-#define SHM_HASH_NODEQ_OFFSET(len, max, size)   /* 链表结点队列 */\
-    (SHM_HASH_SLOT_OFFSET(len, max, size) + (len) * sizeof(shm_hash_slot_t))
-#define SHM_HASH_DATAQ_OFFSET(len, max, size)   /* 数据结点队列 */\
-    (SHM_HASH_NODEQ_OFFSET(len, max, size) + shm_ring_total(max))
-#define SHM_HASH_NODE_OFFSET(len, max, size) \
-    (SHM_HASH_DATAQ_OFFSET(len, max, size) + shm_ring_total(max))
-#define SHM_HASH_DATA_OFFSET(len, max, size) \
-    (SHM_HASH_NODE_OFFSET(len, max, size) + (max) * sizeof(shm_list_node_t))
+#define SHM_HASH_HEAD_OFFSET(slots, max, size) (0)
+#define SHM_HASH_SLOT_OFFSET(slots, max, size) (sizeof(shm_hash_head_t))
+#define SHM_HASH_NODEQ_OFFSET(slots, max, size)   /* 链表结点队列 */\
+    (SHM_HASH_SLOT_OFFSET(slots, max, size) + (slots) * sizeof(shm_hash_slot_t))
+#define SHM_HASH_DATAQ_OFFSET(slots, max, size)   /* 数据结点队列 */\
+    (SHM_HASH_NODEQ_OFFSET(slots, max, size) + shm_ring_total(max))
+#define SHM_HASH_NODE_OFFSET(slots, max, size) \
+    (SHM_HASH_DATAQ_OFFSET(slots, max, size) + shm_ring_total(max))
+#define SHM_HASH_DATA_OFFSET(slots, max, size) \
+    (SHM_HASH_NODE_OFFSET(slots, max, size) + (max) * sizeof(shm_hash_node_t))
+
+#define SHM_HASH_SPIN_MAX   (1024)  /* 加槽锁失败多少次后检查扩容者是否存活 */
+
+/* 扩容进度 */
+#define SHM_HASH_LSP(level, split) (((uint64_t)(level) << 32) | (uint32_t)(split))
+#define SHM_HASH_LEVEL(lsp) ((int)((lsp) >> 32))
+#define SHM_HASH_SPLIT(lsp) ((int)((lsp) & 0xFFFFFFFF))
 
 /* 静态函数 */
 static shm_hash_t *shm_hash_init(void *addr, int len, int max, size_t size);
+static void shm_hash_grow(shm_hash_t *sh);
+
+/* 计算槽数上限: 使len<<k个槽足以容纳max个结点 */
+static int shm_hash_slot_max(int len, int max)
+{
+    int slots = len;
+
+    while ((slots < max / SHM_HASH_LOAD_MAX) && (slots <= (INT_MAX >> 1))) {
+        slots <<= 1;
+    }
+
+    return slots;
+}
 
 /******************************************************************************
  **函数名称: shm_hash_creat
@@ -50,7 +70,8 @@ static shm_hash_t *shm_hash_init(void *addr, int len, int max, size_t size);
  **  ^          ^            ^         ^          ^          ^
  **  |          |            |         |          |          |
  ** addr       slot        node_pool     data_pool       node       data
- **注意事项: 创建共享内存, 并进行相关资源进行初始化.
+ **注意事项: 创建共享内存, 并进行相关资源进行初始化. 哈希槽按可扩容的上限预分配,
+ **          初始只使用len个.
  **作    者: # Qifeng.zou # 2015.07.26 01:00:00 #
  ******************************************************************************/
 shm_hash_t *shm_hash_creat(const char *path, int len, int max, size_t size)
@@ -58,7 +79,7 @@ shm_hash_t *shm_hash_creat(const char *path, int len, int max, size_t size)
     void *addr;
     size_t total;
 
-    total = SHM_HASH_TOTAL_SIZE(len, max, size);
+    total = SHM_HASH_TOTAL_SIZE(shm_hash_slot_max(len, max), max, size);
 
     /* > 创建共享内存 */
     addr = shm_creat(path, total);
@@ -86,13 +107,15 @@ shm_hash_t *shm_hash_creat(const char *path, int len, int max, size_t size)
  ******************************************************************************/
 static shm_hash_t *shm_hash_init(void *addr, int len, int max, size_t size)
 {
-    int idx;
+    int idx, slots;
     off_t off;
     shm_hash_t *sh;
     shm_ring_t *ring;
     shm_hash_head_t *head;
     shm_hash_slot_t *slot;
 
+    slots = shm_hash_slot_max(len, max);
+
     /* > 创建对象 */
     sh = (shm_hash_t *)calloc(1, sizeof(shm_hash_t));
     if (NULL == sh) {
@@ -100,29 +123,37 @@ static shm_hash_t *shm_hash_init(void *addr, int len, int max, size_t size)
     }
 
     sh->addr = addr;
-    sh->head = (shm_hash_head_t *)(addr + SHM_HASH_HEAD_OFFSET(len, max, size));
-    sh->slot = (shm_hash_slot_t *)(addr + SHM_HASH_SLOT_OFFSET(len, max, size));
-    sh->node_pool = (shm_ring_t *)(addr + SHM_HASH_NODEQ_OFFSET(len, max, size));
-    sh->data_pool = (shm_ring_t *)(addr + SHM_HASH_DATAQ_OFFSET(len, max, size));
+    sh->pid = (uint32_t)getpid();
+    sh->head = (shm_hash_head_t *)(addr + SHM_HASH_HEAD_OFFSET(slots, max, size));
+    sh->slot = (shm_hash_slot_t *)(addr + SHM_HASH_SLOT_OFFSET(slots, max, size));
+    sh->node_pool = (shm_ring_t *)(addr + SHM_HASH_NODEQ_OFFSET(slots, max, size));
+    sh->data_pool = (shm_ring_t *)(addr + SHM_HASH_DATAQ_OFFSET(slots, max, size));
 
     /* > 初始化头部信息 */
     head = sh->head;
+    memset(head, 0, sizeof(shm_hash_head_t));
+
     head->len = len;
     head->max = max;
     head->size = size;
-    head->slot_off = SHM_HASH_SLOT_OFFSET(len, max, size);
-    head->node_off = SHM_HASH_NODEQ_OFFSET(len, max, size);
-    head->data_off = SHM_HASH_DATAQ_OFFSET(len, max, size);
+    head->slot_max = slots;
+    head->slot_off = SHM_HASH_SLOT_OFFSET(slots, max, size);
+    head->node_off = SHM_HASH_NODEQ_OFFSET(slots, max, size);
+    head->data_off = SHM_HASH_DATAQ_OFFSET(slots, max, size);
+    head->lsp = SHM_HASH_LSP(0, 0);
+    head->journal.slot = -1;
 
     /* > 链表结点队列 */
     ring = shm_ring_init((void *)sh->node_pool, max);
     if (NULL == ring) {
+        free(sh);
         return NULL;
     }
 
-    off = SHM_HASH_NODE_OFFSET(len, max, size);
-    for (idx=0; idx<max; ++idx, off+=sizeof(shm_list_node_t)) {
+    off = SHM_HASH_NODE_OFFSET(slots, max, size);
+    for (idx=0; idx<max; ++idx, off+=sizeof(shm_hash_node_t)) {
         if (shm_ring_push(sh->node_pool, off)) {
+            free(sh);
             return NULL;
         }
     }
@@ -130,25 +161,66 @@ static shm_hash_t *shm_hash_init(void *addr, int len, int max, size_t size)
     /* > 数据结点队列 */
     ring = shm_ring_init((void *)sh->data_pool, max);
     if (NULL == ring) {
+        free(sh);
         return NULL;
     }
 
-    off = SHM_HASH_DATA_OFFSET(len, max, size);
+    off = SHM_HASH_DATA_OFFSET(slots, max, size);
     for (idx=0; idx<max; ++idx, off+=size) {
         if (shm_ring_push(sh->data_pool, off)) {
+            free(sh);
             return NULL;
         }
     }
 
     /* > 哈希槽数组 */
     slot = sh->slot;
-    for (idx=0; idx<len; ++idx, ++slot) {
+    for (idx=0; idx<slots; ++idx, ++slot) {
         memset(slot, 0, sizeof(shm_hash_slot_t));
     }
 
     return sh;
 }
 
+/******************************************************************************
+ **函数名称: shm_hash_attach
+ **功    能: 附着哈希表
+ **输入参数:
+ **     path: 路径
+ **输出参数: NONE
+ **返    回: 哈希表
+ **实现描述: 各段偏移均从头部信息中获取
+ **注意事项: 对象中记录了当前进程ID, fork()出的子进程须重新附着
+ **作    者: # Qifeng.zou # 2015.07.27 #
+ ******************************************************************************/
+shm_hash_t *shm_hash_attach(const char *path)
+{
+    void *addr;
+    shm_hash_t *sh;
+
+    /* > 创建对象 */
+    sh = (shm_hash_t *)calloc(1, sizeof(shm_hash_t));
+    if (NULL == sh) {
+        return NULL;
+    }
+
+    /* > 附着共享内存 */
+    addr = (void *)shm_attach(path, 0);
+    if (NULL == addr) {
+        free(sh);
+        return NULL;
+    }
+
+    sh->addr = addr;
+    sh->pid = (uint32_t)getpid();
+    sh->head = (shm_hash_head_t *)addr;
+    sh->slot = (shm_hash_slot_t *)(addr + sh->head->slot_off);
+    sh->node_pool = (shm_ring_t *)(addr + sh->head->node_off);
+    sh->data_pool = (shm_ring_t *)(addr + sh->head->data_off);
+
+    return sh;
+}
+
 /******************************************************************************
  **函数名称: shm_hash_alloc
  **功    能: 申请数据单元空间
@@ -188,34 +260,121 @@ void shm_hash_dealloc(shm_hash_t *sh, void *addr)
 {
     off_t off;
 
-    off = (off_t)(sh->addr - addr);
+    off = (off_t)(addr - sh->addr);
 
     shm_ring_push(sh->data_pool, off);
 
     return;
 }
 
+/******************************************************************************
+ **函数名称: shm_hash_slot_idx
+ **功    能: 计算哈希值所在的槽
+ **输入参数:
+ **     sh: 哈希表对象
+ **     hash: 哈希值
+ **输出参数: NONE
+ **返    回: 槽索引
+ **实现描述: 已分裂的槽(< split)按下一级的槽数取模
+ **注意事项: level与split存于同一个64位变量中, 保证读取的一致性
+ **作    者: # Qifeng.zou # 2015.07.27 #
+ ******************************************************************************/
+static int shm_hash_slot_idx(shm_hash_t *sh, uint64_t hash)
+{
+    int level, split;
+    uint64_t idx, lsp = sh->head->lsp;
+
+    level = SHM_HASH_LEVEL(lsp);
+    split = SHM_HASH_SPLIT(lsp);
+
+    idx = hash % ((uint64_t)sh->head->len << level);
+    if (idx < (uint64_t)split) {
+        idx = hash % ((uint64_t)sh->head->len << (level + 1));
+    }
+
+    return (int)idx;
+}
+
+/* 尝试加槽锁(锁中记录当前进程ID): 0:成功 !0:失败 */
+static int shm_hash_slot_trylock(shm_hash_t *sh, int idx)
+{
+    return atomic32_cmp_and_set(&sh->slot[idx].lock, 0, sh->pid)? 0 : -1;
+}
+
+/* 加槽锁(等待释放) */
+static void shm_hash_slot_lock(shm_hash_t *sh, int idx)
+{
+    uint32_t delay = 1;
+
+    while (shm_hash_slot_trylock(sh, idx)) {
+        spin_backoff(&delay);
+    }
+}
+
+/* 释放槽锁 */
+static void shm_hash_slot_unlock(shm_hash_t *sh, int idx)
+{
+    compiler_barrier();
+    sh->slot[idx].lock = 0;
+}
+
+/******************************************************************************
+ **函数名称: shm_hash_lock
+ **功    能: 锁住哈希值所在的槽
+ **输入参数:
+ **     sh: 哈希表对象
+ **     hash: 哈希值
+ **输出参数: NONE
+ **返    回: 槽索引
+ **实现描述: 加锁后再次计算槽索引, 若期间该槽被分裂导致映射变化, 则重试.
+ **注意事项: 1. 扩容进度只在持有被分裂槽的锁时修改, 因此加锁后映射不会再变化
+ **          2. 长时间拿不到锁且有扩容者时, 尝试接管已退出的扩容者遗留的槽锁
+ **作    者: # Qifeng.zou # 2015.07.27 #
+ ******************************************************************************/
+static int shm_hash_lock(shm_hash_t *sh, uint64_t hash)
+{
+    int idx, n;
+    uint32_t delay;
+
+    for (;;) {
+        idx = shm_hash_slot_idx(sh, hash);
+        for (n=1, delay=1; shm_hash_slot_trylock(sh, idx); ++n) {
+            spin_backoff(&delay);
+            if ((0 == (n % SHM_HASH_SPIN_MAX)) && sh->head->owner) {
+                shm_hash_grow(sh); /* 扩容者可能已退出, 尝试接管以释放槽锁 */
+            }
+        }
+        if (idx == shm_hash_slot_idx(sh, hash)) {
+            return idx;
+        }
+        shm_hash_slot_unlock(sh, idx);
+    }
+
+    return -1;
+}
+
 /******************************************************************************
  **函数名称: shm_hash_push
- **功    能: 回收数据单元空间
+ **功    能: 插入数据
  **输入参数:
  **     sh: 哈希表对象
  **     key: 主键
  **     len: 长度
- **     addr: 需要被回收的数据单元地址
+ **     data: 数据单元地址(由shm_hash_alloc()分配)
  **输出参数: NONE
- **返    回: 数据单元地址
- **实现描述:
+ **返    回: 0:成功 !0:失败
+ **实现描述: 插入成功后, 若平均链长超过SHM_HASH_LOAD_MAX, 则分裂部分槽
  **注意事项:
  **作    者: # Qifeng.zou # 2015.07.26 14:32:24 #
  ******************************************************************************/
 int shm_hash_push(shm_hash_t *sh, void *key, int len, void *data)
 {
-    uint64_t idx;
-    shm_list_node_t *node;
+    int idx;
+    uint64_t hash;
+    shm_hash_node_t *node;
     off_t data_off, node_off;
 
-    idx = hash_time33_ex(key, len) % sh->head->len;
+    hash = hash_default(key, len);
     data_off = (off_t)(data - sh->addr);
 
     /* > 申请链表结点 */
@@ -224,14 +383,22 @@ int shm_hash_push(shm_hash_t *sh, void *key, int len, void *data)
         return -1;
     }
 
-    node = (shm_list_node_t *)(sh->addr + node_off);
-    node->data = data_off;
+    node = (shm_hash_node_t *)(sh->addr + node_off);
+    node->list.data = data_off;
+    node->hash = hash;
 
     /* > 插入链表头 */
+    idx = shm_hash_lock(sh, hash);
     if (shm_list_lpush(sh->addr, &sh->slot[idx].list, node_off)) {
+        shm_hash_slot_unlock(sh, idx);
         shm_ring_push(sh->node_pool, node_off);
         return -1;
     }
+    shm_hash_slot_unlock(sh, idx);
+
+    atomic32_inc(&sh->head->num);
+
+    shm_hash_grow(sh);
 
     return 0;
 }
@@ -251,22 +418,380 @@ int shm_hash_push(shm_hash_t *sh, void *key, int len, void *data)
  ******************************************************************************/
 void *shm_hash_pop(shm_hash_t *sh, void *key, int len, cmp_cb_t cmp_cb)
 {
+    int idx;
     void *data;
     off_t off;
-    uint64_t idx;
-    shm_list_node_t *node;
-
-    idx = hash_time33_ex(key, len) % sh->head->len;
+    shm_hash_node_t *node;
 
+    idx = shm_hash_lock(sh, hash_default(key, len));
     off = shm_list_query_and_delete(sh->addr, &sh->slot[idx].list, key, cmp_cb, sh->addr);
+    shm_hash_slot_unlock(sh, idx);
     if (0 == off) {
         return NULL;
     }
 
-    node = (shm_list_node_t *)(sh->addr + off);
-    data = (void *)(sh->addr + node->data);
+    atomic32_dec(&sh->head->num);
+
+    node = (shm_hash_node_t *)(sh->addr + off);
+    data = (void *)(sh->addr + node->list.data);
 
     shm_ring_push(sh->node_pool, off);
 
     return data;
 }
+
+/******************************************************************************
+ **函数名称: shm_hash_unlink
+ **功    能: 将结点从链表中摘除(可重入)
+ **输入参数:
+ **     addr: 首地址
+ **     list: 链表
+ **     off: 结点偏移
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述:
+ **注意事项: 只修改邻居结点和链头, 不修改结点自身, 因此中途退出后可原样重做.
+ **          链表结点数由分裂结束时统一修正.
+ **作    者: # Qifeng.zou # 2015.07.27 #
+ ******************************************************************************/
+static void shm_hash_unlink(void *addr, shm_list_t *list, off_t off)
+{
+    shm_list_node_t *node, *prev, *next;
+
+    node = (shm_list_node_t *)(addr + off);
+    if (node->next == off) {
+        list->head = 0; /* 唯一结点 */
+        return;
+    }
+
+    if (list->head == off) {
+        list->head = node->next;
+    }
+
+    prev = (shm_list_node_t *)(addr + node->prev);
+    next = (shm_list_node_t *)(addr + node->next);
+
+    prev->next = node->next;
+    next->prev = node->prev;
+}
+
+/******************************************************************************
+ **函数名称: shm_hash_link
+ **功    能: 将结点插入链表头(可重入)
+ **输入参数:
+ **     addr: 首地址
+ **     list: 链表
+ **     off: 结点偏移
+ **     head: 链表原链头(来自分裂日志)
+ **     tail: 链表原链尾(来自分裂日志)
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述:
+ **注意事项: 原链头/链尾取自日志而非链表, 因此中途退出后可原样重做
+ **作    者: # Qifeng.zou # 2015.07.27 #
+ ******************************************************************************/
+static void shm_hash_link(void *addr, shm_list_t *list, off_t off, off_t head, off_t tail)
+{
+    shm_list_node_t *node;
+
+    node = (shm_list_node_t *)(addr + off);
+    if (0 == head) {
+        node->prev = off;
+        node->next = off;
+        list->head = off;
+        return;
+    }
+
+    node->prev = tail;
+    node->next = head;
+    ((shm_list_node_t *)(addr + head))->prev = off;
+    ((shm_list_node_t *)(addr + tail))->next = off;
+    list->head = off;
+}
+
+/******************************************************************************
+ **函数名称: shm_hash_move
+ **功    能: 将结点迁移到新槽
+ **输入参数:
+ **     sh: 哈希表对象
+ **     src: 原槽
+ **     dst: 新槽
+ **     off: 结点偏移
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述: 先记日志再修改链表, 每步之间加屏障, 保证日志总能反映当前进度
+ **注意事项:
+ **作    者: # Qifeng.zou # 2015.07.27 #
+ ******************************************************************************/
+static void shm_hash_move(shm_hash_t *sh, shm_list_t *src, shm_list_t *dst, off_t off)
+{
+    shm_hash_journal_t *journal = &sh->head->journal;
+
+    journal->node = off;
+    journal->head = dst->head;
+    journal->tail = dst->head? ((shm_list_node_t *)(sh->addr + dst->head))->prev : 0;
+    compiler_barrier();
+    journal->phase = SHM_HASH_MOVE_UNLINK;
+    compiler_barrier();
+
+    shm_hash_unlink(sh->addr, src, off);
+
+    compiler_barrier();
+    journal->phase = SHM_HASH_MOVE_LINK;
+    compiler_barrier();
+
+    shm_hash_link(sh->addr, dst, off, journal->head, journal->tail);
+
+    compiler_barrier();
+    journal->phase = SHM_HASH_MOVE_IDLE;
+}
+
+/* 统计链表结点数 */
+static int shm_hash_list_count(void *addr, shm_list_t *list)
+{
+    int num = 0;
+    off_t off = list->head;
+
+    if (0 == off) {
+        return 0;
+    }
+
+    do {
+        ++num;
+        off = ((shm_list_node_t *)(addr + off))->next;
+    } while (off != list->head);
+
+    return num;
+}
+
+/******************************************************************************
+ **函数名称: shm_hash_split
+ **功    能: 分裂(或续做)日志中记录的槽
+ **输入参数:
+ **     sh: 哈希表对象
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述:
+ **     1. 重做日志中未完成的结点迁移
+ **     2. 将原槽中按下一级取模落在新槽的结点逐个迁移
+ **     3. 推进扩容进度
+ **注意事项: 调用者持有扩容权, 且原槽和新槽均已加锁. 所有步骤均可重做, 因此执行
+ **          者在任意位置退出后, 接管者从头再执行一遍即可.
+ **作    者: # Qifeng.zou # 2015.07.27 #
+ ******************************************************************************/
+static void shm_hash_split(shm_hash_t *sh)
+{
+    int idx, num, level, split;
+    uint64_t mod;
+    off_t off, next;
+    shm_list_t *src, *dst;
+    shm_hash_node_t *node;
+    shm_hash_head_t *head = sh->head;
+    shm_hash_journal_t *journal = &head->journal;
+
+    level = SHM_HASH_LEVEL(journal->lsp);
+    split = SHM_HASH_SPLIT(journal->lsp);
+    mod = (uint64_t)head->len << (level + 1);
+
+    src = &sh->slot[split].list;
+    dst = &sh->slot[split + (head->len << level)].list;
+
+    /* > 重做未完成的迁移 */
+    switch (journal->phase) {
+        case SHM_HASH_MOVE_UNLINK:
+            shm_hash_unlink(sh->addr, src, journal->node);
+            journal->phase = SHM_HASH_MOVE_LINK;
+            compiler_barrier();
+            /* no break */
+        case SHM_HASH_MOVE_LINK:
+            shm_hash_link(sh->addr, dst, journal->node, journal->head, journal->tail);
+            compiler_barrier();
+            journal->phase = SHM_HASH_MOVE_IDLE;
+            break;
+        default:
+            break;
+    }
+
+    /* > 迁移结点 */
+    num = shm_hash_list_count(sh->addr, src);
+    off = src->head;
+    for (idx=0; idx<num; ++idx, off=next) {
+        node = (shm_hash_node_t *)(sh->addr + off);
+        next = node->list.next;
+        if (node->hash % mod != (uint64_t)split) {
+            shm_hash_move(sh, src, dst, off);
+        }
+    }
+
+    src->num = shm_hash_list_count(sh->addr, src);
+    dst->num = shm_hash_list_count(sh->addr, dst);
+
+    /* > 推进扩容进度 */
+    if (head->lsp == journal->lsp) {
+        if ((++split) == (head->len << level)) {
+            split = 0;
+            ++level;
+        }
+        head->lsp = SHM_HASH_LSP(level, split);
+    }
+}
+
+/******************************************************************************
+ **函数名称: shm_hash_grow_lock
+ **功    能: 获取扩容权
+ **输入参数:
+ **     sh: 哈希表对象
+ **输出参数: NONE
+ **返    回: 0:成功 !0:失败
+ **实现描述: 扩容权记录为进程ID, 持有者已退出时由当前进程接管
+ **注意事项: 同一时刻只有一个进程执行分裂
+ **作    者: # Qifeng.zou # 2015.07.27 #
+ ******************************************************************************/
+static int shm_hash_grow_lock(shm_hash_t *sh)
+{
+    uint32_t owner, pid = sh->pid;
+
+    if (atomic32_cmp_and_set(&sh->head->owner, 0, pid)) {
+        return 0;
+    }
+
+    owner = sh->head->owner;
+    if ((0 != owner) && (owner != pid)
+        && (kill((pid_t)owner, 0) < 0) && (ESRCH == errno)) {
+        return atomic32_cmp_and_set(&sh->head->owner, owner, pid)? 0 : -1; /* 接管 */
+    }
+
+    return -1;
+}
+
+/******************************************************************************
+ **函数名称: shm_hash_lock_adopt
+ **功    能: 加槽锁(持有者已退出时接管)
+ **输入参数:
+ **     sh: 哈希表对象
+ **     idx: 槽索引
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述:
+ **     槽锁中记录了持有者的进程ID. 加锁失败时检查持有者: 已退出(kill()返回
+ **     ESRCH)才将锁改为由当前进程持有; 仍存活时(包括被抢占或暂停)继续等待.
+ **注意事项: 1. 前任扩容者在加锁或解锁途中退出时, 槽锁可能由它持有(已泄漏),
+ **             也可能由其他进程正常持有, 只有前者会被接管
+ **          2. 持有者的进程ID被新进程复用时只会一直等待, 不会被误接管
+ **作    者: # Qifeng.zou # 2015.07.27 #
+ ******************************************************************************/
+static void shm_hash_lock_adopt(shm_hash_t *sh, int idx)
+{
+    uint32_t holder, delay = 1;
+    volatile uint32_t *lck = &sh->slot[idx].lock;
+
+    while (shm_hash_slot_trylock(sh, idx)) {
+        holder = *lck;
+        if ((0 != holder) && (holder != sh->pid)
+            && (kill((pid_t)holder, 0) < 0) && (ESRCH == errno)
+            && atomic32_cmp_and_set(lck, holder, sh->pid)) {
+            return; /* 接管 */
+        }
+        spin_backoff(&delay);
+    }
+}
+
+/* 释放分裂的两个槽锁: 解锁期间日志保持有效, 解锁后才清除 */
+static void shm_hash_grow_unlock(shm_hash_t *sh, int s, int image)
+{
+    shm_hash_journal_t *journal = &sh->head->journal;
+
+    journal->phase = SHM_HASH_MOVE_LOCK;
+    compiler_barrier();
+
+    shm_hash_slot_unlock(sh, image);
+    shm_hash_slot_unlock(sh, s);
+
+    compiler_barrier();
+    journal->slot = -1;
+}
+
+/******************************************************************************
+ **函数名称: shm_hash_grow
+ **功    能: 扩容
+ **输入参数:
+ **     sh: 哈希表对象
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述:
+ **     1. 取得扩容权后, 若日志中有未完成的分裂(前任持有者异常退出), 先续做.
+ **        阶段为SHM_HASH_MOVE_IDLE及迁移中时两个槽的锁仍由前任持有, 直接沿用;
+ **        阶段为SHM_HASH_MOVE_LOCK时重新加两个槽锁(只接管已退出进程持有的
+ **        锁, 其他进程正常持有时等待其释放). 续做后释放两个槽锁.
+ **     2. 平均链长超过SHM_HASH_LOAD_MAX时, 分裂至多SHM_HASH_SPLIT_NUM个槽.
+ **注意事项: 加锁前先写日志(阶段为SHM_HASH_MOVE_LOCK), 两个槽都锁住后才进入
+ **          SHM_HASH_MOVE_IDLE; 解锁前重新置为SHM_HASH_MOVE_LOCK, 解锁后才清除
+ **          日志. 因此扩容者在任意位置退出, 日志中都留有它可能持有的槽锁.
+ **作    者: # Qifeng.zou # 2015.07.27 #
+ ******************************************************************************/
+static void shm_hash_grow(shm_hash_t *sh)
+{
+    int idx, s, image, level, split;
+    uint64_t lsp;
+    shm_hash_head_t *head = sh->head;
+    shm_hash_journal_t *journal = &head->journal;
+
+    if ((0 == head->owner)
+        && (head->num <= (uint32_t)((head->len << SHM_HASH_LEVEL(head->lsp))
+            + SHM_HASH_SPLIT(head->lsp)) * SHM_HASH_LOAD_MAX)) {
+        return;
+    }
+
+    if (shm_hash_grow_lock(sh)) {
+        return;
+    }
+
+    /* > 续做未完成的分裂 */
+    if (-1 != journal->slot) {
+        lsp = journal->lsp;
+        s = journal->slot;
+        image = s + (head->len << SHM_HASH_LEVEL(lsp));
+
+        if (SHM_HASH_MOVE_LOCK == journal->phase) {
+            shm_hash_lock_adopt(sh, s);
+            shm_hash_lock_adopt(sh, image);
+            compiler_barrier();
+            journal->phase = SHM_HASH_MOVE_IDLE;
+        }
+
+        shm_hash_split(sh);
+
+        shm_hash_grow_unlock(sh, s, image);
+    }
+
+    /* > 分裂新槽 */
+    for (idx=0; idx<SHM_HASH_SPLIT_NUM; ++idx) {
+        lsp = head->lsp;
+        level = SHM_HASH_LEVEL(lsp);
+        split = SHM_HASH_SPLIT(lsp);
+        s = split;
+        image = split + (head->len << level);
+        if ((image >= head->slot_max)
+            || (head->num <= (uint32_t)image * SHM_HASH_LOAD_MAX)) {
+            break;
+        }
+
+        journal->lsp = lsp;
+        journal->phase = SHM_HASH_MOVE_LOCK;
+        compiler_barrier();
+        journal->slot = s;
+        compiler_barrier();
+
+        shm_hash_slot_lock(sh, s);
+        shm_hash_slot_lock(sh, image);
+
+        compiler_barrier();
+        journal->phase = SHM_HASH_MOVE_IDLE;
+
+        shm_hash_split(sh);
+
+        shm_hash_grow_unlock(sh, s, image);
+    }
+
+    atomic32_xset(&head->owner, 0);
+}
@@ -251,3 +251,52 @@ int shm_queue_mpop(shm_queue_t *shmq, void **p, int num)
 
     return num;
 }
+
+/******************************************************************************
+ **函数名称: shm_queue_pop_wait
+ **功    能: 出队列(无数据时阻塞等待)
+ **输入参数:
+ **     shmq: 共享内存队列
+ **     msec: 超时时间(ms) (注: <0时表示永久等待)
+ **输出参数: NONE
+ **返    回: 数据地址(NULL:超时)
+ **实现描述:
+ **注意事项: 压入方仅在存在等待者时才执行唤醒系统调用
+ **作    者: # Qifeng.zou # 2015.06.12 #
+ ******************************************************************************/
+void *shm_queue_pop_wait(shm_queue_t *shmq, int msec)
+{
+    off_t off;
+
+    if (0 == shm_ring_mpop_wait(shmq->ring, &off, 1, msec)) {
+        return NULL;
+    }
+
+    return (void *)shmq->ring + off;
+}
+
+/******************************************************************************
+ **函数名称: shm_queue_mpop_wait
+ **功    能: 弹出多个数据(无数据时阻塞等待)
+ **输入参数:
+ **     shmq: 共享内存队列
+ **     num: 最多弹出的条数
+ **     msec: 超时时间(ms) (注: <0时表示永久等待)
+ **输出参数:
+ **     p: 数据地址数组
+ **返    回: 实际数据条数(0:超时)
+ **实现描述: 只要有数据即返回, 不必凑满num条
+ **注意事项:
+ **作    者: # Qifeng.zou # 2015.06.12 #
+ ******************************************************************************/
+int shm_queue_mpop_wait(shm_queue_t *shmq, void **p, int num, int msec)
+{
+    int idx;
+
+    num = shm_ring_mpop_wait(shmq->ring, (off_t *)p, num, msec);
+    for (idx=0; idx<num; ++idx) {
+        p[idx] = (void *)((void *)shmq->ring + (off_t)p[idx]);
+    }
+
+    return num;
+}
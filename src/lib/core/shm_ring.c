@@ -6,7 +6,9 @@
  ** 描  述: 共享内存版环形队列
  ** 作  者: # Qifeng.zou # Tue 05 May 2015 11:40:10 PM CST #
  ******************************************************************************/
+#include "futex.h"
 #include "atomic.h"
+#include "spinlock.h"
 #include "shm_ring.h"
 
 /******************************************************************************
@@ -50,6 +52,8 @@ shm_ring_t *shm_ring_init(void *addr, int max)
     rq->max = max;
     rq->num = 0;
     rq->mask = max - 1;
+    rq->seq = 0;
+    rq->waits = 0;
     rq->prod.head = rq->prod.tail = 0;
     rq->cons.head = rq->cons.tail = 0;
 
@@ -111,6 +115,7 @@ off_t shm_ring_pop(shm_ring_t *rq)
 int shm_ring_mpush(shm_ring_t *rq, off_t *off, unsigned int num)
 {
     int succ;
+    uint32_t delay = 1;
     unsigned int prod_head, prod_next, cons_tail, i;
 
     /* > 申请队列空间 */
@@ -130,11 +135,19 @@ int shm_ring_mpush(shm_ring_t *rq, off_t *off, unsigned int num)
     for (i=0; i<num; ++i) {
         rq->off[(prod_head+i) & rq->mask] = off[i];
     }
-    while (rq->prod.tail != prod_head) { NULL; }
+    while (rq->prod.tail != prod_head) {
+        spin_backoff(&delay); /* 前一生产者被抢占时让出CPU, 避免空转整个时间片 */
+    }
     rq->prod.tail = prod_next;
 
     atomic32_add(&rq->num, num); /* 计数 */
 
+    /* > 唤醒等待者(注: 加锁指令兼具内存屏障作用, 保证先更新序列号再读取等待者个数) */
+    atomic32_inc(&rq->seq);
+    if (rq->waits) {
+        futex_wake(&rq->seq, num);
+    }
+
     return 0;
 }
 
@@ -154,6 +167,7 @@ int shm_ring_mpush(shm_ring_t *rq, off_t *off, unsigned int num)
 int shm_ring_mpop(shm_ring_t *rq, off_t *off, unsigned int num)
 {
     int succ;
+    uint32_t delay = 1;
     unsigned int cons_head, cons_next, prod_tail, i;
 
     /* > 申请队列空间 */
@@ -176,7 +190,9 @@ int shm_ring_mpop(shm_ring_t *rq, off_t *off, unsigned int num)
     }
 
     /* > 判断是否其他线程也在进行处理, 是的话, 则等待对方完成处理 */
-    while (rq->cons.tail != cons_head) { NULL; }
+    while (rq->cons.tail != cons_head) {
+        spin_backoff(&delay);
+    }
 
     rq->cons.tail = cons_next;
 
@@ -185,6 +201,71 @@ int shm_ring_mpop(shm_ring_t *rq, off_t *off, unsigned int num)
     return num;
 }
 
+/******************************************************************************
+ **函数名称: shm_ring_mpop_wait
+ **功    能: 弹出数据(无数据时阻塞等待)
+ **输入参数:
+ **     rq: 队列
+ **     num: 最多弹出n个地址
+ **     msec: 超时时间(ms) (注: <0时表示永久等待)
+ **输出参数:
+ **     off: 偏移数组
+ **返    回: 实际数据条数(0:超时)
+ **实现描述:
+ **     1. 有数据时, 直接弹出min(num, used)个数据
+ **     2. 无数据时, 登记等待者后在序列号上睡眠, 被唤醒后重新尝试
+ **注意事项:
+ **     1. 先增加等待者个数再读取序列号, 与压入方"先更新序列号再读等待者"配对,
+ **        保证不会丢失唤醒: 要么压入方看到等待者, 要么等待者看到新序列号.
+ **     2. 使用共享内存中的futex字, 支持跨进程等待和唤醒.
+ **作    者: # Qifeng.zou # 2015.06.12 #
+ ******************************************************************************/
+int shm_ring_mpop_wait(shm_ring_t *rq, off_t *off, unsigned int num, int msec)
+{
+    int n, left = msec;
+    uint32_t seq, used;
+    struct timeval ctm, etm;
+
+    if (msec >= 0) {
+        gettimeofday(&ctm, NULL);
+        etm.tv_sec = ctm.tv_sec + msec / 1000;
+        etm.tv_usec = ctm.tv_usec + (msec % 1000) * 1000;
+    }
+
+    while (1) {
+        /* > 尝试弹出数据 */
+        used = rq->num;
+        if (used > 0) {
+            n = shm_ring_mpop(rq, off, (num < used)? num : used);
+            if (n > 0) {
+                return n;
+            }
+            continue;
+        }
+
+        if (0 == left) {
+            return 0; /* 超时 */
+        }
+
+        /* > 登记等待者并睡眠 */
+        atomic32_inc(&rq->waits);
+        seq = rq->seq;
+        if (shm_ring_isempty(rq)) {
+            futex_wait(&rq->seq, seq, left);
+        }
+        atomic32_dec(&rq->waits);
+
+        /* > 计算剩余时间 */
+        if (msec >= 0) {
+            gettimeofday(&ctm, NULL);
+            left = (etm.tv_sec - ctm.tv_sec) * 1000 + (etm.tv_usec - ctm.tv_usec) / 1000;
+            left = MAX(left, 0);
+        }
+    }
+
+    return 0;
+}
+
 /******************************************************************************
  **函数名称: shm_ring_print
  **功    能: 打印环形队列
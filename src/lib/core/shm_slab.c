@@ -5,8 +5,10 @@
  ** 版本号: 1.0
  ** 描  述: 共享内存版的SLAB算法机制
  **         该算法主要用于共享内存的分配、管理和回收的处理。
+ **         小块内存优先经过每CPU缓存, 批量与全局SLAB交换, 减少全局锁的竞争.
  ** 作  者: # Qifeng.zou # 2013.07.12 #
  ******************************************************************************/
+#include <sched.h>
 #include "shm_slab.h"
 
 /* 宏定义 */
@@ -59,6 +61,7 @@ int shm_slab_slot_add_page(
     shm_slab_pool_t *pool, shm_slab_slot_t *slot, shm_slab_page_t *page);
 static int shm_slab_slot_remove_page(
     shm_slab_pool_t *pool, shm_slab_slot_t *slot, shm_slab_page_t *page);
+static void shm_slab_dealloc_chunk(shm_slab_pool_t *pool, void *p);
 
 /******************************************************************************
  **Name  : shm_slab_init
@@ -69,18 +72,19 @@ static int shm_slab_slot_remove_page(
  **Output: NONE
  **Return: 0:Success    !0:Failed
  **Desc  :
- **     |<-               HEAD               ->|
- **     |<- POOL ->|<-   SLOT   ->|<-  PAGE  ->|<-            DATA          ->|
- **     -----------------------------------------------------------------------
- **     |          |              |            |      |      |       |        |
- **     |   Pool   |     Slot     |    Page    |  P1  |  P2  |  ...  |   Pn   |
- **     |          |              |            |      |      |       |        |
- **     -----------------------------------------------------------------------
- **     ^          ^              ^            ^                              ^
- **     |          |              |            |                              |
- **    addr       slot           page         data                           end
+ **     |<-                     HEAD                   ->|
+ **     |<- POOL ->|<-  SLOT  ->|<-  CACHE  ->|<-  PAGE  ->|<-        DATA        ->|
+ **     -----------------------------------------------------------------------------
+ **     |          |            |             |            |      |      |     |    |
+ **     |   Pool   |    Slot    |  CPU Cache  |    Page    |  P1  |  P2  | ... | Pn |
+ **     |          |            |             |            |      |      |     |    |
+ **     -----------------------------------------------------------------------------
+ **     ^          ^            ^             ^            ^                        ^
+ **     |          |            |             |            |                        |
+ **    addr       slot        cache          page         data                     end
  **Note  :
  **     addr: 为偏移量的基址
+ **     cache: 每CPU缓存, 组数为CPU数(不超过SHM_SLAB_CPU_MAX), 占用不超过总空间的1/8
  **注意事项：调用shm_slab_init()前, 需要设置好pool_size值.
  **Author: # Qifeng.zou # 2013.07.12 #
  ******************************************************************************/
@@ -91,6 +95,7 @@ int shm_slab_init(shm_slab_pool_t *pool)
     int idx, slot_num, page_num;
     shm_slab_slot_t *slot;
     shm_slab_page_t *page;
+    shm_slab_cache_t *cache;
 
     shm_slab_init_param();
 
@@ -107,7 +112,20 @@ int shm_slab_init(shm_slab_pool_t *pool)
     pool->min_shift = SHM_SLAB_MIN_SHIFT;
 
     pool->slot_offset = sizeof(shm_slab_pool_t);
-    pool->page_offset = pool->slot_offset + slot_num * sizeof(shm_slab_page_t);
+
+    pool->cache_size = (sizeof(shm_slab_cache_t) + 63) & ~63;
+    pool->cache_offset = (pool->slot_offset + slot_num * sizeof(shm_slab_page_t) + 63) & ~63;
+    pool->cpu_num = sysconf(_SC_NPROCESSORS_CONF);
+    if (pool->cpu_num <= 0) {
+        pool->cpu_num = 1;
+    } else if (pool->cpu_num > SHM_SLAB_CPU_MAX) {
+        pool->cpu_num = SHM_SLAB_CPU_MAX;
+    }
+    if (pool->cpu_num * pool->cache_size > (pool->pool_size >> 3)) {
+        pool->cpu_num = 0;  /* 空间较小时不启用 */
+    }
+
+    pool->page_offset = pool->cache_offset + pool->cpu_num * pool->cache_size;
     pool->end_offset = pool->pool_size;
 
     slot = (shm_slab_slot_t *)(addr + pool->slot_offset);
@@ -121,6 +139,12 @@ int shm_slab_init(shm_slab_pool_t *pool)
         return -1;  /* Not enough memory */
     }
 
+    for (idx=0; idx<pool->cpu_num; idx++) {
+        cache = (shm_slab_cache_t *)(addr + pool->cache_offset + idx * pool->cache_size);
+        memset(cache, 0, sizeof(shm_slab_cache_t));
+        spin_lock_init(&cache->lock);
+    }
+
     left_size = pool->end_offset - pool->page_offset;
     page_num = left_size / (shm_slab_page_size() + sizeof(shm_slab_page_t));
     if (page_num <= 0) {
@@ -216,6 +240,158 @@ static int shm_slab_get_alloc_type(size_t size)
     return SHM_SLAB_ALLOC_PAGES;
 }
 
+/******************************************************************************
+ **Name  : shm_slab_cache_get
+ **Func  : Get cache of current cpu.
+ **Input :
+ **     pool: Object of slab pool.
+ **Output: NONE
+ **Return: Cache of current cpu.
+ **Desc  : 进程可能在取得CPU编号后被调度到其他CPU, 因此缓存仍需加锁.
+ **Note  :
+ **Author: # Qifeng.zou # 2015.08.24 #
+ ******************************************************************************/
+static inline shm_slab_cache_t *shm_slab_cache_get(shm_slab_pool_t *pool)
+{
+    int cpu;
+
+    cpu = sched_getcpu();
+    if (cpu < 0) {
+        cpu = 0;
+    }
+
+    return (shm_slab_cache_t *)((void *)pool + pool->cache_offset
+            + (cpu % pool->cpu_num) * pool->cache_size);
+}
+
+/******************************************************************************
+ **Name  : shm_slab_cache_cap
+ **Func  : Get capacity of cache slot.
+ **Input :
+ **     pool: Object of slab pool.
+ **     slot_idx: Index of slot.
+ **Output: NONE
+ **Return: Max number of cached chunks.
+ **Desc  : 不超过SHM_SLAB_CACHE_SIZE个, 且不超过SHM_SLAB_CACHE_BYTES字节
+ **Note  :
+ **Author: # Qifeng.zou # 2015.08.24 #
+ ******************************************************************************/
+static inline int shm_slab_cache_cap(shm_slab_pool_t *pool, int slot_idx)
+{
+    int cap = SHM_SLAB_CACHE_BYTES >> (slot_idx + pool->min_shift);
+
+    return (cap > SHM_SLAB_CACHE_SIZE)? SHM_SLAB_CACHE_SIZE : cap;
+}
+
+/******************************************************************************
+ **Name  : shm_slab_cache_alloc
+ **Func  : Alloc small memory from cpu cache.
+ **Input :
+ **     pool: Object of slab pool.
+ **     size: Alloc special size of memory.
+ **Output: NONE
+ **Return: Address of memory.
+ **Desc  :
+ **     1. 缓存锁被占用时, 直接加全局锁分配;
+ **     2. 缓存为空时, 加一次全局锁批量补充容量一半的块.
+ **Note  : 加锁顺序: 缓存锁 -> 全局锁
+ **Author: # Qifeng.zou # 2015.08.24 #
+ ******************************************************************************/
+static void *shm_slab_cache_alloc(shm_slab_pool_t *pool, size_t size)
+{
+    size_t s;
+    void *addr, *p;
+    shm_slab_cache_t *cache;
+    int shift, idx, num, batch, type;
+
+    addr = (void *)pool;
+
+    cache = shm_slab_cache_get(pool);
+    if (spin_trylock(&cache->lock)) {
+        spin_lock(&pool->lock);
+        p = shm_slab_alloc_slot(pool, size);
+        spin_unlock(&pool->lock);
+        return p;
+    }
+
+    /* 1. Make sure use which slot */
+    shift = pool->min_shift;
+    if (size > pool->min_size) {
+        for (shift = 1, s = size - 1; s >>= 1; shift++) {
+            /* Do nothing */
+        }
+    }
+    idx = shift - pool->min_shift;
+
+    /* 2. Refill cache */
+    if (0 == cache->slot[idx].num) {
+        batch = shm_slab_cache_cap(pool, idx) >> 1;
+        type = shm_slab_get_alloc_type(size);
+
+        spin_lock(&pool->lock);
+        for (num=0; num<batch; num++) {
+            p = _shm_slab_alloc_slot(pool, idx, type);
+            if (NULL == p) {
+                break;
+            }
+            cache->slot[idx].offset[batch-1-num] = p - addr; /* 地址较低的块先被使用 */
+        }
+        spin_unlock(&pool->lock);
+
+        if (0 == num) {
+            spin_unlock(&cache->lock);
+            return NULL;
+        } else if (num < batch) {
+            memmove(cache->slot[idx].offset, cache->slot[idx].offset + batch - num,
+                    num * sizeof(size_t));
+        }
+        cache->slot[idx].num = num;
+    }
+
+    p = addr + cache->slot[idx].offset[--cache->slot[idx].num];
+
+    spin_unlock(&cache->lock);
+
+    memset(p, 0, size);
+
+    return p;
+}
+
+/******************************************************************************
+ **Name  : shm_slab_cache_flush
+ **Func  : Give back the first num chunks of cache slot.
+ **Input :
+ **     pool: Object of slab pool.
+ **     cache: Cache of cpu.
+ **     slot_idx: Index of slot.
+ **     num: Number of chunks.
+ **Output: NONE
+ **Return: VOID
+ **Desc  : 归还最早放入的块, 最近回收的块留在缓存中(缓存较热). 只加一次全局锁.
+ **Note  : 调用者须持有缓存锁
+ **Author: # Qifeng.zou # 2015.08.24 #
+ ******************************************************************************/
+static void shm_slab_cache_flush(shm_slab_pool_t *pool,
+        shm_slab_cache_t *cache, int slot_idx, int num)
+{
+    int i;
+    void *addr = (void *)pool;
+
+    if (0 == num) {
+        return;
+    }
+
+    spin_lock(&pool->lock);
+    for (i=0; i<num; i++) {
+        shm_slab_dealloc_chunk(pool, addr + cache->slot[slot_idx].offset[i]);
+    }
+    spin_unlock(&pool->lock);
+
+    cache->slot[slot_idx].num -= num;
+    memmove(cache->slot[slot_idx].offset, cache->slot[slot_idx].offset + num,
+            cache->slot[slot_idx].num * sizeof(size_t));
+}
+
 /******************************************************************************
  **Name  : shm_slab_alloc
  **Func  : Alloc special size of memory from slab pool.
@@ -225,9 +401,11 @@ static int shm_slab_get_alloc_type(size_t size)
  **Output: NONE
  **Return: 0:Success    !0:Failed
  **Desc  :
+ **     0. Alloc small memory from cpu cache, flush all cpu caches and retry
+ **        once if failed.
  **     1. Alloc large memory from slab pool.
  **     2. Alloc small memory from slab pool.
- **Note  :
+ **Note  : 重试前不持有任何锁(加锁顺序: 缓存锁 -> 全局锁)
  **Author: # Qifeng.zou # 2013.07.12 #
  ******************************************************************************/
 void *shm_slab_alloc(shm_slab_pool_t *pool, size_t size)
@@ -241,6 +419,21 @@ void *shm_slab_alloc(shm_slab_pool_t *pool, size_t size)
         return NULL;
     }
 
+    shm_slab_init_param(); /* 仅attach的进程未初始化全局参数 */
+
+    /* 0. Alloc small memory from cpu cache */
+    if ((size < shm_slab_max_size()) && (pool->cpu_num > 0)) {
+        p = shm_slab_cache_alloc(pool, size);
+        if (NULL != p) {
+            return p;
+        }
+
+        /* 全局空闲块不足时, 空闲块可能滞留在各CPU缓存中: 全部归还后重试一次 */
+        shm_slab_flush(pool);
+
+        return shm_slab_cache_alloc(pool, size);
+    }
+
     spin_lock(&pool->lock);
 
     /* 1. Alloc large memory */
@@ -309,6 +502,9 @@ static shm_slab_page_t *shm_slab_alloc_pages(shm_slab_pool_t *pool, size_t pages
             next->next_idx = page->next_idx;
 
             prev->next_idx = next - start_page;
+            if (!shm_slab_is_null_page(page->next_idx)) {
+                start_page[page->next_idx].prev_idx = next - start_page;
+            }
 
             page->pages = pages;
             page->shift = shm_slab_page_shift();
@@ -564,16 +760,18 @@ static int shm_slab_free_pages(shm_slab_pool_t *pool, shm_slab_page_t *page)
 
     memset(data, 0, shm_slab_page_size());
 
+    page->shift = shm_slab_page_shift();
+    page->type = SHM_SLAB_ALLOC_UNKNOWN;
+
     if (shm_slab_is_null_page(free->next_idx)) {
         free->next_idx = page_idx;
+        page->next_idx = SHM_SLAB_NULL_PAGE;
         page->prev_idx = SHM_SLAB_FREE_PAGE;
         return 0;
     }
 
     next = &start_page[free->next_idx];
 
-    page->shift = shm_slab_page_shift();
-    page->type = SHM_SLAB_ALLOC_UNKNOWN;
     page->next_idx = free->next_idx;
     page->prev_idx = next->prev_idx;
     next->prev_idx = page_idx;
@@ -695,6 +893,62 @@ static int shm_slab_slot_remove_page(
  **Author: # Qifeng.zou # 2013.07.12 #
  ******************************************************************************/
 void shm_slab_dealloc(shm_slab_pool_t *pool, void *p)
+{
+    int cap, slot_idx;
+    size_t offset;
+    shm_slab_page_t *page;
+    shm_slab_cache_t *cache;
+    void *addr = (void *)pool;
+
+    offset = (void *)p - addr;
+    if ((offset < pool->data_offset) || (offset >= pool->end_offset)) {
+        fprintf(stderr, "Pointer address is incorrect! offset:%lu", offset);
+        return;
+    }
+
+    shm_slab_init_param(); /* 仅attach的进程未初始化全局参数 */
+
+    /* 1. Put small memory into cpu cache
+     *  块被占用期间, 所在页的类型和位移不会改变, 因此无需加全局锁 */
+    page = (shm_slab_page_t *)(addr + pool->page_offset) +
+        ((offset - pool->data_offset) >> shm_slab_page_shift());
+    if ((pool->cpu_num > 0)
+        && ((SHM_SLAB_ALLOC_SMALL == page->type)
+            || (SHM_SLAB_ALLOC_EXACT == page->type)
+            || (SHM_SLAB_ALLOC_LARGE == page->type)))
+    {
+        cache = shm_slab_cache_get(pool);
+        if (0 == spin_trylock(&cache->lock)) {
+            slot_idx = page->shift - pool->min_shift;
+            cap = shm_slab_cache_cap(pool, slot_idx);
+            if (cache->slot[slot_idx].num >= cap) {
+                shm_slab_cache_flush(pool, cache, slot_idx, cap >> 1);
+            }
+            cache->slot[slot_idx].offset[cache->slot[slot_idx].num++] = offset;
+            spin_unlock(&cache->lock);
+            return;
+        }
+    }
+
+    /* 2. Give back to slab pool */
+    spin_lock(&pool->lock);
+    shm_slab_dealloc_chunk(pool, p);
+    spin_unlock(&pool->lock);
+}
+
+/******************************************************************************
+ **Name  : shm_slab_dealloc_chunk
+ **Func  : Free special memory.
+ **Input :
+ **     pool: Object of slab pool.
+ **     p: Object which is will be freed.
+ **Output:
+ **Return: VOID
+ **Desc  :
+ **Note  : 调用者须持有pool->lock
+ **Author: # Qifeng.zou # 2013.07.12 #
+ ******************************************************************************/
+static void shm_slab_dealloc_chunk(shm_slab_pool_t *pool, void *p)
 {
     int ret = 0, page_idx = 0,
         idx = 0, is_free = 1,
@@ -709,13 +963,6 @@ void shm_slab_dealloc(shm_slab_pool_t *pool, void *p)
     addr = (void *)pool;
     offset = (void *)p - addr;
 
-    if ((offset < pool->data_offset) || (offset > pool->end_offset)) {
-        fprintf(stderr, "Pointer address is incorrect! offset:%lu", offset);
-        return;
-    }
-
-    spin_lock(&pool->lock);
-
     slot = (shm_slab_slot_t *)(addr + pool->slot_offset);
 
     page_idx = ((offset - pool->data_offset) >> shm_slab_page_shift());
@@ -736,7 +983,7 @@ void shm_slab_dealloc(shm_slab_pool_t *pool, void *p)
             if (0 == bitmap_idx) {
                 page->bitmap &= ~(1 << bit_idx);
             } else {
-                bitmap[bitmap_idx-1] &= ~(1 << bit_idx);
+                bitmap[bitmap_idx-1] &= ~(1 << (bit_idx & (SHM_SLAB_BITMAP_BITS - 1)));
             }
 
             for (idx=0; idx<exp_bitmaps; idx++) {
@@ -760,7 +1007,6 @@ void shm_slab_dealloc(shm_slab_pool_t *pool, void *p)
                 shm_slab_free_pages(pool, page);
                 break;
             }
-            spin_unlock(&pool->lock);
             break;
         }
         case SHM_SLAB_ALLOC_EXACT:
@@ -799,9 +1045,33 @@ void shm_slab_dealloc(shm_slab_pool_t *pool, void *p)
             break;
         }
     }
+}
 
-    spin_unlock(&pool->lock);
-    return;
+/******************************************************************************
+ **Name  : shm_slab_flush
+ **Func  : Give back all chunks of cpu caches.
+ **Input :
+ **     pool: Object of slab pool.
+ **Output:
+ **Return: VOID
+ **Desc  :
+ **Note  : 需要整页空间或统计占用情况前调用
+ **Author: # Qifeng.zou # 2015.08.24 #
+ ******************************************************************************/
+void shm_slab_flush(shm_slab_pool_t *pool)
+{
+    int cpu, idx;
+    shm_slab_cache_t *cache;
+
+    for (cpu=0; cpu<pool->cpu_num; cpu++) {
+        cache = (shm_slab_cache_t *)((void *)pool + pool->cache_offset + cpu * pool->cache_size);
+
+        spin_lock(&cache->lock);
+        for (idx=0; idx<SHM_SLAB_CACHE_CLASS; idx++) {
+            shm_slab_cache_flush(pool, cache, idx, cache->slot[idx].num);
+        }
+        spin_unlock(&cache->lock);
+    }
 }
 
 /******************************************************************************
@@ -819,5 +1089,6 @@ size_t shm_slab_head_size(size_t size)
 {
     return sizeof(shm_slab_pool_t)
             + (shm_slab_max_shift() - SHM_SLAB_MIN_SHIFT) * sizeof(shm_slab_slot_t)
+            + SHM_SLAB_CPU_MAX * ((sizeof(shm_slab_cache_t) + 63) & ~63)
             + (size >> shm_slab_page_shift()) * sizeof(shm_slab_page_t);
 }
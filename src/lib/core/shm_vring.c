@@ -0,0 +1,362 @@
+/******************************************************************************
+ ** Copyright(C) 2014-2024 Qiware technology Co., Ltd
+ **
+ ** 文件名: shm_vring.c
+ ** 版本号: 1.0
+ ** 描  述: 共享内存版变长环形队列
+ **         1. 记录按实际长度存放(记录头 + 数据), 避免shm_queue中定长内存块的浪费;
+ **         2. 支持多生产者/单消费者: 生产者通过CAS申请空间(reserve), 写完后提交
+ **            (commit); 消费者直接读取队列中的数据(peek), 处理完后释放(release),
+ **            全程无需拷贝.
+ **         3. 队尾剩余空间不足时, 写入填充记录(PAD)后回绕到队首.
+ ** 作  者: # Qifeng.zou # 2015.06.14 #
+ ******************************************************************************/
+#include "futex.h"
+#include "atomic.h"
+#include "shm_opt.h"
+#include "shm_vring.h"
+
+/* 大小向上取2的次方 */
+static size_t shm_vring_power2(size_t size)
+{
+    size_t v = SHM_VRING_ALIGN;
+
+    while (v < size) {
+        v <<= 1;
+    }
+
+    return v;
+}
+
+/******************************************************************************
+ **函数名称: shm_vring_total
+ **功    能: 获取变长环形队列需要的总空间
+ **输入参数:
+ **     size: 数据区大小
+ **输出参数: NONE
+ **返    回: 总空间大小
+ **实现描述:
+ **      -------------- ---------------------------------------
+ **     |    header    |               data area               |
+ **     | (shm_vring_t)|  [head|data] [head|data] ... [PAD]    |
+ **      -------------- ---------------------------------------
+ **注意事项: 数据区大小将被调整为2的次方
+ **作    者: # Qifeng.zou # 2015.06.14 #
+ ******************************************************************************/
+size_t shm_vring_total(size_t size)
+{
+    return sizeof(shm_vring_t) + shm_vring_power2(size);
+}
+
+/******************************************************************************
+ **函数名称: shm_vring_init
+ **功    能: 初始化变长环形队列
+ **输入参数:
+ **     addr: 内存首地址
+ **     size: 数据区大小
+ **输出参数: NONE
+ **返    回: 变长环形队列
+ **实现描述:
+ **注意事项: 数据区必须全部清零, 消费者据此判断记录是否已提交
+ **作    者: # Qifeng.zou # 2015.06.14 #
+ ******************************************************************************/
+shm_vring_t *shm_vring_init(void *addr, size_t size)
+{
+    shm_vring_t *vr = (shm_vring_t *)addr;
+
+    size = shm_vring_power2(size);
+
+    memset(vr, 0, sizeof(shm_vring_t) + size);
+
+    vr->size = size;
+    vr->mask = size - 1;
+
+    return vr;
+}
+
+/******************************************************************************
+ **函数名称: shm_vring_creat
+ **功    能: 创建共享内存变长环形队列
+ **输入参数:
+ **     path: KEY值路径
+ **     size: 数据区大小
+ **输出参数: NONE
+ **返    回: 变长环形队列
+ **实现描述:
+ **注意事项:
+ **作    者: # Qifeng.zou # 2015.06.14 #
+ ******************************************************************************/
+shm_vring_t *shm_vring_creat(const char *path, size_t size)
+{
+    void *addr;
+
+    addr = shm_creat(path, shm_vring_total(size));
+    if (NULL == addr) {
+        return NULL;
+    }
+
+    return shm_vring_init(addr, size);
+}
+
+/******************************************************************************
+ **函数名称: shm_vring_attach
+ **功    能: 附着共享内存变长环形队列
+ **输入参数:
+ **     path: KEY值路径
+ **输出参数: NONE
+ **返    回: 变长环形队列
+ **实现描述:
+ **注意事项:
+ **作    者: # Qifeng.zou # 2015.06.14 #
+ ******************************************************************************/
+shm_vring_t *shm_vring_attach(const char *path)
+{
+    return (shm_vring_t *)shm_attach(path, 0);
+}
+
+/******************************************************************************
+ **函数名称: shm_vring_reserve
+ **功    能: 申请记录空间
+ **输入参数:
+ **     vr: 变长环形队列
+ **     len: 数据长度
+ **输出参数: NONE
+ **返    回: 数据地址(NULL:空间不足)
+ **实现描述:
+ **     1. 计算所需空间: 队尾剩余空间不足时, 需额外占用队尾剩余空间作为填充
+ **     2. 通过CAS推进生产者位置
+ **     3. 写入填充记录和记录头(记录标志仍为FREE)
+ **注意事项:
+ **     1. 多个生产者可并发申请
+ **     2. 申请成功后必须调用shm_vring_commit()提交, 否则消费者将阻塞在此记录
+ **作    者: # Qifeng.zou # 2015.06.14 #
+ ******************************************************************************/
+void *shm_vring_reserve(shm_vring_t *vr, size_t len)
+{
+    shm_vring_head_t *head;
+    uint64_t pos, need;
+    size_t off, total, left;
+
+    if (len > shm_vring_max_len(vr)) {
+        return NULL;
+    }
+
+    total = shm_vring_rec_size(len);
+
+    /* > 申请队列空间 */
+    do {
+        pos = vr->head;
+        off = pos & vr->mask;
+        left = vr->size - off;
+
+        need = (total > left)? (left + total) : total;
+        if (pos + need - vr->tail > vr->size) {
+            return NULL; /* 空间不足 */
+        }
+    } while (!atomic64_cmp_and_set(&vr->head, pos, pos + need));
+
+    /* > 队尾剩余空间不足: 写入填充记录 */
+    if (total > left) {
+        head = (shm_vring_head_t *)(shm_vring_data(vr) + off);
+        head->len = left - sizeof(shm_vring_head_t);
+        compiler_barrier();
+        head->flag = SHM_VRING_PAD;
+        off = 0;
+    }
+
+    /* > 设置记录头 */
+    head = (shm_vring_head_t *)(shm_vring_data(vr) + off);
+    head->len = len;
+
+    return (void *)(head + 1);
+}
+
+/******************************************************************************
+ **函数名称: shm_vring_commit
+ **功    能: 提交记录
+ **输入参数:
+ **     vr: 变长环形队列
+ **     p: 数据地址(由shm_vring_reserve()返回)
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述: 先写数据再置记录标志, 之后仅在有等待者时才唤醒消费者
+ **注意事项:
+ **作    者: # Qifeng.zou # 2015.06.14 #
+ ******************************************************************************/
+void shm_vring_commit(shm_vring_t *vr, void *p)
+{
+    shm_vring_head_t *head = (shm_vring_head_t *)p - 1;
+
+    compiler_barrier();
+    head->flag = SHM_VRING_DATA;
+
+    atomic32_inc(&vr->seq);
+    if (vr->waits) {
+        futex_wake(&vr->seq, 1);
+    }
+}
+
+/******************************************************************************
+ **函数名称: shm_vring_push
+ **功    能: 压入数据
+ **输入参数:
+ **     vr: 变长环形队列
+ **     data: 数据
+ **     len: 数据长度
+ **输出参数: NONE
+ **返    回: 0:成功 !0:失败
+ **实现描述: 申请空间 -> 拷贝数据 -> 提交
+ **注意事项:
+ **作    者: # Qifeng.zou # 2015.06.14 #
+ ******************************************************************************/
+int shm_vring_push(shm_vring_t *vr, const void *data, size_t len)
+{
+    void *addr;
+
+    addr = shm_vring_reserve(vr, len);
+    if (NULL == addr) {
+        return -1;
+    }
+
+    memcpy(addr, data, len);
+
+    shm_vring_commit(vr, addr);
+
+    return 0;
+}
+
+/******************************************************************************
+ **函数名称: shm_vring_peek
+ **功    能: 获取队首记录
+ **输入参数:
+ **     vr: 变长环形队列
+ **输出参数:
+ **     len: 数据长度
+ **返    回: 数据地址(NULL:无已提交的数据)
+ **实现描述: 跳过填充记录, 直到遇到未提交记录或数据记录
+ **注意事项:
+ **     1. 只允许单个消费者调用
+ **     2. 数据直接指向共享内存, 处理完后需调用shm_vring_release()释放
+ **作    者: # Qifeng.zou # 2015.06.14 #
+ ******************************************************************************/
+void *shm_vring_peek(shm_vring_t *vr, size_t *len)
+{
+    uint64_t pos;
+    size_t off, total;
+    shm_vring_head_t *head;
+
+    while (1) {
+        pos = vr->tail;
+        off = pos & vr->mask;
+        head = (shm_vring_head_t *)(shm_vring_data(vr) + off);
+
+        switch (head->flag) {
+            case SHM_VRING_DATA:
+            {
+                compiler_barrier();
+                *len = head->len;
+                return (void *)(head + 1);
+            }
+            case SHM_VRING_PAD:
+            {
+                total = vr->size - off;
+                memset(head, 0, total);
+                compiler_barrier();
+                vr->tail = pos + total;
+                continue;
+            }
+            default:
+            {
+                return NULL; /* 无数据或未提交 */
+            }
+        }
+    }
+
+    return NULL;
+}
+
+/******************************************************************************
+ **函数名称: shm_vring_peek_wait
+ **功    能: 获取队首记录(无数据时阻塞等待)
+ **输入参数:
+ **     vr: 变长环形队列
+ **     msec: 超时时间(ms) (注: <0时表示永久等待)
+ **输出参数:
+ **     len: 数据长度
+ **返    回: 数据地址(NULL:超时)
+ **实现描述: 登记等待者后在提交序列号上睡眠, 被唤醒后重新获取
+ **注意事项: 与shm_ring_mpop_wait()相同, 先登记等待者再读取序列号, 保证不丢失唤醒
+ **作    者: # Qifeng.zou # 2015.06.14 #
+ ******************************************************************************/
+void *shm_vring_peek_wait(shm_vring_t *vr, size_t *len, int msec)
+{
+    void *addr;
+    uint32_t seq;
+    int left = msec;
+    struct timeval ctm, etm;
+
+    if (msec >= 0) {
+        gettimeofday(&ctm, NULL);
+        etm.tv_sec = ctm.tv_sec + msec / 1000;
+        etm.tv_usec = ctm.tv_usec + (msec % 1000) * 1000;
+    }
+
+    while (1) {
+        addr = shm_vring_peek(vr, len);
+        if (NULL != addr) {
+            return addr;
+        }
+        else if (0 == left) {
+            return NULL; /* 超时 */
+        }
+
+        /* > 登记等待者并睡眠 */
+        atomic32_inc(&vr->waits);
+        seq = vr->seq;
+        addr = shm_vring_peek(vr, len);
+        if (NULL == addr) {
+            futex_wait(&vr->seq, seq, left);
+        }
+        atomic32_dec(&vr->waits);
+        if (NULL != addr) {
+            return addr;
+        }
+
+        /* > 计算剩余时间 */
+        if (msec >= 0) {
+            gettimeofday(&ctm, NULL);
+            left = (etm.tv_sec - ctm.tv_sec) * 1000 + (etm.tv_usec - ctm.tv_usec) / 1000;
+            left = MAX(left, 0);
+        }
+    }
+
+    return NULL;
+}
+
+/******************************************************************************
+ **函数名称: shm_vring_release
+ **功    能: 释放队首记录
+ **输入参数:
+ **     vr: 变长环形队列
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述: 清零记录空间后推进消费者位置
+ **注意事项:
+ **     1. 只允许单个消费者调用, 且必须在shm_vring_peek()成功之后调用
+ **     2. 释放的空间必须清零: 之后的记录头可能落在此空间的任意位置, 若残留旧
+ **        数据, 消费者可能将其误判为已提交的记录.
+ **作    者: # Qifeng.zou # 2015.06.14 #
+ ******************************************************************************/
+void shm_vring_release(shm_vring_t *vr)
+{
+    size_t total;
+    uint64_t pos = vr->tail;
+    shm_vring_head_t *head;
+
+    head = (shm_vring_head_t *)(shm_vring_data(vr) + (pos & vr->mask));
+    total = shm_vring_rec_size(head->len);
+
+    memset(head, 0, total);
+    compiler_barrier();
+    vr->tail = pos + total;
+}
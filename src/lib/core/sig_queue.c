@@ -27,8 +27,7 @@ sig_queue_t *sig_queue_creat(int max, int size)
         return NULL;
     }
 
-    pthread_cond_init(&sq->ready, NULL);
-    pthread_mutex_init(&sq->lock, NULL);
+    event_count_init(&sq->ready);
 
     return sq;
 }
@@ -41,7 +40,7 @@ sig_queue_t *sig_queue_creat(int max, int size)
  **     addr: 将被放入的数据
  **输出参数: NONE
  **返    回: 0:成功 !0:失败
- **实现描述:
+ **实现描述: 插入成功后唤醒一个休眠的消费者(无消费者休眠时只读取一次等待者数)
  **注意事项:
  **作    者: # Qifeng.zou # 2015.08.05 #
  ******************************************************************************/
@@ -50,8 +49,9 @@ int sig_queue_push(sig_queue_t *sq, void *addr)
     int ret;
 
     ret = queue_push(sq->queue, addr);
-
-    pthread_cond_signal(&sq->ready);
+    if (0 == ret) {
+        event_count_notify(&sq->ready);
+    }
 
     return ret;
 }
@@ -64,18 +64,52 @@ int sig_queue_push(sig_queue_t *sq, void *addr)
  **输出参数: NONE
  **返    回: 内存地址
  **实现描述:
- **注意事项: 由于queue_t本身就是无锁队列, 因此, 将POP操作放在锁之外.
+ **     1. 队列非空时直接弹出, 未取到数据时重试
+ **     2. 队列为空时先自旋SIG_QUEUE_SPIN_NUM轮, 仍为空再登记并休眠
+ **注意事项: queue_t本身就是无锁队列, 弹出不加锁; 阻塞直至取到数据
  **作    者: # Qifeng.zou # 2015.08.05 #
  ******************************************************************************/
 void *sig_queue_pop(sig_queue_t *sq)
 {
-    pthread_mutex_lock(&sq->lock);
-    while (queue_empty(sq->queue)) {
-        pthread_cond_wait(&sq->ready, &sq->lock);
+    int spin = 0;
+    void *addr;
+    uint32_t key;
+
+    while (1) {
+        if (!queue_empty(sq->queue)) {
+            addr = queue_pop(sq->queue);
+            if (NULL != addr) {
+                return addr;
+            }
+
+            /* 被其他消费者取走, 或生产者尚未写完: 让出CPU避免空转 */
+            if (++spin < SIG_QUEUE_SPIN_NUM) {
+                cpu_relax();
+            }
+            else {
+                sched_yield();
+                spin = 0;
+            }
+            continue;
+        }
+
+        if (++spin < SIG_QUEUE_SPIN_NUM) {
+            cpu_relax();
+            continue;
+        }
+
+        /* > 休眠: 先登记再检查, 与sig_queue_push()配合避免丢失唤醒 */
+        key = event_count_prepare(&sq->ready);
+        if (!queue_empty(sq->queue)) {
+            event_count_cancel(&sq->ready);
+        }
+        else {
+            event_count_wait(&sq->ready, key, -1);
+        }
+        spin = 0;
     }
-    pthread_mutex_unlock(&sq->lock);
 
-    return queue_pop(sq->queue);
+    return NULL;
 }
 
 /******************************************************************************
@@ -91,8 +125,6 @@ void *sig_queue_pop(sig_queue_t *sq)
  ******************************************************************************/
 void sig_queue_destroy(sig_queue_t *sq)
 {
-    pthread_mutex_destroy(&sq->lock);
-    pthread_cond_destroy(&sq->ready);
     queue_destroy(sq->queue);
     free(sq);
 }
@@ -52,6 +52,7 @@
 #if !defined(__MEM_LEAK_CHECK__)
 static slab_page_t *slab_alloc_pages(slab_pool_t *pool, uint32_t pages);
 static void slab_dealloc_pages(slab_pool_t *pool, slab_page_t *page, uint32_t pages);
+static void slab_cache_release(void *_cache);
 
 
 static size_t slab_max_size = 0;
@@ -160,32 +161,32 @@ slab_pool_t *slab_init(void *addr, size_t size, log_cycle_t *log)
 
     spin_lock_init(&pool->lock);
 
+    pool->cache.enable = false;
+    pool->cache.list = NULL;
+    spin_lock_init(&pool->cache.lock);
+
     return pool;
 }
 
 /******************************************************************************
- **函数名称: slab_alloc
- **功    能: 从Slab中申请内存空间
+ **函数名称: slab_alloc_chunk
+ **功    能: 从Slab中申请内存空间(不加锁, 不清零)
  **输入参数:
  **     pool: Slab对象
  **     size: 申请的空间大小
  **输出参数:
- **返    回: 内存地址
+ **返    回: 内存地址(0:失败)
  **实现描述:
- **注意事项: 此内存机制只适合"小内存块"的空间分配, 小内存指的是小于4K的内存块.
- **          如果反复进行大量大小内存分配的混合空间申请和释放, "可能"出现分配空间
- **          失败的情况.
+ **注意事项: 调用者须持有pool->lock
  **作    者: # Nginx # YYYY.MM.DD #
  ******************************************************************************/
-void *slab_alloc(slab_pool_t *pool, size_t size)
+static uintptr_t slab_alloc_chunk(slab_pool_t *pool, size_t size)
 {
     size_t s;
     uintptr_t p, n, m, mask, *bitmap;
     uint32_t i, slot, shift, map;
     slab_page_t *page, *prev, *slots;
 
-    spin_lock(&pool->lock);    /* 加锁 */
-
     if (size >= slab_get_max_size()) {
         page = slab_alloc_pages(pool,
                 (size >> slab_get_page_shift()) + ((size % slab_get_page_size()) ? 1 : 0));
@@ -385,37 +386,28 @@ void *slab_alloc(slab_pool_t *pool, size_t size)
     p = 0;
 
 done:
-
-    if (0 != p) {
-        memset((void *)p, 0, size);
-    }
-
-    spin_unlock(&pool->lock);    /* 解锁 */
-
-    return (void *) p;
+    return p;
 }
 
 /******************************************************************************
- **函数名称: slab_dealloc
- **功    能: 释放从Slab申请的内存空间
+ **函数名称: slab_dealloc_chunk
+ **功    能: 释放从Slab申请的内存空间(不加锁)
  **输入参数:
  **     pool: Slab对象
  **     p: 内存起始地址
  **输出参数:
  **返    回: VOID
  **实现描述:
- **注意事项:
+ **注意事项: 调用者须持有pool->lock
  **作    者: # Nginx # YYYY.MM.DD #
  ******************************************************************************/
-void slab_dealloc(slab_pool_t *pool, void *p)
+static void slab_dealloc_chunk(slab_pool_t *pool, void *p)
 {
     size_t size;
     uintptr_t slab, m, *bitmap;
     uint32_t n, type, slot, shift, map;
     slab_page_t *slots, *page;
 
-    spin_lock(&pool->lock);    /* 加锁 */
-
     n = ((u_char *) p - pool->start) >> slab_get_page_shift();
     page = &pool->pages[n];
     slab = page->slab;
@@ -565,19 +557,14 @@ void slab_dealloc(slab_pool_t *pool, void *p)
             slab_dealloc_pages(pool, &pool->pages[n], size);
 
             slab_junk(p, size << slab_get_page_shift());
-
-            spin_unlock(&pool->lock); /* 解锁 */
             return;
         }
     }
 
     /* not reached */
-    spin_unlock(&pool->lock); /* 解锁 */
     return;
 done:
     slab_junk(p, size);
-
-    spin_unlock(&pool->lock);
     return;
 wrong_chunk:
     log_error(pool->log, "Pointer to wrong chunk");
@@ -585,10 +572,357 @@ wrong_chunk:
 chunk_already_free:
     log_error(pool->log, "Chunk is already free");
 fail:
-    spin_unlock(&pool->lock); /* 解锁 */
     return;
 }
 
+/******************************************************************************
+ **函数名称: slab_cache_get
+ **功    能: 获取当前线程的缓存
+ **输入参数:
+ **     pool: Slab对象
+ **输出参数:
+ **返    回: 线程缓存(NULL: 未启用线程缓存或创建失败)
+ **实现描述: 首次使用时创建缓存, 并加入内存池的缓存链表
+ **注意事项:
+ **作    者: # Qifeng.zou # 2015.08.24 #
+ ******************************************************************************/
+static inline slab_cache_t *slab_cache_get(slab_pool_t *pool)
+{
+    slab_cache_t *cache;
+
+    if (!pool->cache.enable) {
+        return NULL;
+    }
+
+    cache = (slab_cache_t *)pthread_getspecific(pool->cache.key);
+    if (NULL != cache) {
+        return cache;
+    }
+
+    cache = (slab_cache_t *)calloc(1, sizeof(slab_cache_t));
+    if (NULL == cache) {
+        return NULL;
+    }
+
+    cache->pool = pool;
+
+    if (pthread_setspecific(pool->cache.key, cache)) {
+        free(cache);
+        return NULL;
+    }
+
+    spin_lock(&pool->cache.lock);
+    cache->next = pool->cache.list;
+    if (NULL != pool->cache.list) {
+        pool->cache.list->prev = cache;
+    }
+    pool->cache.list = cache;
+    spin_unlock(&pool->cache.lock);
+
+    return cache;
+}
+
+/******************************************************************************
+ **函数名称: slab_cache_cap
+ **功    能: 计算分级的缓存容量
+ **输入参数:
+ **     pool: Slab对象
+ **     slot: 分级索引
+ **输出参数:
+ **返    回: 最多缓存的块数
+ **实现描述: 不超过SLAB_CACHE_SIZE个, 且不超过SLAB_CACHE_BYTES字节
+ **注意事项:
+ **作    者: # Qifeng.zou # 2015.08.24 #
+ ******************************************************************************/
+static inline int slab_cache_cap(slab_pool_t *pool, int slot)
+{
+    int cap = SLAB_CACHE_BYTES >> (slot + pool->min_shift);
+
+    return (cap > SLAB_CACHE_SIZE)? SLAB_CACHE_SIZE : cap;
+}
+
+/******************************************************************************
+ **函数名称: slab_cache_slot
+ **功    能: 获取内存块所属的分级
+ **输入参数:
+ **     pool: Slab对象
+ **     p: 内存起始地址
+ **输出参数:
+ **返    回: 分级索引(-1: 整页分配或不属于该内存池, 不经过线程缓存)
+ **实现描述: 块被占用期间, 所在页的类型和位移不会改变, 因此无需加锁
+ **注意事项:
+ **作    者: # Qifeng.zou # 2015.08.24 #
+ ******************************************************************************/
+static inline int slab_cache_slot(slab_pool_t *pool, void *p)
+{
+    uint32_t shift;
+    volatile slab_page_t *page;
+
+    if ((u_char *)p < pool->start || (u_char *)p >= pool->end) {
+        return -1;
+    }
+
+    page = &pool->pages[((u_char *)p - pool->start) >> slab_get_page_shift()];
+
+    switch (page->prev & SLAB_PAGE_MASK) {
+        case SLAB_SMALL:
+        case SLAB_BIG:
+        {
+            shift = page->slab & SLAB_SHIFT_MASK;
+            break;
+        }
+        case SLAB_EXACT:
+        {
+            shift = slab_get_exact_shift();
+            break;
+        }
+        default:
+        {
+            return -1;
+        }
+    }
+
+    if ((uintptr_t)p & ((1 << shift) - 1)) {
+        return -1; /* 交由slab_dealloc_chunk()报错 */
+    }
+
+    return shift - pool->min_shift;
+}
+
+/******************************************************************************
+ **函数名称: slab_cache_flush
+ **功    能: 将分级缓存中前num个块归还内存池
+ **输入参数:
+ **     pool: Slab对象
+ **     cache: 线程缓存
+ **     slot: 分级索引
+ **     num: 归还块数
+ **输出参数:
+ **返    回: VOID
+ **实现描述: 归还最早放入的块, 最近回收的块留在缓存中(缓存较热). 只加一次锁.
+ **注意事项:
+ **作    者: # Qifeng.zou # 2015.08.24 #
+ ******************************************************************************/
+static void slab_cache_flush(slab_pool_t *pool, slab_cache_t *cache, int slot, int num)
+{
+    int i;
+
+    if (0 == num) {
+        return;
+    }
+
+    spin_lock(&pool->lock);
+    for (i=0; i<num; ++i) {
+        slab_dealloc_chunk(pool, cache->slot[slot].obj[i]);
+    }
+    spin_unlock(&pool->lock);
+
+    cache->slot[slot].num -= num;
+    memmove(cache->slot[slot].obj, cache->slot[slot].obj + num,
+            cache->slot[slot].num * sizeof(void *));
+}
+
+/******************************************************************************
+ **函数名称: slab_cache_release
+ **功    能: 销毁线程缓存(线程退出时调用)
+ **输入参数:
+ **     _cache: 线程缓存
+ **输出参数:
+ **返    回: VOID
+ **实现描述: 归还全部缓存的块, 从缓存链表中移除后释放
+ **注意事项:
+ **作    者: # Qifeng.zou # 2015.08.24 #
+ ******************************************************************************/
+static void slab_cache_release(void *_cache)
+{
+    int slot;
+    slab_cache_t *cache = (slab_cache_t *)_cache;
+    slab_pool_t *pool = cache->pool;
+
+    for (slot=0; slot<SLAB_CACHE_CLASS; ++slot) {
+        slab_cache_flush(pool, cache, slot, cache->slot[slot].num);
+    }
+
+    spin_lock(&pool->cache.lock);
+    if (NULL != cache->prev) {
+        cache->prev->next = cache->next;
+    } else {
+        pool->cache.list = cache->next;
+    }
+    if (NULL != cache->next) {
+        cache->next->prev = cache->prev;
+    }
+    spin_unlock(&pool->cache.lock);
+
+    free(cache);
+}
+
+/******************************************************************************
+ **函数名称: slab_alloc
+ **功    能: 从Slab中申请内存空间
+ **输入参数:
+ **     pool: Slab对象
+ **     size: 申请的空间大小
+ **输出参数:
+ **返    回: 内存地址
+ **实现描述:
+ **     小于半页的申请优先从本线程的分级缓存中取, 缓存为空时加一次锁批量补充
+ **     容量一半的块; 其余申请直接加锁分配.
+ **注意事项: 此内存机制只适合"小内存块"的空间分配, 小内存指的是小于4K的内存块.
+ **          如果反复进行大量大小内存分配的混合空间申请和释放, "可能"出现分配空间
+ **          失败的情况.
+ **作    者: # Nginx # YYYY.MM.DD #
+ ******************************************************************************/
+void *slab_alloc(slab_pool_t *pool, size_t size)
+{
+    size_t s;
+    uintptr_t p;
+    slab_cache_t *cache;
+    int slot, shift, num, batch;
+
+    cache = slab_cache_get(pool);
+    if (NULL == cache || size >= slab_get_max_size()) {
+        spin_lock(&pool->lock);    /* 加锁 */
+        p = slab_alloc_chunk(pool, size);
+        spin_unlock(&pool->lock);    /* 解锁 */
+        if (0 != p) {
+            memset((void *)p, 0, size);
+        }
+        return (void *)p;
+    }
+
+    /* > 计算分级 */
+    shift = pool->min_shift;
+    if (size > pool->min_size) {
+        for (shift = 1, s = size - 1; s >>= 1; shift++) {
+            /* void */
+        }
+    }
+    slot = shift - pool->min_shift;
+
+    /* > 缓存为空时批量补充 */
+    if (0 == cache->slot[slot].num) {
+        batch = slab_cache_cap(pool, slot) >> 1;
+
+        spin_lock(&pool->lock);
+        for (num=0; num<batch; ++num) {
+            p = slab_alloc_chunk(pool, (size_t)1 << shift);
+            if (0 == p) {
+                break;
+            }
+            cache->slot[slot].obj[batch-1-num] = (void *)p; /* 地址较低的块先被使用 */
+        }
+        spin_unlock(&pool->lock);
+
+        if (0 == num) {
+            return NULL;
+        } else if (num < batch) {
+            memmove(cache->slot[slot].obj, cache->slot[slot].obj + batch - num,
+                    num * sizeof(void *));
+        }
+        cache->slot[slot].num = num;
+    }
+
+    p = (uintptr_t)cache->slot[slot].obj[--cache->slot[slot].num];
+
+    memset((void *)p, 0, size);
+
+    return (void *)p;
+}
+
+/******************************************************************************
+ **函数名称: slab_dealloc
+ **功    能: 释放从Slab申请的内存空间
+ **输入参数:
+ **     pool: Slab对象
+ **     p: 内存起始地址
+ **输出参数:
+ **返    回: VOID
+ **实现描述:
+ **     小块放入本线程的分级缓存, 缓存满时加一次锁批量归还较早放入的一半;
+ **     整页分配的内存直接加锁释放.
+ **注意事项: 内存块可由任意线程释放, 不要求与申请线程相同
+ **作    者: # Nginx # YYYY.MM.DD #
+ ******************************************************************************/
+void slab_dealloc(slab_pool_t *pool, void *p)
+{
+    int slot, cap;
+    slab_cache_t *cache;
+
+    cache = slab_cache_get(pool);
+    if (NULL == cache || (slot = slab_cache_slot(pool, p)) < 0) {
+        spin_lock(&pool->lock);    /* 加锁 */
+        slab_dealloc_chunk(pool, p);
+        spin_unlock(&pool->lock);    /* 解锁 */
+        return;
+    }
+
+    cap = slab_cache_cap(pool, slot);
+    if (cache->slot[slot].num >= cap) {
+        slab_cache_flush(pool, cache, slot, cap >> 1);
+    }
+
+    cache->slot[slot].obj[cache->slot[slot].num++] = p;
+}
+
+/******************************************************************************
+ **函数名称: slab_flush
+ **功    能: 归还本线程缓存的全部内存块
+ **输入参数:
+ **     pool: Slab对象
+ **输出参数:
+ **返    回: VOID
+ **实现描述:
+ **注意事项: 线程长时间不再使用该内存池时调用, 使其他线程能够申请到这些块
+ **作    者: # Qifeng.zou # 2015.08.24 #
+ ******************************************************************************/
+void slab_flush(slab_pool_t *pool)
+{
+    int slot;
+    slab_cache_t *cache;
+
+    if (!pool->cache.enable) {
+        return;
+    }
+
+    cache = (slab_cache_t *)pthread_getspecific(pool->cache.key);
+    if (NULL == cache) {
+        return;
+    }
+
+    for (slot=0; slot<SLAB_CACHE_CLASS; ++slot) {
+        slab_cache_flush(pool, cache, slot, cache->slot[slot].num);
+    }
+}
+
+/******************************************************************************
+ **函数名称: slab_cache_destroy
+ **功    能: 销毁全部线程缓存
+ **输入参数:
+ **     pool: Slab对象
+ **输出参数:
+ **返    回: VOID
+ **实现描述: 内存池即将释放, 缓存中的块无需归还
+ **注意事项: 调用者须保证其他线程已不再使用该内存池
+ **作    者: # Qifeng.zou # 2015.08.24 #
+ ******************************************************************************/
+void slab_cache_destroy(slab_pool_t *pool)
+{
+    slab_cache_t *cache, *next;
+
+    if (!pool->cache.enable) {
+        return;
+    }
+
+    pthread_key_delete(pool->cache.key);
+    for (cache = pool->cache.list; NULL != cache; cache = next) {
+        next = cache->next;
+        free(cache);
+    }
+    pool->cache.list = NULL;
+    pool->cache.enable = false;
+}
+
 /******************************************************************************
  **函数名称: slab_alloc_pages
  **功    能: 从Slab中申请一页内存
@@ -710,6 +1044,9 @@ slab_pool_t *slab_creat_by_calloc(size_t size, log_cycle_t *log)
         return NULL;
     }
 
+    /* > 启用线程缓存(失败时直接加锁操作) */
+    pool->cache.enable = (0 == pthread_key_create(&pool->cache.key, slab_cache_release));
+
     return pool;
 }
 #else /*__MEM_LEAK_CHECK__*/
@@ -717,6 +1054,8 @@ slab_pool_t *slab_init(void *addr, size_t size, log_cycle_t *log) { return callo
 void *slab_alloc(slab_pool_t *pool, size_t size) { return calloc(1, size); }
 void slab_dealloc(slab_pool_t *pool, void *p) { free(p); }
 slab_pool_t *slab_creat_by_calloc(size_t size, log_cycle_t *log) { return calloc(1, size); }
+void slab_flush(slab_pool_t *pool) { }
+void slab_cache_destroy(slab_pool_t *pool) { }
 #endif /*__MEM_LEAK_CHECK__*/
 
 /******************************************************************************
@@ -5,12 +5,16 @@
  ** 版本号: 1.0
  ** 描  述:
  **     通过环形队列实现内存的申请和回收
+ **     每个线程通过弹匣(slot_mag_t)缓存内存块, 与环形队列之间批量交换
  ** 作  者: # Qifeng.zou # Tue 05 May 2015 08:47:46 AM CST #
  ******************************************************************************/
 
 #include "comm.h"
+#include "redo.h"
 #include "slot.h"
 
+static void slot_mag_destroy(void *_mag);
+
 /******************************************************************************
  **函数名称: slot_creat
  **功    能: 创建内存池
@@ -20,7 +24,7 @@
  **输出参数: NONE
  **返    回: 内存池对象
  **实现描述:
- **注意事项:
+ **注意事项: 块数不少于SLOT_MAG_MIN时启用线程缓存
  **作    者: # Qifeng.zou # 2015.05.05 #
  ******************************************************************************/
 slot_t *slot_creat(int num, size_t size)
@@ -48,24 +52,142 @@ slot_t *slot_creat(int num, size_t size)
     addr = (void *)calloc(num, size);
     if (NULL == addr) {
         ring_destroy(slot->ring);
+        free(slot->ring);
         free(slot);
         return NULL;
     }
 
+    slot->addr = addr;
+
     /* > 插入管理队列 */
     ptr = addr;
     for (i=0; i<num; ++i, ptr += size) {
         if (ring_push(slot->ring, ptr)) {
             ring_destroy(slot->ring);
+            free(slot->ring);
             free(slot);
             free(addr);
             return NULL;
         }
     }
 
+    /* > 启用线程缓存(失败时直接操作环形队列) */
+    spin_lock_init(&slot->mag.lock);
+    if (num >= SLOT_MAG_MIN) {
+        slot->mag.enable = (0 == pthread_key_create(&slot->mag.key, slot_mag_destroy));
+    }
+
     return slot;
 }
 
+/******************************************************************************
+ **函数名称: slot_mag_get
+ **功    能: 获取当前线程的弹匣
+ **输入参数:
+ **     slot: 内存块对象
+ **输出参数: NONE
+ **返    回: 弹匣(NULL: 未启用线程缓存或创建失败)
+ **实现描述: 首次使用时创建弹匣, 并加入内存池的弹匣链表
+ **注意事项:
+ **作    者: # Qifeng.zou # 2015.08.13 #
+ ******************************************************************************/
+static inline slot_mag_t *slot_mag_get(slot_t *slot)
+{
+    slot_mag_t *mag;
+
+    if (!slot->mag.enable) {
+        return NULL;
+    }
+
+    mag = (slot_mag_t *)pthread_getspecific(slot->mag.key);
+    if (NULL != mag) {
+        return mag;
+    }
+
+    mag = (slot_mag_t *)memalign_alloc(64, sizeof(slot_mag_t));
+    if (NULL == mag) {
+        return NULL;
+    }
+
+    memset(mag, 0, sizeof(slot_mag_t));
+    mag->slot = slot;
+
+    if (pthread_setspecific(slot->mag.key, mag)) {
+        free(mag);
+        return NULL;
+    }
+
+    spin_lock(&slot->mag.lock);
+    mag->next = slot->mag.list;
+    if (NULL != slot->mag.list) {
+        slot->mag.list->prev = mag;
+    }
+    slot->mag.list = mag;
+    spin_unlock(&slot->mag.lock);
+
+    return mag;
+}
+
+/******************************************************************************
+ **函数名称: slot_mag_flush
+ **功    能: 将弹匣中前num个块归还环形队列
+ **输入参数:
+ **     slot: 内存块对象
+ **     mag: 弹匣
+ **     num: 归还块数
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述: 归还最早放入的块, 最近回收的块留在弹匣中(缓存较热)
+ **注意事项: 环形队列容量不小于块数, 归还不会失败
+ **作    者: # Qifeng.zou # 2015.08.13 #
+ ******************************************************************************/
+static void slot_mag_flush(slot_t *slot, slot_mag_t *mag, int num)
+{
+    int n, total = 0;
+
+    while (total < num) {
+        n = ring_push_burst(slot->ring, mag->cell + total, num - total);
+        if (n <= 0) {
+            break;
+        }
+        total += n;
+    }
+
+    mag->num -= total;
+    memmove(mag->cell, mag->cell + total, mag->num * sizeof(void *));
+}
+
+/******************************************************************************
+ **函数名称: slot_mag_destroy
+ **功    能: 销毁弹匣(线程退出时调用)
+ **输入参数:
+ **     _mag: 弹匣
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述: 归还全部缓存的块, 从弹匣链表中移除后释放
+ **注意事项:
+ **作    者: # Qifeng.zou # 2015.08.13 #
+ ******************************************************************************/
+static void slot_mag_destroy(void *_mag)
+{
+    slot_mag_t *mag = (slot_mag_t *)_mag;
+    slot_t *slot = mag->slot;
+
+    slot_mag_flush(slot, mag, mag->num);
+
+    spin_lock(&slot->mag.lock);
+    if (NULL != mag->prev) {
+        mag->prev->next = mag->next;
+    } else {
+        slot->mag.list = mag->next;
+    }
+    if (NULL != mag->next) {
+        mag->next->prev = mag->prev;
+    }
+    spin_unlock(&slot->mag.lock);
+
+    free(mag);
+}
 
 /******************************************************************************
  **函数名称: slot_alloc
@@ -76,16 +198,90 @@ slot_t *slot_creat(int num, size_t size)
  **输出参数: NONE
  **返    回: VOID
  **实现描述: 内存地址
+ **     优先从本线程的弹匣中取, 弹匣为空时从环形队列批量补充SLOT_MAG_BATCH个
  **注意事项: 当申请的空间超过内存块的大小时，返回NULL
  **作    者: # Qifeng.zou # 2015.05.05 #
  ******************************************************************************/
 void *slot_alloc(slot_t *slot, int size)
 {
+    slot_mag_t *mag;
+
     if (size > slot->size) {
         return NULL;
     }
 
-    return ring_pop(slot->ring);         /* 申请内存 */
+    mag = slot_mag_get(slot);
+    if (NULL == mag) {
+        return ring_pop(slot->ring);         /* 申请内存 */
+    }
+
+    if (0 == mag->num) {
+        mag->num = ring_pop_burst(slot->ring, mag->cell, SLOT_MAG_BATCH);
+        if (0 == mag->num) {
+            return NULL;
+        }
+    }
+
+    return mag->cell[--mag->num];
+}
+
+/******************************************************************************
+ **函数名称: slot_dealloc
+ **功    能: 回收内存块
+ **输入参数:
+ **     slot: 内存块对象
+ **     p: 内存块地址
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述:
+ **     放入本线程的弹匣, 弹匣满时将较早放入的SLOT_MAG_BATCH个批量归还环形队列
+ **注意事项: 内存块可由任意线程回收, 不要求与申请线程相同
+ **作    者: # Qifeng.zou # 2015.08.13 #
+ ******************************************************************************/
+void slot_dealloc(slot_t *slot, void *p)
+{
+    slot_mag_t *mag;
+
+    mag = slot_mag_get(slot);
+    if (NULL == mag) {
+        ring_push(slot->ring, p);
+        return;
+    }
+
+    if (SLOT_MAG_SIZE == mag->num) {
+        slot_mag_flush(slot, mag, SLOT_MAG_BATCH);
+        if (SLOT_MAG_SIZE == mag->num) {
+            ring_push(slot->ring, p);
+            return;
+        }
+    }
+
+    mag->cell[mag->num++] = p;
+}
+
+/******************************************************************************
+ **函数名称: slot_flush
+ **功    能: 归还本线程弹匣中的全部内存块
+ **输入参数:
+ **     slot: 内存块对象
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述:
+ **注意事项: 线程长时间不再使用该内存池时调用, 使其他线程能够申请到这些块
+ **作    者: # Qifeng.zou # 2015.08.13 #
+ ******************************************************************************/
+void slot_flush(slot_t *slot)
+{
+    slot_mag_t *mag;
+
+    if (!slot->mag.enable) {
+        return;
+    }
+
+    mag = (slot_mag_t *)pthread_getspecific(slot->mag.key);
+    if (NULL != mag) {
+        slot_mag_flush(slot, mag, mag->num);
+    }
 }
 
 /******************************************************************************
@@ -96,12 +292,23 @@ void *slot_alloc(slot_t *slot, int size)
  **输出参数: NONE
  **返    回: VOID
  **实现描述:
- **注意事项:
+ **注意事项: 调用者须保证其他线程已不再使用该内存池
  **作    者: # Qifeng.zou # 2015.05.05 #
  ******************************************************************************/
 void slot_destroy(slot_t *slot)
 {
+    slot_mag_t *mag, *next;
+
+    if (slot->mag.enable) {
+        pthread_key_delete(slot->mag.key);
+        for (mag = slot->mag.list; NULL != mag; mag = next) {
+            next = mag->next;
+            free(mag);
+        }
+    }
+
     ring_destroy(slot->ring);
+    free(slot->ring);
     free(slot->addr);
     free(slot);
 }
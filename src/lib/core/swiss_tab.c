@@ -0,0 +1,565 @@
+/******************************************************************************
+ ** Copyright(C) 2014-2024 Qiware technology Co., Ltd
+ **
+ ** 文件名: swiss_tab.c
+ ** 版本号: 1.0
+ ** 描  述: 开放寻址哈希表(Swiss table)
+ **         1. 数据地址直接存放在连续数组中, 插入时无需申请结点内存;
+ **         2. 以16个控制字节为一组, 通过SSE2一次完成整组的匹配;
+ **         3. 负载达到7/8时渐进式扩容.
+ ** 作  者: # Qifeng.zou # 2015.06.18 #
+ ******************************************************************************/
+#include "swiss_tab.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif /*__SSE2__*/
+
+/* 混合哈希值: 调用者的哈希函数可能较弱(如直接返回整数主键), 需打散各比特位 */
+static inline uint64_t swiss_mix(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+
+    return h;
+}
+
+#define SWISS_H1(h) ((h) >> 7)                  /* 定位组 */
+#define SWISS_H2(h) ((int8_t)((h) & 0x7F))      /* 控制字节 */
+#define SWISS_IS_FULL(c) ((c) >= 0)             /* 单元已占用 */
+
+#if defined(__SSE2__)
+/* 组内匹配控制字节为h2的单元(返回位图) */
+static inline uint32_t swiss_group_match(const int8_t *ctrl, int8_t h2)
+{
+    __m128i group = _mm_loadu_si128((const __m128i *)ctrl);
+
+    return (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), group));
+}
+
+/* 组内匹配空闲单元(返回位图) */
+static inline uint32_t swiss_group_match_empty(const int8_t *ctrl)
+{
+    return swiss_group_match(ctrl, SWISS_CTRL_EMPTY);
+}
+
+/* 组内匹配空闲或墓碑单元(返回位图: 最高位为1的控制字节) */
+static inline uint32_t swiss_group_match_free(const int8_t *ctrl)
+{
+    return (uint32_t)_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)ctrl));
+}
+#else /*!__SSE2__*/
+static inline uint32_t swiss_group_match(const int8_t *ctrl, int8_t h2)
+{
+    int idx;
+    uint32_t mask = 0;
+
+    for (idx=0; idx<SWISS_GROUP_WIDTH; ++idx) {
+        if (ctrl[idx] == h2) { mask |= (1 << idx); }
+    }
+    return mask;
+}
+
+static inline uint32_t swiss_group_match_empty(const int8_t *ctrl)
+{
+    return swiss_group_match(ctrl, SWISS_CTRL_EMPTY);
+}
+
+static inline uint32_t swiss_group_match_free(const int8_t *ctrl)
+{
+    int idx;
+    uint32_t mask = 0;
+
+    for (idx=0; idx<SWISS_GROUP_WIDTH; ++idx) {
+        if (!SWISS_IS_FULL(ctrl[idx])) { mask |= (1 << idx); }
+    }
+    return mask;
+}
+#endif /*!__SSE2__*/
+
+/******************************************************************************
+ **函数名称: swiss_arr_init
+ **功    能: 初始化单元数组
+ **输入参数:
+ **     tab: 哈希表
+ **     arr: 单元数组
+ **     cap: 容量
+ **输出参数: NONE
+ **返    回: 0:成功 !0:失败
+ **实现描述: 控制字节和数据地址使用同一块内存
+ **注意事项:
+ **作    者: # Qifeng.zou # 2015.06.18 #
+ ******************************************************************************/
+static int swiss_arr_init(swiss_tab_t *tab, swiss_arr_t *arr, size_t cap)
+{
+    void *addr;
+
+    addr = tab->alloc(tab->pool, cap * (sizeof(void *) + sizeof(int8_t)));
+    if (NULL == addr) {
+        return SWISS_ERR;
+    }
+
+    arr->cap = cap;
+    arr->num = 0;
+    arr->del = 0;
+    arr->slot = (void **)addr;
+    arr->ctrl = (int8_t *)(arr->slot + cap);
+    memset(arr->ctrl, SWISS_CTRL_EMPTY, cap);
+
+    return SWISS_OK;
+}
+
+/* 释放单元数组 */
+static void swiss_arr_free(swiss_tab_t *tab, swiss_arr_t *arr)
+{
+    if (arr->cap) {
+        tab->dealloc(tab->pool, arr->slot);
+    }
+    memset(arr, 0, sizeof(swiss_arr_t));
+}
+
+/******************************************************************************
+ **函数名称: swiss_arr_find
+ **功    能: 在单元数组中查找主键
+ **输入参数:
+ **     tab: 哈希表
+ **     arr: 单元数组
+ **     hval: 混合后的哈希值
+ **     key: 主键
+ **输出参数: NONE
+ **返    回: 单元索引(-1:未找到)
+ **实现描述: 按组二次探测, 遇到含有空闲单元的组时停止
+ **注意事项:
+ **作    者: # Qifeng.zou # 2015.06.18 #
+ ******************************************************************************/
+static ssize_t swiss_arr_find(swiss_tab_t *tab, swiss_arr_t *arr, uint64_t hval, void *key)
+{
+    int8_t *ctrl;
+    uint32_t mask;
+    size_t group, gmask, idx, pos;
+
+    if (0 == arr->cap) {
+        return -1;
+    }
+
+    gmask = arr->cap / SWISS_GROUP_WIDTH - 1;
+    group = SWISS_H1(hval) & gmask;
+
+    for (idx=0; idx<=gmask; ++idx) {
+        ctrl = arr->ctrl + group * SWISS_GROUP_WIDTH;
+
+        mask = swiss_group_match(ctrl, SWISS_H2(hval));
+        while (mask) {
+            pos = group * SWISS_GROUP_WIDTH + __builtin_ctz(mask);
+            if (0 == tab->cmp(key, arr->slot[pos])) {
+                return (ssize_t)pos;
+            }
+            mask &= mask - 1;
+        }
+
+        if (swiss_group_match_empty(ctrl)) {
+            return -1;
+        }
+
+        group = (group + idx + 1) & gmask; /* 三角数探测: 可遍历全部的组 */
+    }
+
+    return -1;
+}
+
+/* 查找可插入的单元(空闲或墓碑) */
+static size_t swiss_arr_find_free(swiss_arr_t *arr, uint64_t hval)
+{
+    uint32_t mask;
+    size_t group, gmask, idx;
+
+    gmask = arr->cap / SWISS_GROUP_WIDTH - 1;
+    group = SWISS_H1(hval) & gmask;
+
+    for (idx=0; idx<=gmask; ++idx) {
+        mask = swiss_group_match_free(arr->ctrl + group * SWISS_GROUP_WIDTH);
+        if (mask) {
+            return group * SWISS_GROUP_WIDTH + __builtin_ctz(mask);
+        }
+        group = (group + idx + 1) & gmask;
+    }
+
+    return (size_t)-1; /* 调用者保证负载不超过7/8, 不会执行到此处 */
+}
+
+/* 放入数据(调用者保证主键不存在) */
+static void swiss_arr_put(swiss_arr_t *arr, uint64_t hval, void *data)
+{
+    size_t pos;
+
+    pos = swiss_arr_find_free(arr, hval);
+    if (SWISS_CTRL_DELETED == arr->ctrl[pos]) {
+        --arr->del;
+    }
+    arr->ctrl[pos] = SWISS_H2(hval);
+    arr->slot[pos] = data;
+    ++arr->num;
+}
+
+/******************************************************************************
+ **函数名称: swiss_arr_erase
+ **功    能: 清除单元
+ **输入参数:
+ **     arr: 单元数组
+ **     pos: 单元索引
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述: 所在组仍有空闲单元时, 查找不会越过此组, 可直接置为空闲; 否则置为墓碑.
+ **注意事项:
+ **作    者: # Qifeng.zou # 2015.06.18 #
+ ******************************************************************************/
+static void swiss_arr_erase(swiss_arr_t *arr, size_t pos)
+{
+    int8_t *ctrl = arr->ctrl + (pos & ~(size_t)(SWISS_GROUP_WIDTH - 1));
+
+    if (swiss_group_match_empty(ctrl)) {
+        arr->ctrl[pos] = SWISS_CTRL_EMPTY;
+    }
+    else {
+        arr->ctrl[pos] = SWISS_CTRL_DELETED;
+        ++arr->del;
+    }
+    arr->slot[pos] = NULL;
+    --arr->num;
+}
+
+/******************************************************************************
+ **函数名称: swiss_tab_migrate
+ **功    能: 迁移旧数组中的数据
+ **输入参数:
+ **     tab: 哈希表
+ **     num: 本次最多检查的单元数
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述: 迁移完成后释放旧数组
+ **注意事项:
+ **作    者: # Qifeng.zou # 2015.06.18 #
+ ******************************************************************************/
+static void swiss_tab_migrate(swiss_tab_t *tab, size_t num)
+{
+    void *data;
+    swiss_arr_t *old = &tab->old;
+
+    for (; (num > 0) && (tab->mig < old->cap); --num, ++tab->mig) {
+        if (!SWISS_IS_FULL(old->ctrl[tab->mig])) {
+            continue;
+        }
+
+        data = old->slot[tab->mig];
+        swiss_arr_put(&tab->cur, swiss_mix(tab->hash(data)), data);
+
+        old->ctrl[tab->mig] = SWISS_CTRL_DELETED; /* 已迁移: 查找时越过此单元 */
+        old->slot[tab->mig] = NULL;
+        --old->num;
+    }
+
+    if (tab->mig >= old->cap) {
+        swiss_arr_free(tab, old);
+        tab->mig = 0;
+    }
+}
+
+/******************************************************************************
+ **函数名称: swiss_tab_grow
+ **功    能: 扩容
+ **输入参数:
+ **     tab: 哈希表
+ **输出参数: NONE
+ **返    回: 0:成功 !0:失败
+ **实现描述:
+ **     1. 若上次扩容尚未完成, 先完成迁移
+ **     2. 墓碑较多时按原容量重建, 否则容量翻倍
+ **     3. 当前数组转为旧数组, 由后续的插入/删除操作逐步迁移
+ **注意事项:
+ **作    者: # Qifeng.zou # 2015.06.18 #
+ ******************************************************************************/
+static int swiss_tab_grow(swiss_tab_t *tab)
+{
+    size_t cap;
+    swiss_arr_t arr;
+
+    if (tab->old.cap) {
+        swiss_tab_migrate(tab, tab->old.cap);
+    }
+
+    cap = (tab->cur.num >= tab->cur.cap * 7 / 16)? 2 * tab->cur.cap : tab->cur.cap;
+
+    if (swiss_arr_init(tab, &arr, cap)) {
+        return SWISS_ERR;
+    }
+
+    tab->old = tab->cur;
+    tab->cur = arr;
+    tab->mig = 0;
+
+    return SWISS_OK;
+}
+
+/******************************************************************************
+ **函数名称: swiss_tab_creat
+ **功    能: 创建哈希表
+ **输入参数:
+ **     cap: 初始容量
+ **     hash: 生成哈希值的函数
+ **     cmp: 数据比较函数
+ **     opt: 其他选项
+ **输出参数: NONE
+ **返    回: 哈希表
+ **实现描述:
+ **注意事项: 容量将被调整为SWISS_GROUP_WIDTH的2^n倍
+ **作    者: # Qifeng.zou # 2015.06.18 #
+ ******************************************************************************/
+swiss_tab_t *swiss_tab_creat(size_t cap, hash_cb_t hash, cmp_cb_t cmp, swiss_opt_t *opt)
+{
+    size_t size = SWISS_MIN_CAP;
+    swiss_tab_t *tab;
+    swiss_opt_t _opt;
+
+    if (NULL == opt) {
+        _opt.pool = (void *)NULL;
+        _opt.alloc = (mem_alloc_cb_t)mem_alloc;
+        _opt.dealloc = (mem_dealloc_cb_t)mem_dealloc;
+        opt = &_opt;
+    }
+
+    tab = (swiss_tab_t *)opt->alloc(opt->pool, sizeof(swiss_tab_t));
+    if (NULL == tab) {
+        return NULL;
+    }
+
+    memset(tab, 0, sizeof(swiss_tab_t));
+
+    tab->cmp = cmp;
+    tab->hash = hash;
+    tab->pool = opt->pool;
+    tab->alloc = opt->alloc;
+    tab->dealloc = opt->dealloc;
+
+    while (size < cap) {
+        size <<= 1;
+    }
+
+    if (swiss_arr_init(tab, &tab->cur, size)) {
+        opt->dealloc(opt->pool, tab);
+        return NULL;
+    }
+
+    return tab;
+}
+
+/******************************************************************************
+ **函数名称: swiss_tab_insert_ex
+ **功    能: 插入数据(哈希值由调用者计算)
+ **输入参数:
+ **     tab: 哈希表
+ **     hval: 哈希值(注: 必须与tab->hash(data)一致)
+ **     data: 数据(含主键)
+ **输出参数: NONE
+ **返    回: SWISS_OK:成功 SWISS_NODE_EXIST:已存在 SWISS_ERR:失败
+ **实现描述:
+ **注意事项:
+ **作    者: # Qifeng.zou # 2015.06.18 #
+ ******************************************************************************/
+int swiss_tab_insert_ex(swiss_tab_t *tab, uint64_t hval, void *data)
+{
+    hval = swiss_mix(hval);
+
+    if (tab->old.cap) {
+        swiss_tab_migrate(tab, SWISS_MIGRATE_NUM);
+    }
+
+    /* > 判断是否已存在 */
+    if ((swiss_arr_find(tab, &tab->cur, hval, data) >= 0)
+        || (swiss_arr_find(tab, &tab->old, hval, data) >= 0))
+    {
+        return SWISS_NODE_EXIST;
+    }
+
+    /* > 负载超过7/8时扩容 */
+    if ((tab->cur.num + tab->cur.del + 1) * 8 > tab->cur.cap * 7) {
+        if (swiss_tab_grow(tab)) {
+            return SWISS_ERR;
+        }
+    }
+
+    swiss_arr_put(&tab->cur, hval, data);
+    ++tab->total;
+
+    return SWISS_OK;
+}
+
+/******************************************************************************
+ **函数名称: swiss_tab_query_ex
+ **功    能: 查询数据(哈希值由调用者计算)
+ **输入参数:
+ **     tab: 哈希表
+ **     hval: 哈希值(注: 必须与tab->hash(key)一致)
+ **     key: 主键
+ **输出参数: NONE
+ **返    回: 数据地址
+ **实现描述: 迁移期间需同时查找当前数组和旧数组
+ **注意事项: 查询不改变哈希表结构, 可在读锁保护下并发调用
+ **作    者: # Qifeng.zou # 2015.06.18 #
+ ******************************************************************************/
+void *swiss_tab_query_ex(swiss_tab_t *tab, uint64_t hval, void *key)
+{
+    ssize_t pos;
+
+    hval = swiss_mix(hval);
+
+    pos = swiss_arr_find(tab, &tab->cur, hval, key);
+    if (pos >= 0) {
+        return tab->cur.slot[pos];
+    }
+
+    pos = swiss_arr_find(tab, &tab->old, hval, key);
+    if (pos >= 0) {
+        return tab->old.slot[pos];
+    }
+
+    return NULL;
+}
+
+/******************************************************************************
+ **函数名称: swiss_tab_delete_ex
+ **功    能: 删除数据(哈希值由调用者计算)
+ **输入参数:
+ **     tab: 哈希表
+ **     hval: 哈希值(注: 必须与tab->hash(key)一致)
+ **     key: 主键
+ **输出参数: NONE
+ **返    回: 数据地址
+ **实现描述:
+ **注意事项: 返回地址的内存空间由外部释放
+ **作    者: # Qifeng.zou # 2015.06.18 #
+ ******************************************************************************/
+void *swiss_tab_delete_ex(swiss_tab_t *tab, uint64_t hval, void *key)
+{
+    void *data;
+    ssize_t pos;
+
+    hval = swiss_mix(hval);
+
+    if (tab->old.cap) {
+        swiss_tab_migrate(tab, SWISS_MIGRATE_NUM);
+    }
+
+    pos = swiss_arr_find(tab, &tab->cur, hval, key);
+    if (pos >= 0) {
+        data = tab->cur.slot[pos];
+        swiss_arr_erase(&tab->cur, pos);
+        --tab->total;
+        return data;
+    }
+
+    pos = swiss_arr_find(tab, &tab->old, hval, key);
+    if (pos >= 0) {
+        data = tab->old.slot[pos];
+        swiss_arr_erase(&tab->old, pos);
+        --tab->total;
+        return data;
+    }
+
+    return NULL;
+}
+
+/* 插入数据 */
+int swiss_tab_insert(swiss_tab_t *tab, void *data)
+{
+    return swiss_tab_insert_ex(tab, tab->hash(data), data);
+}
+
+/* 查询数据 */
+void *swiss_tab_query(swiss_tab_t *tab, void *key)
+{
+    return swiss_tab_query_ex(tab, tab->hash(key), key);
+}
+
+/* 删除数据 */
+void *swiss_tab_delete(swiss_tab_t *tab, void *key)
+{
+    return swiss_tab_delete_ex(tab, tab->hash(key), key);
+}
+
+/******************************************************************************
+ **函数名称: swiss_tab_trav
+ **功    能: 遍历哈希表
+ **输入参数:
+ **     tab: 哈希表
+ **     proc: 回调函数
+ **     args: 附加参数
+ **输出参数: NONE
+ **返    回: 0:成功 !0:失败
+ **实现描述:
+ **注意事项: 回调函数proc()中禁止插入或删除数据
+ **作    者: # Qifeng.zou # 2015.06.18 #
+ ******************************************************************************/
+int swiss_tab_trav(swiss_tab_t *tab, trav_cb_t proc, void *args)
+{
+    size_t idx;
+
+    for (idx=0; idx<tab->cur.cap; ++idx) {
+        if (SWISS_IS_FULL(tab->cur.ctrl[idx])) {
+            proc(tab->cur.slot[idx], args);
+        }
+    }
+
+    for (idx=tab->mig; idx<tab->old.cap; ++idx) {
+        if (SWISS_IS_FULL(tab->old.ctrl[idx])) {
+            proc(tab->old.slot[idx], args);
+        }
+    }
+
+    return 0;
+}
+
+/* 获取哈希表占用的内存(不含数据本身) */
+size_t swiss_tab_mem_size(swiss_tab_t *tab)
+{
+    return sizeof(swiss_tab_t)
+        + (tab->cur.cap + tab->old.cap) * (sizeof(void *) + sizeof(int8_t));
+}
+
+/******************************************************************************
+ **函数名称: swiss_tab_destroy
+ **功    能: 销毁哈希表
+ **输入参数:
+ **     tab: 哈希表
+ **     dealloc: 数据释放回调
+ **     args: 附加参数
+ **输出参数: NONE
+ **返    回: 0:成功 !0:失败
+ **实现描述:
+ **注意事项:
+ **作    者: # Qifeng.zou # 2015.06.18 #
+ ******************************************************************************/
+int swiss_tab_destroy(swiss_tab_t *tab, mem_dealloc_cb_t dealloc, void *args)
+{
+    size_t idx;
+
+    for (idx=0; idx<tab->cur.cap; ++idx) {
+        if (SWISS_IS_FULL(tab->cur.ctrl[idx])) {
+            dealloc(args, tab->cur.slot[idx]);
+        }
+    }
+
+    for (idx=tab->mig; idx<tab->old.cap; ++idx) {
+        if (SWISS_IS_FULL(tab->old.ctrl[idx])) {
+            dealloc(args, tab->old.slot[idx]);
+        }
+    }
+
+    swiss_arr_free(tab, &tab->cur);
+    swiss_arr_free(tab, &tab->old);
+    tab->dealloc(tab->pool, tab);
+
+    return 0;
+}
@@ -6,11 +6,18 @@
  ** 描  述: 线程池模块的实现.
  **         通过线程池模块, 可有效的简化多线程编程的处理, 加快开发速度, 同时有
  **         效增强模块的复用性和程序的稳定性。
+ **         每个线程拥有独立的任务队列, 空闲线程从其他线程窃取任务.
  ** 作  者: # Qifeng.zou # 2012.12.26 #
  ******************************************************************************/
+#include "atomic.h"
 #include "thread_pool.h"
 
-static void *thread_routine(void *_tpool);
+#define THREAD_POOL_DEQUE_MASK  (THREAD_POOL_DEQUE_SIZE - 1)
+
+/* 当前线程在所属线程池中的信息(非池内线程为NULL) */
+static __thread thread_pool_thd_t *g_thread_pool_self = NULL;
+
+static void *thread_routine(void *_thd);
 
 /******************************************************************************
  **函数名称: thread_pool_init
@@ -31,6 +38,7 @@ thread_pool_t *thread_pool_init(int num, const thread_pool_opt_t *opt, void *arg
 {
     int idx;
     thread_pool_t *tpool;
+    thread_pool_thd_t *thd;
     thread_pool_opt_t _opt;
 
     if (NULL == opt) {
@@ -47,12 +55,10 @@ thread_pool_t *thread_pool_init(int num, const thread_pool_opt_t *opt, void *arg
         return NULL;
     }
 
-    pthread_mutex_init(&(tpool->queue_lock), NULL);
-    pthread_cond_init(&(tpool->queue_ready), NULL);
-    tpool->head = NULL;
-    tpool->queue_size = 0;
-    tpool->shutdown = 0;
+    memset(tpool, 0, sizeof(thread_pool_t));
+
     tpool->data = (void *)args;
+    event_count_init(&tpool->ready);
 
     tpool->mem_pool = opt->pool;
     tpool->alloc = opt->alloc;
@@ -64,9 +70,32 @@ thread_pool_t *thread_pool_init(int num, const thread_pool_opt_t *opt, void *arg
         return NULL;
     }
 
+    tpool->thd = (thread_pool_thd_t *)tpool->alloc(tpool->mem_pool, num*sizeof(thread_pool_thd_t));
+    if (NULL == tpool->thd) {
+        opt->dealloc(opt->pool, tpool->tid);
+        opt->dealloc(opt->pool, tpool);
+        return NULL;
+    }
+
+    for (idx=0; idx<num; ++idx) {
+        thd = &tpool->thd[idx];
+
+        thd->deque.top = 0;
+        thd->deque.bottom = 0;
+        spin_lock_init(&thd->inject.lock);
+        thd->inject.num = 0;
+        thd->inject.head = NULL;
+        thd->inject.tail = NULL;
+        thd->idx = idx;
+        thd->seed = (uint32_t)(idx + 1) * 2654435761U;
+        thd->tpool = tpool;
+    }
+
     /* 2. 创建指定数目的线程 */
     for (idx=0; idx<num; ++idx) {
-        if (thread_creat(&tpool->tid[idx], thread_routine, tpool)) {
+        atomic32_inc(&tpool->alive);
+        if (thread_creat(&tpool->tid[idx], thread_routine, &tpool->thd[idx])) {
+            atomic32_dec(&tpool->alive);
             thread_pool_destroy(tpool);
             return NULL;
         }
@@ -76,6 +105,291 @@ thread_pool_t *thread_pool_init(int num, const thread_pool_opt_t *opt, void *arg
     return tpool;
 }
 
+/******************************************************************************
+ **函数名称: thread_pool_deque_push
+ **功    能: 将任务压入本线程双端队列的bottom端
+ **输入参数:
+ **     thd: 本线程
+ **     worker: 任务
+ **输出参数:
+ **返    回: 0:成功 !0:队列已满
+ **实现描述: 先写入任务, 再发布bottom(x86写写不重排, 仅需编译器屏障)
+ **注意事项: 只能由所属线程调用
+ **作    者: # Qifeng.zou # 2015.09.08 #
+ ******************************************************************************/
+static int thread_pool_deque_push(thread_pool_thd_t *thd, thread_worker_t *worker)
+{
+    uint64_t b = thd->deque.bottom, t = thd->deque.top;
+
+    if (b - t >= THREAD_POOL_DEQUE_SIZE) {
+        return -1;
+    }
+
+    thd->deque.task[b & THREAD_POOL_DEQUE_MASK] = worker;
+    compiler_barrier();
+    thd->deque.bottom = b + 1;
+
+    return 0;
+}
+
+/******************************************************************************
+ **函数名称: thread_pool_deque_pop
+ **功    能: 从本线程双端队列的bottom端弹出任务(后进先出)
+ **输入参数:
+ **     thd: 本线程
+ **输出参数:
+ **返    回: 任务(NULL:队列为空)
+ **实现描述:
+ **     1. 先将bottom减1(xchg带全屏障), 再读取top, 保证与窃取者互相可见;
+ **     2. 只剩最后一个任务时, 与窃取者通过CAS(top)竞争.
+ **注意事项: 只能由所属线程调用
+ **作    者: # Qifeng.zou # 2015.09.08 #
+ ******************************************************************************/
+static thread_worker_t *thread_pool_deque_pop(thread_pool_thd_t *thd)
+{
+    uint64_t b, t;
+    thread_worker_t *worker;
+
+    b = thd->deque.bottom - 1;
+    atomic64_xset(&thd->deque.bottom, b);
+    t = thd->deque.top;
+
+    if ((int64_t)(b - t) < 0) {
+        thd->deque.bottom = t; /* 队列为空 */
+        return NULL;
+    }
+
+    worker = thd->deque.task[b & THREAD_POOL_DEQUE_MASK];
+    if ((int64_t)(b - t) > 0) {
+        return worker;
+    }
+
+    /* > 最后一个任务: 与窃取者竞争 */
+    if (!atomic64_cmp_and_set(&thd->deque.top, t, t + 1)) {
+        worker = NULL;
+    }
+    thd->deque.bottom = t + 1;
+
+    return worker;
+}
+
+/******************************************************************************
+ **函数名称: thread_pool_deque_steal
+ **功    能: 从其他线程双端队列的top端窃取任务(先进先出)
+ **输入参数:
+ **     thd: 被窃取的线程
+ **输出参数:
+ **返    回: 任务(NULL:队列为空或竞争失败)
+ **实现描述: 先读top再读bottom, 通过CAS(top)确认任务归属
+ **注意事项:
+ **作    者: # Qifeng.zou # 2015.09.08 #
+ ******************************************************************************/
+static thread_worker_t *thread_pool_deque_steal(thread_pool_thd_t *thd)
+{
+    uint64_t b, t;
+    thread_worker_t *worker;
+
+    t = thd->deque.top;
+    compiler_barrier();
+    b = thd->deque.bottom;
+
+    if ((int64_t)(b - t) <= 0) {
+        return NULL;
+    }
+
+    worker = thd->deque.task[t & THREAD_POOL_DEQUE_MASK];
+    if (!atomic64_cmp_and_set(&thd->deque.top, t, t + 1)) {
+        return NULL;
+    }
+
+    return worker;
+}
+
+/******************************************************************************
+ **函数名称: thread_pool_inject
+ **功    能: 将任务放入指定线程的注入队列
+ **输入参数:
+ **     thd: 指定线程
+ **     worker: 任务
+ **输出参数:
+ **返    回: VOID
+ **实现描述: 维护尾指针, 追加为O(1)
+ **注意事项:
+ **作    者: # Qifeng.zou # 2015.09.08 #
+ ******************************************************************************/
+static void thread_pool_inject(thread_pool_thd_t *thd, thread_worker_t *worker)
+{
+    worker->next = NULL;
+
+    spin_lock(&thd->inject.lock);
+    if (NULL == thd->inject.tail) {
+        thd->inject.head = worker;
+    } else {
+        thd->inject.tail->next = worker;
+    }
+    thd->inject.tail = worker;
+    ++thd->inject.num;
+    spin_unlock(&thd->inject.lock);
+}
+
+/******************************************************************************
+ **函数名称: thread_pool_inject_take
+ **功    能: 取走指定线程注入队列中的全部任务
+ **输入参数:
+ **     thd: 指定线程
+ **输出参数:
+ **返    回: 任务链表(NULL:队列为空)
+ **实现描述: 先无锁判断是否为空, 避免空闲线程反复争抢自旋锁
+ **注意事项:
+ **作    者: # Qifeng.zou # 2015.09.08 #
+ ******************************************************************************/
+static thread_worker_t *thread_pool_inject_take(thread_pool_thd_t *thd)
+{
+    thread_worker_t *head;
+
+    if (0 == thd->inject.num) {
+        return NULL;
+    }
+
+    spin_lock(&thd->inject.lock);
+    head = thd->inject.head;
+    thd->inject.head = NULL;
+    thd->inject.tail = NULL;
+    thd->inject.num = 0;
+    spin_unlock(&thd->inject.lock);
+
+    return head;
+}
+
+/******************************************************************************
+ **函数名称: thread_pool_load
+ **功    能: 将任务链表装入本线程的双端队列
+ **输入参数:
+ **     thd: 本线程
+ **     head: 任务链表
+ **输出参数:
+ **返    回: 链表中的第一个任务(由调用者直接执行)
+ **实现描述: 其余任务压入双端队列, 以便其他线程窃取; 队列已满时放回注入队列
+ **注意事项:
+ **作    者: # Qifeng.zou # 2015.09.08 #
+ ******************************************************************************/
+static thread_worker_t *thread_pool_load(thread_pool_thd_t *thd, thread_worker_t *head)
+{
+    thread_worker_t *worker, *next;
+
+    for (worker = head->next; NULL != worker; worker = next) {
+        next = worker->next;
+        if (thread_pool_deque_push(thd, worker)) {
+            thread_pool_inject(thd, worker);
+        }
+    }
+
+    return head;
+}
+
+/******************************************************************************
+ **函数名称: thread_pool_get_task
+ **功    能: 获取待处理任务
+ **输入参数:
+ **     thd: 本线程
+ **输出参数:
+ **返    回: 任务(NULL:暂无任务)
+ **实现描述:
+ **     1. 弹出本线程双端队列中的任务
+ **     2. 取走本线程注入队列中的任务
+ **     3. 从随机位置开始, 依次窃取其他线程的任务
+ **注意事项:
+ **作    者: # Qifeng.zou # 2015.09.08 #
+ ******************************************************************************/
+static thread_worker_t *thread_pool_get_task(thread_pool_thd_t *thd)
+{
+    int idx, num;
+    thread_worker_t *worker;
+    thread_pool_thd_t *victim;
+    thread_pool_t *tpool = thd->tpool;
+
+    /* > 本线程双端队列 */
+    worker = thread_pool_deque_pop(thd);
+    if (NULL != worker) {
+        return worker;
+    }
+
+    /* > 本线程注入队列 */
+    worker = thread_pool_inject_take(thd);
+    if (NULL != worker) {
+        return thread_pool_load(thd, worker);
+    }
+
+    /* > 窃取其他线程的任务 */
+    thd->seed ^= thd->seed << 13;
+    thd->seed ^= thd->seed >> 17;
+    thd->seed ^= thd->seed << 5;
+
+    num = tpool->num;
+    for (idx=0; idx<num; ++idx) {
+        victim = &tpool->thd[(thd->seed + idx) % num];
+        if (victim == thd) {
+            continue;
+        }
+
+        worker = thread_pool_deque_steal(victim);
+        if (NULL != worker) {
+            return worker;
+        }
+
+        worker = thread_pool_inject_take(victim);
+        if (NULL != worker) {
+            return thread_pool_load(thd, worker);
+        }
+    }
+
+    return NULL;
+}
+
+/******************************************************************************
+ **函数名称: thread_pool_has_task
+ **功    能: 判断线程池中是否有待处理任务
+ **输入参数:
+ **     tpool: 线程池
+ **输出参数:
+ **返    回: true:有 false:无
+ **实现描述:
+ **注意事项:
+ **作    者: # Qifeng.zou # 2015.09.08 #
+ ******************************************************************************/
+static bool thread_pool_has_task(thread_pool_t *tpool)
+{
+    int idx;
+    thread_pool_thd_t *thd;
+
+    for (idx=0; idx<tpool->num; ++idx) {
+        thd = &tpool->thd[idx];
+        if ((int64_t)(thd->deque.bottom - thd->deque.top) > 0
+            || thd->inject.num > 0)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/******************************************************************************
+ **函数名称: thread_pool_wakeup
+ **功    能: 唤醒一个休眠的线程
+ **输入参数:
+ **     tpool: 线程池
+ **输出参数:
+ **返    回: VOID
+ **实现描述: 见event_count.h, 无休眠线程时不做系统调用
+ **注意事项: 须在任务发布之后调用
+ **作    者: # Qifeng.zou # 2015.09.08 #
+ ******************************************************************************/
+static void thread_pool_wakeup(thread_pool_t *tpool)
+{
+    event_count_notify(&tpool->ready);
+}
+
 /******************************************************************************
  **函数名称: thread_pool_add_worker
  **功    能: 注册处理任务(回调函数)
@@ -87,14 +401,15 @@ thread_pool_t *thread_pool_init(int num, const thread_pool_opt_t *opt, void *arg
  **返    回: 0:成功 !0:失败
  **实现描述:
  **     1. 新建任务结点
- **     2. 将回调函数加入工作队列
- **     3. 唤醒正在等待的线程
+ **     2. 池内线程提交的任务压入本线程双端队列, 否则按轮转放入注入队列
+ **     3. 唤醒正在休眠的线程
  **注意事项:
  **作    者: # Qifeng.zou # 2012.12.26 #
  ******************************************************************************/
 int thread_pool_add_worker(thread_pool_t *tpool, void *(*process)(void *arg), void *arg)
 {
-    thread_worker_t *worker, *member;
+    thread_worker_t *worker;
+    thread_pool_thd_t *self = g_thread_pool_self;
 
     /* 1. 新建任务节点 */
     worker = (thread_worker_t*)tpool->alloc(tpool->mem_pool, sizeof(thread_worker_t));
@@ -107,24 +422,16 @@ int thread_pool_add_worker(thread_pool_t *tpool, void *(*process)(void *arg), vo
     worker->next = NULL;
 
     /* 2. 将回调函数加入工作队列 */
-    pthread_mutex_lock(&(tpool->queue_lock));
-
-    member = tpool->head;
-    if (NULL != member) {
-        while (NULL != member->next) {
-            member = member->next;
+    if ((NULL != self) && (self->tpool == tpool)) {
+        if (thread_pool_deque_push(self, worker)) {
+            thread_pool_inject(self, worker);
         }
-        member->next = worker;
     } else {
-        tpool->head = worker;
+        thread_pool_inject(&tpool->thd[atomic32_xinc(&tpool->rr) % tpool->num], worker);
     }
 
-    tpool->queue_size++;
-
-    pthread_mutex_unlock(&(tpool->queue_lock));
-
     /* 3. 唤醒正在等待的线程 */
-    pthread_cond_signal(&(tpool->queue_ready));
+    thread_pool_wakeup(tpool);
 
     return 0;
 }
@@ -150,7 +457,9 @@ int thread_pool_keepalive(thread_pool_t *tpool)
 
     for (idx=0; idx<tpool->num; idx++) {
         if (ESRCH == pthread_kill(tpool->tid[idx], 0)) {
-            if (thread_creat(&tpool->tid[idx], thread_routine, tpool) < 0) {
+            atomic32_inc(&tpool->alive);
+            if (thread_creat(&tpool->tid[idx], thread_routine, &tpool->thd[idx]) < 0) {
+                atomic32_dec(&tpool->alive);
                 return -1;
             }
         }
@@ -165,20 +474,17 @@ int thread_pool_keepalive(thread_pool_t *tpool)
  **输入参数:
  **     tpool: 线程池
  **输出参数:
- **返    回: 线程序列号
- **实现描述:
+ **返    回: 线程序列号(-1:非该线程池的线程)
+ **实现描述: 线程启动时记录在线程本地变量中, O(1)
  **注意事项:
  **作    者: # Qifeng.zou # 2012.12.26 #
  ******************************************************************************/
 int thread_pool_get_tidx(thread_pool_t *tpool)
 {
-    int idx;
-    pthread_t tid = pthread_self();
+    thread_pool_thd_t *self = g_thread_pool_self;
 
-    for (idx=0; idx<tpool->num; ++idx) {
-        if (tpool->tid[idx] == tid) {
-            return idx;
-        }
+    if ((NULL != self) && (self->tpool == tpool)) {
+        return self->idx;
     }
 
     return -1;
@@ -192,27 +498,24 @@ int thread_pool_get_tidx(thread_pool_t *tpool)
  **输出参数:
  **返    回: 0:成功 !0:失败
  **实现描述:
- **     1. 设置销毁标志
- **     2. 唤醒所有线程
+ **     1. 取消正在执行任务的线程
+ **     2. 设置销毁标志, 唤醒所有线程
  **     3. 等待所有线程结束
- **注意事项:
+ **     4. 释放未处理的任务及线程池
+ **注意事项: 任务长时间不经过取消点时, 线程池空间将不被释放, 以免线程访问非法内存
  **作    者: # Qifeng.zou # 2012.12.26 #
  ******************************************************************************/
 int thread_pool_destroy(thread_pool_t *tpool)
 {
-    int idx;
+    int idx, wait;
+    thread_pool_thd_t *thd;
+    thread_worker_t *worker, *next;
 
     if (0 != tpool->shutdown) {
         return -1;
     }
 
-    /* 1. 设置销毁标志 */
-    tpool->shutdown = 1;
-
-    /* 2. 唤醒所有等待的线程 */
-    pthread_cond_broadcast(&(tpool->queue_ready));
-
-    /* 3. 等待线程结束 */
+    /* 1. 取消正在执行任务的线程(空闲线程不经过取消点, 由销毁标志唤醒退出) */
     for (idx=0; idx<tpool->num; ++idx) {
         if (ESRCH == pthread_kill(tpool->tid[idx], 0)) {
             continue;
@@ -220,55 +523,99 @@ int thread_pool_destroy(thread_pool_t *tpool)
         pthread_cancel(tpool->tid[idx]);
     }
 
-    pthread_mutex_destroy(&(tpool->queue_lock));
-    pthread_cond_destroy(&(tpool->queue_ready));
+    /* 2. 设置销毁标志, 并唤醒所有等待的线程 */
+    tpool->shutdown = 1;
+    event_count_notify_all(&tpool->ready);
+
+    /* 3. 等待线程结束 */
+    for (wait=0; (0 != tpool->alive) && (wait < 1000); ++wait) {
+        usleep(1000);
+    }
+
+    if (0 != tpool->alive) {
+        return 0;
+    }
+
+    /* 4. 释放未处理的任务 */
+    for (idx=0; idx<tpool->num; ++idx) {
+        thd = &tpool->thd[idx];
+        while (NULL != (worker = thread_pool_deque_pop(thd))) {
+            tpool->dealloc(tpool->mem_pool, worker);
+        }
+        for (worker = thd->inject.head; NULL != worker; worker = next) {
+            next = worker->next;
+            tpool->dealloc(tpool->mem_pool, worker);
+        }
+    }
+
+    tpool->dealloc(tpool->mem_pool, tpool->thd);
+    tpool->dealloc(tpool->mem_pool, tpool->tid);
     tpool->dealloc(tpool->mem_pool, tpool);
 
     return 0;
 }
 
+/* 线程退出回调(正常退出或被取消) */
+static void thread_routine_exit(void *_tpool)
+{
+    thread_pool_t *tpool = (thread_pool_t *)_tpool;
+
+    g_thread_pool_self = NULL;
+    atomic32_dec(&tpool->alive);
+}
+
 /******************************************************************************
  **函数名称: thread_routine
  **功    能: 线程运行函数
  **输入参数:
- **     _tpool: 线程池
+ **     _thd: 池内线程
  **输出参数:
  **返    回: VOID *
  **实现描述:
- **     判断是否有任务: 如无, 则等待; 如有, 则处理.
+ **     判断是否有任务: 如有, 则处理; 如无, 则先自旋THREAD_POOL_SPIN_NUM轮, 仍无
+ **     任务时在futex上休眠, 直至有新任务或线程池销毁.
  **注意事项:
  **作    者: # Qifeng.zou # 2014.04.18 #
  ******************************************************************************/
-static void *thread_routine(void *_tpool)
+static void *thread_routine(void *_thd)
 {
+    int spin = 0;
+    uint32_t key;
     thread_worker_t *worker;
-    thread_pool_t *tpool = (thread_pool_t*)_tpool;
+    thread_pool_thd_t *thd = (thread_pool_thd_t *)_thd;
+    thread_pool_t *tpool = thd->tpool;
 
-    while (1) {
-        pthread_mutex_lock(&(tpool->queue_lock));
-        while ((0 == tpool->shutdown)
-            && (0 == tpool->queue_size))
-        {
-            pthread_cond_wait(&(tpool->queue_ready), &(tpool->queue_lock));
-        }
+    g_thread_pool_self = thd;
 
-        if (0 != tpool->shutdown) {
-            pthread_mutex_unlock(&(tpool->queue_lock));
-            pthread_exit(NULL);
-        }
+    pthread_cleanup_push(thread_routine_exit, tpool);
 
-        tpool->queue_size--;
-        worker = tpool->head;
-        tpool->head = worker->next;
-        pthread_mutex_unlock(&(tpool->queue_lock));
+    while (0 == tpool->shutdown) {
+        worker = thread_pool_get_task(thd);
+        if (NULL != worker) {
+            (*(worker->process))(worker->arg);
+            tpool->dealloc(tpool->mem_pool, worker);
+            spin = 0;
+            continue;
+        }
 
-        (*(worker->process))(worker->arg);
+        if (++spin < THREAD_POOL_SPIN_NUM) {
+            cpu_relax();
+            continue;
+        }
 
-        pthread_mutex_lock(&(tpool->queue_lock));
-        tpool->dealloc(tpool->mem_pool, worker);
-        pthread_mutex_unlock(&(tpool->queue_lock));
+        /* > 休眠: 先登记再检查, 与thread_pool_wakeup()配合避免丢失唤醒 */
+        key = event_count_prepare(&tpool->ready);
+        if (!thread_pool_has_task(tpool) && (0 == tpool->shutdown)) {
+            event_count_wait(&tpool->ready, key, -1);
+        }
+        else {
+            event_count_cancel(&tpool->ready);
+        }
+        spin = 0;
     }
 
+    pthread_cleanup_pop(1);
+
     return NULL;
 }
 
@@ -2,10 +2,7 @@
 #include "redo.h"
 #include "timer.h"
 
-static int64_t timer_item_cmp_cb(timer_task_t *item1, timer_task_t *item2)
-{
-    return (int64_t)(item1->ttl - item2->ttl);
-}
+static void timer_task_expire_cb(timer_task_t *task);
 
 /******************************************************************************
  **函数名称: timer_cntx_init
@@ -13,29 +10,30 @@ static int64_t timer_item_cmp_cb(timer_task_t *item1, timer_task_t *item2)
  **输入参数: NONE
  **输出参数: NONE
  **返    回: 上下文对象
- **实现描述:
+ **实现描述: 任务由时间轮管理, 毫秒级精度
  **注意事项:
  **作    者: # Qifeng.zou # 2016.12.28 16:04:41 #
  ******************************************************************************/
 timer_cntx_t *timer_cntx_init(void)
 {
     timer_cntx_t *ctx;
+    pthread_mutexattr_t attr;
 
     ctx = (timer_cntx_t *)calloc(1, sizeof(timer_cntx_t));
     if (NULL == ctx) {
         return NULL;
     }
 
-    ctx->e = (void **)calloc(TIMER_CAP, sizeof(void *));
-    if (NULL == ctx->e) {
+    ctx->wheel = timer_wheel_creat(TIMER_WHEEL_TICK_US);
+    if (NULL == ctx->wheel) {
         free(ctx);
         return NULL;
     }
 
-    ctx->len = 0;
-    ctx->cap = TIMER_CAP;
-    ctx->cmp = (cmp_cb_t)timer_item_cmp_cb;
-    pthread_rwlock_init(&ctx->lock, NULL);
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE);
+    pthread_mutex_init(&ctx->lock, &attr);
+    pthread_mutexattr_destroy(&attr);
 
     return ctx;
 }
@@ -43,10 +41,9 @@ timer_cntx_t *timer_cntx_init(void)
 /******************************************************************************
  **函数名称: timer_task_init
  **功    能: 初始化定时器
- **输入参数: 
- **     task: 定时任务
- **     start: 开始时间
- **     interval: 间隔时间
+ **输入参数:
+ **     start: 开始时间(秒)
+ **     interval: 间隔时间(秒)
  **输出参数: NONE
  **返    回: 定时任务
  **实现描述:
@@ -56,25 +53,41 @@ timer_cntx_t *timer_cntx_init(void)
  **作    者: # Qifeng.zou # 2016.12.28 16:04:41 #
  ******************************************************************************/
 timer_task_t *timer_task_init(int start, int interval)
+{
+    return timer_task_init_ms(start * 1000, (interval? interval : 1) * 1000);
+}
+
+/******************************************************************************
+ **函数名称: timer_task_init_ms
+ **功    能: 初始化定时器(毫秒)
+ **输入参数:
+ **     start_ms: 开始时间(毫秒)
+ **     interval_ms: 间隔时间(毫秒, 0:只执行一次)
+ **输出参数: NONE
+ **返    回: 定时任务
+ **实现描述:
+ **注意事项: 完成定时任务的初始化之后, 还需要调用timer_task_add()将定时任务加入执行流程.
+ **作    者: # Qifeng.zou # 2017.01.05 #
+ ******************************************************************************/
+timer_task_t *timer_task_init_ms(int start_ms, int interval_ms)
 {
     timer_task_t *task;
-    time_t ctm = time(NULL);
 
     task = (timer_task_t *)calloc(1, sizeof(timer_task_t));
     if (NULL == task) {
         return NULL;
     }
 
-    task->start = start;        /* 开始时间 */
-    task->interval = interval? interval : 1;  /* 间隔时间 */
+    task->start = start_ms;         /* 开始时间 */
+    task->interval = interval_ms;   /* 间隔时间 */
     task->list = list_creat(NULL);
     if (NULL == task->list) {
         free(task);
         return NULL;
     }
 
-    task->times = 0;            /* 已执行次数 */
-    task->ttl = ctm + start;    /* 下次执行时间 */
+    task->times = 0;                /* 已执行次数 */
+    timer_wheel_node_init(&task->node, (timer_wheel_cb_t)timer_task_expire_cb, task);
 
     return task;
 }
@@ -82,7 +95,7 @@ timer_task_t *timer_task_init(int start, int interval)
 /******************************************************************************
  **函数名称: timer_task_add
  **功    能: 添加处理任务
- **输入参数: 
+ **输入参数:
  **     task: 定时任务
  **     proc: 处理回调
  **     param: 附加参数
@@ -113,118 +126,27 @@ int timer_task_add(timer_task_t *task, void (*proc)(void *param), void *param)
  **函数名称: timer_task_start
  **功    能: 执行定时任务
  **输入参数:
- **     ctx: 堆对象
- **     data: 数据
+ **     ctx: 上下文对象
+ **     task: 定时任务
  **输出参数: NONE
  **返    回: 0:成功 !0:失败
- **实现描述: 将新增数据放在堆末尾, 再反向调整堆的结构.
- **注意事项:
+ **实现描述: 将任务加入时间轮, start毫秒后首次执行. 已启动的任务重新计时.
+ **注意事项: 可在任意线程(包括定时回调中)调用
  **作    者: # Qifeng.zou # 2016.12.28 17:00:42 #
  ******************************************************************************/
 int timer_task_start(timer_cntx_t *ctx, timer_task_t *task)
 {
-    void **e;
-    int parent, idx;
+    int ret;
 
-    pthread_rwlock_wrlock(&ctx->lock);
+    pthread_mutex_lock(&ctx->lock);
 
     task->ctx = ctx;
+    ret = timer_wheel_add(ctx->wheel, &task->node,
+            (uint64_t)task->start * 1000, (uint64_t)task->interval * 1000);
 
-    /* > 防止空间不足 申请内存空间 */
-    if (ctx->len >= ctx->cap) {
-        e = (void **)realloc(ctx->e, (2 * ctx->cap) * sizeof(void *));
-        if (NULL == e) {
-            pthread_rwlock_unlock(&ctx->lock);
-            return -1;
-        }
-
-        ctx->e = e;
-        ctx->cap = 2 * ctx->cap;
-    }
-
-    if (0 == ctx->len) {
-        ctx->e[ctx->len++] = task;
-        task->idx = 0;
-        pthread_rwlock_unlock(&ctx->lock);
-        return 0;
-    }
-
-    /* > 调整堆的结构 */
-    idx = ctx->len;
-    parent = idx / 2;
-
-    while ((idx != parent) && (ctx->cmp(ctx->e[parent], task) > 0)) {
-        ctx->e[idx] = ctx->e[parent];
-        idx = parent;
-        parent = idx / 2;
-    }
+    pthread_mutex_unlock(&ctx->lock);
 
-    ctx->e[idx] = (void *)task;
-    task->idx = idx;
-    ++ctx->len;
-
-    pthread_rwlock_unlock(&ctx->lock);
-
-    return 0;
-}
-
-/******************************************************************************
- **函数名称: timer_task_pop
- **功    能: 将任务弹出堆
- **输入参数:
- **     ctx: 堆对象
- **输出参数: NONE
- **返    回: 数据
- **实现描述: 数据出堆后, 再拿末尾数据到堆头调整堆结构.
- **注意事项:
- **作    者: # Qifeng.zou # 2016.12.28 16:04:41 #
- ******************************************************************************/
-timer_task_t *timer_task_pop(timer_cntx_t *ctx)
-{
-    timer_task_t *task, *item;
-    int idx, left, right, min;
-
-    pthread_rwlock_wrlock(&ctx->lock);
-
-    if (0 == ctx->len) {
-        pthread_rwlock_unlock(&ctx->lock);
-        return NULL;
-    }
-
-    item = ctx->e[0];
-
-    /* > 调整堆的结构 */
-    task = ctx->e[--ctx->len];
-
-    idx = 0;
-    left = 1;
-    right = 2;
-    while (1) {
-        if (left >= ctx->len) {
-            ctx->e[idx] = task;
-            break;
-        }
-
-        min = left;
-        if (right < ctx->len) {
-            min = (ctx->cmp(ctx->e[left], ctx->e[right]) <= 0)? left : right;
-        }
-
-        if (ctx->cmp(ctx->e[min], task) >= 0) {
-            ctx->e[idx] = task;
-            break;
-        }
-
-        ctx->e[idx] = ctx->e[min];
-
-        idx = min;
-        left = 2 * idx;
-        right = 2 * idx + 1;
-    }
-
-    pthread_rwlock_unlock(&ctx->lock);
-
-    return item;
+    return ret;
 }
 
 /******************************************************************************
@@ -234,99 +156,20 @@ timer_task_t *timer_task_pop(timer_cntx_t *ctx)
  **     ctx: 上下文对象
  **     task: 被删的对象
  **输出参数: NONE
- **返    回: VOID
- **实现描述: 将堆最后一个元素填补被删除的元素, 再从被删元素处开始调整堆的结构.
+ **返    回: 0:成功 !0:任务未启动
+ **实现描述: 从时间轮中移除, O(1)
  **注意事项: 外部需要主动释放内存空间, 否则存在内存泄露的可能性
  **作    者: # Qifeng.zou # 2016.12.28 16:04:41 #
  ******************************************************************************/
 int timer_task_stop(timer_cntx_t *ctx, timer_task_t *task)
 {
-    timer_task_t *item;
-    int idx, left, right, min;
-
-    pthread_rwlock_wrlock(&ctx->lock);
-
-    if (task->idx >= ctx->len) {
-        pthread_rwlock_unlock(&ctx->lock);
-        return -1;
-    } else if (task != (timer_task_t *)ctx->e[task->idx]) {
-        pthread_rwlock_unlock(&ctx->lock);
-        return -1;
-    }
-
-    idx = task->idx;
-    if (0 == idx) {
-        left = 1;
-        right = 2;
-    } else {
-        left = 2 * idx;
-        right = 2 * idx + 1;
-    }
-
-    /* 将堆最后一个元素填补被删除的元素 */
-    item = (timer_task_t *)(ctx->e[--ctx->len]);
-
-    /* 再从被删元素处开始调整堆的结构 */
-    while (1) {
-        if (left >= ctx->len) {
-            ctx->e[idx] = item;
-            task->idx = idx;
-            break;
-        }
-
-        min = left;
-        if (right < ctx->len) {
-            min = (ctx->cmp(ctx->e[left], ctx->e[right]) <= 0)? left : right;
-        }
-
-        if (ctx->cmp(ctx->e[min], item) >= 0) {
-            ctx->e[idx] = item;
-            item->idx = idx;
-            break;
-        }
-
-        ctx->e[idx] = ctx->e[min];
-        ((timer_task_t *)(ctx->e[idx]))->idx = idx;
-
-        idx = min;
-        left = 2 * idx;
-        right = 2 * idx + 1;
-    }
-
-    pthread_rwlock_unlock(&ctx->lock);
-    return 0;
-}
-
-/******************************************************************************
- **函数名称: timer_task_is_timeout
- **功    能: 是否存在超时任务
- **输入参数:
- **     ctx: 堆对象
- **输出参数: NONE
- **返    回: 数据
- **实现描述: 获取堆头的最近超时时间
- **注意事项:
- **作    者: # Qifeng.zou # 2016.12.28 20:06:45 #
- ******************************************************************************/
-static bool timer_task_is_timeout(timer_cntx_t *ctx)
-{
-    int timeout;
-    timer_task_t *task;
-    time_t ctm = time(NULL);
-
-    pthread_rwlock_rdlock(&ctx->lock);
-
-    if (0 == ctx->len) {
-        pthread_rwlock_unlock(&ctx->lock);
-        return false;
-    }
-
-    task = (timer_task_t *)(ctx->e[0]);
-    timeout = (ctm < task->ttl)? task->ttl - ctm : 0;
+    int ret;
 
-    pthread_rwlock_unlock(&ctx->lock);
+    pthread_mutex_lock(&ctx->lock);
+    ret = timer_wheel_del(ctx->wheel, &task->node);
+    pthread_mutex_unlock(&ctx->lock);
 
-    return (timeout > 0)? false : true;
+    return ret;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -340,6 +183,14 @@ static int timer_task_proc_cb(timer_task_item_t *item, void *param)
     return 0;
 }
 
+/* 任务到期回调 */
+static void timer_task_expire_cb(timer_task_t *task)
+{
+    list_trav(task->list, (trav_cb_t)timer_task_proc_cb, NULL);
+
+    ++task->times;
+}
+
 /******************************************************************************
  **函数名称: timer_task_routine
  **功    能: 定时任务处理
@@ -347,32 +198,40 @@ static int timer_task_proc_cb(timer_task_item_t *item, void *param)
  **     task: 定时任务
  **输出参数:
  **返    回: VOID
- **实现描述: 睡眠过程中可能有新添加的定时任务, 为防止新任务超时后长时间得不到处
- **          理, 因此, 每次睡眠时间为1秒.
- **注意事项: 
+ **实现描述: 等待时间轮的timerfd可读, 到期即处理. 新增任务的到期时刻更早时
+ **          会重新设置timerfd, 因此无需定期唤醒.
+ **注意事项:
  **作    者: # Qifeng.zou # 2016.12.28 19:46:43 #
  ******************************************************************************/
 void *timer_task_routine(void *_ctx)
 {
-    timer_task_t *task;
+    int epid;
+    struct epoll_event ev;
     timer_cntx_t *ctx = (timer_cntx_t *)_ctx;
 
-    for (;;) {
-        while (timer_task_is_timeout(ctx)) {
-            task = timer_task_pop(ctx);
-            if (NULL == task) {
-                break;
-            }
-
-            list_trav(task->list, (trav_cb_t)timer_task_proc_cb, NULL);
+    epid = epoll_create1(EPOLL_CLOEXEC);
+    if (epid < 0) {
+        return (void *)-1;
+    }
 
-            ++task->times;
-            task->ttl = time(NULL) + task->interval;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = ctx;
+    epoll_ctl(epid, EPOLL_CTL_ADD, timer_wheel_fd(ctx->wheel), &ev);
 
-            timer_task_start(ctx, task);
+    for (;;) {
+        if (epoll_wait(epid, &ev, 1, -1) < 0) {
+            if (EINTR != errno) {
+                Sleep(1);
+            }
+            continue;
         }
-        Sleep(1);
+
+        pthread_mutex_lock(&ctx->lock);
+        timer_wheel_expire(ctx->wheel);
+        pthread_mutex_unlock(&ctx->lock);
     }
 
+    CLOSE(epid);
     return NULL;
 }
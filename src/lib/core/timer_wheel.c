@@ -0,0 +1,577 @@
+/******************************************************************************
+ ** Copyright(C) 2014-2024 Qiware technology Co., Ltd
+ **
+ ** 文件名: timer_wheel.c
+ ** 版本号: 1.0
+ ** 描  述: 分层时间轮定时器
+ **         支持毫秒/微秒级到期时刻、一次性与周期定时器, O(1)添加与删除,
+ **         通过timerfd嵌入epoll事件循环, 无需专门的定时线程.
+ ** 作  者: # Qifeng.zou # 2017.01.05 #
+ ******************************************************************************/
+#include <sys/timerfd.h>
+
+#include "comm.h"
+#include "redo.h"
+#include "timer_wheel.h"
+
+#define TIMER_WHEEL_NONE    (UINT64_MAX)    /* 无到期时刻 */
+#define TIMER_WHEEL_FIRING  (TIMER_WHEEL_SLOT_NUM) /* 正在处理(已移出槽) */
+
+/* 第level层的位移/槽起始序号/掩码 */
+#define timer_wheel_shift(level) \
+    ((level)? (TIMER_WHEEL_ROOT_BITS + ((level) - 1) * TIMER_WHEEL_NODE_BITS) : 0)
+#define timer_wheel_offset(level) \
+    ((level)? (TIMER_WHEEL_ROOT_SIZE + ((level) - 1) * TIMER_WHEEL_NODE_SIZE) : 0)
+#define timer_wheel_mask(level) \
+    ((level)? (TIMER_WHEEL_NODE_SIZE - 1) : (TIMER_WHEEL_ROOT_SIZE - 1))
+
+/* 时间轮覆盖的tick数 */
+#define TIMER_WHEEL_MAX_TICKS ((uint64_t)1 << timer_wheel_shift(TIMER_WHEEL_LEVEL))
+
+#define timer_wheel_bit_set(tw, idx) ((tw)->bitmap[(idx) >> 6] |= ((uint64_t)1 << ((idx) & 63)))
+#define timer_wheel_bit_clr(tw, idx) ((tw)->bitmap[(idx) >> 6] &= ~((uint64_t)1 << ((idx) & 63)))
+
+/* 获取单调时钟(微秒) */
+static inline uint64_t timer_wheel_clock(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* 链表操作 */
+static inline void timer_wheel_list_init(timer_wheel_node_t *head)
+{
+    head->prev = head;
+    head->next = head;
+}
+
+static inline bool timer_wheel_list_empty(timer_wheel_node_t *head)
+{
+    return (head->next == head);
+}
+
+static inline void timer_wheel_list_add(timer_wheel_node_t *head, timer_wheel_node_t *node)
+{
+    node->prev = head->prev;
+    node->next = head;
+    head->prev->next = node;
+    head->prev = node;
+}
+
+/* 将槽中链表整体移到head(head须为空链表) */
+static inline void timer_wheel_list_splice(timer_wheel_node_t *slot, timer_wheel_node_t *head)
+{
+    if (timer_wheel_list_empty(slot)) {
+        return;
+    }
+
+    head->next = slot->next;
+    head->prev = slot->prev;
+    head->next->prev = head;
+    head->prev->next = head;
+
+    timer_wheel_list_init(slot);
+}
+
+/******************************************************************************
+ **函数名称: timer_wheel_find
+ **功    能: 查找[from, to)范围内的第一个非空槽
+ **输入参数:
+ **     tw: 时间轮
+ **     from: 起始槽序号
+ **     to: 结束槽序号(不含)
+ **输出参数: NONE
+ **返    回: 槽序号(-1:不存在)
+ **实现描述: 按64位字扫描位图
+ **注意事项:
+ **作    者: # Qifeng.zou # 2017.01.05 #
+ ******************************************************************************/
+static int timer_wheel_find(timer_wheel_t *tw, int from, int to)
+{
+    int idx;
+    uint64_t word;
+
+    while (from < to) {
+        idx = from >> 6;
+        word = tw->bitmap[idx] & (~(uint64_t)0 << (from & 63));
+        if (word) {
+            from = (idx << 6) + __builtin_ctzll(word);
+            return (from < to)? from : -1;
+        }
+        from = (idx + 1) << 6;
+    }
+
+    return -1;
+}
+
+/******************************************************************************
+ **函数名称: timer_wheel_creat
+ **功    能: 创建时间轮
+ **输入参数:
+ **     tick_us: tick大小(微秒, 0:使用默认值TIMER_WHEEL_TICK_US)
+ **输出参数: NONE
+ **返    回: 时间轮
+ **实现描述: 创建CLOCK_MONOTONIC的timerfd, 到期时刻变化时重新设置
+ **注意事项:
+ **作    者: # Qifeng.zou # 2017.01.05 #
+ ******************************************************************************/
+timer_wheel_t *timer_wheel_creat(uint32_t tick_us)
+{
+    int idx;
+    timer_wheel_t *tw;
+
+    tw = (timer_wheel_t *)calloc(1, sizeof(timer_wheel_t));
+    if (NULL == tw) {
+        return NULL;
+    }
+
+    tw->fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (tw->fd < 0) {
+        free(tw);
+        return NULL;
+    }
+
+    tw->tick = tick_us? tick_us : TIMER_WHEEL_TICK_US;
+    tw->base = timer_wheel_clock();
+    tw->curr = 0;
+    tw->armed = TIMER_WHEEL_NONE;
+
+    for (idx=0; idx<TIMER_WHEEL_SLOT_NUM; ++idx) {
+        timer_wheel_list_init(&tw->slot[idx]);
+    }
+
+    return tw;
+}
+
+/******************************************************************************
+ **函数名称: timer_wheel_node_init
+ **功    能: 初始化定时器
+ **输入参数:
+ **     node: 定时器
+ **     proc: 定时回调
+ **     param: 附加参数
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述:
+ **注意事项:
+ **作    者: # Qifeng.zou # 2017.01.05 #
+ ******************************************************************************/
+void timer_wheel_node_init(timer_wheel_node_t *node, timer_wheel_cb_t proc, void *param)
+{
+    memset(node, 0, sizeof(timer_wheel_node_t));
+
+    node->slot = -1;
+    node->proc = proc;
+    node->param = param;
+}
+
+/******************************************************************************
+ **函数名称: timer_wheel_link
+ **功    能: 将定时器放入对应的槽
+ **输入参数:
+ **     tw: 时间轮
+ **     node: 定时器(expire已设置)
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述:
+ **     距当前时刻idx个tick: idx < 2^8放第0层, idx < 2^14放第1层, 以此类推;
+ **     超出范围的放在最高层最远的槽, 级联时重新计算.
+ **注意事项: 已过期的定时器在下一个tick处理
+ **作    者: # Qifeng.zou # 2017.01.05 #
+ ******************************************************************************/
+static void timer_wheel_link(timer_wheel_t *tw, timer_wheel_node_t *node)
+{
+    int level, slot;
+    uint64_t expire, idx;
+
+    if (node->expire < tw->curr) {
+        node->expire = tw->curr;
+    }
+
+    expire = node->expire;
+    idx = expire - tw->curr;
+    for (level=0; level<TIMER_WHEEL_LEVEL-1; ++level) {
+        if (idx < ((uint64_t)1 << timer_wheel_shift(level + 1))) {
+            break;
+        }
+    }
+
+    if (idx >= TIMER_WHEEL_MAX_TICKS) {
+        expire = tw->curr + TIMER_WHEEL_MAX_TICKS - 1;
+    }
+
+    slot = timer_wheel_offset(level)
+        + ((expire >> timer_wheel_shift(level)) & timer_wheel_mask(level));
+
+    timer_wheel_list_add(&tw->slot[slot], node);
+    timer_wheel_bit_set(tw, slot);
+    node->slot = slot;
+}
+
+/******************************************************************************
+ **函数名称: timer_wheel_unlink
+ **功    能: 将定时器移出所在的槽
+ **输入参数:
+ **     tw: 时间轮
+ **     node: 定时器
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述: 槽变为空时清除位图
+ **注意事项:
+ **作    者: # Qifeng.zou # 2017.01.05 #
+ ******************************************************************************/
+static void timer_wheel_unlink(timer_wheel_t *tw, timer_wheel_node_t *node)
+{
+    node->prev->next = node->next;
+    node->next->prev = node->prev;
+
+    if ((node->slot < TIMER_WHEEL_SLOT_NUM)
+        && timer_wheel_list_empty(&tw->slot[node->slot]))
+    {
+        timer_wheel_bit_clr(tw, node->slot);
+    }
+
+    node->prev = node->next = NULL;
+    node->slot = -1;
+}
+
+/******************************************************************************
+ **函数名称: timer_wheel_next
+ **功    能: 计算最近的到期时刻
+ **输入参数:
+ **     tw: 时间轮
+ **输出参数: NONE
+ **返    回: 到期tick(TIMER_WHEEL_NONE:无定时器)
+ **实现描述:
+ **     1. 第0层当前圈内的非空槽为精确到期时刻;
+ **     2. 其余情况取下一次级联的时刻(下界), 届时重新计算.
+ **注意事项:
+ **作    者: # Qifeng.zou # 2017.01.05 #
+ ******************************************************************************/
+static uint64_t timer_wheel_next(timer_wheel_t *tw)
+{
+    int level, idx, j;
+    uint64_t next, tick, round;
+
+    if (0 == tw->num) {
+        return TIMER_WHEEL_NONE;
+    }
+
+    idx = tw->curr & timer_wheel_mask(0);
+    if (0 == idx) {
+        return tw->curr; /* 待级联 */
+    }
+
+    /* > 第0层当前圈 */
+    j = timer_wheel_find(tw, idx, TIMER_WHEEL_ROOT_SIZE);
+    if (j >= 0) {
+        return tw->curr - idx + j;
+    }
+
+    /* > 第0层下一圈 */
+    next = TIMER_WHEEL_NONE;
+    j = timer_wheel_find(tw, 0, idx);
+    if (j >= 0) {
+        next = (tw->curr | timer_wheel_mask(0)) + 1 + j;
+    }
+
+    /* > 上层的下一次级联 */
+    for (level=1; level<TIMER_WHEEL_LEVEL; ++level) {
+        round = tw->curr >> timer_wheel_shift(level);
+        idx = (round + 1) & timer_wheel_mask(level);
+        j = timer_wheel_find(tw, timer_wheel_offset(level) + idx,
+                timer_wheel_offset(level) + TIMER_WHEEL_NODE_SIZE);
+        if (j < 0) {
+            j = timer_wheel_find(tw, timer_wheel_offset(level),
+                    timer_wheel_offset(level) + idx);
+            if (j < 0) {
+                continue;
+            }
+        }
+        j -= timer_wheel_offset(level);
+
+        tick = (round + 1 + ((j - round - 1) & timer_wheel_mask(level))) << timer_wheel_shift(level);
+        if (tick < next) {
+            next = tick;
+        }
+    }
+
+    return next;
+}
+
+/******************************************************************************
+ **函数名称: timer_wheel_arm
+ **功    能: 设置timerfd的到期时刻
+ **输入参数:
+ **     tw: 时间轮
+ **     tick: 到期tick(TIMER_WHEEL_NONE:取消)
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述: 使用绝对时间, 避免计算过程中的时间流逝造成误差
+ **注意事项:
+ **作    者: # Qifeng.zou # 2017.01.05 #
+ ******************************************************************************/
+static void timer_wheel_arm(timer_wheel_t *tw, uint64_t tick)
+{
+    uint64_t us;
+    struct itimerspec its;
+
+    if (tick == tw->armed) {
+        return;
+    }
+
+    memset(&its, 0, sizeof(its));
+    if (TIMER_WHEEL_NONE != tick) {
+        us = tw->base + tick * tw->tick;
+        its.it_value.tv_sec = us / 1000000;
+        its.it_value.tv_nsec = (us % 1000000) * 1000;
+        if (0 == its.it_value.tv_sec && 0 == its.it_value.tv_nsec) {
+            its.it_value.tv_nsec = 1; /* 全0表示取消 */
+        }
+    }
+
+    timerfd_settime(tw->fd, TFD_TIMER_ABSTIME, &its, NULL);
+
+    tw->armed = tick;
+}
+
+/******************************************************************************
+ **函数名称: timer_wheel_add
+ **功    能: 启动定时器
+ **输入参数:
+ **     tw: 时间轮
+ **     node: 定时器
+ **     timeout_us: 首次到期的时长(微秒)
+ **     period_us: 周期(微秒, 0:一次性)
+ **输出参数: NONE
+ **返    回: 0:成功 !0:失败
+ **实现描述: 到期时刻向上取整到tick, 不会提前触发. 已启动的定时器重新计时.
+ **注意事项: 周期定时器按固定频率触发, 处理滞后时跳过错过的周期
+ **作    者: # Qifeng.zou # 2017.01.05 #
+ ******************************************************************************/
+int timer_wheel_add(timer_wheel_t *tw, timer_wheel_node_t *node, uint64_t timeout_us, uint64_t period_us)
+{
+    uint64_t us;
+
+    if (NULL == node->proc) {
+        return -1;
+    }
+
+    if (timer_wheel_pending(node)) {
+        timer_wheel_del(tw, node);
+    }
+
+    us = timer_wheel_clock() - tw->base + timeout_us;
+
+    node->expire = (us + tw->tick - 1) / tw->tick;
+    node->period = (period_us + tw->tick - 1) / tw->tick; /* 0:一次性 */
+
+    timer_wheel_link(tw, node);
+    ++tw->num;
+
+    if (node->expire < tw->armed) {
+        timer_wheel_arm(tw, node->expire);
+    }
+
+    return 0;
+}
+
+/******************************************************************************
+ **函数名称: timer_wheel_del
+ **功    能: 停止定时器
+ **输入参数:
+ **     tw: 时间轮
+ **     node: 定时器
+ **输出参数: NONE
+ **返    回: 0:成功 !0:定时器未启动
+ **实现描述: O(1)移出链表; 不调整timerfd, 多余的一次唤醒在处理时忽略
+ **注意事项: 可在定时回调中调用(包括停止自身)
+ **作    者: # Qifeng.zou # 2017.01.05 #
+ ******************************************************************************/
+int timer_wheel_del(timer_wheel_t *tw, timer_wheel_node_t *node)
+{
+    if (!timer_wheel_pending(node)) {
+        return -1;
+    }
+
+    timer_wheel_unlink(tw, node);
+    --tw->num;
+
+    return 0;
+}
+
+/******************************************************************************
+ **函数名称: timer_wheel_cascade
+ **功    能: 将第level层的第idx个槽中的定时器重新分配到下层
+ **输入参数:
+ **     tw: 时间轮
+ **     level: 层
+ **     idx: 槽序号(层内)
+ **输出参数: NONE
+ **返    回: 槽序号
+ **实现描述:
+ **注意事项:
+ **作    者: # Qifeng.zou # 2017.01.05 #
+ ******************************************************************************/
+static int timer_wheel_cascade(timer_wheel_t *tw, int level, int idx)
+{
+    int slot = timer_wheel_offset(level) + idx;
+    timer_wheel_node_t head, *node;
+
+    timer_wheel_list_init(&head);
+    timer_wheel_list_splice(&tw->slot[slot], &head);
+    timer_wheel_bit_clr(tw, slot);
+
+    while (!timer_wheel_list_empty(&head)) {
+        node = head.next;
+        node->prev->next = node->next;
+        node->next->prev = node->prev;
+        timer_wheel_link(tw, node);
+    }
+
+    return idx;
+}
+
+/******************************************************************************
+ **函数名称: timer_wheel_expire
+ **功    能: 处理到期的定时器
+ **输入参数:
+ **     tw: 时间轮
+ **输出参数: NONE
+ **返    回: 触发的定时器个数
+ **实现描述:
+ **     1. 逐tick推进到当前时刻, 跳过空槽; 第0层转完一圈时逐层级联;
+ **     2. 周期定时器在回调前重新加入, 回调中可将其停止;
+ **     3. 处理完成后按最近的到期时刻重新设置timerfd.
+ **注意事项: timerfd可读时调用, 也可在每轮事件循环中调用
+ **作    者: # Qifeng.zou # 2017.01.05 #
+ ******************************************************************************/
+int timer_wheel_expire(timer_wheel_t *tw)
+{
+    uint64_t buf, now, t, next;
+    int idx, j, level, count = 0;
+    timer_wheel_node_t head, *node;
+
+    if (read(tw->fd, &buf, sizeof(buf)) < 0) {
+        /* EAGAIN: 未到期, 继续检查 */
+    }
+    tw->armed = TIMER_WHEEL_NONE;
+
+    now = (timer_wheel_clock() - tw->base) / tw->tick;
+
+    while (tw->curr <= now) {
+        if (0 == tw->num) {
+            tw->curr = now + 1;
+            break;
+        }
+
+        idx = tw->curr & timer_wheel_mask(0);
+        if (0 == idx) {
+            for (level=1; level<TIMER_WHEEL_LEVEL; ++level) {
+                j = (tw->curr >> timer_wheel_shift(level)) & timer_wheel_mask(level);
+                if (timer_wheel_cascade(tw, level, j)) {
+                    break;
+                }
+            }
+        } else if (timer_wheel_list_empty(&tw->slot[idx])) {
+            /* 跳到本圈下一个非空槽(不越过级联点) */
+            j = timer_wheel_find(tw, idx, TIMER_WHEEL_ROOT_SIZE);
+            next = (j < 0)? (tw->curr | timer_wheel_mask(0)) + 1 : tw->curr - idx + j;
+            tw->curr = (next < now + 1)? next : (now + 1);
+            continue;
+        }
+
+        t = tw->curr++;
+
+        timer_wheel_list_init(&head);
+        timer_wheel_list_splice(&tw->slot[idx], &head);
+        timer_wheel_bit_clr(tw, idx);
+        for (node = head.next; node != &head; node = node->next) {
+            node->slot = TIMER_WHEEL_FIRING;
+        }
+
+        while (!timer_wheel_list_empty(&head)) {
+            node = head.next;
+            timer_wheel_unlink(tw, node);
+            --tw->num;
+
+            if (node->period) {
+                node->expire += node->period;
+                if (node->expire <= t) {
+                    node->expire = t + node->period;
+                }
+                timer_wheel_link(tw, node);
+                ++tw->num;
+            }
+
+            node->proc(node->param);
+            ++count;
+        }
+    }
+
+    timer_wheel_arm(tw, timer_wheel_next(tw));
+
+    return count;
+}
+
+/******************************************************************************
+ **函数名称: timer_wheel_timeout
+ **功    能: 距最近到期时刻的毫秒数
+ **输入参数:
+ **     tw: 时间轮
+ **输出参数: NONE
+ **返    回: 毫秒数(-1:无定时器)
+ **实现描述: 可直接作为epoll_wait()的超时时间
+ **注意事项: 返回值向上取整, 不会提前醒来
+ **作    者: # Qifeng.zou # 2017.01.05 #
+ ******************************************************************************/
+int timer_wheel_timeout(timer_wheel_t *tw)
+{
+    uint64_t next, us, now;
+
+    next = timer_wheel_next(tw);
+    if (TIMER_WHEEL_NONE == next) {
+        return -1;
+    }
+
+    us = tw->base + next * tw->tick;
+    now = timer_wheel_clock();
+
+    return (us > now)? (int)((us - now + 999) / 1000) : 0;
+}
+
+/******************************************************************************
+ **函数名称: timer_wheel_now
+ **功    能: 获取时间轮创建以来经过的时间
+ **输入参数:
+ **     tw: 时间轮
+ **输出参数: NONE
+ **返    回: 微秒数
+ **实现描述:
+ **注意事项:
+ **作    者: # Qifeng.zou # 2017.01.05 #
+ ******************************************************************************/
+uint64_t timer_wheel_now(timer_wheel_t *tw)
+{
+    return timer_wheel_clock() - tw->base;
+}
+
+/******************************************************************************
+ **函数名称: timer_wheel_destroy
+ **功    能: 销毁时间轮
+ **输入参数:
+ **     tw: 时间轮
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述:
+ **注意事项: 定时器由调用者分配, 此处不释放
+ **作    者: # Qifeng.zou # 2017.01.05 #
+ ******************************************************************************/
+void timer_wheel_destroy(timer_wheel_t *tw)
+{
+    CLOSE(tw->fd);
+    free(tw);
+}
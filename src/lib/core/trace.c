@@ -0,0 +1,313 @@
+/******************************************************************************
+ ** Copyright(C) 2014-2024 Qiware technology Co., Ltd
+ **
+ ** 文件名: trace.c
+ ** 版本号: 1.0
+ ** 描  述: 热点路径跟踪模块
+ **         业务线程将抽样消息的各阶段时刻写入本线程的环形缓存, 同步线程定时
+ **         将各缓存中的事件写入跟踪文件.
+ ** 作  者: # Qifeng.zou # 2015.09.30 #
+ ******************************************************************************/
+#include "comm.h"
+#include "redo.h"
+#include "trace.h"
+#include "thread_pool.h"
+
+#define TRACE_CALIBRATE_USEC    (20000)     /* TSC频率的校准时长(微秒) */
+
+/* 跟踪服务 */
+typedef struct
+{
+    pthread_mutex_t lock;                   /* 锁(保护缓存链表及文件) */
+    pthread_once_t once;                    /* 线程键只创建一次 */
+    pthread_key_t key;                      /* 线程键(线程退出时标记缓存) */
+    int key_ok;                             /* 线程键是否创建成功 */
+
+    trace_ring_t *rings;                    /* 各线程的缓存 */
+    uint64_t drop;                          /* 已释放缓存的丢弃数 */
+
+    int fd;                                 /* 跟踪文件 */
+    size_t size;                            /* 文件长度 */
+    pthread_t tid;                          /* 同步线程 */
+    trace_file_head_t head;                 /* 文件头 */
+} trace_svr_t;
+
+static trace_svr_t g_trace = {
+    PTHREAD_MUTEX_INITIALIZER, PTHREAD_ONCE_INIT, 0, 0, NULL, 0, -1
+};
+
+volatile uint32_t g_trace_rate = 0;
+__thread trace_ring_t *g_trace_ring = NULL;
+
+/* 线程退出: 标记缓存, 由同步线程取完事件后释放 */
+static void trace_ring_release(void *_ring)
+{
+    trace_ring_t *ring = (trace_ring_t *)_ring;
+
+    ring->closed = 1;
+    g_trace_ring = NULL;
+}
+
+/* 创建线程键 */
+static void trace_key_creat(void)
+{
+    g_trace.key_ok = (0 == pthread_key_create(&g_trace.key, trace_ring_release));
+}
+
+/******************************************************************************
+ **函数名称: trace_ring_creat
+ **功    能: 创建本线程的事件缓存
+ **输入参数: NONE
+ **输出参数: NONE
+ **返    回: 本线程的缓存
+ **实现描述: 缓存挂入链表, 线程退出时由线程键的析构函数标记为已关闭
+ **注意事项: 由trace_ring_get()在线程首次抽样或记录时调用
+ **作    者: # Qifeng.zou # 2015.09.30 #
+ ******************************************************************************/
+trace_ring_t *trace_ring_creat(void)
+{
+    trace_ring_t *ring;
+
+    pthread_once(&g_trace.once, trace_key_creat);
+    if (!g_trace.key_ok) {
+        return NULL;
+    }
+
+    ring = (trace_ring_t *)memalign_alloc(64, sizeof(trace_ring_t));
+    if (NULL == ring) {
+        return NULL;
+    }
+
+    memset(ring, 0, sizeof(trace_ring_t));
+    ring->tid = (uint32_t)syscall(SYS_gettid);
+
+    pthread_mutex_lock(&g_trace.lock);
+    ring->next = g_trace.rings;
+    g_trace.rings = ring;
+    pthread_mutex_unlock(&g_trace.lock);
+
+    pthread_setspecific(g_trace.key, ring);
+    g_trace_ring = ring;
+
+    return ring;
+}
+
+/* 写入文件(超过最大长度后丢弃) */
+static int trace_write(const void *addr, size_t len)
+{
+    ssize_t n;
+
+    if (g_trace.size + len > TRACE_FILE_MAX_SIZE) {
+        return -1;
+    }
+
+    n = pwrite(g_trace.fd, addr, len, g_trace.size);
+    if (n > 0) {
+        g_trace.size += n;
+    }
+
+    return ((size_t)n == len)? 0 : -1;
+}
+
+/******************************************************************************
+ **函数名称: trace_ring_drain
+ **功    能: 将缓存中的事件写入文件
+ **输入参数:
+ **     ring: 线程缓存
+ **输出参数: NONE
+ **返    回: 写入失败(含超过文件最大长度)的事件数
+ **实现描述: 事件在缓存中最多分为两段(回绕), 每段一次写入
+ **注意事项: 须持有g_trace.lock
+ **作    者: # Qifeng.zou # 2015.09.30 #
+ ******************************************************************************/
+static uint64_t trace_ring_drain(trace_ring_t *ring)
+{
+    uint64_t head, tail, off, num, lost = 0;
+
+    head = ring->head;
+    compiler_barrier();
+
+    for (tail = ring->tail; tail < head; tail += num) {
+        off = tail & (TRACE_RING_SIZE - 1);
+        num = head - tail;
+        if (off + num > TRACE_RING_SIZE) {
+            num = TRACE_RING_SIZE - off;
+        }
+        if (trace_write(&ring->event[off], num * sizeof(trace_file_event_t))) {
+            lost += num;
+        }
+    }
+
+    compiler_barrier();
+    ring->tail = head;
+
+    return lost;
+}
+
+/******************************************************************************
+ **函数名称: trace_sync
+ **功    能: 将各线程缓存中的事件写入跟踪文件
+ **输入参数: NONE
+ **输出参数: NONE
+ **返    回: 0:成功 !0:失败
+ **实现描述:
+ **     1. 依次取出各缓存中的事件; 所属线程已退出且已取空的缓存被释放;
+ **     2. 重写文件头(阶段名称、丢弃数).
+ **注意事项: 由同步线程定时调用, 也可在退出前手动调用一次
+ **作    者: # Qifeng.zou # 2015.09.30 #
+ ******************************************************************************/
+int trace_sync(void)
+{
+    uint64_t drop;
+    trace_ring_t *ring, **prev;
+
+    pthread_mutex_lock(&g_trace.lock);
+    if (g_trace.fd < 0) {
+        pthread_mutex_unlock(&g_trace.lock);
+        return -1;
+    }
+
+    drop = 0;
+    prev = &g_trace.rings;
+    while (NULL != (ring = *prev)) {
+        g_trace.drop += trace_ring_drain(ring);
+        if (ring->closed && (ring->tail == ring->head)) {
+            *prev = ring->next;
+            g_trace.drop += ring->drop;
+            free(ring);
+            continue;
+        }
+        drop += ring->drop;
+        prev = &ring->next;
+    }
+
+    g_trace.head.drop = g_trace.drop + drop;
+    pwrite(g_trace.fd, &g_trace.head, sizeof(g_trace.head), 0);
+
+    pthread_mutex_unlock(&g_trace.lock);
+
+    return 0;
+}
+
+/* 同步线程 */
+static void *trace_sync_routine(void *args)
+{
+    for (;;) {
+        trace_sync();
+        usleep(TRACE_SYNC_MSEC * 1000);
+    }
+
+    return NULL;
+}
+
+/******************************************************************************
+ **函数名称: trace_calibrate
+ **功    能: 测定TSC频率及基准时刻
+ **输入参数: NONE
+ **输出参数:
+ **     head: 文件头(tsc_hz/tsc_base/ns_base)
+ **返    回: VOID
+ **实现描述: 比较一段时间内TSC与CLOCK_MONOTONIC的增量
+ **注意事项: 要求CPU支持恒定频率的TSC(constant_tsc)
+ **作    者: # Qifeng.zou # 2015.09.30 #
+ ******************************************************************************/
+static void trace_calibrate(trace_file_head_t *head)
+{
+    uint64_t tsc0, tsc1, ns0, ns1;
+    struct timespec mono, real;
+
+    clock_gettime(CLOCK_MONOTONIC, &mono);
+    clock_gettime(CLOCK_REALTIME, &real);
+    tsc0 = cpu_ticket_get();
+    ns0 = mono.tv_sec * 1000000000UL + mono.tv_nsec;
+
+    usleep(TRACE_CALIBRATE_USEC);
+
+    clock_gettime(CLOCK_MONOTONIC, &mono);
+    tsc1 = cpu_ticket_get();
+    ns1 = mono.tv_sec * 1000000000UL + mono.tv_nsec;
+
+    head->tsc_hz = (uint64_t)((double)(tsc1 - tsc0) * 1e9 / (double)(ns1 - ns0));
+    head->tsc_base = tsc0;
+    head->ns_base = real.tv_sec * 1000000000UL + real.tv_nsec;
+}
+
+/******************************************************************************
+ **函数名称: trace_init
+ **功    能: 启用跟踪
+ **输入参数:
+ **     path: 跟踪文件路径
+ **     rate: 抽样比例(每rate条消息跟踪1条; 0:停止抽样)
+ **输出参数: NONE
+ **返    回: 0:成功 !0:失败
+ **实现描述: 创建跟踪文件, 测定TSC频率, 启动同步线程, 最后打开抽样
+ **注意事项:
+ **     1. 不调用本函数时trace_sample()始终返回0, 热点路径只多一次读操作;
+ **     2. 重复调用时只修改抽样比例(path被忽略).
+ **作    者: # Qifeng.zou # 2015.09.30 #
+ ******************************************************************************/
+int trace_init(const char *path, int rate)
+{
+    if (rate < 0) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&g_trace.lock);
+    if (g_trace.fd >= 0) {
+        g_trace.head.rate = rate;
+        g_trace_rate = rate;
+        pthread_mutex_unlock(&g_trace.lock);
+        return 0;
+    }
+
+    Mkdir2(path, DIR_MODE);
+
+    g_trace.fd = Open(path, OPEN_FLAGS | O_TRUNC, OPEN_MODE);
+    if (g_trace.fd < 0) {
+        pthread_mutex_unlock(&g_trace.lock);
+        return -1;
+    }
+
+    g_trace.head.magic = TRACE_MAGIC;
+    g_trace.head.version = TRACE_VERSION;
+    g_trace.head.pid = getpid();
+    g_trace.head.rate = rate;
+    trace_calibrate(&g_trace.head);
+
+    g_trace.size = 0;
+    trace_write(&g_trace.head, sizeof(g_trace.head));
+    pthread_mutex_unlock(&g_trace.lock);
+
+    if (thread_creat(&g_trace.tid, trace_sync_routine, NULL)) {
+        return -1;
+    }
+
+    g_trace_rate = rate;
+
+    return 0;
+}
+
+/******************************************************************************
+ **函数名称: trace_stage
+ **功    能: 注册阶段名称
+ **输入参数:
+ **     stage: 阶段(0 ~ TRACE_STAGE_MAX_NUM-1)
+ **     name: 名称
+ **输出参数: NONE
+ **返    回: 0:成功 !0:失败
+ **实现描述: 名称保存在文件头中, 下次同步时写入文件
+ **注意事项: 阶段按处理先后编号, trace_export.py按编号顺序计算各阶段耗时
+ **作    者: # Qifeng.zou # 2015.09.30 #
+ ******************************************************************************/
+int trace_stage(int stage, const char *name)
+{
+    if ((stage < 0) || (stage >= TRACE_STAGE_MAX_NUM)) {
+        return -1;
+    }
+
+    pthread_mutex_lock(&g_trace.lock);
+    snprintf(g_trace.head.stage[stage], TRACE_NAME_MAX_LEN, "%s", name);
+    pthread_mutex_unlock(&g_trace.lock);
+
+    return 0;
+}
@@ -1,62 +1,382 @@
 /******************************************************************************
  ** Copyright(C) 2014-2024 Qiware technology Co., Ltd
  **
- ** 文件名: kw_tree.c
- ** 版本号: 1.0
- ** 描  述: 键树的实现
+ ** 文件名: trie.c
+ ** 版本号: 2.0
+ ** 描  述: 键树的实现(自适应基数树)
+ **         原实现每下降一层都要申请256个结点(约6KB), 百万级的URL或关键字无法
+ **         索引. 现改为自适应基数树: 结点规格随孩子数在4/16/48/256间升级, 并对
+ **         单孩子链做路径压缩, 内存下降几个数量级, 查询也因层数减少而更快.
  ** 作  者: # Qifeng.zou # 2015.05.12 #
  ******************************************************************************/
 #include "comm.h"
 #include "trie.h"
 
-static void trie_node_free(trie_tree_t *kwt, trie_node_t *node, void *mempool, mem_dealloc_cb_t dealloc);
+#if defined(__x86_64__)
+#include <emmintrin.h>
+#endif
+
+#define TRIE_IS_LEAF(p) ((uintptr_t)(p) & 1)
+#define TRIE_LEAF(p) ((trie_leaf_t *)((uintptr_t)(p) & ~(uintptr_t)1))
+#define TRIE_SET_LEAF(l) ((void *)((uintptr_t)(l) | 1))
+
+static void trie_node_free(trie_tree_t *tree, void *node, void *mempool, mem_dealloc_cb_t dealloc);
+
+/* 申请内存(并统计) */
+static void *trie_alloc(trie_tree_t *tree, size_t size)
+{
+    void *addr;
+
+    addr = tree->alloc(tree->pool, size);
+    if (NULL != addr) {
+        memset(addr, 0, size);
+        tree->mem += size;
+    }
+
+    return addr;
+}
+
+/* 释放内存(并统计) */
+static void trie_dealloc(trie_tree_t *tree, void *addr, size_t size)
+{
+    tree->mem -= size;
+    tree->dealloc(tree->pool, addr);
+}
+
+/* 结点大小 */
+static size_t trie_node_size(int type)
+{
+    switch (type) {
+        case TRIE_NODE4:
+            return sizeof(trie_node4_t);
+        case TRIE_NODE16:
+            return sizeof(trie_node16_t);
+        case TRIE_NODE48:
+            return sizeof(trie_node48_t);
+        default:
+            return sizeof(trie_node256_t);
+    }
+}
+
+/* 新建内部结点 */
+static trie_node_t *trie_node_alloc(trie_tree_t *tree, int type)
+{
+    trie_node_t *node;
+
+    node = (trie_node_t *)trie_alloc(tree, trie_node_size(type));
+    if (NULL == node) {
+        return NULL;
+    }
+
+    node->type = type;
+
+    return node;
+}
+
+/* 新建叶子 */
+static trie_leaf_t *trie_leaf_alloc(trie_tree_t *tree, const u_char *str, int len, void *data)
+{
+    trie_leaf_t *leaf;
+
+    leaf = (trie_leaf_t *)trie_alloc(tree, sizeof(trie_leaf_t) + len);
+    if (NULL == leaf) {
+        return NULL;
+    }
+
+    leaf->data = data;
+    leaf->len = len;
+    memcpy(leaf->key, str, len);
+
+    return leaf;
+}
+
+/* 叶子的键是否与str相同 */
+static inline bool trie_leaf_equal(const trie_leaf_t *leaf, const u_char *str, int len)
+{
+    return (leaf->len == len) && (0 == memcmp(leaf->key, str, len));
+}
+
+/* 叶子的键是否为str的前缀 */
+static inline bool trie_leaf_is_prefix(const trie_leaf_t *leaf, const u_char *str, int len)
+{
+    return (leaf->len <= len) && (0 == memcmp(leaf->key, str, leaf->len));
+}
 
 /******************************************************************************
- **函数名称: trie_creat
- **功    能: 创建键树
+ **函数名称: trie_find_child
+ **功    能: 查找孩子
  **输入参数:
- **     opt: 选项
+ **     node: 内部结点
+ **     c: 键
  **输出参数: NONE
- **返    回: 键树
- **实现描述:
+ **返    回: 孩子指针的地址(没有时返回NULL)
+ **实现描述: NODE16使用SSE2一次比较16个键
  **注意事项:
- **作    者: # Qifeng.zou # 2015.05.12 #
+ **作    者: # Qifeng.zou # 2015.08.05 #
  ******************************************************************************/
-trie_tree_t *trie_creat(trie_opt_t *opt)
+static void **trie_find_child(trie_node_t *node, u_char c)
 {
-    int max = 256;
-    trie_opt_t _opt;
-    trie_tree_t *kwt;
+    int i;
+    trie_node4_t *n4;
+    trie_node16_t *n16;
+    trie_node48_t *n48;
+    trie_node256_t *n256;
+#if defined(__x86_64__)
+    int mask;
+    __m128i cmp;
+#endif
+
+    switch (node->type) {
+        case TRIE_NODE4:
+            n4 = (trie_node4_t *)node;
+            for (i=0; i<node->num; ++i) {
+                if (n4->key[i] == c) {
+                    return &n4->child[i];
+                }
+            }
+            return NULL;
+        case TRIE_NODE16:
+            n16 = (trie_node16_t *)node;
+#if defined(__x86_64__)
+            cmp = _mm_cmpeq_epi8(_mm_set1_epi8((char)c),
+                    _mm_loadu_si128((const __m128i *)n16->key));
+            mask = _mm_movemask_epi8(cmp) & ((1 << node->num) - 1);
+            return mask? &n16->child[__builtin_ctz(mask)] : NULL;
+#else
+            for (i=0; i<node->num; ++i) {
+                if (n16->key[i] == c) {
+                    return &n16->child[i];
+                }
+            }
+            return NULL;
+#endif
+        case TRIE_NODE48:
+            n48 = (trie_node48_t *)node;
+            return n48->idx[c]? &n48->child[n48->idx[c] - 1] : NULL;
+        case TRIE_NODE256:
+            n256 = (trie_node256_t *)node;
+            return n256->child[c]? &n256->child[c] : NULL;
+        default:
+            break;
+    }
 
-    max = power2(max);
-    if (NULL == opt) {
-        opt = &_opt;
-        opt->pool = (void *)NULL;
-        opt->alloc = (mem_alloc_cb_t)mem_alloc;
-        opt->dealloc = (mem_dealloc_cb_t)mem_dealloc;
+    return NULL;
+}
+
+/* 取子树中的任一叶子(用于补全超出TRIE_PREFIX_MAX的压缩路径) */
+static trie_leaf_t *trie_minimum(void *p)
+{
+    int i;
+    trie_node_t *node;
+
+    while (!TRIE_IS_LEAF(p)) {
+        node = (trie_node_t *)p;
+        if (NULL != node->leaf) {
+            return node->leaf;
+        }
+
+        switch (node->type) {
+            case TRIE_NODE4:
+                p = ((trie_node4_t *)node)->child[0];
+                break;
+            case TRIE_NODE16:
+                p = ((trie_node16_t *)node)->child[0];
+                break;
+            case TRIE_NODE48:
+                for (i=0; 0 == ((trie_node48_t *)node)->idx[i]; ++i) { NULL; }
+                p = ((trie_node48_t *)node)->child[((trie_node48_t *)node)->idx[i] - 1];
+                break;
+            default:
+                for (i=0; NULL == ((trie_node256_t *)node)->child[i]; ++i) { NULL; }
+                p = ((trie_node256_t *)node)->child[i];
+                break;
+        }
     }
 
-    /* 1. 创建对象 */
-    kwt = (trie_tree_t *)opt->alloc(opt->pool, sizeof(trie_tree_t));
-    if (NULL == kwt) {
-        return NULL;
+    return TRIE_LEAF(p);
+}
+
+/******************************************************************************
+ **函数名称: trie_prefix_mismatch
+ **功    能: 计算压缩路径与键的公共长度
+ **输入参数:
+ **     node: 内部结点
+ **     str: 键
+ **     len: 键长
+ **     depth: 压缩路径在键中的起始位置
+ **输出参数: NONE
+ **返    回: 公共长度(等于prefix_len表示完全匹配)
+ **实现描述: 超出TRIE_PREFIX_MAX的部分从子树中的叶子取
+ **注意事项:
+ **作    者: # Qifeng.zou # 2015.08.05 #
+ ******************************************************************************/
+static int trie_prefix_mismatch(trie_node_t *node, const u_char *str, int len, int depth)
+{
+    int i, max;
+    trie_leaf_t *leaf;
+
+    max = MIN(MIN((int)node->prefix_len, TRIE_PREFIX_MAX), len - depth);
+    for (i=0; i<max; ++i) {
+        if (node->prefix[i] != str[depth + i]) {
+            return i;
+        }
     }
 
-    kwt->pool = opt->pool;
-    kwt->alloc = opt->alloc;
-    kwt->dealloc = opt->dealloc;
+    if ((int)node->prefix_len > TRIE_PREFIX_MAX) {
+        leaf = trie_minimum(node);
+        max = MIN(leaf->len, len) - depth;
+        max = MIN(max, (int)node->prefix_len);
+        for (; i<max; ++i) {
+            if (leaf->key[depth + i] != str[depth + i]) {
+                return i;
+            }
+        }
+    }
 
-    /* 2. 创建结点 */
-    kwt->max = max;
-    kwt->root = (trie_node_t *)kwt->alloc(kwt->pool, max * sizeof(trie_node_t));
-    if (NULL == kwt->root) {
-        kwt->dealloc(kwt->pool, kwt);
-        return NULL;
+    return i;
+}
+
+/******************************************************************************
+ **函数名称: trie_grow
+ **功    能: 结点升级
+ **输入参数:
+ **     tree: 键树
+ **     ref: 指向该结点的指针
+ **输出参数: NONE
+ **返    回: 0:成功 !0:失败
+ **实现描述: NODE4->NODE16->NODE48->NODE256
+ **注意事项:
+ **作    者: # Qifeng.zou # 2015.08.05 #
+ ******************************************************************************/
+static int trie_grow(trie_tree_t *tree, void **ref)
+{
+    int i;
+    trie_node_t *node = (trie_node_t *)*ref, *new;
+    trie_node4_t *n4;
+    trie_node16_t *n16;
+    trie_node48_t *n48;
+    trie_node256_t *n256;
+
+    new = trie_node_alloc(tree, node->type + 1);
+    if (NULL == new) {
+        return -1;
+    }
+
+    memcpy(new, node, sizeof(trie_node_t));
+    new->type = node->type + 1;
+
+    switch (node->type) {
+        case TRIE_NODE4:
+            n4 = (trie_node4_t *)node;
+            n16 = (trie_node16_t *)new;
+            memcpy(n16->key, n4->key, sizeof(n4->key));
+            memcpy(n16->child, n4->child, sizeof(n4->child));
+            break;
+        case TRIE_NODE16:
+            n16 = (trie_node16_t *)node;
+            n48 = (trie_node48_t *)new;
+            for (i=0; i<node->num; ++i) {
+                n48->idx[n16->key[i]] = i + 1;
+                n48->child[i] = n16->child[i];
+            }
+            break;
+        default:
+            n48 = (trie_node48_t *)node;
+            n256 = (trie_node256_t *)new;
+            for (i=0; i<256; ++i) {
+                if (n48->idx[i]) {
+                    n256->child[i] = n48->child[n48->idx[i] - 1];
+                }
+            }
+            break;
     }
 
-    memset(kwt->root, 0, sizeof(trie_node_t));
+    trie_dealloc(tree, node, trie_node_size(node->type));
+    *ref = new;
 
-    return kwt;
+    return 0;
+}
+
+/******************************************************************************
+ **函数名称: trie_add_child
+ **功    能: 添加孩子
+ **输入参数:
+ **     tree: 键树
+ **     ref: 指向该结点的指针(结点升级后更新)
+ **     c: 键
+ **     child: 孩子
+ **输出参数: NONE
+ **返    回: 0:成功 !0:失败
+ **实现描述: NODE4/NODE16的键保持有序, 以便按序遍历
+ **注意事项:
+ **作    者: # Qifeng.zou # 2015.08.05 #
+ ******************************************************************************/
+static int trie_add_child(trie_tree_t *tree, void **ref, u_char c, void *child)
+{
+    int i;
+    trie_node_t *node = (trie_node_t *)*ref;
+    trie_node4_t *n4;
+    trie_node16_t *n16;
+    trie_node48_t *n48;
+
+    switch (node->type) {
+        case TRIE_NODE4:
+            if (node->num >= 4) {
+                break;
+            }
+            n4 = (trie_node4_t *)node;
+            for (i=node->num; (i > 0) && (n4->key[i-1] > c); --i) {
+                n4->key[i] = n4->key[i-1];
+                n4->child[i] = n4->child[i-1];
+            }
+            n4->key[i] = c;
+            n4->child[i] = child;
+            ++node->num;
+            return 0;
+        case TRIE_NODE16:
+            if (node->num >= 16) {
+                break;
+            }
+            n16 = (trie_node16_t *)node;
+            for (i=node->num; (i > 0) && (n16->key[i-1] > c); --i) {
+                n16->key[i] = n16->key[i-1];
+                n16->child[i] = n16->child[i-1];
+            }
+            n16->key[i] = c;
+            n16->child[i] = child;
+            ++node->num;
+            return 0;
+        case TRIE_NODE48:
+            if (node->num >= 48) {
+                break;
+            }
+            n48 = (trie_node48_t *)node;
+            n48->child[node->num] = child;
+            n48->idx[c] = ++node->num;
+            return 0;
+        default:
+            ((trie_node256_t *)node)->child[c] = child;
+            ++node->num;
+            return 0;
+    }
+
+    /* > 已满: 升级后再添加 */
+    if (trie_grow(tree, ref)) {
+        return -1;
+    }
+
+    return trie_add_child(tree, ref, c, child);
+}
+
+/* 将结点或叶子挂到新结点下: 键在depth处结束的叶子挂在leaf上 */
+static int trie_attach(trie_tree_t *tree, void **ref, const u_char *str, int len, int depth, void *child)
+{
+    if (depth == len) {
+        ((trie_node_t *)*ref)->leaf = TRIE_LEAF(child);
+        return 0;
+    }
+
+    return trie_add_child(tree, ref, str[depth], child);
 }
 
 /******************************************************************************
@@ -70,34 +390,138 @@ trie_tree_t *trie_creat(trie_opt_t *opt)
  **输出参数: NONE
  **返    回: 0:成功 !0:失败
  **实现描述:
- **注意事项:
+ **     1. 遇到叶子: 键相同则替换数据, 否则新建NODE4, 公共部分作为压缩路径
+ **     2. 压缩路径不匹配: 在不匹配处拆分出新的NODE4
+ **     3. 键在内部结点处结束: 挂在该结点的leaf上
+ **     4. 否则沿孩子下降, 没有孩子时添加(必要时结点升级)
+ **注意事项: 键已存在时替换附加数据(与原实现一致)
  **作    者: # Qifeng.zou # 2015.05.12 #
  ******************************************************************************/
 int trie_insert(trie_tree_t *kwt, const u_char *str, int len, void *data)
 {
-    int i, max = len - 1;
-    trie_node_t *node = kwt->root;
+    int depth = 0, common, max;
+    void **ref = &kwt->root, **child;
+    trie_node_t *node, *new;
+    trie_leaf_t *leaf, *old;
 
     if (len <= 0) { return -1; }
 
-    for (i=0; i<len; ++i) {
-        node += str[i];
-        node->key = str[i];
-        if ((i < max) && (NULL == node->child)) {
-            node->child = (trie_node_t *)kwt->alloc(kwt->pool, kwt->max * sizeof(trie_node_t));
-            if (NULL == node->child) {
+    for (;;) {
+        /* > 空位置: 直接放入叶子 */
+        if (NULL == *ref) {
+            leaf = trie_leaf_alloc(kwt, str, len, data);
+            if (NULL == leaf) {
                 return -1;
             }
+            *ref = TRIE_SET_LEAF(leaf);
+            ++kwt->num;
+            return 0;
+        }
+
+        /* > 遇到叶子 */
+        if (TRIE_IS_LEAF(*ref)) {
+            old = TRIE_LEAF(*ref);
+            if (trie_leaf_equal(old, str, len)) {
+                old->data = data;
+                return 0;
+            }
+
+            max = MIN(old->len, len);
+            for (common=depth; (common < max) && (old->key[common] == str[common]); ++common) { NULL; }
+
+            new = trie_node_alloc(kwt, TRIE_NODE4);
+            if (NULL == new) {
+                return -1;
+            }
+            leaf = trie_leaf_alloc(kwt, str, len, data);
+            if (NULL == leaf) {
+                trie_dealloc(kwt, new, sizeof(trie_node4_t));
+                return -1;
+            }
+
+            new->prefix_len = common - depth;
+            memcpy(new->prefix, str + depth, MIN(common - depth, TRIE_PREFIX_MAX));
+
+            *ref = new;
+            trie_attach(kwt, ref, old->key, old->len, common, TRIE_SET_LEAF(old));
+            trie_attach(kwt, ref, str, len, common, TRIE_SET_LEAF(leaf));
+            ++kwt->num;
+            return 0;
+        }
+
+        /* > 内部结点: 比较压缩路径 */
+        node = (trie_node_t *)*ref;
+        if (node->prefix_len) {
+            common = trie_prefix_mismatch(node, str, len, depth);
+            if (common < (int)node->prefix_len) {
+                new = trie_node_alloc(kwt, TRIE_NODE4);
+                if (NULL == new) {
+                    return -1;
+                }
+                leaf = trie_leaf_alloc(kwt, str, len, data);
+                if (NULL == leaf) {
+                    trie_dealloc(kwt, new, sizeof(trie_node4_t));
+                    return -1;
+                }
+
+                new->prefix_len = common;
+                memcpy(new->prefix, node->prefix, MIN(common, TRIE_PREFIX_MAX));
+
+                /* 原结点的压缩路径去掉公共部分及分叉的一个字节 */
+                *ref = new;
+                if (node->prefix_len <= TRIE_PREFIX_MAX) {
+                    trie_add_child(kwt, ref, node->prefix[common], node);
+                    node->prefix_len -= common + 1;
+                    memmove(node->prefix, node->prefix + common + 1, node->prefix_len);
+                } else {
+                    old = trie_minimum(node);
+                    trie_add_child(kwt, ref, old->key[depth + common], node);
+                    node->prefix_len -= common + 1;
+                    memcpy(node->prefix, old->key + depth + common + 1,
+                            MIN((int)node->prefix_len, TRIE_PREFIX_MAX));
+                }
+
+                trie_attach(kwt, ref, str, len, depth + common, TRIE_SET_LEAF(leaf));
+                ++kwt->num;
+                return 0;
+            }
+            depth += node->prefix_len;
+        }
+
+        /* > 键在此结束 */
+        if (depth == len) {
+            if (NULL != node->leaf) {
+                node->leaf->data = data;
+                return 0;
+            }
+            node->leaf = trie_leaf_alloc(kwt, str, len, data);
+            if (NULL == node->leaf) {
+                return -1;
+            }
+            ++kwt->num;
+            return 0;
+        }
 
-            memset(node->child, 0, sizeof(trie_node_t));
-        } else if (i == max) {
-            node->data = data;
+        /* > 沿孩子下降 */
+        child = trie_find_child(node, str[depth]);
+        if (NULL == child) {
+            leaf = trie_leaf_alloc(kwt, str, len, data);
+            if (NULL == leaf) {
+                return -1;
+            }
+            if (trie_add_child(kwt, ref, str[depth], TRIE_SET_LEAF(leaf))) {
+                trie_dealloc(kwt, leaf, sizeof(trie_leaf_t) + len);
+                return -1;
+            }
+            ++kwt->num;
             return 0;
         }
-        node = node->child;
+
+        ref = child;
+        ++depth;
     }
 
-    return 0;
+    return -1;
 }
 
 /******************************************************************************
@@ -110,65 +534,304 @@ int trie_insert(trie_tree_t *kwt, const u_char *str, int len, void *data)
  **输出参数:
  **     data: 附加参数
  **返    回: 0:成功 !0:失败
- **实现描述:
+ **实现描述: 压缩路径只比较已保存的字节, 最终与叶子中的完整键比较
  **注意事项:
  **作    者: # Qifeng.zou # 2015.05.12 #
  ******************************************************************************/
 int trie_query(trie_tree_t *kwt, const u_char *str, int len, void **data)
 {
-    int i, max = len - 1;
-    trie_node_t *node = kwt->root;
-
-    /* 1. 搜索键树 */
-    for (i=0; i<len; ++i) {
-        node += str[i];
-        if (node->key != str[i]) {
-            *data = NULL;
+    int depth = 0, i, max;
+    void *p = kwt->root, **child;
+    trie_node_t *node;
+    trie_leaf_t *leaf = NULL;
+
+    *data = NULL;
+
+    while (NULL != p) {
+        if (TRIE_IS_LEAF(p)) {
+            leaf = TRIE_LEAF(p);
+            break;
+        }
+
+        node = (trie_node_t *)p;
+        if (node->prefix_len) {
+            if (depth + (int)node->prefix_len > len) {
+                return -1;
+            }
+            max = MIN((int)node->prefix_len, TRIE_PREFIX_MAX);
+            for (i=0; i<max; ++i) {
+                if (node->prefix[i] != str[depth + i]) {
+                    return -1;
+                }
+            }
+            depth += node->prefix_len;
+        }
+
+        if (depth == len) {
+            leaf = node->leaf;
+            break;
+        }
+
+        child = trie_find_child(node, str[depth]);
+        if (NULL == child) {
+            return -1;
+        }
+        p = *child;
+        ++depth;
+    }
+
+    if ((NULL == leaf) || !trie_leaf_equal(leaf, str, len)) {
+        return -1;
+    }
+
+    *data = leaf->data;
+    return 0;
+}
+
+/******************************************************************************
+ **函数名称: trie_match
+ **功    能: 最长前缀匹配
+ **输入参数:
+ **     kwt: 键树
+ **     str: 字串
+ **     len: 字串长度
+ **输出参数:
+ **     data: 最长的、是str前缀的键的附加数据
+ **返    回: 匹配的键长(-1: 无匹配)
+ **实现描述: 沿str下降, 途经的每个完整键(结点的leaf及叶子)都用完整键校验
+ **注意事项: 如: 插入"/a"和"/a/b/"后, 匹配"/a/b/c"返回"/a/b/"
+ **作    者: # Qifeng.zou # 2015.08.05 #
+ ******************************************************************************/
+int trie_match(trie_tree_t *kwt, const u_char *str, int len, void **data)
+{
+    int depth = 0;
+    void *p = kwt->root, **child;
+    trie_node_t *node;
+    trie_leaf_t *leaf, *best = NULL;
+
+    while (NULL != p) {
+        if (TRIE_IS_LEAF(p)) {
+            leaf = TRIE_LEAF(p);
+            if (trie_leaf_is_prefix(leaf, str, len)) {
+                best = leaf;
+            }
+            break;
+        }
+
+        node = (trie_node_t *)p;
+        if (node->prefix_len) {
+            if (trie_prefix_mismatch(node, str, len, depth) < (int)node->prefix_len) {
+                break;
+            }
+            depth += node->prefix_len;
+        }
+
+        if ((NULL != node->leaf) && trie_leaf_is_prefix(node->leaf, str, len)) {
+            best = node->leaf;
+        }
+
+        if (depth >= len) {
+            break;
+        }
+
+        child = trie_find_child(node, str[depth]);
+        if (NULL == child) {
+            break;
+        }
+        p = *child;
+        ++depth;
+    }
+
+    if (NULL == best) {
+        *data = NULL;
+        return -1;
+    }
+
+    *data = best->data;
+    return best->len;
+}
+
+/* 按键的顺序遍历子树 */
+static int trie_trav(void *p, trie_trav_cb_t proc, void *args)
+{
+    int i;
+    trie_leaf_t *leaf;
+    trie_node_t *node;
+    trie_node48_t *n48;
+    trie_node256_t *n256;
+
+    if (TRIE_IS_LEAF(p)) {
+        leaf = TRIE_LEAF(p);
+        return proc(leaf->key, leaf->len, leaf->data, args);
+    }
+
+    node = (trie_node_t *)p;
+    if (NULL != node->leaf) {
+        if (proc(node->leaf->key, node->leaf->len, node->leaf->data, args)) {
             return -1;
-        } else if (i == max) {
-            *data = node->data;
+        }
+    }
+
+    switch (node->type) {
+        case TRIE_NODE4:
+            for (i=0; i<node->num; ++i) {
+                if (trie_trav(((trie_node4_t *)node)->child[i], proc, args)) {
+                    return -1;
+                }
+            }
+            break;
+        case TRIE_NODE16:
+            for (i=0; i<node->num; ++i) {
+                if (trie_trav(((trie_node16_t *)node)->child[i], proc, args)) {
+                    return -1;
+                }
+            }
+            break;
+        case TRIE_NODE48:
+            n48 = (trie_node48_t *)node;
+            for (i=0; i<256; ++i) {
+                if (n48->idx[i] && trie_trav(n48->child[n48->idx[i] - 1], proc, args)) {
+                    return -1;
+                }
+            }
+            break;
+        default:
+            n256 = (trie_node256_t *)node;
+            for (i=0; i<256; ++i) {
+                if (n256->child[i] && trie_trav(n256->child[i], proc, args)) {
+                    return -1;
+                }
+            }
+            break;
+    }
+
+    return 0;
+}
+
+/******************************************************************************
+ **函数名称: trie_prefix_trav
+ **功    能: 遍历以prefix开头的所有键
+ **输入参数:
+ **     kwt: 键树
+ **     prefix: 前缀(len为0时遍历所有键)
+ **     len: 前缀长度
+ **     proc: 回调函数(返回非0时停止遍历)
+ **     args: 附加参数
+ **输出参数: NONE
+ **返    回: 0:成功 !0:失败
+ **实现描述: 沿前缀下降到前缀耗尽的子树, 用子树中的一个完整键校验后按序遍历
+ **注意事项: 遍历过程中禁止修改键树
+ **作    者: # Qifeng.zou # 2015.08.05 #
+ ******************************************************************************/
+int trie_prefix_trav(trie_tree_t *kwt, const u_char *prefix, int len, trie_trav_cb_t proc, void *args)
+{
+    int depth = 0;
+    void *p = kwt->root, **child;
+    trie_node_t *node;
+    trie_leaf_t *leaf;
+
+    while (NULL != p) {
+        if (TRIE_IS_LEAF(p)) {
+            leaf = TRIE_LEAF(p);
+            if ((leaf->len >= len) && (0 == memcmp(leaf->key, prefix, len))) {
+                return proc(leaf->key, leaf->len, leaf->data, args);
+            }
+            return 0;
+        }
+
+        node = (trie_node_t *)p;
+        if (depth + (int)node->prefix_len >= len) {
+            leaf = trie_minimum(node);
+            if ((leaf->len >= len) && (0 == memcmp(leaf->key, prefix, len))) {
+                return trie_trav(node, proc, args);
+            }
             return 0;
         }
 
-        node = node->child;
+        if (node->prefix_len) {
+            if (trie_prefix_mismatch(node, prefix, len, depth) < (int)node->prefix_len) {
+                return 0;
+            }
+            depth += node->prefix_len;
+        }
+
+        child = trie_find_child(node, prefix[depth]);
+        if (NULL == child) {
+            return 0;
+        }
+        p = *child;
+        ++depth;
     }
 
-    *data = NULL;
-    return -1;
+    return 0;
 }
 
 /******************************************************************************
- **函数名称: _kwt_print
+ **函数名称: _trie_print
  **功    能: 打印键树
  **输入参数:
- **     kwt: 键树
+ **     p: 结点
+ **     c: 结点在父结点中的键
+ **     depth: 深度
  **输出参数:
  **返    回: VOID
  **实现描述: 遍历打印树中所有结点
  **注意事项:
  **作    者: # Qifeng.zou # 2015.06.01 17:00:37 #
  ******************************************************************************/
-void _kwt_print(trie_tree_t *kwt, trie_node_t *node, int depth)
+static void _trie_print(void *p, int c, int depth)
 {
     int i, n;
-    trie_node_t *item = node;
+    trie_leaf_t *leaf;
+    trie_node_t *node;
+    static const int width[] = {4, 16, 48, 256};
 
-    for (i=0; i<kwt->max; ++i, ++item) {
-        if (0 == item->key) {
-            continue;
-        }
-
-        for (n=0; n<depth; ++n) {
-            fprintf(stderr, "| ");
-        }
+    for (n=0; n<depth; ++n) {
+        fprintf(stdout, "| ");
+    }
 
-        fprintf(stderr, "|%02X\n", item->key);
+    if (c >= 0) {
+        fprintf(stdout, "|%02X ", c);
+    }
 
-        if (NULL == item->child) {
-            continue;
-        }
+    if (TRIE_IS_LEAF(p)) {
+        leaf = TRIE_LEAF(p);
+        fprintf(stdout, "leaf:%.*s\n", leaf->len, leaf->key);
+        return;
+    }
 
-        _kwt_print(kwt, item->child, depth+1);
+    node = (trie_node_t *)p;
+    fprintf(stdout, "node%d num:%d prefix:%.*s(%u)%s%.*s\n",
+            width[node->type], node->num,
+            MIN((int)node->prefix_len, TRIE_PREFIX_MAX), node->prefix, node->prefix_len,
+            node->leaf? " leaf:" : "", node->leaf? node->leaf->len : 0,
+            node->leaf? (const char *)node->leaf->key : "");
+
+    switch (node->type) {
+        case TRIE_NODE4:
+            for (i=0; i<node->num; ++i) {
+                _trie_print(((trie_node4_t *)node)->child[i], ((trie_node4_t *)node)->key[i], depth+1);
+            }
+            break;
+        case TRIE_NODE16:
+            for (i=0; i<node->num; ++i) {
+                _trie_print(((trie_node16_t *)node)->child[i], ((trie_node16_t *)node)->key[i], depth+1);
+            }
+            break;
+        case TRIE_NODE48:
+            for (i=0; i<256; ++i) {
+                if (((trie_node48_t *)node)->idx[i]) {
+                    _trie_print(((trie_node48_t *)node)->child[((trie_node48_t *)node)->idx[i] - 1], i, depth+1);
+                }
+            }
+            break;
+        default:
+            for (i=0; i<256; ++i) {
+                if (((trie_node256_t *)node)->child[i]) {
+                    _trie_print(((trie_node256_t *)node)->child[i], i, depth+1);
+                }
+            }
+            break;
     }
 }
 
@@ -185,24 +848,48 @@ void _kwt_print(trie_tree_t *kwt, trie_node_t *node, int depth)
  ******************************************************************************/
 void trie_print(trie_tree_t *kwt)
 {
-    int i;
-    trie_node_t *node = kwt->root;
-
-    fprintf(stdout, "\n\n");
+    fprintf(stdout, "\n\nkeys:%lu memory:%zu\n", kwt->num, kwt->mem);
 
-    for (i=0; i<kwt->max; ++i, ++node) {
-        if (0 == node->key) {
-            continue;
-        }
+    if (NULL != kwt->root) {
+        _trie_print(kwt->root, -1, 0);
+    }
+}
 
-        fprintf(stdout, " %02X\n", node->key);
+/******************************************************************************
+ **函数名称: trie_creat
+ **功    能: 创建键树
+ **输入参数:
+ **     opt: 选项
+ **输出参数: NONE
+ **返    回: 键树
+ **实现描述:
+ **注意事项: 空树不占用结点, 结点随插入按需创建
+ **作    者: # Qifeng.zou # 2015.05.12 #
+ ******************************************************************************/
+trie_tree_t *trie_creat(trie_opt_t *opt)
+{
+    trie_opt_t _opt;
+    trie_tree_t *kwt;
 
-        if (NULL == node->child) {
-            continue;
-        }
+    if (NULL == opt) {
+        opt = &_opt;
+        opt->pool = (void *)NULL;
+        opt->alloc = (mem_alloc_cb_t)mem_alloc;
+        opt->dealloc = (mem_dealloc_cb_t)mem_dealloc;
+    }
 
-        _kwt_print(kwt, node->child, 1);
+    kwt = (trie_tree_t *)opt->alloc(opt->pool, sizeof(trie_tree_t));
+    if (NULL == kwt) {
+        return NULL;
     }
+
+    memset(kwt, 0, sizeof(trie_tree_t));
+
+    kwt->pool = opt->pool;
+    kwt->alloc = opt->alloc;
+    kwt->dealloc = opt->dealloc;
+
+    return kwt;
 }
 
 /******************************************************************************
@@ -227,6 +914,15 @@ void trie_destroy(trie_tree_t *kwt, void *mempool, mem_dealloc_cb_t dealloc)
     kwt->dealloc(kwt->pool, kwt);
 }
 
+/* 销毁叶子 */
+static void trie_leaf_free(trie_tree_t *kwt, trie_leaf_t *leaf, void *mempool, mem_dealloc_cb_t dealloc)
+{
+    if (NULL != dealloc) {
+        dealloc(mempool, leaf->data);
+    }
+    trie_dealloc(kwt, leaf, sizeof(trie_leaf_t) + leaf->len);
+}
+
 /******************************************************************************
  **函数名称: trie_node_free
  **功    能: 销毁键树结点
@@ -241,18 +937,49 @@ void trie_destroy(trie_tree_t *kwt, void *mempool, mem_dealloc_cb_t dealloc)
  **注意事项:
  **作    者: # Qifeng.zou # 2015.05.12 #
  ******************************************************************************/
-static void trie_node_free(trie_tree_t *kwt, trie_node_t *node, void *mempool, mem_dealloc_cb_t dealloc)
+static void trie_node_free(trie_tree_t *kwt, void *p, void *mempool, mem_dealloc_cb_t dealloc)
 {
     int i;
+    trie_node_t *node;
+    trie_node48_t *n48;
+    trie_node256_t *n256;
 
-    for (i=0;i<kwt->max; ++i) {
-        if (NULL == node[i].child) {
-            continue;
-        }
-        dealloc(mempool, node[i].data);
-        trie_node_free(kwt, node[i].child, mempool, dealloc);
-        node[i].child = NULL;
+    if (TRIE_IS_LEAF(p)) {
+        trie_leaf_free(kwt, TRIE_LEAF(p), mempool, dealloc);
+        return;
+    }
+
+    node = (trie_node_t *)p;
+    if (NULL != node->leaf) {
+        trie_leaf_free(kwt, node->leaf, mempool, dealloc);
+    }
+
+    switch (node->type) {
+        case TRIE_NODE4:
+            for (i=0; i<node->num; ++i) {
+                trie_node_free(kwt, ((trie_node4_t *)node)->child[i], mempool, dealloc);
+            }
+            break;
+        case TRIE_NODE16:
+            for (i=0; i<node->num; ++i) {
+                trie_node_free(kwt, ((trie_node16_t *)node)->child[i], mempool, dealloc);
+            }
+            break;
+        case TRIE_NODE48:
+            n48 = (trie_node48_t *)node;
+            for (i=0; i<node->num; ++i) {
+                trie_node_free(kwt, n48->child[i], mempool, dealloc);
+            }
+            break;
+        default:
+            n256 = (trie_node256_t *)node;
+            for (i=0; i<256; ++i) {
+                if (NULL != n256->child[i]) {
+                    trie_node_free(kwt, n256->child[i], mempool, dealloc);
+                }
+            }
+            break;
     }
 
-    kwt->dealloc(kwt->pool, node);
+    trie_dealloc(kwt, node, trie_node_size(node->type));
 }
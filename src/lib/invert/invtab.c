@@ -99,7 +99,7 @@ static invt_dic_word_t *invt_word_add(invt_tab_t *tab, char *word, int len)
     int idx;
     invt_dic_word_t *dw;
 
-    idx = hash_time33(word) % tab->mod;
+    idx = hash_default_str(word) % tab->mod;
 
     /* > 创建数据对象 */
     dw = tab->alloc(tab->pool, sizeof(invt_dic_word_t));
@@ -228,7 +228,7 @@ int invtab_insert(invt_tab_t *tab, char *word, const char *url, int freq)
     char_to_lower(word, lower_word, len);
 
     /* > 查找单词项 */
-    idx = hash_time33(lower_word) % tab->mod;
+    idx = hash_default_str(lower_word) % tab->mod;
 
     key.word.len = len;
     key.word.str = lower_word;
@@ -276,7 +276,7 @@ invt_dic_word_t *invtab_query(invt_tab_t *tab, char *word)
     char_to_lower(word, lower_word, len);
 
     /* > 查找关键字 */
-    idx = hash_time33_ex(lower_word, len) % tab->mod;
+    idx = hash_default(lower_word, len) % tab->mod;
 
     key.word.len = len;
     key.word.str = lower_word;
@@ -310,7 +310,7 @@ int invtab_remove(invt_tab_t *tab, char *word)
     char_to_lower(word, lower_word, len);
 
     /* > 删除关键字 */
-    idx = hash_time33(lower_word) % tab->mod;
+    idx = hash_default_str(lower_word) % tab->mod;
 
     key.word.len = len;
     key.word.str = lower_word;
@@ -188,7 +188,7 @@ static int rtmq_proxy_creat_recvq(rtmq_proxy_t *pxy)
 
     /* > 创建接收队列 */
     for (idx=0; idx<conf->work_thd_num; ++idx) {
-        pxy->recvq[idx] = queue_creat(conf->recvq.max, conf->recvq.size);
+        pxy->recvq[idx] = queue_creat_ex(conf->recvq.max, conf->recvq.min, conf->recvq.size);
         if (NULL == pxy->recvq[idx]) {
             log_error(pxy->log, "Create recvq failed!");
             return RTMQ_ERR;
@@ -223,7 +223,7 @@ static int rtmq_proxy_creat_sendq(rtmq_proxy_t *pxy)
 
     /* > 创建发送队列 */
     for (idx=0; idx<conf->send_thd_num; ++idx) {
-        pxy->sendq[idx] = queue_creat(conf->sendq.max, conf->sendq.size);
+        pxy->sendq[idx] = queue_creat_ex(conf->sendq.max, conf->sendq.min, conf->sendq.size);
         if (NULL == pxy->sendq[idx]) {
             log_error(pxy->log, "Create send queue failed!");
             return RTMQ_ERR;
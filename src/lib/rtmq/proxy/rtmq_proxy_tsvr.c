@@ -615,17 +615,16 @@ static int rtmq_proxy_tsvr_wiov_add(rtmq_proxy_tsvr_t *tsvr, rtmq_proxy_sck_t *s
 
     /* > 从发送队列取数据 */
     for (;;) {
-        /* > 判断剩余空间(WARNNING: 勿将共享变量参与三目运算, 否则可能出现严重错误!!!) */
+        /* > 判断剩余空间 */
         num = MIN(wiov_left_space(send), RTSD_POP_NUM);
-        num = MIN(num, queue_used(tsvr->sendq));
         if (0 == num) {
             break; /* 空间不足 */
         }
 
         /* > 弹出发送数据 */
-        num = queue_mpop(tsvr->sendq, data, num);
+        num = queue_pop_burst(tsvr->sendq, data, num);
         if (0 == num) {
-            continue;
+            break; /* 无数据 */
         }
 
         log_trace(tsvr->log, "Multi-pop num:%d!", num);
@@ -787,9 +786,9 @@ static int rtmq_proxy_tsvr_exp_mesg_proc(
 
     ++tsvr->recv_total;
 
-    /* > 验证长度 */
+    /* > 验证长度(分级队列可申请任意大小) */
     len = RTMQ_DATA_TOTAL_LEN(head);
-    if ((int)len > queue_size(pxy->recvq[0])) {
+    if (queue_isfixed(pxy->recvq[0]) && ((int)len > queue_size(pxy->recvq[0]))) {
         ++tsvr->drop_total;
         log_error(pxy->log, "Data is too long! len:%d drop:%lu total:%lu",
                 len, tsvr->drop_total, tsvr->recv_total);
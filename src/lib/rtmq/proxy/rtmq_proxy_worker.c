@@ -225,16 +225,11 @@ static int rtmq_proxy_worker_cmd_proc_req_hdl(rtmq_proxy_t *pxy, rtmq_worker_t *
 
     while (1) {
         /* > 从接收队列获取数据 */
-        num = MIN(queue_used(rq), RTSD_WORK_POP_NUM);
+        num = queue_pop_burst(rq, addr, RTSD_WORK_POP_NUM);
         if (0 == num) {
             return RTMQ_OK;
         }
 
-        num = queue_mpop(rq, addr, num);
-        if (0 == num) {
-            continue;
-        }
-
         log_trace(worker->log, "Multi-pop num:%d!", num);
 
         for (idx=0; idx<num; ++idx) {
@@ -55,20 +55,14 @@ int rtmq_link_auth_check(rtmq_cntx_t *ctx, rtmq_link_auth_req_t *auth)
  **     ctx: 全局对象
  **输出参数: NONE
  **返    回: 0:成功 !0:失败
- **实现描述: 构建平衡二叉树
+ **实现描述: 构建B+树(以nid为主键, 每条消息都要查询, 读远多于写)
  **注意事项:
  **作    者: # Qifeng.zou # 2015.05.30 20:29:26 #
  ******************************************************************************/
-static int64_t rtmq_node_to_svr_map_cmp_cb(
-        const rtmq_node_to_svr_map_t *map1, const rtmq_node_to_svr_map_t *map2)
-{
-    return (int64_t)(map1->nid - map2->nid);
-}
-
 int rtmq_node_to_svr_map_init(rtmq_cntx_t *ctx)
 {
     /* > 创建映射表 */
-    ctx->node_to_svr_map = avl_creat(NULL, (cmp_cb_t)rtmq_node_to_svr_map_cmp_cb);
+    ctx->node_to_svr_map = bptree_creat(NULL);
     if (NULL == ctx->node_to_svr_map) {
         log_error(ctx->log, "Initialize dev->svr map failed!");
         return RTMQ_ERR;
@@ -95,14 +89,13 @@ int rtmq_node_to_svr_map_init(rtmq_cntx_t *ctx)
  ******************************************************************************/
 int rtmq_node_to_svr_map_add(rtmq_cntx_t *ctx, int nid, int rsvr_id)
 {
-    rtmq_node_to_svr_map_t *map, key;
-
-    key.nid = nid;
+    uint64_t key = (uint64_t)nid;
+    rtmq_node_to_svr_map_t *map;
 
     pthread_rwlock_wrlock(&ctx->node_to_svr_map_lock); /* 加锁 */
 
     /* > 查找是否已经存在 */
-    map = avl_query(ctx->node_to_svr_map, &key);
+    map = bptree_query(ctx->node_to_svr_map, &key, sizeof(key));
     if (NULL == map) {
         map = (rtmq_node_to_svr_map_t *)calloc(1, sizeof(rtmq_node_to_svr_map_t));
         if (NULL == map) {
@@ -114,7 +107,7 @@ int rtmq_node_to_svr_map_add(rtmq_cntx_t *ctx, int nid, int rsvr_id)
         map->num = 0;
         map->nid = nid;
 
-        if (avl_insert(ctx->node_to_svr_map, (void *)map)) {
+        if (bptree_insert(ctx->node_to_svr_map, &key, sizeof(key), (void *)map)) {
             pthread_rwlock_unlock(&ctx->node_to_svr_map_lock); /* 解锁 */
             FREE(map);
             log_error(ctx->log, "Insert into dev2sck table failed! nid:%d rsvr_id:%d",
@@ -153,14 +146,13 @@ int rtmq_node_to_svr_map_add(rtmq_cntx_t *ctx, int nid, int rsvr_id)
 int rtmq_node_to_svr_map_del(rtmq_cntx_t *ctx, int nid, int rsvr_id)
 {
     int idx;
-    rtmq_node_to_svr_map_t *map, key;
-
-    key.nid = nid;
+    uint64_t key = (uint64_t)nid;
+    rtmq_node_to_svr_map_t *map;
 
     pthread_rwlock_wrlock(&ctx->node_to_svr_map_lock);
 
     /* > 查找映射表 */
-    map = avl_query(ctx->node_to_svr_map, &key);
+    map = bptree_query(ctx->node_to_svr_map, &key, sizeof(key));
     if (NULL == map) {
         pthread_rwlock_unlock(&ctx->node_to_svr_map_lock);
         log_error(ctx->log, "Query nid [%d] failed!", nid);
@@ -172,7 +164,7 @@ int rtmq_node_to_svr_map_del(rtmq_cntx_t *ctx, int nid, int rsvr_id)
         if (map->rsvr_id[idx] == rsvr_id) {
             map->rsvr_id[idx] = map->rsvr_id[--map->num]; /* 删除:使用最后一个值替代当前值 */
             if (0 == map->num) {
-                avl_delete(ctx->node_to_svr_map, &key, (void *)&map);
+                bptree_delete(ctx->node_to_svr_map, &key, sizeof(key), (void **)&map);
                 FREE(map);
             }
             break;
@@ -198,14 +190,13 @@ int rtmq_node_to_svr_map_del(rtmq_cntx_t *ctx, int nid, int rsvr_id)
 int rtmq_node_to_svr_map_rand(rtmq_cntx_t *ctx, int nid)
 {
     int rsvr_id;
-    rtmq_node_to_svr_map_t *map, key;
-
-    key.nid = nid;
+    uint64_t key = (uint64_t)nid;
+    rtmq_node_to_svr_map_t *map;
 
     pthread_rwlock_rdlock(&ctx->node_to_svr_map_lock);
 
     /* > 获取映射表 */
-    map = avl_query(ctx->node_to_svr_map, &key);
+    map = bptree_query(ctx->node_to_svr_map, &key, sizeof(key));
     if (NULL == map) {
         pthread_rwlock_unlock(&ctx->node_to_svr_map_lock);
         log_error(ctx->log, "Query nid [%d] failed!", nid);
@@ -249,7 +240,7 @@ static int64_t rtmq_sub_tab_cmp_cb(const rtmq_sub_list_t *list1, const rtmq_sub_
 int rtmq_sub_init(rtmq_cntx_t *ctx)
 {
     /* > 创建订阅表 */
-    ctx->sub = hash_tab_creat(100,
+    ctx->sub = hash_map_creat(100,
             (hash_cb_t)rtmq_sub_tab_hash_cb,
             (cmp_cb_t)rtmq_sub_tab_cmp_cb, NULL);
     if (NULL == ctx->sub) {
@@ -423,7 +414,7 @@ int rtmq_sub_add(rtmq_cntx_t *ctx, rtmq_sck_t *sck, int type)
 QUERY_SUB_TAB:
     key.type = type;
 
-    list = (rtmq_sub_list_t *)hash_tab_query(ctx->sub, (void *)&key, WRLOCK);
+    list = (rtmq_sub_list_t *)hash_map_query(ctx->sub, (void *)&key, WRLOCK);
     if (NULL == list) {
         list = (rtmq_sub_list_t *)rtmq_sub_list_alloc(type);
         if (NULL == list) {
@@ -431,7 +422,7 @@ QUERY_SUB_TAB:
             return RTMQ_ERR;
         }
 
-        if (hash_tab_insert(ctx->sub, (void *)list, WRLOCK)) {
+        if (hash_map_insert(ctx->sub, (void *)list, WRLOCK)) {
             rtmq_sub_list_dealloc(list);
             log_error(ctx->log, "Insert sub table failed! type:0x%04X", type);
             return RTMQ_ERR;
@@ -447,7 +438,7 @@ QUERY_SUB_GROUP:
     if (NULL == group) {
         group = rtmq_sub_group_alloc(sck->gid);
         if (NULL == group) {
-            hash_tab_unlock(ctx->sub, &key, WRLOCK);
+            hash_map_unlock(ctx->sub, &key, WRLOCK);
             log_error(ctx->log, "errmsg:[%d] %s!", errno, strerror(errno));
             return RTMQ_ERR;
         }
@@ -463,26 +454,26 @@ QUERY_SUB_GROUP:
     node = vector_find(group->nodes,
             (find_cb_t)rtmq_sub_group_find_sid_cb, (void *)&sck->sid);
     if (NULL != node) {
-        hash_tab_unlock(ctx->sub, &key, WRLOCK);
+        hash_map_unlock(ctx->sub, &key, WRLOCK);
         return RTMQ_OK; /* 已订阅 */
     }
 
     /* 4. 将连接加入订阅列表的分组中... */
     node = rtmq_sub_node_alloc(sck->nid, sck->sid);
     if (NULL == node) {
-        hash_tab_unlock(ctx->sub, &key, WRLOCK);
+        hash_map_unlock(ctx->sub, &key, WRLOCK);
         log_error(ctx->log, "Alloc sub node failed! nid:%d sid:%d", sck->nid, sck->sid);
         return RTMQ_ERR;
     }
 
     if (vector_append(group->nodes, (void *)node)) {
-        hash_tab_unlock(ctx->sub, &key, WRLOCK);
+        hash_map_unlock(ctx->sub, &key, WRLOCK);
         rtmq_sub_node_dealloc(node);
         log_error(ctx->log, "Add sub node failed! nid:%d sid:%d", sck->nid, sck->sid);
         return RTMQ_ERR;
     }
 
-    hash_tab_unlock(ctx->sub, &key, WRLOCK);
+    hash_map_unlock(ctx->sub, &key, WRLOCK);
 
     log_debug(ctx->log, "Add sub success! type:0x%04X gid:%u nid:%u",
             type, sck->gid, sck->nid);
@@ -510,7 +501,7 @@ int rtmq_sub_del(rtmq_cntx_t *ctx, rtmq_sck_t *sck, int type)
 
     /* 1. 查询订阅列表 */
     key.type = type;
-    list = (rtmq_sub_list_t *)hash_tab_query(ctx->sub, &key, WRLOCK);
+    list = (rtmq_sub_list_t *)hash_map_query(ctx->sub, &key, WRLOCK);
     if (NULL == list) {
         return 0; /* 无数据 */
     }
@@ -526,7 +517,7 @@ int rtmq_sub_del(rtmq_cntx_t *ctx, rtmq_sck_t *sck, int type)
     node = vector_find_and_del(group->nodes,
             (find_cb_t)rtmq_sub_group_find_sid_cb, (void *)&sck->sid);
     if (NULL == node) {
-        hash_tab_unlock(ctx->sub, &key, WRLOCK);
+        hash_map_unlock(ctx->sub, &key, WRLOCK);
         return 0; /* 未订阅 */
     }
 
@@ -537,11 +528,11 @@ int rtmq_sub_del(rtmq_cntx_t *ctx, rtmq_sck_t *sck, int type)
         avl_delete(list->groups, &gkey, (void **)&group);
         rtmq_sub_group_dealloc(group);
         if (0 == avl_num(list->groups)) {
-            hash_tab_delete(ctx->sub, &key, NONLOCK);
+            hash_map_delete(ctx->sub, &key, NONLOCK);
             rtmq_sub_list_dealloc(list);
         }
     }
-    hash_tab_unlock(ctx->sub, &key, WRLOCK);
+    hash_map_unlock(ctx->sub, &key, WRLOCK);
 
     return 0;
 }
@@ -80,6 +80,12 @@ rtmq_cntx_t *rtmq_init(const rtmq_conf_t *cf, log_cycle_t *log)
     memcpy(conf, cf, sizeof(rtmq_conf_t));  /* 配置信息 */
     conf->recvq_num = RTMQ_WORKER_HDL_QNUM * cf->work_thd_num;
 
+    /* > 注册跟踪阶段(由trace_init()启用跟踪) */
+    trace_stage(RTMQ_TRACE_READ, "read");
+    trace_stage(RTMQ_TRACE_PUSH, "push");
+    trace_stage(RTMQ_TRACE_DISPATCH, "dispatch");
+    trace_stage(RTMQ_TRACE_DONE, "done");
+
     do {
         /* > 构建鉴权表 */
         if (rtmq_auth_init(ctx)) {
@@ -339,7 +345,7 @@ int rtmq_publish(rtmq_cntx_t *ctx, int type, void *data, size_t len)
     /* > 查找消息订阅列表 */
     key.type = type;
 
-    list = hash_tab_query(ctx->sub, &key, RDLOCK);
+    list = hash_map_query(ctx->sub, &key, RDLOCK);
     if (NULL == list) {
         log_error(ctx->log, "No node sub this message! type:0x%04X", type);
         return -1;
@@ -353,7 +359,7 @@ int rtmq_publish(rtmq_cntx_t *ctx, int type, void *data, size_t len)
 
     avl_trav(list->groups, rtmq_pub_group_trav_cb, &item);
 
-    hash_tab_unlock(ctx->sub, &key, RDLOCK);
+    hash_map_unlock(ctx->sub, &key, RDLOCK);
 
     return RTMQ_OK;
 }
@@ -264,6 +264,11 @@ int rtmq_rsvr_init(rtmq_cntx_t *ctx, rtmq_rsvr_t *rsvr, int id)
 
     rsvr->cmd_fd = ctx->recv_cmd_fd[id].fd[0];
 
+    /* > 注册统计项(各接收线程共用) */
+    rsvr->recv_metric = metrics_counter("rtmq.rsvr.recv");
+    rsvr->err_metric = metrics_counter("rtmq.rsvr.err");
+    rsvr->drop_metric = metrics_counter("rtmq.rsvr.drop");
+
     /* > 创建套接字链表 */
     rsvr->conn_list = list2_creat(NULL);
     if (NULL == rsvr->conn_list) {
@@ -530,6 +535,9 @@ static int rtmq_rsvr_recv_proc(rtmq_cntx_t *ctx, rtmq_rsvr_t *rsvr, rtmq_sck_t *
         n = read(sck->fd, recv->iptr, left);
         if (n > 0) {
             recv->iptr += n;
+            if (g_trace_rate) {
+                rsvr->read_tsc = cpu_ticket_get();
+            }
 
             /* 2. 进行数据处理 */
             if (rtmq_rsvr_data_proc(ctx, rsvr, sck)) {
@@ -627,6 +635,7 @@ static int rtmq_rsvr_data_proc(rtmq_cntx_t *ctx, rtmq_rsvr_t *rsvr, rtmq_sck_t *
         /* 2.2 校验合法性 */
         if (!RTMQ_HEAD_ISVALID(head)) {
             ++rsvr->err_total;
+            metrics_counter_inc(rsvr->err_metric);
             log_error(rsvr->log, "Header is invalid! Mark:%u/%u type:0x%04X len:%d flag:%d",
                     head->chksum, RTMQ_CHKSUM_VAL, head->type, head->length, head->flag);
             return RTMQ_ERR;
@@ -715,11 +724,13 @@ static int rtmq_rsvr_exp_mesg_proc(rtmq_cntx_t *ctx,
     }
 
     ++rsvr->recv_total; /* 总数 */
+    metrics_counter_inc(rsvr->recv_metric);
     len = sizeof(rtmq_header_t) + head->length;
 
     /* > 合法性验证 */
     if (head->nid != sck->nid) {
         ++rsvr->drop_total;
+        metrics_counter_inc(rsvr->drop_metric);
         log_error(rsvr->log, "Devid isn't right! nid:%d/%d", head->nid, sck->nid);
         return RTMQ_ERR;
     }
@@ -731,6 +742,7 @@ static int rtmq_rsvr_exp_mesg_proc(rtmq_cntx_t *ctx,
     item = queue_malloc(rq, sizeof(rtmq_recv_item_t));
     if (NULL == item) {
         ++rsvr->drop_total; /* 丢弃计数 */
+        metrics_counter_inc(rsvr->drop_metric);
         rtmq_rsvr_cmd_proc_all_req(ctx, rsvr);
         log_error(rsvr->log, "Alloc from queue failed! recv:%llu drop:%llu error:%llu len:%d",
                 rsvr->recv_total, rsvr->drop_total, rsvr->err_total, len);
@@ -741,6 +753,11 @@ static int rtmq_rsvr_exp_mesg_proc(rtmq_cntx_t *ctx,
 
     item->base = base;
     item->data = data;
+    item->trace_id = trace_sample();
+    if (item->trace_id) {
+        trace_record(item->trace_id, RTMQ_TRACE_READ, head->type, rsvr->read_tsc);
+        trace_event(item->trace_id, RTMQ_TRACE_PUSH, head->type);
+    }
 
     queue_push(rq, item);
 
@@ -1160,7 +1177,7 @@ int rtmq_rsvr_sck_sub_item_free(rtmq_rsvr_sck_sub_trav_t *args, rtmq_sub_req_t *
     /* 1. 查找订阅列表 */
     key.type = req->type;
 
-    list = hash_tab_query(ctx->sub, &key, WRLOCK);
+    list = hash_map_query(ctx->sub, &key, WRLOCK);
     if (NULL == list) {
         return 0;
     }
@@ -1170,14 +1187,14 @@ int rtmq_rsvr_sck_sub_item_free(rtmq_rsvr_sck_sub_trav_t *args, rtmq_sub_req_t *
 
     group = avl_query(list->groups, &gkey);
     if (NULL == group) {
-        hash_tab_unlock(ctx->sub, &key, WRLOCK);
+        hash_map_unlock(ctx->sub, &key, WRLOCK);
         return 0;
     }
 
     /* 3. 从订阅列表分组中删除指定连接 */
     node = vector_find_and_del(group->nodes, (find_cb_t)rtmq_sub_group_find_sid_cb, &sck->sid);
     if (NULL == node) {
-        hash_tab_unlock(ctx->sub, &key, WRLOCK);
+        hash_map_unlock(ctx->sub, &key, WRLOCK);
         return 0;
     }
 
@@ -1188,11 +1205,11 @@ int rtmq_rsvr_sck_sub_item_free(rtmq_rsvr_sck_sub_trav_t *args, rtmq_sub_req_t *
         avl_delete(list->groups, &gkey, (void **)&group);
         rtmq_sub_group_dealloc(group);
         if (0 == avl_num(list->groups)) {
-            hash_tab_delete(ctx->sub, &key, NONLOCK);
+            hash_map_delete(ctx->sub, &key, NONLOCK);
             rtmq_sub_list_dealloc(list);
         }
     }
-    hash_tab_unlock(ctx->sub, &key, WRLOCK);
+    hash_map_unlock(ctx->sub, &key, WRLOCK);
 
     free(req);
     return 0;
@@ -1268,16 +1285,11 @@ static int rtmq_rsvr_add_conn_hdl(rtmq_cntx_t *ctx, rtmq_rsvr_t *rsvr)
     connq = ctx->connq[rsvr->id];
     while (1) {
         /* > 获取新建连接 */
-        num = MIN(queue_used(connq), RTMQ_CONNQ_LEN);
+        num = queue_pop_burst(connq, (void **)item, RTMQ_CONNQ_LEN);
         if (0 == num) {
             return RTMQ_OK;
         }
 
-        num = queue_mpop(connq, (void **)item, num);
-        if (0 == num) {
-            continue;
-        }
-
         for (idx=0; idx<num; ++idx) {
             /* > 创建套接字对象 */
             sck = rtmq_rsvr_sck_creat(rsvr, item[idx]);
@@ -1492,17 +1504,12 @@ static int rtmq_rsvr_dist_data(rtmq_cntx_t *ctx, rtmq_rsvr_t *rsvr)
 
     while (1) {
         /* > 弹出队列数据 */
-        num = MIN(ring_used(sendq), RTRD_POP_MAX_NUM);
+        num = ring_pop_burst(sendq, data, RTRD_POP_MAX_NUM);
         if (0 == num) {
             break;
         }
 
-        num = ring_mpop(sendq, data, num);
-        if (0 == num) {
-            continue;
-        }
-
-        log_trace(ctx->log, "Multi-pop num:%d!", num);
+        log_btrace(ctx->log, "Multi-pop num:%d!", num);
 
         /* > 逐条处理数据 */
         for (idx=0; idx<num; ++idx) {
@@ -1532,7 +1539,7 @@ static int rtmq_rsvr_dist_data(rtmq_cntx_t *ctx, rtmq_rsvr_t *rsvr)
             /* > 回收内存空间[注: 无需释放结点数据空间] */
             list_destroy(cl.list, mem_dummy_dealloc, NULL);
 
-            log_trace(ctx->log, "Select upstream! fd:%d nid:%d sid:%d",
+            log_btrace(ctx->log, "Select upstream! fd:%d nid:%d sid:%d",
                     sck->fd, sck->nid, sck->sid);
 
 
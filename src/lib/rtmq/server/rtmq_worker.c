@@ -139,6 +139,11 @@ int rtmq_worker_init(rtmq_cntx_t *ctx, rtmq_worker_t *worker, int id)
 
     worker->cmd_fd = ctx->work_cmd_fd[id].fd[0];
 
+    /* > 注册统计项(各工作线程共用) */
+    worker->proc_metric = metrics_counter("rtmq.worker.proc");
+    worker->drop_metric = metrics_counter("rtmq.worker.drop");
+    worker->err_metric = metrics_counter("rtmq.worker.err");
+
     return RTMQ_OK;
 }
 
@@ -207,20 +212,17 @@ static int rtmq_worker_cmd_proc_req_hdl(rtmq_cntx_t *ctx, rtmq_worker_t *worker,
 
     while (1) {
         /* > 从接收队列获取数据 */
-        num = MIN(queue_used(rq), RTRD_WORK_POP_NUM);
+        num = queue_pop_burst(rq, (void **)item, RTRD_WORK_POP_NUM);
         if (0 == num) {
             return RTMQ_OK;
         }
 
-        num = queue_mpop(rq, (void **)item, num);
-        if (0 == num) {
-            continue;
-        }
-
         /* > 依次处理各条数据 */
         for (idx=0; idx<num; ++idx) {
             head = (rtmq_header_t *)item[idx]->data;
 
+            trace_event(item[idx]->trace_id, RTMQ_TRACE_DISPATCH, head->type);
+
             key.type = head->type;
 
             reg = (rtmq_reg_t *)avl_query(ctx->reg, (void *)&key);
@@ -229,6 +231,7 @@ static int rtmq_worker_cmd_proc_req_hdl(rtmq_cntx_t *ctx, rtmq_worker_t *worker,
                 reg = (rtmq_reg_t *)avl_query(ctx->reg, (void *)&key);
                 if (NULL == reg) {
                     ++worker->drop_total;   /* 丢弃计数 */
+                    metrics_counter_inc(worker->drop_metric);
                     mref_dec(item[idx]->base);
                     queue_dealloc(rq, (void *)item[idx]);
                     log_trace(ctx->log, "Drop data! type:%u", head->type);
@@ -239,10 +242,14 @@ static int rtmq_worker_cmd_proc_req_hdl(rtmq_cntx_t *ctx, rtmq_worker_t *worker,
             if (reg->proc(head->type, head->nid,
                 (void *)(head + 1), head->length, reg->param)) {
                 ++worker->err_total;    /* 错误计数 */
+                metrics_counter_inc(worker->err_metric);
             } else {
                 ++worker->proc_total;   /* 处理计数 */
+                metrics_counter_inc(worker->proc_metric);
             }
 
+            trace_event(item[idx]->trace_id, RTMQ_TRACE_DONE, head->type);
+
             /* > 释放内存空间 */
             mref_dec(item[idx]->base);
             queue_dealloc(rq, (void *)item[idx]);
@@ -1,4 +1,5 @@
 #include "redo.h"
+#include "evfd.h"
 #include "sdtp_mesg.h"
 #include "sdtp_comm.h"
 #include "sdrd_recv.h"
@@ -62,22 +63,6 @@ int sdrd_link_auth_check(sdrd_cntx_t *ctx, sdtp_link_auth_req_t *link_auth_req)
     return SDTP_LINK_AUTH_SUCC;
 }
 
-/******************************************************************************
- **函数名称: sdrd_node_svr_map_cmp_cb
- **功    能: 比较回调函数
- **输入参数:
- **输出参数: NONE
- **返    回: 
- **实现描述: 
- **注意事项:
- **作    者: # Qifeng.zou # 2016.08.09 14:15:45 #
- ******************************************************************************/
-static int64_t sdrd_node_svr_map_cmp_cb(
-        const sdrd_dev_to_rsvr_map_t *map1, const sdrd_dev_to_rsvr_map_t *map2)
-{
-    return (int64_t)(map1->nid - map2->nid);
-}
-
 /******************************************************************************
  **函数名称: sdrd_node_to_svr_map_init
  **功    能: 创建NODE与SVR的映射表
@@ -85,7 +70,7 @@ static int64_t sdrd_node_svr_map_cmp_cb(
  **     ctx: 全局对象
  **输出参数: NONE
  **返    回: 0:成功 !0:失败
- **实现描述: 构建平衡二叉树
+ **实现描述: 构建B+树(以nid为主键, 每条消息都要查询, 读远多于写)
  **注意事项:
  **作    者: # Qifeng.zou # 2015.05.30 20:29:26 #
  ******************************************************************************/
@@ -93,7 +78,7 @@ int sdrd_node_to_svr_map_init(sdrd_cntx_t *ctx)
 {
     pthread_rwlock_init(&ctx->node_to_svr_map_lock, NULL);
 
-    ctx->node_to_svr_map = avl_creat(NULL, (cmp_cb_t)sdrd_node_svr_map_cmp_cb);
+    ctx->node_to_svr_map = bptree_creat(NULL);
     if (NULL == ctx->node_to_svr_map) {
         log_error(ctx->log, "Initialize dev->svr map failed!");
         return SDTP_ERR;
@@ -117,17 +102,16 @@ int sdrd_node_to_svr_map_init(sdrd_cntx_t *ctx)
  ******************************************************************************/
 int sdrd_node_to_svr_map_add(sdrd_cntx_t *ctx, int nid, int rsvr_idx)
 {
+    uint64_t key = (uint64_t)nid;
     list_node_t *list_node;
     sdrd_node_to_svr_item_t *item;
-    sdrd_dev_to_rsvr_map_t *map, key;
-
-    key.nid = nid;
+    sdrd_dev_to_rsvr_map_t *map;
 
     pthread_rwlock_wrlock(&ctx->node_to_svr_map_lock); /* 加锁 */
 
     while (1) {
         /* > 查找是否已经存在 */
-        map = avl_query(ctx->node_to_svr_map, &key);
+        map = bptree_query(ctx->node_to_svr_map, &key, sizeof(key));
         if (NULL == map) {
             map = (sdrd_dev_to_rsvr_map_t *)calloc(1, sizeof(sdrd_dev_to_rsvr_map_t));
             if (NULL == map) {
@@ -144,7 +128,7 @@ int sdrd_node_to_svr_map_add(sdrd_cntx_t *ctx, int nid, int rsvr_idx)
                 return SDTP_ERR;
             }
 
-            if (avl_insert(ctx->node_to_svr_map, map)) {
+            if (bptree_insert(ctx->node_to_svr_map, &key, sizeof(key), map)) {
                 pthread_rwlock_unlock(&ctx->node_to_svr_map_lock); /* 解锁 */
                 log_error(ctx->log, "Insert into dev2sck table failed! nid:%d rsvr_idx:%d",
                         nid, rsvr_idx);
@@ -212,15 +196,14 @@ int sdrd_node_to_svr_map_del(sdrd_cntx_t *ctx, int nid, int rsvr_idx)
 {
     list_t *list;
     list_node_t *node;
+    uint64_t key = (uint64_t)nid;
     sdrd_node_to_svr_item_t *item;
-    sdrd_dev_to_rsvr_map_t *map, key;
-
-    key.nid = nid;
+    sdrd_dev_to_rsvr_map_t *map;
 
     pthread_rwlock_wrlock(&ctx->node_to_svr_map_lock);
 
     /* > 获取链表对象 */
-    map = avl_query(ctx->node_to_svr_map, &key);
+    map = bptree_query(ctx->node_to_svr_map, &key, sizeof(key));
     if (NULL == map) {
         pthread_rwlock_unlock(&ctx->node_to_svr_map_lock);
         log_error(ctx->log, "Query nid [%d] failed!", nid);
@@ -265,15 +248,14 @@ int sdrd_node_to_svr_map_rand(sdrd_cntx_t *ctx, int nid)
     int idx, n, rsvr_idx;
     list_t *list;
     list_node_t *node;
+    uint64_t key = (uint64_t)nid;
     sdrd_node_to_svr_item_t *item;
-    sdrd_dev_to_rsvr_map_t key, *map;
-
-    key.nid = nid;
+    sdrd_dev_to_rsvr_map_t *map;
 
     pthread_rwlock_rdlock(&ctx->node_to_svr_map_lock);
 
     /* > 获取链表对象 */
-    map = avl_query(ctx->node_to_svr_map, &key);
+    map = bptree_query(ctx->node_to_svr_map, &key, sizeof(key));
     if (NULL == map) {
         pthread_rwlock_unlock(&ctx->node_to_svr_map_lock);
         log_error(ctx->log, "Query nid [%d] failed!", nid);
@@ -360,13 +342,13 @@ void *sdrd_dist_routine(void *_ctx)
     int idx;
     void *data, *addr;
     sdtp_frwd_t *frwd;
+    sdrd_rsvr_t *rsvr;
     sdrd_cntx_t *ctx = (sdrd_cntx_t *)_ctx;
 
     while (1) {
-        /* > 弹出发送数据 */
-        data = shm_queue_pop(ctx->distq);
+        /* > 弹出发送数据(无数据时阻塞等待) */
+        data = shm_queue_pop_wait(ctx->distq, -1);
         if (NULL == data) {
-            usleep(500); /* TODO: 可使用事件通知机制减少CPU的消耗 */
             continue;
         }
 
@@ -375,6 +357,7 @@ void *sdrd_dist_routine(void *_ctx)
 
         idx = sdrd_node_to_svr_map_rand(ctx, frwd->dest);
         if (idx < 0) {
+            shm_queue_dealloc(ctx->distq, data);
             log_error(ctx->log, "Didn't find dev to svr map! nid:%d", frwd->dest);
             continue;
         }
@@ -393,6 +376,10 @@ void *sdrd_dist_routine(void *_ctx)
         queue_push(ctx->sendq[idx], addr);
 
         shm_queue_dealloc(ctx->distq, data);
+
+        /* > 通知接收线程 */
+        rsvr = (sdrd_rsvr_t *)ctx->recvtp->data + idx;
+        evfd_notify(rsvr->evfd);
     }
 
     return (void *)-1;
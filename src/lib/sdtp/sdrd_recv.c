@@ -414,9 +414,14 @@ void sdrd_recvtp_destroy(void *_ctx, void *args)
     for (idx=0; idx<ctx->conf.recv_thd_num; ++idx, ++rsvr) {
         /* > 关闭命令套接字 */
         CLOSE(rsvr->cmd_sck_id);
+        CLOSE(rsvr->evfd);
 
         /* > 关闭通信套接字 */
         sdrd_rsvr_del_all_conn_hdl(ctx, rsvr);
+
+        /* > 释放事件对象 */
+        CLOSE(rsvr->epid);
+        FREE(rsvr->events);
     }
 
     FREE(ctx->recvtp->data);
@@ -495,6 +500,7 @@ void sdrd_worktp_destroy(void *_ctx, void *args)
 
     for (idx=0; idx<conf->work_thd_num; ++idx, ++wrk) {
         CLOSE(wrk->cmd_sck_id);
+        CLOSE(wrk->evfd);
     }
 
     FREE(ctx->worktp->data);
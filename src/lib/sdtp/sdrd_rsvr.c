@@ -9,6 +9,7 @@
  ******************************************************************************/
 
 #include "redo.h"
+#include "evfd.h"
 #include "sdtp_mesg.h"
 #include "sdtp_comm.h"
 #include "sdrd_recv.h"
@@ -19,8 +20,8 @@ static sdrd_rsvr_t *sdrd_rsvr_get_curr(sdrd_cntx_t *ctx);
 static int sdrd_rsvr_event_core_hdl(sdrd_cntx_t *ctx, sdrd_rsvr_t *rsvr);
 static int sdrd_rsvr_event_timeout_hdl(sdrd_cntx_t *ctx, sdrd_rsvr_t *rsvr);
 
-static int sdrd_rsvr_trav_recv(sdrd_cntx_t *ctx, sdrd_rsvr_t *rsvr);
-static int sdrd_rsvr_trav_send(sdrd_cntx_t *ctx, sdrd_rsvr_t *rsvr);
+static void sdrd_rsvr_set_events(sdrd_rsvr_t *rsvr, sdrd_sck_t *sck);
+static int sdrd_rsvr_send_proc(sdrd_cntx_t *ctx, sdrd_rsvr_t *rsvr, sdrd_sck_t *sck);
 
 static int sdrd_rsvr_recv_proc(sdrd_cntx_t *ctx, sdrd_rsvr_t *rsvr, sdrd_sck_t *sck);
 static int sdrd_rsvr_data_proc(sdrd_cntx_t *ctx, sdrd_rsvr_t *rsvr, sdrd_sck_t *sck);
@@ -64,100 +65,39 @@ static int sdrd_rsvr_queue_alloc(sdrd_cntx_t *ctx, sdrd_rsvr_t *rsvr);
 #define sdtp_rand_work(ctx) (rand() % (ctx->worktp->num))
 
 /******************************************************************************
- **函数名称: sdrd_rsvr_set_rdset
- **功    能: 设置可读集合
+ **函数名称: sdrd_rsvr_set_events
+ **功    能: 设置套接字的侦听事件
  **输入参数:
  **     rsvr: 接收服务
+ **     sck: 套接字对象
  **输出参数: NONE
- **返    回: 0:成功 !0:失败
- **实现描述:
- **注意事项: 如果超时未接收或发送数据，则关闭连接!
+ **返    回: VOID
+ **实现描述: 只有发送链表或发送缓存中存在数据时，才侦听可写事件!
+ **注意事项: 事件未发生变化时, 不进行系统调用
  **作    者: # Qifeng.zou # 2015.01.01 #
  ******************************************************************************/
-static void sdrd_rsvr_set_rdset(sdrd_cntx_t *ctx, sdrd_rsvr_t *rsvr)
+static void sdrd_rsvr_set_events(sdrd_rsvr_t *rsvr, sdrd_sck_t *sck)
 {
-    sdrd_sck_t *curr;
-    list2_node_t *node, *next, *tail;
-
-    FD_ZERO(&rsvr->rdset);
-
-    FD_SET(rsvr->cmd_sck_id, &rsvr->rdset);
-    rsvr->max = rsvr->cmd_sck_id;
-
-    node = rsvr->conn_list->head;
-    if (NULL != node) {
-        tail = node->prev;
-    }
-
-    while (NULL != node) {
-        curr = (sdrd_sck_t *)node->data;
-        if ((rsvr->ctm - curr->rdtm > 30)
-            && (rsvr->ctm - curr->wrtm > 30)) {
-            log_error(rsvr->log, "Didn't active for along time! fd:%d ip:%s",
-                    curr->fd, curr->ipaddr);
-
-            if (node == tail) {
-                sdrd_rsvr_del_conn_hdl(ctx, rsvr, node);
-                break;
-            }
-            next = node->next;
-            sdrd_rsvr_del_conn_hdl(ctx, rsvr, node);
-            node = next;
-            continue;
-        }
-
-        FD_SET(curr->fd, &rsvr->rdset);
-        rsvr->max = MAX(rsvr->max, curr->fd);
+    uint32_t events = EPOLLIN;
+    struct epoll_event ev;
 
-        if (node == tail) {
-            break;
-        }
-        node = node->next;
+    if (!list_empty(sck->mesg_list)
+        || (sck->send.optr != sck->send.iptr)) {
+        events |= EPOLLOUT;
     }
-}
-
-/******************************************************************************
- **函数名称: sdrd_rsvr_set_wrset
- **功    能: 设置可写集合
- **输入参数:
- **     rsvr: 接收服务
- **输出参数: NONE
- **返    回: 0:成功 !0:失败
- **实现描述: 只有发送链表中存在数据时，才将该套接字加入到可写侦听集合!
- **注意事项:
- **作    者: # Qifeng.zou # 2015.01.01 #
- ******************************************************************************/
-static void sdrd_rsvr_set_wrset(sdrd_cntx_t *ctx, sdrd_rsvr_t *rsvr)
-{
-    sdrd_sck_t *curr;
-    list2_node_t *node, *tail;
-
-    FD_ZERO(&rsvr->wrset);
 
-    node = rsvr->conn_list->head;
-    if (NULL != node) {
-        tail = node->prev;
+    if (events == sck->events) {
+        return;
     }
 
-    while (NULL != node) {
-        curr = (sdrd_sck_t *)node->data;
+    memset(&ev, 0, sizeof(ev));
 
-        if (list_empty(curr->mesg_list)
-            && (curr->send.optr == curr->send.iptr)) {
-            if (node == tail) {
-                break;
-            }
-            node = node->next;
-            continue;
-        }
+    ev.data.ptr = sck;
+    ev.events = events;
 
-        FD_SET(curr->fd, &rsvr->wrset);
+    epoll_ctl(rsvr->epid, EPOLL_CTL_MOD, sck->fd, &ev);
 
-        if (node == tail) {
-            break;
-        }
-        node = node->next;
-    }
+    sck->events = events;
 }
 
 /******************************************************************************
@@ -176,42 +116,39 @@ static void sdrd_rsvr_set_wrset(sdrd_cntx_t *ctx, sdrd_rsvr_t *rsvr)
  ******************************************************************************/
 void *sdrd_rsvr_routine(void *_ctx)
 {
-    int ret;
     sdrd_rsvr_t *rsvr;
-    struct timeval timeout;
     sdrd_cntx_t *ctx = (sdrd_cntx_t *)_ctx;
 
     /* 1. 获取接收服务 */
     rsvr = sdrd_rsvr_get_curr(ctx);
     if (NULL == rsvr) {
-        log_fatal(rsvr->log, "Get recv server failed!");
+        log_fatal(ctx->log, "Get recv server failed!");
         abort();
         return (void *)SDTP_ERR;
     }
 
     for (;;) {
-        /* > 分发发送数据 */
-        sdrd_rsvr_dist_send_data(ctx, rsvr);
-
         /* 2. 等待事件通知 */
-        sdrd_rsvr_set_rdset(ctx, rsvr);
-        sdrd_rsvr_set_wrset(ctx, rsvr);
-
-        timeout.tv_sec = 1;
-        timeout.tv_usec = 0;
-        ret = select(rsvr->max+1, &rsvr->rdset, &rsvr->wrset, NULL, &timeout);
-        if (ret < 0) {
+        rsvr->fds = epoll_wait(rsvr->epid, rsvr->events,
+                SDRD_EVENT_MAX_NUM, SDRD_TMOUT_MSEC);
+        if (rsvr->fds < 0) {
             if (EINTR == errno) { continue; }
             log_fatal(rsvr->log, "errmsg:[%d] %s", errno, strerror(errno));
             abort();
             return (void *)SDTP_ERR;
-        } else if (0 == ret) {
-            sdrd_rsvr_event_timeout_hdl(ctx, rsvr);
-            continue;
         }
 
         /* 3. 进行事件处理 */
-        sdrd_rsvr_event_core_hdl(ctx, rsvr);
+        if (rsvr->fds > 0) {
+            sdrd_rsvr_event_core_hdl(ctx, rsvr);
+        }
+
+        /* 4. 进行超时处理 */
+        rsvr->ctm = time(NULL);
+        if (rsvr->ctm - rsvr->scan_tm >= SDRD_TMOUT_SCAN_SEC) {
+            rsvr->scan_tm = rsvr->ctm;
+            sdrd_rsvr_event_timeout_hdl(ctx, rsvr);
+        }
     }
 
     log_fatal(rsvr->log, "errmsg:[%d] %s", errno, strerror(errno));
@@ -264,12 +201,27 @@ static sdrd_rsvr_t *sdrd_rsvr_get_curr(sdrd_cntx_t *ctx)
  ******************************************************************************/
 int sdrd_rsvr_init(sdrd_cntx_t *ctx, sdrd_rsvr_t *rsvr, int id)
 {
+    struct epoll_event ev;
     char path[FILE_PATH_MAX_LEN];
     sdrd_conf_t *conf = &ctx->conf;
 
     rsvr->id = id;
     rsvr->log = ctx->log;
     rsvr->ctm = time(NULL);
+    rsvr->scan_tm = rsvr->ctm;
+
+    /* > 创建epoll对象 */
+    rsvr->epid = epoll_create(SDRD_EVENT_MAX_NUM);
+    if (rsvr->epid < 0) {
+        log_error(rsvr->log, "errmsg:[%d] %s!", errno, strerror(errno));
+        return SDTP_ERR;
+    }
+
+    rsvr->events = (struct epoll_event *)calloc(SDRD_EVENT_MAX_NUM, sizeof(struct epoll_event));
+    if (NULL == rsvr->events) {
+        log_error(rsvr->log, "errmsg:[%d] %s!", errno, strerror(errno));
+        return SDTP_ERR;
+    }
 
     /* > 创建CMD套接字 */
     sdrd_rsvr_usck_path(conf, path, rsvr->id);
@@ -280,6 +232,24 @@ int sdrd_rsvr_init(sdrd_cntx_t *ctx, sdrd_rsvr_t *rsvr, int id)
         return SDTP_ERR;
     }
 
+    /* > 创建事件通知 */
+    rsvr->evfd = evfd_creat();
+    if (rsvr->evfd < 0) {
+        log_error(rsvr->log, "errmsg:[%d] %s!", errno, strerror(errno));
+        return SDTP_ERR;
+    }
+
+    /* > 加入事件侦听(以成员地址区分套接字对象) */
+    memset(&ev, 0, sizeof(ev));
+
+    ev.data.ptr = &rsvr->cmd_sck_id;
+    ev.events = EPOLLIN;
+    epoll_ctl(rsvr->epid, EPOLL_CTL_ADD, rsvr->cmd_sck_id, &ev);
+
+    ev.data.ptr = &rsvr->evfd;
+    ev.events = EPOLLIN;
+    epoll_ctl(rsvr->epid, EPOLL_CTL_ADD, rsvr->evfd, &ev);
+
     /* > 初始化队列设置 */
     sdrd_rsvr_queue_reset(rsvr);
 
@@ -330,68 +300,15 @@ static int sdrd_rsvr_recv_cmd(sdrd_cntx_t *ctx, sdrd_rsvr_t *rsvr)
 }
 
 /******************************************************************************
- **函数名称: sdrd_rsvr_trav_recv
- **功    能: 遍历接收数据
- **输入参数:
- **     ctx: 全局对象
- **     rsvr: 接收服务
- **输出参数: NONE
- **返    回: 0:成功 !0:失败
- **实现描述: 遍历判断套接字是否可读，并接收数据!
- **注意事项:
- **作    者: # Qifeng.zou # 2015.01.01 #
- ******************************************************************************/
-static int sdrd_rsvr_trav_recv(sdrd_cntx_t *ctx, sdrd_rsvr_t *rsvr)
-{
-    sdrd_sck_t *curr;
-    list2_node_t *node, *next, *tail;
-
-    rsvr->ctm = time(NULL);
-
-    node = rsvr->conn_list->head;
-    if (NULL != node) {
-        tail = node->prev;
-    }
-
-    while (NULL != node) {
-        curr = (sdrd_sck_t *)node->data;
-
-        if (FD_ISSET(curr->fd, &rsvr->rdset)) {
-            curr->rdtm = rsvr->ctm;
-
-            /* 进行接收处理 */
-            if (sdrd_rsvr_recv_proc(ctx, rsvr, curr)) {
-                log_error(rsvr->log, "Recv proc failed! fd:%d ip:%s", curr->fd, curr->ipaddr);
-                if (node == tail) {
-                    sdrd_rsvr_del_conn_hdl(ctx, rsvr, node);
-                    break;
-                }
-                next = node->next;
-                sdrd_rsvr_del_conn_hdl(ctx, rsvr, node);
-                node = next;
-                continue;
-            }
-        }
-
-        if (node == tail) {
-            break;
-        }
-
-        node = node->next;
-    }
-
-    return SDTP_OK;
-}
-
-/******************************************************************************
- **函数名称: sdrd_rsvr_trav_send
- **功    能: 遍历发送数据
+ **函数名称: sdrd_rsvr_send_proc
+ **功    能: 发送数据
  **输入参数:
  **     ctx: 全局对象
  **     rsvr: 接收服务
+ **     sck: 可写的套接字
  **输出参数: NONE
  **返    回: 0:成功 !0:失败
- **实现描述: 遍历判断套接字是否可写，并发送数据!
+ **实现描述: 依次填充发送缓存并发送, 直至无数据或套接字不可写!
  **注意事项:
  **       ------------------------------------------------
  **      | 已发送 |     待发送     |       剩余空间       |
@@ -405,64 +322,42 @@ static int sdrd_rsvr_trav_recv(sdrd_cntx_t *ctx, sdrd_rsvr_t *rsvr)
  **     addr     optr             iptr                   end
  **作    者: # Qifeng.zou # 2015.01.01 #
  ******************************************************************************/
-static int sdrd_rsvr_trav_send(sdrd_cntx_t *ctx, sdrd_rsvr_t *rsvr)
+static int sdrd_rsvr_send_proc(sdrd_cntx_t *ctx, sdrd_rsvr_t *rsvr, sdrd_sck_t *sck)
 {
     int n, len;
-    sdrd_sck_t *curr;
-    sdtp_snap_t *send;
-    list2_node_t *node, *tail;
-
-    rsvr->ctm = time(NULL);
-
-    node = rsvr->conn_list->head;
-    if (NULL != node) {
-        tail = node->prev;
-    }
-
-    while (NULL != node) {
-        curr = (sdrd_sck_t *)node->data;
-
-        if (FD_ISSET(curr->fd, &rsvr->wrset)) {
-            curr->wrtm = rsvr->ctm;
-            send = &curr->send;
-
-            for (;;) {
-                /* 1. 填充发送缓存 */
-                if (send->iptr == send->optr) {
-                    sdrd_rsvr_fill_send_buff(rsvr, curr);
-                }
-
-                /* 2. 发送缓存数据 */
-                len = send->iptr - send->optr;
-                if (0 == len) {
-                    break;
-                }
+    sdtp_snap_t *send = &sck->send;
 
-                n = Writen(curr->fd, send->optr, len);
-                if (n != len) {
-                    if (n > 0) {
-                        send->optr += n;
-                        break;
-                    }
+    sck->wrtm = rsvr->ctm;
 
-                    log_error(rsvr->log, "errmsg:[%d] %s!", errno, strerror(errno));
+    for (;;) {
+        /* 1. 填充发送缓存 */
+        if (send->iptr == send->optr) {
+            sdrd_rsvr_fill_send_buff(rsvr, sck);
+        }
 
-                    sdrd_rsvr_del_conn_hdl(ctx, rsvr, node);
-                    return SDTP_ERR;
-                }
+        /* 2. 发送缓存数据 */
+        len = send->iptr - send->optr;
+        if (0 == len) {
+            break;
+        }
 
-                /* 3. 重置标识量 */
-                sdtp_snap_reset(send);
+        n = Writen(sck->fd, send->optr, len);
+        if (n != len) {
+            if (n > 0) {
+                send->optr += n;
+                break;
             }
-        }
 
-        if (node == tail) {
-            break;
+            log_error(rsvr->log, "errmsg:[%d] %s!", errno, strerror(errno));
+            return SDTP_ERR;
         }
 
-        node = node->next;
+        /* 3. 重置标识量 */
+        sdtp_snap_reset(send);
     }
 
+    sdrd_rsvr_set_events(rsvr, sck);
+
     return SDTP_OK;
 }
 
@@ -786,23 +681,59 @@ static int sdrd_rsvr_exp_mesg_proc(sdrd_cntx_t *ctx,
  **返    回: 0:成功 !0:失败
  **实现描述:
  **     1. 接收命令数据
- **     2. 遍历接收数据
- **     3. 遍历发送数据
+ **     2. 分发发送数据
+ **     3. 接收就绪套接字的数据
+ **     4. 发送就绪套接字的数据
  **注意事项:
  **作    者: # Qifeng.zou # 2015.01.01 #
  ******************************************************************************/
 static int sdrd_rsvr_event_core_hdl(sdrd_cntx_t *ctx, sdrd_rsvr_t *rsvr)
 {
-    /* 1. 接收命令数据 */
-    if (FD_ISSET(rsvr->cmd_sck_id, &rsvr->rdset)) {
-        sdrd_rsvr_recv_cmd(ctx, rsvr);
-    }
+    int idx;
+    sdrd_sck_t *sck;
+    struct epoll_event *ev;
+
+    rsvr->ctm = time(NULL);
 
-    /* 2. 遍历接收数据 */
-    sdrd_rsvr_trav_recv(ctx, rsvr);
+    for (idx=0; idx<rsvr->fds; ++idx) {
+        ev = &rsvr->events[idx];
 
-    /* 3. 遍历发送数据 */
-    sdrd_rsvr_trav_send(ctx, rsvr);
+        /* 1. 接收命令数据 */
+        if (ev->data.ptr == (void *)&rsvr->cmd_sck_id) {
+            sdrd_rsvr_recv_cmd(ctx, rsvr);
+            continue;
+        }
+        /* 2. 分发发送数据 */
+        else if (ev->data.ptr == (void *)&rsvr->evfd) {
+            evfd_clear(rsvr->evfd);
+            sdrd_rsvr_dist_send_data(ctx, rsvr);
+            continue;
+        }
+
+        sck = (sdrd_sck_t *)ev->data.ptr;
+
+        /* 3. 接收网络数据 */
+        if (ev->events & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+            sck->rdtm = rsvr->ctm;
+
+            if (sdrd_rsvr_recv_proc(ctx, rsvr, sck)) {
+                log_error(rsvr->log, "Recv proc failed! fd:%d ip:%s", sck->fd, sck->ipaddr);
+                sdrd_rsvr_del_conn_hdl(ctx, rsvr, sck->node);
+                continue;
+            }
+        }
+
+        /* 4. 发送网络数据 */
+        if ((ev->events & EPOLLOUT)
+            || !list_empty(sck->mesg_list))
+        {
+            if (sdrd_rsvr_send_proc(ctx, rsvr, sck)) {
+                log_error(rsvr->log, "Send proc failed! fd:%d ip:%s", sck->fd, sck->ipaddr);
+                sdrd_rsvr_del_conn_hdl(ctx, rsvr, sck->node);
+                continue;
+            }
+        }
+    }
 
     return SDTP_OK;
 }
@@ -850,7 +781,9 @@ static int sdrd_rsvr_event_timeout_hdl(sdrd_cntx_t *ctx, sdrd_rsvr_t *rsvr)
 
         curr = (sdrd_sck_t *)node->data;
 
-        if (rsvr->ctm - curr->rdtm >= 60) {
+        if ((rsvr->ctm - curr->rdtm >= 60)
+            || ((rsvr->ctm - curr->rdtm > 30) && (rsvr->ctm - curr->wrtm > 30)))
+        {
             log_trace(rsvr->log, "Didn't active for along time! fd:%d ip:%s",
                     curr->fd, curr->ipaddr);
 
@@ -1126,6 +1059,7 @@ static void sdrd_rsvr_sck_free(sdrd_rsvr_t *rsvr, sdrd_sck_t *sck)
 static int sdrd_rsvr_add_conn_hdl(sdrd_rsvr_t *rsvr, sdtp_cmd_add_sck_t *req)
 {
     sdrd_sck_t *sck;
+    struct epoll_event ev;
 
     /* > 分配连接空间 */
     sck = sdrd_rsvr_sck_creat(rsvr, req);
@@ -1135,7 +1069,23 @@ static int sdrd_rsvr_add_conn_hdl(sdrd_rsvr_t *rsvr, sdtp_cmd_add_sck_t *req)
     }
 
     /* 4. 加入链尾 */
-    list2_rpush(rsvr->conn_list, (void *)sck);
+    if (list2_rpush(rsvr->conn_list, (void *)sck)) {
+        log_error(rsvr->log, "Push into list failed!");
+        sdrd_rsvr_sck_free(rsvr, sck);
+        return SDTP_ERR;
+    }
+
+    sck->node = rsvr->conn_list->head->prev; /* 链尾结点 */
+
+    /* 5. 加入事件侦听 */
+    memset(&ev, 0, sizeof(ev));
+
+    ev.data.ptr = sck;
+    ev.events = EPOLLIN;
+
+    epoll_ctl(rsvr->epid, EPOLL_CTL_ADD, sck->fd, &ev);
+
+    sck->events = ev.events;
 
     ++rsvr->connections; /* 统计TCP连接数 */
 
@@ -1159,8 +1109,12 @@ static int sdrd_rsvr_add_conn_hdl(sdrd_rsvr_t *rsvr, sdtp_cmd_add_sck_t *req)
  ******************************************************************************/
 static int sdrd_rsvr_del_conn_hdl(sdrd_cntx_t *ctx, sdrd_rsvr_t *rsvr, list2_node_t *node)
 {
+    struct epoll_event ev;
     sdrd_sck_t *curr = (sdrd_sck_t *)node->data;
 
+    /* > 从事件侦听中剔除 */
+    epoll_ctl(rsvr->epid, EPOLL_CTL_DEL, curr->fd, &ev);
+
     /* > 从链表剔除结点 */
     list2_delete(rsvr->conn_list, node);
 
@@ -1219,35 +1173,28 @@ void sdrd_rsvr_del_all_conn_hdl(sdrd_cntx_t *ctx, sdrd_rsvr_t *rsvr)
  **     rqid: 队列ID
  **输出参数: NONE
  **返    回: 0:成功 !0:失败
- **实现描述:
- **注意事项:
+ **实现描述: 通过eventfd唤醒负责该队列的工作线程
+ **注意事项: 工作线程被唤醒后, 将处理其负责的所有队列, 因此多次通知会被合并
  **作    者: # Qifeng.zou # 2015.01.01 #
  ******************************************************************************/
 static int sdrd_rsvr_cmd_proc_req(sdrd_cntx_t *ctx, sdrd_rsvr_t *rsvr, int rqid)
 {
     int widx;
-    sdtp_cmd_t cmd;
-    char path[FILE_PATH_MAX_LEN];
-    sdrd_conf_t *conf = &ctx->conf;
-    sdtp_cmd_proc_req_t *req = (sdtp_cmd_proc_req_t *)&cmd.args;
+    sdtp_worker_t *worker;
 
-    cmd.type = SDTP_CMD_PROC_REQ;
-    req->ori_rsvr_tidx = rsvr->id;
-    req->num = -1;
-    req->rqidx = rqid;
-
-    /* 1. 随机选择Work线程 */
-    /* widx = sdtp_rand_work(ctx); */
+    /* 1. 选择Work线程 */
     widx = rqid / SDTP_WORKER_HDL_QNUM;
+    if (widx >= ctx->worktp->num) {
+        log_error(rsvr->log, "Didn't find worker! rqid:%d widx:%d", rqid, widx);
+        return SDTP_ERR;
+    }
 
-    sdrd_worker_usck_path(conf, path, widx);
+    worker = (sdtp_worker_t *)ctx->worktp->data + widx;
 
-    /* 2. 发送处理命令 */
-    if (unix_udp_send(rsvr->cmd_sck_id, path, &cmd, sizeof(sdtp_cmd_t)) < 0) {
-        if (EAGAIN != errno) {
-            log_debug(rsvr->log, "Send command failed! errmsg:[%d] %s! path:[%s]",
-                      errno, strerror(errno), path);
-        }
+    /* 2. 发送处理通知 */
+    if (evfd_notify(worker->evfd)) {
+        log_debug(rsvr->log, "Notify worker failed! errmsg:[%d] %s! widx:%d",
+                  errno, strerror(errno), widx);
         return SDTP_ERR;
     }
 
@@ -1459,11 +1406,15 @@ static int sdrd_rsvr_dist_send_data(sdrd_cntx_t *ctx, sdrd_rsvr_t *rsvr)
 
         /* > 放入发送链表 */
         if (list_rpush(sck->mesg_list, addr)) {
-            queue_dealloc(sendq, data);
+            FREE(addr);
             log_error(rsvr->log, "Push input list failed!");
         }
 
+        queue_dealloc(sendq, data);
         list_destroy(conn.list, mem_dummy_dealloc, NULL);
+
+        /* > 侦听可写事件 */
+        sdrd_rsvr_set_events(rsvr, sck);
     }
 
     return SDTP_OK;
@@ -8,6 +8,7 @@
  ** 作  者: # Qifeng.zou # 2015.01.06 #
  ******************************************************************************/
 
+#include "evfd.h"
 #include "sdtp_comm.h"
 #include "sdtp_mesg.h"
 #include "sdrd_recv.h"
@@ -17,6 +18,7 @@
 static sdtp_worker_t *sdrd_worker_get_curr(sdrd_cntx_t *ctx);
 static int sdrd_worker_event_core_hdl(sdrd_cntx_t *ctx, sdtp_worker_t *worker);
 static int sdrd_worker_cmd_proc_req_hdl(sdrd_cntx_t *ctx, sdtp_worker_t *worker, const sdtp_cmd_t *cmd);
+static int sdrd_worker_proc_all_hdl(sdrd_cntx_t *ctx, sdtp_worker_t *worker);
 
 /******************************************************************************
  **函数名称: sdrd_worker_routine
@@ -34,9 +36,8 @@ static int sdrd_worker_cmd_proc_req_hdl(sdrd_cntx_t *ctx, sdtp_worker_t *worker,
  ******************************************************************************/
 void *sdrd_worker_routine(void *_ctx)
 {
-    int ret, idx;
+    int ret;
     sdtp_worker_t *worker;
-    sdtp_cmd_proc_req_t *req;
     struct timeval timeout;
     sdrd_cntx_t *ctx = (sdrd_cntx_t *)_ctx;
 
@@ -53,7 +54,8 @@ void *sdrd_worker_routine(void *_ctx)
         FD_ZERO(&worker->rdset);
 
         FD_SET(worker->cmd_sck_id, &worker->rdset);
-        worker->max = worker->cmd_sck_id;
+        FD_SET(worker->evfd, &worker->rdset);
+        worker->max = MAX(worker->cmd_sck_id, worker->evfd);
 
         timeout.tv_sec = 30;
         timeout.tv_usec = 0;
@@ -64,19 +66,8 @@ void *sdrd_worker_routine(void *_ctx)
             abort();
             return (void *)-1;
         } else if (0 == ret) {
-            /* 超时: 模拟处理命令 */
-            sdtp_cmd_t cmd;
-            req = (sdtp_cmd_proc_req_t *)&cmd.args;
-
-            for (idx=0; idx<SDTP_WORKER_HDL_QNUM; ++idx) {
-                memset(&cmd, 0, sizeof(cmd));
-
-                cmd.type = SDTP_CMD_PROC_REQ;
-                req->num = -1;
-                req->rqidx = SDTP_WORKER_HDL_QNUM * worker->id + idx;
-
-                sdrd_worker_cmd_proc_req_hdl(ctx, worker, &cmd);
-            }
+            /* 超时: 处理所负责的队列 */
+            sdrd_worker_proc_all_hdl(ctx, worker);
             continue;
         }
 
@@ -127,6 +118,7 @@ static sdtp_worker_t *sdrd_worker_get_curr(sdrd_cntx_t *ctx)
  **返    回: 0:成功 !0:失败
  **实现描述:
  **     1. 创建命令套接字
+ **     2. 创建事件通知
  **注意事项:
  **作    者: # Qifeng.zou # 2015.01.06 #
  ******************************************************************************/
@@ -137,6 +129,9 @@ int sdrd_worker_init(sdrd_cntx_t *ctx, sdtp_worker_t *worker, int id)
 
     worker->id = id;
     worker->log = ctx->log;
+    worker->proc_metric = metrics_counter("sdrd.worker.proc");
+    worker->drop_metric = metrics_counter("sdrd.worker.drop");
+    worker->err_metric = metrics_counter("sdrd.worker.err");
 
     /* 1. 创建命令套接字 */
     sdrd_worker_usck_path(conf, path, worker->id);
@@ -147,6 +142,13 @@ int sdrd_worker_init(sdrd_cntx_t *ctx, sdtp_worker_t *worker, int id)
         return SDTP_ERR;
     }
 
+    /* 2. 创建事件通知 */
+    worker->evfd = evfd_creat();
+    if (worker->evfd < 0) {
+        log_error(worker->log, "errmsg:[%d] %s!", errno, strerror(errno));
+        return SDTP_ERR;
+    }
+
     return SDTP_OK;
 }
 
@@ -167,6 +169,12 @@ static int sdrd_worker_event_core_hdl(sdrd_cntx_t *ctx, sdtp_worker_t *worker)
 {
     sdtp_cmd_t cmd;
 
+    /* > 接收线程的处理通知 */
+    if (FD_ISSET(worker->evfd, &worker->rdset)) {
+        evfd_clear(worker->evfd);
+        sdrd_worker_proc_all_hdl(ctx, worker);
+    }
+
     if (!FD_ISSET(worker->cmd_sck_id, &worker->rdset)) {
         return SDTP_OK; /* 无数据 */
     }
@@ -236,6 +244,7 @@ static int sdrd_worker_cmd_proc_req_hdl(sdrd_cntx_t *ctx, sdtp_worker_t *worker,
             if (NULL == reg->proc) {
                 ptr += head->length + sizeof(sdtp_header_t);
                 ++worker->drop_total;   /* 丢弃计数 */
+                metrics_counter_inc(worker->drop_metric);
                 continue;
             }
 
@@ -243,8 +252,10 @@ static int sdrd_worker_cmd_proc_req_hdl(sdrd_cntx_t *ctx, sdtp_worker_t *worker,
                         ptr+sizeof(sdtp_header_t), head->length, reg->args))
             {
                 ++worker->err_total;    /* 错误计数 */
+                metrics_counter_inc(worker->err_metric);
             } else {
                 ++worker->proc_total;   /* 处理计数 */
+                metrics_counter_inc(worker->proc_metric);
             }
 
             ptr += head->length + sizeof(sdtp_header_t);
@@ -256,3 +267,37 @@ static int sdrd_worker_cmd_proc_req_hdl(sdrd_cntx_t *ctx, sdtp_worker_t *worker,
 
     return SDTP_OK;
 }
+
+/******************************************************************************
+ **函数名称: sdrd_worker_proc_all_hdl
+ **功    能: 处理所负责的全部接收队列
+ **输入参数:
+ **     ctx: 全局对象
+ **     worker: 工作对象
+ **输出参数: NONE
+ **返    回: 0:成功 !0:失败
+ **实现描述: 各工作线程负责SDTP_WORKER_HDL_QNUM个接收队列
+ **注意事项:
+ **作    者: # Qifeng.zou # 2015.01.06 #
+ ******************************************************************************/
+static int sdrd_worker_proc_all_hdl(sdrd_cntx_t *ctx, sdtp_worker_t *worker)
+{
+    int idx;
+    sdtp_cmd_t cmd;
+    sdtp_cmd_proc_req_t *req = (sdtp_cmd_proc_req_t *)&cmd.args;
+
+    for (idx=0; idx<SDTP_WORKER_HDL_QNUM; ++idx) {
+        memset(&cmd, 0, sizeof(cmd));
+
+        cmd.type = SDTP_CMD_PROC_REQ;
+        req->num = -1;
+        req->rqidx = SDTP_WORKER_HDL_QNUM * worker->id + idx;
+        if (req->rqidx >= (uint32_t)ctx->conf.recvq_num) {
+            break;
+        }
+
+        sdrd_worker_cmd_proc_req_hdl(ctx, worker, &cmd);
+    }
+
+    return SDTP_OK;
+}
@@ -41,18 +41,20 @@ sdsd_pool_t *sdsd_pool_creat(const char *fpath, int max, int size)
     /* > 初始化处理 */
     head = (sdsd_pool_head_t *)addr;
 
-    memset(head, 0, sizeof(sdsd_pool_head_t));
+    memset(addr, 0, total); /* 共享内存可能已存在: 须清除残留的提交标志 */
 
     head->size = size;
     pool->head = head;
 
     for (idx=0; idx<SDSD_POOL_PAGE_NUM; ++idx) {
-        ticket_lock_init(&head->page[idx].lock);
         head->page[idx].idx = idx;
         head->page[idx].size = size * max;
         head->page[idx].begin = sizeof(sdsd_pool_head_t) + idx*size*max; /* 偏移量 */
         head->page[idx].end =  sizeof(sdsd_pool_head_t) + (idx+1)*size*max;
         head->page[idx].off = 0;
+        head->page[idx].limit = SDSD_POOL_INVALID_OFF;
+        head->page[idx].len = 0;
+        head->page[idx].chk = 0;
         head->page[idx].mode = SDSD_MOD_WR;
         head->page[idx].send_tm = time(NULL);
 
@@ -110,64 +112,150 @@ sdsd_pool_t *sdsd_pool_attach(const char *fpath)
  **输出参数: NONE
  **返    回: 0:成功 !0:失败
  **实现描述:
+ **     1. 通过原子加预留空间(off的最高位为封页标志, 封页后预留必然失败);
+ **     2. 在无锁的情况下拷贝报头和报体;
+ **     3. 最后写入chksum, 表示该记录已提交, 发送线程据此判断记录是否完整.
  **注意事项:
+ **     1. 预留越界的生产者中, 只有跨越页尾的那一个负责设置limit, 其值即为页内有效数据的长度;
+ **     2. 各线程从不同的页开始尝试, 以分散对off的竞争.
  **作    者: # Qifeng.zou # 2015.04.11 #
  ******************************************************************************/
 int sdsd_pool_push(sdsd_pool_t *pool, int type, int nid, const void *data, size_t len)
 {
     int idx, num;
+    uint64_t off;
+    size_t total;
     sdtp_header_t *head;
     sdsd_pool_page_t *page;
+    static __thread unsigned int seed = 0;
+
+    if (0 == seed) {
+        seed = (unsigned int)pthread_self();
+    }
 
-    idx = rand() % SDSD_POOL_PAGE_NUM;
+    total = sizeof(sdtp_header_t) + len;
+    idx = rand_r(&seed) % SDSD_POOL_PAGE_NUM;
 
     for (num=0; num<SDSD_POOL_PAGE_NUM; ++num, ++idx) {
         idx = idx % SDSD_POOL_PAGE_NUM;
 
         page  = &pool->head->page[idx];
 
-        if (page->off > 1 * GB) {
-            assert(0);
+        if ((SDSD_MOD_WR != page->mode)
+            || (page->off & SDSD_POOL_SEALED)
+            || (page->off + total > page->size))
+        {
+            continue; /* 无写入权限或空间不足(非精确判断, 只为减少无效的原子操作) */
         }
 
-        ticket_lock(&page->lock);     /* 加锁 */
-
-        if (SDSD_MOD_WR != page->mode) {
-            ticket_unlock(&page->lock);
-            continue; /* 无写入权限 */
+        /* > 预留空间 */
+        off = atomic64_xadd(&page->off, total);
+        if (off & SDSD_POOL_SEALED) {
+            continue; /* 已封页 */
         }
-
-        if ((page->size - page->off) < (sizeof(sdtp_header_t) + len)) {
-            ticket_unlock(&page->lock);
+        else if (off + total > page->size) {
+            if (off <= page->size) {
+                page->limit = off; /* 跨越页尾: 设置有效数据长度 */
+            }
             continue; /* 空间不足 */
         }
 
         /* > 设置报头信息 */
-        head = (sdtp_header_t *)(pool->addr[idx] + page->off);
+        head = (sdtp_header_t *)(pool->addr[idx] + off);
 
         head->type = htons(type);
         head->nid = htonl(nid);
         head->length = htonl(len);
         head->flag = SDTP_EXP_MESG;  /* 外部数据 */
-        head->chksum = htonl(SDTP_CHKSUM_VAL);
 
         /* > 设置报体信息 */
-        page->off += sizeof(sdtp_header_t);
-        memcpy(pool->addr[idx] + page->off, data, len);
-        page->off += len;
-        ++page->num;
-
-        if (page->off > 1 * GB) {
-            assert(0);
-        }
+        memcpy(pool->addr[idx] + off + sizeof(sdtp_header_t), data, len);
 
-        ticket_unlock(&page->lock);   /* 加锁 */
+        /* > 提交记录(须在数据写入之后) */
+        compiler_barrier();
+        head->chksum = htonl(SDTP_CHKSUM_VAL);
         return SDTP_OK;
     }
 
     return SDTP_ERR;
 }
 
+/******************************************************************************
+ **函数名称: sdsd_pool_page_reset
+ **描    述: 重置发送页
+ **输入参数:
+ **     pool: 发送池
+ **     page: 发送页
+ **     ctm: 当前时间
+ **输出参数: NONE
+ **返    回: VOID
+ **实现描述: 将本轮预留过的空间全部清零后, 再清零预留偏移, 最后恢复写权限
+ **注意事项: 1. 已发送完成的页才能重置
+ **          2. 下一轮的记录头不一定落在本轮记录头的位置, 本轮报体中的残留数据
+ **             可能恰好等于SDTP_CHKSUM_VAL, 被误认为已提交. 因此清零整个预留区,
+ **             使页内未预留的空间始终为0(创建时已整体清零)
+ **作    者: # Qifeng.zou # 2015.04.11 #
+ ******************************************************************************/
+static void sdsd_pool_page_reset(sdsd_pool_t *pool, sdsd_pool_page_t *page, time_t ctm)
+{
+    uint64_t off;
+
+    /* > 清除预留区(含各记录的提交标志) */
+    off = page->off & ~SDSD_POOL_SEALED;
+    if (off > page->size) {
+        off = page->size;
+    }
+    memset(pool->addr[page->idx], 0, off);
+
+    page->num = 0;
+    page->len = 0;
+    page->chk = 0;
+    page->limit = SDSD_POOL_INVALID_OFF;
+    page->send_tm = ctm;
+
+    compiler_barrier();
+    atomic64_xset(&page->off, 0);
+    page->mode = SDSD_MOD_WR; /* 发送完全 */
+}
+
+/******************************************************************************
+ **函数名称: sdsd_pool_page_commited
+ **描    述: 判断封页后的各记录是否已全部提交
+ **输入参数:
+ **     pool: 发送池
+ **     page: 发送页
+ **输出参数: NONE
+ **返    回: true:已全部提交 false:仍有记录未提交
+ **实现描述: 从上次确认的位置(chk)开始, 逐条检查记录的chksum
+ **注意事项: 生产者在预留和提交之间被中断时, 发送线程不会等待, 而是下次再检查
+ **作    者: # Qifeng.zou # 2015.04.11 #
+ ******************************************************************************/
+static bool sdsd_pool_page_commited(sdsd_pool_t *pool, sdsd_pool_page_t *page)
+{
+    sdtp_header_t *head;
+
+    /* > 计算有效数据长度 */
+    if (SDSD_POOL_INVALID_OFF == page->len) {
+        if (SDSD_POOL_INVALID_OFF == page->limit) {
+            return false; /* 跨越页尾的生产者还未设置limit */
+        }
+        page->len = page->limit;
+    }
+
+    /* > 检查提交标志 */
+    while (page->chk < page->len) {
+        head = (sdtp_header_t *)(pool->addr[page->idx] + page->chk);
+        if (htonl(SDTP_CHKSUM_VAL) != head->chksum) {
+            return false; /* 未提交 */
+        }
+        compiler_barrier();
+        page->chk += sizeof(sdtp_header_t) + ntohl(head->length);
+        ++page->num;
+    }
+
+    return true;
+}
+
 /******************************************************************************
  **函数名称: sdsd_pool_switch
  **描    述: 切换发送池
@@ -175,30 +263,24 @@ int sdsd_pool_push(sdsd_pool_t *pool, int type, int nid, const void *data, size_
  **     pool: 发送池
  **输出参数: NONE
  **返    回: 发送页
- **实现描述: 当发送页超时或容量超过50%时, 便可切换发送池
+ **实现描述:
+ **     1. 当发送页超时或容量超过50%时, 便可封页;
+ **     2. 封页后的各记录全部提交后, 才能进行发送.
  **注意事项:
  **作    者: # Qifeng.zou # 2015.04.11 #
  ******************************************************************************/
 sdsd_pool_page_t *sdsd_pool_switch(sdsd_pool_t *pool)
 {
     int idx;
+    uint64_t off;
     time_t ctm = time(NULL);
     sdsd_pool_page_t *page;
 
     /* > 改变状态 */
     for (idx=0; idx<SDSD_POOL_PAGE_NUM; ++idx) {
         page = &pool->head->page[idx];
-
-        if (page->off > page->size) {
-            assert(0);
-        }
-
         if (SDSD_MOD_RD == page->mode) {
-            page->off = 0;
-            page->num = 0;
-            page->send_tm = ctm;
-            page->mode = SDSD_MOD_WR; /* 发送完全 */
-            continue;
+            sdsd_pool_page_reset(pool, page, ctm);
         }
     }
 
@@ -206,17 +288,33 @@ sdsd_pool_page_t *sdsd_pool_switch(sdsd_pool_t *pool)
     for (idx=0; idx<SDSD_POOL_PAGE_NUM; ++idx) {
         page = &pool->head->page[idx];
 
-        if (page->off > 1 * GB) {
-            assert(0);
+        if (SDSD_MOD_WR == page->mode) {
+            off = page->off;
+            if (off > page->size) {
+                off = page->size;
+            }
+
+            /* 当缓存分配超过50%或超时5s时 则可封页 */
+            if ((off <= (page->size >> 1))
+                && ((ctm - page->send_tm < 5) || (0 == off)))
+            {
+                continue;
+            }
+
+            /* > 封页: 返回值为封页前的预留长度 */
+            off = atomic64_xadd(&page->off, SDSD_POOL_SEALED);
+            page->len = (off > page->size)? SDSD_POOL_INVALID_OFF : off;
+            page->chk = 0;
+            page->num = 0;
+            page->mode = SDSD_MOD_SEAL;
         }
 
-        /* 当缓存分配超过50%或超时5s时 则可发送缓存内容 */
-        if ((page->off > (page->size >> 1))
-            || ((ctm - page->send_tm >= 5) && (page->off > 0)))
-        {
-            ticket_lock(&page->lock);
+        if (SDSD_MOD_SEAL == page->mode) {
+            if (!sdsd_pool_page_commited(pool, page)) {
+                continue; /* 仍有记录未提交 */
+            }
+
             page->mode = SDSD_MOD_RD;
-            ticket_unlock(&page->lock);
             return page;
         }
     }
@@ -46,6 +46,7 @@ int sdsd_ssvr_init(sdsd_cntx_t *ctx, sdsd_ssvr_t *ssvr, int idx)
 {
     void *addr;
     list_opt_t opt;
+    struct epoll_event ev;
     sdsd_conf_t *conf = &ctx->conf;
     sdtp_snap_t *recv = &ssvr->sck.recv;
     sdtp_snap_t *send = &ssvr->sck.send[SDTP_SNAP_SHOT_SYS_DATA];
@@ -66,6 +67,20 @@ int sdsd_ssvr_init(sdsd_cntx_t *ctx, sdsd_ssvr_t *ssvr, int idx)
         return SDTP_ERR;
     }
 
+    /* > 创建epoll对象 */
+    ssvr->epid = epoll_create(SDSD_EVENT_MAX_NUM);
+    if (ssvr->epid < 0) {
+        log_error(ssvr->log, "errmsg:[%d] %s!", errno, strerror(errno));
+        return SDTP_ERR;
+    }
+
+    memset(&ev, 0, sizeof(ev));
+
+    ev.data.ptr = &ssvr->cmd_sck_id;
+    ev.events = EPOLLIN;
+
+    epoll_ctl(ssvr->epid, EPOLL_CTL_ADD, ssvr->cmd_sck_id, &ev);
+
     /* > 创建发送链表 */
     memset(&opt, 0, sizeof(opt));
 
@@ -281,14 +296,10 @@ void sdsd_ssvr_switch_send_buff(sdsd_cntx_t *ctx, sdsd_ssvr_t *ssvr)
     send = &sck->send[SDTP_SNAP_SHOT_EXP_DATA];
 
     send->addr = (void *)ssvr->sendq->head + page->begin;
-    send->end = send->addr + page->off;
-    send->size = page->off;
+    send->end = send->addr + page->len;
+    send->size = page->len;
     send->optr = send->addr;
-    send->iptr = send->addr + page->off;
-
-    if (page->off > 1 * GB) {
-        assert(0);
-    }
+    send->iptr = send->addr + page->len;
 
 #if 0
     int idx;
@@ -308,46 +319,54 @@ void sdsd_ssvr_switch_send_buff(sdsd_cntx_t *ctx, sdsd_ssvr_t *ssvr)
 }
 
 /******************************************************************************
- **函数名称: sdsd_ssvr_set_rwset
- **功    能: 设置读写集
+ **函数名称: sdsd_ssvr_set_events
+ **功    能: 设置侦听事件
  **输入参数:
  **     ssvr: 发送服务对象
  **输出参数: NONE
- **返    回: 0:成功 !0:失败
+ **返    回: VOID
  **实现描述:
- **注意事项:
+ **     1. 新建的连接: 加入事件侦听
+ **     2. 已有的连接: 只有存在待发送的数据时, 才侦听可写事件
+ **注意事项: 套接字关闭时, 内核自动将其从epoll中剔除
  **作    者: # Qifeng.zou # 2015.01.16 #
  ******************************************************************************/
-void sdsd_ssvr_set_rwset(sdsd_ssvr_t *ssvr)
+static void sdsd_ssvr_set_events(sdsd_ssvr_t *ssvr)
 {
     int idx;
+    uint32_t events;
     sdtp_snap_t *snap;
+    struct epoll_event ev;
+    sdsd_sck_t *sck = &ssvr->sck;
 
-    FD_ZERO(&ssvr->rset);
-    FD_ZERO(&ssvr->wset);
-
-    FD_SET(ssvr->cmd_sck_id, &ssvr->rset);
-
-    ssvr->max = MAX(ssvr->cmd_sck_id, ssvr->sck.fd);
+    events = EPOLLIN;
 
-    /* 1 设置读集合 */
-    FD_SET(ssvr->sck.fd, &ssvr->rset);
+    /* > 是否侦听可写事件 */
+    if (!list_empty(sck->mesg_list)) {
+        events |= EPOLLOUT;
+    } else {
+        snap = &sck->send[SDTP_SNAP_SHOT_SYS_DATA];
+        for (idx=0; idx<SDTP_SNAP_SHOT_TOTAL; ++idx, ++snap) {
+            if (snap->iptr != snap->optr) {
+                events |= EPOLLOUT;
+                break;
+            }
+        }
+    }
 
-    /* 2 设置写集合: 发送至接收端 */
-    if (!list_empty(ssvr->sck.mesg_list)) {
-        FD_SET(ssvr->sck.fd, &ssvr->wset);
+    if (events == sck->events) {
         return;
     }
 
-    snap = &ssvr->sck.send[SDTP_SNAP_SHOT_SYS_DATA];
-    for (idx=0; idx<SDTP_SNAP_SHOT_TOTAL; ++idx, ++snap) {
-        if (snap->iptr != snap->optr) {
-            FD_SET(ssvr->sck.fd, &ssvr->wset);
-            return;
-        }
-    }
+    /* > 修改侦听事件 */
+    memset(&ev, 0, sizeof(ev));
 
-    return;
+    ev.data.ptr = sck;
+    ev.events = events;
+
+    epoll_ctl(ssvr->epid, (0 == sck->events)? EPOLL_CTL_ADD : EPOLL_CTL_MOD, sck->fd, &ev);
+
+    sck->events = events;
 }
 
 /******************************************************************************
@@ -363,17 +382,17 @@ void sdsd_ssvr_set_rwset(sdsd_ssvr_t *ssvr)
  ******************************************************************************/
 void *sdsd_ssvr_routine(void *_ctx)
 {
-    int ret;
+    int idx;
     sdsd_sck_t *sck;
     sdsd_ssvr_t *ssvr;
-    struct timeval timeout;
+    struct epoll_event *ev;
     sdsd_cntx_t *ctx = (sdsd_cntx_t *)_ctx;
     sdsd_conf_t *conf = &ctx->conf;
 
     /* 1. 获取发送线程 */
     ssvr = sdsd_ssvr_get_curr(ctx);
     if (NULL == ssvr) {
-        log_fatal(ssvr->log, "Get current thread failed!");
+        log_fatal(ctx->log, "Get current thread failed!");
         abort();
         return (void *)-1;
     }
@@ -397,6 +416,7 @@ void *sdsd_ssvr_routine(void *_ctx)
                 continue;
             }
 
+            sck->events = 0; /* 新连接: 需重新加入事件侦听 */
             sdtp_set_kpalive_stat(sck, SDTP_KPALIVE_STAT_UNKNOWN);
             sdtp_link_auth_req(ctx, ssvr); /* 发起鉴权请求 */
         }
@@ -404,34 +424,38 @@ void *sdsd_ssvr_routine(void *_ctx)
         sdsd_ssvr_switch_send_buff(ctx, ssvr);
 
         /* 3.2 等待事件通知 */
-        sdsd_ssvr_set_rwset(ssvr);
+        sdsd_ssvr_set_events(ssvr);
 
-        timeout.tv_sec = SDTP_SSVR_TMOUT_SEC;
-        timeout.tv_usec = SDTP_SSVR_TMOUT_USEC;
-        ret = select(ssvr->max+1, &ssvr->rset, &ssvr->wset, NULL, &timeout);
-        if (ret < 0) {
+        ssvr->fds = epoll_wait(ssvr->epid, ssvr->events, SDSD_EVENT_MAX_NUM,
+                SDTP_SSVR_TMOUT_SEC * 1000 + SDTP_SSVR_TMOUT_USEC / 1000);
+        if (ssvr->fds < 0) {
             if (EINTR == errno) { continue; }
             log_fatal(ssvr->log, "errmsg:[%d] %s!", errno, strerror(errno));
             abort();
             return (void *)-1;
-        } else if (0 == ret) {
+        } else if (0 == ssvr->fds) {
             sdsd_ssvr_timeout_hdl(ctx, ssvr);
             continue;
         }
 
-        /* 发送数据: 发送优先 */
-        if (FD_ISSET(sck->fd, &ssvr->wset)) {
-            sdsd_ssvr_send_data(ctx, ssvr);
-        }
+        for (idx=0; idx<ssvr->fds; ++idx) {
+            ev = &ssvr->events[idx];
 
-        /* 接收命令 */
-        if (FD_ISSET(ssvr->cmd_sck_id, &ssvr->rset)) {
-            sdsd_ssvr_recv_cmd(ctx, ssvr);
-        }
+            /* 接收命令 */
+            if (ev->data.ptr == (void *)&ssvr->cmd_sck_id) {
+                sdsd_ssvr_recv_cmd(ctx, ssvr);
+                continue;
+            }
+
+            /* 发送数据: 发送优先 */
+            if ((ev->events & EPOLLOUT) && (sck->fd >= 0)) {
+                sdsd_ssvr_send_data(ctx, ssvr);
+            }
 
-        /* 接收Recv服务的数据 */
-        if (FD_ISSET(sck->fd, &ssvr->rset)) {
-            sdsd_ssvr_recv_proc(ctx, ssvr);
+            /* 接收Recv服务的数据 */
+            if ((ev->events & (EPOLLIN | EPOLLERR | EPOLLHUP)) && (sck->fd >= 0)) {
+                sdsd_ssvr_recv_proc(ctx, ssvr);
+            }
         }
     }
 
@@ -156,6 +156,10 @@ int sdsd_worker_init(sdsd_cntx_t *ctx, sdtp_worker_t *worker, int id)
 
     worker->id = id;
     worker->log = ctx->log;
+    worker->evfd = INVALID_FD; /* 发送端无需事件通知 */
+    worker->proc_metric = metrics_counter("sdsd.worker.proc");
+    worker->drop_metric = metrics_counter("sdsd.worker.drop");
+    worker->err_metric = metrics_counter("sdsd.worker.err");
 
     /* 1. 创建命令套接字 */
     sdsd_worker_usck_path(conf, path, worker->id);
@@ -256,6 +260,7 @@ static int sdsd_worker_cmd_proc_req_hdl(sdsd_cntx_t *ctx, sdtp_worker_t *worker,
             if (NULL == reg->proc) {
                 ptr += head->length + sizeof(sdtp_header_t);
                 ++worker->drop_total;   /* 丢弃计数 */
+                metrics_counter_inc(worker->drop_metric);
                 continue;
             }
 
@@ -263,8 +268,10 @@ static int sdsd_worker_cmd_proc_req_hdl(sdsd_cntx_t *ctx, sdtp_worker_t *worker,
                         ptr+sizeof(sdtp_header_t), head->length, reg->args))
             {
                 ++worker->err_total;    /* 错误计数 */
+                metrics_counter_inc(worker->err_metric);
             } else {
                 ++worker->proc_total;   /* 处理计数 */
+                metrics_counter_inc(worker->proc_metric);
             }
 
             ptr += head->length + sizeof(sdtp_header_t);
@@ -0,0 +1,184 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+
+###############################################################################
+## 文件名: log_decode.py
+## 描  述: 二进制日志解析工具
+##         将二进制模式(LOG_MODE_BINARY)的日志文件还原为文本日志, 输出格式与
+##         文本模式相同. 文件格式见src/incl/log.h
+## 用  法: log_decode.py 日志文件 [日志文件 ...] > 输出文件
+## 作  者: # Qifeng.zou # 2015.09.26 #
+###############################################################################
+
+import re
+import sys
+import time
+import struct
+
+LOG_BIN_MAGIC = 0x42474F4C
+LOG_BIN_VERSION = 1
+
+# 记录类型
+LOG_REC_TEXT = 0
+LOG_REC_FMT = 1
+LOG_REC_DATA = 2
+
+# 参数类型
+LOG_ARG_INT = 0
+LOG_ARG_LONG = 1
+LOG_ARG_DOUBLE = 2
+LOG_ARG_STR = 3
+LOG_ARG_PTR = 4
+
+LOG_LEVEL_TAG = ["TRACE", "DEBUG", "INFO", "WARN", "ERROR", "FATAL", "OTHER"]
+
+EIGHT_EAST_AREA_TM_DIFF_SEC = 28800 # 与local_time()一致: 东八区
+
+# printf转换说明: [标志][宽度][.精度][长度]转换符
+FMT_SPEC = re.compile(r"%([-+ #0']*)(\*|\d+)?(?:\.(\*|\d*))?((?:hh|h|ll|l|z|j|t|q)*)([diouxXceEfFgGaAsp%])")
+
+# 格式定义
+class CFormat(object):
+    def __init__(self, body):
+        (self.id, self.lineno, self.level, argc) = struct.unpack_from("<Iiii", body, 0)
+        off = 16
+        self.types = bytearray(body[off:off+argc])
+        off += argc
+        (fname, func, fmt) = body[off:].split(b"\0")[0:3]
+        self.fname = fname.decode("utf-8", "replace")
+        self.func = func.decode("utf-8", "replace")
+        self.fmt = fmt.decode("utf-8", "replace")
+
+    # 解析参数
+    def unpack_args(self, body, off):
+        args = []
+        for t in self.types:
+            if t == LOG_ARG_DOUBLE:
+                args.append(struct.unpack_from("<d", body, off)[0])
+                off += 8
+            elif t == LOG_ARG_STR:
+                n = struct.unpack_from("<I", body, off)[0]
+                off += 4
+                args.append(body[off:off+n].decode("utf-8", "replace"))
+                off += n
+            else:
+                args.append(struct.unpack_from("<q", body, off)[0])
+                off += 8
+        return args
+
+    # 按格式串还原日志内容
+    def render(self, args):
+        args = list(args)
+
+        def conv(m):
+            (flags, width, prec, length, spec) = m.groups()
+            if spec == "%":
+                return "%"
+            flags = flags.replace("'", "")
+            if width == "*":
+                width = str(args.pop(0))
+                if width.startswith("-"):
+                    flags += "-"
+                    width = width[1:]
+            if prec == "*":
+                prec = args.pop(0)
+                prec = None if prec < 0 else str(prec) # 负数精度视为未指定
+            val = args.pop(0)
+
+            if spec in "diouxX":
+                bits = 64 if length in ("l", "ll", "z", "j", "t", "q") else \
+                        (8 if length == "hh" else (16 if length == "h" else 32))
+                val &= (1 << bits) - 1
+                if spec in "di":
+                    if val >= (1 << (bits - 1)):
+                        val -= (1 << bits)
+                    spec = "d"
+                elif spec == "u":
+                    spec = "d"
+            elif spec == "c":
+                val = chr(val & 0xFF)
+            elif spec == "p":
+                if val == 0:
+                    val = "(nil)"
+                else:
+                    val = "0x%x" % (val & 0xFFFFFFFFFFFFFFFF)
+                spec = "s"
+                prec = None
+            elif spec in "aA":
+                val = float.hex(val)
+                if spec == "A":
+                    val = val.upper()
+                spec = "s"
+                prec = None
+
+            pyfmt = "%" + flags + (width or "")
+            if prec is not None:
+                pyfmt += "." + (prec or "0")
+            return (pyfmt + spec) % (val,)
+
+        try:
+            return FMT_SPEC.sub(conv, self.fmt)
+        except (IndexError, TypeError, ValueError):
+            return "%s <decode failed: %r>" % (self.fmt, args)
+
+# 解析二进制日志
+def decode_data(fmts, body, out):
+    (sec, nsec, fid, pid, resv) = struct.unpack_from("<QIIiI", body, 0)
+    fmt = fmts.get(fid)
+    if fmt is None:
+        out.write(("<unknown format id:%d>\n" % (fid)).encode("utf-8"))
+        return
+    tm = time.gmtime(sec + EIGHT_EAST_AREA_TM_DIFF_SEC)
+    level = fmt.level if 0 <= fmt.level < len(LOG_LEVEL_TAG) - 1 else len(LOG_LEVEL_TAG) - 1
+    line = "@%d|%04d%02d%02d|%02d:%02d:%02d.%03d|%s [%s][%d]%s() %s\n" % (
+            pid, tm.tm_year, tm.tm_mon, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec,
+            nsec // 1000000, LOG_LEVEL_TAG[level], fmt.fname, fmt.lineno, fmt.func,
+            fmt.render(fmt.unpack_args(body, 24)))
+    out.write(line.encode("utf-8"))
+
+# 解析日志文件
+def decode_file(path, out):
+    fobj = open(path, "rb")
+    data = fobj.read()
+    fobj.close()
+
+    if len(data) < 8:
+        sys.stderr.write("%s: too short!\n" % (path))
+        return -1
+    (magic, version) = struct.unpack_from("<II", data, 0)
+    if magic != LOG_BIN_MAGIC or version != LOG_BIN_VERSION:
+        sys.stderr.write("%s: not a binary log! magic:0x%08X version:%d\n" % (path, magic, version))
+        return -1
+
+    fmts = {}
+    off = 8
+    while off + 8 <= len(data):
+        (length, rtype) = struct.unpack_from("<II", data, off)
+        off += 8
+        body = data[off:off+length]
+        off += length
+        if len(body) < length:
+            sys.stderr.write("%s: truncated record at offset %d!\n" % (path, off - 8 - length))
+            break
+        if rtype == LOG_REC_TEXT:
+            out.write(body)
+        elif rtype == LOG_REC_FMT:
+            fmt = CFormat(body)
+            fmts[fmt.id] = fmt
+        elif rtype == LOG_REC_DATA:
+            decode_data(fmts, body, out)
+    return 0
+
+def main():
+    if len(sys.argv) < 2:
+        sys.stderr.write("usage: %s log [log ...]\n" % (sys.argv[0]))
+        return -1
+    out = getattr(sys.stdout, "buffer", sys.stdout)
+    ret = 0
+    for path in sys.argv[1:]:
+        if decode_file(path, out) < 0:
+            ret = -1
+    return ret
+
+if __name__ == "__main__":
+    sys.exit(main())
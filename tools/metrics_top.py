@@ -0,0 +1,170 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+
+###############################################################################
+## 文件名: metrics_top.py
+## 描  述: 进程内统计查看工具
+##         附着metrics_init()创建的共享内存, 定时读取统计快照并打印: 计数器的
+##         值及每秒增量, 仪表的值, 直方图的次数/每秒次数/均值/分位数.
+##         共享内存格式见src/incl/metrics.h
+## 用  法: metrics_top.py 共享内存路径 [间隔秒数] [次数(0:不限)]
+## 作  者: # Qifeng.zou # 2015.09.29 #
+###############################################################################
+
+import re
+import sys
+import time
+import ctypes
+import ctypes.util
+import struct
+
+METRICS_MAGIC = 0x4D455452
+METRICS_VERSION = 1
+METRICS_MAX_NUM = 256
+METRICS_HIST_MAX_NUM = 32
+METRICS_NAME_MAX_LEN = 64
+
+# 统计类型
+METRICS_COUNTER = 0
+METRICS_GAUGE = 1
+METRICS_HISTOGRAM = 2
+
+SHM_RDONLY = 0o10000
+
+HEAD = struct.Struct("=IIQQiIII")
+ITEM = struct.Struct("=%dsiiqQ" % METRICS_NAME_MAX_LEN)
+
+QUANTILES = [0.5, 0.9, 0.99, 0.999]
+
+libc = ctypes.CDLL(ctypes.util.find_library("c"), use_errno=True)
+libc.shmat.restype = ctypes.c_void_p
+libc.shmat.argtypes = [ctypes.c_int, ctypes.c_void_p, ctypes.c_int]
+
+# 读取共享内存ID及大小(shm_creat()写入的XML文件)
+def shm_load(path):
+    text = open(path).read()
+    shmid = re.search(r"<ID>\s*(-?\d+)\s*</ID>", text)
+    size = re.search(r"<SIZE>\s*(\d+)\s*</SIZE>", text)
+    if shmid is None or size is None:
+        raise ValueError("invalid shm file: %s" % path)
+    return int(shmid.group(1)), int(size.group(1))
+
+# 附着共享内存(只读)
+def shm_attach(path):
+    shmid, size = shm_load(path)
+    addr = libc.shmat(shmid, None, SHM_RDONLY)
+    if addr is None or addr == ctypes.c_void_p(-1).value:
+        raise OSError(ctypes.get_errno(), "shmat failed: id=%d" % shmid)
+    return addr, size
+
+# 读取快照(顺序锁: seq为奇数或前后不一致时重读)
+def snapshot(addr, size):
+    seq = ctypes.c_uint64.from_address(addr + 8)
+    while True:
+        begin = seq.value
+        if begin & 1:
+            time.sleep(0.001)
+            continue
+        data = ctypes.string_at(addr, size)
+        if seq.value == begin:
+            break
+
+    magic, version, _, msec, pid, num, sub_bits, bucket_num = HEAD.unpack_from(data, 0)
+    if magic != METRICS_MAGIC or version != METRICS_VERSION:
+        raise ValueError("invalid metrics shm: magic=%#x version=%d" % (magic, version))
+
+    bucket_off = HEAD.size + ITEM.size * METRICS_MAX_NUM
+    items = []
+    for idx in range(num):
+        name, mtype, hist, value, total = ITEM.unpack_from(data, HEAD.size + ITEM.size * idx)
+        name = name.split(b"\0", 1)[0].decode("utf-8", "replace")
+        buckets = None
+        if mtype == METRICS_HISTOGRAM:
+            off = bucket_off + 8 * bucket_num * hist
+            buckets = struct.unpack_from("=%dQ" % bucket_num, data, off)
+        items.append((name, mtype, value, total, buckets))
+
+    return {"time": msec / 1000.0, "pid": pid, "sub_bits": sub_bits, "items": items}
+
+# 分桶的上界(与metrics_hist_bucket()对应)
+def bucket_upper(idx, sub_bits):
+    sub_num = 1 << sub_bits
+    if idx < sub_num:
+        return idx
+    exp = ((idx - sub_num) >> sub_bits) + sub_bits
+    sub = (idx - sub_num) & (sub_num - 1)
+    lower = (sub_num + sub) << (exp - sub_bits)
+    return lower + (1 << (exp - sub_bits)) - 1
+
+# 计算分位数(返回所在分桶的上界)
+def quantile(buckets, count, q, sub_bits):
+    if count == 0:
+        return 0
+    rank = q * count
+    acc = 0
+    for idx, num in enumerate(buckets):
+        acc += num
+        if acc >= rank and num:
+            return bucket_upper(idx, sub_bits)
+    return 0
+
+# 两次快照之差(直方图的分位数按区间内的增量计算)
+def delta(cur, prev):
+    if prev is None or prev["pid"] != cur["pid"]:
+        return {}, 0.0
+    old = dict((item[0], item) for item in prev["items"])
+    return old, cur["time"] - prev["time"]
+
+def show(cur, prev):
+    old, sec = delta(cur, prev)
+    sub_bits = cur["sub_bits"]
+
+    sys.stdout.write("%s pid:%d\n" % (time.strftime("%Y-%m-%d %H:%M:%S",
+                     time.localtime(cur["time"])), cur["pid"]))
+    for name, mtype, value, total, buckets in cur["items"]:
+        last = old.get(name)
+        rate = ""
+        if last is not None and sec > 0 and mtype != METRICS_GAUGE:
+            rate = "%.1f/s" % ((value - last[2]) / sec)
+
+        if mtype == METRICS_COUNTER:
+            sys.stdout.write("  %-40s counter %16d %14s\n" % (name, value, rate))
+        elif mtype == METRICS_GAUGE:
+            sys.stdout.write("  %-40s gauge   %16d\n" % (name, value))
+        else:
+            count, acc = value, total
+            if last is not None and value > last[2]:
+                count = value - last[2]
+                acc = total - last[3]
+                buckets = [a - b for a, b in zip(buckets, last[4])]
+            mean = (float(acc) / count) if count else 0.0
+            qs = " ".join("p%s=%d" % (("%g" % (q * 100)), quantile(buckets, count, q, sub_bits))
+                          for q in QUANTILES)
+            sys.stdout.write("  %-40s hist    %16d %14s mean=%.1f %s\n"
+                             % (name, value, rate, mean, qs))
+    sys.stdout.write("\n")
+    sys.stdout.flush()
+
+def main():
+    if len(sys.argv) < 2:
+        sys.stderr.write("usage: %s path [interval(sec)] [count(0:unlimited)]\n" % sys.argv[0])
+        return 1
+
+    interval = float(sys.argv[2]) if len(sys.argv) > 2 else 1.0
+    count = int(sys.argv[3]) if len(sys.argv) > 3 else 0
+
+    addr, size = shm_attach(sys.argv[1])
+    prev = None
+    idx = 0
+    while True:
+        cur = snapshot(addr, size)
+        show(cur, prev)
+        prev = cur
+        idx += 1
+        if count and idx >= count:
+            break
+        time.sleep(interval)
+    return 0
+
+if __name__ == "__main__":
+    sys.exit(main())
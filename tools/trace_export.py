@@ -0,0 +1,132 @@
+#!/usr/bin/env python
+# -*- coding: utf-8 -*-
+
+###############################################################################
+## 文件名: trace_export.py
+## 描  述: 跟踪文件转换工具
+##         将trace_init()生成的跟踪文件转换为Chrome trace格式(JSON), 可在
+##         chrome://tracing或Perfetto中查看; 同时在标准错误输出各阶段耗时
+##         的分位数统计. 文件格式见src/incl/trace.h
+##         每条被抽样的消息输出为一组异步事件(整体及相邻阶段之间的区间),
+##         同一线程内的区间另输出到该线程的时间线上.
+## 用  法: trace_export.py 跟踪文件 > trace.json
+## 作  者: # Qifeng.zou # 2015.09.30 #
+###############################################################################
+
+import sys
+import json
+import struct
+
+TRACE_MAGIC = 0x43415254
+TRACE_VERSION = 1
+TRACE_STAGE_MAX_NUM = 16
+TRACE_NAME_MAX_LEN = 32
+
+HEAD = struct.Struct("=IIiIQQQQ%ds" % (TRACE_STAGE_MAX_NUM * TRACE_NAME_MAX_LEN))
+EVENT = struct.Struct("=QQIHHII")
+
+# 读取文件头
+def load_head(data):
+    if len(data) < HEAD.size:
+        raise ValueError("file too short")
+    magic, version, pid, rate, tsc_hz, tsc_base, ns_base, drop, names = HEAD.unpack_from(data, 0)
+    if magic != TRACE_MAGIC or version != TRACE_VERSION:
+        raise ValueError("invalid trace file: magic=%#x version=%d" % (magic, version))
+    stage = []
+    for idx in range(TRACE_STAGE_MAX_NUM):
+        name = names[idx * TRACE_NAME_MAX_LEN:(idx + 1) * TRACE_NAME_MAX_LEN]
+        name = name.split(b"\0", 1)[0].decode("utf-8", "replace")
+        stage.append(name or ("stage%d" % idx))
+    return {"pid": pid, "rate": rate, "tsc_hz": tsc_hz, "tsc_base": tsc_base,
+            "ns_base": ns_base, "drop": drop, "stage": stage}
+
+# 读取事件, 按跟踪ID分组
+def load_events(data):
+    traces = {}
+    off = HEAD.size
+    while off + EVENT.size <= len(data):
+        tid, tsc, thread, stage, _, mtype, _ = EVENT.unpack_from(data, off)
+        traces.setdefault(tid, []).append((stage, tsc, thread, mtype))
+        off += EVENT.size
+    return traces
+
+def quantile(vals, q):
+    if not vals:
+        return 0.0
+    return vals[min(len(vals) - 1, int(q * len(vals)))]
+
+def export(head, traces):
+    pid = head["pid"]
+    tsc_base = head["tsc_base"]
+    scale = 1e6 / head["tsc_hz"]
+    stage = head["stage"]
+
+    def us(tsc):
+        return (tsc - tsc_base) * scale
+
+    out = []
+    spans = {}
+    threads = set()
+    for tid in sorted(traces):
+        ev = sorted(traces[tid])
+        if len(ev) < 2:
+            continue
+        mtype = ev[0][3]
+        aid = "0x%x" % tid
+        args = {"trace_id": aid, "type": "0x%04X" % mtype}
+
+        out.append({"name": "type:0x%04X" % mtype, "cat": "trace", "ph": "b", "id": aid,
+                    "pid": pid, "tid": ev[0][2], "ts": us(ev[0][1]), "args": args})
+        for prev, curr in zip(ev[:-1], ev[1:]):
+            name = "%s->%s" % (stage[prev[0]], stage[curr[0]])
+            dur = us(curr[1]) - us(prev[1])
+            spans.setdefault((prev[0], curr[0]), []).append(dur)
+
+            out.append({"name": name, "cat": "trace", "ph": "b", "id": aid,
+                        "pid": pid, "tid": prev[2], "ts": us(prev[1])})
+            out.append({"name": name, "cat": "trace", "ph": "e", "id": aid,
+                        "pid": pid, "tid": curr[2], "ts": us(curr[1])})
+            if prev[2] == curr[2]:
+                out.append({"name": name, "cat": "stage", "ph": "X", "pid": pid,
+                            "tid": curr[2], "ts": us(prev[1]), "dur": dur, "args": args})
+            threads.add(prev[2])
+            threads.add(curr[2])
+        out.append({"name": "type:0x%04X" % mtype, "cat": "trace", "ph": "e", "id": aid,
+                    "pid": pid, "tid": ev[-1][2], "ts": us(ev[-1][1])})
+
+    for thread in sorted(threads):
+        out.append({"name": "thread_name", "ph": "M", "pid": pid, "tid": thread,
+                    "args": {"name": "tid %d" % thread}})
+
+    json.dump({"traceEvents": out, "displayTimeUnit": "ns",
+               "otherData": {"pid": pid, "rate": head["rate"], "tsc_hz": head["tsc_hz"],
+                             "time_base_ns": head["ns_base"], "drop": head["drop"]}},
+              sys.stdout)
+    sys.stdout.write("\n")
+
+    # 各阶段耗时统计
+    sys.stderr.write("traces:%d rate:1/%d dropped events:%d\n"
+                     % (len(traces), head["rate"], head["drop"]))
+    sys.stderr.write("%-24s %10s %10s %10s %10s %10s\n"
+                     % ("stage(us)", "count", "p50", "p90", "p99", "max"))
+    for key in sorted(spans):
+        vals = sorted(spans[key])
+        sys.stderr.write("%-24s %10d %10.2f %10.2f %10.2f %10.2f\n"
+                         % ("%s->%s" % (stage[key[0]], stage[key[1]]), len(vals),
+                            quantile(vals, 0.5), quantile(vals, 0.9),
+                            quantile(vals, 0.99), vals[-1]))
+
+def main():
+    if len(sys.argv) != 2:
+        sys.stderr.write("usage: %s trace_file > trace.json\n" % sys.argv[0])
+        return 1
+
+    with open(sys.argv[1], "rb") as fp:
+        data = fp.read()
+
+    head = load_head(data)
+    export(head, load_events(data))
+    return 0
+
+if __name__ == "__main__":
+    sys.exit(main())